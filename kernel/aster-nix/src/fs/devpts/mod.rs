@@ -99,7 +99,7 @@ impl FileSystem for DevPts {
     }
 
     fn flags(&self) -> FsFlags {
-        FsFlags::empty()
+        FsFlags::NO_NEGATIVE_DENTRY
     }
 }
 
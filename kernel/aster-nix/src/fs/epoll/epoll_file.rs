@@ -12,7 +12,7 @@ use super::*;
 use crate::{
     events::Observer,
     fs::{file_handle::FileLike, file_table::FdEvents, utils::IoctlCmd},
-    process::signal::{Pollee, Poller},
+    process::signal::{Pauser, Pollee, Poller},
 };
 
 /// A file-like object that provides epoll API.
@@ -27,23 +27,51 @@ use crate::{
 /// on the files. To do so, the `EpollFile` registers itself as an `Observer` to
 /// the monotored files. Thus, we can add a file to the ready list when an interesting
 /// event happens on the file.
+///
+/// An entry is put into the ready list at most once, which is tracked by its
+/// ready flag. So a file that keeps producing events while it is already in the
+/// ready list costs no more than an atomic operation, and the lock of the ready
+/// list is only taken when an entry becomes ready for the first time.
+///
+/// A thread that waits on the epoll file scans the ready list without holding
+/// the lock of the ready list: it moves all the ready entries to its scan list
+/// in one go, polls them and reports the events, and then moves the remaining
+/// entries back. The two lists exchange their buffers, so that no memory needs
+/// to be allocated to wait for events once the lists have grown large enough.
+///
+/// The threads waiting on the same epoll file are woken up one at a time. A
+/// woken thread passes the wakeup on to another one if it leaves some ready
+/// entries for others.
 pub struct EpollFile {
     // All interesting entries.
     interest: Mutex<BTreeMap<FileDesc, Arc<EpollEntry>>>,
     // Entries that are probably ready (having events happened).
-    ready: Mutex<VecDeque<Arc<EpollEntry>>>,
+    ready: SpinLock<VecDeque<Arc<EpollEntry>>>,
+    // Entries that are being scanned by a waiting thread. The lock also
+    // serializes the scans of the ready list.
+    scan: Mutex<VecDeque<Arc<EpollEntry>>>,
+    // Threads waiting for ready entries in `EpollFile::wait`.
+    waiters: Arc<Pauser>,
     // EpollFile itself is also pollable
     pollee: Pollee,
     // Any EpollFile is wrapped with Arc when created.
     weak_self: Weak<Self>,
 }
 
+/// The events that are allowed to be used along with `EpollFlags::EXCLUSIVE`.
+const EXCLUSIVE_OK_EVENTS: IoEvents = IoEvents::IN
+    .union(IoEvents::OUT)
+    .union(IoEvents::ERR)
+    .union(IoEvents::HUP);
+
 impl EpollFile {
     /// Creates a new epoll file.
     pub fn new() -> Arc<Self> {
         Arc::new_cyclic(|me| Self {
             interest: Mutex::new(BTreeMap::new()),
-            ready: Mutex::new(VecDeque::new()),
+            ready: SpinLock::new(VecDeque::new()),
+            scan: Mutex::new(VecDeque::new()),
+            waiters: Pauser::new(),
             pollee: Pollee::new(IoEvents::empty()),
             weak_self: me.clone(),
         })
@@ -69,6 +97,19 @@ impl EpollFile {
         let file_table = current.file_table().lock();
         let file_table_entry = file_table.get_entry(fd)?;
         let file = file_table_entry.file();
+        if ep_flags.contains(EpollFlags::EXCLUSIVE) {
+            if ep_flags.contains(EpollFlags::ONE_SHOT)
+                || !EXCLUSIVE_OK_EVENTS.contains(ep_event.events)
+            {
+                return_errno_with_message!(Errno::EINVAL, "invalid events for EPOLLEXCLUSIVE");
+            }
+            if file.downcast_ref::<EpollFile>().is_some() {
+                return_errno_with_message!(
+                    Errno::EINVAL,
+                    "EPOLLEXCLUSIVE cannot be used with epoll files"
+                );
+            }
+        }
         let weak_file = Arc::downgrade(file);
         let mask = ep_event.events;
         let entry = EpollEntry::new(fd, weak_file, ep_event, ep_flags, self.weak_self.clone());
@@ -127,6 +168,10 @@ impl EpollFile {
     ) -> Result<()> {
         self.warn_unsupported_flags(&new_ep_flags);
 
+        if new_ep_flags.contains(EpollFlags::EXCLUSIVE) {
+            return_errno_with_message!(Errno::EINVAL, "EPOLLEXCLUSIVE cannot be modified");
+        }
+
         // Update the epoll entry
         let interest = self.interest.lock();
         let entry = interest
@@ -135,6 +180,9 @@ impl EpollFile {
         if entry.is_deleted() {
             return_errno_with_message!(Errno::ENOENT, "fd is not in the interest list");
         }
+        if entry.flags().contains(EpollFlags::EXCLUSIVE) {
+            return_errno_with_message!(Errno::EINVAL, "the fd is added with EPOLLEXCLUSIVE");
+        }
         let new_mask = new_ep_event.events;
         entry.update(new_ep_event, new_ep_flags);
         let entry = entry.clone();
@@ -164,128 +212,193 @@ impl EpollFile {
     /// of the epoll file.
     ///
     /// This method blocks until either some interesting events happen or
-    /// the timeout expires or a signal arrives. The first case returns
-    /// `Ok(events)`, where `events` is a `Vec` containing at most `max_events`
-    /// number of `EpollEvent`s. The second and third case returns errors.
+    /// the timeout expires or a signal arrives. In the first case, at most
+    /// `max_events` number of `EpollEvent`s are handed to `on_event` one by
+    /// one, and the number of the events is returned. In the second case,
+    /// zero is returned. The third case returns an error.
+    ///
+    /// The events are handed over as soon as they are collected, so that
+    /// they can be copied to the user space without being buffered. If
+    /// `on_event` fails, the event is kept in the ready list. The error is
+    /// returned if no events have been handed over successfully; otherwise,
+    /// the events that have been handed over are counted in the return value.
     ///
     /// When `max_events` equals to zero, the method returns when the timeout
     /// expires or a signal arrives.
-    pub fn wait(&self, max_events: usize, timeout: Option<&Duration>) -> Result<Vec<EpollEvent>> {
-        let mut ep_events = Vec::new();
-        let mut poller = None;
+    pub fn wait<F>(
+        &self,
+        max_events: usize,
+        timeout: Option<&Duration>,
+        mut on_event: F,
+    ) -> Result<usize>
+    where
+        F: FnMut(EpollEvent) -> Result<()>,
+    {
+        let res = self.do_wait(max_events, timeout, &mut on_event);
+
+        // We may have been woken up for the ready entries, but leave before
+        // consuming them, e.g., due to a signal. Pass the wakeup on in this case.
+        if res.is_err() && self.has_ready() {
+            self.waiters.resume_one();
+        }
+
+        res
+    }
+
+    fn do_wait<F>(
+        &self,
+        max_events: usize,
+        timeout: Option<&Duration>,
+        on_event: &mut F,
+    ) -> Result<usize>
+    where
+        F: FnMut(EpollEvent) -> Result<()>,
+    {
+        let cond = || self.has_ready().then_some(());
+
         loop {
             // Try to pop some ready entries
-            if self.pop_ready(max_events, &mut ep_events) > 0 {
-                return Ok(ep_events);
+            let count_events = self.pop_ready(max_events, on_event)?;
+            if count_events > 0 {
+                return Ok(count_events);
             }
 
             // Return immediately if specifying a timeout of zero
             if timeout.is_some() && timeout.as_ref().unwrap().is_zero() {
-                return Ok(ep_events);
+                return Ok(0);
             }
 
             // If no ready entries for now, wait for them
-            if poller.is_none() {
-                poller = Some(Poller::new());
-                let events = self.pollee.poll(IoEvents::IN, poller.as_ref());
-                if !events.is_empty() {
-                    continue;
-                }
-            }
-
-            if let Some(timeout) = timeout {
-                poller.as_ref().unwrap().wait_timeout(timeout)?;
+            let res = if let Some(timeout) = timeout {
+                self.waiters.pause_until_or_timeout(cond, timeout)
             } else {
-                poller.as_ref().unwrap().wait()?;
+                self.waiters.pause_until(cond)
+            };
+            match res {
+                Ok(()) => (),
+                Err(err) if err.error() == Errno::ETIME => return Ok(0),
+                Err(err) => return Err(err),
             }
         }
     }
 
+    fn has_ready(&self) -> bool {
+        !self.ready.lock().is_empty()
+    }
+
     fn push_ready(&self, entry: Arc<EpollEntry>) {
-        let mut ready = self.ready.lock();
         if entry.is_deleted() {
             return;
         }
 
-        if !entry.is_ready() {
-            entry.set_ready();
-            ready.push_back(entry);
+        // If the entry is already in the ready list (or being scanned), it
+        // will be polled again anyway, so there is no need to wake anyone up.
+        if !entry.try_set_ready() {
+            return;
         }
 
-        // Even if the entry is already set to ready, there might be new events that we are interested in.
-        // Wake the poller anyway.
+        self.ready.lock().push_back(entry);
+
+        // Only one of the waiting threads is woken up, which avoids the
+        // thundering herd when many threads wait on the same epoll file.
+        self.waiters.resume_one();
         self.pollee.add_events(IoEvents::IN);
     }
 
-    fn pop_ready(&self, max_events: usize, ep_events: &mut Vec<EpollEvent>) -> usize {
+    fn pop_ready<F>(&self, max_events: usize, on_event: &mut F) -> Result<usize>
+    where
+        F: FnMut(EpollEvent) -> Result<()>,
+    {
+        let mut scan = self.scan.lock();
+        debug_assert!(scan.is_empty());
+
+        // Take all the ready entries and leave the empty buffer of the scan
+        // list to the ready list.
+        core::mem::swap(&mut *self.ready.lock(), &mut *scan);
+
         let mut count_events = 0;
-        let mut ready = self.ready.lock();
-        let mut pop_quota = ready.len();
-        loop {
-            // Pop some ready entries per round.
-            //
-            // Since the popped ready entries may contain "false positive" and
-            // we want to return as many results as possible, this has to
-            // be done in a loop.
-            let pop_count = (max_events - count_events).min(pop_quota);
-            if pop_count == 0 {
-                break;
+        let mut pop_quota = scan.len();
+        // Whether the entries left in the scan list deserve waking up another thread.
+        let mut should_wake_others = false;
+        let mut res = Ok(());
+        while count_events < max_events && pop_quota > 0 {
+            let entry = scan.pop_front().unwrap();
+            pop_quota -= 1;
+
+            // Reset the ready flag before polling the file. If new events happen
+            // after the file is polled, the entry will be pushed to the ready list again.
+            entry.reset_ready();
+            if entry.is_deleted() {
+                continue;
+            }
+
+            let (ep_event, ep_flags) = entry.event_and_flags();
+            // If this entry's file is ready, report the events.
+            // EPOLLHUP and EPOLLERR should always be reported.
+            let ready_events = entry.poll() & (ep_event.events | IoEvents::ALWAYS_POLL);
+            // If there are no events, the entry is removed from the ready list.
+            if ready_events.is_empty() {
+                continue;
             }
-            let ready_entries: Vec<Arc<EpollEntry>> = ready
-                .drain(..pop_count)
-                .filter(|entry| !entry.is_deleted())
-                .collect();
-            pop_quota -= pop_count;
-
-            // Examine these ready entries, which are candidates for the results
-            // to be returned.
-            for entry in ready_entries {
-                let (ep_event, ep_flags) = entry.event_and_flags();
-                // If this entry's file is ready, save it in the output array.
-                // EPOLLHUP and EPOLLERR should always be reported.
-                let ready_events = entry.poll() & (ep_event.events | IoEvents::HUP | IoEvents::ERR);
-                // If there are no events, the entry should be removed from the ready list.
-                if ready_events.is_empty() {
-                    entry.reset_ready();
-                    // For EPOLLONESHOT flag, this entry should also be removed from the interest list
-                    if ep_flags.intersects(EpollFlags::ONE_SHOT) {
-                        self.del_interest(entry.fd())
-                            .expect("this entry should be in the interest list");
-                    }
-                    continue;
-                }
 
-                // Records the events from the ready list
-                ep_events.push(EpollEvent::new(ready_events, ep_event.user_data));
-                count_events += 1;
+            if let Err(err) = on_event(EpollEvent::new(ready_events, ep_event.user_data)) {
+                // Keep the entry so that the events will not get lost.
+                if entry.try_set_ready() {
+                    scan.push_front(entry);
+                }
+                res = Err(err);
+                break;
+            }
+            count_events += 1;
 
+            if ep_flags.contains(EpollFlags::ONE_SHOT) {
+                // For EPOLLONESHOT flag, this entry should also be removed from the interest list.
+                // It may have been removed concurrently, so the error is ignored.
+                let _ = self.del_interest(entry.fd());
+            } else if !ep_flags.contains(EpollFlags::EDGE_TRIGGER) {
                 // If the epoll entry is neither edge-triggered or one-shot, then we should
-                // keep the entry in the ready list.
-                if !ep_flags.intersects(EpollFlags::ONE_SHOT | EpollFlags::EDGE_TRIGGER) {
-                    ready.push_back(entry);
+                // keep the entry in the ready list. For EPOLLEXCLUSIVE, the events have
+                // been reported by this thread, so no other threads need to be woken up
+                // for them.
+                if !ep_flags.contains(EpollFlags::EXCLUSIVE) {
+                    should_wake_others = true;
                 }
-                // Otherwise, the entry is indeed removed the ready list and we should reset
-                // its ready flag.
-                else {
-                    entry.reset_ready();
-                    // For EPOLLONESHOT flag, this entry should also be removed from the interest list
-                    if ep_flags.intersects(EpollFlags::ONE_SHOT) {
-                        self.del_interest(entry.fd())
-                            .expect("this entry should be in the interest list");
-                    }
+                if entry.try_set_ready() {
+                    scan.push_back(entry);
                 }
             }
         }
+        if pop_quota > 0 {
+            should_wake_others = true;
+        }
 
+        // Move the remaining entries back to the ready list, in front of the
+        // entries that became ready during the scan.
+        let mut ready = self.ready.lock();
+        if !ready.is_empty() {
+            should_wake_others = true;
+            scan.append(&mut ready);
+        }
+        core::mem::swap(&mut *ready, &mut *scan);
         // Clear the epoll file's events if no ready entries
-        if ready.len() == 0 {
+        if ready.is_empty() {
             self.pollee.del_events(IoEvents::IN);
         }
-        count_events
+        drop(ready);
+        drop(scan);
+
+        if should_wake_others && count_events > 0 {
+            self.waiters.resume_one();
+        }
+
+        match res {
+            Err(err) if count_events == 0 => Err(err),
+            _ => Ok(count_events),
+        }
     }
 
     fn warn_unsupported_flags(&self, flags: &EpollFlags) {
-        if flags.intersects(EpollFlags::EXCLUSIVE | EpollFlags::WAKE_UP) {
+        if flags.intersects(EpollFlags::WAKE_UP) {
             warn!("{:?} contains unsupported flags", flags);
         }
     }
@@ -361,7 +474,7 @@ impl FileLike for EpollFile {
 pub struct EpollEntry {
     fd: FileDesc,
     file: Weak<dyn FileLike>,
-    inner: Mutex<Inner>,
+    inner: SpinLock<Inner>,
     // Whether the entry is in the ready list
     is_ready: AtomicBool,
     // Whether the entry has been deleted from the interest list
@@ -389,7 +502,7 @@ impl EpollEntry {
         Arc::new_cyclic(|me| Self {
             fd,
             file,
-            inner: Mutex::new(Inner { event, flags }),
+            inner: SpinLock::new(Inner { event, flags }),
             is_ready: AtomicBool::new(false),
             is_deleted: AtomicBool::new(false),
             weak_epoll,
@@ -460,13 +573,18 @@ impl EpollEntry {
     }
 
     /// Mark the epoll entry as being in the ready list.
-    pub fn set_ready(&self) {
-        self.is_ready.store(true, Ordering::Relaxed);
+    ///
+    /// Returns `false` if the epoll entry has already been marked, in which
+    /// case the caller must not put it into the ready list again.
+    pub fn try_set_ready(&self) -> bool {
+        !self.is_ready.swap(true, Ordering::SeqCst)
     }
 
     /// Mark the epoll entry as not being in the ready list.
     pub fn reset_ready(&self) {
-        self.is_ready.store(false, Ordering::Relaxed)
+        // This has to be ordered before the subsequent polling of the file,
+        // so that the events happening after the polling are not missed.
+        self.is_ready.swap(false, Ordering::SeqCst);
     }
 
     /// Returns whether the epoll entry has been deleted from the interest list.
@@ -3,7 +3,7 @@
 #![allow(dead_code)]
 #![allow(unused_variables)]
 
-use core::ops::Range;
+use core::{mem::size_of, ops::Range};
 
 use align_ext::AlignExt;
 use aster_rights::Full;
@@ -17,10 +17,11 @@ use super::{
 };
 use crate::{fs::exfat::fat::FatChainFlags, prelude::*, vm::vmo::Vmo};
 
-// TODO: use u64
+/// The bits are stored in bytes, the same as on the disk, but scanned a word at a time.
 type BitStore = u8;
 
 const BITS_PER_BYTE: usize = 8;
+const BITS_PER_WORD: usize = u64::BITS as usize;
 
 #[derive(Debug, Default)]
 pub(super) struct ExfatBitmap {
@@ -68,15 +69,12 @@ impl ExfatBitmap {
         let mut buf = vec![0; dentry.size as usize];
 
         fs.read_meta_at(chain.physical_cluster_start_offset(), &mut buf)?;
-        let mut free_cluster_num = 0;
-        for idx in 0..fs.super_block().num_clusters - EXFAT_RESERVED_CLUSTERS {
-            if (buf[idx as usize / BITS_PER_BYTE] & (1 << (idx % BITS_PER_BYTE as u32))) == 0 {
-                free_cluster_num += 1;
-            }
-        }
+        let bitvec = BitVec::from_slice(&buf);
+        let num_valid_bits = (fs.super_block().num_clusters - EXFAT_RESERVED_CLUSTERS) as usize;
+        let free_cluster_num = bitvec[..num_valid_bits].count_zeros() as u32;
         Ok(ExfatBitmap {
             chain,
-            bitvec: BitVec::from_slice(&buf),
+            bitvec,
             dirty_bytes: VecDeque::new(),
             num_free_cluster: free_cluster_num,
             fs: fs_weak,
@@ -120,211 +118,114 @@ impl ExfatBitmap {
             return_errno_with_message!(Errno::EINVAL, "invalid cluster ranges.")
         }
 
-        for id in clusters {
-            if self.bitvec[(id - EXFAT_RESERVED_CLUSTERS) as usize] {
-                return Ok(false);
-            }
-        }
-        Ok(true)
+        let bits = (clusters.start - EXFAT_RESERVED_CLUSTERS) as usize
+            ..(clusters.end - EXFAT_RESERVED_CLUSTERS) as usize;
+        Ok(self.bitvec[bits].not_any())
     }
 
     /// Return the first unused cluster.
     pub(super) fn find_next_unused_cluster(&self, cluster: ClusterID) -> Result<ClusterID> {
-        let clusters = self.find_next_unused_cluster_range_by_bits(cluster, 1)?;
+        let clusters = self.find_next_unused_cluster_range(cluster, 1)?;
         Ok(clusters.start)
     }
 
-    /// Return the first unused cluster range, set num_clusters=1 to find a single cluster.
-    fn find_next_unused_cluster_range_by_bits(
+    /// Return the next contiguous unused clusters, set cluster_num=1 to find a single cluster
+    pub(super) fn find_next_unused_cluster_range(
         &self,
         search_start_cluster: ClusterID,
         num_clusters: u32,
     ) -> Result<Range<ClusterID>> {
-        if !self
-            .fs()
-            .is_cluster_range_valid(search_start_cluster..search_start_cluster + num_clusters)
-        {
-            return_errno_with_message!(Errno::ENOSPC, "free contigous clusters not avalable.")
-        }
-
-        let mut cur_index = search_start_cluster - EXFAT_RESERVED_CLUSTERS;
-        let end_index = self.fs().super_block().num_clusters - EXFAT_RESERVED_CLUSTERS;
-        let search_end_index = end_index - num_clusters + 1;
-        let mut range_start_index: ClusterID;
-
-        while cur_index < search_end_index {
-            if !self.is_used(cur_index as usize) {
-                range_start_index = cur_index;
-                let mut cnt = 0;
-                while cnt < num_clusters
-                    && cur_index < end_index
-                    && !self.is_used(cur_index as usize)
-                {
-                    cnt += 1;
-                    cur_index += 1;
-                }
-                if cnt >= num_clusters {
-                    return Ok(range_start_index + EXFAT_RESERVED_CLUSTERS
-                        ..range_start_index + EXFAT_RESERVED_CLUSTERS + num_clusters);
-                }
-            }
-            cur_index += 1;
-        }
-        return_errno!(Errno::ENOSPC)
-    }
-
-    /// Make sure the bit at the range start position is 0.
-    fn adjust_head_pos(
-        &self,
-        bytes: &[BitStore],
-        mut cur_unit_index: u32,
-        mut cur_unit_offset: u32,
-        total_cluster_num: u32,
-    ) -> (u32, u32) {
-        let unit_size: u32 = (BITS_PER_BYTE * core::mem::size_of::<BitStore>()) as u32;
-        while cur_unit_index < total_cluster_num {
-            let leading_zeros = bytes[cur_unit_index as usize].leading_zeros();
-            let head_cluster_num = unit_size - cur_unit_offset;
-            if leading_zeros == 0 {
-                // Fall over to the next unit, we need to continue checking.
-                cur_unit_index += 1;
-                cur_unit_offset = 0;
-            } else {
-                // Stop at current unit, we may need to adjust the cur_offset
-                cur_unit_offset = cur_unit_offset.max(unit_size - leading_zeros);
-                break;
-            }
-        }
-        (cur_unit_index, cur_unit_offset)
-    }
-
-    /// Check if the next mid_unit_num units are zero.
-    /// If not, return the index of the first not zero unit.
-    fn check_mid_units(&self, bytes: &[BitStore], cur_unit_index: u32, mid_unit_num: u32) -> u32 {
-        for i in 1..mid_unit_num + 1 {
-            if bytes[(cur_unit_index + i) as usize] != 0 {
-                return cur_unit_index + 1;
-            }
-        }
-        cur_unit_index
-    }
-
-    /// Check if the tail unit is valid.
-    /// Currently not used.
-    fn check_tail_bits(
-        &self,
-        bytes: &[BitStore],
-        tail_idx: u32,
-        tail_cluster_num: u32,
-        complete_unit_num: u32,
-        rest_cluster_num: u32,
-    ) -> bool {
-        let valid_bytes_num = if rest_cluster_num > 0 {
-            complete_unit_num + 1
-        } else {
-            complete_unit_num
-        };
-        let mut tail_byte: u8 = 0;
-        if tail_idx == complete_unit_num {
-            tail_byte |= 0xFF_u8 - ((1_u8 << rest_cluster_num) - 1);
-        }
-        if tail_idx < valid_bytes_num {
-            tail_byte |= bytes[tail_idx as usize];
-        }
-        let tailing_zeros = tail_byte.trailing_zeros();
-        tailing_zeros >= tail_cluster_num
+        self.find_unused_clusters(search_start_cluster, num_clusters, num_clusters)
     }
 
-    fn make_range(
+    /// Return the first run of contiguous unused clusters, which has at most `max_clusters` clusters.
+    pub(super) fn find_next_unused_cluster_run(
         &self,
-        cur_unit_index: u32,
-        cur_unit_offset: u32,
-        num_clusters: u32,
-    ) -> Range<ClusterID> {
-        let unit_size: u32 = (BITS_PER_BYTE * core::mem::size_of::<BitStore>()) as u32;
-        let result_bit_index = cur_unit_index * unit_size + cur_unit_offset;
-        result_bit_index + EXFAT_RESERVED_CLUSTERS
-            ..result_bit_index + EXFAT_RESERVED_CLUSTERS + num_clusters
+        search_start_cluster: ClusterID,
+        max_clusters: u32,
+    ) -> Result<Range<ClusterID>> {
+        self.find_unused_clusters(search_start_cluster, 1, max_clusters)
     }
 
-    /// Return the next contiguous unused clusters, set cluster_num=1 to find a single cluster
-    pub(super) fn find_next_unused_cluster_range(
+    fn find_unused_clusters(
         &self,
         search_start_cluster: ClusterID,
-        num_clusters: u32,
+        min_clusters: u32,
+        max_clusters: u32,
     ) -> Result<Range<ClusterID>> {
         if !self
             .fs()
-            .is_cluster_range_valid(search_start_cluster..search_start_cluster + num_clusters)
+            .is_cluster_range_valid(search_start_cluster..search_start_cluster + min_clusters)
         {
-            return_errno!(Errno::ENOSPC)
+            return_errno_with_message!(Errno::ENOSPC, "free contigous clusters not avalable.")
         }
 
-        let bytes: &[BitStore] = self.bitvec.as_raw_slice();
-        let unit_size: u32 = (BITS_PER_BYTE * core::mem::size_of::<BitStore>()) as u32;
-        let start_cluster_index = search_start_cluster - EXFAT_RESERVED_CLUSTERS;
-        let mut cur_unit_index = start_cluster_index / unit_size;
-        let mut cur_unit_offset = start_cluster_index % unit_size;
-        let total_cluster_num = self.fs().super_block().num_clusters - EXFAT_RESERVED_CLUSTERS;
-        let complete_unit_num = total_cluster_num / unit_size;
-        let rest_cluster_num = total_cluster_num % unit_size;
-        let valid_bytes_num = if rest_cluster_num > 0 {
-            complete_unit_num + 1
-        } else {
-            complete_unit_num
+        let start_bit = (search_start_cluster - EXFAT_RESERVED_CLUSTERS) as usize;
+        let Some(bits) =
+            self.find_unused_bits(start_bit, min_clusters as usize, max_clusters as usize)
+        else {
+            return_errno!(Errno::ENOSPC)
         };
-        if num_clusters <= unit_size {
-            // If this case, back to the simple function
-            return self.find_next_unused_cluster_range_by_bits(search_start_cluster, num_clusters);
-        }
-        // Treat a continuous bit chunk as lead_bits+mid_units+tail_bits (mid_units are unit aligned)
-        // For example: 11110000 00000000 00000000 00111111
-        //                  **** -------- -------- ..
-        //                  ^(start bit)
-        // (*): head_bits;  (-): mid_units;  (.): tail_bits
-        // The start bit can be identified with a pair (cur_unit_index, cur_unit_offset)
-        while cur_unit_index < complete_unit_num {
-            // First, adjust the cur_idx to a proper head.
-            (cur_unit_index, cur_unit_offset) =
-                self.adjust_head_pos(bytes, cur_unit_index, cur_unit_offset, total_cluster_num);
-            let head_cluster_num = unit_size - cur_unit_offset;
-            let mid_unit_num = (num_clusters - head_cluster_num) / unit_size;
-            let tail_cluster_num = (num_clusters - head_cluster_num) % unit_size;
-            // If the last complete unit to be check is out of range, stop searching
-            if cur_unit_index + mid_unit_num >= complete_unit_num {
-                break;
+        Ok(bits.start as ClusterID + EXFAT_RESERVED_CLUSTERS
+            ..bits.end as ClusterID + EXFAT_RESERVED_CLUSTERS)
+    }
+
+    /// Finds the first run of unused bits from `start_bit`, which has at least `min_len` bits.
+    /// The run is truncated to `max_len` bits.
+    fn find_unused_bits(
+        &self,
+        start_bit: usize,
+        min_len: usize,
+        max_len: usize,
+    ) -> Option<Range<usize>> {
+        let end_bit = (self.fs().super_block().num_clusters - EXFAT_RESERVED_CLUSTERS) as usize;
+        let mut run_start = start_bit;
+        let mut bit = start_bit;
+
+        while bit < end_bit {
+            let (word, num_bits) = self.load_word(bit, end_bit);
+
+            let num_unused = word.trailing_zeros() as usize;
+            bit += num_unused;
+            if bit - run_start >= max_len {
+                return Some(run_start..run_start + max_len);
             }
-            // Then check for the mid units, these units should be all zero
-            // Due to previous check, there will be no array out of bounds situation
-            let ret = self.check_mid_units(bytes, cur_unit_index, mid_unit_num);
-            if ret != cur_unit_index {
-                // Mid_checks failed, should go back to the first step.
-                cur_unit_index = ret;
-                cur_unit_offset = 0;
+            if num_unused == num_bits {
                 continue;
             }
-            // At last, check for the tail bits
-            if tail_cluster_num == 0 {
-                return Ok(self.make_range(cur_unit_index, cur_unit_offset, num_clusters));
-            }
-            let mut tail_byte: u8 = 0;
-            let tail_idx = cur_unit_index + mid_unit_num + 1;
-            if tail_idx == complete_unit_num {
-                tail_byte |= 0xFF_u8 - ((1_u8 << rest_cluster_num) - 1);
-            }
-            if tail_idx < valid_bytes_num {
-                tail_byte |= bytes[tail_idx as usize];
-            }
-            let tailing_zeros = tail_byte.trailing_zeros();
-            if tail_cluster_num > tailing_zeros {
-                cur_unit_index = tail_idx;
-                cur_unit_offset = tailing_zeros + 1;
-                continue;
+
+            // A used bit is found, so the run ends here.
+            if bit - run_start >= min_len {
+                return Some(run_start..bit);
             }
-            // If we reach here, it means we have found a result
-            return Ok(self.make_range(cur_unit_index, cur_unit_offset, num_clusters));
+            // The bits past the valid ones are padded with ones, which must not be skipped.
+            let num_used =
+                ((word >> num_unused).trailing_ones() as usize).min(num_bits - num_unused);
+            bit += num_used;
+            run_start = bit;
         }
-        return_errno!(Errno::ENOSPC)
+
+        (run_start < end_bit && end_bit - run_start >= min_len).then(|| run_start..end_bit)
+    }
+
+    /// Loads at most a word of bits from `bit`, returning the bits and the number of valid bits.
+    ///
+    /// The bits beyond `end_bit` are treated as used.
+    fn load_word(&self, bit: usize, end_bit: usize) -> (u64, usize) {
+        let bytes: &[BitStore] = self.bitvec.as_raw_slice();
+        let byte_idx = bit / BITS_PER_BYTE;
+        let num_bytes = (bytes.len() - byte_idx).min(size_of::<u64>());
+
+        let mut word_bytes = [BitStore::MAX; size_of::<u64>()];
+        word_bytes[..num_bytes].copy_from_slice(&bytes[byte_idx..byte_idx + num_bytes]);
+
+        let shift = bit % BITS_PER_BYTE;
+        let num_bits = (BITS_PER_WORD - shift).min(end_bit - bit);
+        let mut word = u64::from_le_bytes(word_bytes) >> shift;
+        if num_bits < BITS_PER_WORD {
+            word |= u64::MAX << num_bits;
+        }
+        (word, num_bits)
     }
 
     pub(super) fn num_free_clusters(&self) -> u32 {
@@ -336,17 +237,15 @@ impl ExfatBitmap {
             return_errno_with_message!(Errno::EINVAL, "invalid cluster ranges.")
         }
 
-        for cluster_id in clusters.clone() {
-            let index = (cluster_id - EXFAT_RESERVED_CLUSTERS) as usize;
-            let old_bit = self.is_used(index);
-            self.bitvec.set(index, bit);
-
-            if !old_bit && bit {
-                self.num_free_cluster -= 1;
-            } else if old_bit && !bit {
-                self.num_free_cluster += 1;
-            }
+        let bits = &mut self.bitvec[(clusters.start - EXFAT_RESERVED_CLUSTERS) as usize
+            ..(clusters.end - EXFAT_RESERVED_CLUSTERS) as usize];
+        let num_used = bits.count_ones() as u32;
+        if bit {
+            self.num_free_cluster -= bits.len() as u32 - num_used;
+        } else {
+            self.num_free_cluster += num_used;
         }
+        bits.fill(bit);
 
         self.write_to_disk(clusters.clone(), sync)?;
 
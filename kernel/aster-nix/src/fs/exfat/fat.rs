@@ -224,6 +224,7 @@ impl ExfatChain {
     }
 
     // Allocate clusters in fat mode, return the first allocated cluster id. Bitmap need to be already locked.
+    // The clusters are allocated run by run, so that the chain is as contiguous as possible.
     fn alloc_cluster_fat(
         &mut self,
         num_to_be_allocated: u32,
@@ -231,21 +232,34 @@ impl ExfatChain {
         bitmap: &mut MutexGuard<ExfatBitmap>,
     ) -> Result<ClusterID> {
         let fs = self.fs();
-        let mut alloc_start_cluster = 0;
+        let mut alloc_start_cluster = None;
         let mut prev_cluster = 0;
-        let mut cur_cluster = EXFAT_FIRST_CLUSTER;
-        for i in 0..num_to_be_allocated {
-            cur_cluster = bitmap.find_next_unused_cluster(cur_cluster)?;
-            bitmap.set_used(cur_cluster, sync)?;
-
-            if i == 0 {
-                alloc_start_cluster = cur_cluster;
+        let mut search_start_cluster = EXFAT_FIRST_CLUSTER;
+        let mut num_allocated = 0;
+        while num_allocated < num_to_be_allocated {
+            let run = bitmap.find_next_unused_cluster_run(
+                search_start_cluster,
+                num_to_be_allocated - num_allocated,
+            )?;
+            bitmap.set_range_used(run.clone(), sync)?;
+
+            if alloc_start_cluster.is_none() {
+                alloc_start_cluster = Some(run.start);
             } else {
-                fs.write_next_fat(prev_cluster, FatValue::Next(cur_cluster), sync)?;
+                fs.write_next_fat(prev_cluster, FatValue::Next(run.start), sync)?;
+            }
+            for cluster in run.start..run.end - 1 {
+                fs.write_next_fat(cluster, FatValue::Next(cluster + 1), sync)?;
             }
 
-            prev_cluster = cur_cluster;
+            prev_cluster = run.end - 1;
+            num_allocated += run.len() as u32;
+            search_start_cluster = run.end;
         }
+
+        let Some(alloc_start_cluster) = alloc_start_cluster else {
+            return_errno_with_message!(Errno::EINVAL, "no clusters to be allocated")
+        };
         fs.write_next_fat(prev_cluster, FatValue::EndOfChain, sync)?;
         Ok(alloc_start_cluster)
     }
@@ -282,6 +296,101 @@ impl ExfatChain {
     }
 }
 
+/// A cache of the runs of physically contiguous clusters in a chain.
+///
+/// The cache maps the logical clusters of a chain to the physical ones without walking
+/// the FAT chain again. The runs are filled in the order of the logical clusters, so the
+/// whole chain is walked at most once.
+#[derive(Debug, Default)]
+pub(super) struct ClusterRunCache {
+    runs: Vec<ClusterRun>,
+}
+
+#[derive(Debug, Clone, Copy)]
+struct ClusterRun {
+    logical: u32,
+    physical: ClusterID,
+    len: u32,
+}
+
+impl ClusterRun {
+    fn logical_end(&self) -> u32 {
+        self.logical + self.len
+    }
+}
+
+impl ClusterRunCache {
+    /// Gets the physical cluster of the logical cluster in the chain.
+    pub(super) fn physical_cluster(
+        &mut self,
+        chain: &ExfatChain,
+        logical: u32,
+    ) -> Result<ClusterID> {
+        if logical >= chain.num_clusters() {
+            return_errno_with_message!(Errno::EINVAL, "invalid logical cluster for FAT chain")
+        }
+        if !chain.fat_in_use() {
+            return Ok(chain.cluster_id() + logical);
+        }
+
+        let idx = self
+            .runs
+            .partition_point(|run| run.logical_end() <= logical);
+        if let Some(run) = self.runs.get(idx) {
+            return Ok(run.physical + (logical - run.logical));
+        }
+
+        self.fill_until(chain, logical)?;
+        let run = self.runs.last().unwrap();
+        Ok(run.physical + (logical - run.logical))
+    }
+
+    /// Walks the FAT chain from the end of the cached runs until the logical cluster is cached.
+    fn fill_until(&mut self, chain: &ExfatChain, logical: u32) -> Result<()> {
+        let fs = chain.fs();
+        let Some(mut last_run) = self.runs.pop() else {
+            self.runs.push(ClusterRun {
+                logical: 0,
+                physical: chain.cluster_id(),
+                len: 1,
+            });
+            return self.fill_until(chain, logical);
+        };
+
+        while last_run.logical_end() <= logical {
+            let tail = last_run.physical + last_run.len - 1;
+            let next = match fs.read_next_fat(tail)? {
+                FatValue::Next(next) => next,
+                _ => return_errno_with_message!(Errno::EIO, "invalid access to FAT cluster"),
+            };
+            if next == tail + 1 {
+                last_run.len += 1;
+            } else {
+                let logical_end = last_run.logical_end();
+                self.runs.push(last_run);
+                last_run = ClusterRun {
+                    logical: logical_end,
+                    physical: next,
+                    len: 1,
+                };
+            }
+        }
+        self.runs.push(last_run);
+        Ok(())
+    }
+
+    /// Drops the cached runs beyond the first `num_clusters` logical clusters.
+    ///
+    /// This must be called when the chain is truncated. Appending clusters to the chain
+    /// keeps the cached runs valid.
+    pub(super) fn truncate(&mut self, num_clusters: u32) {
+        self.runs.retain(|run| run.logical < num_clusters);
+        if let Some(run) = self.runs.last_mut() {
+            run.len = run.len.min(num_clusters - run.logical);
+        }
+    }
+}
+
 pub trait ClusterAllocator {
     fn extend_clusters(&mut self, num_to_be_allocated: u32, sync: bool) -> Result<ClusterID>;
     fn remove_clusters_from_tail(&mut self, free_num: u32, sync: bool) -> Result<()>;
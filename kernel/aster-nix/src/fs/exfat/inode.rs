@@ -21,7 +21,7 @@ use super::{
         Checksum, ExfatDentry, ExfatDentrySet, ExfatFileDentry, ExfatName, RawExfatDentry,
         DENTRY_SIZE,
     },
-    fat::{ClusterAllocator, ClusterID, ExfatChainPosition, FatChainFlags},
+    fat::{ClusterAllocator, ClusterID, ClusterRunCache, ExfatChainPosition, FatChainFlags},
     fs::{ExfatMountOptions, EXFAT_ROOT_INO},
     utils::{make_hash_index, DosTimestamp},
 };
@@ -31,8 +31,8 @@ use crate::{
         device::Device,
         exfat::{dentry::ExfatDentryIterator, fat::ExfatChain, fs::ExfatFS},
         utils::{
-            DirentVisitor, Inode, InodeMode, InodeType, IoctlCmd, Metadata, PageCache,
-            PageCacheBackend,
+            DirentVisitor, FileAdvice, Inode, InodeMode, InodeType, IoctlCmd, Metadata, PageCache,
+            PageCacheBackend, PageCachePrefetch,
         },
     },
     prelude::*,
@@ -99,6 +99,8 @@ struct ExfatInodeInner {
 
     /// Start position on disk, this is undefined if the allocated size is 0.
     start_chain: ExfatChain,
+    /// The cached runs of the clusters in `start_chain`.
+    cluster_cache: Mutex<ClusterRunCache>,
 
     /// Valid size of the file.
     size: usize,
@@ -189,22 +191,18 @@ impl ExfatInodeInner {
 
     /// Get physical sector id from logical sector id fot this Inode.
     fn get_sector_id(&self, sector_id: usize) -> Result<usize> {
-        let chain_offset = self
-            .start_chain
-            .walk_to_cluster_at_offset(sector_id * self.fs().sector_size())?;
-
         let sect_per_cluster = self.fs().super_block().sect_per_cluster as usize;
-        let cluster_id = sector_id / sect_per_cluster;
         let cluster = self.get_physical_cluster((sector_id / sect_per_cluster) as ClusterID)?;
 
-        let sec_offset = sector_id % (self.fs().super_block().sect_per_cluster as usize);
+        let sec_offset = sector_id % sect_per_cluster;
         Ok(self.fs().cluster_to_off(cluster) / self.fs().sector_size() + sec_offset)
     }
 
     /// Get the physical cluster id from the logical cluster id in the inode.
     fn get_physical_cluster(&self, logical: ClusterID) -> Result<ClusterID> {
-        let chain = self.start_chain.walk(logical)?;
-        Ok(chain.cluster_id())
+        self.cluster_cache
+            .lock()
+            .physical_cluster(&self.start_chain, logical)
     }
 
     /// The number of clusters allocated.
@@ -274,6 +272,7 @@ impl ExfatInodeInner {
                 // Some exist clusters should be truncated.
                 self.start_chain
                     .remove_clusters_from_tail(num_clusters - new_num_clusters, sync)?;
+                self.cluster_cache.lock().truncate(new_num_clusters);
                 if new_size < self.size {
                     // Valid data is truncated.
                     self.size = new_size;
@@ -564,7 +563,9 @@ impl ExfatInodeInner {
     fn free_all_clusters(&mut self, fs_guard: &MutexGuard<()>) -> Result<()> {
         let num_clusters = self.num_clusters();
         self.start_chain
-            .remove_clusters_from_tail(num_clusters, self.is_sync())
+            .remove_clusters_from_tail(num_clusters, self.is_sync())?;
+        self.cluster_cache.lock().truncate(0);
+        Ok(())
     }
 
     fn sync_metadata(&self, fs_guard: &MutexGuard<()>) -> Result<()> {
@@ -654,6 +655,7 @@ impl ExfatInode {
                 inode_type,
                 attr,
                 start_chain: root_chain,
+                cluster_cache: Mutex::new(ClusterRunCache::default()),
                 size,
                 size_allocated: size,
                 atime: ctime,
@@ -763,6 +765,7 @@ impl ExfatInode {
                 inode_type,
                 attr,
                 start_chain,
+                cluster_cache: Mutex::new(ClusterRunCache::default()),
                 size,
                 size_allocated,
                 atime,
@@ -1218,6 +1221,26 @@ impl Inode for ExfatInode {
         Some(self.inner.read().page_cache.pages().dup())
     }
 
+    fn prefetch(&self, offset: usize, len: usize) -> Result<Option<PageCachePrefetch>> {
+        let inner = self.inner.read();
+        if inner.inode_type.is_directory() {
+            return Ok(None);
+        }
+        let start = inner.size.min(offset);
+        let end = inner.size.min(offset.saturating_add(len));
+        inner.page_cache.prefetch(start..end)
+    }
+
+    fn advise(&self, offset: usize, len: usize, advice: FileAdvice) -> Result<()> {
+        let inner = self.inner.read();
+        if inner.inode_type.is_directory() {
+            return Ok(());
+        }
+        inner
+            .page_cache
+            .advise(offset..offset.saturating_add(len), advice)
+    }
+
     fn read_at(&self, offset: usize, buf: &mut [u8]) -> Result<usize> {
         let inner = self.inner.upread();
         if inner.inode_type.is_directory() {
@@ -884,6 +884,57 @@ mod test {
         }
     }
 
+    #[ktest]
+    fn bitmap_find_run() {
+        let fs = load_exfat();
+        let bitmap_binding = fs.bitmap();
+        let mut bitmap = bitmap_binding.lock();
+
+        let range = bitmap
+            .find_next_unused_cluster_range(EXFAT_RESERVED_CLUSTERS, 100)
+            .unwrap();
+        // Split the free range into a run of 30 clusters and a run of 69 clusters.
+        bitmap.set_used(range.start + 30, true).unwrap();
+
+        let run = bitmap
+            .find_next_unused_cluster_run(range.start, 50)
+            .unwrap();
+        assert_eq!(run, range.start..range.start + 30);
+        let run = bitmap
+            .find_next_unused_cluster_run(range.start, 20)
+            .unwrap();
+        assert_eq!(run, range.start..range.start + 20);
+        let chunk = bitmap
+            .find_next_unused_cluster_range(range.start, 50)
+            .unwrap();
+        assert_eq!(chunk, range.start + 31..range.start + 81);
+
+        bitmap.set_unused(range.start + 30, true).unwrap();
+    }
+
+    #[ktest]
+    fn bitmap_find_across_word() {
+        let fs = load_exfat();
+        let bitmap_binding = fs.bitmap();
+        let mut bitmap = bitmap_binding.lock();
+
+        let range = bitmap
+            .find_next_unused_cluster_range(EXFAT_RESERVED_CLUSTERS, 200)
+            .unwrap();
+        // Let the bits start at a byte boundary, so a scan from bit 3 loads a partial word.
+        let base =
+            (range.start - EXFAT_RESERVED_CLUSTERS).next_multiple_of(8) + EXFAT_RESERVED_CLUSTERS;
+        // Leave only bit 66 unused in bits 3..80.
+        bitmap.set_range_used(base + 3..base + 66, true).unwrap();
+        bitmap.set_range_used(base + 67..base + 80, true).unwrap();
+
+        let cluster = bitmap.find_next_unused_cluster(base + 3).unwrap();
+        assert_eq!(cluster, base + 66);
+
+        bitmap.set_range_unused(base + 3..base + 66, true).unwrap();
+        bitmap.set_range_unused(base + 67..base + 80, true).unwrap();
+    }
+
     #[ktest]
     fn resize_single_file() {
         let fs = load_exfat();
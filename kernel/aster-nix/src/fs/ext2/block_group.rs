@@ -171,7 +171,10 @@ impl BlockGroup {
         assert!(inner.metadata.is_inode_allocated(inode_idx));
 
         inner.metadata.free_inode(inode_idx, is_dir);
-        inner.inode_cache.remove(&inode_idx);
+        let removed_inode = inner.inode_cache.remove(&inode_idx);
+        // Dropping the inode may free its preallocated blocks, which locks this group.
+        drop(inner);
+        drop(removed_inode);
     }
 
     /// Allocates and returns a consecutive range of block indices.
@@ -190,6 +193,35 @@ impl BlockGroup {
         self.bg_impl.inner.write().metadata.alloc_blocks(count)
     }
 
+    /// Allocates and returns a consecutive range of block indices starting at `start_idx`.
+    ///
+    /// Returns `None` if the block at `start_idx` is unavailable.
+    ///
+    /// The actual allocated range size may be smaller than the requested `count` if
+    /// some of the following blocks have been allocated.
+    pub fn alloc_blocks_at(&self, start_idx: Ext2Bid, count: Ext2Bid) -> Option<Range<Ext2Bid>> {
+        let end_idx = start_idx
+            .saturating_add(count)
+            .min(self.fs().blocks_per_group());
+        if start_idx >= end_idx {
+            return None;
+        }
+
+        // The fast path
+        let inner = self.bg_impl.inner.read();
+        if inner.metadata.free_blocks_count() == 0 || inner.metadata.is_block_allocated(start_idx) {
+            return None;
+        }
+        drop(inner);
+
+        // The slow path
+        self.bg_impl
+            .inner
+            .write()
+            .metadata
+            .alloc_blocks_in(start_idx..end_idx)
+    }
+
     /// Frees the consecutive range of allocated block indices.
     ///
     /// # Panics
@@ -217,40 +249,67 @@ impl BlockGroup {
             .unwrap();
     }
 
+    /// Returns the number of free inodes in this group.
+    pub fn free_inodes_count(&self) -> u16 {
+        self.bg_impl.inner.read().metadata.free_inodes_count()
+    }
+
+    /// Returns the number of free blocks in this group.
+    pub fn free_blocks_count(&self) -> u16 {
+        self.bg_impl.inner.read().metadata.free_blocks_count()
+    }
+
+    /// Returns the number of directories in this group.
+    pub fn dirs_count(&self) -> u16 {
+        self.bg_impl.inner.read().metadata.descriptor.dirs_count
+    }
+
     /// Writes back the metadata of this group.
-    pub fn sync_metadata(&self) -> Result<()> {
+    ///
+    /// The bios of the bitmaps are submitted to the `plug`, so that the caller can
+    /// batch the writebacks of multiple groups. Returns the waiter of the bios, or
+    /// `None` if the metadata is clean.
+    ///
+    /// The metadata is considered clean once the bios are submitted, since the bitmaps
+    /// are copied into the bios. If the bios fail, the caller should call
+    /// [`Self::set_metadata_dirty`] so that the metadata is written back again.
+    pub fn sync_metadata(&self, plug: &mut BioPlug) -> Result<Option<BioWaiter>> {
         if !self.bg_impl.inner.read().metadata.is_dirty() {
-            return Ok(());
+            return Ok(None);
         }
 
         let mut inner = self.bg_impl.inner.write();
+        if !inner.metadata.is_dirty() {
+            return Ok(None);
+        }
+
         let fs = self.fs();
         // Writes back the descriptor.
         let raw_descriptor = RawGroupDescriptor::from(&inner.metadata.descriptor);
-        self.fs().sync_group_descriptor(self.idx, &raw_descriptor)?;
+        fs.sync_group_descriptor(self.idx, &raw_descriptor)?;
 
         let mut bio_waiter = BioWaiter::new();
         // Writes back the inode bitmap.
         let inode_bitmap_bid = Bid::new(inner.metadata.descriptor.inode_bitmap_bid as u64);
-        bio_waiter.concat(fs.block_device().write_bytes_async(
+        bio_waiter.concat(plug.write_bytes(
             inode_bitmap_bid.to_offset(),
             inner.metadata.inode_bitmap.as_bytes(),
         )?);
 
         // Writes back the block bitmap.
         let block_bitmap_bid = Bid::new(inner.metadata.descriptor.block_bitmap_bid as u64);
-        bio_waiter.concat(fs.block_device().write_bytes_async(
+        bio_waiter.concat(plug.write_bytes(
             block_bitmap_bid.to_offset(),
             inner.metadata.block_bitmap.as_bytes(),
         )?);
 
-        // Waits for the completion of all submitted bios.
-        bio_waiter.wait().ok_or_else(|| {
-            Error::with_message(Errno::EIO, "failed to sync metadata of block group")
-        })?;
-
         inner.metadata.clear_dirty();
-        Ok(())
+        Ok(Some(bio_waiter))
+    }
+
+    /// Marks the metadata of this group as dirty.
+    pub fn set_metadata_dirty(&self) {
+        self.bg_impl.inner.write().metadata.set_dirty();
     }
 
     /// Writes back all of the cached inodes.
@@ -289,9 +348,11 @@ impl BlockGroup {
         drop(remaining_inodes);
 
         // Writes back the raw inode metadata.
+        //
+        // The dirty pages are written in runs of consecutive pages, instead of being
+        // decommitted and written one by one.
         self.raw_inodes_cache
-            .pages()
-            .decommit(0..self.bg_impl.raw_inodes_size)?;
+            .evict_range(0..self.bg_impl.raw_inodes_size)?;
         Ok(())
     }
 
@@ -328,6 +389,16 @@ impl PageCacheBackend for BlockGroupImpl {
         self.fs.upgrade().unwrap().write_block_async(bid, frame)
     }
 
+    fn read_pages(&self, idx: usize, frames: &[Frame]) -> Result<BioWaiter> {
+        let bid = self.inode_table_bid + idx as Ext2Bid;
+        self.fs.upgrade().unwrap().read_blocks_async(bid, frames)
+    }
+
+    fn write_pages(&self, idx: usize, frames: &[Frame]) -> Result<BioWaiter> {
+        let bid = self.inode_table_bid + idx as Ext2Bid;
+        self.fs.upgrade().unwrap().write_blocks_async(bid, frames)
+    }
+
     fn npages(&self) -> usize {
         self.raw_inodes_size.div_ceil(BLOCK_SIZE)
     }
@@ -386,6 +457,23 @@ impl GroupMetadata {
         None
     }
 
+    /// Allocates the free blocks at the beginning of the `range`.
+    pub fn alloc_blocks_in(&mut self, range: Range<Ext2Bid>) -> Option<Range<Ext2Bid>> {
+        let end = range
+            .clone()
+            .find(|idx| self.is_block_allocated(*idx))
+            .unwrap_or(range.end);
+        if end == range.start {
+            return None;
+        }
+
+        for idx in range.start..end {
+            self.block_bitmap.alloc_specific(idx as usize).unwrap();
+        }
+        self.dec_free_blocks((end - range.start) as u16);
+        Some(range.start..end)
+    }
+
     pub fn free_blocks(&mut self, range: Range<Ext2Bid>) {
         self.block_bitmap
             .free_consecutive((range.start as usize)..(range.end as usize));
@@ -2,6 +2,8 @@
 
 #![allow(dead_code)]
 
+use core::sync::atomic::{AtomicUsize, Ordering};
+
 use super::{
     block_group::{BlockGroup, RawGroupDescriptor},
     block_ptr::Ext2Bid,
@@ -24,9 +26,37 @@ pub struct Ext2 {
     inode_size: usize,
     block_size: usize,
     group_descriptors_segment: Segment,
+    /// The group to start searching from for a new directory in the root directory.
+    dir_group_rotor: AtomicUsize,
+    /// The preallocation windows of the inodes.
+    prealloc_windows: Mutex<PreallocWindows>,
     self_ref: Weak<Self>,
 }
 
+/// The blocks that are preallocated for the inodes, but not yet used by them.
+///
+/// The blocks of the windows are marked as allocated in memory only, so that the
+/// other inodes do not allocate them. They are never written back to the device as
+/// allocated: all the windows are released before the metadata is written back.
+/// Since the windows can always be released, they are counted as free blocks.
+#[derive(Debug, Default)]
+struct PreallocWindows {
+    /// The windows indexed by the inode numbers, which are never empty.
+    windows: BTreeMap<u32, Range<Ext2Bid>>,
+    /// The total number of blocks in the windows.
+    nr_blocks: Ext2Bid,
+}
+
+impl PreallocWindows {
+    /// Frees the blocks of all the windows.
+    fn release_all(&mut self, fs: &Ext2) {
+        for (_, window) in core::mem::take(&mut self.windows) {
+            fs.free_blocks(window).unwrap();
+        }
+        self.nr_blocks = 0;
+    }
+}
+
 impl Ext2 {
     /// Opens and loads an Ext2 from the `block_device`.
     pub fn open(block_device: Arc<dyn BlockDevice>) -> Result<Arc<Self>> {
@@ -88,6 +118,8 @@ impl Ext2 {
             block_device,
             super_block: RwMutex::new(Dirty::new(super_block)),
             group_descriptors_segment,
+            dir_group_rotor: AtomicUsize::new(0),
+            prealloc_windows: Mutex::new(PreallocWindows::default()),
             self_ref: weak_ref.clone(),
         });
         Ok(ext2)
@@ -123,6 +155,12 @@ impl Ext2 {
         self.super_block.read()
     }
 
+    /// Returns the number of free blocks, including the preallocated ones.
+    pub fn free_blocks_count(&self) -> Ext2Bid {
+        let nr_prealloc_blocks = self.prealloc_windows.lock().nr_blocks;
+        self.super_block.read().free_blocks_count() + nr_prealloc_blocks
+    }
+
     /// Returns the root inode.
     pub fn root_inode(&self) -> Result<Arc<Inode>> {
         self.lookup_inode(ROOT_INO)
@@ -135,15 +173,21 @@ impl Ext2 {
         block_group.lookup_inode(inode_idx)
     }
 
-    /// Creates a new inode.
+    /// Creates a new inode in the directory of `dir_ino`.
     pub(super) fn create_inode(
         &self,
+        dir_ino: u32,
         dir_block_group_idx: usize,
         file_type: FileType,
         file_perm: FilePerm,
     ) -> Result<Arc<Inode>> {
-        let (block_group_idx, ino) =
-            self.alloc_ino(dir_block_group_idx, file_type == FileType::Dir)?;
+        let is_dir = file_type == FileType::Dir;
+        let block_group_idx = if is_dir {
+            self.find_group_for_dir(dir_ino, dir_block_group_idx)
+        } else {
+            dir_block_group_idx
+        };
+        let (block_group_idx, ino) = self.alloc_ino(block_group_idx, is_dir)?;
         let inode = {
             let inode_desc = InodeDesc::new(file_type, file_perm);
             Inode::new(ino, block_group_idx, inode_desc, self.self_ref.clone())
@@ -153,12 +197,66 @@ impl Ext2 {
         Ok(inode)
     }
 
+    /// Chooses the block group to allocate a new directory from (the Orlov allocator).
+    ///
+    /// The directories in the root directory are spread across the groups, so that the
+    /// unrelated directory trees, which are likely to be written in parallel, do not
+    /// contend for the same group. Such a directory goes to the group with the fewest
+    /// directories among the groups that have more free inodes and blocks than the average.
+    ///
+    /// The other directories stay close to their parents to keep the related files together,
+    /// unless the group of the parent is too full or already contains too many directories.
+    fn find_group_for_dir(&self, dir_ino: u32, dir_block_group_idx: usize) -> usize {
+        let nr_groups = self.block_groups.len();
+        let (avg_free_inodes, avg_free_blocks) = {
+            let super_block = self.super_block.read();
+            (
+                super_block.free_inodes_count() / nr_groups as u32,
+                super_block.free_blocks_count() / nr_groups as u32,
+            )
+        };
+
+        if dir_ino == ROOT_INO {
+            let start_idx = self.dir_group_rotor.fetch_add(1, Ordering::Relaxed) % nr_groups;
+            return (0..nr_groups)
+                .map(|i| (start_idx + i) % nr_groups)
+                .filter(|idx| {
+                    let block_group = &self.block_groups[*idx];
+                    block_group.free_inodes_count() as u32 >= avg_free_inodes.max(1)
+                        && block_group.free_blocks_count() as u32 >= avg_free_blocks
+                })
+                .min_by_key(|idx| self.block_groups[*idx].dirs_count())
+                .unwrap_or(dir_block_group_idx);
+        }
+
+        let max_dirs = {
+            let nr_dirs: u32 = self
+                .block_groups
+                .iter()
+                .map(|block_group| block_group.dirs_count() as u32)
+                .sum();
+            nr_dirs / nr_groups as u32 + self.inodes_per_group / 16
+        };
+        let min_free_inodes = avg_free_inodes
+            .saturating_sub(self.inodes_per_group / 4)
+            .max(1);
+        let min_free_blocks = avg_free_blocks.saturating_sub(self.blocks_per_group / 4);
+        (0..nr_groups)
+            .map(|i| (dir_block_group_idx + i) % nr_groups)
+            .find(|idx| {
+                let block_group = &self.block_groups[*idx];
+                (block_group.dirs_count() as u32) < max_dirs
+                    && block_group.free_inodes_count() as u32 >= min_free_inodes
+                    && block_group.free_blocks_count() as u32 >= min_free_blocks
+            })
+            .unwrap_or(dir_block_group_idx)
+    }
+
     /// Allocates a new inode number, internally used by `new_inode`.
     ///
-    /// Attempts to allocate from the `dir_block_group_idx` group first.
+    /// Attempts to allocate from the `block_group_idx` group first.
     /// If allocation is not possible from this group, then search the remaining groups.
-    fn alloc_ino(&self, dir_block_group_idx: usize, is_dir: bool) -> Result<(usize, u32)> {
-        let mut block_group_idx = dir_block_group_idx;
+    fn alloc_ino(&self, mut block_group_idx: usize, is_dir: bool) -> Result<(usize, u32)> {
         if block_group_idx >= self.block_groups.len() {
             return_errno_with_message!(Errno::EINVAL, "invalid block group idx");
         }
@@ -215,11 +313,29 @@ impl Ext2 {
     /// The returned allocated range size may be smaller than the requested `count` if
     /// insufficient consecutive blocks are available.
     ///
-    /// Attempts to allocate blocks from the `block_group_idx` group first.
-    /// If allocation is not possible from this group, then search the remaining groups.
+    /// Attempts to allocate blocks starting at the `goal` first, so that the blocks
+    /// of a file can be kept contiguous. If the `goal` is unavailable, attempts to
+    /// allocate blocks from the `block_group_idx` group, and then search the remaining
+    /// groups.
+    ///
+    /// If no block is available, the preallocation windows are released to make room.
     pub(super) fn alloc_blocks(
+        &self,
+        block_group_idx: usize,
+        goal: Option<Ext2Bid>,
+        count: Ext2Bid,
+    ) -> Option<Range<Ext2Bid>> {
+        self.alloc_blocks_near(block_group_idx, goal, count)
+            .or_else(|| {
+                self.release_all_prealloc_windows();
+                self.alloc_blocks_near(block_group_idx, goal, count)
+            })
+    }
+
+    fn alloc_blocks_near(
         &self,
         mut block_group_idx: usize,
+        goal: Option<Ext2Bid>,
         count: Ext2Bid,
     ) -> Option<Range<Ext2Bid>> {
         if count > self.super_block.read().free_blocks_count() {
@@ -237,27 +353,33 @@ impl Ext2 {
                 block_group_idx = 0;
             }
             let block_group = &self.block_groups[block_group_idx];
-            if let Some(range_in_group) = block_group.alloc_blocks(remaining_count) {
-                let device_range = {
-                    let start =
-                        (block_group_idx as Ext2Bid) * self.blocks_per_group + range_in_group.start;
-                    start..start + (range_in_group.len() as Ext2Bid)
-                };
-                match allocated_range {
-                    Some(ref mut range) => {
-                        if range.end == device_range.start {
-                            // Accumulate consecutive bids
-                            range.end = device_range.end;
-                            remaining_count -= range_in_group.len() as Ext2Bid;
-                        } else {
-                            block_group.free_blocks(range_in_group);
-                            break;
-                        }
-                    }
-                    None => {
-                        allocated_range = Some(device_range);
-                    }
+            let group_start_bid = (block_group_idx as Ext2Bid) * self.blocks_per_group;
+            let range_in_group = match allocated_range.as_ref() {
+                // Only the blocks at the start of this group can be accumulated.
+                Some(range) if range.end == group_start_bid => {
+                    block_group.alloc_blocks_at(0, remaining_count)
+                }
+                Some(_) => None,
+                None => goal
+                    .filter(|goal| (goal / self.blocks_per_group) as usize == block_group_idx)
+                    .and_then(|goal| {
+                        block_group.alloc_blocks_at(self.block_idx(goal), remaining_count)
+                    })
+                    .or_else(|| block_group.alloc_blocks(remaining_count)),
+            };
+            match (range_in_group, allocated_range.as_mut()) {
+                (Some(range_in_group), Some(range)) => {
+                    // Accumulate consecutive bids
+                    range.end += range_in_group.len() as Ext2Bid;
+                    remaining_count -= range_in_group.len() as Ext2Bid;
+                }
+                (Some(range_in_group), None) => {
+                    let start = group_start_bid + range_in_group.start;
+                    allocated_range = Some(start..start + (range_in_group.len() as Ext2Bid));
+                    remaining_count -= range_in_group.len() as Ext2Bid;
                 }
+                (None, Some(_)) => break,
+                (None, None) => {}
             }
             block_group_idx += 1;
         }
@@ -270,6 +392,61 @@ impl Ext2 {
         allocated_range
     }
 
+    /// Preallocates a window of `count` blocks for the inode, like [`Self::alloc_blocks`].
+    ///
+    /// The blocks can then be taken with [`Self::take_prealloc_blocks`]. Returns `false`
+    /// if the blocks are not available, in which case the windows of the other inodes
+    /// are kept.
+    ///
+    /// The old window of the inode must have been used up or discarded.
+    pub(super) fn prealloc_blocks(
+        &self,
+        ino: u32,
+        block_group_idx: usize,
+        goal: Option<Ext2Bid>,
+        count: Ext2Bid,
+    ) -> bool {
+        // The lock is held so that the window cannot be written back as allocated.
+        let mut prealloc_windows = self.prealloc_windows.lock();
+        debug_assert!(!prealloc_windows.windows.contains_key(&ino));
+        let Some(window) = self.alloc_blocks_near(block_group_idx, goal, count) else {
+            return false;
+        };
+        prealloc_windows.nr_blocks += window.len() as Ext2Bid;
+        prealloc_windows.windows.insert(ino, window);
+        true
+    }
+
+    /// Takes at most `count` blocks from the start of the preallocation window of the inode.
+    ///
+    /// Returns `None` if the inode has no window, e.g., if the window has been released.
+    pub(super) fn take_prealloc_blocks(&self, ino: u32, count: Ext2Bid) -> Option<Range<Ext2Bid>> {
+        let mut prealloc_windows = self.prealloc_windows.lock();
+        let window = prealloc_windows.windows.get_mut(&ino)?;
+        let cnt = count.min(window.len() as Ext2Bid);
+        let range = window.start..window.start + cnt;
+        window.start += cnt;
+        if window.is_empty() {
+            prealloc_windows.windows.remove(&ino);
+        }
+        prealloc_windows.nr_blocks -= cnt;
+        Some(range)
+    }
+
+    /// Frees the unused blocks in the preallocation window of the inode.
+    pub(super) fn discard_prealloc_blocks(&self, ino: u32) {
+        let mut prealloc_windows = self.prealloc_windows.lock();
+        if let Some(window) = prealloc_windows.windows.remove(&ino) {
+            prealloc_windows.nr_blocks -= window.len() as Ext2Bid;
+            self.free_blocks(window).unwrap();
+        }
+    }
+
+    /// Frees the unused blocks in all the preallocation windows.
+    fn release_all_prealloc_windows(&self) {
+        self.prealloc_windows.lock().release_all(self);
+    }
+
     /// Frees a range of blocks.
     pub(super) fn free_blocks(&self, range: Range<Ext2Bid>) -> Result<()> {
         let mut current_range = range.clone();
@@ -320,6 +497,19 @@ impl Ext2 {
         Ok(waiter)
     }
 
+    /// Reads contiguous blocks starting from the `bid` into the frames asynchronously.
+    ///
+    /// The bios of the blocks are merged into large requests.
+    pub(super) fn read_blocks_async(&self, bid: Ext2Bid, frames: &[Frame]) -> Result<BioWaiter> {
+        let mut plug = BioPlug::new(self.block_device.as_ref());
+        let mut waiter = BioWaiter::new();
+        for (i, frame) in frames.iter().enumerate() {
+            waiter.concat(plug.read_block(Bid::new((bid as usize + i) as u64), frame)?);
+        }
+        plug.flush();
+        Ok(waiter)
+    }
+
     /// Writes contiguous blocks starting from the `bid` synchronously.
     pub(super) fn write_blocks(&self, bid: Ext2Bid, segment: &Segment) -> Result<()> {
         let status = self
@@ -348,6 +538,19 @@ impl Ext2 {
         Ok(waiter)
     }
 
+    /// Writes contiguous blocks starting from the `bid` from the frames asynchronously.
+    ///
+    /// The bios of the blocks are merged into large requests.
+    pub(super) fn write_blocks_async(&self, bid: Ext2Bid, frames: &[Frame]) -> Result<BioWaiter> {
+        let mut plug = BioPlug::new(self.block_device.as_ref());
+        let mut waiter = BioWaiter::new();
+        for (i, frame) in frames.iter().enumerate() {
+            waiter.concat(plug.write_block(Bid::new((bid as usize + i) as u64), frame)?);
+        }
+        plug.flush();
+        Ok(waiter)
+    }
+
     /// Writes back the metadata to the block device.
     pub fn sync_metadata(&self) -> Result<()> {
         // If the superblock is clean, the block groups must be clean.
@@ -355,10 +558,45 @@ impl Ext2 {
             return Ok(());
         }
 
+        // The preallocated blocks must not be written back as allocated, so all the
+        // windows are released, and no window is created until the metadata is written.
+        let mut prealloc_windows = self.prealloc_windows.lock();
+        prealloc_windows.release_all(self);
+
         let mut super_block = self.super_block.write();
-        // Writes back the metadata of block groups
+        // Writes back the metadata of block groups.
+        //
+        // The bios of all the groups are submitted in a batch and waited together,
+        // so the I/O of different groups are not serialized.
+        let mut plug = BioPlug::new(self.block_device.as_ref());
+        let mut bio_waiter = BioWaiter::new();
+        let mut synced_groups = Vec::new();
+        let mut submit_result = Ok(());
         for block_group in &self.block_groups {
-            block_group.sync_metadata()?;
+            match block_group.sync_metadata(&mut plug) {
+                Ok(Some(waiter)) => {
+                    bio_waiter.concat(waiter);
+                    synced_groups.push(block_group);
+                }
+                Ok(None) => (),
+                Err(err) => {
+                    submit_result = Err(err);
+                    break;
+                }
+            }
+        }
+        plug.flush();
+        drop(plug);
+        // The groups are marked clean as their bios are submitted. If any group fails,
+        // the submitted groups are marked dirty again, so that none of them is lost.
+        let is_complete = bio_waiter.wait().is_some();
+        drop(bio_waiter);
+        if submit_result.is_err() || !is_complete {
+            for block_group in synced_groups {
+                block_group.set_metadata_dirty();
+            }
+            submit_result?;
+            return_errno_with_message!(Errno::EIO, "failed to sync metadata of block groups");
         }
 
         // Writes back the main superblock and group descriptor table.
@@ -378,24 +616,28 @@ impl Ext2 {
         drop(bio_waiter);
 
         // Writes back the backups of superblock and group descriptor table.
+        //
+        // The backups are written in a batch, so that the contiguous ones can be merged.
+        let mut plug = BioPlug::new(self.block_device.as_ref());
+        let mut bio_waiter = BioWaiter::new();
         let mut raw_super_block_backup = raw_super_block;
         for idx in 1..super_block.block_groups_count() {
             if super_block.is_backup_group(idx as usize) {
-                let mut bio_waiter = BioWaiter::new();
                 raw_super_block_backup.block_group_idx = idx as u16;
-                bio_waiter.concat(self.block_device.write_bytes_async(
+                bio_waiter.concat(plug.write_bytes(
                     super_block.bid(idx as usize).to_offset(),
                     raw_super_block_backup.as_bytes(),
                 )?);
-                bio_waiter.concat(self.block_device.write_blocks(
+                bio_waiter.concat(plug.write_blocks(
                     super_block.group_descriptors_bid(idx as usize),
                     &self.group_descriptors_segment,
                 )?);
-                bio_waiter.wait().ok_or_else(|| {
-                    Error::with_message(Errno::EIO, "failed to sync backup metadata")
-                })?;
             }
         }
+        plug.flush();
+        bio_waiter
+            .wait()
+            .ok_or_else(|| Error::with_message(Errno::EIO, "failed to sync backup metadata"))?;
 
         // Reset to clean.
         super_block.clear_dirty();
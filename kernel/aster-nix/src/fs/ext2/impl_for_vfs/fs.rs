@@ -22,7 +22,11 @@ impl FileSystem for Ext2 {
     }
 
     fn sb(&self) -> SuperBlock {
-        SuperBlock::from(self.super_block())
+        let mut sb = SuperBlock::from(self.super_block());
+        // The preallocated blocks are free on the device.
+        sb.bfree = self.free_blocks_count() as _;
+        sb.bavail = sb.bfree;
+        sb
     }
 
     fn flags(&self) -> FsFlags {
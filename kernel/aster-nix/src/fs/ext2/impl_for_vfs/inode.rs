@@ -10,7 +10,10 @@ use crate::{
     fs::{
         device::Device,
         ext2::{FilePerm, FileType, Inode as Ext2Inode},
-        utils::{DirentVisitor, FileSystem, Inode, InodeMode, InodeType, IoctlCmd, Metadata},
+        utils::{
+            DirentVisitor, FileAdvice, FileSystem, Inode, InodeMode, InodeType, IoctlCmd, Metadata,
+            PageCachePrefetch,
+        },
     },
     prelude::*,
     process::{Gid, Uid},
@@ -108,6 +111,14 @@ impl Inode for Ext2Inode {
         Some(self.page_cache())
     }
 
+    fn prefetch(&self, offset: usize, len: usize) -> Result<Option<PageCachePrefetch>> {
+        self.prefetch(offset, len)
+    }
+
+    fn advise(&self, offset: usize, len: usize, advice: FileAdvice) -> Result<()> {
+        self.advise(offset, len, advice)
+    }
+
     fn read_at(&self, offset: usize, buf: &mut [u8]) -> Result<usize> {
         self.read_at(offset, buf)
     }
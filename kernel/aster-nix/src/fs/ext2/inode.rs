@@ -4,6 +4,7 @@
 #![allow(unused_variables)]
 
 use alloc::rc::Rc;
+use core::ops::RangeInclusive;
 
 use inherit_methods_macro::inherit_methods;
 
@@ -23,6 +24,15 @@ pub const MAX_FNAME_LEN: usize = 255;
 /// Max path length of the fast symlink.
 pub const MAX_FAST_SYMLINK_LEN: usize = MAX_BLOCK_PTRS * BID_SIZE;
 
+/// The range of the number of blocks preallocated for a regular file each time.
+///
+/// The number grows with the size of the file, so that the small files do not
+/// hold many free blocks.
+const PREALLOC_WINDOW_BLOCKS: RangeInclusive<Ext2Bid> = 8..=256;
+
+/// Max number of blocks read or written by one round of direct I/O.
+const MAX_DIRECT_IO_BLOCKS: usize = 256;
+
 /// The Ext2 inode.
 pub struct Inode {
     ino: u32,
@@ -99,7 +109,7 @@ impl Inode {
 
         let inode = self
             .fs()
-            .create_inode(self.block_group_idx, file_type, file_perm)?;
+            .create_inode(self.ino, self.block_group_idx, file_type, file_perm)?;
         let is_dir = file_type == FileType::Dir;
         if let Err(e) = inode.init(self.ino) {
             self.fs().free_inode(inode.ino, is_dir).unwrap();
@@ -558,6 +568,25 @@ impl Inode {
         inner.read_at(offset, buf)
     }
 
+    pub fn prefetch(&self, offset: usize, len: usize) -> Result<Option<PageCachePrefetch>> {
+        let inner = self.inner.read();
+        if inner.file_type() != FileType::File {
+            return Ok(None);
+        }
+
+        inner.prefetch(offset, len)
+    }
+
+    pub fn advise(&self, offset: usize, len: usize, advice: FileAdvice) -> Result<()> {
+        let inner = self.inner.read();
+        if inner.file_type() != FileType::File {
+            return Ok(());
+        }
+
+        let end = offset.saturating_add(len);
+        inner.page_cache.advise(offset..end, advice)
+    }
+
     // The offset and the length of buffer must be multiples of the block size.
     pub fn read_direct_at(&self, offset: usize, buf: &mut [u8]) -> Result<usize> {
         let inner = self.inner.read();
@@ -662,6 +691,15 @@ impl Debug for Inode {
     }
 }
 
+impl Drop for Inode {
+    fn drop(&mut self) {
+        // The evicted inode no longer grows, so its preallocated blocks are released.
+        if let Some(fs) = self.fs.upgrade() {
+            fs.discard_prealloc_blocks(self.ino);
+        }
+    }
+}
+
 fn read_lock_two_inodes<'a>(
     this: &'a Inode,
     other: &'a Inode,
@@ -767,6 +805,13 @@ impl Inner {
         Ok(read_len)
     }
 
+    pub fn prefetch(&self, offset: usize, len: usize) -> Result<Option<PageCachePrefetch>> {
+        let file_size = self.inode_impl.file_size();
+        let start = file_size.min(offset);
+        let end = file_size.min(offset.saturating_add(len));
+        self.page_cache.prefetch(start..end)
+    }
+
     pub fn read_direct_at(&self, offset: usize, buf: &mut [u8]) -> Result<usize> {
         let (offset, read_len) = {
             let file_size = self.inode_impl.file_size();
@@ -776,16 +821,18 @@ impl Inner {
         };
         self.page_cache.discard_range(offset..offset + read_len);
 
+        // Reads the blocks in batches, each of which is mapped to a few contiguous
+        // runs on the device and read with a few large requests.
         let mut buf_offset = 0;
-        for bid in Bid::from_offset(offset)..Bid::from_offset(offset + read_len) {
-            let frame = FrameAllocOptions::new(1)
-                .uninit(true)
-                .alloc_single()
-                .unwrap();
-            self.inode_impl
-                .read_block_sync(bid.to_raw() as Ext2Bid, &frame)?;
-            frame.read_bytes(0, &mut buf[buf_offset..buf_offset + BLOCK_SIZE])?;
-            buf_offset += BLOCK_SIZE;
+        while buf_offset < read_len {
+            let nblocks = ((read_len - buf_offset) / BLOCK_SIZE).min(MAX_DIRECT_IO_BLOCKS);
+            let frames = alloc_frames(nblocks);
+            let bid = ((offset + buf_offset) / BLOCK_SIZE) as Ext2Bid;
+            self.inode_impl.read_blocks_sync(bid, &frames)?;
+            for frame in frames.iter() {
+                frame.read_bytes(0, &mut buf[buf_offset..buf_offset + BLOCK_SIZE])?;
+                buf_offset += BLOCK_SIZE;
+            }
         }
         Ok(read_len)
     }
@@ -816,19 +863,17 @@ impl Inner {
             self.inode_impl.resize(end_offset)?;
         }
 
+        // Writes the blocks in batches, in the same way as `read_direct_at`.
         let mut buf_offset = 0;
-        for bid in Bid::from_offset(offset)..Bid::from_offset(end_offset) {
-            let frame = {
-                let frame = FrameAllocOptions::new(1)
-                    .uninit(true)
-                    .alloc_single()
-                    .unwrap();
+        while buf_offset < buf.len() {
+            let nblocks = ((buf.len() - buf_offset) / BLOCK_SIZE).min(MAX_DIRECT_IO_BLOCKS);
+            let frames = alloc_frames(nblocks);
+            let bid = ((offset + buf_offset) / BLOCK_SIZE) as Ext2Bid;
+            for frame in frames.iter() {
                 frame.write_bytes(0, &buf[buf_offset..buf_offset + BLOCK_SIZE])?;
-                frame
-            };
-            self.inode_impl
-                .write_block_sync(bid.to_raw() as Ext2Bid, &frame)?;
-            buf_offset += BLOCK_SIZE;
+                buf_offset += BLOCK_SIZE;
+            }
+            self.inode_impl.write_blocks_sync(bid, &frames)?;
         }
 
         Ok(())
@@ -1010,6 +1055,83 @@ impl InodeImpl_ {
         }
     }
 
+    /// Reads consecutive blocks starting from the `bid` asynchronously.
+    ///
+    /// The blocks are mapped to contiguous runs on the device, and the bios of
+    /// each run are merged into large requests.
+    pub fn read_blocks_async(&self, bid: Ext2Bid, blocks: &[Frame]) -> Result<BioWaiter> {
+        let range = bid..bid + blocks.len() as Ext2Bid;
+        if range.end > self.desc.blocks_count() {
+            return_errno!(Errno::EINVAL);
+        }
+        if range.is_empty() {
+            return Ok(BioWaiter::new());
+        }
+
+        let fs = self.fs();
+        let mut plug = BioPlug::new(fs.block_device());
+        let mut waiter = BioWaiter::new();
+        let mut blocks = range.clone().zip(blocks.iter());
+        let mut device_range_reader = DeviceRangeReader::new(self, range)?;
+        while let Some(device_range) = device_range_reader.next_range()? {
+            for (device_bid, (bid, block)) in device_range.zip(blocks.by_ref()) {
+                if self.blocks_hole_desc.read().is_hole(bid as usize) {
+                    block.writer().fill(0);
+                    continue;
+                }
+                waiter.concat(plug.read_block(Bid::new(device_bid as u64), block)?);
+            }
+        }
+        plug.flush();
+        Ok(waiter)
+    }
+
+    pub fn read_blocks_sync(&self, bid: Ext2Bid, blocks: &[Frame]) -> Result<()> {
+        match self.read_blocks_async(bid, blocks)?.wait() {
+            Some(BioStatus::Complete) => Ok(()),
+            _ => return_errno!(Errno::EIO),
+        }
+    }
+
+    /// Writes consecutive blocks starting from the `bid` asynchronously.
+    ///
+    /// The bios are merged into large requests in the same way as `read_blocks_async`.
+    pub fn write_blocks_async(&self, bid: Ext2Bid, blocks: &[Frame]) -> Result<BioWaiter> {
+        let range = bid..bid + blocks.len() as Ext2Bid;
+        if range.end > self.desc.blocks_count() {
+            return_errno!(Errno::EINVAL);
+        }
+        if range.is_empty() {
+            return Ok(BioWaiter::new());
+        }
+
+        let fs = self.fs();
+        let mut plug = BioPlug::new(fs.block_device());
+        let mut waiter = BioWaiter::new();
+        let mut blocks = blocks.iter();
+        let mut device_range_reader = DeviceRangeReader::new(self, range.clone())?;
+        while let Some(device_range) = device_range_reader.next_range()? {
+            for (device_bid, block) in device_range.zip(blocks.by_ref()) {
+                waiter.concat(plug.write_block(Bid::new(device_bid as u64), block)?);
+            }
+        }
+        plug.flush();
+
+        // FIXME: Unset the block holes in the callback function of bio.
+        let mut blocks_hole_desc = self.blocks_hole_desc.write();
+        for bid in range {
+            blocks_hole_desc.unset(bid as usize);
+        }
+        Ok(waiter)
+    }
+
+    pub fn write_blocks_sync(&self, bid: Ext2Bid, blocks: &[Frame]) -> Result<()> {
+        match self.write_blocks_async(bid, blocks)?.wait() {
+            Some(BioStatus::Complete) => Ok(()),
+            _ => return_errno!(Errno::EIO),
+        }
+    }
+
     pub fn resize(&mut self, new_size: usize) -> Result<()> {
         let old_size = self.desc.size;
         if new_size > old_size {
@@ -1030,7 +1152,7 @@ impl InodeImpl_ {
 
         // Expands block count if necessary
         if new_blocks > old_blocks {
-            if new_blocks - old_blocks > self.fs().super_block().free_blocks_count() {
+            if new_blocks - old_blocks > self.fs().free_blocks_count() {
                 return_errno_with_message!(Errno::ENOSPC, "not enough free blocks");
             }
             self.expand_blocks(old_blocks..new_blocks)?;
@@ -1086,19 +1208,10 @@ impl InodeImpl_ {
             (max_cnt, indirect_cnt)
         };
 
-        // Calculates the block_group_idx to advise the filesystem on which group
-        // to prioritize for allocation.
-        let block_group_idx = self
-            .last_alloc_device_bid
-            .map_or(self.inode().block_group_idx, |id| {
-                ((id + 1) / self.fs().blocks_per_group()) as usize
-            });
-
         // Allocates the blocks only, no indirect blocks are required.
         if indirect_cnt == 0 {
             let device_range = self
-                .fs()
-                .alloc_blocks(block_group_idx, max_cnt)
+                .alloc_blocks(max_cnt)
                 .ok_or_else(|| Error::new(Errno::ENOSPC))?;
             if let Err(e) = self.set_device_range(range.start, device_range.clone()) {
                 self.fs().free_blocks(device_range).unwrap();
@@ -1115,7 +1228,7 @@ impl InodeImpl_ {
             let mut total_cnt = max_cnt + indirect_cnt;
             let mut device_range: Option<Range<Ext2Bid>> = None;
             while device_range.is_none() {
-                let Some(mut range) = self.fs().alloc_blocks(block_group_idx, total_cnt) else {
+                let Some(mut range) = self.alloc_blocks(total_cnt) else {
                     for indirect_bid in indirect_bids.iter() {
                         self.fs()
                             .free_blocks(*indirect_bid..*indirect_bid + 1)
@@ -1155,6 +1268,42 @@ impl InodeImpl_ {
         Ok(device_range.len() as Ext2Bid)
     }
 
+    /// Allocates a consecutive range of device blocks for the inode.
+    ///
+    /// The returned allocated range size may be smaller than the requested `count`.
+    ///
+    /// The blocks of a regular file are taken from its preallocation window, which
+    /// follows the last allocated block, so that the file can be expanded with
+    /// consecutive blocks even if it grows in small steps, e.g., by appending writes.
+    /// If the window is used up or has been released by the filesystem, a new window
+    /// is preallocated right after the last allocated block if possible.
+    fn alloc_blocks(&mut self, count: Ext2Bid) -> Option<Range<Ext2Bid>> {
+        let fs = self.fs();
+        let ino = self.inode().ino;
+        if let Some(range) = fs.take_prealloc_blocks(ino, count) {
+            return Some(range);
+        }
+
+        let goal = self.last_alloc_device_bid.map(|bid| bid + 1);
+        // Advises the filesystem on which group to prioritize for allocation.
+        let block_group_idx = goal.map_or(self.inode().block_group_idx, |bid| {
+            (bid / fs.blocks_per_group()) as usize
+        });
+        if self.desc.type_ == FileType::File {
+            let (min_cnt, max_cnt) = PREALLOC_WINDOW_BLOCKS.into_inner();
+            let window_cnt = count.max(self.desc.blocks_count().clamp(min_cnt, max_cnt));
+            if fs.prealloc_blocks(ino, block_group_idx, goal, window_cnt) {
+                return fs.take_prealloc_blocks(ino, count);
+            }
+        }
+        fs.alloc_blocks(block_group_idx, goal, count)
+    }
+
+    /// Frees the unused blocks in the preallocation window.
+    fn discard_prealloc_window(&mut self) {
+        self.fs().discard_prealloc_blocks(self.inode().ino);
+    }
+
     /// Sets the device block IDs for a specified range.
     ///
     /// It updates the mapping between the file's block IDs and the device's block IDs
@@ -1294,6 +1443,8 @@ impl InodeImpl_ {
     ///
     /// After the reduction, the block count will be decreased to `range.start`.
     fn shrink_blocks(&mut self, range: Range<Ext2Bid>) {
+        self.discard_prealloc_window();
+
         let mut current_range = range.clone();
         while !current_range.is_empty() {
             let free_cnt = self.try_shrink_blocks(current_range.clone());
@@ -1508,6 +1659,14 @@ impl<'a> DeviceRangeReader<'a> {
         Ok(device_range)
     }
 
+    /// Reads the next contiguous device range, or returns `None` if the whole range has been read.
+    pub fn next_range(&mut self) -> Result<Option<Range<Ext2Bid>>> {
+        if self.range.is_empty() {
+            return Ok(None);
+        }
+        self.read().map(Some)
+    }
+
     fn update_indirect_block(&mut self) -> Result<()> {
         let bid_path = BidPath::from(self.range.start);
         match bid_path {
@@ -1677,6 +1836,22 @@ impl InodeImpl {
         self.0.read().write_block_async(bid, block)
     }
 
+    pub fn read_blocks_sync(&self, bid: Ext2Bid, blocks: &[Frame]) -> Result<()> {
+        self.0.read().read_blocks_sync(bid, blocks)
+    }
+
+    pub fn read_blocks_async(&self, bid: Ext2Bid, blocks: &[Frame]) -> Result<BioWaiter> {
+        self.0.read().read_blocks_async(bid, blocks)
+    }
+
+    pub fn write_blocks_sync(&self, bid: Ext2Bid, blocks: &[Frame]) -> Result<()> {
+        self.0.read().write_blocks_sync(bid, blocks)
+    }
+
+    pub fn write_blocks_async(&self, bid: Ext2Bid, blocks: &[Frame]) -> Result<BioWaiter> {
+        self.0.read().write_blocks_async(bid, blocks)
+    }
+
     pub fn set_device_id(&self, device_id: u64) {
         self.0.write().desc.block_ptrs.as_bytes_mut()[..core::mem::size_of::<u64>()]
             .copy_from_slice(device_id.as_bytes());
@@ -1719,6 +1894,11 @@ impl InodeImpl {
     }
 
     pub fn sync_metadata(&self) -> Result<()> {
+        // The preallocated blocks are released once the inode is written back, since
+        // they are no longer needed if the inode stops growing.
+        let inode = self.0.read().inode();
+        inode.fs().discard_prealloc_blocks(inode.ino);
+
         if !self.0.read().desc.is_dirty() {
             return Ok(());
         }
@@ -1758,6 +1938,16 @@ impl PageCacheBackend for InodeImpl {
         self.write_block_async(bid, frame)
     }
 
+    fn read_pages(&self, idx: usize, frames: &[Frame]) -> Result<BioWaiter> {
+        let bid = idx as Ext2Bid;
+        self.read_blocks_async(bid, frames)
+    }
+
+    fn write_pages(&self, idx: usize, frames: &[Frame]) -> Result<BioWaiter> {
+        let bid = idx as Ext2Bid;
+        self.write_blocks_async(bid, frames)
+    }
+
     fn npages(&self) -> usize {
         self.blocks_count() as _
     }
@@ -2082,6 +2272,15 @@ pub(super) struct Osd2 {
     reserved2: u32,
 }
 
+fn alloc_frames(nframes: usize) -> Vec<Frame> {
+    FrameAllocOptions::new(nframes)
+        .uninit(true)
+        .alloc()
+        .unwrap()
+        .into_iter()
+        .collect()
+}
+
 fn is_block_aligned(offset: usize) -> bool {
     offset % BLOCK_SIZE == 0
 }
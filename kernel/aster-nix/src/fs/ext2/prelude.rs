@@ -7,7 +7,7 @@ pub(super) use core::{
 
 pub(super) use align_ext::AlignExt;
 pub(super) use aster_block::{
-    bio::{BioStatus, BioWaiter},
+    bio::{BioPlug, BioStatus, BioWaiter},
     id::Bid,
     BlockDevice, BLOCK_SIZE,
 };
@@ -20,7 +20,10 @@ pub(super) use static_assertions::const_assert;
 
 pub(super) use super::utils::{Dirty, IsPowerOf};
 pub(super) use crate::{
-    fs::utils::{CStr256, DirentVisitor, InodeType, PageCache, PageCacheBackend, Str16, Str64},
+    fs::utils::{
+        CStr256, DirentVisitor, FileAdvice, InodeType, PageCache, PageCacheBackend,
+        PageCachePrefetch, Str16, Str64,
+    },
     prelude::*,
     time::UnixTime,
     vm::vmo::Vmo,
@@ -59,6 +59,11 @@ impl<T: Debug> Dirty<T> {
     pub fn clear_dirty(&mut self) {
         self.dirty = false;
     }
+
+    /// Sets the dirty flag.
+    pub fn set_dirty(&mut self) {
+        self.dirty = true;
+    }
 }
 
 impl<T: Debug> Deref for Dirty<T> {
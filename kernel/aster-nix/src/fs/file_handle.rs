@@ -8,11 +8,15 @@ use crate::{
     events::{IoEvents, Observer},
     fs::{
         device::Device,
-        utils::{AccessMode, InodeMode, IoctlCmd, Metadata, SeekFrom, StatusFlags},
+        utils::{
+            AccessMode, FrameSlice, InodeMode, IoctlCmd, Metadata, SeekFrom, SpliceFlags,
+            StatusFlags,
+        },
     },
     net::socket::Socket,
     prelude::*,
     process::{signal::Poller, Gid, Uid},
+    util::IoVec,
 };
 
 /// The basic operations defined on a file
@@ -46,6 +50,94 @@ pub trait FileLike: Send + Sync + Any {
         return_errno_with_message!(Errno::ESPIPE, "write_at is not supported");
     }
 
+    /// Reads at the given file offset by appending the page frames that back the data
+    /// to `frames`, without copying the data.
+    ///
+    /// At most `max_len` bytes are read. Returns the number of bytes read.
+    /// Files whose data is not backed by page frames, e.g., files not backed by
+    /// the page cache, fail with `EOPNOTSUPP`.
+    fn read_frames_at(
+        &self,
+        offset: usize,
+        max_len: usize,
+        frames: &mut Vec<FrameSlice>,
+    ) -> Result<usize> {
+        return_errno_with_message!(Errno::EOPNOTSUPP, "read_frames_at is not supported");
+    }
+
+    /// Writes the data of the given frame slices.
+    ///
+    /// Files that can keep references to the frames (e.g., pipes) or copy the data
+    /// directly into their own buffers (e.g., stream sockets) can avoid
+    /// the intermediate copy of the default implementation.
+    ///
+    /// The `flags` are those of `splice`. The default implementation ignores them.
+    fn write_frames(&self, frames: &[FrameSlice], flags: SpliceFlags) -> Result<usize> {
+        let mut buffer = vec![0u8; PAGE_SIZE].into_boxed_slice();
+        let mut written_len = 0;
+        for frame in frames {
+            let len = frame.reader().read(&mut VmWriter::from(&mut buffer[..]));
+            match self.write(&buffer[..len]) {
+                Ok(n) => {
+                    written_len += n;
+                    if n < len {
+                        break;
+                    }
+                }
+                Err(_) if written_len > 0 => break,
+                Err(err) => return Err(err),
+            }
+        }
+        Ok(written_len)
+    }
+
+    /// Reads data into the user space buffers pointed by the IO vectors in order.
+    ///
+    /// Files that can copy their data directly into user space (e.g., pipes) should
+    /// override this method, so that the data is read atomically and without
+    /// the intermediate buffer of the default implementation.
+    fn read_vectored(&self, io_vecs: &[IoVec]) -> Result<usize> {
+        let mut total_len = 0;
+        for io_vec in io_vecs.iter().filter(|io_vec| !io_vec.is_empty()) {
+            let mut buffer = vec![0u8; io_vec.len()];
+            let read_len = match self.read(&mut buffer) {
+                Ok(len) => len,
+                Err(_) if total_len > 0 => break,
+                Err(err) => return Err(err),
+            };
+            io_vec.write_to_user(&buffer[..read_len])?;
+            total_len += read_len;
+            if read_len < buffer.len() {
+                // End of file reached or no more data to read
+                break;
+            }
+        }
+        Ok(total_len)
+    }
+
+    /// Writes the data of the user space buffers pointed by the IO vectors in order.
+    ///
+    /// Files that can copy the data directly from user space (e.g., pipes) should
+    /// override this method, so that the data is written atomically and without
+    /// the intermediate buffer of the default implementation.
+    fn write_vectored(&self, io_vecs: &[IoVec]) -> Result<usize> {
+        let mut total_len = 0;
+        for io_vec in io_vecs.iter().filter(|io_vec| !io_vec.is_empty()) {
+            let mut buffer = vec![0u8; io_vec.len()];
+            io_vec.read_exact_from_user(&mut buffer)?;
+            let write_len = match self.write(&buffer) {
+                Ok(len) => len,
+                Err(_) if total_len > 0 => break,
+                Err(err) => return Err(err),
+            };
+            total_len += write_len;
+            if write_len < buffer.len() {
+                break;
+            }
+        }
+        Ok(total_len)
+    }
+
     fn ioctl(&self, cmd: IoctlCmd, arg: usize) -> Result<i32> {
         return_errno_with_message!(Errno::EINVAL, "ioctl is not supported");
     }
@@ -5,6 +5,7 @@
 use core::sync::atomic::{AtomicU8, Ordering};
 
 use aster_util::slot_vec::SlotVec;
+use ostd::sync::Rcu;
 
 use super::{
     file_handle::FileLike,
@@ -19,17 +20,54 @@ use crate::{
 
 pub type FileDesc = i32;
 
+/// A file table that is shared by threads and processes.
+///
+/// Looking up files is lock-free, since the files are published with RCU. The
+/// other operations, e.g., opening, closing and duplicating file descriptors,
+/// should lock the file table.
+pub struct SharedFileTable {
+    table: Mutex<FileTable>,
+    files: Arc<RcuFiles>,
+}
+
+impl SharedFileTable {
+    pub fn new(table: FileTable) -> Self {
+        let files = table.files.clone();
+        Self {
+            table: Mutex::new(table),
+            files,
+        }
+    }
+
+    /// Locks the file table.
+    pub fn lock(&self) -> MutexGuard<'_, FileTable> {
+        self.table.lock()
+    }
+
+    /// Gets the file of the file descriptor without locking the file table.
+    pub fn get_file(&self, fd: FileDesc) -> Result<Arc<dyn FileLike>> {
+        self.files
+            .get(fd)
+            .ok_or(Error::with_message(Errno::EBADF, "fd not exits"))
+    }
+
+    /// Gets the socket of the file descriptor without locking the file table.
+    pub fn get_socket(&self, sockfd: FileDesc) -> Result<Arc<dyn Socket>> {
+        self.get_file(sockfd)?
+            .as_socket()
+            .ok_or_else(|| Error::with_message(Errno::ENOTSOCK, "the fd is not a socket"))
+    }
+}
+
 pub struct FileTable {
-    table: SlotVec<FileTableEntry>,
+    table: SlotVec<Arc<FileTableEntry>>,
     subject: Subject<FdEvents>,
+    files: Arc<RcuFiles>,
 }
 
 impl FileTable {
-    pub const fn new() -> Self {
-        Self {
-            table: SlotVec::new(),
-            subject: Subject::new(),
-        }
+    pub fn new() -> Self {
+        Self::from_table(SlotVec::new())
     }
 
     pub fn new_with_stdio() -> Self {
@@ -51,15 +89,44 @@ impl FileTable {
             let mode = InodeMode::S_IWUSR;
             fs_resolver.open(&tty_path, flags, mode.bits()).unwrap()
         };
-        table.put(FileTableEntry::new(Arc::new(stdin), FdFlags::empty()));
-        table.put(FileTableEntry::new(Arc::new(stdout), FdFlags::empty()));
-        table.put(FileTableEntry::new(Arc::new(stderr), FdFlags::empty()));
+        table.put(Arc::new(FileTableEntry::new(
+            Arc::new(stdin),
+            FdFlags::empty(),
+        )));
+        table.put(Arc::new(FileTableEntry::new(
+            Arc::new(stdout),
+            FdFlags::empty(),
+        )));
+        table.put(Arc::new(FileTableEntry::new(
+            Arc::new(stderr),
+            FdFlags::empty(),
+        )));
+        Self::from_table(table)
+    }
+
+    fn from_table(table: SlotVec<Arc<FileTableEntry>>) -> Self {
+        let files = Arc::new(RcuFiles::new(&table));
         Self {
             table,
             subject: Subject::new(),
+            files,
         }
     }
 
+    /// Puts the entry at the index and publishes it to the lock-free readers.
+    fn put_entry_at(&mut self, idx: usize, entry: FileTableEntry) -> Option<Arc<FileTableEntry>> {
+        let old_entry = self.table.put_at(idx, Arc::new(entry));
+        self.files.publish(&self.table, idx);
+        old_entry
+    }
+
+    /// Removes the entry at the index and retracts it from the lock-free readers.
+    fn remove_entry(&mut self, idx: usize) -> Option<Arc<FileTableEntry>> {
+        let old_entry = self.table.remove(idx)?;
+        self.files.publish(&self.table, idx);
+        Some(old_entry)
+    }
+
     pub fn dup(&mut self, fd: FileDesc, new_fd: FileDesc, flags: FdFlags) -> Result<FileDesc> {
         let file = self
             .table
@@ -84,13 +151,15 @@ impl FileTable {
 
         let min_free_fd = get_min_free_fd();
         let entry = FileTableEntry::new(file, flags);
-        self.table.put_at(min_free_fd, entry);
+        self.put_entry_at(min_free_fd, entry);
         Ok(min_free_fd as FileDesc)
     }
 
     pub fn insert(&mut self, item: Arc<dyn FileLike>, flags: FdFlags) -> FileDesc {
-        let entry = FileTableEntry::new(item, flags);
-        self.table.put(entry) as FileDesc
+        let entry = Arc::new(FileTableEntry::new(item, flags));
+        let fd = self.table.put(entry);
+        self.files.publish(&self.table, fd);
+        fd as FileDesc
     }
 
     pub fn insert_at(
@@ -100,23 +169,23 @@ impl FileTable {
         flags: FdFlags,
     ) -> Option<Arc<dyn FileLike>> {
         let entry = FileTableEntry::new(item, flags);
-        let entry = self.table.put_at(fd as usize, entry);
+        let entry = self.put_entry_at(fd as usize, entry);
         if entry.is_some() {
             let events = FdEvents::Close(fd);
             self.notify_fd_events(&events);
             entry.as_ref().unwrap().notify_fd_events(&events);
         }
-        entry.map(|e| e.file)
+        entry.map(|e| e.file.clone())
     }
 
     pub fn close_file(&mut self, fd: FileDesc) -> Option<Arc<dyn FileLike>> {
-        let entry = self.table.remove(fd as usize);
+        let entry = self.remove_entry(fd as usize);
         if entry.is_some() {
             let events = FdEvents::Close(fd);
             self.notify_fd_events(&events);
             entry.as_ref().unwrap().notify_fd_events(&events);
         }
-        entry.map(|e| e.file)
+        entry.map(|e| e.file.clone())
     }
 
     pub fn close_all(&mut self) -> Vec<Arc<dyn FileLike>> {
@@ -126,12 +195,18 @@ impl FileTable {
             .idxes_and_items()
             .map(|(idx, _)| idx as FileDesc)
             .collect();
-        for fd in closed_fds {
-            let entry = self.table.remove(fd as usize).unwrap();
+        let closed_entries: Vec<_> = closed_fds
+            .into_iter()
+            .map(|fd| (fd, self.table.remove(fd as usize).unwrap()))
+            .collect();
+        // Retract all the closed files at once.
+        self.files.publish_all(&self.table);
+
+        for (fd, entry) in closed_entries {
             let events = FdEvents::Close(fd);
             self.notify_fd_events(&events);
             entry.notify_fd_events(&events);
-            closed_files.push(entry.file);
+            closed_files.push(entry.file.clone());
         }
         closed_files
     }
@@ -149,12 +224,18 @@ impl FileTable {
                 }
             })
             .collect();
-        for fd in closed_fds {
-            let entry = self.table.remove(fd as usize).unwrap();
+        let closed_entries: Vec<_> = closed_fds
+            .into_iter()
+            .map(|fd| (fd, self.table.remove(fd as usize).unwrap()))
+            .collect();
+        // Retract all the closed files at once.
+        self.files.publish_all(&self.table);
+
+        for (fd, entry) in closed_entries {
             let events = FdEvents::Close(fd);
             self.notify_fd_events(&events);
             entry.notify_fd_events(&events);
-            closed_files.push(entry.file);
+            closed_files.push(entry.file.clone());
         }
         closed_files
     }
@@ -176,6 +257,7 @@ impl FileTable {
     pub fn get_entry(&self, fd: FileDesc) -> Result<&FileTableEntry> {
         self.table
             .get(fd as usize)
+            .map(|entry| entry.as_ref())
             .ok_or(Error::with_message(Errno::EBADF, "fd not exits"))
     }
 
@@ -198,6 +280,80 @@ impl FileTable {
     }
 }
 
+/// The files of a file table that can be looked up without locking.
+///
+/// The slots are replaced as a whole only when the number of slots grows or many
+/// files are closed at once. Otherwise, only the slot of the file descriptor is
+/// replaced. The updates are serialized by the lock of the file table.
+///
+/// The slots do not own the files. A file is still closed as soon as its last file
+/// descriptor is closed, and a reader that races with the close fails to upgrade its
+/// reference. So the replaced slots own no files and can be reclaimed in the RCU
+/// softirq without waiting for a grace period.
+struct RcuFiles {
+    slots: Rcu<Box<Vec<RcuSlot>>>,
+}
+
+type RcuSlot = Rcu<Option<Box<Weak<dyn FileLike>>>>;
+
+impl RcuFiles {
+    fn new(table: &SlotVec<Arc<FileTableEntry>>) -> Self {
+        Self {
+            slots: Rcu::new(Self::new_slots(table)),
+        }
+    }
+
+    fn new_slots(table: &SlotVec<Arc<FileTableEntry>>) -> Box<Vec<RcuSlot>> {
+        let nr_slots = table.slots_len().next_power_of_two().max(NR_INIT_SLOTS);
+        let slots = (0..nr_slots)
+            .map(|idx| Rcu::new(Self::new_slot(table, idx)))
+            .collect();
+        Box::new(slots)
+    }
+
+    fn new_slot(
+        table: &SlotVec<Arc<FileTableEntry>>,
+        idx: usize,
+    ) -> Option<Box<Weak<dyn FileLike>>> {
+        table
+            .get(idx)
+            .map(|entry| Box::new(Arc::downgrade(&entry.file)))
+    }
+
+    fn get(&self, fd: FileDesc) -> Option<Arc<dyn FileLike>> {
+        let slots = self.slots.read();
+        let slot = slots.get(usize::try_from(fd).ok()?)?.read();
+        slot.get()?.upgrade()
+    }
+
+    /// Publishes the entry at the index of the table.
+    fn publish(&self, table: &SlotVec<Arc<FileTableEntry>>, idx: usize) {
+        let slots = self.slots.read();
+        let Some(slot) = slots.get(idx) else {
+            drop(slots);
+            // The entry is already in the table, so it is published with the new slots.
+            self.publish_all(table);
+            return;
+        };
+        let reclaimer = slot.replace(Self::new_slot(table, idx));
+        drop(slots);
+
+        // An empty slot has nothing to reclaim, which is the case for most new file
+        // descriptors. Otherwise, the readers may still hold the old reference.
+        if let Some(reclaimer) = reclaimer.skip_if_none() {
+            reclaimer.delay();
+        }
+    }
+
+    /// Publishes all the entries of the table.
+    fn publish_all(&self, table: &SlotVec<Arc<FileTableEntry>>) {
+        self.slots.replace(Self::new_slots(table)).delay();
+    }
+}
+
+/// The minimum number of slots of [`RcuFiles`].
+const NR_INIT_SLOTS: usize = 64;
+
 impl Default for FileTable {
     fn default() -> Self {
         Self::new()
@@ -206,10 +362,11 @@ impl Default for FileTable {
 
 impl Clone for FileTable {
     fn clone(&self) -> Self {
-        Self {
-            table: self.table.clone(),
-            subject: Subject::new(),
+        let mut table = SlotVec::new();
+        for (idx, entry) in self.table.idxes_and_items() {
+            table.put_at(idx, Arc::new(FileTableEntry::clone(entry)));
         }
+        Self::from_table(table)
     }
 }
 
@@ -105,6 +105,18 @@ impl FileLike for InodeHandle<Rights> {
         self.0.read_at(offset, buf)
     }
 
+    fn read_frames_at(
+        &self,
+        offset: usize,
+        max_len: usize,
+        frames: &mut Vec<FrameSlice>,
+    ) -> Result<usize> {
+        if !self.1.contains(Rights::READ) {
+            return_errno_with_message!(Errno::EBADF, "file is not readable");
+        }
+        self.0.read_frames_at(offset, max_len, frames)
+    }
+
     fn write_at(&self, offset: usize, buf: &[u8]) -> Result<usize> {
         if !self.1.contains(Rights::WRITE) {
             return_errno_with_message!(Errno::EBADF, "file is not writable");
@@ -19,8 +19,8 @@ use crate::{
         file_handle::FileLike,
         path::Dentry,
         utils::{
-            AccessMode, DirentVisitor, InodeMode, InodeType, IoctlCmd, Metadata, SeekFrom,
-            StatusFlags,
+            AccessMode, DirentVisitor, FrameSlice, InodeMode, InodeType, IoctlCmd, Metadata,
+            SeekFrom, StatusFlags,
         },
     },
     prelude::*,
@@ -101,6 +101,36 @@ impl InodeHandle_ {
         }
     }
 
+    pub fn read_frames_at(
+        &self,
+        offset: usize,
+        max_len: usize,
+        frames: &mut Vec<FrameSlice>,
+    ) -> Result<usize> {
+        if self.file_io.is_some() || self.status_flags().contains(StatusFlags::O_DIRECT) {
+            return_errno_with_message!(Errno::EOPNOTSUPP, "the file is not read via page cache");
+        }
+
+        let inode = self.dentry.inode();
+        if inode.type_() != InodeType::File {
+            return_errno_with_message!(Errno::EOPNOTSUPP, "the file is not a regular file");
+        }
+        let Some(page_cache) = inode.page_cache() else {
+            return_errno_with_message!(Errno::EOPNOTSUPP, "the file has no page cache");
+        };
+
+        let end = inode.size().min(offset.saturating_add(max_len));
+        let mut pos = offset;
+        while pos < end {
+            let frame = page_cache.get_committed_frame(pos / PAGE_SIZE, false)?;
+            let start_in_page = pos % PAGE_SIZE;
+            let len = (PAGE_SIZE - start_in_page).min(end - pos);
+            frames.push(FrameSlice::new(frame, start_in_page..start_in_page + len));
+            pos += len;
+        }
+        Ok(pos - offset)
+    }
+
     pub fn read_to_end(&self, buf: &mut Vec<u8>) -> Result<usize> {
         if self.file_io.is_some() {
             return_errno_with_message!(Errno::EINVAL, "file io does not support read to end");
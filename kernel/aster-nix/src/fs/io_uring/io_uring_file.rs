@@ -0,0 +1,492 @@
+// SPDX-License-Identifier: MPL-2.0
+
+use core::{
+    sync::atomic::{fence, Ordering},
+    time::Duration,
+};
+
+use aster_rights::{Full, Rights};
+use ostd::mm::VmIo;
+
+use super::{
+    registered::Registered, request::Request, CqRingOffsets, IoUringCqe, IoUringRegisterOp,
+    IoUringSqe, SqRingFlags, SqRingOffsets, SqeFlags, IORING_OFF_CQ_RING, IORING_OFF_SQES,
+    IORING_OFF_SQ_RING,
+};
+use crate::{
+    events::{IoEvents, Observer},
+    fs::{
+        file_handle::FileLike,
+        utils::{IoctlCmd, PageCachePrefetch},
+    },
+    prelude::*,
+    process::signal::{Pollee, Poller},
+    time::{clocks::MonotonicClock, Clock},
+    vm::vmo::{Vmo, VmoChildOptions, VmoOptions, VmoRightsOp},
+};
+
+// The layout of the memory region of the rings, which is shared by the SQ
+// ring and the CQ ring. The heads and the tails of the SQ and the CQ, which are
+// written by the kernel and the user space respectively, reside in different
+// cache lines.
+const SQ_HEAD: usize = 0;
+const SQ_TAIL: usize = 4;
+const CQ_HEAD: usize = 64;
+const CQ_TAIL: usize = 68;
+const SQ_RING_MASK: usize = 128;
+const CQ_RING_MASK: usize = 132;
+const SQ_RING_ENTRIES: usize = 136;
+const CQ_RING_ENTRIES: usize = 140;
+const SQ_DROPPED: usize = 144;
+const SQ_FLAGS: usize = 148;
+const CQ_FLAGS: usize = 152;
+const CQ_OVERFLOW: usize = 156;
+const CQES: usize = 192;
+
+/// A file-like object that provides io_uring API.
+///
+/// The requests are executed in the context of the task that enters the ring,
+/// either when they are submitted or when the task waits for completions.
+/// A request is executed right away if it will not block. Otherwise,
+/// it is kept pending until it can make progress:
+///
+/// - A read of a regular file starts reading the missing pages into the page
+///   cache, so that a batch of reads has its block I/O issued all at once and
+///   the requests are executed when the I/O finishes;
+/// - A request on other files (e.g., sockets and pipes) is executed when
+///   the file has the interesting events, which are awaited with a `Poller`.
+///
+/// This is similar to the `IORING_SETUP_DEFER_TASKRUN` mode of Linux, where
+/// the completions are posted only when the task enters the ring with
+/// `IORING_ENTER_GETEVENTS`.
+pub struct IoUringFile {
+    sq_entries: u32,
+    cq_entries: u32,
+    // The memory region of the SQ ring and the CQ ring.
+    rings: Vmo<Full>,
+    // The memory region of the SQE array.
+    sqes: Vmo<Full>,
+    // The head of the SQ. The lock also serializes the submissions.
+    sq_head: Mutex<u32>,
+    // The files and the buffers registered with `io_uring_register`.
+    registered: Mutex<Registered>,
+    // The state of the CQ.
+    cq: Mutex<CqState>,
+    // The requests that cannot be executed without blocking for now.
+    pending: Mutex<Vec<PendingRequest>>,
+    // The ring file is readable when there are CQEs.
+    pollee: Pollee,
+    // Notifies the tasks waiting for completions when CQEs are posted. The events are
+    // not kept, so the waiters must check the CQ after starting polling.
+    completion: Pollee,
+}
+
+struct CqState {
+    tail: u32,
+    // The CQEs that cannot fit into the CQ for now.
+    overflow: VecDeque<IoUringCqe>,
+}
+
+struct PendingRequest {
+    request: Request,
+    wait: Wait,
+}
+
+/// What a pending request waits for.
+enum Wait {
+    Events(IoEvents),
+    Prefetch(PageCachePrefetch),
+}
+
+impl IoUringFile {
+    /// Creates a new io_uring file with the given number of SQ and CQ entries.
+    ///
+    /// The numbers must be powers of two.
+    pub fn new(sq_entries: u32, cq_entries: u32) -> Result<Arc<Self>> {
+        debug_assert!(sq_entries.is_power_of_two() && cq_entries.is_power_of_two());
+
+        let rings_size = Self::sq_array_offset(cq_entries) + sq_entries as usize * size_of::<u32>();
+        let rings = VmoOptions::<Full>::new(rings_size).alloc()?;
+        rings.write_val(SQ_RING_MASK, &(sq_entries - 1))?;
+        rings.write_val(CQ_RING_MASK, &(cq_entries - 1))?;
+        rings.write_val(SQ_RING_ENTRIES, &sq_entries)?;
+        rings.write_val(CQ_RING_ENTRIES, &cq_entries)?;
+
+        let sqes =
+            VmoOptions::<Full>::new(sq_entries as usize * size_of::<IoUringSqe>()).alloc()?;
+
+        Ok(Arc::new(Self {
+            sq_entries,
+            cq_entries,
+            rings,
+            sqes,
+            sq_head: Mutex::new(0),
+            registered: Mutex::new(Registered::default()),
+            cq: Mutex::new(CqState {
+                tail: 0,
+                overflow: VecDeque::new(),
+            }),
+            pending: Mutex::new(Vec::new()),
+            pollee: Pollee::new(IoEvents::empty()),
+            completion: Pollee::new(IoEvents::empty()),
+        }))
+    }
+
+    fn sq_array_offset(cq_entries: u32) -> usize {
+        CQES + cq_entries as usize * size_of::<IoUringCqe>()
+    }
+
+    /// Returns the offsets of the fields in the SQ ring and the CQ ring.
+    pub fn ring_offsets(&self) -> (SqRingOffsets, CqRingOffsets) {
+        let sq_off = SqRingOffsets {
+            head: SQ_HEAD as _,
+            tail: SQ_TAIL as _,
+            ring_mask: SQ_RING_MASK as _,
+            ring_entries: SQ_RING_ENTRIES as _,
+            flags: SQ_FLAGS as _,
+            dropped: SQ_DROPPED as _,
+            array: Self::sq_array_offset(self.cq_entries) as _,
+            ..Default::default()
+        };
+        let cq_off = CqRingOffsets {
+            head: CQ_HEAD as _,
+            tail: CQ_TAIL as _,
+            ring_mask: CQ_RING_MASK as _,
+            ring_entries: CQ_RING_ENTRIES as _,
+            overflow: CQ_OVERFLOW as _,
+            cqes: CQES as _,
+            flags: CQ_FLAGS as _,
+            ..Default::default()
+        };
+        (sq_off, cq_off)
+    }
+
+    /// Returns the VMO to be mapped into the user space at the given mmap offset.
+    pub fn mmap_vmo(&self, offset: usize, len: usize) -> Result<Vmo<Rights>> {
+        let vmo = match offset {
+            IORING_OFF_SQ_RING | IORING_OFF_CQ_RING => &self.rings,
+            IORING_OFF_SQES => &self.sqes,
+            _ => return_errno_with_message!(Errno::EINVAL, "invalid io_uring mmap offset"),
+        };
+        if len > vmo.size() {
+            return_errno_with_message!(Errno::EINVAL, "the mapping exceeds the io_uring region");
+        }
+        VmoChildOptions::new_slice_rights(vmo.dup().to_dyn(), 0..len).alloc()
+    }
+
+    /// Submits at most `to_submit` SQEs.
+    ///
+    /// Returns the number of the submitted SQEs. A request that fails to be
+    /// submitted, e.g., due to invalid arguments, is completed with an error.
+    pub fn submit(&self, to_submit: u32) -> Result<u32> {
+        let mut sq_head = self.sq_head.lock();
+        let sq_tail: u32 = self.rings.read_val(SQ_TAIL)?;
+        // Read the SQEs after reading the tail written by the user space.
+        fence(Ordering::Acquire);
+
+        let registered = self.registered.lock();
+        let nr_entries = sq_tail.wrapping_sub(*sq_head).min(to_submit);
+        let array_offset = Self::sq_array_offset(self.cq_entries);
+        let mut nr_submitted = 0;
+        for _ in 0..nr_entries {
+            let slot = (*sq_head & (self.sq_entries - 1)) as usize;
+            let index: u32 = self
+                .rings
+                .read_val(array_offset + slot * size_of::<u32>())?;
+            *sq_head = sq_head.wrapping_add(1);
+
+            if index >= self.sq_entries {
+                let dropped: u32 = self.rings.read_val(SQ_DROPPED)?;
+                self.rings.write_val(SQ_DROPPED, &dropped.wrapping_add(1))?;
+                continue;
+            }
+            let sqe: IoUringSqe = self
+                .sqes
+                .read_val(index as usize * size_of::<IoUringSqe>())?;
+            self.issue(&sqe, &registered)?;
+            nr_submitted += 1;
+        }
+
+        // Release the SQEs to the user space after consuming them.
+        fence(Ordering::Release);
+        self.rings.write_val(SQ_HEAD, &*sq_head)?;
+        Ok(nr_submitted)
+    }
+
+    fn issue(&self, sqe: &IoUringSqe, registered: &Registered) -> Result<()> {
+        let request = match Request::new(sqe, registered) {
+            Ok(request) => request,
+            Err(err) => return self.post_cqe(sqe.user_data, -(err.error() as i32)),
+        };
+
+        let wait = match request.prefetch() {
+            Ok(Some(prefetch)) => Wait::Prefetch(prefetch),
+            Ok(None) => match request.awaited_events() {
+                Some((file, events)) if file.poll(events, None).is_empty() => Wait::Events(events),
+                _ => return self.execute(request),
+            },
+            Err(err) => return self.post_result(&request, Err(err)),
+        };
+        self.pending.lock().push(PendingRequest { request, wait });
+        Ok(())
+    }
+
+    /// Registers or unregisters files or buffers.
+    pub fn register(&self, op: IoUringRegisterOp, arg: Vaddr, nr_args: u32) -> Result<()> {
+        let mut registered = self.registered.lock();
+        match op {
+            IoUringRegisterOp::RegisterBuffers => registered.register_buffers(arg, nr_args),
+            IoUringRegisterOp::UnregisterBuffers => registered.unregister_buffers(),
+            IoUringRegisterOp::RegisterFiles => registered.register_files(arg, nr_args),
+            IoUringRegisterOp::UnregisterFiles => registered.unregister_files(),
+        }
+    }
+
+    fn execute(&self, request: Request) -> Result<()> {
+        let res = request.execute();
+        if let Err(err) = &res
+            && err.error() == Errno::EAGAIN
+            && let Some((_, events)) = request.awaited_events()
+        {
+            // The events have been consumed by others. Wait for them again.
+            self.pending.lock().push(PendingRequest {
+                request,
+                wait: Wait::Events(events),
+            });
+            return Ok(());
+        }
+        self.post_result(&request, res)
+    }
+
+    fn post_result(&self, request: &Request, res: Result<usize>) -> Result<()> {
+        let res = match res {
+            Ok(_) if request.flags().contains(SqeFlags::CQE_SKIP_SUCCESS) => return Ok(()),
+            Ok(len) => len as i32,
+            Err(err) => -(err.error() as i32),
+        };
+        self.post_cqe(request.user_data(), res)
+    }
+
+    fn post_cqe(&self, user_data: u64, res: i32) -> Result<()> {
+        let cqe = IoUringCqe {
+            user_data,
+            res,
+            flags: 0,
+        };
+
+        let mut cq = self.cq.lock();
+        self.flush_overflow(&mut cq)?;
+        if !cq.overflow.is_empty() || !self.push_cqe(&mut cq, &cqe)? {
+            // Keep the CQE until the user space makes room for it.
+            if cq.overflow.is_empty() {
+                self.set_sq_flags(SqRingFlags::CQ_OVERFLOW, true)?;
+            }
+            cq.overflow.push_back(cqe);
+        }
+        drop(cq);
+
+        self.pollee.add_events(IoEvents::IN);
+        self.completion.add_events(IoEvents::IN);
+        self.completion.del_events(IoEvents::IN);
+        Ok(())
+    }
+
+    /// Pushes a CQE into the CQ. Returns `false` if the CQ is full.
+    fn push_cqe(&self, cq: &mut MutexGuard<CqState>, cqe: &IoUringCqe) -> Result<bool> {
+        let cq_head: u32 = self.rings.read_val(CQ_HEAD)?;
+        if cq.tail.wrapping_sub(cq_head) >= self.cq_entries {
+            return Ok(false);
+        }
+
+        let slot = (cq.tail & (self.cq_entries - 1)) as usize;
+        self.rings
+            .write_val(CQES + slot * size_of::<IoUringCqe>(), cqe)?;
+        cq.tail = cq.tail.wrapping_add(1);
+        // Publish the CQE before publishing the tail.
+        fence(Ordering::Release);
+        self.rings.write_val(CQ_TAIL, &cq.tail)?;
+        Ok(true)
+    }
+
+    fn flush_overflow(&self, cq: &mut MutexGuard<CqState>) -> Result<()> {
+        if cq.overflow.is_empty() {
+            return Ok(());
+        }
+
+        while let Some(cqe) = cq.overflow.front().copied() {
+            if !self.push_cqe(cq, &cqe)? {
+                return Ok(());
+            }
+            cq.overflow.pop_front();
+        }
+        self.set_sq_flags(SqRingFlags::CQ_OVERFLOW, false)
+    }
+
+    fn set_sq_flags(&self, flags: SqRingFlags, is_set: bool) -> Result<()> {
+        let old_flags: u32 = self.rings.read_val(SQ_FLAGS)?;
+        let new_flags = if is_set {
+            old_flags | flags.bits()
+        } else {
+            old_flags & !flags.bits()
+        };
+        self.rings.write_val(SQ_FLAGS, &new_flags)?;
+        Ok(())
+    }
+
+    /// Returns the number of CQEs that have not been consumed by the user space.
+    fn nr_ready_cqes(&self) -> Result<u32> {
+        let cq_tail = self.cq.lock().tail;
+        let cq_head: u32 = self.rings.read_val(CQ_HEAD)?;
+        Ok(cq_tail.wrapping_sub(cq_head))
+    }
+
+    /// Waits until there are at least `min_complete` CQEs, or no more requests
+    /// can complete.
+    ///
+    /// This method can be interrupted by signals. If `timeout` is given and expires
+    /// before that, this method fails with `ETIME`.
+    pub fn wait_cqes(&self, min_complete: u32, timeout: Option<&Duration>) -> Result<()> {
+        let deadline = timeout.map(|timeout| MonotonicClock::get().read_time() + *timeout);
+        loop {
+            {
+                let mut cq = self.cq.lock();
+                self.flush_overflow(&mut cq)?;
+            }
+            self.run_pending()?;
+            if self.nr_ready_cqes()? >= min_complete {
+                return Ok(());
+            }
+
+            // Wait for the block I/O, which will finish soon.
+            if self.complete_one_prefetch()? {
+                continue;
+            }
+
+            // Wait for the events of the pending requests.
+            let poller = Poller::new();
+            self.completion.poll(IoEvents::IN, Some(&poller));
+            let (has_pending, has_events) = {
+                let pending = self.pending.lock();
+                let has_events = pending.iter().any(|pending_request| {
+                    let Some((file, events)) = pending_request.request.awaited_events() else {
+                        return false;
+                    };
+                    !file.poll(events, Some(&poller)).is_empty()
+                });
+                (!pending.is_empty(), has_events)
+            };
+            if has_events {
+                continue;
+            }
+            if !has_pending || self.nr_ready_cqes()? >= min_complete {
+                return Ok(());
+            }
+            match deadline {
+                Some(deadline) => {
+                    let now = MonotonicClock::get().read_time();
+                    if now >= deadline {
+                        return_errno_with_message!(Errno::ETIME, "waiting for CQEs timed out");
+                    }
+                    poller.wait_timeout(&(deadline - now))?;
+                }
+                None => poller.wait()?,
+            }
+        }
+    }
+
+    /// Executes the pending requests that can make progress.
+    fn run_pending(&self) -> Result<()> {
+        let ready_requests = {
+            let mut pending = self.pending.lock();
+            let (ready, not_ready): (Vec<_>, Vec<_>) =
+                pending
+                    .drain(..)
+                    .partition(|pending_request| match &pending_request.wait {
+                        Wait::Events(events) => {
+                            let (file, _) = pending_request.request.awaited_events().unwrap();
+                            !file.poll(*events, None).is_empty()
+                        }
+                        Wait::Prefetch(prefetch) => prefetch.is_finished(),
+                    });
+            *pending = not_ready;
+            ready
+        };
+
+        for pending_request in ready_requests {
+            self.complete(pending_request)?;
+        }
+        Ok(())
+    }
+
+    /// Completes the first pending request that waits for block I/O.
+    ///
+    /// Returns `false` if there is no such request.
+    fn complete_one_prefetch(&self) -> Result<bool> {
+        let pending_request = {
+            let mut pending = self.pending.lock();
+            let Some(index) = pending
+                .iter()
+                .position(|pending_request| matches!(pending_request.wait, Wait::Prefetch(_)))
+            else {
+                return Ok(false);
+            };
+            pending.remove(index)
+        };
+
+        self.complete(pending_request)?;
+        Ok(true)
+    }
+
+    fn complete(&self, pending_request: PendingRequest) -> Result<()> {
+        let PendingRequest { request, wait } = pending_request;
+        if let Wait::Prefetch(prefetch) = wait
+            && let Err(err) = prefetch.complete()
+        {
+            return self.post_result(&request, Err(err));
+        }
+        self.execute(request)
+    }
+
+    fn update_events(&self) {
+        match self.nr_ready_cqes() {
+            Ok(0) => self.pollee.del_events(IoEvents::IN),
+            _ => self.pollee.add_events(IoEvents::IN),
+        }
+    }
+}
+
+impl FileLike for IoUringFile {
+    fn read(&self, _buf: &mut [u8]) -> Result<usize> {
+        return_errno_with_message!(Errno::EINVAL, "io_uring files do not support read");
+    }
+
+    fn write(&self, _buf: &[u8]) -> Result<usize> {
+        return_errno_with_message!(Errno::EINVAL, "io_uring files do not support write");
+    }
+
+    fn ioctl(&self, _cmd: IoctlCmd, _arg: usize) -> Result<i32> {
+        return_errno_with_message!(Errno::EINVAL, "io_uring files do not support ioctl");
+    }
+
+    fn poll(&self, mask: IoEvents, poller: Option<&Poller>) -> IoEvents {
+        // The user space consumes the CQEs without notifying the kernel.
+        self.update_events();
+        self.pollee.poll(mask, poller)
+    }
+
+    fn register_observer(
+        &self,
+        observer: Weak<dyn Observer<IoEvents>>,
+        mask: IoEvents,
+    ) -> Result<()> {
+        self.pollee.register_observer(observer, mask);
+        Ok(())
+    }
+
+    fn unregister_observer(
+        &self,
+        observer: &Weak<dyn Observer<IoEvents>>,
+    ) -> Option<Weak<dyn Observer<IoEvents>>> {
+        self.pollee.unregister_observer(observer)
+    }
+}
@@ -0,0 +1,226 @@
+// SPDX-License-Identifier: MPL-2.0
+
+//! The io_uring interface for asynchronous I/O.
+//!
+//! An io_uring instance consists of a submission queue (SQ) and a completion
+//! queue (CQ), which are ring buffers shared between the kernel and the user space.
+//! The user space puts submission queue entries (SQEs) into the SQ and the kernel
+//! puts completion queue entries (CQEs) into the CQ. Thus, many I/O operations
+//! can be submitted and reaped with a single system call.
+
+use crate::prelude::*;
+
+mod io_uring_file;
+mod registered;
+mod request;
+
+pub use self::io_uring_file::IoUringFile;
+
+/// The maximum number of SQ entries.
+pub const IORING_MAX_ENTRIES: u32 = 32768;
+/// The maximum number of CQ entries.
+pub const IORING_MAX_CQ_ENTRIES: u32 = 2 * IORING_MAX_ENTRIES;
+
+/// The mmap offset of the SQ ring.
+pub const IORING_OFF_SQ_RING: usize = 0;
+/// The mmap offset of the CQ ring.
+pub const IORING_OFF_CQ_RING: usize = 0x8000000;
+/// The mmap offset of the SQE array.
+pub const IORING_OFF_SQES: usize = 0x10000000;
+
+bitflags! {
+    /// The flags of `io_uring_setup`.
+    pub struct IoUringSetupFlags: u32 {
+        const IOPOLL        = 1 << 0;
+        const SQPOLL        = 1 << 1;
+        const SQ_AFF        = 1 << 2;
+        const CQSIZE        = 1 << 3;
+        const CLAMP         = 1 << 4;
+        const ATTACH_WQ     = 1 << 5;
+        const R_DISABLED    = 1 << 6;
+        const SUBMIT_ALL    = 1 << 7;
+        const COOP_TASKRUN  = 1 << 8;
+        const TASKRUN_FLAG  = 1 << 9;
+        const SQE128        = 1 << 10;
+        const CQE32         = 1 << 11;
+        const SINGLE_ISSUER = 1 << 12;
+        const DEFER_TASKRUN = 1 << 13;
+    }
+}
+
+impl IoUringSetupFlags {
+    /// The flags that are supported.
+    ///
+    /// Requests are always completed in the context of the task that enters
+    /// the ring, so the task-running hints are accepted as is.
+    pub const SUPPORTED: Self = Self::CQSIZE
+        .union(Self::CLAMP)
+        .union(Self::SUBMIT_ALL)
+        .union(Self::COOP_TASKRUN)
+        .union(Self::SINGLE_ISSUER)
+        .union(Self::DEFER_TASKRUN);
+}
+
+bitflags! {
+    /// The features supported by the io_uring implementation.
+    pub struct IoUringFeatures: u32 {
+        const SINGLE_MMAP   = 1 << 0;
+        const NODROP        = 1 << 1;
+        const SUBMIT_STABLE = 1 << 2;
+        const RW_CUR_POS    = 1 << 3;
+        const EXT_ARG       = 1 << 8;
+    }
+}
+
+bitflags! {
+    /// The flags of `io_uring_enter`.
+    pub struct IoUringEnterFlags: u32 {
+        const GETEVENTS = 1 << 0;
+        const SQ_WAKEUP = 1 << 1;
+        const SQ_WAIT   = 1 << 2;
+        const EXT_ARG   = 1 << 3;
+    }
+}
+
+bitflags! {
+    /// The flags of an SQE.
+    pub struct SqeFlags: u8 {
+        const FIXED_FILE       = 1 << 0;
+        const IO_DRAIN         = 1 << 1;
+        const IO_LINK          = 1 << 2;
+        const IO_HARDLINK      = 1 << 3;
+        const ASYNC            = 1 << 4;
+        const BUFFER_SELECT    = 1 << 5;
+        const CQE_SKIP_SUCCESS = 1 << 6;
+    }
+}
+
+bitflags! {
+    /// The flags in the SQ ring, which are set by the kernel.
+    pub struct SqRingFlags: u32 {
+        const NEED_WAKEUP = 1 << 0;
+        const CQ_OVERFLOW = 1 << 1;
+    }
+}
+
+/// The opcodes of the supported operations.
+#[repr(u8)]
+#[derive(Copy, Clone, Debug, PartialEq, Eq, TryFromInt)]
+pub enum IoUringOp {
+    Nop = 0,
+    Readv = 1,
+    Writev = 2,
+    Fsync = 3,
+    ReadFixed = 4,
+    WriteFixed = 5,
+    PollAdd = 6,
+    Sendmsg = 9,
+    Recvmsg = 10,
+    Read = 22,
+    Write = 23,
+    Send = 26,
+    Recv = 27,
+}
+
+/// The opcodes of `io_uring_register` that are supported.
+#[repr(u32)]
+#[derive(Copy, Clone, Debug, PartialEq, Eq, TryFromInt)]
+pub enum IoUringRegisterOp {
+    RegisterBuffers = 0,
+    UnregisterBuffers = 1,
+    RegisterFiles = 2,
+    UnregisterFiles = 3,
+}
+
+/// The flag of `IoUringOp::Fsync` to sync only the data.
+pub const IORING_FSYNC_DATASYNC: u32 = 1 << 0;
+
+/// The parameters of `io_uring_setup`.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Pod)]
+pub struct IoUringParams {
+    pub sq_entries: u32,
+    pub cq_entries: u32,
+    pub flags: u32,
+    pub sq_thread_cpu: u32,
+    pub sq_thread_idle: u32,
+    pub features: u32,
+    pub wq_fd: u32,
+    pub resv: [u32; 3],
+    pub sq_off: SqRingOffsets,
+    pub cq_off: CqRingOffsets,
+}
+
+/// The offsets of the fields in the SQ ring.
+#[repr(C)]
+#[derive(Debug, Default, Clone, Copy, Pod)]
+pub struct SqRingOffsets {
+    pub head: u32,
+    pub tail: u32,
+    pub ring_mask: u32,
+    pub ring_entries: u32,
+    pub flags: u32,
+    pub dropped: u32,
+    pub array: u32,
+    pub resv1: u32,
+    pub user_addr: u64,
+}
+
+/// The offsets of the fields in the CQ ring.
+#[repr(C)]
+#[derive(Debug, Default, Clone, Copy, Pod)]
+pub struct CqRingOffsets {
+    pub head: u32,
+    pub tail: u32,
+    pub ring_mask: u32,
+    pub ring_entries: u32,
+    pub overflow: u32,
+    pub cqes: u32,
+    pub flags: u32,
+    pub resv1: u32,
+    pub user_addr: u64,
+}
+
+/// The extended arguments of `io_uring_enter` with `IoUringEnterFlags::EXT_ARG`.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Pod)]
+pub struct IoUringGeteventsArg {
+    pub sigmask: u64,
+    pub sigmask_sz: u32,
+    pub pad: u32,
+    /// The address of the timeout of waiting for completions.
+    pub ts: u64,
+}
+
+/// A submission queue entry.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Pod)]
+pub struct IoUringSqe {
+    pub opcode: u8,
+    pub flags: u8,
+    pub ioprio: u16,
+    pub fd: i32,
+    /// The file offset, or the second address.
+    pub off: u64,
+    /// The buffer address, or the address of the I/O vectors or the message header.
+    pub addr: u64,
+    /// The buffer length, or the number of the I/O vectors.
+    pub len: u32,
+    /// The flags specific to the opcode.
+    pub op_flags: u32,
+    pub user_data: u64,
+    pub buf_index: u16,
+    pub personality: u16,
+    pub splice_fd_in: i32,
+    pub addr3: u64,
+    pub pad: u64,
+}
+
+/// A completion queue entry.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Pod)]
+pub struct IoUringCqe {
+    pub user_data: u64,
+    pub res: i32,
+    pub flags: u32,
+}
@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: MPL-2.0
+
+use crate::{
+    fs::{file_handle::FileLike, file_table::FileDesc},
+    prelude::*,
+    util::{copy_iovs_from_user, read_val_from_user, IoVec},
+};
+
+/// The maximum number of registered files.
+const IORING_MAX_FIXED_FILES: u32 = 1 << 20;
+/// The maximum number of registered buffers.
+const IORING_MAX_REG_BUFFERS: u32 = 1 << 14;
+/// The maximum length of a registered buffer.
+const IORING_MAX_REG_BUFFER_LEN: usize = 1 << 30;
+
+/// The files and the buffers that are registered with `io_uring_register`.
+///
+/// An SQE refers to a registered file by its index if it has `SqeFlags::FIXED_FILE`,
+/// and to a registered buffer by its index if it has a `*_FIXED` opcode. A registered
+/// file stays open until it is unregistered, even if its file descriptor is closed.
+///
+/// The registered buffers are not pinned. Only their ranges are recorded, so that
+/// the requests can be checked against them, and the data is still copied from
+/// and to the user space when the requests are executed.
+#[derive(Default)]
+pub(super) struct Registered {
+    files: Option<Box<[Option<Arc<dyn FileLike>>]>>,
+    buffers: Option<Box<[IoVec]>>,
+}
+
+impl Registered {
+    /// Registers the files of the `nr_fds` file descriptors at `fds_addr`.
+    ///
+    /// A file descriptor of -1 leaves its slot empty.
+    pub(super) fn register_files(&mut self, fds_addr: Vaddr, nr_fds: u32) -> Result<()> {
+        if self.files.is_some() {
+            return_errno_with_message!(Errno::EBUSY, "the files have been registered");
+        }
+        if nr_fds == 0 {
+            return_errno_with_message!(Errno::EINVAL, "no files to register");
+        }
+        if nr_fds > IORING_MAX_FIXED_FILES {
+            return_errno_with_message!(Errno::EMFILE, "too many files to register");
+        }
+
+        let current = current!();
+        let file_table = current.file_table();
+        let files = (0..nr_fds as usize)
+            .map(|i| {
+                let fd: i32 = read_val_from_user(fds_addr + i * size_of::<i32>())?;
+                if fd == -1 {
+                    return Ok(None);
+                }
+                file_table.get_file(fd as FileDesc).map(Some)
+            })
+            .collect::<Result<_>>()?;
+        self.files = Some(files);
+        Ok(())
+    }
+
+    pub(super) fn unregister_files(&mut self) -> Result<()> {
+        if self.files.take().is_none() {
+            return_errno_with_message!(Errno::ENXIO, "no files have been registered");
+        }
+        Ok(())
+    }
+
+    /// Registers the buffers of the `nr_io_vecs` I/O vectors at `io_vecs_addr`.
+    pub(super) fn register_buffers(&mut self, io_vecs_addr: Vaddr, nr_io_vecs: u32) -> Result<()> {
+        if self.buffers.is_some() {
+            return_errno_with_message!(Errno::EBUSY, "the buffers have been registered");
+        }
+        if nr_io_vecs == 0 || nr_io_vecs > IORING_MAX_REG_BUFFERS {
+            return_errno_with_message!(Errno::EINVAL, "invalid number of buffers");
+        }
+
+        let buffers = copy_iovs_from_user(io_vecs_addr, nr_io_vecs as usize)?;
+        for buffer in buffers.iter() {
+            if buffer.is_empty() || buffer.len() > IORING_MAX_REG_BUFFER_LEN {
+                return_errno_with_message!(Errno::EFAULT, "invalid buffer to register");
+            }
+            if buffer.base().checked_add(buffer.len()).is_none() {
+                return_errno_with_message!(Errno::EFAULT, "the buffer overflows");
+            }
+        }
+        self.buffers = Some(buffers);
+        Ok(())
+    }
+
+    pub(super) fn unregister_buffers(&mut self) -> Result<()> {
+        if self.buffers.take().is_none() {
+            return_errno_with_message!(Errno::ENXIO, "no buffers have been registered");
+        }
+        Ok(())
+    }
+
+    /// Returns the registered file at `index`.
+    pub(super) fn file(&self, index: i32) -> Result<Arc<dyn FileLike>> {
+        let Some(files) = &self.files else {
+            return_errno_with_message!(Errno::EBADF, "no files have been registered");
+        };
+        usize::try_from(index)
+            .ok()
+            .and_then(|index| files.get(index)?.clone())
+            .ok_or_else(|| Error::with_message(Errno::EBADF, "no such registered file"))
+    }
+
+    /// Returns the part of the registered buffer at `index`, which starts at `addr`
+    /// and has `len` bytes.
+    pub(super) fn buffer(&self, index: u16, addr: Vaddr, len: usize) -> Result<IoVec> {
+        let buffer = self
+            .buffers
+            .as_ref()
+            .and_then(|buffers| buffers.get(index as usize))
+            .ok_or_else(|| Error::with_message(Errno::EFAULT, "no such registered buffer"))?;
+
+        let buffer_end = buffer.base() + buffer.len();
+        if addr < buffer.base() || addr.checked_add(len).map_or(true, |end| end > buffer_end) {
+            return_errno_with_message!(Errno::EFAULT, "the range exceeds the registered buffer");
+        }
+        Ok(IoVec::new(addr, len))
+    }
+}
@@ -0,0 +1,371 @@
+// SPDX-License-Identifier: MPL-2.0
+
+use super::{registered::Registered, IoUringOp, IoUringSqe, SqeFlags, IORING_FSYNC_DATASYNC};
+use crate::{
+    events::IoEvents,
+    fs::{
+        file_handle::FileLike,
+        file_table::FileDesc,
+        inode_handle::InodeHandle,
+        utils::{InodeType, PageCachePrefetch, SeekFrom, StatusFlags},
+    },
+    net::socket::{MessageHeader, SendRecvFlags, SocketAddr},
+    prelude::*,
+    util::{
+        copy_iovs_from_user, net::CUserMsgHdr, read_bytes_from_user, read_val_from_user,
+        write_bytes_to_user, IoVec,
+    },
+};
+
+/// The maximum number of I/O vectors of a request.
+const MAX_IO_VECS: usize = 1024;
+
+/// A request that is submitted through an SQE.
+///
+/// All the arguments that reside in the user space (e.g., I/O vectors and
+/// message headers) are copied when the request is created, so the user
+/// space can reuse the SQE and the arguments right after the submission.
+pub(super) struct Request {
+    user_data: u64,
+    flags: SqeFlags,
+    op: Op,
+}
+
+enum Op {
+    Nop,
+    Read {
+        file: RequestFile,
+        offset: Option<usize>,
+        io_vecs: Box<[IoVec]>,
+    },
+    Write {
+        file: RequestFile,
+        offset: Option<usize>,
+        io_vecs: Box<[IoVec]>,
+    },
+    Fsync {
+        file: RequestFile,
+        is_datasync: bool,
+    },
+    PollAdd {
+        file: RequestFile,
+        events: IoEvents,
+    },
+    Send {
+        file: RequestFile,
+        io_vecs: Box<[IoVec]>,
+        addr: Option<SocketAddr>,
+        flags: SendRecvFlags,
+    },
+    Recv {
+        file: RequestFile,
+        io_vecs: Box<[IoVec]>,
+        msghdr: Option<CUserMsgHdr>,
+        flags: SendRecvFlags,
+    },
+}
+
+/// The file of a request.
+struct RequestFile {
+    file: Arc<dyn FileLike>,
+    // Whether the file is a regular file, which is always ready for I/O
+    // and is backed by the page cache (if any).
+    is_regular: bool,
+}
+
+impl RequestFile {
+    /// Gets the file of the SQE, which refers to a registered file with
+    /// `SqeFlags::FIXED_FILE`, or an opened file otherwise.
+    fn new(sqe: &IoUringSqe, registered: &Registered) -> Result<Self> {
+        let file = if SqeFlags::from_bits_truncate(sqe.flags).contains(SqeFlags::FIXED_FILE) {
+            registered.file(sqe.fd)?
+        } else {
+            let current = current!();
+            current.file_table().get_file(sqe.fd as FileDesc)?
+        };
+        let is_regular = file
+            .downcast_ref::<InodeHandle>()
+            .is_some_and(|inode_handle| inode_handle.dentry().type_() == InodeType::File);
+        Ok(Self { file, is_regular })
+    }
+
+    fn new_socket(sqe: &IoUringSqe, registered: &Registered) -> Result<Self> {
+        let file = Self::new(sqe, registered)?;
+        if file.file.clone().as_socket().is_none() {
+            return_errno_with_message!(Errno::ENOTSOCK, "the file is not a socket");
+        }
+        Ok(file)
+    }
+}
+
+impl Request {
+    /// Creates a request from an SQE, whose registered files and buffers are in `registered`.
+    pub(super) fn new(sqe: &IoUringSqe, registered: &Registered) -> Result<Self> {
+        let flags = SqeFlags::from_bits(sqe.flags)
+            .ok_or_else(|| Error::with_message(Errno::EINVAL, "invalid SQE flags"))?;
+        if flags.intersects(
+            SqeFlags::IO_DRAIN
+                | SqeFlags::IO_LINK
+                | SqeFlags::IO_HARDLINK
+                | SqeFlags::BUFFER_SELECT,
+        ) {
+            return_errno_with_message!(Errno::EINVAL, "unsupported SQE flags");
+        }
+
+        let offset = || (sqe.off != u64::MAX).then_some(sqe.off as usize);
+        let op = match IoUringOp::try_from(sqe.opcode)? {
+            IoUringOp::Nop => Op::Nop,
+            IoUringOp::Read => Op::Read {
+                file: RequestFile::new(sqe, registered)?,
+                offset: offset(),
+                io_vecs: Box::new([IoVec::new(sqe.addr as Vaddr, sqe.len as usize)]),
+            },
+            IoUringOp::Readv => Op::Read {
+                file: RequestFile::new(sqe, registered)?,
+                offset: offset(),
+                io_vecs: copy_io_vecs(sqe.addr as Vaddr, sqe.len as usize)?,
+            },
+            IoUringOp::Write => Op::Write {
+                file: RequestFile::new(sqe, registered)?,
+                offset: offset(),
+                io_vecs: Box::new([IoVec::new(sqe.addr as Vaddr, sqe.len as usize)]),
+            },
+            IoUringOp::Writev => Op::Write {
+                file: RequestFile::new(sqe, registered)?,
+                offset: offset(),
+                io_vecs: copy_io_vecs(sqe.addr as Vaddr, sqe.len as usize)?,
+            },
+            IoUringOp::ReadFixed => Op::Read {
+                file: RequestFile::new(sqe, registered)?,
+                offset: offset(),
+                io_vecs: Box::new([registered.buffer(
+                    sqe.buf_index,
+                    sqe.addr as Vaddr,
+                    sqe.len as usize,
+                )?]),
+            },
+            IoUringOp::WriteFixed => Op::Write {
+                file: RequestFile::new(sqe, registered)?,
+                offset: offset(),
+                io_vecs: Box::new([registered.buffer(
+                    sqe.buf_index,
+                    sqe.addr as Vaddr,
+                    sqe.len as usize,
+                )?]),
+            },
+            IoUringOp::Fsync => {
+                let file = RequestFile::new(sqe, registered)?;
+                if file.file.downcast_ref::<InodeHandle>().is_none() {
+                    return_errno_with_message!(Errno::EINVAL, "not inode");
+                }
+                Op::Fsync {
+                    file,
+                    is_datasync: sqe.op_flags & IORING_FSYNC_DATASYNC != 0,
+                }
+            }
+            IoUringOp::PollAdd => Op::PollAdd {
+                file: RequestFile::new(sqe, registered)?,
+                // Only the lower 16 bits are used, as Linux does without `IORING_POLL_ADD_MULTI`.
+                events: IoEvents::from_bits_truncate(sqe.op_flags & 0xffff),
+            },
+            IoUringOp::Send => Op::Send {
+                file: RequestFile::new_socket(sqe, registered)?,
+                io_vecs: Box::new([IoVec::new(sqe.addr as Vaddr, sqe.len as usize)]),
+                addr: None,
+                flags: SendRecvFlags::from_bits_truncate(sqe.op_flags as i32),
+            },
+            IoUringOp::Sendmsg => {
+                let file = RequestFile::new_socket(sqe, registered)?;
+                let msghdr: CUserMsgHdr = read_val_from_user(sqe.addr as Vaddr)?;
+                if msghdr.msg_control != 0 {
+                    // TODO: support sending control message
+                    warn!("control message is not supported now");
+                }
+                Op::Send {
+                    file,
+                    io_vecs: copy_io_vecs(msghdr.msg_iov, msghdr.msg_iovlen)?,
+                    addr: msghdr.read_socket_addr_from_user()?,
+                    flags: SendRecvFlags::from_bits_truncate(sqe.op_flags as i32),
+                }
+            }
+            IoUringOp::Recv => Op::Recv {
+                file: RequestFile::new_socket(sqe, registered)?,
+                io_vecs: Box::new([IoVec::new(sqe.addr as Vaddr, sqe.len as usize)]),
+                msghdr: None,
+                flags: SendRecvFlags::from_bits_truncate(sqe.op_flags as i32),
+            },
+            IoUringOp::Recvmsg => {
+                let file = RequestFile::new_socket(sqe, registered)?;
+                let msghdr: CUserMsgHdr = read_val_from_user(sqe.addr as Vaddr)?;
+                Op::Recv {
+                    file,
+                    io_vecs: copy_io_vecs(msghdr.msg_iov, msghdr.msg_iovlen)?,
+                    msghdr: Some(msghdr),
+                    flags: SendRecvFlags::from_bits_truncate(sqe.op_flags as i32),
+                }
+            }
+        };
+
+        Ok(Self {
+            user_data: sqe.user_data,
+            flags,
+            op,
+        })
+    }
+
+    pub(super) fn user_data(&self) -> u64 {
+        self.user_data
+    }
+
+    pub(super) fn flags(&self) -> SqeFlags {
+        self.flags
+    }
+
+    /// Returns the file and the events that the request has to wait for
+    /// before it can be executed without blocking.
+    ///
+    /// Requests on regular files never wait for events.
+    pub(super) fn awaited_events(&self) -> Option<(&Arc<dyn FileLike>, IoEvents)> {
+        let (file, events) = match &self.op {
+            Op::Nop | Op::Fsync { .. } => return None,
+            Op::Read { file, .. } | Op::Recv { file, .. } => (file, IoEvents::IN),
+            Op::Write { file, .. } | Op::Send { file, .. } => (file, IoEvents::OUT),
+            Op::PollAdd { file, events } => return Some((&file.file, *events)),
+        };
+        (!file.is_regular).then_some((&file.file, events))
+    }
+
+    /// Starts reading the data of the request into the page cache,
+    /// so that the request can be executed without blocking on the I/O.
+    ///
+    /// Returns `None` if the request does not read a regular file or
+    /// all the data to read has been cached.
+    pub(super) fn prefetch(&self) -> Result<Option<PageCachePrefetch>> {
+        let Op::Read {
+            file,
+            offset,
+            io_vecs,
+        } = &self.op
+        else {
+            return Ok(None);
+        };
+        if !file.is_regular || file.file.status_flags().contains(StatusFlags::O_DIRECT) {
+            return Ok(None);
+        }
+
+        let offset = match offset {
+            Some(offset) => *offset,
+            None => file.file.seek(SeekFrom::Current(0))?,
+        };
+        let len = io_vecs.iter().map(IoVec::len).sum();
+        let inode_handle = file.file.downcast_ref::<InodeHandle>().unwrap();
+        inode_handle.dentry().inode().prefetch(offset, len)
+    }
+
+    /// Executes the request.
+    ///
+    /// Returns the result that is reported in the CQE.
+    pub(super) fn execute(&self) -> Result<usize> {
+        match &self.op {
+            Op::Nop => Ok(0),
+            Op::Read {
+                file,
+                offset,
+                io_vecs,
+            } => {
+                let mut buffer = vec![0u8; io_vecs.iter().map(IoVec::len).sum()];
+                if buffer.is_empty() {
+                    return Ok(0);
+                }
+                let read_len = match offset {
+                    Some(offset) if file.is_regular => file.file.read_at(*offset, &mut buffer)?,
+                    _ => file.file.read(&mut buffer)?,
+                };
+                scatter_to_user(io_vecs, &buffer[..read_len])?;
+                Ok(read_len)
+            }
+            Op::Write {
+                file,
+                offset,
+                io_vecs,
+            } => {
+                let buffer = gather_from_user(io_vecs)?;
+                if buffer.is_empty() {
+                    return Ok(0);
+                }
+                match offset {
+                    Some(offset) if file.is_regular => file.file.write_at(*offset, &buffer),
+                    _ => file.file.write(&buffer),
+                }
+            }
+            Op::Fsync { file, is_datasync } => {
+                let dentry = file.file.downcast_ref::<InodeHandle>().unwrap().dentry();
+                if *is_datasync {
+                    dentry.sync_data()?;
+                } else {
+                    dentry.sync_all()?;
+                }
+                Ok(0)
+            }
+            Op::PollAdd { file, events } => {
+                let revents = file.file.poll(*events, None);
+                Ok(revents.bits() as usize)
+            }
+            Op::Send {
+                file,
+                io_vecs,
+                addr,
+                flags,
+            } => {
+                let socket = file.file.clone().as_socket().unwrap();
+                socket.sendmsg(io_vecs, MessageHeader::new(addr.clone(), None), *flags)
+            }
+            Op::Recv {
+                file,
+                io_vecs,
+                msghdr,
+                flags,
+            } => {
+                let socket = file.file.clone().as_socket().unwrap();
+                let (read_len, message_header) = socket.recvmsg(io_vecs, *flags)?;
+                if let Some(msghdr) = msghdr
+                    && let Some(addr) = message_header.addr()
+                {
+                    msghdr.write_socket_addr_to_user(addr)?;
+                }
+                Ok(read_len)
+            }
+        }
+    }
+}
+
+fn copy_io_vecs(addr: Vaddr, count: usize) -> Result<Box<[IoVec]>> {
+    if count > MAX_IO_VECS {
+        return_errno_with_message!(Errno::EINVAL, "too many I/O vectors");
+    }
+    copy_iovs_from_user(addr, count)
+}
+
+fn gather_from_user(io_vecs: &[IoVec]) -> Result<Vec<u8>> {
+    let mut buffer = vec![0u8; io_vecs.iter().map(IoVec::len).sum()];
+    let mut pos = 0;
+    for io_vec in io_vecs.iter().filter(|io_vec| !io_vec.is_empty()) {
+        let dst = &mut buffer[pos..pos + io_vec.len()];
+        read_bytes_from_user(io_vec.base(), &mut VmWriter::from(dst))?;
+        pos += io_vec.len();
+    }
+    buffer.truncate(pos);
+    Ok(buffer)
+}
+
+fn scatter_to_user(io_vecs: &[IoVec], mut data: &[u8]) -> Result<()> {
+    for io_vec in io_vecs.iter().filter(|io_vec| !io_vec.is_empty()) {
+        if data.is_empty() {
+            break;
+        }
+        let len = io_vec.len().min(data.len());
+        write_bytes_to_user(io_vec.base(), &mut VmReader::from(&data[..len]))?;
+        data = &data[len..];
+    }
+    Ok(())
+}
@@ -8,6 +8,7 @@ pub mod file_handle;
 pub mod file_table;
 pub mod fs_resolver;
 pub mod inode_handle;
+pub mod io_uring;
 pub mod path;
 pub mod pipe;
 pub mod procfs;
@@ -30,15 +31,23 @@ use crate::{
 
 fn start_block_device(device_name: &str) -> Result<Arc<dyn BlockDevice>> {
     if let Some(device) = aster_block::get_device(device_name) {
-        let cloned_device = device.clone();
-        let task_fn = move || {
-            info!("spawn the virt-io-block thread");
-            let virtio_block_device = cloned_device.downcast_ref::<VirtIoBlockDevice>().unwrap();
-            loop {
-                virtio_block_device.handle_requests();
-            }
-        };
-        crate::Thread::spawn_kernel_thread(crate::ThreadOptions::new(task_fn));
+        let num_hw_queues = device
+            .downcast_ref::<VirtIoBlockDevice>()
+            .unwrap()
+            .num_hw_queues();
+        // Each hardware queue is served by its own thread.
+        for hw_index in 0..num_hw_queues {
+            let cloned_device = device.clone();
+            let task_fn = move || {
+                info!("spawn the virt-io-block thread for queue {}", hw_index);
+                let virtio_block_device =
+                    cloned_device.downcast_ref::<VirtIoBlockDevice>().unwrap();
+                loop {
+                    virtio_block_device.handle_requests(hw_index);
+                }
+            };
+            crate::Thread::spawn_kernel_thread(crate::ThreadOptions::new(task_fn));
+        }
         Ok(device)
     } else {
         return_errno_with_message!(Errno::ENOENT, "Device does not exist")
@@ -46,6 +55,8 @@ fn start_block_device(device_name: &str) -> Result<Arc<dyn BlockDevice>> {
 }
 
 pub fn lazy_init() {
+    utils::start_writeback_thread();
+
     //The device name is specified in qemu args as --serial={device_name}
     let ext2_device_name = "vext2";
     let exfat_device_name = "vexfat";
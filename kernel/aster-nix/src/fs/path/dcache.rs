@@ -0,0 +1,256 @@
+// SPDX-License-Identifier: MPL-2.0
+
+//! The cache of the children of dentries.
+
+use core::{
+    hash::BuildHasher,
+    sync::atomic::{fence, AtomicBool, AtomicUsize, Ordering},
+};
+
+use hashbrown::hash_map::DefaultHashBuilder;
+use ostd::sync::Rcu;
+
+use super::dentry::Dentry_;
+use crate::{
+    fs::utils::FsFlags,
+    prelude::*,
+    thread::work_queue::{submit_work_func, WorkPriority},
+};
+
+lazy_static! {
+    pub(super) static ref DCACHE: DentryCache = DentryCache::new();
+}
+
+/// A hash table of the children of dentries, indexed by their parents and names.
+///
+/// Lookups neither lock nor allocate, since each bucket is published with RCU.
+/// The updates of a bucket are serialized by the lock of the bucket.
+///
+/// Besides the existing children, the cache also remembers the names that do not
+/// exist in a directory, i.e., the negative dentries, so that repeated failed
+/// lookups do not go to the file system.
+///
+/// The number of cached children is bounded. When the cache is full, the unused
+/// children are evicted in a least-recently-used manner, which is approximated by
+/// the CLOCK algorithm. An entry is marked as dead before it is evicted, so that
+/// a lookup that races with the eviction does not revive the child.
+pub(super) struct DentryCache {
+    buckets: Box<[Bucket]>,
+    hasher: DefaultHashBuilder,
+    nr_entries: AtomicUsize,
+    /// The next bucket to be scanned by the shrinker.
+    clock_hand: AtomicUsize,
+}
+
+/// A child found in the [`DentryCache`].
+pub(super) enum CachedChild {
+    /// The child exists.
+    Positive(Arc<Dentry_>),
+    /// The child is known not to exist.
+    Negative,
+}
+
+struct Bucket {
+    entries: Rcu<Box<Vec<Arc<CacheEntry>>>>,
+    lock: Mutex<()>,
+}
+
+struct CacheEntry {
+    parent: Arc<Dentry_>,
+    name: String,
+    /// The child, or `None` if it is a negative dentry.
+    child: Option<Arc<Dentry_>>,
+    /// Whether the entry has been looked up since the last scan of the shrinker.
+    referenced: AtomicBool,
+    /// Whether the entry is being evicted or has been evicted.
+    ///
+    /// The flag is set only with the bucket locked, and is cleared before the lock is
+    /// released if the entry turns out to be in use.
+    is_dead: AtomicBool,
+}
+
+const NR_BUCKETS: usize = 1 << 12;
+const MAX_NR_ENTRIES: usize = 1 << 16;
+/// The number of buckets scanned each time the cache is full.
+const NR_SHRINK_BUCKETS: usize = 32;
+
+impl DentryCache {
+    fn new() -> Self {
+        let buckets = (0..NR_BUCKETS)
+            .map(|_| Bucket {
+                entries: Rcu::new(Box::new(Vec::new())),
+                lock: Mutex::new(()),
+            })
+            .collect();
+        Self {
+            buckets,
+            hasher: DefaultHashBuilder::default(),
+            nr_entries: AtomicUsize::new(0),
+            clock_hand: AtomicUsize::new(0),
+        }
+    }
+
+    /// Looks up the child of the parent with the name.
+    ///
+    /// Returns `None` if the child is not cached.
+    pub(super) fn lookup(&self, parent: &Dentry_, name: &str) -> Option<CachedChild> {
+        let bucket = self.bucket(parent, name);
+        {
+            let entries = bucket.entries.read();
+            let entry = entries.iter().find(|entry| entry.is_for(parent, name))?;
+            if !entry.referenced.load(Ordering::Relaxed) {
+                entry.referenced.store(true, Ordering::Relaxed);
+            }
+            let Some(child) = entry.child.as_ref() else {
+                return Some(CachedChild::Negative);
+            };
+
+            // Pairs with the fence in `CacheEntry::try_evict`. Either the shrinker sees
+            // the new reference and keeps the entry, or the entry is seen as dead here.
+            let child = child.clone();
+            fence(Ordering::SeqCst);
+            if !entry.is_dead.load(Ordering::Relaxed) {
+                return Some(CachedChild::Positive(child));
+            }
+        }
+
+        // The entry may be being evicted. With the bucket locked, the eviction has either
+        // been done, or been given up and the entry is alive.
+        let _guard = bucket.lock.lock();
+        let entries = bucket.entries.read();
+        let entry = entries.iter().find(|entry| entry.is_for(parent, name))?;
+        let child = match entry.child.as_ref() {
+            Some(child) => CachedChild::Positive(child.clone()),
+            None => CachedChild::Negative,
+        };
+        Some(child)
+    }
+
+    /// Caches the child of the parent with the name, or a negative dentry
+    /// if the child is `None`.
+    ///
+    /// The entry of the same parent and name is replaced.
+    pub(super) fn insert(&self, parent: &Arc<Dentry_>, name: &str, child: Option<Arc<Dentry_>>) {
+        let new_entry = Arc::new(CacheEntry {
+            parent: parent.clone(),
+            name: String::from(name),
+            child,
+            referenced: AtomicBool::new(true),
+            is_dead: AtomicBool::new(false),
+        });
+        self.bucket(parent, name).update(|entries| {
+            if let Some(entry) = entries.iter_mut().find(|entry| entry.is_for(parent, name)) {
+                *entry = new_entry;
+            } else {
+                entries.push(new_entry);
+                self.nr_entries.fetch_add(1, Ordering::Relaxed);
+            }
+        });
+
+        if self.nr_entries.load(Ordering::Relaxed) > MAX_NR_ENTRIES {
+            self.shrink();
+        }
+    }
+
+    /// Removes the entry of the parent and the name.
+    ///
+    /// Returns the child if the entry is not a negative dentry.
+    pub(super) fn remove(&self, parent: &Dentry_, name: &str) -> Option<Arc<Dentry_>> {
+        let removed_entry = self.bucket(parent, name).update(|entries| {
+            let pos = entries
+                .iter()
+                .position(|entry| entry.is_for(parent, name))?;
+            self.nr_entries.fetch_sub(1, Ordering::Relaxed);
+            Some(entries.swap_remove(pos))
+        })?;
+        removed_entry.child.clone()
+    }
+
+    /// Evicts the unused entries that are not referenced recently.
+    ///
+    /// A referenced entry gets a second chance, i.e., it is kept but becomes
+    /// unreferenced, so it can be evicted by the next scan.
+    fn shrink(&self) {
+        for _ in 0..NR_SHRINK_BUCKETS {
+            let idx = self.clock_hand.fetch_add(1, Ordering::Relaxed) % NR_BUCKETS;
+            let nr_evicted = self.buckets[idx].update(|entries| {
+                let old_len = entries.len();
+                entries.retain(|entry| {
+                    entry.referenced.swap(false, Ordering::Relaxed) || !entry.try_evict()
+                });
+                old_len - entries.len()
+            });
+            self.nr_entries.fetch_sub(nr_evicted, Ordering::Relaxed);
+        }
+    }
+
+    fn bucket(&self, parent: &Dentry_, name: &str) -> &Bucket {
+        let hash = self
+            .hasher
+            .hash_one((parent as *const Dentry_ as usize, name));
+        &self.buckets[hash as usize % NR_BUCKETS]
+    }
+}
+
+impl Bucket {
+    /// Updates the entries of the bucket and publishes them.
+    ///
+    /// The old entries are reclaimed after a grace period without waiting for it.
+    fn update<R>(&self, f: impl FnOnce(&mut Vec<Arc<CacheEntry>>) -> R) -> R {
+        let _guard = self.lock.lock();
+        let mut entries = Vec::clone(&self.entries.read());
+        let res = f(&mut entries);
+        self.entries
+            .replace(Box::new(entries))
+            .delay_with(|old_entries| {
+                // Dropping the last references to the removed dentries may sleep, e.g., to
+                // write back their inodes. So it is done by a worker, instead of in the RCU
+                // softirq.
+                let removed_entries: Vec<CacheEntry> = (*old_entries)
+                    .into_iter()
+                    .filter_map(Arc::into_inner)
+                    .collect();
+                if !removed_entries.is_empty() {
+                    let removed_entries = SpinLock::new(Some(removed_entries));
+                    submit_work_func(
+                        move || drop(removed_entries.lock().take()),
+                        WorkPriority::Normal,
+                    );
+                }
+            });
+        res
+    }
+}
+
+impl CacheEntry {
+    fn is_for(&self, parent: &Dentry_, name: &str) -> bool {
+        core::ptr::eq(Arc::as_ptr(&self.parent), parent) && self.name == name
+    }
+
+    /// Marks the entry as dead if it can be evicted, and returns whether it is dead.
+    ///
+    /// A child is in use if it is referenced elsewhere, e.g., by its cached children,
+    /// the mount nodes or the opened files. Such a child cannot be evicted, otherwise
+    /// the same file may be represented by different dentries.
+    ///
+    /// The entry is marked before its references are counted, so a lock-free lookup
+    /// that gets the child in the meantime is either counted or sees the mark.
+    ///
+    /// This method must be called with the bucket locked.
+    fn try_evict(&self) -> bool {
+        let Some(child) = self.child.as_ref() else {
+            return true;
+        };
+        if child.fs().flags().contains(FsFlags::DENTRY_UNEVICTABLE) {
+            return false;
+        }
+
+        self.is_dead.store(true, Ordering::Relaxed);
+        fence(Ordering::SeqCst);
+        if Arc::strong_count(child) == 1 {
+            return true;
+        }
+        self.is_dead.store(false, Ordering::Relaxed);
+        false
+    }
+}
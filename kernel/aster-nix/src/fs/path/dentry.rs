@@ -13,17 +13,16 @@ use inherit_methods_macro::inherit_methods;
 use crate::{
     fs::{
         device::Device,
-        path::mount::MountNode,
-        utils::{FileSystem, Inode, InodeMode, InodeType, Metadata, NAME_MAX},
+        path::{
+            dcache::{CachedChild, DCACHE},
+            mount::MountNode,
+        },
+        utils::{FileSystem, FsFlags, Inode, InodeMode, InodeType, Metadata, NAME_MAX},
     },
     prelude::*,
     process::{Gid, Uid},
 };
 
-lazy_static! {
-    static ref DCACHE: Mutex<BTreeMap<DentryKey, Arc<Dentry_>>> = Mutex::new(BTreeMap::new());
-}
-
 /// The Dentry_ cache to accelerate path lookup
 pub struct Dentry_ {
     inode: Arc<dyn Inode>,
@@ -39,9 +38,7 @@ impl Dentry_ {
     /// It is been created during the construction of MountNode struct. The MountNode
     /// struct holds an arc reference to this root Dentry_.
     pub(super) fn new_root(inode: Arc<dyn Inode>) -> Arc<Self> {
-        let root = Self::new(inode, DentryOptions::Root);
-        DCACHE.lock().insert(root.key(), root.clone());
-        root
+        Self::new(inode, DentryOptions::Root)
     }
 
     /// Internal constructor.
@@ -54,7 +51,7 @@ impl Dentry_ {
                 _ => RwLock::new(None),
             },
             this: weak_self.clone(),
-            children: Mutex::new(Children::new()),
+            children: Mutex::new(Children::new(weak_self.clone())),
         })
     }
 
@@ -158,16 +155,42 @@ impl Dentry_ {
         Ok(child)
     }
 
-    /// Lookup a Dentry_ from DCACHE.
-    pub fn lookup_via_cache(&self, name: &str) -> Option<Arc<Dentry_>> {
-        let mut children = self.children.lock();
-        children.find_dentry(name)
+    /// Lookup a Dentry_ from DCACHE, or from the filesystem if it is not cached.
+    pub fn lookup(&self, name: &str) -> Result<Arc<Dentry_>> {
+        if let Some(res) = self.lookup_via_cache(name) {
+            return res;
+        }
+        self.lookup_via_fs(name)
+    }
+
+    /// Lookup a Dentry_ from DCACHE without locking.
+    ///
+    /// Returns `None` if the Dentry_ is not cached, or `ENOENT` if it is cached as a
+    /// negative dentry.
+    fn lookup_via_cache(&self, name: &str) -> Option<Result<Arc<Dentry_>>> {
+        match DCACHE.lookup(self, name)? {
+            CachedChild::Positive(dentry) => Some(Ok(dentry)),
+            CachedChild::Negative => Some(Err(Error::new(Errno::ENOENT))),
+        }
     }
 
     /// Lookup a Dentry_ from filesystem.
-    pub fn lookuop_via_fs(&self, name: &str) -> Result<Arc<Dentry_>> {
+    fn lookup_via_fs(&self, name: &str) -> Result<Arc<Dentry_>> {
         let mut children = self.children.lock();
-        let inode = self.inode.lookup(name)?;
+        // The Dentry_ may be looked up by others before the lock is acquired.
+        if let Some(res) = self.lookup_via_cache(name) {
+            return res;
+        }
+
+        let inode = match self.inode.lookup(name) {
+            Ok(inode) => inode,
+            Err(err) => {
+                if err.error() == Errno::ENOENT {
+                    children.insert_negative_dentry(name);
+                }
+                return Err(err);
+            }
+        };
         let inner = Self::new(
             inode,
             DentryOptions::Leaf((String::from(name), self.this())),
@@ -363,43 +386,55 @@ enum DentryOptions {
     Leaf((String, Arc<Dentry_>)),
 }
 
+/// The children of a Dentry_, which are cached in DCACHE.
+///
+/// The lock of the children serializes the updates of them, while the lookups
+/// in DCACHE are lock-free.
 struct Children {
-    inner: BTreeMap<String, Weak<Dentry_>>,
+    dir: Weak<Dentry_>,
 }
 
 impl Children {
-    pub fn new() -> Self {
-        Self {
-            inner: BTreeMap::new(),
-        }
+    pub fn new(dir: Weak<Dentry_>) -> Self {
+        Self { dir }
+    }
+
+    fn dir(&self) -> Arc<Dentry_> {
+        self.dir.upgrade().unwrap()
     }
 
     pub fn insert_dentry(&mut self, dentry: &Arc<Dentry_>) {
-        // Do not cache it in DCACHE and children if is not cacheable.
+        let dir = self.dir();
+        // Do not cache it in DCACHE if is not cacheable.
         // When we look up it from the parent, it will always be newly created.
         if !dentry.inode().is_dentry_cacheable() {
+            DCACHE.remove(&dir, &dentry.name());
+            return;
+        }
+
+        DCACHE.insert(&dir, &dentry.name(), Some(dentry.clone()));
+    }
+
+    /// Caches that there is no child with the name.
+    pub fn insert_negative_dentry(&mut self, name: &str) {
+        let dir = self.dir();
+        if !dir.inode().is_dentry_cacheable()
+            || dir.fs().flags().contains(FsFlags::NO_NEGATIVE_DENTRY)
+        {
             return;
         }
 
-        DCACHE.lock().insert(dentry.key(), dentry.clone());
-        self.inner.insert(dentry.name(), Arc::downgrade(dentry));
+        DCACHE.insert(&dir, name, None);
     }
 
     pub fn delete_dentry(&mut self, name: &str) -> Option<Arc<Dentry_>> {
-        self.inner
-            .remove(name)
-            .and_then(|d| d.upgrade())
-            .and_then(|d| DCACHE.lock().remove(&d.key()))
+        DCACHE.remove(&self.dir(), name)
     }
 
     pub fn find_dentry(&mut self, name: &str) -> Option<Arc<Dentry_>> {
-        if let Some(dentry) = self.inner.get(name) {
-            dentry.upgrade().or_else(|| {
-                self.inner.remove(name);
-                None
-            })
-        } else {
-            None
+        match DCACHE.lookup(&self.dir(), name)? {
+            CachedChild::Positive(dentry) => Some(dentry),
+            CachedChild::Negative => None,
         }
     }
 
@@ -479,14 +514,8 @@ impl Dentry {
             "." => self.this(),
             ".." => self.effective_parent().unwrap_or_else(|| self.this()),
             name => {
-                let children_inner = self.inner.lookup_via_cache(name);
-                match children_inner {
-                    Some(inner) => Self::new(self.mount_node().clone(), inner.clone()),
-                    None => {
-                        let fs_inner = self.inner.lookuop_via_fs(name)?;
-                        Self::new(self.mount_node().clone(), fs_inner.clone())
-                    }
-                }
+                let inner = self.inner.lookup(name)?;
+                Self::new(self.mount_node().clone(), inner)
             }
         };
         let dentry = dentry.get_top_dentry();
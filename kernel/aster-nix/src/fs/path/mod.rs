@@ -5,5 +5,6 @@
 pub use dentry::{Dentry, DentryKey};
 pub use mount::MountNode;
 
+mod dcache;
 mod dentry;
 mod mount;
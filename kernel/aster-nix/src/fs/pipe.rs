@@ -2,42 +2,246 @@
 
 #![allow(dead_code)]
 
+//! Pipes.
+//!
+//! The data of a pipe is kept in a ring of pipe buffers, each of which refers to
+//! a range of bytes within a page frame. `write` copies the data into frames owned
+//! by the pipe, while `splice` and `tee` only move or clone references to frames,
+//! e.g., the page cache frames of a file, so that the data itself is never copied.
+
+use core::sync::atomic::{AtomicBool, AtomicU32, Ordering};
+
+use ostd::mm::{FrameAllocOptions, UserSpace};
+
 use super::{
     file_handle::FileLike,
-    utils::{AccessMode, Consumer, InodeMode, InodeType, Metadata, Producer, StatusFlags},
+    utils::{AccessMode, FrameSlice, InodeMode, InodeType, Metadata, SpliceFlags, StatusFlags},
 };
 use crate::{
     events::{IoEvents, Observer},
     prelude::*,
-    process::{signal::Poller, Gid, Uid},
+    process::{
+        signal::{Pollee, Poller},
+        Gid, Uid,
+    },
     time::clocks::RealTimeCoarseClock,
+    util::{with_user_readers, with_user_writers, IoVec},
 };
 
+/// The default number of pipe buffers of a pipe.
+///
+/// Each pipe buffer holds at most one page of data.
+const DEFAULT_NR_BUFS: usize = 256;
+
+/// The maximum size of a pipe that can be set with `F_SETPIPE_SZ`.
+const MAX_PIPE_SIZE: usize = 16 * 1024 * 1024;
+
+/// Creates a new pipe, returning its read end and its write end.
+pub fn new_pipe(status_flags: StatusFlags) -> Result<(Arc<PipeReader>, Arc<PipeWriter>)> {
+    check_status_flags(status_flags)?;
+
+    let common = Arc::new(Common::new(DEFAULT_NR_BUFS, status_flags));
+    let reader = PipeReader {
+        common: common.clone(),
+    };
+    let writer = PipeWriter { common };
+    Ok((Arc::new(reader), Arc::new(writer)))
+}
+
 pub struct PipeReader {
-    consumer: Consumer<u8>,
+    common: Arc<Common>,
 }
 
 impl PipeReader {
-    pub fn new(consumer: Consumer<u8>) -> Self {
-        Self { consumer }
+    /// Moves at most `max_len` bytes out of the pipe without copying them.
+    ///
+    /// The data is handed to `f` as frame slices, and `f` returns the number of bytes
+    /// that it has consumed, which are then removed from the pipe. The ring is not locked
+    /// while `f` runs, since `f` may block (e.g., on a full socket), so the writers can
+    /// still fill the pipe. Only the other readers wait, so that none of them can consume
+    /// the same data.
+    ///
+    /// Returns zero if the write end has been closed and the pipe is empty.
+    pub fn splice_out<F>(&self, max_len: usize, is_nonblocking: bool, mut f: F) -> Result<usize>
+    where
+        F: FnMut(&[FrameSlice]) -> Result<usize>,
+    {
+        let is_nonblocking = is_nonblocking || self.is_nonblocking();
+        let mut frames = Vec::new();
+        let common = &self.common;
+        // An `EAGAIN` error returned by `f` is not retried, since waiting for the pipe
+        // does not help. So errors of `f` are returned in the inner `Result`.
+        wait_events(
+            is_nonblocking,
+            &[(&common.reader.pollee, IoEvents::IN)],
+            || {
+                if max_len == 0 {
+                    return Ok(Ok(0));
+                }
+
+                let _read_guard = common.read_lock.lock();
+                {
+                    let ring = common.ring.lock();
+                    if ring.is_empty() {
+                        return common.check_read_eof().map(Ok);
+                    }
+                    frames.clear();
+                    ring.peek(max_len, &mut frames);
+                }
+
+                // The peeked data stays at the head of the ring, since only the readers,
+                // which are excluded by the read lock, consume data.
+                Ok(f(&frames).map(|len| {
+                    let mut ring = common.ring.lock();
+                    ring.consume(len);
+                    common.update_pollee(&ring);
+                    len
+                }))
+            },
+        )?
+    }
+
+    /// Moves at most `max_len` bytes from this pipe to another pipe without copying them.
+    pub fn splice_to(
+        &self,
+        writer: &PipeWriter,
+        max_len: usize,
+        is_nonblocking: bool,
+    ) -> Result<usize> {
+        self.transfer_to(writer, max_len, is_nonblocking, true)
+    }
+
+    /// Duplicates at most `max_len` bytes from this pipe to another pipe without
+    /// consuming or copying them.
+    pub fn tee_to(
+        &self,
+        writer: &PipeWriter,
+        max_len: usize,
+        is_nonblocking: bool,
+    ) -> Result<usize> {
+        self.transfer_to(writer, max_len, is_nonblocking, false)
+    }
+
+    fn transfer_to(
+        &self,
+        writer: &PipeWriter,
+        max_len: usize,
+        is_nonblocking: bool,
+        consume: bool,
+    ) -> Result<usize> {
+        let src = &self.common;
+        let dst = &writer.common;
+        if Arc::ptr_eq(src, dst) {
+            return_errno_with_message!(
+                Errno::EINVAL,
+                "the source and the destination are the same pipe"
+            );
+        }
+
+        let is_nonblocking = is_nonblocking || self.is_nonblocking() || writer.is_nonblocking();
+        let mut frames = Vec::new();
+        let pollees = [
+            (&src.reader.pollee, IoEvents::IN),
+            (&dst.writer.pollee, IoEvents::OUT),
+        ];
+        wait_events(is_nonblocking, &pollees, || {
+            if max_len == 0 {
+                return Ok(0);
+            }
+
+            let _read_guard = consume.then(|| src.read_lock.lock());
+            // Lock the two pipes in a fixed order to avoid deadlocks with a transfer
+            // in the opposite direction.
+            let (mut src_ring, mut dst_ring) = if Arc::as_ptr(src) < Arc::as_ptr(dst) {
+                let src_ring = src.ring.lock();
+                (src_ring, dst.ring.lock())
+            } else {
+                let dst_ring = dst.ring.lock();
+                (src.ring.lock(), dst_ring)
+            };
+
+            if dst.is_read_end_closed() {
+                return_errno_with_message!(Errno::EPIPE, "the read end of the pipe is closed");
+            }
+            if src_ring.is_empty() {
+                return src.check_read_eof();
+            }
+            if dst_ring.is_full() {
+                return_errno_with_message!(Errno::EAGAIN, "the pipe is full");
+            }
+
+            frames.clear();
+            src_ring.peek(max_len.min(dst_ring.free_len()), &mut frames);
+            let len = dst_ring.push_frames(&frames);
+            if consume {
+                src_ring.consume(len);
+                src.update_pollee(&src_ring);
+            }
+            dst.update_pollee(&dst_ring);
+            Ok(len)
+        })
+    }
+
+    /// Returns the capacity of the pipe in bytes.
+    pub fn capacity(&self) -> usize {
+        self.common.capacity()
+    }
+
+    /// Sets the capacity of the pipe, returning the actual capacity in bytes.
+    pub fn set_capacity(&self, size: usize) -> Result<usize> {
+        self.common.set_capacity(size)
+    }
+
+    fn read_with<S: PipeSink + ?Sized>(&self, sink: &mut S) -> Result<usize> {
+        let common = &self.common;
+        wait_events(
+            self.is_nonblocking(),
+            &[(&common.reader.pollee, IoEvents::IN)],
+            || {
+                if !sink.has_avail() {
+                    return Ok(0);
+                }
+
+                let _read_guard = common.read_lock.lock();
+                let mut ring = common.ring.lock();
+                if ring.is_empty() {
+                    return common.check_read_eof();
+                }
+
+                let len = ring.read(sink)?;
+                common.update_pollee(&ring);
+                Ok(len)
+            },
+        )
+    }
+
+    fn is_nonblocking(&self) -> bool {
+        self.common
+            .reader
+            .status_flags()
+            .contains(StatusFlags::O_NONBLOCK)
     }
 }
 
 impl FileLike for PipeReader {
     fn read(&self, buf: &mut [u8]) -> Result<usize> {
-        self.consumer.read(buf)
+        self.read_with(&mut VmWriter::from(buf))
+    }
+
+    fn read_vectored(&self, io_vecs: &[IoVec]) -> Result<usize> {
+        with_user_writers(io_vecs, |writers| self.read_with(writers))
     }
 
     fn poll(&self, mask: IoEvents, poller: Option<&Poller>) -> IoEvents {
-        self.consumer.poll(mask, poller)
+        self.common.reader.pollee.poll(mask, poller)
     }
 
     fn status_flags(&self) -> StatusFlags {
-        self.consumer.status_flags()
+        self.common.reader.status_flags()
     }
 
     fn set_status_flags(&self, new_flags: StatusFlags) -> Result<()> {
-        self.consumer.set_status_flags(new_flags)
+        self.common.reader.set_status_flags(new_flags)
     }
 
     fn access_mode(&self) -> AccessMode {
@@ -45,23 +249,7 @@ impl FileLike for PipeReader {
     }
 
     fn metadata(&self) -> Metadata {
-        let now = RealTimeCoarseClock::get().read_time();
-        Metadata {
-            dev: 0,
-            ino: 0,
-            size: 0,
-            blk_size: 0,
-            blocks: 0,
-            atime: now,
-            mtime: now,
-            ctime: now,
-            type_: InodeType::NamedPipe,
-            mode: InodeMode::from_bits_truncate(0o400),
-            nlinks: 1,
-            uid: Uid::new_root(),
-            gid: Gid::new_root(),
-            rdev: 0,
-        }
+        pipe_metadata(InodeMode::from_bits_truncate(0o400))
     }
 
     fn register_observer(
@@ -69,42 +257,143 @@ impl FileLike for PipeReader {
         observer: Weak<dyn Observer<IoEvents>>,
         mask: IoEvents,
     ) -> Result<()> {
-        self.consumer.register_observer(observer, mask)
+        self.common.reader.pollee.register_observer(observer, mask);
+        Ok(())
     }
 
     fn unregister_observer(
         &self,
         observer: &Weak<dyn Observer<IoEvents>>,
     ) -> Option<Weak<dyn Observer<IoEvents>>> {
-        self.consumer.unregister_observer(observer)
+        self.common.reader.pollee.unregister_observer(observer)
+    }
+}
+
+impl Drop for PipeReader {
+    fn drop(&mut self) {
+        let common = &self.common;
+        let _ring = common.ring.lock();
+        common.reader.shutdown();
+
+        // POLLERR is also set for a file descriptor referring to the write end of a pipe
+        // when the read end has been closed.
+        common.writer.pollee.add_events(IoEvents::ERR);
     }
 }
 
 pub struct PipeWriter {
-    producer: Producer<u8>,
+    common: Arc<Common>,
 }
 
 impl PipeWriter {
-    pub fn new(producer: Producer<u8>) -> Self {
-        Self { producer }
+    /// Waits until the pipe has a free pipe buffer.
+    pub fn wait_writable(&self, is_nonblocking: bool) -> Result<()> {
+        let is_nonblocking = is_nonblocking || self.is_nonblocking();
+        let common = &self.common;
+        wait_events(
+            is_nonblocking,
+            &[(&common.writer.pollee, IoEvents::OUT)],
+            || {
+                let ring = common.ring.lock();
+                common.check_write()?;
+                if ring.is_full() {
+                    return_errno_with_message!(Errno::EAGAIN, "the pipe is full");
+                }
+                Ok(())
+            },
+        )
+    }
+
+    /// Puts references to the frame slices into the pipe without copying the data.
+    ///
+    /// Each frame slice takes up a pipe buffer. Returns the number of bytes
+    /// of the frame slices that have been put into the pipe.
+    pub fn splice_in(&self, frames: &[FrameSlice], is_nonblocking: bool) -> Result<usize> {
+        let is_nonblocking = is_nonblocking || self.is_nonblocking();
+        let common = &self.common;
+        wait_events(
+            is_nonblocking,
+            &[(&common.writer.pollee, IoEvents::OUT)],
+            || {
+                if frames.is_empty() {
+                    return Ok(0);
+                }
+
+                let mut ring = common.ring.lock();
+                common.check_write()?;
+                let len = ring.push_frames(frames);
+                common.update_pollee(&ring);
+                if len == 0 {
+                    return_errno_with_message!(Errno::EAGAIN, "the pipe is full");
+                }
+                Ok(len)
+            },
+        )
+    }
+
+    /// Returns the capacity of the pipe in bytes.
+    pub fn capacity(&self) -> usize {
+        self.common.capacity()
+    }
+
+    /// Sets the capacity of the pipe, returning the actual capacity in bytes.
+    pub fn set_capacity(&self, size: usize) -> Result<usize> {
+        self.common.set_capacity(size)
+    }
+
+    fn write_with<S: PipeSource + ?Sized>(&self, source: &mut S) -> Result<usize> {
+        let common = &self.common;
+        wait_events(
+            self.is_nonblocking(),
+            &[(&common.writer.pollee, IoEvents::OUT)],
+            || {
+                let mut ring = common.ring.lock();
+                common.check_write()?;
+                if !source.has_remain() {
+                    return Ok(0);
+                }
+
+                let len = ring.write(source)?;
+                common.update_pollee(&ring);
+                if len == 0 {
+                    return_errno_with_message!(Errno::EAGAIN, "the pipe is full");
+                }
+                Ok(len)
+            },
+        )
+    }
+
+    fn is_nonblocking(&self) -> bool {
+        self.common
+            .writer
+            .status_flags()
+            .contains(StatusFlags::O_NONBLOCK)
     }
 }
 
 impl FileLike for PipeWriter {
     fn write(&self, buf: &[u8]) -> Result<usize> {
-        self.producer.write(buf)
+        self.write_with(&mut VmReader::from(buf))
+    }
+
+    fn write_vectored(&self, io_vecs: &[IoVec]) -> Result<usize> {
+        with_user_readers(io_vecs, |readers| self.write_with(readers))
+    }
+
+    fn write_frames(&self, frames: &[FrameSlice], flags: SpliceFlags) -> Result<usize> {
+        self.splice_in(frames, flags.contains(SpliceFlags::SPLICE_F_NONBLOCK))
     }
 
     fn poll(&self, mask: IoEvents, poller: Option<&Poller>) -> IoEvents {
-        self.producer.poll(mask, poller)
+        self.common.writer.pollee.poll(mask, poller)
     }
 
     fn status_flags(&self) -> StatusFlags {
-        self.producer.status_flags()
+        self.common.writer.status_flags()
     }
 
     fn set_status_flags(&self, new_flags: StatusFlags) -> Result<()> {
-        self.producer.set_status_flags(new_flags)
+        self.common.writer.set_status_flags(new_flags)
     }
 
     fn access_mode(&self) -> AccessMode {
@@ -112,23 +401,7 @@ impl FileLike for PipeWriter {
     }
 
     fn metadata(&self) -> Metadata {
-        let now = RealTimeCoarseClock::get().read_time();
-        Metadata {
-            dev: 0,
-            ino: 0,
-            size: 0,
-            blk_size: 0,
-            blocks: 0,
-            atime: now,
-            mtime: now,
-            ctime: now,
-            type_: InodeType::NamedPipe,
-            mode: InodeMode::from_bits_truncate(0o200),
-            nlinks: 1,
-            uid: Uid::new_root(),
-            gid: Gid::new_root(),
-            rdev: 0,
-        }
+        pipe_metadata(InodeMode::from_bits_truncate(0o200))
     }
 
     fn register_observer(
@@ -136,24 +409,461 @@ impl FileLike for PipeWriter {
         observer: Weak<dyn Observer<IoEvents>>,
         mask: IoEvents,
     ) -> Result<()> {
-        self.producer.register_observer(observer, mask)
+        self.common.writer.pollee.register_observer(observer, mask);
+        Ok(())
     }
 
     fn unregister_observer(
         &self,
         observer: &Weak<dyn Observer<IoEvents>>,
     ) -> Option<Weak<dyn Observer<IoEvents>>> {
-        self.producer.unregister_observer(observer)
+        self.common.writer.pollee.unregister_observer(observer)
+    }
+}
+
+impl Drop for PipeWriter {
+    fn drop(&mut self) {
+        let common = &self.common;
+        let _ring = common.ring.lock();
+        common.writer.shutdown();
+
+        // When reading from a channel such as a pipe or a stream socket,
+        // POLLHUP merely indicates that the peer closed its end of the channel.
+        common.reader.pollee.add_events(IoEvents::HUP);
+    }
+}
+
+fn pipe_metadata(mode: InodeMode) -> Metadata {
+    let now = RealTimeCoarseClock::get().read_time();
+    Metadata {
+        dev: 0,
+        ino: 0,
+        size: 0,
+        blk_size: 0,
+        blocks: 0,
+        atime: now,
+        mtime: now,
+        ctime: now,
+        type_: InodeType::NamedPipe,
+        mode,
+        nlinks: 1,
+        uid: Uid::new_root(),
+        gid: Gid::new_root(),
+        rdev: 0,
+    }
+}
+
+/// The states shared by the two ends of a pipe.
+struct Common {
+    ring: Mutex<PipeRing>,
+    /// The lock that serializes the readers, which consume the data at the head of the ring.
+    ///
+    /// It is acquired before the ring, and is held by [`PipeReader::splice_out`] while
+    /// the peeked data is being written elsewhere without the ring locked.
+    read_lock: Mutex<()>,
+    reader: EndPoint,
+    writer: EndPoint,
+}
+
+impl Common {
+    fn new(nr_bufs: usize, status_flags: StatusFlags) -> Self {
+        Self {
+            ring: Mutex::new(PipeRing::new(nr_bufs)),
+            read_lock: Mutex::new(()),
+            reader: EndPoint::new(IoEvents::empty(), status_flags),
+            writer: EndPoint::new(IoEvents::OUT, status_flags),
+        }
+    }
+
+    fn is_read_end_closed(&self) -> bool {
+        self.reader.is_shutdown()
+    }
+
+    /// Returns an `Ok(0)` for the end of file if the write end has been closed,
+    /// or an `EAGAIN` error otherwise.
+    ///
+    /// This method must be called with the ring locked and empty.
+    fn check_read_eof(&self) -> Result<usize> {
+        if self.writer.is_shutdown() {
+            Ok(0)
+        } else {
+            return_errno_with_message!(Errno::EAGAIN, "the pipe is empty");
+        }
+    }
+
+    fn check_write(&self) -> Result<()> {
+        if self.is_read_end_closed() {
+            return_errno_with_message!(Errno::EPIPE, "the read end of the pipe is closed");
+        }
+        Ok(())
+    }
+
+    fn capacity(&self) -> usize {
+        self.ring.lock().max_bufs * PAGE_SIZE
+    }
+
+    /// Sets the capacity of the pipe.
+    ///
+    /// The capacity is rounded up to a power-of-two number of pages. It cannot
+    /// be smaller than the data that is currently in the pipe.
+    fn set_capacity(&self, size: usize) -> Result<usize> {
+        if size > MAX_PIPE_SIZE {
+            return_errno_with_message!(Errno::EPERM, "the pipe size is too large");
+        }
+        let nr_bufs = size.div_ceil(PAGE_SIZE).max(1).next_power_of_two();
+
+        let mut ring = self.ring.lock();
+        if ring.bufs.len() > nr_bufs {
+            return_errno_with_message!(Errno::EBUSY, "the pipe holds too much data");
+        }
+        ring.max_bufs = nr_bufs;
+        self.update_pollee(&ring);
+        Ok(nr_bufs * PAGE_SIZE)
+    }
+
+    /// Updates the events of the two ends.
+    ///
+    /// The ring is locked so that the events always reflect the _true_ state
+    /// of the ring regardless of any race conditions.
+    ///
+    /// The observers are only notified when the ring becomes non-empty or non-full,
+    /// since a blocked reader or writer only waits for these transitions. So a stream
+    /// of small writes wakes up the reader once rather than once per write.
+    fn update_pollee(&self, ring: &PipeRing) {
+        update_events(&self.reader.pollee, IoEvents::IN, !ring.is_empty());
+        update_events(&self.writer.pollee, IoEvents::OUT, !ring.is_full());
     }
 }
 
-fn should_io_return(res: &Result<usize>, is_nonblocking: bool) -> bool {
-    if is_nonblocking {
-        return true;
+/// Adds the events to the pollee if `is_set` is true, or deletes them otherwise.
+///
+/// Unlike `Pollee::add_events`, the observers are not notified if the events
+/// are already there.
+fn update_events(pollee: &Pollee, events: IoEvents, is_set: bool) {
+    let is_present = pollee.poll(events, None).contains(events);
+    if is_set && !is_present {
+        pollee.add_events(events);
+    } else if !is_set && is_present {
+        pollee.del_events(events);
     }
-    match res {
-        Ok(_) => true,
-        Err(e) if e.error() == Errno::EAGAIN => false,
-        Err(_) => true,
+}
+
+struct EndPoint {
+    pollee: Pollee,
+    is_shutdown: AtomicBool,
+    status_flags: AtomicU32,
+}
+
+impl EndPoint {
+    fn new(init_events: IoEvents, status_flags: StatusFlags) -> Self {
+        Self {
+            pollee: Pollee::new(init_events),
+            is_shutdown: AtomicBool::new(false),
+            status_flags: AtomicU32::new(status_flags.bits()),
+        }
+    }
+
+    fn is_shutdown(&self) -> bool {
+        self.is_shutdown.load(Ordering::Acquire)
+    }
+
+    fn shutdown(&self) {
+        self.is_shutdown.store(true, Ordering::Release)
+    }
+
+    fn status_flags(&self) -> StatusFlags {
+        let bits = self.status_flags.load(Ordering::Relaxed);
+        StatusFlags::from_bits(bits).unwrap()
+    }
+
+    fn set_status_flags(&self, new_flags: StatusFlags) -> Result<()> {
+        check_status_flags(new_flags)?;
+        self.status_flags.store(new_flags.bits(), Ordering::Relaxed);
+        Ok(())
+    }
+}
+
+/// The ring of pipe buffers.
+struct PipeRing {
+    bufs: VecDeque<PipeBuf>,
+    max_bufs: usize,
+}
+
+/// A pipe buffer, which refers to a range of bytes within a page frame.
+struct PipeBuf {
+    slice: FrameSlice,
+    /// Whether the frame is owned by the pipe, so that later writes can append
+    /// data after the end of the slice.
+    ///
+    /// The bytes after the end of the slice are never referenced by others, even if
+    /// the slice has been cloned by `tee`, so appending to them is always safe.
+    can_merge: bool,
+}
+
+impl PipeRing {
+    fn new(max_bufs: usize) -> Self {
+        Self {
+            bufs: VecDeque::with_capacity(max_bufs),
+            max_bufs,
+        }
+    }
+
+    fn is_empty(&self) -> bool {
+        self.bufs.is_empty()
+    }
+
+    fn is_full(&self) -> bool {
+        self.bufs.len() >= self.max_bufs
+    }
+
+    /// Returns the number of bytes that can be put into the free pipe buffers.
+    fn free_len(&self) -> usize {
+        (self.max_bufs - self.bufs.len()) * PAGE_SIZE
+    }
+
+    /// Copies data from the source into the pipe.
+    fn write<S: PipeSource + ?Sized>(&mut self, source: &mut S) -> Result<usize> {
+        let mut written_len = 0;
+        while source.has_remain() {
+            if let Some(buf) = self.bufs.back_mut()
+                && buf.can_merge
+                && buf.slice.range().end < PAGE_SIZE
+            {
+                let range = buf.slice.range();
+                let res = source.copy_into(&mut buf.slice.frame().writer().skip(range.end));
+                let len = match res {
+                    Ok(len) if len > 0 => len,
+                    res => {
+                        // Do not leave behind an empty pipe buffer.
+                        if buf.slice.is_empty() {
+                            self.bufs.pop_back();
+                        }
+                        match res {
+                            Err(err) if written_len == 0 => return Err(err),
+                            _ => break,
+                        }
+                    }
+                };
+                buf.slice =
+                    FrameSlice::new(buf.slice.frame().clone(), range.start..range.end + len);
+                written_len += len;
+                continue;
+            }
+
+            if self.is_full() {
+                break;
+            }
+            let frame = match FrameAllocOptions::new(1).uninit(true).alloc_single() {
+                Ok(frame) => frame,
+                Err(_) if written_len > 0 => break,
+                Err(err) => return Err(err.into()),
+            };
+            self.bufs.push_back(PipeBuf {
+                slice: FrameSlice::new(frame, 0..0),
+                can_merge: true,
+            });
+        }
+        Ok(written_len)
+    }
+
+    /// Copies data from the pipe into the sink, consuming the data.
+    fn read<S: PipeSink + ?Sized>(&mut self, sink: &mut S) -> Result<usize> {
+        let mut read_len = 0;
+        while sink.has_avail()
+            && let Some(buf) = self.bufs.front()
+        {
+            let len = match sink.copy_from(&mut buf.slice.reader()) {
+                Ok(len) => len,
+                Err(_) if read_len > 0 => break,
+                Err(err) => return Err(err),
+            };
+            if len == 0 {
+                break;
+            }
+            read_len += len;
+            self.consume(len);
+        }
+        Ok(read_len)
+    }
+
+    /// Puts references to the frame slices into the free pipe buffers.
+    fn push_frames(&mut self, frames: &[FrameSlice]) -> usize {
+        let mut pushed_len = 0;
+        for frame in frames.iter().filter(|frame| !frame.is_empty()) {
+            if self.is_full() {
+                break;
+            }
+            self.bufs.push_back(PipeBuf {
+                slice: frame.clone(),
+                can_merge: false,
+            });
+            pushed_len += frame.len();
+        }
+        pushed_len
+    }
+
+    /// Clones the references to at most `max_len` bytes at the head of the pipe.
+    fn peek(&self, max_len: usize, frames: &mut Vec<FrameSlice>) {
+        let mut remain = max_len;
+        for buf in self.bufs.iter() {
+            if remain == 0 {
+                break;
+            }
+            let slice = buf.slice.clone().limit(remain);
+            remain -= slice.len();
+            frames.push(slice);
+        }
+    }
+
+    /// Removes `len` bytes from the head of the pipe.
+    fn consume(&mut self, mut len: usize) {
+        while len > 0 {
+            let buf = self.bufs.front_mut().unwrap();
+            if len < buf.slice.len() {
+                buf.slice = buf.slice.clone().skip(len);
+                return;
+            }
+            len -= buf.slice.len();
+            self.bufs.pop_front();
+        }
+    }
+}
+
+/// A source of the data that is copied into a pipe.
+trait PipeSource {
+    fn has_remain(&self) -> bool;
+
+    /// Copies data into the writer, returning the number of bytes copied.
+    ///
+    /// If an error occurs after some bytes have been copied, the number of
+    /// the copied bytes is returned, and the error is reported by the next call.
+    fn copy_into(&mut self, writer: &mut VmWriter) -> Result<usize>;
+}
+
+impl PipeSource for VmReader<'_> {
+    fn has_remain(&self) -> bool {
+        VmReader::has_remain(self)
+    }
+
+    fn copy_into(&mut self, writer: &mut VmWriter) -> Result<usize> {
+        Ok(self.read(writer))
+    }
+}
+
+/// The user space buffers of IO vectors, which are copied into the pipe in order.
+impl PipeSource for [VmReader<'_, UserSpace>] {
+    fn has_remain(&self) -> bool {
+        self.iter().any(|reader| reader.has_remain())
+    }
+
+    fn copy_into(&mut self, writer: &mut VmWriter) -> Result<usize> {
+        let mut copied_len = 0;
+        for reader in self.iter_mut() {
+            if !writer.has_avail() {
+                break;
+            }
+            match reader.read_fallible(writer) {
+                Ok(len) => copied_len += len,
+                Err((_, len)) if copied_len + len > 0 => return Ok(copied_len + len),
+                Err((err, _)) => return Err(err.into()),
+            }
+        }
+        Ok(copied_len)
+    }
+}
+
+/// A sink of the data that is copied out of a pipe.
+trait PipeSink {
+    fn has_avail(&self) -> bool;
+
+    /// Copies data from the reader, returning the number of bytes copied.
+    ///
+    /// If an error occurs after some bytes have been copied, the number of
+    /// the copied bytes is returned, and the error is reported by the next call.
+    fn copy_from(&mut self, reader: &mut VmReader) -> Result<usize>;
+}
+
+impl PipeSink for VmWriter<'_> {
+    fn has_avail(&self) -> bool {
+        VmWriter::has_avail(self)
+    }
+
+    fn copy_from(&mut self, reader: &mut VmReader) -> Result<usize> {
+        Ok(self.write(reader))
+    }
+}
+
+/// The user space buffers of IO vectors, which are filled by the pipe in order.
+impl PipeSink for [VmWriter<'_, UserSpace>] {
+    fn has_avail(&self) -> bool {
+        self.iter().any(|writer| writer.has_avail())
+    }
+
+    fn copy_from(&mut self, reader: &mut VmReader) -> Result<usize> {
+        let mut copied_len = 0;
+        for writer in self.iter_mut() {
+            if !reader.has_remain() {
+                break;
+            }
+            match writer.write_fallible(reader) {
+                Ok(len) => copied_len += len,
+                Err((_, len)) if copied_len + len > 0 => return Ok(copied_len + len),
+                Err((err, _)) => return Err(err.into()),
+            }
+        }
+        Ok(copied_len)
+    }
+}
+
+fn check_status_flags(flags: StatusFlags) -> Result<()> {
+    let valid_flags: StatusFlags = StatusFlags::O_NONBLOCK | StatusFlags::O_DIRECT;
+    if !valid_flags.contains(flags) {
+        return_errno_with_message!(Errno::EINVAL, "invalid flags");
+    }
+    if flags.contains(StatusFlags::O_DIRECT) {
+        return_errno_with_message!(Errno::EINVAL, "O_DIRECT is not supported");
     }
+    Ok(())
+}
+
+/// Calls `cond` until it does not fail with `EAGAIN`, waiting for the given events
+/// of the pollees in between if `is_nonblocking` is false.
+fn wait_events<F, R>(
+    is_nonblocking: bool,
+    pollees: &[(&Pollee, IoEvents)],
+    mut cond: F,
+) -> Result<R>
+where
+    F: FnMut() -> Result<R>,
+{
+    // Fast path
+    let res = cond();
+    if is_nonblocking || !is_eagain(&res) {
+        return res;
+    }
+
+    // Slow path
+    let poller = Poller::new();
+    loop {
+        let res = cond();
+        if !is_eagain(&res) {
+            return res;
+        }
+
+        // Register the poller to all pollees, and wait if any of them is not ready.
+        let mut is_ready = true;
+        for (pollee, mask) in pollees {
+            if pollee.poll(*mask, Some(&poller)).is_empty() {
+                is_ready = false;
+            }
+        }
+        if !is_ready {
+            // FIXME: should pipe deal with timeout?
+            poller.wait()?;
+        }
+    }
+}
+
+fn is_eagain<R>(res: &Result<R>) -> bool {
+    matches!(res, Err(err) if err.error() == Errno::EAGAIN)
 }
@@ -4,7 +4,10 @@ use core::sync::atomic::{AtomicU64, Ordering};
 
 use self::{
     pid::PidDirOps,
+    rcu_stats::RcuStatsFileOps,
     self_::SelfSymOps,
+    softirq_stats::SoftIrqStatsFileOps,
+    syscall_stats::SyscallStatsFileOps,
     template::{DirOps, ProcDir, ProcDirBuilder, ProcSymBuilder, SymOps},
 };
 use crate::{
@@ -15,7 +18,10 @@ use crate::{
 };
 
 mod pid;
+mod rcu_stats;
 mod self_;
+mod softirq_stats;
+mod syscall_stats;
 mod template;
 
 /// Magic number.
@@ -59,7 +65,7 @@ impl FileSystem for ProcFS {
     }
 
     fn flags(&self) -> FsFlags {
-        FsFlags::empty()
+        FsFlags::NO_NEGATIVE_DENTRY
     }
 }
 
@@ -91,6 +97,12 @@ impl DirOps for RootDirOps {
     fn lookup_child(&self, this_ptr: Weak<dyn Inode>, name: &str) -> Result<Arc<dyn Inode>> {
         let child = if name == "self" {
             SelfSymOps::new_inode(this_ptr.clone())
+        } else if name == "rcu_stats" {
+            RcuStatsFileOps::new_inode(this_ptr.clone())
+        } else if name == "softirq_stats" {
+            SoftIrqStatsFileOps::new_inode(this_ptr.clone())
+        } else if name == "syscall_stats" {
+            SyscallStatsFileOps::new_inode(this_ptr.clone())
         } else if let Ok(pid) = name.parse::<Pid>() {
             let process_ref =
                 process_table::get_process(pid).ok_or_else(|| Error::new(Errno::ENOENT))?;
@@ -108,6 +120,14 @@ impl DirOps for RootDirOps {
         };
         let mut cached_children = this.cached_children().write();
         cached_children.put_entry_if_not_found("self", || SelfSymOps::new_inode(this_ptr.clone()));
+        cached_children
+            .put_entry_if_not_found("rcu_stats", || RcuStatsFileOps::new_inode(this_ptr.clone()));
+        cached_children.put_entry_if_not_found("softirq_stats", || {
+            SoftIrqStatsFileOps::new_inode(this_ptr.clone())
+        });
+        cached_children.put_entry_if_not_found("syscall_stats", || {
+            SyscallStatsFileOps::new_inode(this_ptr.clone())
+        });
 
         for process in process_table::process_table().iter() {
             let pid = process.pid().to_string();
@@ -1,6 +1,9 @@
 // SPDX-License-Identifier: MPL-2.0
 
-use self::{cmdline::CmdlineFileOps, comm::CommFileOps, exe::ExeSymOps, fd::FdDirOps};
+use self::{
+    cmdline::CmdlineFileOps, comm::CommFileOps, exe::ExeSymOps, fd::FdDirOps,
+    schedstat::SchedStatFileOps,
+};
 use super::template::{DirOps, ProcDir, ProcDirBuilder};
 use crate::{
     events::Observer,
@@ -16,6 +19,7 @@ mod cmdline;
 mod comm;
 mod exe;
 mod fd;
+mod schedstat;
 
 /// Represents the inode at `/proc/[pid]`.
 pub struct PidDirOps(Arc<Process>);
@@ -51,6 +55,7 @@ impl DirOps for PidDirOps {
             "comm" => CommFileOps::new_inode(self.0.clone(), this_ptr.clone()),
             "fd" => FdDirOps::new_inode(self.0.clone(), this_ptr.clone()),
             "cmdline" => CmdlineFileOps::new_inode(self.0.clone(), this_ptr.clone()),
+            "schedstat" => SchedStatFileOps::new_inode(self.0.clone(), this_ptr.clone()),
             _ => return_errno!(Errno::ENOENT),
         };
         Ok(inode)
@@ -74,5 +79,8 @@ impl DirOps for PidDirOps {
         cached_children.put_entry_if_not_found("cmdline", || {
             CmdlineFileOps::new_inode(self.0.clone(), this_ptr.clone())
         });
+        cached_children.put_entry_if_not_found("schedstat", || {
+            SchedStatFileOps::new_inode(self.0.clone(), this_ptr.clone())
+        });
     }
 }
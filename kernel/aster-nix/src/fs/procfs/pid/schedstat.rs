@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: MPL-2.0
+
+use alloc::format;
+
+use crate::{
+    fs::{
+        procfs::template::{FileOps, ProcFileBuilder},
+        utils::Inode,
+    },
+    prelude::*,
+    Process,
+};
+
+/// Represents the inode at `/proc/[pid]/schedstat`.
+///
+/// As in Linux, the file contains three numbers for the main thread of the process:
+/// the time spent on the CPU (in nanoseconds), the time spent waiting in a run queue
+/// (in nanoseconds), and the number of timeslices run on the CPU.
+pub struct SchedStatFileOps(Arc<Process>);
+
+impl SchedStatFileOps {
+    pub fn new_inode(process_ref: Arc<Process>, parent: Weak<dyn Inode>) -> Arc<dyn Inode> {
+        ProcFileBuilder::new(Self(process_ref))
+            .parent(parent)
+            .build()
+            .unwrap()
+    }
+}
+
+impl FileOps for SchedStatFileOps {
+    fn data(&self) -> Result<Vec<u8>> {
+        let Some(main_thread) = self.0.main_thread() else {
+            return Ok(b"0 0 0\n".to_vec());
+        };
+        let sched_entity = main_thread.sched_entity();
+        let output = format!(
+            "{} {} {}\n",
+            sched_entity.sum_exec_runtime().as_nanos(),
+            sched_entity.sum_wait_time().as_nanos(),
+            sched_entity.nr_timeslices()
+        );
+        Ok(output.into_bytes())
+    }
+}
@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: MPL-2.0
+
+use core::fmt::Write;
+
+use ostd::sync::rcu_stats;
+
+use crate::{
+    fs::{
+        procfs::template::{FileOps, ProcFileBuilder},
+        utils::Inode,
+    },
+    prelude::*,
+};
+
+/// Represents the inode at `/proc/rcu_stats`.
+///
+/// Each line of the file contains the name and the value of a statistic of RCU,
+/// including the latency (in nanoseconds) of grace periods and the number of
+/// pending callbacks.
+pub struct RcuStatsFileOps;
+
+impl RcuStatsFileOps {
+    pub fn new_inode(parent: Weak<dyn Inode>) -> Arc<dyn Inode> {
+        ProcFileBuilder::new(Self).parent(parent).build().unwrap()
+    }
+}
+
+impl FileOps for RcuStatsFileOps {
+    fn data(&self) -> Result<Vec<u8>> {
+        let stats = rcu_stats();
+        let mut output = String::new();
+        writeln!(output, "grace_periods {}", stats.nr_grace_periods).unwrap();
+        writeln!(output, "avg_gp_latency_ns {}", stats.avg_gp_latency_ns).unwrap();
+        writeln!(output, "max_gp_latency_ns {}", stats.max_gp_latency_ns).unwrap();
+        writeln!(output, "pending_callbacks {}", stats.nr_pending_callbacks).unwrap();
+        writeln!(output, "invoked_callbacks {}", stats.nr_invoked_callbacks).unwrap();
+        writeln!(output, "quiescent_states {}", stats.nr_quiescent_states).unwrap();
+        Ok(output.into_bytes())
+    }
+}
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: MPL-2.0
+
+use core::fmt::Write;
+
+use ostd::trap::SoftIrqLine;
+
+use crate::{
+    fs::{
+        procfs::template::{FileOps, ProcFileBuilder},
+        utils::Inode,
+    },
+    prelude::*,
+    softirq_id::softirq_name,
+};
+
+/// Represents the inode at `/proc/softirq_stats`.
+///
+/// Each line of the file is for a softirq line that is in use, and contains the
+/// name of the softirq, the number of times it has been handled, and the total
+/// time (in nanoseconds) spent in handling it.
+pub struct SoftIrqStatsFileOps;
+
+impl SoftIrqStatsFileOps {
+    pub fn new_inode(parent: Weak<dyn Inode>) -> Arc<dyn Inode> {
+        ProcFileBuilder::new(Self).parent(parent).build().unwrap()
+    }
+}
+
+impl FileOps for SoftIrqStatsFileOps {
+    fn data(&self) -> Result<Vec<u8>> {
+        let mut output = String::new();
+        for id in 0..SoftIrqLine::NR_LINES {
+            let Some(name) = softirq_name(id) else {
+                continue;
+            };
+            let stats = SoftIrqLine::get(id).stats();
+            writeln!(output, "{} {} {}", name, stats.count, stats.total_ns).unwrap();
+        }
+        Ok(output.into_bytes())
+    }
+}
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: MPL-2.0
+
+use alloc::format;
+use core::fmt::Write;
+
+use crate::{
+    fs::{
+        procfs::template::{FileOps, ProcFileBuilder},
+        utils::Inode,
+    },
+    prelude::*,
+    syscall::stats::syscall_stats,
+};
+
+/// Represents the inode at `/proc/syscall_stats`.
+///
+/// Each line of the file is for a system call that has been handled, and contains
+/// the name of the system call, the number of calls, the total latency (in
+/// nanoseconds), and the latency histogram. The `i`-th number of the histogram is
+/// the number of calls that take `[2^i, 2^(i + 1))` nanoseconds, and the trailing
+/// zeros of the histogram are omitted.
+pub struct SyscallStatsFileOps;
+
+impl SyscallStatsFileOps {
+    pub fn new_inode(parent: Weak<dyn Inode>) -> Arc<dyn Inode> {
+        ProcFileBuilder::new(Self).parent(parent).build().unwrap()
+    }
+}
+
+impl FileOps for SyscallStatsFileOps {
+    fn data(&self) -> Result<Vec<u8>> {
+        let mut output = String::new();
+        for stats in syscall_stats() {
+            let name = match stats.syscall_name {
+                Some(name) => name.trim_start_matches("SYS_").to_lowercase(),
+                None => format!("syscall_{}", stats.syscall_number),
+            };
+            write!(output, "{} {} {}", name, stats.count, stats.total_ns).unwrap();
+
+            let nr_buckets = stats
+                .latency_buckets
+                .iter()
+                .rposition(|&count| count > 0)
+                .map_or(0, |pos| pos + 1);
+            for count in &stats.latency_buckets[..nr_buckets] {
+                write!(output, " {}", count).unwrap();
+            }
+            output.push('\n');
+        }
+        Ok(output.into_bytes())
+    }
+}
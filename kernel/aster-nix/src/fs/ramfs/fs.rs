@@ -51,6 +51,7 @@ impl RamFS {
                     weak_root.clone(),
                     weak_root.clone(),
                 )),
+                initial_data: SpinLock::new(&[]),
                 ino: ROOT_INO,
                 typ: InodeType::Dir,
                 this: weak_root.clone(),
@@ -88,9 +89,16 @@ impl FileSystem for RamFS {
     }
 }
 
-struct RamInode {
+/// An inode of [`RamFS`].
+pub struct RamInode {
     /// The mutable part of the inode
     node: RwMutex<Node>,
+    /// The initial data of a regular file, which are borrowed from an in-memory image
+    /// and copied to the page cache when the pages are first accessed.
+    ///
+    /// Only the part within the file size is kept, so that the truncated data do not
+    /// reappear after the file is extended again.
+    initial_data: SpinLock<&'static [u8]>,
     /// Inode number
     ino: u64,
     /// Type of the inode
@@ -387,6 +395,7 @@ impl RamInode {
                 weak_self.clone(),
                 parent.clone(),
             )),
+            initial_data: SpinLock::new(&[]),
             ino: fs.alloc_id(),
             typ: InodeType::Dir,
             this: weak_self.clone(),
@@ -397,6 +406,7 @@ impl RamInode {
     fn new_file(fs: &Arc<RamFS>, mode: InodeMode, uid: Uid, gid: Gid) -> Arc<Self> {
         Arc::new_cyclic(|weak_self| RamInode {
             node: RwMutex::new(Node::new_file(mode, uid, gid, weak_self.clone())),
+            initial_data: SpinLock::new(&[]),
             ino: fs.alloc_id(),
             typ: InodeType::File,
             this: weak_self.clone(),
@@ -407,6 +417,7 @@ impl RamInode {
     fn new_symlink(fs: &Arc<RamFS>, mode: InodeMode, uid: Uid, gid: Gid) -> Arc<Self> {
         Arc::new_cyclic(|weak_self| RamInode {
             node: RwMutex::new(Node::new_symlink(mode, uid, gid)),
+            initial_data: SpinLock::new(&[]),
             ino: fs.alloc_id(),
             typ: InodeType::SymLink,
             this: weak_self.clone(),
@@ -417,6 +428,7 @@ impl RamInode {
     fn new_socket(fs: &Arc<RamFS>, mode: InodeMode, uid: Uid, gid: Gid) -> Arc<Self> {
         Arc::new_cyclic(|weak_self| RamInode {
             node: RwMutex::new(Node::new_socket(mode, uid, gid)),
+            initial_data: SpinLock::new(&[]),
             ino: fs.alloc_id(),
             typ: InodeType::Socket,
             this: weak_self.clone(),
@@ -433,6 +445,7 @@ impl RamInode {
     ) -> Arc<Self> {
         Arc::new_cyclic(|weak_self| RamInode {
             node: RwMutex::new(Node::new_device(mode, uid, gid, device.clone())),
+            initial_data: SpinLock::new(&[]),
             ino: fs.alloc_id(),
             typ: InodeType::from(device.type_()),
             this: weak_self.clone(),
@@ -440,6 +453,31 @@ impl RamInode {
         })
     }
 
+    /// Sets the initial data of the regular file, which must be empty.
+    ///
+    /// The data are not copied here. Instead, each page is copied to the page cache
+    /// when it is first accessed, so a file can be created from a large in-memory
+    /// image (e.g., the initramfs) cheaply.
+    pub fn set_initial_data(&self, data: &'static [u8]) -> Result<()> {
+        if self.typ != InodeType::File {
+            return_errno_with_message!(Errno::EISDIR, "not regular file");
+        }
+
+        let mut self_inode = self.node.write();
+        if self_inode.metadata.size != 0 {
+            return_errno_with_message!(Errno::EINVAL, "the file is not empty");
+        }
+        *self.initial_data.lock() = data;
+        self_inode
+            .inner
+            .as_file()
+            .unwrap()
+            .pages()
+            .resize(data.len())?;
+        self_inode.resize(data.len());
+        Ok(())
+    }
+
     fn find(&self, name: &str) -> Result<Arc<Self>> {
         if self.typ != InodeType::Dir {
             return_errno_with_message!(Errno::ENOTDIR, "self is not dir");
@@ -457,9 +495,18 @@ impl RamInode {
 }
 
 impl PageCacheBackend for RamInode {
-    fn read_page(&self, _idx: usize, frame: &Frame) -> Result<BioWaiter> {
-        // Initially, any block/page in a RamFs inode contains all zeros
-        frame.writer().fill(0);
+    fn read_page(&self, idx: usize, frame: &Frame) -> Result<BioWaiter> {
+        // Initially, any block/page in a RamFs inode contains the initial data, if any,
+        // followed by all zeros
+        let initial_data = *self.initial_data.lock();
+        let page_data = {
+            let start = (idx * BLOCK_SIZE).min(initial_data.len());
+            let end = (start + BLOCK_SIZE).min(initial_data.len());
+            &initial_data[start..end]
+        };
+        let mut writer = frame.writer();
+        writer.write(&mut VmReader::from(page_data));
+        writer.fill(0);
         Ok(BioWaiter::new())
     }
 
@@ -471,6 +518,11 @@ impl PageCacheBackend for RamInode {
     fn npages(&self) -> usize {
         self.node.read().metadata.blocks
     }
+
+    fn can_evict_clean_pages(&self) -> bool {
+        // The page cache is the only storage of the data.
+        false
+    }
 }
 
 impl Inode for RamInode {
@@ -554,6 +606,12 @@ impl Inode for RamInode {
 
         let mut self_inode = self_inode.upgrade();
         self_inode.resize(new_size);
+        {
+            let mut initial_data = self.initial_data.lock();
+            if initial_data.len() > new_size {
+                *initial_data = &initial_data[..new_size];
+            }
+        }
         let self_inode = self_inode.downgrade();
         let page_cache = self_inode.inner.as_file().unwrap();
         page_cache.pages().resize(new_size)?;
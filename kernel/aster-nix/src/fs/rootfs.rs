@@ -1,90 +1,169 @@
 // SPDX-License-Identifier: MPL-2.0
 
-use cpio_decoder::{CpioDecoder, FileType};
+use cpio_decoder::{CpioDecoder, CpioSliceDecoder, FileMetadata, FileType};
 use lending_iterator::LendingIterator;
 use libflate::gzip::Decoder as GZipDecoder;
 use spin::Once;
 
 use super::{
     fs_resolver::{FsPath, FsResolver},
-    path::MountNode,
+    path::{Dentry, MountNode},
     procfs::ProcFS,
-    ramfs::RamFS,
+    ramfs::{RamFS, RamInode},
     utils::{FileSystem, InodeMode, InodeType},
 };
-use crate::prelude::*;
+use crate::{prelude::*, time::clocks::MonotonicClock};
+
+/// The magic number of the gzip format.
+const GZIP_MAGIC: &[u8] = &[0x1f, 0x8b];
 
 /// Unpack and prepare the rootfs from the initramfs CPIO buffer.
-pub fn init(initramfs_buf: &[u8]) -> Result<()> {
+///
+/// The initramfs can be either a gzip-compressed or an uncompressed CPIO archive.
+/// The files in an uncompressed archive are not copied when unpacking. Instead,
+/// their pages are copied from the initramfs buffer when they are first accessed.
+pub fn init(initramfs_buf: &'static [u8]) -> Result<()> {
     init_root_mount();
 
-    println!("[kernel] unpacking the initramfs.cpio.gz to rootfs ...");
-    let fs = FsResolver::new();
-    let mut decoder = CpioDecoder::new(
-        GZipDecoder::new(initramfs_buf)
-            .map_err(|_| Error::with_message(Errno::EINVAL, "invalid gzip buffer"))?,
+    let start_time = MonotonicClock::get().read_time();
+    let mut unpacker = Unpacker::new();
+    if initramfs_buf.starts_with(GZIP_MAGIC) {
+        println!("[kernel] unpacking the initramfs.cpio.gz to rootfs ...");
+        let mut decoder = CpioDecoder::new(
+            GZipDecoder::new(initramfs_buf)
+                .map_err(|_| Error::with_message(Errno::EINVAL, "invalid gzip buffer"))?,
+        );
+        while let Some(entry_result) = decoder.next() {
+            let mut entry = entry_result?;
+            let Some(dentry) = unpacker.new_entry(entry.name(), entry.metadata())? else {
+                continue;
+            };
+            match entry.metadata().file_type() {
+                FileType::File => entry.read_all(dentry.inode().writer(0))?,
+                FileType::Link => {
+                    let mut link_data: Vec<u8> = Vec::new();
+                    entry.read_all(&mut link_data)?;
+                    dentry
+                        .inode()
+                        .write_link(core::str::from_utf8(&link_data)?)?;
+                }
+                _ => {}
+            }
+        }
+    } else {
+        println!("[kernel] unpacking the initramfs.cpio to rootfs ...");
+        for entry_result in CpioSliceDecoder::new(initramfs_buf) {
+            let entry = entry_result?;
+            let Some(dentry) = unpacker.new_entry(entry.name(), entry.metadata())? else {
+                continue;
+            };
+            match entry.metadata().file_type() {
+                FileType::File => {
+                    let inode = dentry.inode();
+                    if let Some(ram_inode) = inode.downcast_ref::<RamInode>() {
+                        ram_inode.set_initial_data(entry.data())?;
+                    } else {
+                        inode.write_at(0, entry.data())?;
+                    }
+                }
+                FileType::Link => {
+                    dentry
+                        .inode()
+                        .write_link(core::str::from_utf8(entry.data())?)?;
+                }
+                _ => {}
+            }
+        }
+    }
+    let elapsed_time = MonotonicClock::get().read_time() - start_time;
+    println!(
+        "[kernel] unpacked {} entries of the initramfs in {} ms",
+        unpacker.nr_entries,
+        elapsed_time.as_millis()
     );
 
-    loop {
-        let Some(entry_result) = decoder.next() else {
-            break;
-        };
+    let fs = unpacker.fs;
+    // Mount ProcFS
+    let proc_dentry = fs.lookup(&FsPath::try_from("/proc")?)?;
+    proc_dentry.mount(ProcFS::new())?;
+    // Mount DevFS
+    let dev_dentry = fs.lookup(&FsPath::try_from("/dev")?)?;
+    dev_dentry.mount(RamFS::new())?;
+
+    println!("[kernel] rootfs is ready");
+
+    Ok(())
+}
+
+/// Creates the files of the CPIO entries in the rootfs.
+struct Unpacker {
+    fs: FsResolver,
+    /// The directory of the last entry and its path.
+    ///
+    /// Since the entries in the same directory are adjacent in the archive, this
+    /// saves most of the path lookups.
+    last_parent: Option<(String, Arc<Dentry>)>,
+    nr_entries: usize,
+}
 
-        let mut entry = entry_result?;
+impl Unpacker {
+    fn new() -> Self {
+        Self {
+            fs: FsResolver::new(),
+            last_parent: None,
+            nr_entries: 0,
+        }
+    }
 
+    /// Creates the file of an entry.
+    ///
+    /// Returns the dentry of the new file, or `None` if the entry is skipped.
+    /// The data of regular files and symbolic links should be filled by the caller.
+    fn new_entry(
+        &mut self,
+        entry_name: &str,
+        metadata: &FileMetadata,
+    ) -> Result<Option<Arc<Dentry>>> {
         // Make sure the name is a relative path, and is not end with "/".
-        let entry_name = entry.name().trim_start_matches('/').trim_end_matches('/');
+        let entry_name = entry_name.trim_start_matches('/').trim_end_matches('/');
         if entry_name.is_empty() {
             return_errno_with_message!(Errno::EINVAL, "invalid entry name");
         }
         if entry_name == "." {
-            continue;
+            return Ok(None);
         }
 
         // Here we assume that the directory referred by "prefix" must has been created.
         // The basis of this assumption is：
         // The mkinitramfs script uses `find` command to ensure that the entries are
         // sorted that a directory always appears before its child directories and files.
-        let (parent, name) = if let Some((prefix, last)) = entry_name.rsplit_once('/') {
-            (fs.lookup(&FsPath::try_from(prefix)?)?, last)
-        } else {
-            (fs.root().clone(), entry_name)
+        let (prefix, name) = entry_name.rsplit_once('/').unwrap_or(("", entry_name));
+        let parent = match &self.last_parent {
+            Some((last_prefix, last_parent)) if last_prefix == prefix => last_parent.clone(),
+            _ => {
+                let parent = if prefix.is_empty() {
+                    self.fs.root().clone()
+                } else {
+                    self.fs.lookup(&FsPath::try_from(prefix)?)?
+                };
+                self.last_parent = Some((String::from(prefix), parent.clone()));
+                parent
+            }
         };
 
-        let metadata = entry.metadata();
         let mode = InodeMode::from_bits_truncate(metadata.permission_mode());
-        match metadata.file_type() {
-            FileType::File => {
-                let dentry = parent.new_fs_child(name, InodeType::File, mode)?;
-                entry.read_all(dentry.inode().writer(0))?;
-            }
-            FileType::Dir => {
-                let _ = parent.new_fs_child(name, InodeType::Dir, mode)?;
-            }
-            FileType::Link => {
-                let dentry = parent.new_fs_child(name, InodeType::SymLink, mode)?;
-                let link_content = {
-                    let mut link_data: Vec<u8> = Vec::new();
-                    entry.read_all(&mut link_data)?;
-                    core::str::from_utf8(&link_data)?.to_string()
-                };
-                dentry.inode().write_link(&link_content)?;
-            }
+        let type_ = match metadata.file_type() {
+            FileType::File => InodeType::File,
+            FileType::Dir => InodeType::Dir,
+            FileType::Link => InodeType::SymLink,
             type_ => {
                 panic!("unsupported file type = {:?} in initramfs", type_);
             }
-        }
+        };
+        let dentry = parent.new_fs_child(name, type_, mode)?;
+        self.nr_entries += 1;
+        Ok(Some(dentry))
     }
-    // Mount ProcFS
-    let proc_dentry = fs.lookup(&FsPath::try_from("/proc")?)?;
-    proc_dentry.mount(ProcFS::new())?;
-    // Mount DevFS
-    let dev_dentry = fs.lookup(&FsPath::try_from("/dev")?)?;
-    dev_dentry.mount(RamFS::new())?;
-
-    println!("[kernel] rootfs is ready");
-
-    Ok(())
 }
 
 pub fn mount_fs_at(fs: Arc<dyn FileSystem>, fs_path: &FsPath) -> Result<()> {
@@ -277,10 +277,22 @@ impl<T> Consumer<T> {
 
 impl<T: Copy> Consumer<T> {
     pub fn read(&self, buf: &mut [T]) -> Result<usize> {
+        self.read_with_limit(buf, |_| usize::MAX)
+    }
+
+    /// Reads like [`Consumer::read`], but reads at most `max_len(len)` items, where
+    /// `len` is the number of the items that are available when they are read.
+    ///
+    /// The limit is decided after the reader waits for the items, so it can depend
+    /// on the state of the writer when the items are written.
+    pub fn read_with_limit<F>(&self, buf: &mut [T], mut max_len: F) -> Result<usize>
+    where
+        F: FnMut(usize) -> usize,
+    {
         let is_nonblocking = self.is_nonblocking();
 
         // Fast path
-        let res = self.try_read(buf);
+        let res = self.try_read(buf, &mut max_len);
         if should_io_return(&res, is_nonblocking) {
             return res;
         }
@@ -289,7 +301,7 @@ impl<T: Copy> Consumer<T> {
         let mask = IoEvents::IN;
         let poller = Poller::new();
         loop {
-            let res = self.try_read(buf);
+            let res = self.try_read(buf, &mut max_len);
             if should_io_return(&res, is_nonblocking) {
                 return res;
             }
@@ -301,7 +313,7 @@ impl<T: Copy> Consumer<T> {
         }
     }
 
-    fn try_read(&self, buf: &mut [T]) -> Result<usize> {
+    fn try_read(&self, buf: &mut [T], max_len: &mut dyn FnMut(usize) -> usize) -> Result<usize> {
         if self.is_shutdown() {
             return_errno!(Errno::EPIPE);
         }
@@ -309,7 +321,7 @@ impl<T: Copy> Consumer<T> {
             return Ok(0);
         }
 
-        let read_len = self.0.read(buf);
+        let read_len = self.0.read(buf, max_len);
 
         self.update_pollee();
 
@@ -398,9 +410,10 @@ impl<T, R: TRights> EndPoint<T, R> {
 
 impl<T: Copy, R: TRights> EndPoint<T, R> {
     #[require(R > Read)]
-    pub fn read(&self, buf: &mut [T]) -> usize {
+    pub fn read(&self, buf: &mut [T], max_len: &mut dyn FnMut(usize) -> usize) -> usize {
         let mut rb = self.common.consumer.rb();
-        rb.pop_slice(buf)
+        let len = buf.len().min(max_len(rb.len()));
+        rb.pop_slice(&mut buf[..len])
     }
 
     #[require(R > Write)]
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: MPL-2.0
+
+use core::ops::Range;
+
+use ostd::mm::Frame;
+
+use crate::prelude::*;
+
+/// A range of bytes within a page frame.
+///
+/// Frame slices are used to hand data between files without copying it,
+/// e.g., from the page cache to a pipe in `splice` or to a socket in `sendfile`.
+/// A frame slice holds a reference to the frame, so the frame stays alive
+/// as long as the slice does.
+#[derive(Clone)]
+pub struct FrameSlice {
+    frame: Frame,
+    range: Range<usize>,
+}
+
+impl FrameSlice {
+    /// Creates a slice of `range` within the frame.
+    ///
+    /// # Panics
+    ///
+    /// This method panics if the range exceeds the frame.
+    pub fn new(frame: Frame, range: Range<usize>) -> Self {
+        assert!(range.start <= range.end && range.end <= PAGE_SIZE);
+        Self { frame, range }
+    }
+
+    /// Returns the frame.
+    pub fn frame(&self) -> &Frame {
+        &self.frame
+    }
+
+    /// Returns the range of bytes within the frame.
+    pub fn range(&self) -> Range<usize> {
+        self.range.clone()
+    }
+
+    /// Returns the length of the slice in bytes.
+    pub fn len(&self) -> usize {
+        self.range.len()
+    }
+
+    /// Returns whether the slice is empty.
+    pub fn is_empty(&self) -> bool {
+        self.range.is_empty()
+    }
+
+    /// Returns a reader to read the bytes of the slice.
+    pub fn reader(&self) -> VmReader<'_> {
+        self.frame
+            .reader()
+            .skip(self.range.start)
+            .limit(self.range.len())
+    }
+
+    /// Returns the slice with its first `nbytes` bytes removed.
+    ///
+    /// # Panics
+    ///
+    /// This method panics if `nbytes` is greater than the length of the slice.
+    pub fn skip(mut self, nbytes: usize) -> Self {
+        assert!(nbytes <= self.len());
+        self.range.start += nbytes;
+        self
+    }
+
+    /// Returns the slice with its length limited to at most `max_len` bytes.
+    pub fn limit(mut self, max_len: usize) -> Self {
+        self.range.end = self.range.end.min(self.range.start + max_len);
+        self
+    }
+}
+
+impl Debug for FrameSlice {
+    fn fmt(&self, f: &mut core::fmt::Formatter) -> core::fmt::Result {
+        f.debug_struct("FrameSlice")
+            .field("paddr", &self.frame.start_paddr())
+            .field("range", &self.range)
+            .finish()
+    }
+}
@@ -40,6 +40,9 @@ bitflags! {
     pub struct FsFlags: u32 {
         /// Dentry cannot be evicted.
         const DENTRY_UNEVICTABLE = 1 << 1;
+        /// Failed lookups cannot be cached as negative dentries, since files may
+        /// appear without going through the VFS layer.
+        const NO_NEGATIVE_DENTRY = 1 << 2;
     }
 }
 
@@ -7,7 +7,7 @@ use core::time::Duration;
 use aster_rights::Full;
 use core2::io::{Error as IoError, ErrorKind as IoErrorKind, Result as IoResult, Write};
 
-use super::{DirentVisitor, FileSystem, IoctlCmd};
+use super::{DirentVisitor, FileAdvice, FileSystem, IoctlCmd, PageCachePrefetch};
 use crate::{
     events::IoEvents,
     fs::device::{Device, DeviceType},
@@ -276,6 +276,21 @@ pub trait Inode: Any + Sync + Send {
         None
     }
 
+    /// Starts reading the data within the given range into the page cache
+    /// without waiting for the I/O to complete.
+    ///
+    /// Returns `None` if the inode has no page cache or the data has been cached.
+    fn prefetch(&self, offset: usize, len: usize) -> Result<Option<PageCachePrefetch>> {
+        Ok(None)
+    }
+
+    /// Applies the advice on how the data within the given range is going to be accessed.
+    ///
+    /// The advice is ignored if the inode has no page cache.
+    fn advise(&self, offset: usize, len: usize, advice: FileAdvice) -> Result<()> {
+        Ok(())
+    }
+
     fn read_at(&self, offset: usize, buf: &mut [u8]) -> Result<usize> {
         Err(Error::new(Errno::EISDIR))
     }
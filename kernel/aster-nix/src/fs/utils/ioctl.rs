@@ -4,6 +4,7 @@ use crate::prelude::*;
 
 #[repr(u32)]
 #[derive(Debug, Clone, Copy, TryFromInt)]
+#[allow(non_camel_case_types)]
 pub enum IoctlCmd {
     /// Get terminal attributes
     TCGETS = 0x5401,
@@ -33,4 +34,14 @@ pub enum IoctlCmd {
     TIOCGPTPEER = 0x40045441,
     /// Get tdx report using TDCALL
     TDXGETREPORT = 0xc4405401,
+    /// Enable a performance event
+    PERF_EVENT_IOC_ENABLE = 0x2400,
+    /// Disable a performance event
+    PERF_EVENT_IOC_DISABLE = 0x2401,
+    /// Reset the count of a performance event
+    PERF_EVENT_IOC_RESET = 0x2403,
+    /// Set the sample period of a performance event
+    PERF_EVENT_IOC_PERIOD = 0x40082404,
+    /// Get the ID of a performance event
+    PERF_EVENT_IOC_ID = 0x80082407,
 }
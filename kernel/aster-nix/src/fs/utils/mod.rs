@@ -8,11 +8,16 @@ pub use creation_flags::CreationFlags;
 pub use dirent_visitor::DirentVisitor;
 pub use direntry_vec::DirEntryVecExt;
 pub use file_creation_mask::FileCreationMask;
+pub use frame_slice::FrameSlice;
 pub use fs::{FileSystem, FsFlags, SuperBlock};
 pub use inode::{Inode, InodeMode, InodeType, Metadata};
 pub use ioctl::IoctlCmd;
-pub use page_cache::{PageCache, PageCacheBackend};
+pub use page_cache::{
+    start_writeback_thread, FileAdvice, PageCache, PageCacheBackend, PageCacheLimits,
+    PageCachePrefetch,
+};
 pub use random_test::{generate_random_operation, new_fs_in_memory};
+pub use splice_flags::SpliceFlags;
 pub use status_flags::StatusFlags;
 
 mod access_mode;
@@ -21,11 +26,13 @@ mod creation_flags;
 mod dirent_visitor;
 mod direntry_vec;
 mod file_creation_mask;
+mod frame_slice;
 mod fs;
 mod inode;
 mod ioctl;
 mod page_cache;
 mod random_test;
+mod splice_flags;
 mod status_flags;
 
 use crate::prelude::*;
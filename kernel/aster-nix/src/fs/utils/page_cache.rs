@@ -2,16 +2,39 @@
 
 #![allow(dead_code)]
 
-use core::ops::Range;
+//! The page cache and the writeback of the dirty pages.
+//!
+//! All the page caches share a writeback thread, which periodically writes the
+//! dirty pages back to the backends in the background. The thread is also woken up
+//! early if there are too many dirty pages, or if the page caches take more memory
+//! than allowed, in which case it evicts the clean pages that are used least recently.
+//! Writers that dirty pages faster than they can be written back are throttled.
+//! See [`PageCacheLimits`] for the tunables.
+
+use core::{
+    ops::Range,
+    sync::atomic::{AtomicBool, AtomicUsize, Ordering},
+    time::Duration,
+};
 
 use aster_block::bio::{BioStatus, BioWaiter};
 use aster_rights::Full;
 use lru::LruCache;
-use ostd::mm::{Frame, FrameAllocOptions};
+use ostd::{
+    collections::xarray::{CursorMut, XArray, XMark},
+    mm::{total_pages, Frame, FrameAllocOptions, Paddr},
+    sync::{synchronize_rcu, Rcu, WaitQueue},
+};
+use spin::Once;
 
 use crate::{
     prelude::*,
-    vm::vmo::{get_page_idx_range, Pager, Vmo, VmoFlags, VmoOptions},
+    thread::{
+        kernel_thread::{KernelThreadExt, ThreadOptions},
+        Thread,
+    },
+    time::wait::WaitTimeout,
+    vm::vmo::{get_page_idx_range, Pager, Vmo, VmoFlags, VmoOptions, WeakVmo},
 };
 
 pub struct PageCache {
@@ -22,12 +45,7 @@ pub struct PageCache {
 impl PageCache {
     /// Creates an empty size page cache associated with a new backend.
     pub fn new(backend: Weak<dyn PageCacheBackend>) -> Result<Self> {
-        let manager = Arc::new(PageCacheManager::new(backend));
-        let pages = VmoOptions::<Full>::new(0)
-            .flags(VmoFlags::RESIZABLE)
-            .pager(manager.clone())
-            .alloc()?;
-        Ok(Self { pages, manager })
+        Self::with_capacity(0, backend)
     }
 
     /// Creates a page cache associated with an existing backend.
@@ -40,6 +58,8 @@ impl PageCache {
             .flags(VmoFlags::RESIZABLE)
             .pager(manager.clone())
             .alloc()?;
+        manager.vmo.call_once(|| pages.downgrade());
+        PAGE_CACHE_MANAGERS.lock().push(Arc::downgrade(&manager));
         Ok(Self { pages, manager })
     }
 
@@ -66,6 +86,85 @@ impl PageCache {
     pub fn backend(&self) -> Arc<dyn PageCacheBackend> {
         self.manager.backend()
     }
+
+    /// Starts reading the data within a specified range from the backend,
+    /// without waiting for the I/O to complete.
+    ///
+    /// Only the pages that are not in the page cache are read. Returns `None`
+    /// if there is no need to read any page.
+    pub fn prefetch(&self, range: Range<usize>) -> Result<Option<PageCachePrefetch>> {
+        self.manager.prefetch(range)
+    }
+
+    /// Applies the advice on how the data within a specified range is going to be accessed.
+    pub fn advise(&self, range: Range<usize>, advice: FileAdvice) -> Result<()> {
+        self.manager.advise(range, advice)
+    }
+}
+
+/// The advice on how the data of a file is going to be accessed.
+///
+/// The advice tunes the readahead of the page cache of the file.
+#[repr(i32)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, TryFromInt)]
+pub enum FileAdvice {
+    /// No special treatment, which restores the default readahead.
+    Normal = 0,
+    /// The data is accessed randomly, so the readahead is disabled.
+    Random = 1,
+    /// The data is accessed sequentially, so the readahead window can be larger.
+    Sequential = 2,
+    /// The data is going to be accessed soon, so it is read ahead now.
+    WillNeed = 3,
+    /// The data is not going to be accessed soon, so its clean pages are evicted.
+    DontNeed = 4,
+    /// The data is going to be accessed only once.
+    NoReuse = 5,
+}
+
+/// The pages being read from the backend, which are started by [`PageCache::prefetch`].
+///
+/// The pages are not visible in the page cache until the prefetch is completed.
+/// Meanwhile, a concurrent access to the pages reads the pages again on its own.
+pub struct PageCachePrefetch {
+    manager: Arc<PageCacheManager>,
+    pages: Vec<(usize, Frame)>,
+    waiter: BioWaiter,
+}
+
+impl PageCachePrefetch {
+    /// Returns whether the I/O has been finished, successfully or not.
+    pub fn is_finished(&self) -> bool {
+        (0..self.waiter.nreqs()).all(|i| self.waiter.status(i) != BioStatus::Submit)
+    }
+
+    /// Waits for the I/O to finish and puts the pages into the page cache.
+    pub fn complete(self) -> Result<()> {
+        if !matches!(self.waiter.wait(), Some(BioStatus::Complete)) {
+            return_errno!(Errno::EIO)
+        }
+
+        let npages = self.manager.backend().npages();
+        self.manager.update_pages(|pages| {
+            for (idx, frame) in self.pages {
+                // The page may have been read (and even written) by others in the meantime,
+                // or have been truncated.
+                if idx >= npages || pages.contains(idx) {
+                    continue;
+                }
+                pages.put(idx, frame, PageState::UpToDate);
+            }
+        });
+        Ok(())
+    }
+}
+
+impl Debug for PageCachePrefetch {
+    fn fmt(&self, f: &mut core::fmt::Formatter) -> core::fmt::Result {
+        f.debug_struct("PageCachePrefetch")
+            .field("nr_pages", &self.pages.len())
+            .finish()
+    }
 }
 
 impl Drop for PageCache {
@@ -134,13 +233,30 @@ impl ReadaheadWindow {
     }
 }
 
+/// The readahead of a page cache.
+///
+/// Several sequential streams can be detected in the same page cache, e.g., when
+/// the file is read by interleaved streams. Each stream has its own readahead window.
 struct ReadaheadState {
+    /// The recently accessed streams, from the most recently accessed one.
+    streams: Vec<ReadaheadStream>,
+    /// The readaheads whose pages are not up to date yet.
+    inflight: Vec<Arc<InflightReadahead>>,
+    /// Maximum window size, or zero if the readahead is disabled.
+    max_size: usize,
+}
+
+/// A sequential stream of the accesses to a page cache.
+struct ReadaheadStream {
     /// Current readahead window.
     ra_window: Option<ReadaheadWindow>,
-    /// Maximum window size.
-    max_size: usize,
     /// The last page visited, used to determine sequential I/O.
-    prev_page: Option<usize>,
+    prev_page: usize,
+}
+
+/// The pages being read ahead, which are in the page cache but not up to date.
+struct InflightReadahead {
+    pages: Vec<(usize, Frame)>,
     /// Readahead requests waiter.
     waiter: BioWaiter,
 }
@@ -148,143 +264,194 @@ struct ReadaheadState {
 impl ReadaheadState {
     const INIT_WINDOW_SIZE: usize = 4;
     const DEFAULT_MAX_SIZE: usize = 32;
+    const MAX_NR_STREAMS: usize = 8;
 
     pub fn new() -> Self {
         Self {
-            ra_window: None,
+            streams: Vec::new(),
+            inflight: Vec::new(),
             max_size: Self::DEFAULT_MAX_SIZE,
-            prev_page: None,
-            waiter: BioWaiter::new(),
         }
     }
 
     /// Sets the maximum readahead window size.
+    ///
+    /// Zero disables the readahead.
     pub fn set_max_window_size(&mut self, size: usize) {
         self.max_size = size;
     }
 
-    fn is_sequential(&self, idx: usize) -> bool {
-        if let Some(prev) = self.prev_page {
-            idx == prev || idx == prev + 1
-        } else {
-            false
-        }
-    }
+    /// Records the access to the page by a stream, and returns the new readahead window
+    /// of the stream if a new readahead should be performed.
+    ///
+    /// We only consider readahead for sequential I/O now. An access that is not sequential
+    /// to any stream starts a new stream, which replaces the least recently accessed one.
+    pub fn access(&mut self, idx: usize, max_page: usize) -> Option<Range<usize>> {
+        let Some(pos) = self
+            .streams
+            .iter()
+            .position(|stream| stream.is_sequential(idx))
+        else {
+            self.streams.truncate(Self::MAX_NR_STREAMS - 1);
+            self.streams.insert(0, ReadaheadStream::new(idx));
+            return None;
+        };
 
-    /// The number of bio requests in waiter.
-    /// This number will be zero if there are no previous readahead.
-    pub fn request_number(&self) -> usize {
-        self.waiter.nreqs()
+        let mut stream = self.streams.remove(pos);
+        let new_window = if self.max_size > 0 && stream.should_readahead(idx, max_page) {
+            stream.setup_window(idx, max_page, self.max_size);
+            stream
+                .ra_window
+                .as_ref()
+                .map(ReadaheadWindow::readahead_range)
+        } else {
+            None
+        };
+        stream.prev_page = idx;
+        self.streams.insert(0, stream);
+        new_window
     }
 
-    /// Checks for the previous readahead.
-    /// Returns true if the previous readahead has been completed.
-    pub fn prev_readahead_is_completed(&self) -> bool {
-        let nreqs = self.request_number();
-        if nreqs == 0 {
-            return false;
+    /// Conducts the new readahead.
+    ///
+    /// Sends the read requests of the pages within the range that are not in the page cache,
+    /// and puts them into the page cache as `Uninit` pages without waiting for the I/O.
+    pub fn conduct_readahead(
+        &mut self,
+        pages: &mut PagesMut,
+        readahead_range: Range<usize>,
+        backend: &Arc<dyn PageCacheBackend>,
+    ) -> Result<()> {
+        let mut async_pages = Vec::with_capacity(readahead_range.len());
+        for idx in readahead_range {
+            if !pages.contains(idx) {
+                async_pages.push((idx, alloc_uninit_frame()?));
+            }
+        }
+        if async_pages.is_empty() {
+            return Ok(());
         }
 
-        for i in 0..nreqs {
-            if self.waiter.status(i) == BioStatus::Submit {
-                return false;
-            }
+        let mut waiter = BioWaiter::new();
+        for run in async_pages.chunk_by(|(prev_idx, _), (idx, _)| prev_idx + 1 == *idx) {
+            let frames: Vec<Frame> = run.iter().map(|(_, frame)| frame.clone()).collect();
+            waiter.concat(backend.read_pages(run[0].0, &frames)?);
         }
-        true
+        for (idx, frame) in async_pages.iter() {
+            pages.put(*idx, frame.clone(), PageState::Uninit);
+        }
+        self.inflight.push(Arc::new(InflightReadahead {
+            pages: async_pages,
+            waiter,
+        }));
+        Ok(())
     }
 
-    /// Waits for the previous readahead.
-    pub fn wait_for_prev_readahead(
-        &mut self,
-        pages: &mut MutexGuard<LruCache<usize, Page>>,
-    ) -> Result<()> {
-        if matches!(self.waiter.wait(), Some(BioStatus::Complete)) {
-            let Some(window) = &self.ra_window else {
-                return_errno!(Errno::EINVAL)
-            };
-            for idx in window.readahead_range() {
-                if let Some(page) = pages.get_mut(&idx) {
-                    page.set_state(PageState::UpToDate);
-                }
-            }
-            self.waiter.clear();
-        } else {
-            return_errno!(Errno::EIO)
+    /// Takes the readaheads whose I/O has been finished, successfully or not.
+    pub fn take_finished(&mut self) -> Vec<Arc<InflightReadahead>> {
+        let (finished, inflight) = self
+            .inflight
+            .drain(..)
+            .partition(|readahead| readahead.is_finished());
+        self.inflight = inflight;
+        finished
+    }
+
+    /// Finds the readahead that reads the page.
+    pub fn find_inflight(&self, idx: usize) -> Option<Arc<InflightReadahead>> {
+        self.inflight
+            .iter()
+            .find(|readahead| readahead.contains(idx))
+            .cloned()
+    }
+}
+
+impl ReadaheadStream {
+    fn new(idx: usize) -> Self {
+        Self {
+            ra_window: None,
+            prev_page: idx,
         }
+    }
 
-        Ok(())
+    fn is_sequential(&self, idx: usize) -> bool {
+        idx == self.prev_page || idx == self.prev_page + 1
     }
 
     /// Determines whether a new readahead should be performed.
-    /// We only consider readahead for sequential I/O now.
-    /// There should be at most one in-progress readahead.
-    pub fn should_readahead(&self, idx: usize, max_page: usize) -> bool {
-        if self.request_number() == 0 && self.is_sequential(idx) {
-            if let Some(cur_window) = &self.ra_window {
-                let trigger_readahead =
-                    idx == cur_window.lookahead_index() || idx == cur_window.readahead_index();
-                let next_window_exist = cur_window.readahead_range().end < max_page;
-                trigger_readahead && next_window_exist
-            } else {
-                let new_window_start = idx + 1;
-                new_window_start < max_page
-            }
+    ///
+    /// The readahead is triggered when the stream reaches the start or the end of the
+    /// current window, so it is performed asynchronously before the pages are needed.
+    fn should_readahead(&self, idx: usize, max_page: usize) -> bool {
+        if let Some(cur_window) = &self.ra_window {
+            let trigger_readahead =
+                idx == cur_window.lookahead_index() || idx == cur_window.readahead_index();
+            let next_window_exist = cur_window.readahead_range().end < max_page;
+            trigger_readahead && next_window_exist
         } else {
-            false
+            let new_window_start = idx + 1;
+            new_window_start < max_page
         }
     }
 
     /// Setup the new readahead window.
-    pub fn setup_window(&mut self, idx: usize, max_page: usize) {
+    fn setup_window(&mut self, idx: usize, max_page: usize, max_size: usize) {
         let new_window = if let Some(cur_window) = &self.ra_window {
-            cur_window.next(self.max_size, max_page)
+            cur_window.next(max_size, max_page)
         } else {
             let start_idx = idx + 1;
-            let init_size = Self::INIT_WINDOW_SIZE.min(self.max_size);
+            let init_size = ReadaheadState::INIT_WINDOW_SIZE.min(max_size);
             let end_idx = (start_idx + init_size).min(max_page);
             ReadaheadWindow::new(start_idx..end_idx)
         };
         self.ra_window = Some(new_window);
     }
+}
 
-    /// Conducts the new readahead.
-    /// Sends the relevant read request and sets the relevant page in the page cache to `Uninit`.
-    pub fn conduct_readahead(
-        &mut self,
-        pages: &mut MutexGuard<LruCache<usize, Page>>,
-        backend: Arc<dyn PageCacheBackend>,
-    ) -> Result<()> {
-        let Some(window) = &self.ra_window else {
-            return_errno!(Errno::EINVAL)
-        };
-        for async_idx in window.readahead_range() {
-            let mut async_page = Page::alloc()?;
-            let pg_waiter = backend.read_page(async_idx, async_page.frame())?;
-            self.waiter.concat(pg_waiter);
-            async_page.set_state(PageState::Uninit);
-            pages.put(async_idx, async_page);
-        }
-        Ok(())
+impl InflightReadahead {
+    fn contains(&self, idx: usize) -> bool {
+        self.pages
+            .binary_search_by_key(&idx, |(page_idx, _)| *page_idx)
+            .is_ok()
     }
 
-    /// Sets the last page visited.
-    pub fn set_prev_page(&mut self, idx: usize) {
-        self.prev_page = Some(idx);
+    fn is_finished(&self) -> bool {
+        (0..self.waiter.nreqs()).all(|i| self.waiter.status(i) != BioStatus::Submit)
     }
 }
 
 struct PageCacheManager {
-    pages: Mutex<LruCache<usize, Page>>,
+    /// The index of the cached pages, which is read without locking.
+    ///
+    /// The index is updated only through [`Self::update_pages`].
+    pages: Rcu<Box<XArray<Frame, PageMark>>>,
+    /// The cached pages, from the most recently used one to the least recently used one.
+    ///
+    /// The order decides which clean pages are evicted first. It approximates the least
+    /// recently used order, since the lookups that hit the index without locking do not
+    /// update it. The lock also serializes the updates of the index.
+    lru: Mutex<LruCache<usize, ()>>,
     backend: Weak<dyn PageCacheBackend>,
     ra_state: Mutex<ReadaheadState>,
+    /// The VMO whose pages are provided by the manager.
+    vmo: Once<WeakVmo<Full>>,
+    /// Whether there may be dirty pages, so the writeback thread can skip clean page caches.
+    has_dirty_pages: AtomicBool,
+    /// The lock that serializes the writebacks, so that a writeback (e.g., an `fsync`)
+    /// does not return while the pages cleaned by another writeback are still under I/O.
+    writeback_lock: Mutex<()>,
 }
 
 impl PageCacheManager {
     pub fn new(backend: Weak<dyn PageCacheBackend>) -> Self {
         Self {
-            pages: Mutex::new(LruCache::unbounded()),
+            pages: Rcu::new(Box::new(XArray::new())),
+            lru: Mutex::new(LruCache::unbounded()),
             backend,
             ra_state: Mutex::new(ReadaheadState::new()),
+            vmo: Once::new(),
+            has_dirty_pages: AtomicBool::new(false),
+            writeback_lock: Mutex::new(()),
         }
     }
 
@@ -292,99 +459,420 @@ impl PageCacheManager {
         self.backend.upgrade().unwrap()
     }
 
+    /// Gets the page and its state without locking.
+    fn load_page(&self, idx: usize) -> Option<(Frame, PageState)> {
+        let pages = self.pages.read();
+        let mut cursor = pages.cursor(idx as u64);
+        let state = PageState::from_marks(|mark| cursor.is_marked(mark));
+        let frame = cursor.load()?.clone();
+        Some((frame, state))
+    }
+
+    /// Gets the state of the page without locking.
+    fn load_state(&self, idx: usize) -> Option<PageState> {
+        let pages = self.pages.read();
+        let mut cursor = pages.cursor(idx as u64);
+        cursor.load()?;
+        Some(PageState::from_marks(|mark| cursor.is_marked(mark)))
+    }
+
+    /// Returns the physical address of the frame of the page if the page is up to date,
+    /// not under writeback, and its frame is referred by no one other than the
+    /// `nr_owner_refs` owners.
+    fn evictable_frame(&self, idx: usize, nr_owner_refs: u32) -> Option<Paddr> {
+        let pages = self.pages.read();
+        let mut cursor = pages.cursor(idx as u64);
+        if !cursor.is_marked(PageMark::UpToDate) || cursor.is_marked(PageMark::Writeback) {
+            return None;
+        }
+        let frame = cursor.load()?;
+        (frame.reference_count() <= nr_owner_refs).then(|| frame.start_paddr())
+    }
+
+    /// Updates the pages.
+    ///
+    /// The updates are serialized and applied to a copy of the index, which is then
+    /// published to the lock-free readers. The copy shares the unmodified nodes with
+    /// the old index, so the cost depends on the updated pages rather than all the pages.
+    fn update_pages<R>(&self, f: impl FnOnce(&mut PagesMut) -> R) -> R {
+        let mut lru = self.lru.lock();
+        let mut pages = XArray::clone(&self.pages.read());
+        let mut pages_mut = PagesMut {
+            pages: &mut pages,
+            lru: &mut lru,
+            is_modified: false,
+        };
+        let res = f(&mut pages_mut);
+        if pages_mut.is_modified {
+            self.pages.replace(Box::new(pages)).delay();
+        }
+        res
+    }
+
     // Discard pages without writing them back to disk.
     pub fn discard_range(&self, range: Range<usize>) {
         let page_idx_range = get_page_idx_range(&range);
-        for idx in page_idx_range {
-            self.pages.lock().pop(&idx);
-        }
+        self.update_pages(|pages| {
+            for idx in page_idx_range {
+                pages.remove(idx);
+            }
+        });
     }
 
     pub fn evict_range(&self, range: Range<usize>) -> Result<()> {
         let page_idx_range = get_page_idx_range(&range);
+        while self.write_back_pages(page_idx_range.clone(), MAX_WRITEBACK_BATCH)?
+            == MAX_WRITEBACK_BATCH
+        {}
+        Ok(())
+    }
 
-        //TODO: When there are many pages, we should submit them in batches of folios rather than all at once.
-        let mut indices_and_waiters: Vec<(usize, BioWaiter)> = Vec::new();
+    /// Writes back at most `max_pages` dirty pages within the page index range,
+    /// and waits for the I/O to complete.
+    ///
+    /// The pages with the lowest indices are written in the ascending order of
+    /// the indices, so the block layer can merge the I/O of adjacent pages.
+    /// Returns the number of the written pages.
+    fn write_back_pages(&self, idx_range: Range<usize>, max_pages: usize) -> Result<usize> {
+        let Some(backend) = self.backend.upgrade() else {
+            return Ok(0);
+        };
+        let idx_range = idx_range.start..idx_range.end.min(backend.npages());
+        let _writeback_guard = self.writeback_lock.lock();
 
-        for idx in page_idx_range {
-            if let Some(page) = self.pages.lock().get_mut(&idx) {
-                if let PageState::Dirty = page.state() {
-                    let backend = self.backend();
-                    if idx < backend.npages() {
-                        indices_and_waiters.push((idx, backend.write_page(idx, page.frame())?));
-                    }
+        let dirty_pages: Vec<(usize, Frame)> = self.update_pages(|pages| {
+            let mut nr_dirty_pages = 0;
+            let mut indices: Vec<usize> = pages
+                .dirty_indices()
+                .inspect(|_| nr_dirty_pages += 1)
+                .filter(|idx| idx_range.contains(idx))
+                .collect();
+            indices.sort_unstable();
+            indices.truncate(max_pages);
+            // Some dirty pages are left, e.g., the pages out of the range or beyond the end of
+            // the backend, which is going to be extended.
+            if nr_dirty_pages > indices.len() {
+                self.has_dirty_pages.store(true, Ordering::Relaxed);
+            }
+            indices
+                .into_iter()
+                .map(|idx| {
+                    let (frame, _) = pages.peek(idx).unwrap();
+                    // The page is cleaned before the I/O is submitted,
+                    // so that a write during the I/O dirties it again.
+                    pages.set_state(idx, PageState::UpToDate);
+                    pages.set_writeback(idx, true);
+                    (idx, frame)
+                })
+                .collect()
+        });
+        let nr_pages = dirty_pages.len();
+
+        // The consecutive pages are written in runs, each of which the backend can write
+        // with a few large requests.
+        let runs: Vec<&[(usize, Frame)]> = dirty_pages
+            .chunk_by(|(prev_idx, _), (idx, _)| prev_idx + 1 == *idx)
+            .collect();
+        let mut waiters = Vec::with_capacity(runs.len());
+        let mut submit_result = Ok(());
+        for run in runs.iter() {
+            let frames: Vec<Frame> = run.iter().map(|(_, frame)| frame.clone()).collect();
+            match backend.write_pages(run[0].0, &frames) {
+                Ok(waiter) => waiters.push(waiter),
+                Err(err) => {
+                    submit_result = Err(err);
+                    break;
                 }
             }
         }
 
-        for (idx, waiter) in indices_and_waiters.iter() {
-            if matches!(waiter.wait(), Some(BioStatus::Complete)) {
-                if let Some(page) = self.pages.lock().get_mut(idx) {
-                    page.set_state(PageState::UpToDate)
+        let mut failed_pages: Vec<&(usize, Frame)> =
+            runs[waiters.len()..].iter().copied().flatten().collect();
+        for (run, waiter) in runs.iter().zip(waiters.iter()) {
+            if !matches!(waiter.wait(), Some(BioStatus::Complete)) {
+                failed_pages.extend(run.iter());
+            }
+        }
+
+        // The pages that fail to be written are dirty again, unless they have been replaced.
+        let is_failed = !failed_pages.is_empty();
+        self.update_pages(|pages| {
+            for (idx, frame) in dirty_pages.iter() {
+                if pages.is_in_frame(*idx, frame) {
+                    pages.set_writeback(*idx, false);
                 }
-            } else {
-                // TODO: We may need an error handler here.
-                return_errno!(Errno::EIO)
             }
+            for (idx, frame) in failed_pages {
+                if pages.is_in_frame(*idx, frame) {
+                    pages.set_state(*idx, PageState::Dirty);
+                }
+            }
+        });
+        if !is_failed {
+            return Ok(nr_pages);
         }
 
+        self.has_dirty_pages.store(true, Ordering::Relaxed);
+        submit_result?;
+        return_errno_with_message!(Errno::EIO, "failed to write back the dirty pages")
+    }
+
+    /// Writes back all the dirty pages, in batches of `MAX_WRITEBACK_BATCH` pages.
+    fn write_back_all(&self) -> Result<()> {
+        if !self.has_dirty_pages.swap(false, Ordering::Relaxed) {
+            return Ok(());
+        }
+        while self.write_back_pages(0..usize::MAX, MAX_WRITEBACK_BATCH)? == MAX_WRITEBACK_BATCH {
+            THROTTLE_WAIT_QUEUE.wake_all();
+        }
+        THROTTLE_WAIT_QUEUE.wake_all();
         Ok(())
     }
 
-    fn ondemand_readahead(&self, idx: usize) -> Result<Frame> {
-        let mut pages = self.pages.lock();
-        let mut ra_state = self.ra_state.lock();
+    /// Evicts at most `max_pages` clean pages that are used least recently.
+    ///
+    /// A page is evicted only if no one but the page cache refers to the frame,
+    /// e.g., the page is not mapped to any user space or under I/O.
+    /// Returns the number of the evicted pages.
+    fn evict_clean_pages(&self, max_pages: usize) -> usize {
+        self.evict_pages(max_pages, |_| true)
+    }
+
+    /// Evicts at most `max_pages` clean pages whose indices satisfy `is_target`,
+    /// in the same way as [`Self::evict_clean_pages`].
+    fn evict_pages(&self, max_pages: usize, is_target: impl Fn(usize) -> bool) -> usize {
+        let Some(vmo) = self.vmo.get().and_then(WeakVmo::upgrade) else {
+            return 0;
+        };
+        if !self
+            .backend
+            .upgrade()
+            .is_some_and(|backend| backend.can_evict_clean_pages())
+        {
+            return 0;
+        }
+
+        // The frame of a committed page is referred by both the VMO and the page cache.
+        const NR_COMMITTED_REFS: u32 = 2;
+        // The replaced indices also refer to the frames until they are reclaimed, which
+        // makes the pages look used. Instead of waiting for them, such pages are left to
+        // a later eviction.
+        let candidates: Vec<usize> = self
+            .lru
+            .lock()
+            .iter()
+            .rev()
+            .map(|(idx, _)| *idx)
+            .filter(|idx| is_target(*idx))
+            .filter(|idx| self.evictable_frame(*idx, NR_COMMITTED_REFS).is_some())
+            .take(max_pages)
+            .collect();
+
+        if candidates.is_empty() {
+            return 0;
+        }
+
+        // The pages are checked again with the VMO locked, since they may have been
+        // dirtied or mapped in the meantime. Decommitting the pages removes them from
+        // the page cache, too, with a single update of the index.
+        let decommitted: BTreeSet<usize> = match vmo.decommit_pages_if(&candidates, |idx, frame| {
+            self.evictable_frame(idx, NR_COMMITTED_REFS) == Some(frame.start_paddr())
+        }) {
+            Ok(decommitted) => decommitted.into_iter().collect(),
+            Err(err) => {
+                warn!("failed to evict the pages: {:?}", err);
+                return 0;
+            }
+        };
+
+        // The other pages may not be committed in the VMO at all, e.g., the pages read ahead.
+        let nr_uncommitted_evicted = self.update_pages(|pages| {
+            let mut nr_evicted = 0;
+            for idx in candidates.iter().filter(|idx| !decommitted.contains(idx)) {
+                if self.evictable_frame(*idx, 1).is_some() && pages.remove(*idx).is_some() {
+                    nr_evicted += 1;
+                }
+            }
+            nr_evicted
+        });
+        decommitted.len() + nr_uncommitted_evicted
+    }
+
+    fn prefetch(self: &Arc<Self>, range: Range<usize>) -> Result<Option<PageCachePrefetch>> {
         let backend = self.backend();
-        // Checks for the previous readahead.
-        if ra_state.prev_readahead_is_completed() {
-            ra_state.wait_for_prev_readahead(&mut pages)?;
+        let page_idx_range = get_page_idx_range(&range);
+        let page_idx_range = page_idx_range.start..page_idx_range.end.min(backend.npages());
+
+        let missing_indices: Vec<usize> = {
+            let pages = self.pages.read();
+            page_idx_range
+                .filter(|idx| pages.load(*idx as u64).is_none())
+                .collect()
+        };
+        let mut prefetched_pages: Vec<(usize, Frame)> = Vec::with_capacity(missing_indices.len());
+        let mut waiter = BioWaiter::new();
+        for idx in missing_indices {
+            prefetched_pages.push((idx, alloc_uninit_frame()?));
         }
+
+        // The consecutive missing pages are read in runs.
+        for run in prefetched_pages.chunk_by(|(prev_idx, _), (idx, _)| prev_idx + 1 == *idx) {
+            let frames: Vec<Frame> = run.iter().map(|(_, frame)| frame.clone()).collect();
+            waiter.concat(backend.read_pages(run[0].0, &frames)?);
+        }
+
+        if prefetched_pages.is_empty() {
+            return Ok(None);
+        }
+        Ok(Some(PageCachePrefetch {
+            manager: self.clone(),
+            pages: prefetched_pages,
+            waiter,
+        }))
+    }
+
+    /// Reads the page for the VMO, and reads ahead the following pages if the page
+    /// is accessed by a sequential stream.
+    ///
+    /// The readahead does not wait for the I/O. A page being read ahead is waited for
+    /// only when it is accessed, without blocking the accesses to the other pages.
+    fn ondemand_readahead(&self, idx: usize) -> Result<Frame> {
+        let backend = self.backend();
+        let inflight = {
+            let mut ra_state = self.ra_state.lock();
+            let finished = ra_state.take_finished();
+            self.complete_readaheads(&finished);
+            if let Some(readahead_range) = ra_state.access(idx, backend.npages()) {
+                self.update_pages(|pages| {
+                    ra_state.conduct_readahead(pages, readahead_range, &backend)
+                })?;
+            }
+            ra_state.find_inflight(idx)
+        };
+
         // There are three possible conditions that could be encountered upon reaching here.
         // 1. The requested page is ready for read in page cache.
         // 2. The requested page is in previous readahead range, not ready for now.
         // 3. The requested page is on disk, need a sync read operation here.
-        let frame = if let Some(page) = pages.get(&idx) {
-            // Cond 1 & 2.
-            if let PageState::Uninit = page.state() {
-                // Cond 2: We should wait for the previous readahead.
-                // If there is no previous readahead, an error must have occurred somewhere.
-                if ra_state.request_number() == 0 {
-                    return_errno!(Errno::EINVAL)
-                }
-                ra_state.wait_for_prev_readahead(&mut pages)?;
-                pages.get(&idx).unwrap().frame().clone()
-            } else {
-                // Cond 1.
-                page.frame().clone()
+        if let Some((frame, state)) = self.load_page(idx) {
+            // Cond 1.
+            if !matches!(state, PageState::Uninit) {
+                return Ok(frame);
+            }
+            // Cond 2: We should wait for the previous readahead. If the readahead fails,
+            // the page is read again synchronously.
+            if let Some(readahead) = inflight {
+                readahead.waiter.wait();
+                self.complete_readaheads(&[readahead]);
             }
+            if let Some((frame, state)) = self.load_page(idx)
+                && !matches!(state, PageState::Uninit)
+            {
+                return Ok(frame);
+            }
+        }
+
+        // Cond 3.
+        // Conducts the sync read operation.
+        let (frame, state) = if idx < backend.npages() {
+            let frame = alloc_uninit_frame()?;
+            backend.read_page_sync(idx, &frame)?;
+            (frame, PageState::UpToDate)
         } else {
-            // Cond 3.
-            // Conducts the sync read operation.
-            let page = if idx < backend.npages() {
-                let mut page = Page::alloc()?;
-                backend.read_page_sync(idx, page.frame())?;
-                page.set_state(PageState::UpToDate);
-                page
-            } else {
-                Page::alloc_zero()?
-            };
-            let frame = page.frame().clone();
-            pages.put(idx, page);
-            frame
+            self.has_dirty_pages.store(true, Ordering::Relaxed);
+            (FrameAllocOptions::new(1).alloc_single()?, PageState::Dirty)
         };
-        if ra_state.should_readahead(idx, backend.npages()) {
-            ra_state.setup_window(idx, backend.npages());
-            ra_state.conduct_readahead(&mut pages, backend)?;
+        Ok(self.update_pages(|pages| {
+            // The page may have been read by others in the meantime.
+            if let Some((cached_frame, cached_state)) = pages.get(idx)
+                && !matches!(cached_state, PageState::Uninit)
+            {
+                return cached_frame;
+            }
+            pages.put(idx, frame.clone(), state);
+            frame
+        }))
+    }
+
+    /// Makes the pages of the finished readaheads up to date, or removes them if
+    /// the readaheads fail.
+    ///
+    /// The pages that have been replaced in the meantime are left untouched.
+    fn complete_readaheads(&self, readaheads: &[Arc<InflightReadahead>]) {
+        if readaheads.is_empty() {
+            return;
         }
-        ra_state.set_prev_page(idx);
-        Ok(frame)
+        self.update_pages(|pages| {
+            for readahead in readaheads {
+                let is_completed = matches!(readahead.waiter.wait(), Some(BioStatus::Complete));
+                for (idx, frame) in readahead.pages.iter() {
+                    if !pages.is_in_frame(*idx, frame)
+                        || !matches!(pages.state(*idx), Some(PageState::Uninit))
+                    {
+                        continue;
+                    }
+                    if is_completed {
+                        pages.set_state(*idx, PageState::UpToDate);
+                    } else {
+                        pages.remove(*idx);
+                    }
+                }
+            }
+        });
+    }
+
+    /// Starts reading ahead the pages within the page index range, without waiting
+    /// for the I/O to complete.
+    fn readahead(&self, idx_range: Range<usize>) -> Result<()> {
+        const MAX_READAHEAD_BATCH: usize = 256;
+
+        let backend = self.backend();
+        let idx_range = idx_range.start..idx_range.end.min(backend.npages());
+        let mut ra_state = self.ra_state.lock();
+        let finished = ra_state.take_finished();
+        self.complete_readaheads(&finished);
+        for batch_start in idx_range.clone().step_by(MAX_READAHEAD_BATCH) {
+            let batch_end = (batch_start + MAX_READAHEAD_BATCH).min(idx_range.end);
+            self.update_pages(|pages| {
+                ra_state.conduct_readahead(pages, batch_start..batch_end, &backend)
+            })?;
+        }
+        Ok(())
+    }
+
+    fn advise(&self, range: Range<usize>, advice: FileAdvice) -> Result<()> {
+        // The range may end at `usize::MAX` (e.g., a zero length in `fadvise`), so clamp
+        // it to the pages of the file before aligning it to pages.
+        let max_end = self.backend().npages() * PAGE_SIZE;
+        let range = range.start.min(max_end)..range.end.min(max_end);
+        let idx_range = get_page_idx_range(&range);
+        match advice {
+            FileAdvice::Normal => self
+                .ra_state
+                .lock()
+                .set_max_window_size(ReadaheadState::DEFAULT_MAX_SIZE),
+            FileAdvice::Sequential => self
+                .ra_state
+                .lock()
+                .set_max_window_size(ReadaheadState::DEFAULT_MAX_SIZE * 2),
+            FileAdvice::Random => self.ra_state.lock().set_max_window_size(0),
+            FileAdvice::WillNeed => self.readahead(idx_range)?,
+            FileAdvice::DontNeed => {
+                // Unlike the evictions of the writeback thread, the pages are expected to be
+                // evicted now, so wait for the replaced indices that refer to them.
+                synchronize_rcu();
+                self.evict_pages(usize::MAX, |idx| idx_range.contains(&idx));
+            }
+            FileAdvice::NoReuse => {}
+        }
+        Ok(())
     }
 }
 
 impl Debug for PageCacheManager {
     fn fmt(&self, f: &mut core::fmt::Formatter) -> core::fmt::Result {
         f.debug_struct("PageCacheManager")
-            .field("pages", &self.pages.lock())
+            .field("nr_pages", &self.lru.lock().len())
             .finish()
     }
 }
@@ -394,80 +882,224 @@ impl Pager for PageCacheManager {
         self.ondemand_readahead(idx)
     }
 
+    fn try_commit_page(&self, idx: usize) -> Option<Frame> {
+        let (frame, state) = self.load_page(idx)?;
+        // The page may be under the I/O of a readahead.
+        if let PageState::Uninit = state {
+            return None;
+        }
+        Some(frame)
+    }
+
     fn update_page(&self, idx: usize) -> Result<()> {
-        let mut pages = self.pages.lock();
-        if let Some(page) = pages.get_mut(&idx) {
-            page.set_state(PageState::Dirty);
-        } else {
-            warn!("The page {} is not in page cache", idx);
+        // A page that is written repeatedly is usually dirty already. If the page is being
+        // cleaned by a writeback concurrently, the writeback has not submitted the I/O yet,
+        // so the written content is still written back.
+        if !matches!(self.load_state(idx), Some(PageState::Dirty)) {
+            if self.update_pages(|pages| pages.set_state(idx, PageState::Dirty)) {
+                self.has_dirty_pages.store(true, Ordering::Relaxed);
+            } else {
+                warn!("The page {} is not in page cache", idx);
+            }
+        }
+        Ok(())
+    }
+
+    fn update_page_range(&self, idx_range: Range<usize>) -> Result<()> {
+        for idx in idx_range {
+            self.update_page(idx)?;
         }
 
+        // Throttle the writer once after all the pages of the write are dirtied.
+        throttle_dirty_pages();
         Ok(())
     }
 
     fn decommit_page(&self, idx: usize) -> Result<()> {
-        let page_result = self.pages.lock().pop(&idx);
-        if let Some(page) = page_result {
-            if let PageState::Dirty = page.state() {
-                let Some(backend) = self.backend.upgrade() else {
-                    return Ok(());
-                };
-                if idx < backend.npages() {
-                    backend.write_page_sync(idx, page.frame())?;
-                }
-            }
+        self.decommit_pages(&[idx])
+    }
+
+    fn decommit_pages(&self, indices: &[usize]) -> Result<()> {
+        let dirty_pages: Vec<(usize, Frame)> = self.update_pages(|pages| {
+            indices
+                .iter()
+                .filter_map(|idx| match pages.remove(*idx)? {
+                    (frame, PageState::Dirty) => Some((*idx, frame)),
+                    _ => None,
+                })
+                .collect()
+        });
+        if dirty_pages.is_empty() {
+            return Ok(());
         }
 
+        let Some(backend) = self.backend.upgrade() else {
+            return Ok(());
+        };
+        for (idx, frame) in dirty_pages {
+            if idx < backend.npages() {
+                backend.write_page_sync(idx, &frame)?;
+            }
+        }
         Ok(())
     }
 
     fn commit_overwrite(&self, idx: usize) -> Result<Frame> {
-        if let Some(page) = self.pages.lock().get(&idx) {
-            return Ok(page.frame.clone());
+        // A page being read ahead is replaced like a missing page, otherwise the readahead
+        // would overwrite the written content when it completes.
+        if let Some((frame, state)) = self.load_page(idx)
+            && !matches!(state, PageState::Uninit)
+        {
+            return Ok(frame);
         }
 
-        let page = Page::alloc_zero()?;
-        Ok(self.pages.lock().get_or_insert(idx, || page).frame.clone())
+        let new_frame = FrameAllocOptions::new(1).alloc_single()?;
+        self.has_dirty_pages.store(true, Ordering::Relaxed);
+        Ok(self.update_pages(|pages| {
+            if let Some((frame, state)) = pages.get(idx)
+                && !matches!(state, PageState::Uninit)
+            {
+                return frame;
+            }
+            pages.put(idx, new_frame.clone(), PageState::Dirty);
+            new_frame
+        }))
     }
 }
 
-#[derive(Debug)]
-struct Page {
-    frame: Frame,
-    state: PageState,
+/// The pages of a page cache that are being updated by [`PageCacheManager::update_pages`].
+///
+/// The numbers of the cached and the dirty pages are maintained as the pages are updated.
+struct PagesMut<'a> {
+    pages: &'a mut XArray<Frame, PageMark>,
+    lru: &'a mut LruCache<usize, ()>,
+    is_modified: bool,
 }
 
-impl Page {
-    pub fn alloc() -> Result<Self> {
-        let frame = FrameAllocOptions::new(1).uninit(true).alloc_single()?;
-        Ok(Self {
-            frame,
-            state: PageState::Uninit,
-        })
+impl PagesMut<'_> {
+    /// Gets the page and its state, and marks the page as used most recently.
+    fn get(&mut self, idx: usize) -> Option<(Frame, PageState)> {
+        let page = self.peek(idx)?;
+        self.lru.promote(&idx);
+        Some(page)
+    }
+
+    /// Gets the page and its state.
+    fn peek(&self, idx: usize) -> Option<(Frame, PageState)> {
+        let mut cursor = self.pages.cursor(idx as u64);
+        let state = PageState::from_marks(|mark| cursor.is_marked(mark));
+        let frame = cursor.load()?.clone();
+        Some((frame, state))
     }
 
-    pub fn alloc_zero() -> Result<Self> {
-        let frame = FrameAllocOptions::new(1).alloc_single()?;
-        Ok(Self {
-            frame,
-            state: PageState::Dirty,
-        })
+    fn state(&self, idx: usize) -> Option<PageState> {
+        let mut cursor = self.pages.cursor(idx as u64);
+        cursor.load()?;
+        Some(PageState::from_marks(|mark| cursor.is_marked(mark)))
     }
 
-    pub fn frame(&self) -> &Frame {
-        &self.frame
+    fn contains(&self, idx: usize) -> bool {
+        self.pages.load(idx as u64).is_some()
     }
 
-    pub fn state(&self) -> &PageState {
-        &self.state
+    /// Returns whether the page is in the frame, i.e., has not been replaced or removed.
+    fn is_in_frame(&self, idx: usize, frame: &Frame) -> bool {
+        self.pages
+            .load(idx as u64)
+            .is_some_and(|page_frame| page_frame.start_paddr() == frame.start_paddr())
     }
 
-    pub fn set_state(&mut self, new_state: PageState) {
-        self.state = new_state;
+    /// Returns the indices of the dirty pages.
+    fn dirty_indices(&self) -> impl Iterator<Item = usize> + '_ {
+        self.lru
+            .iter()
+            .map(|(idx, _)| *idx)
+            .filter(move |idx| matches!(self.state(*idx), Some(PageState::Dirty)))
     }
+
+    /// Puts a page, which replaces the existing page with the same index.
+    fn put(&mut self, idx: usize, frame: Frame, state: PageState) {
+        self.remove(idx);
+        let mut cursor = self.pages.cursor_mut(idx as u64);
+        cursor.store(frame);
+        state.mark(&mut cursor);
+        set_mark(&mut cursor, PageMark::Writeback, false);
+        self.lru.put(idx, ());
+        self.is_modified = true;
+
+        let nr_cached_pages = NR_CACHED_PAGES.fetch_add(1, Ordering::Relaxed) + 1;
+        if let PageState::Dirty = state {
+            NR_DIRTY_PAGES.fetch_add(1, Ordering::Relaxed);
+        }
+        if nr_cached_pages > PageCacheLimits::get().max_pages()
+            && !EVICTION_STALLED.load(Ordering::Relaxed)
+        {
+            wake_writeback_thread();
+        }
+    }
+
+    /// Sets the state of the page.
+    ///
+    /// Returns `false` if the page does not exist.
+    fn set_state(&mut self, idx: usize, new_state: PageState) -> bool {
+        let Some(old_state) = self.state(idx) else {
+            return false;
+        };
+        match (old_state, new_state) {
+            (PageState::Dirty, PageState::Dirty) => {}
+            (PageState::Dirty, _) => {
+                NR_DIRTY_PAGES.fetch_sub(1, Ordering::Relaxed);
+            }
+            (_, PageState::Dirty) => {
+                NR_DIRTY_PAGES.fetch_add(1, Ordering::Relaxed);
+            }
+            _ => {}
+        }
+        new_state.mark(&mut self.pages.cursor_mut(idx as u64));
+        self.is_modified = true;
+        true
+    }
+
+    /// Sets whether the page is under writeback, if the page exists.
+    fn set_writeback(&mut self, idx: usize, is_writeback: bool) {
+        let mut cursor = self.pages.cursor_mut(idx as u64);
+        if cursor.load().is_none() {
+            return;
+        }
+        set_mark(&mut cursor, PageMark::Writeback, is_writeback);
+        self.is_modified = true;
+    }
+
+    /// Removes the page, and returns the page and its state.
+    fn remove(&mut self, idx: usize) -> Option<(Frame, PageState)> {
+        let state = self.state(idx)?;
+        let frame = self.pages.cursor_mut(idx as u64).remove()?;
+        self.lru.pop(&idx);
+        self.is_modified = true;
+
+        NR_CACHED_PAGES.fetch_sub(1, Ordering::Relaxed);
+        if let PageState::Dirty = state {
+            NR_DIRTY_PAGES.fetch_sub(1, Ordering::Relaxed);
+        }
+        Some((frame, state))
+    }
+}
+
+/// Allocates a frame for a page whose content is to be read from the backend.
+fn alloc_uninit_frame() -> Result<Frame> {
+    Ok(FrameAllocOptions::new(1).uninit(true).alloc_single()?)
 }
 
-#[derive(Debug)]
+fn set_mark(cursor: &mut CursorMut<'_, Frame, PageMark>, mark: PageMark, is_marked: bool) {
+    // The cursor points to a page, so setting or unsetting the mark never fails.
+    if is_marked {
+        cursor.set_mark(mark).unwrap();
+    } else {
+        cursor.unset_mark(mark).unwrap();
+    }
+}
+
+#[derive(Debug, Clone, Copy)]
 enum PageState {
     /// `Uninit` indicates a new allocated page which content has not been initialized.
     /// The page is available to write, not available to read.
@@ -480,14 +1112,82 @@ enum PageState {
     Dirty,
 }
 
+impl PageState {
+    /// Gets the state from the marks of a page.
+    fn from_marks(mut is_marked: impl FnMut(PageMark) -> bool) -> Self {
+        if is_marked(PageMark::Dirty) {
+            Self::Dirty
+        } else if is_marked(PageMark::UpToDate) {
+            Self::UpToDate
+        } else {
+            Self::Uninit
+        }
+    }
+
+    /// Marks the page pointed by the cursor with the state.
+    fn mark(&self, cursor: &mut CursorMut<'_, Frame, PageMark>) {
+        set_mark(cursor, PageMark::UpToDate, matches!(self, Self::UpToDate));
+        set_mark(cursor, PageMark::Dirty, matches!(self, Self::Dirty));
+    }
+}
+
+/// The marks of the pages in the index of a page cache.
+///
+/// A page is marked with at most one of `UpToDate` and `Dirty`, and is `PageState::Uninit`
+/// if it is marked with neither of them.
+#[derive(Clone, Copy)]
+enum PageMark {
+    UpToDate,
+    Dirty,
+    /// The page is being written back to the backend.
+    Writeback,
+}
+
+impl From<PageMark> for XMark {
+    fn from(val: PageMark) -> Self {
+        match val {
+            PageMark::UpToDate => XMark::Mark0,
+            PageMark::Dirty => XMark::Mark1,
+            PageMark::Writeback => XMark::Mark2,
+        }
+    }
+}
+
 /// This trait represents the backend for the page cache.
 pub trait PageCacheBackend: Sync + Send {
     /// Reads a page from the backend asynchronously.
     fn read_page(&self, idx: usize, frame: &Frame) -> Result<BioWaiter>;
     /// Writes a page to the backend asynchronously.
     fn write_page(&self, idx: usize, frame: &Frame) -> Result<BioWaiter>;
+    /// Reads consecutive pages starting from the `idx`-th page from the backend asynchronously.
+    ///
+    /// The backend may override it to read the pages with fewer but larger requests.
+    fn read_pages(&self, idx: usize, frames: &[Frame]) -> Result<BioWaiter> {
+        let mut waiter = BioWaiter::new();
+        for (i, frame) in frames.iter().enumerate() {
+            waiter.concat(self.read_page(idx + i, frame)?);
+        }
+        Ok(waiter)
+    }
+    /// Writes consecutive pages starting from the `idx`-th page to the backend asynchronously.
+    ///
+    /// The backend may override it to write the pages with fewer but larger requests.
+    fn write_pages(&self, idx: usize, frames: &[Frame]) -> Result<BioWaiter> {
+        let mut waiter = BioWaiter::new();
+        for (i, frame) in frames.iter().enumerate() {
+            waiter.concat(self.write_page(idx + i, frame)?);
+        }
+        Ok(waiter)
+    }
     /// Returns the number of pages in the backend.
     fn npages(&self) -> usize;
+    /// Returns whether clean pages can be evicted from the page cache and read back later.
+    ///
+    /// A backend that keeps its data only in the page cache (e.g., a RAM-based file system)
+    /// must return `false`.
+    fn can_evict_clean_pages(&self) -> bool {
+        true
+    }
 }
 
 impl dyn PageCacheBackend {
@@ -508,3 +1208,201 @@ impl dyn PageCacheBackend {
         }
     }
 }
+
+/// The limits of the memory and the dirty pages of all the page caches.
+///
+/// The limits can be tuned at runtime and take effect on the next check.
+pub struct PageCacheLimits {
+    /// The maximum number of pages in the page caches, or zero for the default.
+    max_pages: AtomicUsize,
+    /// The percentage of `max_pages` at which writers are throttled.
+    dirty_ratio: AtomicUsize,
+    /// The percentage of `max_pages` at which the writeback thread starts to work.
+    dirty_background_ratio: AtomicUsize,
+}
+
+static PAGE_CACHE_LIMITS: PageCacheLimits = PageCacheLimits {
+    max_pages: AtomicUsize::new(0),
+    dirty_ratio: AtomicUsize::new(20),
+    dirty_background_ratio: AtomicUsize::new(10),
+};
+
+impl PageCacheLimits {
+    /// Returns the global limits.
+    pub fn get() -> &'static Self {
+        &PAGE_CACHE_LIMITS
+    }
+
+    /// Returns the maximum number of pages in the page caches.
+    ///
+    /// By default, the page caches can take half of the physical memory.
+    pub fn max_pages(&self) -> usize {
+        match self.max_pages.load(Ordering::Relaxed) {
+            0 => total_pages() / 2,
+            max_pages => max_pages,
+        }
+    }
+
+    /// Sets the maximum number of pages in the page caches.
+    ///
+    /// Zero restores the default limit.
+    pub fn set_max_pages(&self, max_pages: usize) {
+        self.max_pages.store(max_pages, Ordering::Relaxed);
+        EVICTION_STALLED.store(false, Ordering::Relaxed);
+        wake_writeback_thread();
+    }
+
+    /// Returns the percentage of the limit of pages at which writers are throttled.
+    pub fn dirty_ratio(&self) -> usize {
+        self.dirty_ratio.load(Ordering::Relaxed)
+    }
+
+    /// Sets the percentage of the limit of pages at which writers are throttled.
+    pub fn set_dirty_ratio(&self, ratio: usize) -> Result<()> {
+        if ratio == 0 || ratio > 100 {
+            return_errno_with_message!(Errno::EINVAL, "the dirty ratio is out of range");
+        }
+        self.dirty_ratio.store(ratio, Ordering::Relaxed);
+        Ok(())
+    }
+
+    /// Returns the percentage of the limit of pages at which the writeback starts.
+    pub fn dirty_background_ratio(&self) -> usize {
+        self.dirty_background_ratio.load(Ordering::Relaxed)
+    }
+
+    /// Sets the percentage of the limit of pages at which the writeback starts.
+    pub fn set_dirty_background_ratio(&self, ratio: usize) -> Result<()> {
+        if ratio == 0 || ratio > 100 {
+            return_errno_with_message!(Errno::EINVAL, "the dirty ratio is out of range");
+        }
+        self.dirty_background_ratio.store(ratio, Ordering::Relaxed);
+        Ok(())
+    }
+
+    fn dirty_threshold(&self) -> usize {
+        self.max_pages() / 100 * self.dirty_ratio()
+    }
+
+    fn dirty_background_threshold(&self) -> usize {
+        // The writeback starts no later than writers are throttled.
+        self.max_pages() / 100 * self.dirty_background_ratio().min(self.dirty_ratio())
+    }
+}
+
+/// The number of pages in all the page caches.
+static NR_CACHED_PAGES: AtomicUsize = AtomicUsize::new(0);
+/// The number of dirty pages in all the page caches.
+static NR_DIRTY_PAGES: AtomicUsize = AtomicUsize::new(0);
+
+/// The managers of all the page caches, which are visited by the writeback thread.
+static PAGE_CACHE_MANAGERS: Mutex<Vec<Weak<PageCacheManager>>> = Mutex::new(Vec::new());
+
+/// The interval of the periodic writeback.
+const WRITEBACK_INTERVAL: Duration = Duration::from_secs(5);
+/// The maximum number of pages that are written back at a time.
+const MAX_WRITEBACK_BATCH: usize = 256;
+/// The maximum number of pages that are evicted from a page cache at a time.
+const MAX_EVICTION_BATCH: usize = 64;
+/// The maximum time that a writer is throttled for each write.
+const MAX_DIRTY_PAUSE: Duration = Duration::from_millis(200);
+
+static WRITEBACK_THREAD: Once<Arc<Thread>> = Once::new();
+static WRITEBACK_WAIT_QUEUE: WaitQueue = WaitQueue::new();
+static WRITEBACK_REQUESTED: AtomicBool = AtomicBool::new(false);
+/// Whether the last eviction failed to evict any page, e.g., because
+/// the remaining pages are all dirty, mapped, or cannot be evicted.
+///
+/// The allocation of pages stops waking the writeback thread for eviction
+/// until the next periodic writeback, which tries the eviction again.
+static EVICTION_STALLED: AtomicBool = AtomicBool::new(false);
+/// The writers that are throttled, which wait for the dirty pages to be written back.
+static THROTTLE_WAIT_QUEUE: WaitQueue = WaitQueue::new();
+
+/// Starts the writeback thread for all the page caches.
+pub fn start_writeback_thread() {
+    WRITEBACK_THREAD.call_once(|| {
+        Thread::spawn_kernel_thread(ThreadOptions::new(|| loop {
+            let is_requested = WRITEBACK_WAIT_QUEUE
+                .wait_until_or_timeout(
+                    || {
+                        WRITEBACK_REQUESTED
+                            .swap(false, Ordering::Relaxed)
+                            .then_some(())
+                    },
+                    &WRITEBACK_INTERVAL,
+                )
+                .is_some();
+            if !is_requested {
+                EVICTION_STALLED.store(false, Ordering::Relaxed);
+            }
+            do_writeback();
+        }))
+    });
+}
+
+fn wake_writeback_thread() {
+    if !WRITEBACK_REQUESTED.swap(true, Ordering::Relaxed) {
+        WRITEBACK_WAIT_QUEUE.wake_all();
+    }
+}
+
+/// Writes back the dirty pages of all the page caches, and then evicts clean pages
+/// if the page caches take more memory than allowed.
+fn do_writeback() {
+    let managers: Vec<Arc<PageCacheManager>> = {
+        let mut managers = PAGE_CACHE_MANAGERS.lock();
+        managers.retain(|manager| manager.strong_count() > 0);
+        managers.iter().filter_map(Weak::upgrade).collect()
+    };
+
+    for manager in managers.iter() {
+        if let Err(err) = manager.write_back_all() {
+            warn!("failed to write back the page cache: {:?}", err);
+        }
+    }
+
+    let max_pages = PageCacheLimits::get().max_pages();
+    if NR_CACHED_PAGES.load(Ordering::Relaxed) <= max_pages {
+        return;
+    }
+    // Evict a few more pages than needed, so the eviction is not triggered by every allocation.
+    let target_pages = max_pages - max_pages / 16;
+    loop {
+        let mut nr_evicted = 0;
+        for manager in managers.iter() {
+            let nr_cached_pages = NR_CACHED_PAGES.load(Ordering::Relaxed);
+            if nr_cached_pages <= target_pages {
+                return;
+            }
+            nr_evicted +=
+                manager.evict_clean_pages((nr_cached_pages - target_pages).min(MAX_EVICTION_BATCH));
+        }
+        if nr_evicted == 0 {
+            EVICTION_STALLED.store(true, Ordering::Relaxed);
+            return;
+        }
+    }
+}
+
+/// Throttles the current writer if there are too many dirty pages.
+///
+/// The writer waits for the writeback thread to clean the pages, but no longer
+/// than `MAX_DIRTY_PAUSE` for each write. This is because the writer may hold
+/// the locks that are required to write back its own pages.
+fn throttle_dirty_pages() {
+    let limits = PageCacheLimits::get();
+    let nr_dirty_pages = NR_DIRTY_PAGES.load(Ordering::Relaxed);
+    if nr_dirty_pages <= limits.dirty_background_threshold() || WRITEBACK_THREAD.get().is_none() {
+        return;
+    }
+    wake_writeback_thread();
+
+    if nr_dirty_pages <= limits.dirty_threshold() {
+        return;
+    }
+    THROTTLE_WAIT_QUEUE.wait_until_or_timeout(
+        || (NR_DIRTY_PAGES.load(Ordering::Relaxed) <= limits.dirty_threshold()).then_some(()),
+        &MAX_DIRTY_PAUSE,
+    );
+}
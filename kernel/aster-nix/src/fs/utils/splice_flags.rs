@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: MPL-2.0
+
+use bitflags::bitflags;
+
+bitflags! {
+    /// The flags of `splice`, `tee`, and `vmsplice`, which are also passed to the
+    /// files that the data is spliced to.
+    pub struct SpliceFlags: u32 {
+        /// Move pages instead of copying. It is only a hint.
+        const SPLICE_F_MOVE = 1;
+        /// Do not block on pipe operations.
+        const SPLICE_F_NONBLOCK = 2;
+        /// More data will be coming in a subsequent splice.
+        const SPLICE_F_MORE = 4;
+        /// Gift the user pages to the kernel. It is only a hint.
+        const SPLICE_F_GIFT = 8;
+    }
+}
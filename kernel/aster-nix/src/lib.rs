@@ -54,6 +54,7 @@ pub mod events;
 pub mod fs;
 pub mod net;
 pub mod prelude;
+pub mod perf;
 mod process;
 mod sched;
 pub mod softirq_id;
@@ -71,10 +72,12 @@ pub fn init() {
     time::init();
     net::init();
     sched::init();
+    perf::init();
     fs::rootfs::init(boot::initramfs()).unwrap();
     device::init().unwrap();
     vdso::init();
     taskless::init();
+    ostd::sync::enable_rcu_softirq(softirq_id::RCU_SOFTIRQ_ID);
     process::init();
 }
 
@@ -86,6 +89,7 @@ fn init_thread() {
     // Work queue should be initialized before interrupt is enabled,
     // in case any irq handler uses work queue as bottom half
     thread::work_queue::init();
+    thread::softirq_daemon::init();
     // FIXME: Remove this if we move the step of mounting
     // the filesystems to be done within the init process.
     ostd::trap::enable_local();
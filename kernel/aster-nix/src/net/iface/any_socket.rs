@@ -65,7 +65,6 @@ pub struct AnyBoundSocket {
     port: u16,
     socket_family: SocketFamily,
     observer: RwLock<Weak<dyn Observer<()>>>,
-    weak_self: Weak<Self>,
 }
 
 impl AnyBoundSocket {
@@ -76,13 +75,12 @@ impl AnyBoundSocket {
         socket_family: SocketFamily,
         observer: Weak<dyn Observer<()>>,
     ) -> Arc<Self> {
-        Arc::new_cyclic(|weak_self| Self {
+        Arc::new(Self {
             iface,
             handle,
             port,
             socket_family,
             observer: RwLock::new(observer),
-            weak_self: weak_self.clone(),
         })
     }
 
@@ -104,6 +102,11 @@ impl AnyBoundSocket {
         self.on_iface_events();
     }
 
+    /// Returns the observer whose `on_events` will be called when certain iface events happen.
+    pub fn observer(&self) -> Weak<dyn Observer<()>> {
+        self.observer.read().clone()
+    }
+
     pub fn local_endpoint(&self) -> Option<IpEndpoint> {
         let ip_addr = {
             let ipv4_addr = self.iface.ipv4_addr()?;
@@ -138,10 +141,6 @@ impl AnyBoundSocket {
         &self.iface
     }
 
-    pub(super) fn weak_ref(&self) -> Weak<Self> {
-        self.weak_self.clone()
-    }
-
     fn close(&self) {
         match self.socket_family {
             SocketFamily::Tcp => self.raw_with(|socket: &mut RawTcpSocket| socket.close()),
@@ -154,9 +153,10 @@ impl Drop for AnyBoundSocket {
     fn drop(&mut self) {
         self.close();
         self.iface.poll();
+        // The handle can be reused once the socket is removed, so remove the bound socket first.
+        self.iface.common().remove_bound_socket(self.handle);
         self.iface.common().remove_socket(self.handle);
         self.iface.common().release_port(self.port);
-        self.iface.common().remove_bound_socket(self.weak_ref());
     }
 }
 
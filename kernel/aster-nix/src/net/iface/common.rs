@@ -1,13 +1,14 @@
 // SPDX-License-Identifier: MPL-2.0
 
 use alloc::collections::btree_map::Entry;
-use core::sync::atomic::{AtomicU64, Ordering};
+use core::sync::atomic::{AtomicBool, AtomicU16, AtomicU64, Ordering};
 
-use keyable_arc::KeyableWeak;
 use ostd::sync::WaitQueue;
 use smoltcp::{
     iface::{SocketHandle, SocketSet},
-    phy::Device,
+    phy::{Device, DeviceCapabilities},
+    socket::Socket,
+    time::Instant,
     wire::IpCidr,
 };
 
@@ -22,25 +23,40 @@ use crate::prelude::*;
 pub struct IfaceCommon {
     interface: SpinLock<smoltcp::iface::Interface>,
     sockets: SpinLock<SocketSet<'static>>,
-    used_ports: RwLock<BTreeMap<u16, usize>>,
+    used_ports: PortTable,
     /// The time should do next poll. We stores the total milliseconds since system boots up.
     next_poll_at_ms: AtomicU64,
-    bound_sockets: RwLock<BTreeSet<KeyableWeak<AnyBoundSocket>>>,
+    bound_sockets: RwLock<BTreeMap<SocketHandle, Weak<AnyBoundSocket>>>,
     /// The wait queue that background polling thread will sleep on
     polling_wait_queue: WaitQueue,
+    /// Whether the background polling thread should poll the iface as soon as possible.
+    poll_requested: AtomicBool,
+    /// The buffers that are reused by the polls to find the updated sockets.
+    ///
+    /// The polls are serialized by the lock of `interface`, so this lock is never contended.
+    poll_buffers: SpinLock<PollBuffers>,
+}
+
+#[derive(Default)]
+struct PollBuffers {
+    /// The readiness of the sockets before a poll.
+    old_readiness: Vec<Option<u64>>,
+    /// The sockets whose readiness may be changed by a poll.
+    updated_sockets: Vec<SocketHandle>,
 }
 
 impl IfaceCommon {
     pub(super) fn new(interface: smoltcp::iface::Interface) -> Self {
         let socket_set = SocketSet::new(Vec::new());
-        let used_ports = BTreeMap::new();
         Self {
             interface: SpinLock::new(interface),
             sockets: SpinLock::new(socket_set),
-            used_ports: RwLock::new(used_ports),
+            used_ports: PortTable::new(),
             next_poll_at_ms: AtomicU64::new(0),
-            bound_sockets: RwLock::new(BTreeSet::new()),
+            bound_sockets: RwLock::new(BTreeMap::new()),
             polling_wait_queue: WaitQueue::new(),
+            poll_requested: AtomicBool::new(false),
+            poll_buffers: SpinLock::new(PollBuffers::default()),
         }
     }
 
@@ -68,40 +84,25 @@ impl IfaceCommon {
         &self.polling_wait_queue
     }
 
-    /// Alloc an unused port range from 49152 ~ 65535 (According to smoltcp docs)
-    fn alloc_ephemeral_port(&self) -> Result<u16> {
-        let mut used_ports = self.used_ports.write();
-        for port in IP_LOCAL_PORT_START..=IP_LOCAL_PORT_END {
-            if let Entry::Vacant(e) = used_ports.entry(port) {
-                e.insert(0);
-                return Ok(port);
-            }
-        }
-        return_errno_with_message!(Errno::EAGAIN, "no ephemeral port is available");
+    /// Asks the background polling thread to poll the iface.
+    ///
+    /// This method can be called in the interrupt context.
+    pub(super) fn request_poll(&self) {
+        self.poll_requested.store(true, Ordering::Release);
+        self.polling_wait_queue.wake_all();
     }
 
-    fn bind_port(&self, port: u16, can_reuse: bool) -> Result<()> {
-        let mut used_ports = self.used_ports.write();
-        if let Some(used_times) = used_ports.get_mut(&port) {
-            if *used_times == 0 || can_reuse {
-                *used_times += 1;
-            } else {
-                return_errno_with_message!(Errno::EADDRINUSE, "the address is already in use");
-            }
-        } else {
-            used_ports.insert(port, 1);
-        }
-        Ok(())
+    pub(super) fn has_poll_request(&self) -> bool {
+        self.poll_requested.load(Ordering::Acquire)
+    }
+
+    pub(super) fn take_poll_request(&self) -> bool {
+        self.poll_requested.swap(false, Ordering::AcqRel)
     }
 
     /// Release port number so the port can be used again. For reused port, the port may still be in use.
     pub(super) fn release_port(&self, port: u16) {
-        let mut used_ports = self.used_ports.write();
-        if let Some(used_times) = used_ports.remove(&port) {
-            if used_times != 1 {
-                used_ports.insert(port, used_times - 1);
-            }
-        }
+        self.used_ports.release(port);
     }
 
     pub(super) fn bind_socket(
@@ -111,16 +112,14 @@ impl IfaceCommon {
         config: BindPortConfig,
     ) -> core::result::Result<Arc<AnyBoundSocket>, (Error, Box<AnyUnboundSocket>)> {
         let port = if let Some(port) = config.port() {
-            port
+            self.used_ports.bind(port, &config).map(|_| port)
         } else {
-            match self.alloc_ephemeral_port() {
-                Ok(port) => port,
-                Err(err) => return Err((err, socket)),
-            }
+            self.used_ports.alloc_ephemeral()
+        };
+        let port = match port {
+            Ok(port) => port,
+            Err(err) => return Err((err, socket)),
         };
-        if let Some(err) = self.bind_port(port, config.can_reuse()).err() {
-            return Err((err, socket));
-        }
 
         let (handle, socket_family, observer) = match socket.into_raw() {
             (AnyRawSocket::Tcp(tcp_socket), observer) => (
@@ -135,7 +134,9 @@ impl IfaceCommon {
             ),
         };
         let bound_socket = AnyBoundSocket::new(iface, handle, port, socket_family, observer);
-        self.insert_bound_socket(&bound_socket).unwrap();
+        self.bound_sockets
+            .write()
+            .insert(handle, Arc::downgrade(&bound_socket));
 
         Ok(bound_socket)
     }
@@ -145,21 +146,51 @@ impl IfaceCommon {
         self.sockets.lock_irq_disabled().remove(handle);
     }
 
-    pub(super) fn poll<D: Device + ?Sized>(&self, device: &mut D) {
+    /// Polls the iface with the device.
+    ///
+    /// At most `RX_BUDGET` packets are received, so that a busy device cannot hold
+    /// the locks for too long. Returns whether the budget is exhausted, in which
+    /// case there may be more packets to receive.
+    pub(super) fn poll<D: Device + ?Sized>(&self, device: &mut D) -> bool {
         let mut interface = self.interface.lock_irq_disabled();
         let timestamp = get_network_timestamp();
-        let has_events = {
+        let mut device = BudgetedDevice {
+            device,
+            budget: RX_BUDGET,
+        };
+        let mut poll_buffers = self.poll_buffers.lock_irq_disabled();
+        let PollBuffers {
+            old_readiness,
+            updated_sockets,
+        } = &mut *poll_buffers;
+        {
             let mut sockets = self.sockets.lock_irq_disabled();
-            interface.poll(timestamp, device, &mut sockets)
+            old_readiness.clear();
+            old_readiness.extend(sockets.iter().map(|(_, socket)| readiness(socket)));
+            let has_events = interface.poll(timestamp, &mut device, &mut sockets);
+            // Only the sockets that are updated by this poll need to be notified. Sockets
+            // cannot be added or removed during the poll, so the order stays the same.
+            if has_events {
+                updated_sockets.extend(
+                    sockets
+                        .iter()
+                        .zip(old_readiness.iter())
+                        .filter(|((_, socket), old)| old.is_none() || readiness(socket) != **old)
+                        .map(|((handle, _), _)| handle),
+                );
+            }
             // drop sockets here to avoid deadlock
-        };
-        if has_events {
-            self.bound_sockets.read().iter().for_each(|bound_socket| {
-                if let Some(bound_socket) = bound_socket.upgrade() {
+        }
+        let is_budget_exhausted = device.budget == 0;
+        if !updated_sockets.is_empty() {
+            let bound_sockets = self.bound_sockets.read();
+            for handle in updated_sockets.drain(..) {
+                if let Some(bound_socket) = bound_sockets.get(&handle).and_then(Weak::upgrade) {
                     bound_socket.on_iface_events();
                 }
-            });
+            }
         }
+        drop(poll_buffers);
 
         let sockets = self.sockets.lock_irq_disabled();
         if let Some(instant) = interface.poll_at(timestamp, &sockets) {
@@ -173,6 +204,8 @@ impl IfaceCommon {
         } else {
             self.next_poll_at_ms.store(0, Ordering::Relaxed);
         }
+
+        is_budget_exhausted
     }
 
     pub(super) fn next_poll_at_ms(&self) -> Option<u64> {
@@ -184,21 +217,156 @@ impl IfaceCommon {
         }
     }
 
-    fn insert_bound_socket(&self, socket: &Arc<AnyBoundSocket>) -> Result<()> {
-        let weak_ref = KeyableWeak::from(Arc::downgrade(socket));
-        let mut bound_sockets = self.bound_sockets.write();
-        if bound_sockets.contains(&weak_ref) {
-            return_errno_with_message!(Errno::EINVAL, "the socket is already bound");
+    pub(super) fn remove_bound_socket(&self, handle: SocketHandle) {
+        self.bound_sockets.write().remove(&handle);
+    }
+}
+
+/// Returns a summary of the state of a socket that decides the I/O events of the socket.
+///
+/// If the summary does not change, the I/O events do not change, so there is no need to
+/// notify the socket. `None` means that the socket should always be notified.
+fn readiness(socket: &Socket) -> Option<u64> {
+    match socket {
+        Socket::Tcp(socket) => Some(
+            socket.state() as u64
+                | (socket.can_recv() as u64) << 8
+                | (socket.can_send() as u64) << 9
+                | (socket.recv_queue() as u64) << 16
+                | (socket.send_queue() as u64) << 40,
+        ),
+        _ => None,
+    }
+}
+
+/// The table of the used ports.
+///
+/// The table is sharded by the port numbers, so binding or releasing different ports seldom
+/// contends for the same lock.
+struct PortTable {
+    shards: [RwLock<BTreeMap<u16, PortUsage>>; NR_PORT_SHARDS],
+    /// The ephemeral port to try first, relative to `IP_LOCAL_PORT_START`.
+    next_ephemeral_port: AtomicU16,
+}
+
+impl PortTable {
+    fn new() -> Self {
+        Self {
+            shards: core::array::from_fn(|_| RwLock::new(BTreeMap::new())),
+            next_ephemeral_port: AtomicU16::new(0),
         }
-        bound_sockets.insert(weak_ref);
+    }
+
+    fn shard(&self, port: u16) -> &RwLock<BTreeMap<u16, PortUsage>> {
+        &self.shards[port as usize % NR_PORT_SHARDS]
+    }
+
+    /// Alloc an unused port range from 49152 ~ 65535 (According to smoltcp docs)
+    ///
+    /// The search starts after the last allocated port, so it seldom visits the used ports.
+    /// Consecutive ports belong to different shards, so concurrent allocations do not contend.
+    fn alloc_ephemeral(&self) -> Result<u16> {
+        const NR_EPHEMERAL_PORTS: usize = (IP_LOCAL_PORT_END - IP_LOCAL_PORT_START) as usize + 1;
+
+        for _ in 0..NR_EPHEMERAL_PORTS {
+            let offset = self.next_ephemeral_port.fetch_add(1, Ordering::Relaxed) as usize;
+            let port = IP_LOCAL_PORT_START + (offset % NR_EPHEMERAL_PORTS) as u16;
+            if let Entry::Vacant(entry) = self.shard(port).write().entry(port) {
+                entry.insert(PortUsage::new(false));
+                return Ok(port);
+            }
+        }
+        return_errno_with_message!(Errno::EAGAIN, "no ephemeral port is available");
+    }
+
+    fn bind(&self, port: u16, config: &BindPortConfig) -> Result<()> {
+        let is_shared = matches!(config, BindPortConfig::Shared(_));
+        let mut used_ports = self.shard(port).write();
+        let Some(usage) = used_ports.get_mut(&port) else {
+            used_ports.insert(port, PortUsage::new(is_shared));
+            return Ok(());
+        };
+
+        let can_reuse = match config {
+            BindPortConfig::CanReuse(_) => true,
+            // All the sockets bound to the port must enable `SO_REUSEPORT`.
+            BindPortConfig::Shared(_) => usage.is_shared,
+            BindPortConfig::Specified(_) | BindPortConfig::Ephemeral => false,
+        };
+        if !can_reuse {
+            return_errno_with_message!(Errno::EADDRINUSE, "the address is already in use");
+        }
+        usage.nr_sockets += 1;
         Ok(())
     }
 
-    pub(super) fn remove_bound_socket(&self, socket: Weak<AnyBoundSocket>) {
-        let weak_ref = KeyableWeak::from(socket);
-        self.bound_sockets.write().remove(&weak_ref);
+    fn release(&self, port: u16) {
+        let mut used_ports = self.shard(port).write();
+        if let Entry::Occupied(mut entry) = used_ports.entry(port) {
+            entry.get_mut().nr_sockets -= 1;
+            if entry.get().nr_sockets == 0 {
+                entry.remove();
+            }
+        }
     }
 }
 
+/// The usage of a port in `PortTable`.
+struct PortUsage {
+    /// The number of the sockets bound to the port.
+    nr_sockets: usize,
+    /// Whether the port is bound with `SO_REUSEPORT`.
+    is_shared: bool,
+}
+
+impl PortUsage {
+    fn new(is_shared: bool) -> Self {
+        Self {
+            nr_sockets: 1,
+            is_shared,
+        }
+    }
+}
+
+/// The number of the shards in `PortTable`.
+const NR_PORT_SHARDS: usize = 64;
+
+/// A device that stops receiving packets after receiving `budget` packets.
+struct BudgetedDevice<'a, D: ?Sized> {
+    device: &'a mut D,
+    budget: usize,
+}
+
+impl<D: Device + ?Sized> Device for BudgetedDevice<'_, D> {
+    type RxToken<'a>
+        = D::RxToken<'a>
+    where
+        Self: 'a;
+    type TxToken<'a>
+        = D::TxToken<'a>
+    where
+        Self: 'a;
+
+    fn receive(&mut self, timestamp: Instant) -> Option<(Self::RxToken<'_>, Self::TxToken<'_>)> {
+        if self.budget == 0 {
+            return None;
+        }
+        let tokens = self.device.receive(timestamp)?;
+        self.budget -= 1;
+        Some(tokens)
+    }
+
+    fn transmit(&mut self, timestamp: Instant) -> Option<Self::TxToken<'_>> {
+        self.device.transmit(timestamp)
+    }
+
+    fn capabilities(&self) -> DeviceCapabilities {
+        self.device.capabilities()
+    }
+}
+
+/// The maximum number of packets to receive in one poll.
+const RX_BUDGET: usize = 64;
+
 const IP_LOCAL_PORT_START: u16 = 49152;
 const IP_LOCAL_PORT_END: u16 = 65535;
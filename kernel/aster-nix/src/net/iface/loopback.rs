@@ -65,6 +65,8 @@ impl Iface for IfaceLoopback {
 
     fn poll(&self) {
         let mut device = self.driver.lock();
-        self.common.poll(&mut *device);
+        if self.common.poll(&mut *device) {
+            self.common.request_poll();
+        }
     }
 }
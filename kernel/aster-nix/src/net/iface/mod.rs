@@ -66,6 +66,13 @@ pub trait Iface: internal::IfaceInternal + Send + Sync {
     fn polling_wait_queue(&self) -> &WaitQueue {
         self.common().polling_wait_queue()
     }
+
+    /// Asks the background polling thread to poll the iface.
+    ///
+    /// Unlike `poll`, this method does not block, so it can be called in the interrupt context.
+    fn request_poll(&self) {
+        self.common().request_poll()
+    }
 }
 
 mod internal {
@@ -86,6 +93,13 @@ mod internal {
         fn next_poll_at_ms(&self) -> Option<u64> {
             self.common().next_poll_at_ms()
         }
+        /// Whether the iface should be polled regardless of `next_poll_at_ms`.
+        fn has_poll_request(&self) -> bool {
+            self.common().has_poll_request()
+        }
+        fn take_poll_request(&self) -> bool {
+            self.common().take_poll_request()
+        }
         fn arc_self(&self) -> Arc<dyn Iface>;
     }
 }
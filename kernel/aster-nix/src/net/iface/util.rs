@@ -16,6 +16,8 @@ use crate::{
 
 pub enum BindPortConfig {
     CanReuse(u16),
+    /// The port can be shared with the other sockets that are bound with `SO_REUSEPORT`.
+    Shared(u16),
     Specified(u16),
     Ephemeral,
 }
@@ -36,13 +38,20 @@ impl BindPortConfig {
         Ok(config)
     }
 
-    pub(super) fn can_reuse(&self) -> bool {
-        matches!(self, Self::CanReuse(_))
+    /// Creates the config for a socket with `SO_REUSEPORT`.
+    ///
+    /// If `port` is zero, an ephemeral port is allocated, which is not shared.
+    pub fn new_shared(port: u16) -> Self {
+        if port != 0 {
+            Self::Shared(port)
+        } else {
+            Self::Ephemeral
+        }
     }
 
     pub(super) fn port(&self) -> Option<u16> {
         match self {
-            Self::CanReuse(port) | Self::Specified(port) => Some(*port),
+            Self::CanReuse(port) | Self::Shared(port) | Self::Specified(port) => Some(*port),
             Self::Ephemeral => None,
         }
     }
@@ -53,10 +62,22 @@ pub fn spawn_background_poll_thread(iface: Arc<dyn Iface>) {
         trace!("spawn background poll thread for {}", iface.name());
         let wait_queue = iface.polling_wait_queue();
         loop {
-            let next_poll_at_ms = if let Some(next_poll_at_ms) = iface.next_poll_at_ms() {
-                next_poll_at_ms
-            } else {
-                wait_queue.wait_until(|| iface.next_poll_at_ms())
+            // A poll request comes from the device interrupts or an unfinished poll,
+            // which means that there are packets to receive.
+            if iface.take_poll_request() {
+                iface.poll();
+                continue;
+            }
+
+            let Some(next_poll_at_ms) = iface.next_poll_at_ms() else {
+                // The network is idle, so give the unused receive buffers back.
+                if let Some(rx_buffer_pool) = aster_network::RX_BUFFER_POOL.get() {
+                    rx_buffer_pool.shrink();
+                }
+                wait_queue.wait_until(|| {
+                    (iface.has_poll_request() || iface.next_poll_at_ms().is_some()).then_some(())
+                });
+                continue;
             };
 
             let now_as_ms = Jiffies::elapsed().as_duration().as_millis() as u64;
@@ -76,8 +97,14 @@ pub fn spawn_background_poll_thread(iface: Arc<dyn Iface>) {
 
             let duration = Duration::from_millis(next_poll_at_ms - now_as_ms);
             wait_queue.wait_until_or_timeout(
-                // If `iface.next_poll_at_ms()` changes to an earlier time, we will end the waiting.
-                || (iface.next_poll_at_ms()? < next_poll_at_ms).then_some(()),
+                // If `iface.next_poll_at_ms()` changes to an earlier time or a poll is
+                // requested, we will end the waiting.
+                || {
+                    let is_earlier = iface
+                        .next_poll_at_ms()
+                        .is_some_and(|next| next < next_poll_at_ms);
+                    (iface.has_poll_request() || is_earlier).then_some(())
+                },
                 &duration,
             );
         }
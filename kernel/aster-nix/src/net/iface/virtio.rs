@@ -114,7 +114,18 @@ impl Iface for IfaceVirtio {
 
     fn poll(&self) {
         let mut driver = self.driver.lock_irq_disabled();
-        self.common.poll(&mut *driver);
+        if self.common.poll(&mut *driver) {
+            // There are more packets to receive, so keep polling without interrupts.
+            self.common.request_poll();
+        } else {
+            driver.enable_recv_irq();
+            // The packets that arrive before enabling the interrupts do not raise them.
+            if driver.can_receive() {
+                driver.disable_recv_irq();
+                self.common.request_poll();
+            }
+        }
+        drop(driver);
         self.process_dhcp();
     }
 }
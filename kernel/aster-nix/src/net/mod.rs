@@ -20,11 +20,15 @@ pub fn init() {
         vec![iface_virtio, iface_loopback]
     });
 
-    for (name, _) in aster_network::all_devices() {
-        aster_network::register_recv_callback(&name, || {
+    for (name, device) in aster_network::all_devices() {
+        aster_network::register_recv_callback(&name, move || {
             // TODO: further check that the irq num is the same as iface's irq num
             let iface_virtio = &IFACES.get().unwrap()[0];
-            iface_virtio.poll();
+            // The interrupt only kicks off the polling. The packets are received in
+            // batches by the background polling thread, with no more interrupts
+            // until the device is drained.
+            device.lock_irq_disabled().disable_recv_irq();
+            iface_virtio.request_poll();
         })
     }
     poll_ifaces();
@@ -45,7 +45,7 @@ fn get_ephemeral_iface(remote_ip_addr: &IpAddress) -> Arc<dyn Iface> {
 pub(super) fn bind_socket(
     unbound_socket: Box<AnyUnboundSocket>,
     endpoint: &IpEndpoint,
-    can_reuse: bool,
+    reuse_port: bool,
 ) -> core::result::Result<Arc<AnyBoundSocket>, (Error, Box<AnyUnboundSocket>)> {
     let iface = match get_iface_to_bind(&endpoint.addr) {
         Some(iface) => iface,
@@ -54,9 +54,13 @@ pub(super) fn bind_socket(
             return Err((err, unbound_socket));
         }
     };
-    let bind_port_config = match BindPortConfig::new(endpoint.port, can_reuse) {
-        Ok(config) => config,
-        Err(e) => return Err((e, unbound_socket)),
+    let bind_port_config = if reuse_port {
+        BindPortConfig::new_shared(endpoint.port)
+    } else {
+        match BindPortConfig::new(endpoint.port, false) {
+            Ok(config) => config,
+            Err(e) => return Err((e, unbound_socket)),
+        }
     };
     iface.bind_socket(unbound_socket, bind_port_config)
 }
@@ -6,8 +6,9 @@ use smoltcp::socket::tcp::{RecvError, SendError};
 
 use crate::{
     events::{IoEvents, Observer},
+    fs::utils::FrameSlice,
     net::{
-        iface::{AnyBoundSocket, IpEndpoint, RawTcpSocket},
+        iface::{AnyBoundSocket, Iface, IpEndpoint, RawTcpSocket},
         socket::util::{send_recv_flags::SendRecvFlags, shutdown_cmd::SockShutdownCmd},
     },
     prelude::*,
@@ -83,6 +84,41 @@ impl ConnectedStream {
         }
     }
 
+    /// Sends the data of the frame slices.
+    ///
+    /// The data is copied from the frames directly into the send buffer of the socket.
+    pub fn try_send_frames(&self, frames: &[FrameSlice], _flags: SendRecvFlags) -> Result<usize> {
+        let result = self.bound_socket.raw_with(|socket: &mut RawTcpSocket| {
+            let mut sent_bytes = 0;
+            for frame in frames {
+                let mut reader = frame.reader();
+                while reader.has_remain() {
+                    let len = socket.send(|buf: &mut [u8]| {
+                        let len = reader.read(&mut VmWriter::from(buf));
+                        (len, len)
+                    })?;
+                    if len == 0 {
+                        return Ok(sent_bytes);
+                    }
+                    sent_bytes += len;
+                }
+            }
+            Ok(sent_bytes)
+        });
+
+        match result {
+            Ok(0) => return_errno_with_message!(Errno::EAGAIN, "the send buffer is full"),
+            Ok(sent_bytes) => Ok(sent_bytes),
+            Err(SendError::InvalidState) => {
+                return_errno_with_message!(Errno::ECONNRESET, "the connection is reset");
+            }
+        }
+    }
+
+    pub fn iface(&self) -> &Arc<dyn Iface> {
+        self.bound_socket.iface()
+    }
+
     pub fn local_endpoint(&self) -> IpEndpoint {
         self.bound_socket.local_endpoint().unwrap()
     }
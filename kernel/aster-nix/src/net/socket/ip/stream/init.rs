@@ -27,9 +27,13 @@ impl InitStream {
         InitStream::Bound(bound_socket)
     }
 
+    /// Binds the socket to `endpoint`.
+    ///
+    /// If `reuse_port` is true, the port can be shared with other sockets with `SO_REUSEPORT`.
     pub fn bind(
         self,
         endpoint: &IpEndpoint,
+        reuse_port: bool,
     ) -> core::result::Result<Arc<AnyBoundSocket>, (Error, Self)> {
         let unbound_socket = match self {
             InitStream::Unbound(unbound_socket) => unbound_socket,
@@ -40,7 +44,7 @@ impl InitStream {
                 ));
             }
         };
-        let bound_socket = match bind_socket(unbound_socket, endpoint, false) {
+        let bound_socket = match bind_socket(unbound_socket, endpoint, reuse_port) {
             Ok(bound_socket) => bound_socket,
             Err((err, unbound_socket)) => return Err((err, InitStream::Unbound(unbound_socket))),
         };
@@ -52,7 +56,7 @@ impl InitStream {
         remote_endpoint: &IpEndpoint,
     ) -> core::result::Result<Arc<AnyBoundSocket>, (Error, Self)> {
         let endpoint = get_ephemeral_endpoint(remote_endpoint);
-        self.bind(&endpoint)
+        self.bind(&endpoint, false)
     }
 
     pub fn connect(
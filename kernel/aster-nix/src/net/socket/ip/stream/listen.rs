@@ -1,5 +1,7 @@
 // SPDX-License-Identifier: MPL-2.0
 
+use core::sync::atomic::{AtomicUsize, Ordering};
+
 use smoltcp::socket::tcp::ListenError;
 
 use super::connected::ConnectedStream;
@@ -7,7 +9,7 @@ use crate::{
     events::IoEvents,
     net::iface::{AnyBoundSocket, AnyUnboundSocket, BindPortConfig, IpEndpoint, RawTcpSocket},
     prelude::*,
-    process::signal::Pollee,
+    process::signal::{Pauser, Pollee},
 };
 
 pub struct ListenStream {
@@ -16,6 +18,10 @@ pub struct ListenStream {
     bound_socket: Arc<AnyBoundSocket>,
     /// Backlog sockets listening at the local endpoint
     backlog_sockets: RwLock<Vec<BacklogSocket>>,
+    /// The threads blocked in `accept`
+    acceptors: Arc<Pauser>,
+    /// The number of pending connections that the acceptors have been woken for
+    nr_pending: AtomicUsize,
 }
 
 impl ListenStream {
@@ -27,6 +33,8 @@ impl ListenStream {
             backlog,
             bound_socket,
             backlog_sockets: RwLock::new(Vec::new()),
+            acceptors: Pauser::new(),
+            nr_pending: AtomicUsize::new(0),
         };
         if let Err(err) = listen_stream.fill_backlog_sockets() {
             return Err((err, listen_stream.bound_socket));
@@ -76,6 +84,10 @@ impl ListenStream {
         ))
     }
 
+    pub fn acceptors(&self) -> &Arc<Pauser> {
+        &self.acceptors
+    }
+
     pub fn local_endpoint(&self) -> IpEndpoint {
         self.bound_socket.local_endpoint().unwrap()
     }
@@ -89,12 +101,21 @@ impl ListenStream {
         // The lock should be held to avoid data races
         let backlog_sockets = self.backlog_sockets.read();
 
-        let can_accept = backlog_sockets.iter().any(|socket| socket.is_active());
-        if can_accept {
+        let nr_pending = backlog_sockets
+            .iter()
+            .filter(|socket| socket.is_active())
+            .count();
+        if nr_pending > 0 {
             pollee.add_events(IoEvents::IN);
         } else {
             pollee.del_events(IoEvents::IN);
         }
+
+        // Wake up one acceptor for each new connection.
+        let old_nr_pending = self.nr_pending.swap(nr_pending, Ordering::Relaxed);
+        for _ in old_nr_pending..nr_pending {
+            self.acceptors.resume_one();
+        }
     }
 }
 
@@ -111,7 +132,9 @@ impl BacklogSocket {
             "the socket is not bound",
         ))?;
 
-        let unbound_socket = Box::new(AnyUnboundSocket::new_tcp(Weak::<()>::new()));
+        // The iface only notifies the sockets whose states change, so the listening socket
+        // should observe the backlog sockets to know the incoming connections.
+        let unbound_socket = Box::new(AnyUnboundSocket::new_tcp(bound_socket.observer()));
         let bound_socket = {
             let iface = bound_socket.iface();
             let bind_port_config = BindPortConfig::new(local_endpoint.port, true)?;
@@ -14,7 +14,10 @@ use util::{TcpOptionSet, DEFAULT_MAXSEG};
 use super::UNSPECIFIED_LOCAL_ENDPOINT;
 use crate::{
     events::{IoEvents, Observer},
-    fs::{file_handle::FileLike, utils::StatusFlags},
+    fs::{
+        file_handle::FileLike,
+        utils::{FrameSlice, SpliceFlags, StatusFlags},
+    },
     match_sock_option_mut, match_sock_option_ref,
     net::{
         poll_ifaces,
@@ -245,7 +248,12 @@ impl StreamSocket {
         });
 
         drop(state);
-        poll_ifaces();
+        // The accepted connection has been established, so the iface only needs to be polled
+        // if there is no pending connection. This lets a burst of `accept` calls drain the
+        // backlog without polling the iface every time.
+        if accepted.is_err() {
+            poll_ifaces();
+        }
 
         accepted
     }
@@ -285,6 +293,20 @@ impl StreamSocket {
     }
 
     fn try_send(&self, buf: &[u8], flags: SendRecvFlags) -> Result<usize> {
+        self.try_send_with(false, |connected_stream| {
+            connected_stream.try_send(buf, flags)
+        })
+    }
+
+    /// Sends data with `send` if the socket is connected.
+    ///
+    /// If `has_more` is true, i.e., a splice knows that more data follows, the data is
+    /// left to the background polling thread instead of being transmitted right away,
+    /// so that the following data can be sent with it.
+    fn try_send_with<F>(&self, has_more: bool, send: F) -> Result<usize>
+    where
+        F: FnOnce(&ConnectedStream) -> Result<usize>,
+    {
         let state = self.state.read();
 
         let connected_stream = match state.as_ref() {
@@ -300,11 +322,16 @@ impl StreamSocket {
             }
         };
 
-        let sent_bytes = connected_stream.try_send(buf, flags).map(|sent_bytes| {
+        let sent_bytes = send(connected_stream).map(|sent_bytes| {
             connected_stream.update_io_events(&self.pollee);
             sent_bytes
         });
 
+        if has_more && sent_bytes.is_ok() {
+            connected_stream.iface().request_poll();
+            return sent_bytes;
+        }
+
         drop(state);
         poll_ifaces();
 
@@ -372,6 +399,25 @@ impl FileLike for StreamSocket {
         self.send(buf, flags)
     }
 
+    fn write_frames(&self, frames: &[FrameSlice], splice_flags: SpliceFlags) -> Result<usize> {
+        let mut flags = SendRecvFlags::empty();
+        if splice_flags.contains(SpliceFlags::SPLICE_F_NONBLOCK) {
+            flags |= SendRecvFlags::MSG_DONTWAIT;
+        }
+        let has_more = splice_flags.contains(SpliceFlags::SPLICE_F_MORE);
+
+        let try_send_frames = || {
+            self.try_send_with(has_more, |connected_stream| {
+                connected_stream.try_send_frames(frames, flags)
+            })
+        };
+        if self.is_nonblocking() || flags.contains(SendRecvFlags::MSG_DONTWAIT) {
+            try_send_frames()
+        } else {
+            self.wait_events(IoEvents::OUT, try_send_frames)
+        }
+    }
+
     fn poll(&self, mask: IoEvents, poller: Option<&Poller>) -> IoEvents {
         self.pollee.poll(mask, poller)
     }
@@ -417,6 +463,7 @@ impl FileLike for StreamSocket {
 impl Socket for StreamSocket {
     fn bind(&self, socket_addr: SocketAddr) -> Result<()> {
         let endpoint = socket_addr.try_into()?;
+        let reuse_port = self.options.read().socket.reuse_port();
 
         let mut state = self.state.write();
 
@@ -431,7 +478,7 @@ impl Socket for StreamSocket {
                 );
             };
 
-            let bound_socket = match init_stream.bind(&endpoint) {
+            let bound_socket = match init_stream.bind(&endpoint, reuse_port) {
                 Ok(bound_socket) => bound_socket,
                 Err((err, init_stream)) => {
                     return (State::Init(init_stream), Err(err));
@@ -486,10 +533,28 @@ impl Socket for StreamSocket {
 
     fn accept(&self) -> Result<(Arc<dyn FileLike>, SocketAddr)> {
         if self.is_nonblocking() {
-            self.try_accept()
-        } else {
-            self.wait_events(IoEvents::IN, || self.try_accept())
+            return self.try_accept();
+        }
+
+        let acceptors = {
+            let state = self.state.read();
+            let State::Listen(listen_stream) = state.as_ref() else {
+                return_errno_with_message!(Errno::EINVAL, "the socket is not listening");
+            };
+            listen_stream.acceptors().clone()
+        };
+        // Unlike the pollers, the blocking acceptors are woken one by one for each incoming
+        // connection, so that they do not race for the same connection.
+        let accepted = acceptors.pause_until(|| match self.try_accept() {
+            Err(err) if err.error() == Errno::EAGAIN => None,
+            result => Some(result),
+        });
+        if accepted.is_err() {
+            // The acceptor may have been woken for a pending connection and then interrupted
+            // by a signal before accepting it, so the wakeup is passed on to another acceptor.
+            acceptors.resume_one();
         }
+        accepted?
     }
 
     fn shutdown(&self, cmd: SockShutdownCmd) -> Result<()> {
@@ -3,6 +3,7 @@
 use super::endpoint::Endpoint;
 use crate::{
     events::IoEvents,
+    fs::file_handle::FileLike,
     net::socket::{unix::addr::UnixSocketAddrBound, SockShutdownCmd},
     prelude::*,
     process::signal::Poller,
@@ -25,11 +26,11 @@ impl Connected {
         self.local_endpoint.peer_addr()
     }
 
-    pub(super) fn write(&self, buf: &[u8]) -> Result<usize> {
-        self.local_endpoint.write(buf)
+    pub(super) fn write(&self, buf: &[u8], files: Option<Vec<Arc<dyn FileLike>>>) -> Result<usize> {
+        self.local_endpoint.write(buf, files)
     }
 
-    pub(super) fn read(&self, buf: &mut [u8]) -> Result<usize> {
+    pub(super) fn read(&self, buf: &mut [u8]) -> Result<(usize, Option<Vec<Arc<dyn FileLike>>>)> {
         self.local_endpoint.read(buf)
     }
 
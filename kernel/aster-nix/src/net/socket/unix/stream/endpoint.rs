@@ -2,18 +2,39 @@
 
 use crate::{
     events::IoEvents,
-    fs::utils::{Channel, Consumer, Producer, StatusFlags},
+    fs::{
+        file_handle::FileLike,
+        utils::{Channel, Consumer, Producer, StatusFlags},
+    },
     net::socket::{unix::addr::UnixSocketAddrBound, SockShutdownCmd},
     prelude::*,
     process::signal::Poller,
 };
 
+/// One end of a connected UNIX stream socket.
+///
+/// Each direction is a byte ring of [`DEFAULT_BUF_SIZE`] bytes. The data is copied
+/// into the ring by the writer and out of the ring by the reader, so a transfer costs
+/// two copies of each byte.
+///
+/// A ring of frame slices, like the one of pipes, would let `splice` move references
+/// to page frames into the socket without copying them. But `send` and `recv` would
+/// still copy the data, as `write` and `read` of pipes do, and the socket does not
+/// implement [`FileLike::write_frames`] yet.
 pub(super) struct Endpoint(Inner);
 
 struct Inner {
     addr: RwLock<Option<UnixSocketAddrBound>>,
     reader: Consumer<u8>,
     writer: Producer<u8>,
+    /// The files passed to this end.
+    recv_files: Arc<PassedFiles>,
+    /// The files passed to the peer end.
+    send_files: Arc<PassedFiles>,
+    /// The number of bytes that have been read, which also serializes the readers.
+    nr_read: Mutex<usize>,
+    /// The number of bytes that have been written, which also serializes the writers.
+    nr_written: Mutex<usize>,
     peer: Weak<Endpoint>,
 }
 
@@ -25,24 +46,42 @@ impl Endpoint {
             StatusFlags::empty()
         };
         let (writer_a, reader_b) =
-            Channel::with_capacity_and_flags(DAFAULT_BUF_SIZE, flags)?.split();
+            Channel::with_capacity_and_flags(DEFAULT_BUF_SIZE, flags)?.split();
         let (writer_b, reader_a) =
-            Channel::with_capacity_and_flags(DAFAULT_BUF_SIZE, flags)?.split();
+            Channel::with_capacity_and_flags(DEFAULT_BUF_SIZE, flags)?.split();
+        let files_a = Arc::new(PassedFiles::new());
+        let files_b = Arc::new(PassedFiles::new());
         let mut endpoint_b = None;
         let endpoint_a = Arc::new_cyclic(|endpoint_a_ref| {
-            let peer = Arc::new(Endpoint::new(reader_b, writer_b, endpoint_a_ref.clone()));
-            let endpoint_a = Endpoint::new(reader_a, writer_a, Arc::downgrade(&peer));
+            let peer = Arc::new(Endpoint::new(
+                (reader_b, files_b.clone()),
+                (writer_b, files_a.clone()),
+                endpoint_a_ref.clone(),
+            ));
+            let endpoint_a = Endpoint::new(
+                (reader_a, files_a),
+                (writer_a, files_b),
+                Arc::downgrade(&peer),
+            );
             endpoint_b = Some(peer);
             endpoint_a
         });
         Ok((endpoint_a, endpoint_b.unwrap()))
     }
 
-    fn new(reader: Consumer<u8>, writer: Producer<u8>, peer: Weak<Endpoint>) -> Self {
+    fn new(
+        (reader, recv_files): (Consumer<u8>, Arc<PassedFiles>),
+        (writer, send_files): (Producer<u8>, Arc<PassedFiles>),
+        peer: Weak<Endpoint>,
+    ) -> Self {
         Self(Inner {
             addr: RwLock::new(None),
             reader,
             writer,
+            recv_files,
+            send_files,
+            nr_read: Mutex::new(0),
+            nr_written: Mutex::new(0),
             peer,
         })
     }
@@ -78,12 +117,52 @@ impl Endpoint {
         Ok(())
     }
 
-    pub(super) fn read(&self, buf: &mut [u8]) -> Result<usize> {
-        self.0.reader.read(buf)
+    /// Reads data from the peer, along with the files passed with the data.
+    ///
+    /// The reading stops before the data that has files passed with it,
+    /// so that the files are received with the first byte of their data.
+    pub(super) fn read(&self, buf: &mut [u8]) -> Result<(usize, Option<Vec<Arc<dyn FileLike>>>)> {
+        let mut nr_read = self.0.nr_read.lock();
+
+        // The limit is decided once the data is available, since more data and files may
+        // arrive while the reader waits. The files are pushed before their data, so the
+        // files of the available data are all visible here.
+        let read_len = self.0.reader.read_with_limit(buf, |avail_len| {
+            match self.0.recv_files.next_offset_after(*nr_read) {
+                Some(offset) => avail_len.min(offset - *nr_read),
+                None => avail_len,
+            }
+        })?;
+        *nr_read += read_len;
+
+        Ok((read_len, self.0.recv_files.pop_before(*nr_read)))
     }
 
-    pub(super) fn write(&self, buf: &[u8]) -> Result<usize> {
-        self.0.writer.write(buf)
+    /// Writes data to the peer, passing the files with the data.
+    ///
+    /// The files are not passed if no data is written.
+    pub(super) fn write(&self, buf: &[u8], files: Option<Vec<Arc<dyn FileLike>>>) -> Result<usize> {
+        let mut nr_written = self.0.nr_written.lock();
+
+        // The files must be visible no later than their data.
+        let files = files.filter(|_| !buf.is_empty());
+        let has_files = files.is_some();
+        if let Some(files) = files {
+            self.0.send_files.push(*nr_written, files);
+        }
+
+        match self.0.writer.write(buf) {
+            Ok(written_len) => {
+                *nr_written += written_len;
+                Ok(written_len)
+            }
+            Err(err) => {
+                if has_files {
+                    self.0.send_files.pop_last();
+                }
+                Err(err)
+            }
+        }
     }
 
     pub(super) fn shutdown(&self, cmd: SockShutdownCmd) -> Result<()> {
@@ -124,4 +203,51 @@ impl Endpoint {
     }
 }
 
-const DAFAULT_BUF_SIZE: usize = 4096;
+/// The files passed with `SCM_RIGHTS` in one direction.
+///
+/// Each batch of files is tagged with the offset in the stream where the data
+/// sent with the files starts.
+struct PassedFiles(SpinLock<VecDeque<(usize, Vec<Arc<dyn FileLike>>)>>);
+
+impl PassedFiles {
+    fn new() -> Self {
+        Self(SpinLock::new(VecDeque::new()))
+    }
+
+    fn push(&self, offset: usize, files: Vec<Arc<dyn FileLike>>) {
+        self.0.lock().push_back((offset, files));
+    }
+
+    fn pop_last(&self) {
+        self.0.lock().pop_back();
+    }
+
+    /// Returns the offset of the first batch of files that starts after `offset`.
+    fn next_offset_after(&self, offset: usize) -> Option<usize> {
+        self.0
+            .lock()
+            .iter()
+            .map(|(start, _)| *start)
+            .find(|start| *start > offset)
+    }
+
+    /// Takes all the files that start before `offset`.
+    fn pop_before(&self, offset: usize) -> Option<Vec<Arc<dyn FileLike>>> {
+        let mut batches = self.0.lock();
+        let mut files: Option<Vec<_>> = None;
+        while let Some((start, _)) = batches.front()
+            && *start < offset
+        {
+            let (_, batch) = batches.pop_front().unwrap();
+            files.get_or_insert_with(Vec::new).extend(batch);
+        }
+        files
+    }
+}
+
+/// The buffer size in each direction.
+///
+/// The buffer consists of whole pages, and is large enough that a bulk transfer
+/// does not have to wait for the peer after every page. The size only reduces the
+/// number of round trips between the peers, not the copies of the data.
+const DEFAULT_BUF_SIZE: usize = 16 * PAGE_SIZE;
@@ -18,7 +18,7 @@ use crate::{
         unix::{addr::UnixSocketAddrBound, UnixSocketAddr},
         util::{
             copy_message_from_user, copy_message_to_user, create_message_buffer,
-            send_recv_flags::SendRecvFlags, socket_addr::SocketAddr, MessageHeader,
+            send_recv_flags::SendRecvFlags, socket_addr::SocketAddr, ControlMessage, MessageHeader,
         },
         SockShutdownCmd, Socket,
     },
@@ -84,16 +84,28 @@ impl UnixStreamSocket {
         status_flags.intersection(SUPPORTED_FLAGS)
     }
 
-    fn send(&self, buf: &[u8], _flags: SendRecvFlags) -> Result<usize> {
+    fn send(
+        &self,
+        buf: &[u8],
+        files: Option<Vec<Arc<dyn FileLike>>>,
+        _flags: SendRecvFlags,
+    ) -> Result<usize> {
         let connected = match &*self.0.read() {
             State::Connected(connected) => connected.clone(),
             _ => return_errno_with_message!(Errno::ENOTCONN, "the socket is not connected"),
         };
 
-        connected.write(buf)
+        connected.write(buf, files)
     }
 
-    fn recv(&self, buf: &mut [u8], _flags: SendRecvFlags) -> Result<usize> {
+    /// Receives data, along with the files passed with the data.
+    ///
+    /// The passed files are closed if they are not taken by the caller.
+    fn recv(
+        &self,
+        buf: &mut [u8],
+        _flags: SendRecvFlags,
+    ) -> Result<(usize, Option<Vec<Arc<dyn FileLike>>>)> {
         let connected = match &*self.0.read() {
             State::Connected(connected) => connected.clone(),
             _ => return_errno_with_message!(Errno::ENOTCONN, "the socket is not connected"),
@@ -111,13 +123,13 @@ impl FileLike for UnixStreamSocket {
     fn read(&self, buf: &mut [u8]) -> Result<usize> {
         // TODO: Set correct flags
         let flags = SendRecvFlags::empty();
-        self.recv(buf, flags)
+        self.recv(buf, flags).map(|(read_len, _)| read_len)
     }
 
     fn write(&self, buf: &[u8]) -> Result<usize> {
         // TODO: Set correct flags
         let flags = SendRecvFlags::empty();
-        self.send(buf, flags)
+        self.send(buf, None, flags)
     }
 
     fn poll(&self, mask: IoEvents, poller: Option<&Poller>) -> IoEvents {
@@ -282,14 +294,11 @@ impl Socket for UnixStreamSocket {
             control_message, ..
         } = message_header;
 
-        if control_message.is_some() {
-            // TODO: Support sending control message
-            warn!("sending control message is not supported");
-        }
+        let files = control_message.map(|ControlMessage::Rights(files)| files);
 
         let buf = copy_message_from_user(io_vecs);
 
-        self.send(&buf, flags)
+        self.send(&buf, files, flags)
     }
 
     fn recvmsg(&self, io_vecs: &[IoVec], flags: SendRecvFlags) -> Result<(usize, MessageHeader)> {
@@ -297,16 +306,14 @@ impl Socket for UnixStreamSocket {
         debug_assert!(flags.is_all_supported());
 
         let mut buf = create_message_buffer(io_vecs);
-        let received_bytes = self.recv(&mut buf, flags)?;
+        let (received_bytes, files) = self.recv(&mut buf, flags)?;
 
         let copied_bytes = {
             let message = &buf[..received_bytes];
             copy_message_to_user(io_vecs, message)
         };
 
-        // TODO: Receive control message
-
-        let message_header = MessageHeader::new(None, None);
+        let message_header = MessageHeader::new(None, files.map(ControlMessage::Rights));
 
         Ok((copied_bytes, message_header))
     }
@@ -1,7 +1,9 @@
 // SPDX-License-Identifier: MPL-2.0
 
+use core::fmt::Debug;
+
 use super::socket_addr::SocketAddr;
-use crate::{prelude::*, util::IoVec};
+use crate::{fs::file_handle::FileLike, prelude::*, util::IoVec};
 
 /// Message header used for sendmsg/recvmsg.
 #[derive(Debug)]
@@ -23,13 +25,29 @@ impl MessageHeader {
     pub fn addr(&self) -> Option<&SocketAddr> {
         self.addr.as_ref()
     }
+
+    /// Returns the control message.
+    pub fn into_control_message(self) -> Option<ControlMessage> {
+        self.control_message
+    }
 }
 
 /// Control message carried by MessageHeader.
-///
-/// TODO: Implement the struct. The struct is empty now.
-#[derive(Debug)]
-pub struct ControlMessage;
+pub enum ControlMessage {
+    /// The files passed with `SCM_RIGHTS`.
+    Rights(Vec<Arc<dyn FileLike>>),
+}
+
+impl Debug for ControlMessage {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        match self {
+            Self::Rights(files) => f
+                .debug_struct("Rights")
+                .field("nr_files", &files.len())
+                .finish(),
+        }
+    }
+}
 
 /// Copies a message from user space.
 ///
@@ -6,7 +6,7 @@ pub mod send_recv_flags;
 pub mod shutdown_cmd;
 pub mod socket_addr;
 
-pub use message_header::MessageHeader;
 pub(in crate::net) use message_header::{
     copy_message_from_user, copy_message_to_user, create_message_buffer,
 };
+pub use message_header::{ControlMessage, MessageHeader};
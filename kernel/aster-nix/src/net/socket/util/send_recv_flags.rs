@@ -32,12 +32,16 @@ bitflags! {
         // const MSG_EOF         MSG_FIN
         const MSG_NO_SHARED_FRAGS = 0x80000; /* sendpage() internal : page frags are not shared */
         const MSG_SENDPAGE_DECRYPTED	= 0x100000; /* sendpage() internal : page may carry plain text and require encryption */
+        const MSG_ZEROCOPY	= 0x4000000;	/* Use user data in kernel path */
+        const MSG_CMSG_CLOEXEC = 0x40000000;	/* Set close_on_exec for file descriptor received through SCM_RIGHTS */
     }
 }
 
 impl SendRecvFlags {
     fn supported_flags() -> Self {
-        SendRecvFlags::empty()
+        // `MSG_ZEROCOPY` is ignored unless `SO_ZEROCOPY` is set, which is not supported.
+        // So the data is always copied, and no completion notifications are queued.
+        SendRecvFlags::MSG_ZEROCOPY | SendRecvFlags::MSG_CMSG_CLOEXEC
     }
 
     pub fn is_all_supported(&self) -> bool {
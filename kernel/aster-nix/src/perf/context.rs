@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: MPL-2.0
+
+use core::sync::atomic::{AtomicUsize, Ordering};
+
+use super::PerfEvent;
+use crate::prelude::*;
+
+/// The performance events that are attached to a thread.
+///
+/// The events are scheduled in and out with the thread on context switches.
+pub struct PerfEventContext {
+    events: SpinLock<Vec<Arc<PerfEvent>>>,
+    // The number of events, which lets the context switches skip the lock
+    // for the threads without events.
+    nr_events: AtomicUsize,
+}
+
+impl PerfEventContext {
+    pub const fn new() -> Self {
+        Self {
+            events: SpinLock::new(Vec::new()),
+            nr_events: AtomicUsize::new(0),
+        }
+    }
+
+    /// Attaches an event to the thread.
+    pub fn attach(&self, event: Arc<PerfEvent>) {
+        let mut events = self.events.lock_irq_disabled();
+        events.push(event);
+        self.nr_events.store(events.len(), Ordering::Relaxed);
+    }
+
+    /// Detaches an event from the thread.
+    pub fn detach(&self, event: &Arc<PerfEvent>) {
+        let mut events = self.events.lock_irq_disabled();
+        events.retain(|attached| !Arc::ptr_eq(attached, event));
+        self.nr_events.store(events.len(), Ordering::Relaxed);
+    }
+
+    /// Schedules in the events on the current CPU, as the thread is switched in.
+    pub fn sched_in(&self) {
+        if self.nr_events.load(Ordering::Relaxed) == 0 {
+            return;
+        }
+        for event in self.events.lock_irq_disabled().iter() {
+            event.sched_in();
+        }
+    }
+
+    /// Schedules out the events, as the thread is switched out.
+    pub fn sched_out(&self) {
+        if self.nr_events.load(Ordering::Relaxed) == 0 {
+            return;
+        }
+        for event in self.events.lock_irq_disabled().iter() {
+            event.sched_out();
+        }
+    }
+
+    /// Enables the events that wait for the thread to execute a new program.
+    pub fn enable_on_exec(&self) {
+        if self.nr_events.load(Ordering::Relaxed) == 0 {
+            return;
+        }
+        for event in self.events.lock_irq_disabled().iter() {
+            event.enable_on_exec();
+        }
+    }
+}
+
+impl Default for PerfEventContext {
+    fn default() -> Self {
+        Self::new()
+    }
+}
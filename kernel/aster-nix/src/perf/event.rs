@@ -0,0 +1,881 @@
+// SPDX-License-Identifier: MPL-2.0
+
+use core::{
+    cell::RefCell,
+    sync::atomic::{AtomicU64, AtomicUsize, Ordering},
+};
+
+use aster_rights::Rights;
+use ostd::{
+    arch::pmu::{self, Counter, CounterConfig},
+    cpu::this_cpu,
+    cpu_local,
+    task::current_task,
+    trap::TrapFrame,
+    CpuLocal,
+};
+
+use super::{
+    hw_event_of,
+    ring_buffer::{RecordWriter, RingBuffer},
+    PerfEventAttr, PerfEventAttrFlags, PerfReadFormat, PerfSampleType, PERF_ATTR_SIZE_VER0,
+    PERF_MAX_SAMPLE_RATE, PERF_MAX_STACK, PERF_TYPE_HARDWARE,
+};
+use crate::{
+    events::{IoEvents, Observer},
+    fs::{
+        file_handle::FileLike,
+        utils::{InodeMode, InodeType, IoctlCmd, Metadata},
+    },
+    prelude::*,
+    process::{
+        posix_thread::PosixThreadExt,
+        signal::{Pollee, Poller},
+        Gid, Uid,
+    },
+    sched::sched_clock,
+    thread::{
+        work_queue::{submit_work_item, work_item::WorkItem, WorkPriority},
+        Thread,
+    },
+    time::clocks::RealTimeClock,
+    util::{read_val_from_user, write_val_to_user},
+    vm::vmo::{Vmo, VmoChildOptions, VmoRightsOp},
+};
+
+/// The maximum number of events that a counter is programmed to count before it
+/// overflows, which is limited by the 32-bit writes to the counters.
+const MAX_PERIOD: u64 = i32::MAX as u64;
+
+const PERF_RECORD_LOST: u32 = 2;
+const PERF_RECORD_SAMPLE: u32 = 9;
+
+const PERF_RECORD_MISC_KERNEL: u16 = 1;
+const PERF_RECORD_MISC_USER: u16 = 2;
+
+// The markers in a call chain that tell whether the following entries are in
+// the kernel or in the user space.
+const PERF_CONTEXT_KERNEL: u64 = -128i64 as u64;
+const PERF_CONTEXT_USER: u64 = -512i64 as u64;
+
+static NEXT_EVENT_ID: AtomicU64 = AtomicU64::new(1);
+
+/// The target of a performance event.
+pub enum PerfTarget {
+    /// The event counts while the thread is running, optionally only on the given CPU.
+    Thread {
+        thread: Weak<Thread>,
+        cpu: Option<u32>,
+    },
+    /// The event counts whatever is running on the CPU.
+    Cpu(u32),
+}
+
+/// A performance event.
+pub struct PerfEvent {
+    id: u64,
+    attr: PerfEventAttr,
+    flags: PerfEventAttrFlags,
+    sample_type: PerfSampleType,
+    read_format: PerfReadFormat,
+    counter_config: CounterConfig,
+    target: PerfTarget,
+    state: SpinLock<EventState>,
+    // The event file is readable when there are records in the ring buffer.
+    pollee: Pollee,
+    // Notifies the pollers out of the interrupt context, where the pollee cannot be used.
+    wakeup: Arc<WorkItem>,
+}
+
+struct EventState {
+    enabled: bool,
+    enable_on_exec: bool,
+    // The time when the event is scheduled in, or `None` if the event is scheduled out.
+    active_since: Option<u64>,
+    // The CPU that the event is scheduled in, which is valid if `active_since` is `Some`.
+    active_cpu: u32,
+    // The counter, or `None` if the event is scheduled out or fails to get a counter.
+    counter: Option<RunningCounter>,
+    count: u64,
+    time_enabled: u64,
+    time_running: u64,
+    // The sample period, which is zero if the event does not sample.
+    period: u64,
+    // The sample frequency, which is zero if the period is fixed.
+    freq: u64,
+    // The number of events left before the next sample.
+    left: u64,
+    last_sample_time: u64,
+    samples_before_wakeup: u32,
+    nr_lost: u64,
+    ring_buffer: Option<RingBuffer>,
+}
+
+struct RunningCounter {
+    counter: Counter,
+    // The value of the counter when it is last accounted.
+    last_value: u64,
+    // The time when the counter is last accounted.
+    last_time: u64,
+}
+
+impl RunningCounter {
+    /// Returns the number of events since the counter is last accounted.
+    fn elapsed(&self) -> u64 {
+        self.counter.read().wrapping_sub(self.last_value) & counter_mask()
+    }
+}
+
+fn counter_mask() -> u64 {
+    (1 << pmu::counter_width()) - 1
+}
+
+impl EventState {
+    /// Accounts the events that have been counted.
+    ///
+    /// Returns whether a sample is due.
+    fn account(&mut self, elapsed: u64) -> bool {
+        self.count += elapsed;
+        if self.period == 0 {
+            return false;
+        }
+        if elapsed >= self.left {
+            self.left = self.period;
+            return true;
+        }
+        self.left -= elapsed;
+        false
+    }
+
+    /// Accounts the events and the time up to `now`.
+    ///
+    /// The counter can only be read on the CPU that the event is scheduled in. On
+    /// other CPUs, only the enabled time is accounted, and the events are accounted
+    /// the next time the event is synchronized on that CPU.
+    ///
+    /// Returns whether a sample is due.
+    fn sync(&mut self, now: u64) -> bool {
+        if let Some(since) = self.active_since.as_mut() {
+            self.time_enabled += now - *since;
+            *since = now;
+        }
+
+        if self.active_cpu != this_cpu() {
+            return false;
+        }
+        let Some(running) = self.counter.as_mut() else {
+            return false;
+        };
+        let elapsed = running.elapsed();
+        running.last_value = (running.last_value + elapsed) & counter_mask();
+        self.time_running += now - running.last_time;
+        running.last_time = now;
+        self.account(elapsed)
+    }
+
+    /// Returns the value that makes the counter overflow at the next sample.
+    fn counter_start_value(&self) -> i32 {
+        if self.period == 0 {
+            0
+        } else {
+            -(self.left.min(MAX_PERIOD) as i32)
+        }
+    }
+}
+
+impl PerfEvent {
+    /// Creates a new performance event with the attributes.
+    ///
+    /// The event is not attached to its target. See [`PerfEventContext::attach`] for
+    /// the events of threads, and [`PerfEvent::enable`] for the events of CPUs.
+    ///
+    /// [`PerfEventContext::attach`]: super::PerfEventContext::attach
+    pub fn new(attr: &PerfEventAttr, target: PerfTarget) -> Result<Arc<Self>> {
+        if attr.size != 0 && attr.size < PERF_ATTR_SIZE_VER0 {
+            return_errno_with_message!(Errno::E2BIG, "the attributes are too small");
+        }
+        if attr.type_ != PERF_TYPE_HARDWARE {
+            return_errno_with_message!(Errno::ENOENT, "only the hardware events are supported");
+        }
+        let Some(hw_event) = hw_event_of(attr.config) else {
+            return_errno_with_message!(Errno::ENOENT, "unknown hardware event");
+        };
+        if !hw_event.is_supported() {
+            return_errno_with_message!(Errno::ENOENT, "the hardware event is not supported");
+        }
+
+        let flags = PerfEventAttrFlags::from_bits(attr.flags)
+            .ok_or_else(|| Error::with_message(Errno::EINVAL, "unknown attribute flags"))?;
+        if !PerfEventAttrFlags::SUPPORTED.contains(flags) {
+            return_errno_with_message!(Errno::EOPNOTSUPP, "unsupported attribute flags");
+        }
+        let sample_type = PerfSampleType::from_bits(attr.sample_type)
+            .filter(|sample_type| PerfSampleType::SUPPORTED.contains(*sample_type))
+            .ok_or_else(|| Error::with_message(Errno::EINVAL, "unsupported sample type"))?;
+        let read_format = PerfReadFormat::from_bits(attr.read_format)
+            .filter(|read_format| PerfReadFormat::SUPPORTED.contains(*read_format))
+            .ok_or_else(|| Error::with_message(Errno::EINVAL, "unsupported read format"))?;
+
+        let (period, freq) = if flags.contains(PerfEventAttrFlags::FREQ) {
+            let freq = attr.sample_period;
+            if freq == 0 || freq > PERF_MAX_SAMPLE_RATE {
+                return_errno_with_message!(Errno::EINVAL, "invalid sample frequency");
+            }
+            // Start with the period of the CPU cycles, which is adjusted on each sample.
+            let period = (ostd::arch::tsc_freq() / freq).clamp(1, MAX_PERIOD);
+            (period, freq)
+        } else {
+            (attr.sample_period, 0)
+        };
+
+        let counter_config = CounterConfig {
+            event: hw_event,
+            count_user: !flags.contains(PerfEventAttrFlags::EXCLUDE_USER),
+            count_kernel: !flags.contains(PerfEventAttrFlags::EXCLUDE_KERNEL),
+            interrupt_on_overflow: period != 0,
+        };
+        let state = EventState {
+            enabled: false,
+            enable_on_exec: flags.contains(PerfEventAttrFlags::ENABLE_ON_EXEC),
+            active_since: None,
+            active_cpu: 0,
+            counter: None,
+            count: 0,
+            time_enabled: 0,
+            time_running: 0,
+            period,
+            freq,
+            left: period,
+            last_sample_time: 0,
+            samples_before_wakeup: attr.wakeup_events.max(1),
+            nr_lost: 0,
+            ring_buffer: None,
+        };
+
+        Ok(Arc::new_cyclic(|weak_self: &Weak<PerfEvent>| {
+            let weak_self = weak_self.clone();
+            let wakeup = Arc::new(WorkItem::new(Box::new(move || {
+                if let Some(event) = weak_self.upgrade() {
+                    event.pollee.add_events(IoEvents::IN);
+                }
+            })));
+            Self {
+                id: NEXT_EVENT_ID.fetch_add(1, Ordering::Relaxed),
+                attr: *attr,
+                flags,
+                sample_type,
+                read_format,
+                counter_config,
+                target,
+                state: SpinLock::new(state),
+                pollee: Pollee::new(IoEvents::empty()),
+                wakeup,
+            }
+        }))
+    }
+
+    /// Returns the unique ID of the event.
+    pub fn id(&self) -> u64 {
+        self.id
+    }
+
+    /// Returns the target of the event.
+    pub fn target(&self) -> &PerfTarget {
+        &self.target
+    }
+
+    /// Returns whether the event is initially enabled.
+    pub fn is_initially_enabled(&self) -> bool {
+        !self.flags.contains(PerfEventAttrFlags::DISABLED)
+    }
+
+    /// Enables the event.
+    ///
+    /// The event is scheduled in right away if its target is running on the current
+    /// CPU. An event of another CPU is scheduled in the next time that CPU switches
+    /// tasks, and an event of a thread the next time the thread is switched in.
+    pub fn enable(self: &Arc<Self>) {
+        self.state.lock_irq_disabled().enabled = true;
+        if self.is_target_running() {
+            self.sched_in();
+        } else if let PerfTarget::Cpu(cpu) = self.target {
+            defer_to_cpu(cpu, self.clone());
+        }
+    }
+
+    /// Disables the event.
+    ///
+    /// If the event is scheduled in on another CPU, it is scheduled out the next
+    /// time that CPU switches tasks.
+    pub fn disable(self: &Arc<Self>) {
+        let mut state = self.state.lock_irq_disabled();
+        state.enabled = false;
+        if state.active_since.is_some() && state.active_cpu != this_cpu() {
+            let cpu = state.active_cpu;
+            drop(state);
+            defer_to_cpu(cpu, self.clone());
+            return;
+        }
+        self.do_sched_out(&mut state);
+    }
+
+    /// Schedules the event in or out on the current CPU, as it is enabled or
+    /// disabled on another CPU.
+    fn sync_deferred(self: &Arc<Self>) {
+        let mut state = self.state.lock_irq_disabled();
+        if !state.enabled {
+            if state.active_cpu == this_cpu() {
+                self.do_sched_out(&mut state);
+            }
+            return;
+        }
+        drop(state);
+        if self.is_target_running() {
+            self.sched_in();
+        }
+    }
+
+    /// Enables the event if it waits for the thread to execute a new program.
+    pub(super) fn enable_on_exec(self: &Arc<Self>) {
+        let mut state = self.state.lock_irq_disabled();
+        if !core::mem::take(&mut state.enable_on_exec) || state.enabled {
+            return;
+        }
+        drop(state);
+        self.enable();
+    }
+
+    /// Resets the count of the event to zero.
+    pub fn reset(&self) {
+        let mut state = self.state.lock_irq_disabled();
+        state.sync(sched_clock());
+        state.count = 0;
+    }
+
+    /// Sets the sample period, or the sample frequency if the event samples by frequency.
+    ///
+    /// The new period takes effect after the next sample.
+    pub fn set_period(&self, period: u64) -> Result<()> {
+        let mut state = self.state.lock_irq_disabled();
+        if state.period == 0 {
+            return_errno_with_message!(Errno::EINVAL, "the event does not sample");
+        }
+        if period == 0 {
+            return_errno_with_message!(Errno::EINVAL, "the period is zero");
+        }
+        if state.freq == 0 {
+            state.period = period;
+        } else if period <= PERF_MAX_SAMPLE_RATE {
+            state.freq = period;
+        } else {
+            return_errno_with_message!(Errno::EINVAL, "the sample frequency is too high");
+        }
+        Ok(())
+    }
+
+    /// Returns the count, the enabled time and the running time of the event.
+    pub fn read(&self) -> (u64, u64, u64) {
+        let mut state = self.state.lock_irq_disabled();
+        state.sync(sched_clock());
+        (state.count, state.time_enabled, state.time_running)
+    }
+
+    /// Schedules in the event on the current CPU.
+    pub(super) fn sched_in(self: &Arc<Self>) {
+        let mut state = self.state.lock_irq_disabled();
+        if !state.enabled || state.active_since.is_some() || !self.can_run_on(this_cpu()) {
+            return;
+        }
+
+        let now = sched_clock();
+        state.active_since = Some(now);
+        state.active_cpu = this_cpu();
+
+        let start_value = state.counter_start_value();
+        let Some(counter) = Counter::start(&self.counter_config, start_value) else {
+            // All counters are in use, so the event does not count for now.
+            return;
+        };
+        let index = counter.index();
+        state.counter = Some(RunningCounter {
+            counter,
+            last_value: start_value as i64 as u64 & counter_mask(),
+            last_time: now,
+        });
+        CpuLocal::borrow_with(&ACTIVE_EVENTS, |events| {
+            events.borrow_mut().push((index, self.clone()));
+        });
+    }
+
+    /// Schedules out the event from the current CPU.
+    pub(super) fn sched_out(&self) {
+        let mut state = self.state.lock_irq_disabled();
+        self.do_sched_out(&mut state);
+    }
+
+    fn do_sched_out(&self, state: &mut EventState) {
+        if state.active_since.is_none() {
+            return;
+        }
+        state.sync(sched_clock());
+        state.active_since = None;
+
+        let Some(running) = state.counter.take() else {
+            return;
+        };
+        let index = running.counter.index();
+        CpuLocal::borrow_with(&ACTIVE_EVENTS, |events| {
+            events.borrow_mut().retain(|(i, _)| *i != index);
+        });
+        // Dropping the counter stops it.
+        drop(running);
+    }
+
+    fn can_run_on(&self, cpu: u32) -> bool {
+        match &self.target {
+            PerfTarget::Thread { cpu: target, .. } => target.map_or(true, |target| target == cpu),
+            PerfTarget::Cpu(target) => *target == cpu,
+        }
+    }
+
+    /// Returns whether the target of the event is running on the current CPU.
+    fn is_target_running(&self) -> bool {
+        match &self.target {
+            PerfTarget::Thread { thread, .. } => thread
+                .upgrade()
+                .is_some_and(|thread| Arc::ptr_eq(&thread, &current_thread!())),
+            PerfTarget::Cpu(cpu) => *cpu == this_cpu(),
+        }
+    }
+
+    /// Handles the overflow of the counter, which is in the interrupt context.
+    fn handle_counter_overflow(&self, trap_frame: &TrapFrame) {
+        let mut state = self.state.lock_irq_disabled();
+        let now = sched_clock();
+        let period = state.period;
+        if state.sync(now) {
+            Self::adjust_period(&mut state, now);
+            self.record_sample(&mut state, trap_frame, period, now);
+        }
+
+        let start_value = state.counter_start_value();
+        if let Some(running) = state.counter.as_mut() {
+            running.counter.write(start_value);
+            running.last_value = start_value as i64 as u64 & counter_mask();
+        }
+    }
+
+    /// Adjusts the sample period to meet the sample frequency.
+    fn adjust_period(state: &mut EventState, now: u64) {
+        let last_sample_time = core::mem::replace(&mut state.last_sample_time, now);
+        if state.freq == 0 || last_sample_time == 0 {
+            return;
+        }
+
+        let interval = (now - last_sample_time).max(1) as u128;
+        let target_interval = 1_000_000_000 / state.freq as u128;
+        let new_period = state.period as u128 * target_interval / interval;
+        // Smooth the adjustment, since the interval between two samples varies.
+        let period = ((state.period as u128 + new_period) / 2).clamp(1, MAX_PERIOD as u128);
+        state.period = period as u64;
+        state.left = state.period;
+    }
+
+    fn record_sample(&self, state: &mut EventState, trap_frame: &TrapFrame, period: u64, now: u64) {
+        let Some(ring_buffer) = state.ring_buffer.as_mut() else {
+            return;
+        };
+
+        if state.nr_lost > 0 {
+            let written = ring_buffer.write_record(24, |writer| {
+                writer.write(&RecordHeader::new(PERF_RECORD_LOST, 0, 24));
+                writer.write(&self.id);
+                writer.write(&state.nr_lost);
+            });
+            if written {
+                state.nr_lost = 0;
+            }
+        }
+
+        let is_user = pmu::is_user_frame(trap_frame);
+        let mut callchain = [0usize; PERF_MAX_STACK];
+        let nr_ips = if self.sample_type.contains(PerfSampleType::CALLCHAIN) {
+            self.collect_callchain(trap_frame, is_user, &mut callchain)
+        } else {
+            0
+        };
+        let (pid, tid) = current_pid_tid();
+
+        let sample_type = self.sample_type;
+        let nr_fields = [
+            PerfSampleType::IDENTIFIER,
+            PerfSampleType::IP,
+            PerfSampleType::TID,
+            PerfSampleType::TIME,
+            PerfSampleType::ID,
+            PerfSampleType::STREAM_ID,
+            PerfSampleType::CPU,
+            PerfSampleType::PERIOD,
+        ]
+        .into_iter()
+        .filter(|field| sample_type.contains(*field))
+        .count();
+        let mut size = size_of::<RecordHeader>() + nr_fields * size_of::<u64>();
+        if sample_type.contains(PerfSampleType::CALLCHAIN) {
+            size += (1 + nr_ips) * size_of::<u64>();
+        }
+
+        let misc = if is_user {
+            PERF_RECORD_MISC_USER
+        } else {
+            PERF_RECORD_MISC_KERNEL
+        };
+        // The fields are written in the order defined by Linux.
+        let written = ring_buffer.write_record(size, |writer: &mut RecordWriter<'_>| {
+            writer.write(&RecordHeader::new(PERF_RECORD_SAMPLE, misc, size as u16));
+            if sample_type.contains(PerfSampleType::IDENTIFIER) {
+                writer.write(&self.id);
+            }
+            if sample_type.contains(PerfSampleType::IP) {
+                writer.write(&(trap_frame.rip as u64));
+            }
+            if sample_type.contains(PerfSampleType::TID) {
+                writer.write(&[pid, tid]);
+            }
+            if sample_type.contains(PerfSampleType::TIME) {
+                writer.write(&now);
+            }
+            if sample_type.contains(PerfSampleType::ID) {
+                writer.write(&self.id);
+            }
+            if sample_type.contains(PerfSampleType::STREAM_ID) {
+                writer.write(&self.id);
+            }
+            if sample_type.contains(PerfSampleType::CPU) {
+                writer.write(&[this_cpu(), 0]);
+            }
+            if sample_type.contains(PerfSampleType::PERIOD) {
+                writer.write(&period);
+            }
+            if sample_type.contains(PerfSampleType::CALLCHAIN) {
+                writer.write(&(nr_ips as u64));
+                for ip in &callchain[..nr_ips] {
+                    writer.write(&(*ip as u64));
+                }
+            }
+        });
+        if !written {
+            state.nr_lost += 1;
+            return;
+        }
+
+        let should_wake_up = if self.flags.contains(PerfEventAttrFlags::WATERMARK) {
+            let watermark = match self.attr.wakeup_events as usize {
+                0 => ring_buffer.data_size() / 2,
+                watermark => watermark,
+            };
+            ring_buffer.len() >= watermark
+        } else {
+            state.samples_before_wakeup -= 1;
+            if state.samples_before_wakeup == 0 {
+                state.samples_before_wakeup = self.attr.wakeup_events.max(1);
+                true
+            } else {
+                false
+            }
+        };
+        if should_wake_up {
+            submit_work_item(self.wakeup.clone(), WorkPriority::High);
+        }
+    }
+
+    /// Collects the call chains of the interrupted code, each of which is preceded
+    /// by a context marker.
+    ///
+    /// A user call chain is only collected if the user code is interrupted, since
+    /// the user context of a thread running in the kernel is not at hand.
+    fn collect_callchain(
+        &self,
+        trap_frame: &TrapFrame,
+        is_user: bool,
+        buf: &mut [usize; PERF_MAX_STACK],
+    ) -> usize {
+        if is_user {
+            if self
+                .flags
+                .contains(PerfEventAttrFlags::EXCLUDE_CALLCHAIN_USER)
+            {
+                return 0;
+            }
+            let Some(task) = current_task() else {
+                return 0;
+            };
+            let Some(user_space) = task.user_space() else {
+                return 0;
+            };
+            buf[0] = PERF_CONTEXT_USER as usize;
+            1 + pmu::user_callchain(trap_frame, user_space.vm_space(), &mut buf[1..])
+        } else {
+            if self
+                .flags
+                .contains(PerfEventAttrFlags::EXCLUDE_CALLCHAIN_KERNEL)
+            {
+                return 0;
+            }
+            buf[0] = PERF_CONTEXT_KERNEL as usize;
+            1 + pmu::kernel_callchain(trap_frame, &mut buf[1..])
+        }
+    }
+
+    /// Returns the VMO of the ring buffer to be mapped into the user space.
+    ///
+    /// The ring buffer is created on the first mapping, whose length decides the
+    /// number of data pages. The later mappings must have the same length. A
+    /// mapping of the metadata page alone has no data pages, so no records are
+    /// written but the user space can still read the metadata.
+    pub fn mmap_vmo(&self, offset: usize, len: usize) -> Result<Vmo<Rights>> {
+        if offset != 0 {
+            return_errno_with_message!(Errno::EINVAL, "the ring buffer must be mapped at offset 0");
+        }
+        if len < PAGE_SIZE {
+            return_errno_with_message!(Errno::EINVAL, "the metadata page is not mapped");
+        }
+        let nr_data_pages = len / PAGE_SIZE - 1;
+        if nr_data_pages != 0 && !nr_data_pages.is_power_of_two() {
+            return_errno_with_message!(
+                Errno::EINVAL,
+                "the number of data pages is not a power of two"
+            );
+        }
+        if self.state.lock_irq_disabled().ring_buffer.is_none() {
+            let ring_buffer = RingBuffer::new(nr_data_pages)?;
+            self.state
+                .lock_irq_disabled()
+                .ring_buffer
+                .get_or_insert(ring_buffer);
+        }
+
+        let vmo = {
+            let state = self.state.lock_irq_disabled();
+            let ring_buffer = state.ring_buffer.as_ref().unwrap();
+            if ring_buffer.data_size() != nr_data_pages * PAGE_SIZE {
+                return_errno_with_message!(Errno::EINVAL, "the ring buffer has another size");
+            }
+            ring_buffer.vmo().dup()
+        };
+        VmoChildOptions::new_slice_rights(vmo.to_dyn(), 0..len).alloc()
+    }
+
+    fn poll(&self, mask: IoEvents, poller: Option<&Poller>) -> IoEvents {
+        let is_empty = self
+            .state
+            .lock_irq_disabled()
+            .ring_buffer
+            .as_ref()
+            .map_or(true, RingBuffer::is_empty);
+        if is_empty {
+            self.pollee.del_events(IoEvents::IN);
+        }
+        self.pollee.poll(mask, poller)
+    }
+}
+
+#[derive(Debug, Clone, Copy, Pod)]
+#[repr(C)]
+struct RecordHeader {
+    type_: u32,
+    misc: u16,
+    size: u16,
+}
+
+impl RecordHeader {
+    fn new(type_: u32, misc: u16, size: u16) -> Self {
+        Self { type_, misc, size }
+    }
+}
+
+/// Returns the process ID and the thread ID of the current thread.
+fn current_pid_tid() -> (u32, u32) {
+    let Some(thread) =
+        current_task().and_then(|task| task.data().downcast_ref::<Weak<Thread>>()?.upgrade())
+    else {
+        return (0, 0);
+    };
+    let pid = thread
+        .as_posix_thread()
+        .and_then(|posix_thread| posix_thread.weak_process().upgrade())
+        .map_or(0, |process| process.pid());
+    (pid, thread.tid())
+}
+
+/// The events that are enabled or disabled on other CPUs than the CPUs they run on,
+/// with the CPUs they run on.
+///
+/// The counters of a CPU can only be programmed on the CPU itself. Without IPIs, the
+/// events are synchronized on their CPUs the next time the CPUs switch tasks.
+static DEFERRED_EVENTS: SpinLock<Vec<(u32, Arc<PerfEvent>)>> = SpinLock::new(Vec::new());
+// The number of deferred events, which lets the context switches skip the lock.
+static NR_DEFERRED_EVENTS: AtomicUsize = AtomicUsize::new(0);
+
+fn defer_to_cpu(cpu: u32, event: Arc<PerfEvent>) {
+    let mut events = DEFERRED_EVENTS.lock_irq_disabled();
+    events.push((cpu, event));
+    NR_DEFERRED_EVENTS.store(events.len(), Ordering::Relaxed);
+}
+
+/// Schedules in or out the events that are enabled or disabled on other CPUs, as
+/// the current CPU switches tasks.
+pub fn sync_deferred_events() {
+    if NR_DEFERRED_EVENTS.load(Ordering::Relaxed) == 0 {
+        return;
+    }
+
+    let cpu = this_cpu();
+    let mut events_of_cpu = Vec::new();
+    {
+        let mut events = DEFERRED_EVENTS.lock_irq_disabled();
+        events.retain(|(event_cpu, event)| {
+            if *event_cpu != cpu {
+                return true;
+            }
+            events_of_cpu.push(event.clone());
+            false
+        });
+        NR_DEFERRED_EVENTS.store(events.len(), Ordering::Relaxed);
+    }
+    for event in events_of_cpu {
+        event.sync_deferred();
+    }
+}
+
+cpu_local! {
+    /// The events that hold the counters of the CPU, with the indexes of the counters.
+    static ACTIVE_EVENTS: RefCell<Vec<(u8, Arc<PerfEvent>)>> = RefCell::new(Vec::new());
+}
+
+pub(super) fn handle_overflow(trap_frame: &TrapFrame, index: u8) {
+    let event = CpuLocal::borrow_with(&ACTIVE_EVENTS, |events| {
+        events
+            .borrow()
+            .iter()
+            .find(|(i, _)| *i == index)
+            .map(|(_, event)| event.clone())
+    });
+    if let Some(event) = event {
+        event.handle_counter_overflow(trap_frame);
+    }
+}
+
+/// A file-like object of a performance event.
+///
+/// The event is detached from its target when the file is dropped.
+pub struct PerfEventFile {
+    event: Arc<PerfEvent>,
+}
+
+impl PerfEventFile {
+    pub fn new(event: Arc<PerfEvent>) -> Self {
+        Self { event }
+    }
+
+    pub fn mmap_vmo(&self, offset: usize, len: usize) -> Result<Vmo<Rights>> {
+        self.event.mmap_vmo(offset, len)
+    }
+}
+
+impl Drop for PerfEventFile {
+    fn drop(&mut self) {
+        self.event.disable();
+        if let PerfTarget::Thread { thread, .. } = &self.event.target {
+            if let Some(thread) = thread.upgrade() {
+                thread.perf_events().detach(&self.event);
+            }
+        }
+    }
+}
+
+impl FileLike for PerfEventFile {
+    fn read(&self, buf: &mut [u8]) -> Result<usize> {
+        let (count, time_enabled, time_running) = self.event.read();
+        let read_format = self.event.read_format;
+
+        let mut values = [0u64; 4];
+        let mut nr_values = 0;
+        let mut push = |value| {
+            values[nr_values] = value;
+            nr_values += 1;
+        };
+        push(count);
+        if read_format.contains(PerfReadFormat::TOTAL_TIME_ENABLED) {
+            push(time_enabled);
+        }
+        if read_format.contains(PerfReadFormat::TOTAL_TIME_RUNNING) {
+            push(time_running);
+        }
+        if read_format.contains(PerfReadFormat::ID) {
+            push(self.event.id);
+        }
+
+        let bytes = &values.as_bytes()[..nr_values * size_of::<u64>()];
+        if buf.len() < bytes.len() {
+            return_errno_with_message!(Errno::ENOSPC, "the buffer is too small");
+        }
+        buf[..bytes.len()].copy_from_slice(bytes);
+        Ok(bytes.len())
+    }
+
+    fn ioctl(&self, cmd: IoctlCmd, arg: usize) -> Result<i32> {
+        match cmd {
+            IoctlCmd::PERF_EVENT_IOC_ENABLE => self.event.enable(),
+            IoctlCmd::PERF_EVENT_IOC_DISABLE => self.event.disable(),
+            IoctlCmd::PERF_EVENT_IOC_RESET => self.event.reset(),
+            IoctlCmd::PERF_EVENT_IOC_PERIOD => {
+                let period: u64 = read_val_from_user(arg)?;
+                self.event.set_period(period)?;
+            }
+            IoctlCmd::PERF_EVENT_IOC_ID => write_val_to_user(arg, &self.event.id)?,
+            _ => return_errno_with_message!(Errno::ENOTTY, "unsupported ioctl command"),
+        }
+        Ok(0)
+    }
+
+    fn poll(&self, mask: IoEvents, poller: Option<&Poller>) -> IoEvents {
+        self.event.poll(mask, poller)
+    }
+
+    fn register_observer(
+        &self,
+        observer: Weak<dyn Observer<IoEvents>>,
+        mask: IoEvents,
+    ) -> Result<()> {
+        self.event.pollee.register_observer(observer, mask);
+        Ok(())
+    }
+
+    fn unregister_observer(
+        &self,
+        observer: &Weak<dyn Observer<IoEvents>>,
+    ) -> Option<Weak<dyn Observer<IoEvents>>> {
+        self.event.pollee.unregister_observer(observer)
+    }
+
+    fn metadata(&self) -> Metadata {
+        let now = RealTimeClock::get().read_time();
+        Metadata {
+            dev: 0,
+            ino: 0,
+            size: 0,
+            blk_size: 0,
+            blocks: 0,
+            atime: now,
+            mtime: now,
+            ctime: now,
+            type_: InodeType::File,
+            mode: InodeMode::from_bits_truncate(0o600),
+            nlinks: 1,
+            uid: Uid::new_root(),
+            gid: Gid::new_root(),
+            rdev: 0,
+        }
+    }
+}
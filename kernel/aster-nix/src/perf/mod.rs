@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: MPL-2.0
+
+//! Performance events, which are created with the `perf_event_open` system call.
+//!
+//! A performance event counts a hardware event (e.g., CPU cycles or cache misses)
+//! with a general-purpose counter of the PMU. An event is either attached to a
+//! thread, in which case it only counts while the thread is running, or attached
+//! to a CPU, in which case it counts whatever runs on the CPU.
+//!
+//! The counters are a scarce resource, so an event only holds a counter while it
+//! is scheduled in, i.e., while it is enabled and its thread is running. An event
+//! that fails to get a counter does not count, which is reflected by the difference
+//! between its enabled time and its running time.
+//!
+//! A sampling event makes its counter overflow after every `sample_period` events.
+//! On each overflow, a sample of the interrupted code, optionally with the kernel
+//! and user call chains, is written into the ring buffer of the event, which the
+//! user space maps with `mmap`.
+
+use ostd::arch::pmu::{self, HwEvent};
+
+use crate::prelude::*;
+
+mod context;
+mod event;
+mod ring_buffer;
+
+pub use self::{
+    context::PerfEventContext,
+    event::{sync_deferred_events, PerfEvent, PerfEventFile, PerfTarget},
+};
+
+/// The size of the first published version of `perf_event_attr`.
+pub const PERF_ATTR_SIZE_VER0: u32 = 64;
+
+/// The maximum sampling frequency.
+pub const PERF_MAX_SAMPLE_RATE: u64 = 100_000;
+
+/// The maximum number of entries in a call chain, including the context markers.
+pub const PERF_MAX_STACK: usize = 127;
+
+/// The attributes of a performance event, which are the leading fields of
+/// `perf_event_attr` that are understood by the kernel.
+///
+/// Reference: <https://man7.org/linux/man-pages/man2/perf_event_open.2.html>.
+#[derive(Debug, Default, Clone, Copy, Pod)]
+#[repr(C)]
+pub struct PerfEventAttr {
+    pub type_: u32,
+    pub size: u32,
+    pub config: u64,
+    /// The sample period, or the sample frequency if `PerfEventAttrFlags::FREQ` is set.
+    pub sample_period: u64,
+    pub sample_type: u64,
+    pub read_format: u64,
+    pub flags: u64,
+    /// The number of samples, or the number of bytes if `PerfEventAttrFlags::WATERMARK`
+    /// is set, before the pollers of the ring buffer are woken up.
+    pub wakeup_events: u32,
+    pub bp_type: u32,
+    pub config1: u64,
+}
+
+/// The type of the generalized hardware events.
+pub const PERF_TYPE_HARDWARE: u32 = 0;
+
+/// Returns the hardware event of a generalized hardware event ID.
+pub fn hw_event_of(config: u64) -> Option<HwEvent> {
+    let event = match config {
+        0 => HwEvent::CpuCycles,
+        1 => HwEvent::Instructions,
+        2 => HwEvent::CacheReferences,
+        3 => HwEvent::CacheMisses,
+        4 => HwEvent::BranchInstructions,
+        5 => HwEvent::BranchMisses,
+        _ => return None,
+    };
+    Some(event)
+}
+
+bitflags! {
+    /// The flags of `perf_event_attr`.
+    pub struct PerfEventAttrFlags: u64 {
+        const DISABLED                  = 1 << 0;
+        const INHERIT                   = 1 << 1;
+        const PINNED                    = 1 << 2;
+        const EXCLUSIVE                 = 1 << 3;
+        const EXCLUDE_USER              = 1 << 4;
+        const EXCLUDE_KERNEL            = 1 << 5;
+        const EXCLUDE_HV                = 1 << 6;
+        const EXCLUDE_IDLE              = 1 << 7;
+        const MMAP                      = 1 << 8;
+        const COMM                      = 1 << 9;
+        const FREQ                      = 1 << 10;
+        const INHERIT_STAT              = 1 << 11;
+        const ENABLE_ON_EXEC            = 1 << 12;
+        const TASK                      = 1 << 13;
+        const WATERMARK                 = 1 << 14;
+        const PRECISE_IP                = 3 << 15;
+        const MMAP_DATA                 = 1 << 17;
+        const SAMPLE_ID_ALL             = 1 << 18;
+        const EXCLUDE_HOST              = 1 << 19;
+        const EXCLUDE_GUEST             = 1 << 20;
+        const EXCLUDE_CALLCHAIN_KERNEL  = 1 << 21;
+        const EXCLUDE_CALLCHAIN_USER    = 1 << 22;
+        const MMAP2                     = 1 << 23;
+        const COMM_EXEC                 = 1 << 24;
+    }
+}
+
+impl PerfEventAttrFlags {
+    /// The flags that are supported.
+    ///
+    /// The flags that request side-band records (e.g., `MMAP` and `COMM`) are
+    /// accepted, but no such records are generated. `INHERIT` is also accepted,
+    /// but the children of the thread are not counted. There is no hypervisor or
+    /// guest, so excluding them has no effect.
+    pub const SUPPORTED: Self = Self::all()
+        .difference(Self::INHERIT_STAT)
+        .difference(Self::PRECISE_IP);
+}
+
+bitflags! {
+    /// The fields that are included in a sample.
+    pub struct PerfSampleType: u64 {
+        const IP            = 1 << 0;
+        const TID           = 1 << 1;
+        const TIME          = 1 << 2;
+        const ADDR          = 1 << 3;
+        const READ          = 1 << 4;
+        const CALLCHAIN     = 1 << 5;
+        const ID            = 1 << 6;
+        const CPU           = 1 << 7;
+        const PERIOD        = 1 << 8;
+        const STREAM_ID     = 1 << 9;
+        const RAW           = 1 << 10;
+        const IDENTIFIER    = 1 << 16;
+    }
+}
+
+impl PerfSampleType {
+    /// The fields that are supported.
+    pub const SUPPORTED: Self = Self::IP
+        .union(Self::TID)
+        .union(Self::TIME)
+        .union(Self::CALLCHAIN)
+        .union(Self::ID)
+        .union(Self::CPU)
+        .union(Self::PERIOD)
+        .union(Self::STREAM_ID)
+        .union(Self::IDENTIFIER);
+}
+
+bitflags! {
+    /// The fields that are returned by reading an event.
+    pub struct PerfReadFormat: u64 {
+        const TOTAL_TIME_ENABLED    = 1 << 0;
+        const TOTAL_TIME_RUNNING    = 1 << 1;
+        const ID                    = 1 << 2;
+        const GROUP                 = 1 << 3;
+        const LOST                  = 1 << 4;
+    }
+}
+
+impl PerfReadFormat {
+    /// The fields that are supported.
+    pub const SUPPORTED: Self = Self::TOTAL_TIME_ENABLED
+        .union(Self::TOTAL_TIME_RUNNING)
+        .union(Self::ID);
+}
+
+bitflags! {
+    /// The flags of `perf_event_open`.
+    pub struct PerfEventOpenFlags: u64 {
+        const FD_NO_GROUP   = 1 << 0;
+        const FD_OUTPUT     = 1 << 1;
+        const PID_CGROUP    = 1 << 2;
+        const FD_CLOEXEC    = 1 << 3;
+    }
+}
+
+pub(super) fn init() {
+    if pmu::nr_counters() == 0 {
+        return;
+    }
+    pmu::set_overflow_handler(event::handle_overflow);
+}
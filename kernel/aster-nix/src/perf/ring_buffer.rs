@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: MPL-2.0
+
+use core::sync::atomic::{fence, Ordering};
+
+use aster_rights::Full;
+use ostd::mm::{Frame, VmIo};
+
+use crate::{
+    prelude::*,
+    vm::vmo::{Vmo, VmoOptions},
+};
+
+// The offsets of the fields in the metadata page, which is `perf_event_mmap_page`.
+const VERSION: usize = 0;
+const CAPABILITIES: usize = 40;
+const PMC_WIDTH: usize = 48;
+const SIZE: usize = 72;
+const DATA_HEAD: usize = 1024;
+const DATA_TAIL: usize = 1032;
+const DATA_OFFSET: usize = 1040;
+const DATA_SIZE: usize = 1048;
+// The size of `perf_event_mmap_page`, including the reserved fields.
+const METADATA_SIZE: u32 = 1088;
+
+// The `cap_bit0_is_deprecated` capability, which tells that the other capability
+// bits are valid. None of `cap_user_rdpmc` and `cap_user_time` is set.
+const CAP_BIT0_IS_DEPRECATED: u64 = 1 << 1;
+
+/// The ring buffer of a performance event, which is shared with the user space.
+///
+/// The ring buffer consists of a metadata page, followed by the data pages that
+/// hold the records. The kernel advances the data head after writing the records,
+/// and the user space advances the data tail after reading them.
+///
+/// The pages are committed when the ring buffer is created, so the records are
+/// written directly into the frames. This allows writing the records in the
+/// interrupt context.
+pub(super) struct RingBuffer {
+    vmo: Vmo<Full>,
+    frames: Vec<Frame>,
+    data_size: usize,
+    head: u64,
+}
+
+impl RingBuffer {
+    /// Creates a ring buffer with the given number of data pages.
+    ///
+    /// The number must be zero or a power of two. A ring buffer without data pages
+    /// only has the metadata page, and all records are lost.
+    pub fn new(nr_data_pages: usize) -> Result<Self> {
+        debug_assert!(nr_data_pages == 0 || nr_data_pages.is_power_of_two());
+
+        let nr_pages = nr_data_pages + 1;
+        let vmo = VmoOptions::<Full>::new(nr_pages * PAGE_SIZE).alloc()?;
+        let frames = vmo.get_committed_frames(0..nr_pages, true)?;
+
+        let data_size = nr_data_pages * PAGE_SIZE;
+        let metadata = &frames[0];
+        metadata.write_val(VERSION, &0u32)?;
+        metadata.write_val(CAPABILITIES, &CAP_BIT0_IS_DEPRECATED)?;
+        metadata.write_val(PMC_WIDTH, &(ostd::arch::pmu::counter_width() as u16))?;
+        metadata.write_val(SIZE, &METADATA_SIZE)?;
+        metadata.write_val(DATA_OFFSET, &(PAGE_SIZE as u64))?;
+        metadata.write_val(DATA_SIZE, &(data_size as u64))?;
+
+        Ok(Self {
+            vmo,
+            frames,
+            data_size,
+            head: 0,
+        })
+    }
+
+    /// Returns the VMO that holds the ring buffer.
+    pub fn vmo(&self) -> &Vmo<Full> {
+        &self.vmo
+    }
+
+    /// Returns the number of bytes written but not yet consumed by the user space.
+    pub fn len(&self) -> usize {
+        (self.head.wrapping_sub(self.tail()) as usize).min(self.data_size)
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    pub fn data_size(&self) -> usize {
+        self.data_size
+    }
+
+    fn tail(&self) -> u64 {
+        let tail = self.frames[0].read_val::<u64>(DATA_TAIL).unwrap();
+        // Overwrite the records only after the user space finishes reading them.
+        fence(Ordering::Acquire);
+        tail
+    }
+
+    /// Writes a record of `size` bytes with `write_fields`, which must write exactly
+    /// `size` bytes with the writer.
+    ///
+    /// Returns `false` if there is no room for the record, in which case nothing is written.
+    pub fn write_record(
+        &mut self,
+        size: usize,
+        write_fields: impl FnOnce(&mut RecordWriter<'_>),
+    ) -> bool {
+        debug_assert_eq!(size % size_of::<u64>(), 0);
+        if self.len() + size > self.data_size {
+            return false;
+        }
+
+        let mut writer = RecordWriter {
+            frames: &self.frames,
+            data_size: self.data_size,
+            pos: self.head,
+        };
+        write_fields(&mut writer);
+        debug_assert_eq!(writer.pos, self.head + size as u64);
+        self.head = writer.pos;
+
+        // Publish the data head after the records are written.
+        fence(Ordering::Release);
+        self.frames[0].write_val(DATA_HEAD, &self.head).unwrap();
+        true
+    }
+}
+
+/// A writer of the fields of a record in the ring buffer.
+pub(super) struct RecordWriter<'a> {
+    frames: &'a [Frame],
+    data_size: usize,
+    pos: u64,
+}
+
+impl RecordWriter<'_> {
+    /// Writes a field, which must be a multiple of 8 bytes.
+    ///
+    /// The records are 8-byte aligned, so a field of 8 bytes never crosses a page
+    /// boundary. Larger fields are written in 8-byte pieces.
+    pub fn write<T: Pod>(&mut self, val: &T) {
+        for chunk in val.as_bytes().chunks(size_of::<u64>()) {
+            debug_assert_eq!(chunk.len(), size_of::<u64>());
+            let offset = self.pos as usize & (self.data_size - 1);
+            let frame = &self.frames[1 + offset / PAGE_SIZE];
+            frame.write_bytes(offset % PAGE_SIZE, chunk).unwrap();
+            self.pos += chunk.len() as u64;
+        }
+    }
+}
@@ -22,7 +22,7 @@ use super::{
 use crate::{
     cpu::LinuxAbi,
     current_thread,
-    fs::{file_table::FileTable, fs_resolver::FsResolver, utils::FileCreationMask},
+    fs::{file_table::SharedFileTable, fs_resolver::FsResolver, utils::FileCreationMask},
     prelude::*,
     thread::{allocate_tid, thread_table, Thread, Tid},
     util::write_val_to_user,
@@ -82,6 +82,20 @@ impl CloneArgs {
         }
     }
 
+    /// Clone Args for syscall vfork.
+    pub const fn for_vfork() -> Self {
+        CloneArgs {
+            new_sp: 0,
+            stack_size: 0,
+            parent_tidptr: 0,
+            child_tidptr: 0,
+            tls: 0,
+            clone_flags: CloneFlags::from_bits_truncate(
+                CloneFlags::CLONE_VM.bits() | CloneFlags::CLONE_VFORK.bits(),
+            ),
+        }
+    }
+
     pub const fn new(
         new_sp: u64,
         stack_size: usize,
@@ -115,6 +129,7 @@ impl CloneFlags {
             | CloneFlags::CLONE_FS
             | CloneFlags::CLONE_FILES
             | CloneFlags::CLONE_SIGHAND
+            | CloneFlags::CLONE_VFORK
             | CloneFlags::CLONE_THREAD
             | CloneFlags::CLONE_SYSVSEM
             | CloneFlags::CLONE_SETTLS
@@ -143,13 +158,30 @@ pub fn clone_child(parent_context: &UserContext, clone_args: CloneArgs) -> Resul
         Ok(child_tid)
     } else {
         let child_process = clone_child_process(parent_context, clone_args)?;
+        let is_vfork = clone_args.clone_flags.contains(CloneFlags::CLONE_VFORK);
+        if is_vfork {
+            child_process.set_vfork_parent_waiting();
+        }
         child_process.run();
+        if is_vfork {
+            wait_vfork_child(&child_process);
+        }
 
         let child_pid = child_process.pid();
         Ok(child_pid)
     }
 }
 
+/// Suspends the current process until the vfork child execs or exits.
+///
+/// Signals interrupt the waiting so that the parent can still be killed.
+fn wait_vfork_child(child_process: &Process) {
+    let current = current!();
+    let _ = current
+        .children_pauser()
+        .pause_until(|| (!child_process.is_vfork_parent_waiting()).then_some(()));
+}
+
 fn clone_child_thread(parent_context: &UserContext, clone_args: CloneArgs) -> Result<Arc<Thread>> {
     let clone_flags = clone_args.clone_flags;
     let current = current!();
@@ -198,7 +230,7 @@ fn clone_child_thread(parent_context: &UserContext, clone_args: CloneArgs) -> Re
     clone_parent_settid(child_tid, clone_args.parent_tidptr, clone_flags)?;
     clone_child_cleartid(child_posix_thread, clone_args.child_tidptr, clone_flags)?;
     clone_child_settid(
-        child_root_vmar,
+        &child_root_vmar,
         child_tid,
         clone_args.child_tidptr,
         clone_flags,
@@ -217,7 +249,7 @@ fn clone_child_process(
     // clone vm
     let child_process_vm = {
         let parent_process_vm = current.vm();
-        clone_vm(parent_process_vm, clone_flags)?
+        clone_vm(&parent_process_vm, clone_flags)?
     };
 
     // clone user space
@@ -305,7 +337,7 @@ fn clone_child_process(
 
     let child_root_vmar = child.root_vmar();
     clone_child_settid(
-        child_root_vmar,
+        &child_root_vmar,
         child_tid,
         clone_args.child_tidptr,
         clone_flags,
@@ -354,11 +386,11 @@ fn clone_parent_settid(
 
 /// Clone child process vm. If CLONE_VM is set, both threads share the same root vmar.
 /// Otherwise, fork a new copy-on-write vmar.
-fn clone_vm(parent_process_vm: &ProcessVm, clone_flags: CloneFlags) -> Result<ProcessVm> {
+fn clone_vm(parent_process_vm: &Arc<ProcessVm>, clone_flags: CloneFlags) -> Result<Arc<ProcessVm>> {
     if clone_flags.contains(CloneFlags::CLONE_VM) {
         Ok(parent_process_vm.clone())
     } else {
-        ProcessVm::fork_from(parent_process_vm)
+        Ok(Arc::new(ProcessVm::fork_from(parent_process_vm)?))
     }
 }
 
@@ -374,8 +406,9 @@ fn clone_cpu_context(
     child_context.set_syscall_ret(0);
 
     if clone_flags.contains(CloneFlags::CLONE_VM) {
-        // if parent and child shares the same address space, a new stack must be specified.
-        debug_assert!(new_sp != 0);
+        // if parent and child shares the same address space, a new stack must be specified,
+        // unless the parent is suspended until the child execs or exits.
+        debug_assert!(new_sp != 0 || clone_flags.contains(CloneFlags::CLONE_VFORK));
     }
     if new_sp != 0 {
         // If stack size is not 0, the `new_sp` points to the BOTTOMMOST byte of stack.
@@ -406,16 +439,16 @@ fn clone_fs(
 }
 
 fn clone_files(
-    parent_file_table: &Arc<Mutex<FileTable>>,
+    parent_file_table: &Arc<SharedFileTable>,
     clone_flags: CloneFlags,
-) -> Arc<Mutex<FileTable>> {
+) -> Arc<SharedFileTable> {
     // if CLONE_FILES is set, the child and parent shares the same file table
     // Otherwise, the child will deep copy a new file table.
     // FIXME: the clone may not be deep copy.
     if clone_flags.contains(CloneFlags::CLONE_FILES) {
         parent_file_table.clone()
     } else {
-        Arc::new(Mutex::new(parent_file_table.lock().clone()))
+        Arc::new(SharedFileTable::new(parent_file_table.lock().clone()))
     }
 }
 
@@ -56,6 +56,8 @@ pub fn do_exit_group(term_status: TermStatus) {
         }
     }
 
+    current.release_vfork_parent();
+
     if let Some(parent) = current.parent() {
         // Notify parent
         let signal = KernelSignal::new(SIGCHLD);
@@ -9,7 +9,7 @@ use crate::{
     prelude::*,
     process::{
         posix_thread::name::ThreadName,
-        signal::{sig_mask::SigMask, sig_queues::SigQueues},
+        signal::{sig_mask::SigMask, sig_queues::SigQueues, SigQueueObserver},
         Credentials, Process,
     },
     thread::{status::ThreadStatus, task, thread_table, Thread, Tid},
@@ -103,6 +103,8 @@ impl PosixThreadBuilder {
                 sig_queues,
                 sig_context: Mutex::new(None),
                 sig_stack: Mutex::new(None),
+                sig_queue_observer: SigQueueObserver::new(),
+                poller: Mutex::new(None),
                 robust_list: Mutex::new(None),
                 prof_clock,
                 virtual_timer_manager,
@@ -24,16 +24,21 @@ pub fn do_exit(thread: Arc<Thread>, term_status: TermStatus) -> Result<()> {
     let posix_thread = thread.as_posix_thread().unwrap();
 
     let mut clear_ctid = posix_thread.clear_child_tid().lock();
-    // If clear_ctid !=0 ,do a futex wake and write zero to the clear_ctid addr.
+    // If clear_ctid !=0 ,write zero to the clear_ctid addr and do a futex wake.
     if *clear_ctid != 0 {
-        futex_wake(*clear_ctid, 1)?;
         // FIXME: the correct write length?
         write_val_to_user(*clear_ctid, &0u32).unwrap();
+        // The futex value must be changed before the wake. Otherwise, the waiter may
+        // find the old value and wait again, missing the wakeup.
+        futex_wake(*clear_ctid, 1, false)?;
         *clear_ctid = 0;
     }
     // exit the robust list: walk the robust list; mark futex words as dead and do futex wake
     wake_robust_list(posix_thread, tid);
 
+    // Unregister the cached poller from the polled files.
+    drop(posix_thread.poller().lock().take());
+
     if tid != posix_thread.process().pid() {
         // We don't remove main thread.
         // The main thread is removed when the process is reaped.
@@ -45,7 +50,7 @@ pub fn do_exit(thread: Arc<Thread>, term_status: TermStatus) -> Result<()> {
         do_exit_group(term_status);
     }
 
-    futex_wake(Arc::as_ptr(&posix_thread.process()) as Vaddr, 1)?;
+    futex_wake(Arc::as_ptr(&posix_thread.process()) as Vaddr, 1, false)?;
     Ok(())
 }
 
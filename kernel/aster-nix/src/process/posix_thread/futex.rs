@@ -2,27 +2,41 @@
 
 #![allow(dead_code)]
 
-use core::sync::atomic::{AtomicBool, Ordering};
+use core::time::Duration;
 
-use ostd::cpu::num_cpus;
+use ostd::{
+    cpu::num_cpus,
+    sync::{Waiter, Waker},
+    task::current_task,
+};
 use spin::Once;
 
 use crate::{
     prelude::*,
-    thread::{Thread, Tid},
-    util::read_val_from_user,
+    time::{clocks::JIFFIES_TIMER_MANAGER, timer::Timeout},
+    util::{atomic_update_val_in_user, read_val_from_user},
 };
 
 type FutexBitSet = u32;
-type FutexBucketRef = Arc<Mutex<FutexBucket>>;
 
 const FUTEX_OP_MASK: u32 = 0x0000_000F;
 const FUTEX_FLAGS_MASK: u32 = 0xFFFF_FFF0;
 const FUTEX_BITSET_MATCH_ANY: FutexBitSet = 0xFFFF_FFFF;
 
 /// do futex wait
-pub fn futex_wait(futex_addr: u64, futex_val: i32, timeout: &Option<FutexTimeout>) -> Result<()> {
-    futex_wait_bitset(futex_addr as _, futex_val, timeout, FUTEX_BITSET_MATCH_ANY)
+pub fn futex_wait(
+    futex_addr: u64,
+    futex_val: i32,
+    timeout: &Option<FutexTimeout>,
+    is_private: bool,
+) -> Result<()> {
+    futex_wait_bitset(
+        futex_addr as _,
+        futex_val,
+        timeout,
+        FUTEX_BITSET_MATCH_ANY,
+        is_private,
+    )
 }
 
 /// do futex wait bitset
@@ -31,34 +45,66 @@ pub fn futex_wait_bitset(
     futex_val: i32,
     timeout: &Option<FutexTimeout>,
     bitset: FutexBitSet,
+    is_private: bool,
 ) -> Result<()> {
     debug!(
         "futex_wait_bitset addr: {:#x}, val: {}, timeout: {:?}, bitset: {:#x}",
         futex_addr, futex_val, timeout, bitset
     );
-    let futex_key = FutexKey::new(futex_addr);
-    let (_, futex_bucket_ref) = get_futex_bucket(futex_key);
-
-    // lock futex bucket ref here to avoid data race
-    let mut futex_bucket = futex_bucket_ref.lock();
+    if bitset == 0 {
+        return_errno_with_message!(Errno::EINVAL, "the futex bitset cannot be zero");
+    }
 
-    if futex_key.load_val() != futex_val {
-        return_errno_with_message!(Errno::EINVAL, "futex value does not match");
+    let futex_key = FutexKey::new(futex_addr, is_private)?;
+    let futex_bucket = get_futex_bucket(&futex_key);
+
+    let (waiter, waker) = Waiter::new_pair();
+    futex_bucket
+        .lock()
+        .enqueue_item(FutexItem::new(futex_key, bitset, waker.clone()));
+
+    // The futex value is checked after the item is enqueued, and without holding the bucket
+    // lock since reading user memory may sleep. A waker always changes the futex value before
+    // waking up the waiters. So either the change is visible here, or the waker finds the item.
+    let futex_val_now = futex_key.load_val();
+    if !matches!(futex_val_now, Ok(val) if val == futex_val) {
+        // Closing the waker before removing the item ensures that the item never
+        // consumes a wakeup that is meant for others, even if it has been requeued.
+        drop(waiter);
+        futex_bucket.lock().remove_item(&futex_key, &waker);
+        futex_val_now?;
+        return_errno_with_message!(Errno::EAGAIN, "futex value does not match");
     }
-    let futex_item = FutexItem::new(futex_key, bitset);
-    futex_bucket.enqueue_item(futex_item.clone());
 
-    // drop lock
-    drop(futex_bucket);
-    // Wait on the futex item
-    futex_item.wait();
+    let Some(timeout) = timeout else {
+        // Wait on the futex item
+        waiter.wait();
+        return Ok(());
+    };
+
+    let timer = JIFFIES_TIMER_MANAGER.get().unwrap().create_timer({
+        let waker = waker.clone();
+        move || {
+            waker.wake_up();
+        }
+    });
+    timer.set_timeout(Timeout::After(timeout.duration()));
+    waiter.wait();
+    timer.cancel();
+
+    // If the item is still in the bucket, the waiter is woken by the timer rather than by
+    // dequeuing the item.
+    drop(waiter);
+    if futex_bucket.lock().remove_item(&futex_key, &waker) {
+        return_errno_with_message!(Errno::ETIMEDOUT, "the futex wait timed out");
+    }
 
     Ok(())
 }
 
 /// do futex wake
-pub fn futex_wake(futex_addr: Vaddr, max_count: usize) -> Result<usize> {
-    futex_wake_bitset(futex_addr, max_count, FUTEX_BITSET_MATCH_ANY)
+pub fn futex_wake(futex_addr: Vaddr, max_count: usize, is_private: bool) -> Result<usize> {
+    futex_wake_bitset(futex_addr, max_count, FUTEX_BITSET_MATCH_ANY, is_private)
 }
 
 /// Do futex wake with bitset
@@ -66,46 +112,86 @@ pub fn futex_wake_bitset(
     futex_addr: Vaddr,
     max_count: usize,
     bitset: FutexBitSet,
+    is_private: bool,
 ) -> Result<usize> {
     debug!(
         "futex_wake_bitset addr: {:#x}, max_count: {}, bitset: {:#x}",
         futex_addr, max_count, bitset
     );
+    if bitset == 0 {
+        return_errno_with_message!(Errno::EINVAL, "the futex bitset cannot be zero");
+    }
 
-    let futex_key = FutexKey::new(futex_addr);
-    let (_, futex_bucket_ref) = get_futex_bucket(futex_key);
-    let mut futex_bucket = futex_bucket_ref.lock();
-    let res = futex_bucket.dequeue_and_wake_items(futex_key, max_count, bitset);
-    // debug!("futex wake bitset succeeds, res = {}", res);
-    drop(futex_bucket);
-    // for _ in 0..res {
-    //     Thread::yield_now();
-    // }
+    let futex_key = FutexKey::new(futex_addr, is_private)?;
+    let futex_bucket = get_futex_bucket(&futex_key);
+    let res = futex_bucket
+        .lock()
+        .dequeue_and_wake_items(futex_key, max_count, bitset);
     Ok(res)
 }
 
+/// Do futex wake op
+///
+/// This operation atomically (with regard to other futex operations) applies `wake_op`
+/// to the futex word at `futex_addr_2`, wakes up at most `max_nwakes` waiters of the futex
+/// at `futex_addr`, and, if the old value of the futex word at `futex_addr_2` satisfies
+/// the comparison encoded in `wake_op`, wakes up at most `max_nwakes_2` waiters of the
+/// futex at `futex_addr_2`.
+pub fn futex_wake_op(
+    futex_addr: Vaddr,
+    futex_addr_2: Vaddr,
+    max_nwakes: usize,
+    max_nwakes_2: usize,
+    wake_op: u32,
+    is_private: bool,
+) -> Result<usize> {
+    let wake_op = FutexWakeOp::from_u32(wake_op)?;
+    let futex_key = FutexKey::new(futex_addr, is_private)?;
+    let futex_key_2 = FutexKey::new(futex_addr_2, is_private)?;
+
+    let old_val =
+        atomic_update_val_in_user(futex_addr_2, |val| wake_op.apply(val as i32) as u32)? as i32;
+
+    let mut nwakes = get_futex_bucket(&futex_key).lock().dequeue_and_wake_items(
+        futex_key,
+        max_nwakes,
+        FUTEX_BITSET_MATCH_ANY,
+    );
+    if wake_op.should_wake_2(old_val) {
+        nwakes += get_futex_bucket(&futex_key_2)
+            .lock()
+            .dequeue_and_wake_items(futex_key_2, max_nwakes_2, FUTEX_BITSET_MATCH_ANY);
+    }
+    Ok(nwakes)
+}
+
 /// Do futex requeue
 pub fn futex_requeue(
     futex_addr: Vaddr,
     max_nwakes: usize,
     max_nrequeues: usize,
     futex_new_addr: Vaddr,
+    is_private: bool,
 ) -> Result<usize> {
     if futex_new_addr == futex_addr {
-        return futex_wake(futex_addr, max_nwakes);
+        return futex_wake(futex_addr, max_nwakes, is_private);
     }
 
-    let futex_key = FutexKey::new(futex_addr);
-    let futex_new_key = FutexKey::new(futex_new_addr);
-    let (bucket_idx, futex_bucket_ref) = get_futex_bucket(futex_key);
-    let (new_bucket_idx, futex_new_bucket_ref) = get_futex_bucket(futex_new_key);
+    let futex_key = FutexKey::new(futex_addr, is_private)?;
+    let futex_new_key = FutexKey::new(futex_new_addr, is_private)?;
+    let futex_buckets = FUTEX_BUCKETS.get().unwrap();
+    let bucket_idx = futex_buckets.index_of(&futex_key);
+    let new_bucket_idx = futex_buckets.index_of(&futex_new_key);
+    let futex_bucket_ref = futex_buckets.bucket_at(bucket_idx);
+    let futex_new_bucket_ref = futex_buckets.bucket_at(new_bucket_idx);
 
     let nwakes = {
         if bucket_idx == new_bucket_idx {
             let mut futex_bucket = futex_bucket_ref.lock();
             let nwakes =
                 futex_bucket.dequeue_and_wake_items(futex_key, max_nwakes, FUTEX_BITSET_MATCH_ANY);
-            futex_bucket.update_item_keys(futex_key, futex_new_key, max_nrequeues);
+            let items = futex_bucket.dequeue_items(futex_key, max_nrequeues);
+            futex_bucket.enqueue_items(futex_new_key, items);
             drop(futex_bucket);
             nwakes
         } else {
@@ -124,12 +210,8 @@ pub fn futex_requeue(
 
             let nwakes =
                 futex_bucket.dequeue_and_wake_items(futex_key, max_nwakes, FUTEX_BITSET_MATCH_ANY);
-            futex_bucket.requeue_items_to_another_bucket(
-                futex_key,
-                &mut futex_new_bucket,
-                futex_new_key,
-                max_nrequeues,
-            );
+            let items = futex_bucket.dequeue_items(futex_key, max_nrequeues);
+            futex_new_bucket.enqueue_items(futex_new_key, items);
             nwakes
         }
     };
@@ -146,7 +228,7 @@ fn get_bucket_count() -> usize {
     ((1 << 8) * num_cpus()).next_power_of_two() as usize
 }
 
-fn get_futex_bucket(key: FutexKey) -> (usize, FutexBucketRef) {
+fn get_futex_bucket(key: &FutexKey) -> &'static SpinLock<FutexBucket> {
     FUTEX_BUCKETS.get().unwrap().get_bucket(key)
 }
 
@@ -155,39 +237,61 @@ pub fn init() {
     FUTEX_BUCKETS.call_once(|| FutexBucketVec::new(get_bucket_count()));
 }
 
+/// The timeout of a futex wait, relative to the time when the wait starts.
 #[derive(Debug, Clone)]
-pub struct FutexTimeout {}
+pub struct FutexTimeout {
+    duration: Duration,
+}
 
 impl FutexTimeout {
-    pub fn new() -> Self {
-        todo!()
+    pub fn new(duration: Duration) -> Self {
+        Self { duration }
+    }
+
+    pub fn duration(&self) -> Duration {
+        self.duration
     }
 }
 
 struct FutexBucketVec {
-    vec: Vec<FutexBucketRef>,
+    vec: Vec<PaddedFutexBucket>,
+    /// The base-2 logarithm of the number of buckets.
+    order: u32,
 }
 
+/// A futex bucket that occupies whole cache lines,
+/// so that contention on one bucket does not slow down accesses to its neighbors.
+#[repr(align(64))]
+struct PaddedFutexBucket(SpinLock<FutexBucket>);
+
 impl FutexBucketVec {
     pub fn new(size: usize) -> FutexBucketVec {
-        let mut buckets = FutexBucketVec {
-            vec: Vec::with_capacity(size),
-        };
-        for _ in 0..size {
-            let bucket = Arc::new(Mutex::new(FutexBucket::new()));
-            buckets.vec.push(bucket);
+        debug_assert!(size.is_power_of_two());
+        let vec = (0..size)
+            .map(|_| PaddedFutexBucket(SpinLock::new(FutexBucket::new())))
+            .collect();
+        FutexBucketVec {
+            vec,
+            order: size.trailing_zeros(),
         }
-        buckets
     }
 
-    pub fn get_bucket(&self, key: FutexKey) -> (usize, FutexBucketRef) {
-        let index = (self.vec.len() - 1) & {
-            // The addr is the multiples of 4, so we ignore the last 2 bits
-            let addr = key.addr() >> 2;
-            // simple hash
-            addr / self.size()
-        };
-        (index, self.vec[index].clone())
+    pub fn get_bucket(&self, key: &FutexKey) -> &SpinLock<FutexBucket> {
+        self.bucket_at(self.index_of(key))
+    }
+
+    fn bucket_at(&self, index: usize) -> &SpinLock<FutexBucket> {
+        &self.vec[index].0
+    }
+
+    fn index_of(&self, key: &FutexKey) -> usize {
+        // The addr is the multiples of 4, so we ignore the last 2 bits.
+        // The address space is mixed in so that the same address in different processes
+        // is unlikely to end up in the same bucket.
+        let word = ((key.addr() >> 2) as u64) ^ (key.space as u64).rotate_left(32);
+        // Fibonacci hashing, which spreads consecutive words over all buckets
+        let hash = word.wrapping_mul(0x9E37_79B9_7F4A_7C15);
+        (hash >> (u64::BITS - self.order)) as usize
     }
 
     fn size(&self) -> usize {
@@ -195,146 +299,248 @@ impl FutexBucketVec {
     }
 }
 
+/// A futex bucket.
+///
+/// The waiting items are grouped by their keys, so a wakeup finds the
+/// waiters of a futex without scanning the waiters of other futexes
+/// that happen to be hashed into the same bucket.
 struct FutexBucket {
-    queue: VecDeque<FutexItem>,
+    queues: BTreeMap<FutexKey, VecDeque<FutexItem>>,
 }
 
 impl FutexBucket {
     pub fn new() -> FutexBucket {
         FutexBucket {
-            queue: VecDeque::new(),
+            queues: BTreeMap::new(),
         }
     }
 
     pub fn enqueue_item(&mut self, item: FutexItem) {
-        self.queue.push_back(item);
+        self.queues.entry(item.key).or_default().push_back(item);
+    }
+
+    pub fn enqueue_items(&mut self, new_key: FutexKey, items: VecDeque<FutexItem>) {
+        if items.is_empty() {
+            return;
+        }
+        let queue = self.queues.entry(new_key).or_default();
+        queue.extend(items.into_iter().map(|mut item| {
+            item.key = new_key;
+            item
+        }));
     }
 
-    pub fn dequeue_item(&mut self, item: &FutexItem) {
-        let item_i = self
-            .queue
+    /// Removes the item that holds the `waker` from the queue of `key`, if it is still there.
+    ///
+    /// Returns whether the item is removed.
+    pub fn remove_item(&mut self, key: &FutexKey, waker: &Arc<Waker>) -> bool {
+        let Some(queue) = self.queues.get_mut(key) else {
+            return false;
+        };
+        let item_i = queue
             .iter()
-            .position(|futex_item| *futex_item == *item);
+            .position(|item| Arc::ptr_eq(&item.waker, waker));
         if let Some(item_i) = item_i {
-            self.queue.remove(item_i).unwrap();
+            queue.remove(item_i);
         }
+        if queue.is_empty() {
+            self.queues.remove(key);
+        }
+        item_i.is_some()
     }
 
+    /// Wakes up at most `max_count` waiters of the futex whose bitsets intersect `bitset`.
+    ///
+    /// Items whose waiters have given up waiting are discarded and not counted.
     pub fn dequeue_and_wake_items(
         &mut self,
         key: FutexKey,
         max_count: usize,
         bitset: FutexBitSet,
     ) -> usize {
+        let Some(queue) = self.queues.get_mut(&key) else {
+            return 0;
+        };
+
         let mut count = 0;
-        let mut items_to_wake = Vec::new();
-
-        self.queue.retain(|item| {
-            if count >= max_count || key != item.key || (bitset & item.bitset) == 0 {
-                true
-            } else {
-                items_to_wake.push(item.clone());
-                count += 1;
-                false
+        if bitset == FUTEX_BITSET_MATCH_ANY {
+            // Fast path: every item matches, so take them from the front.
+            while count < max_count {
+                let Some(item) = queue.pop_front() else {
+                    break;
+                };
+                if item.waker.wake_up() {
+                    count += 1;
+                }
             }
-        });
-
-        // debug!("items to wake len: {}", items_to_wake.len());
+        } else {
+            queue.retain(|item| {
+                if count >= max_count || (bitset & item.bitset) == 0 {
+                    true
+                } else {
+                    if item.waker.wake_up() {
+                        count += 1;
+                    }
+                    false
+                }
+            });
+        }
 
-        FutexItem::batch_wake(&items_to_wake);
+        if queue.is_empty() {
+            self.queues.remove(&key);
+        }
         count
     }
 
-    pub fn update_item_keys(&mut self, key: FutexKey, new_key: FutexKey, max_count: usize) {
-        let mut count = 0;
-        for item in self.queue.iter_mut() {
-            if count == max_count {
-                break;
-            }
-            if item.key == key {
-                item.key = new_key;
-                count += 1;
-            }
+    /// Dequeues at most `max_count` items of the futex without waking them up.
+    pub fn dequeue_items(&mut self, key: FutexKey, max_count: usize) -> VecDeque<FutexItem> {
+        let Some(queue) = self.queues.get_mut(&key) else {
+            return VecDeque::new();
+        };
+        if queue.len() <= max_count {
+            return self.queues.remove(&key).unwrap();
         }
-    }
-
-    pub fn requeue_items_to_another_bucket(
-        &mut self,
-        key: FutexKey,
-        another: &mut Self,
-        new_key: FutexKey,
-        max_nrequeues: usize,
-    ) {
-        let mut count = 0;
-
-        self.queue.retain(|item| {
-            if count >= max_nrequeues || key != item.key {
-                true
-            } else {
-                let mut new_item = item.clone();
-                new_item.key = new_key;
-                another.enqueue_item(new_item);
-                count += 1;
-                false
-            }
-        });
+        let rest = queue.split_off(max_count);
+        core::mem::replace(queue, rest)
     }
 }
 
-#[derive(Debug, PartialEq, Clone)]
 struct FutexItem {
     key: FutexKey,
     bitset: FutexBitSet,
-    waiter: FutexWaiterRef,
+    waker: Arc<Waker>,
 }
 
 impl FutexItem {
-    pub fn new(key: FutexKey, bitset: FutexBitSet) -> Self {
-        FutexItem {
-            key,
-            bitset,
-            waiter: Arc::new(FutexWaiter::new()),
-        }
+    pub fn new(key: FutexKey, bitset: FutexBitSet, waker: Arc<Waker>) -> Self {
+        FutexItem { key, bitset, waker }
     }
+}
 
-    pub fn wake(&self) {
-        // debug!("wake futex item, key = {:?}", self.key);
-        self.waiter.wake();
-    }
+/// The key that identifies a futex.
+///
+/// A private futex can only be shared between the threads of a process, so it is keyed by
+/// both the address space and the address. Other futexes are keyed by the address only,
+/// since they may be shared between processes that map the same memory at the same address.
+///
+/// FIXME: Shared futexes should be keyed by the underlying memory object and offset,
+/// like Linux, to support memory that is mapped at different addresses in different processes.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord)]
+struct FutexKey {
+    /// An identifier of the address space for private futexes, or zero for shared ones.
+    space: usize,
+    addr: Vaddr,
+}
+
+impl FutexKey {
+    pub fn new(futex_addr: Vaddr, is_private: bool) -> Result<Self> {
+        if futex_addr % core::mem::align_of::<u32>() != 0 {
+            return_errno_with_message!(Errno::EINVAL, "the futex address is not aligned");
+        }
 
-    pub fn wait(&self) {
-        // debug!("wait on futex item, key = {:?}", self.key);
-        self.waiter.wait();
-        // debug!("wait finished, key = {:?}", self.key);
+        let space = if is_private {
+            current_task()
+                .and_then(|task| {
+                    task.user_space()
+                        .map(|user_space| user_space.vm_space() as *const _ as usize)
+                })
+                .unwrap_or(0)
+        } else {
+            0
+        };
+
+        Ok(FutexKey {
+            space,
+            addr: futex_addr,
+        })
     }
 
-    pub fn waiter(&self) -> &FutexWaiterRef {
-        &self.waiter
+    pub fn load_val(&self) -> Result<i32> {
+        // FIXME: how to implement a atomic load?
+        read_val_from_user(self.addr)
     }
 
-    pub fn batch_wake(items: &[FutexItem]) {
-        let waiters = items.iter().map(|item| item.waiter()).collect::<Vec<_>>();
-        FutexWaiter::batch_wake(&waiters);
+    pub fn addr(&self) -> Vaddr {
+        self.addr
     }
 }
 
-// The addr of a futex, it should be used to mark different futex word
-#[derive(Debug, Clone, Copy, PartialEq, Eq)]
-struct FutexKey(Vaddr);
+/// The operation encoded in the `val3` argument of `FUTEX_WAKE_OP`.
+#[derive(Debug, Clone, Copy)]
+struct FutexWakeOp {
+    op: u32,
+    oparg: i32,
+    cmp: u32,
+    cmparg: i32,
+}
 
-impl FutexKey {
-    pub fn new(futex_addr: Vaddr) -> Self {
-        FutexKey(futex_addr as _)
+const FUTEX_OP_SET: u32 = 0;
+const FUTEX_OP_ADD: u32 = 1;
+const FUTEX_OP_OR: u32 = 2;
+const FUTEX_OP_ANDN: u32 = 3;
+const FUTEX_OP_XOR: u32 = 4;
+/// The flag that tells to use `1 << oparg` as the operand.
+const FUTEX_OP_OPARG_SHIFT: u32 = 8;
+
+const FUTEX_OP_CMP_EQ: u32 = 0;
+const FUTEX_OP_CMP_NE: u32 = 1;
+const FUTEX_OP_CMP_LT: u32 = 2;
+const FUTEX_OP_CMP_LE: u32 = 3;
+const FUTEX_OP_CMP_GT: u32 = 4;
+const FUTEX_OP_CMP_GE: u32 = 5;
+
+impl FutexWakeOp {
+    pub fn from_u32(bits: u32) -> Result<Self> {
+        /// Sign-extends a 12-bit argument.
+        fn sign_extend_12(bits: u32) -> i32 {
+            ((bits << 20) as i32) >> 20
+        }
+
+        let mut op = (bits >> 28) & 0xf;
+        let cmp = (bits >> 24) & 0xf;
+        let mut oparg = sign_extend_12((bits >> 12) & 0xfff);
+        let cmparg = sign_extend_12(bits & 0xfff);
+
+        if op & FUTEX_OP_OPARG_SHIFT != 0 {
+            op &= !FUTEX_OP_OPARG_SHIFT;
+            oparg = 1 << (oparg & 31);
+        }
+        if op > FUTEX_OP_XOR || cmp > FUTEX_OP_CMP_GE {
+            return_errno_with_message!(Errno::ENOSYS, "unknown futex wake op");
+        }
+
+        Ok(Self {
+            op,
+            oparg,
+            cmp,
+            cmparg,
+        })
     }
 
-    pub fn load_val(&self) -> i32 {
-        // FIXME: how to implement a atomic load?
-        warn!("implement an atomic load");
-        read_val_from_user(self.0).unwrap()
+    /// Returns the new value of the futex word given its old value.
+    pub fn apply(&self, old_val: i32) -> i32 {
+        match self.op {
+            FUTEX_OP_SET => self.oparg,
+            FUTEX_OP_ADD => old_val.wrapping_add(self.oparg),
+            FUTEX_OP_OR => old_val | self.oparg,
+            FUTEX_OP_ANDN => old_val & !self.oparg,
+            FUTEX_OP_XOR => old_val ^ self.oparg,
+            _ => unreachable!(),
+        }
     }
 
-    pub fn addr(&self) -> Vaddr {
-        self.0
+    /// Tells whether the waiters of the second futex should be woken up
+    /// given the old value of its futex word.
+    pub fn should_wake_2(&self, old_val: i32) -> bool {
+        match self.cmp {
+            FUTEX_OP_CMP_EQ => old_val == self.cmparg,
+            FUTEX_OP_CMP_NE => old_val != self.cmparg,
+            FUTEX_OP_CMP_LT => old_val < self.cmparg,
+            FUTEX_OP_CMP_LE => old_val <= self.cmparg,
+            FUTEX_OP_CMP_GT => old_val > self.cmparg,
+            FUTEX_OP_CMP_GE => old_val >= self.cmparg,
+            _ => unreachable!(),
+        }
     }
 }
 
@@ -400,56 +606,3 @@ pub fn futex_op_and_flags_from_u32(bits: u32) -> Result<(FutexOp, FutexFlags)> {
     };
     Ok((op, flags))
 }
-
-type FutexWaiterRef = Arc<FutexWaiter>;
-
-#[derive(Debug)]
-struct FutexWaiter {
-    is_woken: AtomicBool,
-    tid: Tid,
-}
-
-impl PartialEq for FutexWaiter {
-    fn eq(&self, other: &Self) -> bool {
-        self.tid == other.tid
-    }
-}
-
-impl FutexWaiter {
-    pub fn new() -> Self {
-        Self {
-            is_woken: AtomicBool::new(false),
-            tid: current_thread!().tid(),
-        }
-    }
-
-    pub fn wait(&self) {
-        let current_thread = current_thread!();
-        if current_thread.tid() != self.tid {
-            return;
-        }
-        self.is_woken.store(false, Ordering::SeqCst);
-        while !self.is_woken() {
-            // debug!("futex is wait for waken, tid = {}", self.tid);
-            Thread::yield_now();
-        }
-        // debug!("futex is waken, tid = {}", self.tid);
-    }
-
-    pub fn wake(&self) {
-        if !self.is_woken() {
-            // debug!("wake up futex, tid = {}", self.tid);
-            self.is_woken.store(true, Ordering::SeqCst);
-        }
-    }
-
-    pub fn is_woken(&self) -> bool {
-        self.is_woken.load(Ordering::SeqCst)
-    }
-
-    pub fn batch_wake(waiters: &[&FutexWaiterRef]) {
-        waiters.iter().for_each(|waiter| {
-            waiter.wake();
-        });
-    }
-}
@@ -11,7 +11,7 @@ use super::{
         sig_num::SigNum,
         sig_queues::SigQueues,
         signals::Signal,
-        SigEvents, SigEventsFilter, SigStack,
+        Poller, SigEvents, SigEventsFilter, SigQueueObserver, SigStack,
     },
     Credentials, Process,
 };
@@ -62,6 +62,12 @@ pub struct PosixThread {
     /// FIXME: This field may be removed. For glibc applications with RESTORER flag set, the sig_context is always equals with rsp.
     sig_context: Mutex<Option<Vaddr>>,
     sig_stack: Mutex<Option<SigStack>>,
+    /// The observer that interrupts the pauses of the thread when signals arrive.
+    sig_queue_observer: Arc<SigQueueObserver>,
+
+    /// The poller cached for `poll` and `select`, so that the registrations on the
+    /// polled files are kept across the system calls.
+    poller: Mutex<Option<Poller>>,
 
     /// A profiling clock measures the user CPU time and kernel CPU time in the thread.
     prof_clock: Arc<ProfClock>,
@@ -78,6 +84,10 @@ impl PosixThread {
         self.process.upgrade().unwrap()
     }
 
+    pub fn weak_process(&self) -> &Weak<Process> {
+        &self.process
+    }
+
     pub fn thread_name(&self) -> &Mutex<Option<ThreadName>> {
         &self.name
     }
@@ -101,10 +111,21 @@ impl PosixThread {
     /// Returns whether the thread has some pending signals
     /// that are not blocked.
     pub fn has_pending(&self) -> bool {
+        if !self.has_queued_signals() {
+            return false;
+        }
         let blocked = *self.sig_mask().lock();
         self.sig_queues.has_pending(blocked)
     }
 
+    /// Returns whether there are signals queued to the thread, regardless of whether
+    /// they are blocked.
+    ///
+    /// This is cheaper than [`Self::has_pending`] since no locks are taken.
+    pub fn has_queued_signals(&self) -> bool {
+        !self.sig_queues.is_empty()
+    }
+
     /// Returns whether the signal is blocked by the thread.
     pub(in crate::process) fn has_signal_blocked(&self, signal: &dyn Signal) -> bool {
         let mask = self.sig_mask.lock();
@@ -209,6 +230,10 @@ impl PosixThread {
         self.sig_queues.unregister_observer(observer);
     }
 
+    pub(in crate::process) fn sig_queue_observer(&self) -> &Arc<SigQueueObserver> {
+        &self.sig_queue_observer
+    }
+
     pub fn sig_context(&self) -> &Mutex<Option<Vaddr>> {
         &self.sig_context
     }
@@ -217,6 +242,10 @@ impl PosixThread {
         &self.sig_stack
     }
 
+    pub fn poller(&self) -> &Mutex<Option<Poller>> {
+        &self.poller
+    }
+
     pub fn robust_list(&self) -> &Mutex<Option<RobustListHead>> {
         &self.robust_list
     }
@@ -148,7 +148,7 @@ pub fn wake_robust_futex(futex_addr: Vaddr, tid: Pid) -> Result<()> {
         // Wakeup one waiter
         if cur_val & FUTEX_WAITERS != 0 {
             debug!("wake robust futex addr: {:?}", futex_addr);
-            futex_wake(futex_addr, 1)?;
+            futex_wake(futex_addr, 1, false)?;
         }
         break;
     }
@@ -4,7 +4,11 @@
 
 use super::{Pid, Process};
 use crate::{
-    fs::{file_table::FileTable, fs_resolver::FsResolver, utils::FileCreationMask},
+    fs::{
+        file_table::{FileTable, SharedFileTable},
+        fs_resolver::FsResolver,
+        utils::FileCreationMask,
+    },
     prelude::*,
     process::{
         posix_thread::{PosixThreadBuilder, PosixThreadExt},
@@ -27,8 +31,8 @@ pub struct ProcessBuilder<'a> {
     main_thread_builder: Option<PosixThreadBuilder>,
     argv: Option<Vec<CString>>,
     envp: Option<Vec<CString>>,
-    process_vm: Option<ProcessVm>,
-    file_table: Option<Arc<Mutex<FileTable>>>,
+    process_vm: Option<Arc<ProcessVm>>,
+    file_table: Option<Arc<SharedFileTable>>,
     fs: Option<Arc<RwMutex<FsResolver>>>,
     umask: Option<Arc<RwLock<FileCreationMask>>>,
     resource_limits: Option<ResourceLimits>,
@@ -62,12 +66,12 @@ impl<'a> ProcessBuilder<'a> {
         self
     }
 
-    pub fn process_vm(&mut self, process_vm: ProcessVm) -> &mut Self {
+    pub fn process_vm(&mut self, process_vm: Arc<ProcessVm>) -> &mut Self {
         self.process_vm = Some(process_vm);
         self
     }
 
-    pub fn file_table(&mut self, file_table: Arc<Mutex<FileTable>>) -> &mut Self {
+    pub fn file_table(&mut self, file_table: Arc<SharedFileTable>) -> &mut Self {
         self.file_table = Some(file_table);
         self
     }
@@ -149,10 +153,10 @@ impl<'a> ProcessBuilder<'a> {
             nice,
         } = self;
 
-        let process_vm = process_vm.or_else(|| Some(ProcessVm::alloc())).unwrap();
+        let process_vm = process_vm.unwrap_or_else(|| Arc::new(ProcessVm::alloc()));
 
         let file_table = file_table
-            .or_else(|| Some(Arc::new(Mutex::new(FileTable::new_with_stdio()))))
+            .or_else(|| Some(Arc::new(SharedFileTable::new(FileTable::new_with_stdio()))))
             .unwrap();
 
         let fs = fs
@@ -197,7 +201,7 @@ impl<'a> ProcessBuilder<'a> {
             Thread::new_posix_thread_from_executable(
                 pid,
                 credentials.unwrap(),
-                process.vm(),
+                &process.vm(),
                 &process.fs().read(),
                 executable_path,
                 Arc::downgrade(&process),
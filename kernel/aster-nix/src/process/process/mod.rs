@@ -1,10 +1,12 @@
 // SPDX-License-Identifier: MPL-2.0
 
+use core::sync::atomic::{AtomicBool, Ordering};
+
 use self::timer_manager::PosixTimerManager;
 use super::{
     posix_thread::PosixThreadExt,
     process_table,
-    process_vm::{Heap, InitStackReader, ProcessVm},
+    process_vm::ProcessVm,
     rlimit::ResourceLimits,
     signal::{
         constants::SIGCHLD,
@@ -19,7 +21,7 @@ use super::{
 };
 use crate::{
     device::tty::open_ntty_as_controlling_terminal,
-    fs::{file_table::FileTable, fs_resolver::FsResolver, utils::FileCreationMask},
+    fs::{file_table::SharedFileTable, fs_resolver::FsResolver, utils::FileCreationMask},
     prelude::*,
     sched::nice::Nice,
     thread::{allocate_tid, Thread},
@@ -38,6 +40,7 @@ use aster_rights::Full;
 use atomic::Atomic;
 pub use builder::ProcessBuilder;
 pub use job_control::JobControl;
+use ostd::task::current_task;
 pub use process_group::ProcessGroup;
 pub use session::Session;
 pub use terminal::Terminal;
@@ -60,11 +63,14 @@ pub struct Process {
     // Immutable Part
     pid: Pid,
 
-    process_vm: ProcessVm,
     /// Wait for child status changed
     children_pauser: Arc<Pauser>,
 
     // Mutable Part
+    /// The virtual memory, which may be shared with other processes.
+    ///
+    /// A process switches to a new virtual memory at exec if the old one is shared.
+    process_vm: Mutex<Arc<ProcessVm>>,
     /// The executable path.
     executable_path: RwLock<String>,
     /// The threads
@@ -78,7 +84,7 @@ pub struct Process {
     /// Process group
     pub(super) process_group: Mutex<Weak<ProcessGroup>>,
     /// File table
-    file_table: Arc<Mutex<FileTable>>,
+    file_table: Arc<SharedFileTable>,
     /// FsResolver
     fs: Arc<RwMutex<FsResolver>>,
     /// umask
@@ -95,6 +101,10 @@ pub struct Process {
     sig_dispositions: Arc<Mutex<SigDispositions>>,
     /// The signal that the process should receive when parent process exits.
     parent_death_signal: AtomicSigNum,
+    /// Whether the parent process is suspended until the process execs or exits.
+    ///
+    /// This is set if the process is created with `CLONE_VFORK`.
+    vfork_parent_waiting: AtomicBool,
 
     /// A profiling clock measures the user CPU time and kernel CPU time of the current process.
     prof_clock: Arc<ProfClock>,
@@ -110,10 +120,10 @@ impl Process {
         parent: Weak<Process>,
         threads: Vec<Arc<Thread>>,
         executable_path: String,
-        process_vm: ProcessVm,
+        process_vm: Arc<ProcessVm>,
 
         fs: Arc<RwMutex<FsResolver>>,
-        file_table: Arc<Mutex<FileTable>>,
+        file_table: Arc<SharedFileTable>,
 
         umask: Arc<RwLock<FileCreationMask>>,
         resource_limits: ResourceLimits,
@@ -128,12 +138,13 @@ impl Process {
         };
 
         let prof_clock = ProfClock::new();
+        process_vm.attach_process();
 
         Arc::new_cyclic(|process_ref: &Weak<Process>| Self {
             pid,
             threads: Mutex::new(threads),
             executable_path: RwLock::new(executable_path),
-            process_vm,
+            process_vm: Mutex::new(process_vm),
             children_pauser,
             status: Mutex::new(ProcessStatus::Uninit),
             parent: Mutex::new(parent),
@@ -144,6 +155,7 @@ impl Process {
             umask,
             sig_dispositions,
             parent_death_signal: AtomicSigNum::new_empty(),
+            vfork_parent_waiting: AtomicBool::new(false),
             resource_limits: Mutex::new(resource_limits),
             nice: Atomic::new(nice),
             timer_manager: PosixTimerManager::new(&prof_clock, process_ref),
@@ -529,25 +541,38 @@ impl Process {
 
     // ************** Virtual Memory *************
 
-    pub fn vm(&self) -> &ProcessVm {
-        &self.process_vm
+    pub fn vm(&self) -> Arc<ProcessVm> {
+        self.process_vm.lock().clone()
     }
 
-    pub fn root_vmar(&self) -> &Vmar<Full> {
-        self.process_vm.root_vmar()
+    pub fn root_vmar(&self) -> Vmar<Full> {
+        self.vm().root_vmar().dup().unwrap()
     }
 
-    pub fn heap(&self) -> &Heap {
-        self.process_vm.heap()
+    /// Returns whether the virtual memory is shared with other processes.
+    pub fn is_vm_shared(&self) -> bool {
+        self.process_vm.lock().is_shared()
     }
 
-    pub fn init_stack_reader(&self) -> InitStackReader {
-        self.process_vm.init_stack_reader()
+    /// Switches to a new virtual memory.
+    ///
+    /// The current thread, which must belong to the process, switches to the
+    /// new virtual memory at once.
+    pub(crate) fn set_vm(&self, process_vm: Arc<ProcessVm>) {
+        let vm_space = process_vm.root_vmar().vm_space().clone();
+        process_vm.attach_process();
+        let old_process_vm = core::mem::replace(&mut *self.process_vm.lock(), process_vm);
+        old_process_vm.detach_process();
+        current_task()
+            .unwrap()
+            .user_space()
+            .unwrap()
+            .set_vm_space(vm_space);
     }
 
     // ************** File system ****************
 
-    pub fn file_table(&self) -> &Arc<Mutex<FileTable>> {
+    pub fn file_table(&self) -> &Arc<SharedFileTable> {
         &self.file_table
     }
 
@@ -614,6 +639,28 @@ impl Process {
         self.parent_death_signal.as_sig_num()
     }
 
+    // ******************* Vfork ********************
+
+    /// Marks that the parent process will be suspended until the process execs or exits.
+    pub(super) fn set_vfork_parent_waiting(&self) {
+        self.vfork_parent_waiting.store(true, Ordering::Release);
+    }
+
+    /// Returns whether the parent process is suspended by the process.
+    pub(super) fn is_vfork_parent_waiting(&self) -> bool {
+        self.vfork_parent_waiting.load(Ordering::Acquire)
+    }
+
+    /// Resumes the parent process if it is suspended until the process execs or exits.
+    pub fn release_vfork_parent(&self) {
+        if !self.vfork_parent_waiting.swap(false, Ordering::AcqRel) {
+            return;
+        }
+        if let Some(parent) = self.parent() {
+            parent.children_pauser().resume_all();
+        }
+    }
+
     // ******************* Status ********************
 
     fn set_runnable(&self) {
@@ -640,6 +687,12 @@ impl Process {
     }
 }
 
+impl Drop for Process {
+    fn drop(&mut self) {
+        self.process_vm.lock().detach_process();
+    }
+}
+
 pub fn current() -> Arc<Process> {
     let current_thread = Thread::current();
     if let Some(posix_thread) = current_thread.as_posix_thread() {
@@ -655,6 +708,7 @@ mod test {
     use ostd::prelude::*;
 
     use super::*;
+    use crate::fs::file_table::FileTable;
 
     fn new_process(parent: Option<Arc<Process>>) -> Arc<Process> {
         crate::util::random::init();
@@ -670,9 +724,9 @@ mod test {
             parent,
             vec![],
             String::new(),
-            ProcessVm::alloc(),
+            Arc::new(ProcessVm::alloc()),
             Arc::new(RwMutex::new(FsResolver::new())),
-            Arc::new(Mutex::new(FileTable::new())),
+            Arc::new(SharedFileTable::new(FileTable::new())),
             Arc::new(RwLock::new(FileCreationMask::default())),
             ResourceLimits::default(),
             Nice::default(),
@@ -6,56 +6,64 @@
 //! This table can be used to get process with pid.
 //! TODO: progress group, thread all need similar mapping
 
-use alloc::collections::btree_map::Values;
+use core::slice::Iter;
+
+use ostd::sync::{Rcu, RcuReclaimer};
 
 use super::{Pgid, Pid, Process, ProcessGroup, Session, Sid};
 use crate::{
     events::{Events, Observer, Subject},
     prelude::*,
+    thread::work_queue::{submit_work_func, WorkPriority},
 };
 
-static PROCESS_TABLE: Mutex<BTreeMap<Pid, Arc<Process>>> = Mutex::new(BTreeMap::new());
-static PROCESS_GROUP_TABLE: Mutex<BTreeMap<Pgid, Arc<ProcessGroup>>> = Mutex::new(BTreeMap::new());
+lazy_static! {
+    static ref PROCESS_TABLE: PidTable<Process> = PidTable::new();
+    static ref PROCESS_GROUP_TABLE: PidTable<ProcessGroup> = PidTable::new();
+    static ref SESSION_TABLE: PidTable<Session> = PidTable::new();
+}
 static PROCESS_TABLE_SUBJECT: Subject<PidEvent> = Subject::new();
-static SESSION_TABLE: Mutex<BTreeMap<Sid, Arc<Session>>> = Mutex::new(BTreeMap::new());
 
 // ************ Process *************
 
 /// Gets a process with pid
 pub fn get_process(pid: Pid) -> Option<Arc<Process>> {
-    PROCESS_TABLE.lock().get(&pid).cloned()
+    PROCESS_TABLE.get(pid)
 }
 
-pub(super) fn process_table_mut() -> MutexGuard<'static, BTreeMap<Pid, Arc<Process>>> {
+pub(super) fn process_table_mut() -> PidTableGuard<'static, Process> {
     PROCESS_TABLE.lock()
 }
 
-/// Acquires a lock on the process table and returns a `ProcessTable`.
-pub fn process_table() -> ProcessTable<'static> {
+/// Takes a snapshot of the process table and returns a `ProcessTable`.
+///
+/// The snapshot is taken without locking the table, so the processes that are
+/// created or reaped meanwhile may or may not be in the snapshot.
+pub fn process_table() -> ProcessTable {
     ProcessTable {
-        inner: PROCESS_TABLE.lock(),
+        inner: PROCESS_TABLE.snapshot(),
     }
 }
 
-/// A wrapper for the mutex-protected process table.
+/// A snapshot of the process table.
 ///
 /// It provides the `iter` method to iterator over the processes in the table.
-pub struct ProcessTable<'a> {
-    inner: MutexGuard<'a, BTreeMap<Pid, Arc<Process>>>,
+pub struct ProcessTable {
+    inner: Vec<Arc<Process>>,
 }
 
-impl<'a> ProcessTable<'a> {
-    /// Returns an iterator over the processes in the table.
+impl ProcessTable {
+    /// Returns an iterator over the processes in the table, in the order of their PIDs.
     pub fn iter(&self) -> ProcessTableIter {
         ProcessTableIter {
-            inner: self.inner.values(),
+            inner: self.inner.iter(),
         }
     }
 }
 
 /// An iterator over the processes of the process table.
 pub struct ProcessTableIter<'a> {
-    inner: Values<'a, Pid, Arc<Process>>,
+    inner: Iter<'a, Arc<Process>>,
 }
 
 impl<'a> Iterator for ProcessTableIter<'a> {
@@ -70,15 +78,15 @@ impl<'a> Iterator for ProcessTableIter<'a> {
 
 /// Gets a process group with `pgid`
 pub fn get_process_group(pgid: &Pgid) -> Option<Arc<ProcessGroup>> {
-    PROCESS_GROUP_TABLE.lock().get(pgid).cloned()
+    PROCESS_GROUP_TABLE.get(*pgid)
 }
 
 /// Returns whether process table contains process group with pgid
 pub fn contain_process_group(pgid: &Pgid) -> bool {
-    PROCESS_GROUP_TABLE.lock().contains_key(pgid)
+    PROCESS_GROUP_TABLE.contains_key(*pgid)
 }
 
-pub(super) fn group_table_mut() -> MutexGuard<'static, BTreeMap<Pgid, Arc<ProcessGroup>>> {
+pub(super) fn group_table_mut() -> PidTableGuard<'static, ProcessGroup> {
     PROCESS_GROUP_TABLE.lock()
 }
 
@@ -86,13 +94,145 @@ pub(super) fn group_table_mut() -> MutexGuard<'static, BTreeMap<Pgid, Arc<Proces
 
 /// Gets a session with `sid`.
 pub fn get_session(sid: &Sid) -> Option<Arc<Session>> {
-    SESSION_TABLE.lock().get(sid).map(Arc::clone)
+    SESSION_TABLE.get(*sid)
 }
 
-pub(super) fn session_table_mut() -> MutexGuard<'static, BTreeMap<Sid, Arc<Session>>> {
+pub(super) fn session_table_mut() -> PidTableGuard<'static, Session> {
     SESSION_TABLE.lock()
 }
 
+// ************ PID table *************
+
+/// A hash table of the objects indexed by their IDs, e.g., PIDs, PGIDs or SIDs.
+///
+/// Lookups neither lock nor allocate, since each bucket is published with RCU.
+/// The updates are serialized by the lock of the table, which is held by a
+/// [`PidTableGuard`], so that the updates of different tables can be made atomic
+/// by holding their guards together.
+///
+/// Since the IDs are allocated sequentially, the objects are evenly distributed
+/// in the buckets, and a bucket only contains a few objects unless there are more
+/// than tens of thousands of objects.
+pub(super) struct PidTable<T> {
+    buckets: Box<[Rcu<Box<Bucket<T>>>]>,
+    lock: Mutex<()>,
+}
+
+type Bucket<T> = Vec<(u32, Arc<T>)>;
+
+const NR_BUCKETS: usize = 1 << 10;
+
+impl<T: Send + Sync + 'static> PidTable<T> {
+    fn new() -> Self {
+        let buckets = (0..NR_BUCKETS)
+            .map(|_| Rcu::new(Box::new(Vec::new())))
+            .collect();
+        Self {
+            buckets,
+            lock: Mutex::new(()),
+        }
+    }
+
+    /// Gets the object with the ID.
+    fn get(&self, id: u32) -> Option<Arc<T>> {
+        let bucket = self.bucket(id).read();
+        bucket
+            .iter()
+            .find(|(key, _)| *key == id)
+            .map(|(_, value)| value.clone())
+    }
+
+    /// Returns whether the table contains the object with the ID.
+    fn contains_key(&self, id: u32) -> bool {
+        let bucket = self.bucket(id).read();
+        bucket.iter().any(|(key, _)| *key == id)
+    }
+
+    /// Collects all the objects in the table, in the order of their IDs.
+    fn snapshot(&self) -> Vec<Arc<T>> {
+        let mut entries = Vec::new();
+        for bucket in self.buckets.iter() {
+            entries.extend(bucket.read().iter().cloned());
+        }
+        entries.sort_unstable_by_key(|(key, _)| *key);
+        entries.into_iter().map(|(_, value)| value).collect()
+    }
+
+    /// Locks the table for updates.
+    fn lock(&self) -> PidTableGuard<'_, T> {
+        PidTableGuard {
+            table: self,
+            _guard: self.lock.lock(),
+        }
+    }
+
+    fn bucket(&self, id: u32) -> &Rcu<Box<Bucket<T>>> {
+        &self.buckets[id as usize % NR_BUCKETS]
+    }
+}
+
+/// A guard that holds the lock of a [`PidTable`] for updates.
+///
+/// The old buckets replaced in the table are dropped after a grace period without
+/// waiting for it, so the updates never block on RCU.
+pub(super) struct PidTableGuard<'a, T: Send + Sync + 'static> {
+    table: &'a PidTable<T>,
+    _guard: MutexGuard<'a, ()>,
+}
+
+impl<'a, T: Send + Sync + 'static> PidTableGuard<'a, T> {
+    /// Inserts the object with the ID, replacing the old one with the same ID.
+    pub(super) fn insert(&mut self, id: u32, value: Arc<T>) {
+        let rcu = self.table.bucket(id);
+        let mut bucket = Vec::clone(&rcu.read());
+        if let Some(entry) = bucket.iter_mut().find(|(key, _)| *key == id) {
+            entry.1 = value;
+        } else {
+            bucket.push((id, value));
+        }
+
+        reclaim_bucket(rcu.replace(Box::new(bucket)));
+    }
+
+    /// Removes the object with the ID, returning it if it is in the table.
+    pub(super) fn remove(&mut self, id: &u32) -> Option<Arc<T>> {
+        let rcu = self.table.bucket(*id);
+        let mut bucket = Vec::clone(&rcu.read());
+        let pos = bucket.iter().position(|(key, _)| key == id)?;
+        let (_, removed) = bucket.swap_remove(pos);
+
+        reclaim_bucket(rcu.replace(Box::new(bucket)));
+        Some(removed)
+    }
+
+    /// Returns whether the table contains the object with the ID.
+    pub(super) fn contains_key(&self, id: &u32) -> bool {
+        self.table.contains_key(*id)
+    }
+}
+
+/// Drops an old bucket after a grace period without waiting for it.
+///
+/// Even if no object is removed by an update, the old bucket may hold the last
+/// reference to an object that is removed from the new bucket before the grace period
+/// ends. Dropping the last reference to a process, group or session may sleep, so such
+/// objects are handed to a worker, instead of being dropped in the RCU softirq.
+fn reclaim_bucket<T: Send + Sync + 'static>(reclaimer: RcuReclaimer<Box<Bucket<T>>>) {
+    reclaimer.delay_with(|old_bucket| {
+        let removed_objects: Vec<T> = (*old_bucket)
+            .into_iter()
+            .filter_map(|(_, value)| Arc::into_inner(value))
+            .collect();
+        if !removed_objects.is_empty() {
+            let removed_objects = SpinLock::new(Some(removed_objects));
+            submit_work_func(
+                move || drop(removed_objects.lock().take()),
+                WorkPriority::Normal,
+            );
+        }
+    });
+}
+
 // ************ Observer *************
 
 /// Registers an observer which watches `PidEvent`.
@@ -111,3 +251,33 @@ pub enum PidEvent {
 }
 
 impl Events for PidEvent {}
+
+#[cfg(ktest)]
+mod test {
+    use ostd::prelude::*;
+
+    use super::*;
+
+    #[ktest]
+    fn pid_table_insert_and_remove() {
+        let table = PidTable::new();
+        {
+            let mut table_mut = table.lock();
+            // The IDs fall into the same bucket.
+            table_mut.insert(1 + NR_BUCKETS as u32, Arc::new(2));
+            table_mut.insert(1, Arc::new(1));
+            table_mut.insert(2, Arc::new(3));
+        }
+        assert_eq!(table.get(1).as_deref(), Some(&1));
+        assert_eq!(
+            table.snapshot().iter().map(|v| **v).collect::<Vec<i32>>(),
+            [1, 3, 2]
+        );
+
+        let removed = table.lock().remove(&1);
+        assert_eq!(removed.as_deref(), Some(&1));
+        assert!(!table.contains_key(1));
+        assert!(table.contains_key(1 + NR_BUCKETS as u32));
+        assert!(table.lock().remove(&1).is_none());
+    }
+}
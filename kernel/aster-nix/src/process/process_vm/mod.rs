@@ -12,6 +12,8 @@
 mod heap;
 mod init_stack;
 
+use core::sync::atomic::{AtomicUsize, Ordering};
+
 use aster_rights::Full;
 pub use heap::Heap;
 
@@ -66,6 +68,9 @@ pub struct ProcessVm {
     root_vmar: Vmar<Full>,
     init_stack: InitStack,
     heap: Heap,
+    /// The number of processes that use the VM, which is more than one if the VM
+    /// is shared with `CLONE_VM`.
+    nr_processes: AtomicUsize,
 }
 
 impl Clone for ProcessVm {
@@ -74,6 +79,7 @@ impl Clone for ProcessVm {
             root_vmar: self.root_vmar.dup().unwrap(),
             init_stack: self.init_stack.clone(),
             heap: self.heap.clone(),
+            nr_processes: AtomicUsize::new(0),
         }
     }
 }
@@ -90,6 +96,7 @@ impl ProcessVm {
             root_vmar,
             heap,
             init_stack,
+            nr_processes: AtomicUsize::new(0),
         }
     }
 
@@ -102,6 +109,7 @@ impl ProcessVm {
             root_vmar,
             heap: other.heap.clone(),
             init_stack: other.init_stack.clone(),
+            nr_processes: AtomicUsize::new(0),
         })
     }
 
@@ -109,6 +117,24 @@ impl ProcessVm {
         &self.root_vmar
     }
 
+    /// Returns whether the VM is used by more than one process.
+    ///
+    /// Unlike the references to the VM, which may be held temporarily, e.g., to
+    /// access the memory of another process, only the processes are counted.
+    pub fn is_shared(&self) -> bool {
+        self.nr_processes.load(Ordering::Acquire) > 1
+    }
+
+    /// Records that a process starts to use the VM.
+    pub(super) fn attach_process(&self) {
+        self.nr_processes.fetch_add(1, Ordering::AcqRel);
+    }
+
+    /// Records that a process stops using the VM.
+    pub(super) fn detach_process(&self) {
+        self.nr_processes.fetch_sub(1, Ordering::AcqRel);
+    }
+
     /// Returns a reader for reading contents from
     /// the `InitStack`.
     pub fn init_stack_reader(&self) -> InitStackReader {
@@ -124,7 +150,7 @@ impl ProcessVm {
         self.init_stack.writer(&self.root_vmar, argv, envp, aux_vec)
     }
 
-    pub(super) fn heap(&self) -> &Heap {
+    pub fn heap(&self) -> &Heap {
         &self.heap
     }
 
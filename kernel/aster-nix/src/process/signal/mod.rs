@@ -20,6 +20,7 @@ use c_types::{siginfo_t, ucontext_t};
 pub use events::{SigEvents, SigEventsFilter};
 use ostd::{cpu::UserContext, user::UserContextApi};
 pub use pauser::Pauser;
+pub(super) use pauser::SigQueueObserver;
 pub use poll::{Pollee, Poller};
 use sig_action::{SigAction, SigActionFlags, SigDefaultAction};
 use sig_mask::SigMask;
@@ -48,6 +49,9 @@ pub fn handle_pending_signal(
 ) -> Result<()> {
     // We first deal with signal in current thread, then signal in current process.
     let posix_thread = current_thread.as_posix_thread().unwrap();
+    if !posix_thread.has_queued_signals() {
+        return Ok(());
+    }
     let signal = {
         let sig_mask = *posix_thread.sig_mask().lock();
         if let Some(signal) = posix_thread.dequeue_signal(&sig_mask) {
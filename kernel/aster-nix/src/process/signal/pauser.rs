@@ -135,10 +135,12 @@ impl Pauser {
             (old_mask, SigEventsFilter::new(new_mask))
         };
 
-        // Register observer on sigqueue
-        let observer = SigQueueObserver::new(self.clone());
-        let weak_observer = Arc::downgrade(&observer) as Weak<dyn Observer<SigEvents>>;
-        posix_thread.register_sigqueue_observer(weak_observer.clone(), filter);
+        // Register the observer of the thread on sigqueue. Registering it again only
+        // updates the filter, so pausing does not allocate.
+        let observer = posix_thread.sig_queue_observer();
+        observer.start_pause(self.clone());
+        let weak_observer = Arc::downgrade(observer) as Weak<dyn Observer<SigEvents>>;
+        posix_thread.register_sigqueue_observer(weak_observer, filter);
 
         // Some signal may come before we register observer, so we do another check here.
         if posix_thread.has_pending() {
@@ -150,19 +152,16 @@ impl Pauser {
             Interrupted,
         }
 
-        let cond = {
-            let cloned_observer = observer.clone();
-            move || {
-                if let Some(res) = cond() {
-                    return Some(Res::Ok(res));
-                }
-
-                if cloned_observer.is_interrupted() {
-                    return Some(Res::Interrupted);
-                }
+        let cond = || {
+            if let Some(res) = cond() {
+                return Some(Res::Ok(res));
+            }
 
-                None
+            if observer.is_interrupted() {
+                return Some(Res::Interrupted);
             }
+
+            None
         };
 
         let res = if let Some(timeout) = timeout {
@@ -173,8 +172,8 @@ impl Pauser {
             Ok(self.wait_queue.wait_until(cond))
         };
 
-        // Restore the state
-        posix_thread.unregiser_sigqueue_observer(&weak_observer);
+        // Restore the state. The observer is kept registered for the next pause.
+        observer.end_pause();
         posix_thread.sig_mask().lock().set(old_mask.as_u64());
 
         match res? {
@@ -194,19 +193,34 @@ impl Pauser {
     }
 }
 
-struct SigQueueObserver {
+/// The observer that interrupts the pauses of a thread when signals arrive.
+///
+/// Each thread has its own observer, which is reused by all the pauses of the
+/// thread. The observer ignores the signals while the thread is not paused.
+pub struct SigQueueObserver {
     is_interrupted: AtomicBool,
-    pauser: Arc<Pauser>,
+    /// The pauser that the thread is paused on.
+    pauser: SpinLock<Option<Arc<Pauser>>>,
 }
 
 impl SigQueueObserver {
-    fn new(pauser: Arc<Pauser>) -> Arc<Self> {
+    pub(in crate::process) fn new() -> Arc<Self> {
         Arc::new(Self {
             is_interrupted: AtomicBool::new(false),
-            pauser,
+            pauser: SpinLock::new(None),
         })
     }
 
+    fn start_pause(&self, pauser: Arc<Pauser>) {
+        let mut current_pauser = self.pauser.lock();
+        self.is_interrupted.store(false, Ordering::Relaxed);
+        *current_pauser = Some(pauser);
+    }
+
+    fn end_pause(&self) {
+        self.pauser.lock().take();
+    }
+
     fn is_interrupted(&self) -> bool {
         self.is_interrupted.load(Ordering::Acquire)
     }
@@ -218,7 +232,10 @@ impl SigQueueObserver {
 
 impl Observer<SigEvents> for SigQueueObserver {
     fn on_events(&self, _: &SigEvents) {
-        self.set_interrupted();
-        self.pauser.wait_queue.wake_all();
+        let pauser = self.pauser.lock();
+        if let Some(pauser) = pauser.as_ref() {
+            self.set_interrupted();
+            pauser.wait_queue.wake_all();
+        }
     }
 }
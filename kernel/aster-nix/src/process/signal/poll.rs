@@ -64,11 +64,24 @@ impl Pollee {
     }
 
     fn register_poller(&self, poller: &Poller, mask: IoEvents) {
+        let round = poller.inner.round.load(Ordering::Relaxed);
+        let mut pollees = poller.inner.pollees.lock();
+        let entry = pollees
+            .entry(Arc::downgrade(&self.inner).into())
+            .or_insert(PolleeEntry {
+                mask: IoEvents::empty(),
+                round,
+            });
+        entry.round = round;
+
+        // Skip the registration if the poller has been registered with the events.
+        if entry.mask.contains(mask) {
+            return;
+        }
+        entry.mask |= mask;
         self.inner
             .subject
-            .register_observer(poller.observer(), mask);
-        let mut pollees = poller.inner.pollees.lock();
-        pollees.insert(Arc::downgrade(&self.inner).into(), ());
+            .register_observer(poller.observer(), entry.mask);
     }
 
     /// Register an IoEvents observer.
@@ -142,7 +155,17 @@ struct PollerInner {
     // Use event counter to wait or wake up a poller
     event_counter: EventCounter,
     // All pollees that are interesting to this poller
-    pollees: Mutex<BTreeMap<KeyableWeak<PolleeInner>, ()>>,
+    pollees: Mutex<BTreeMap<KeyableWeak<PolleeInner>, PolleeEntry>>,
+    // The current round of polling, see `Poller::start_round`
+    round: AtomicU32,
+}
+
+/// The registration of a poller on a pollee.
+struct PolleeEntry {
+    // The events that the poller is registered with
+    mask: IoEvents,
+    // The last round in which the pollee is polled
+    round: u32,
 }
 
 impl Default for Poller {
@@ -157,6 +180,7 @@ impl Poller {
         let inner = PollerInner {
             event_counter: EventCounter::new(),
             pollees: Mutex::new(BTreeMap::new()),
+            round: AtomicU32::new(0),
         };
         Self {
             inner: Arc::new(inner),
@@ -177,6 +201,37 @@ impl Poller {
         Ok(())
     }
 
+    /// Starts a new round of polling.
+    ///
+    /// A poller is not unregistered from its pollees until it is dropped, so it can
+    /// be reused to poll the same pollees repeatedly without registering again. A
+    /// round is started before each time that the pollees are polled, which discards
+    /// the events happened before so that the wait of this round is not woken up by
+    /// them. Since the pollees are polled after starting the round, no events are
+    /// missed.
+    pub fn start_round(&self) {
+        self.inner.round.fetch_add(1, Ordering::Relaxed);
+        self.inner.event_counter.reset();
+    }
+
+    /// Unregisters the poller from the pollees that are not polled in the current round.
+    ///
+    /// This prevents the pollees that are no longer interested from waking up the poller.
+    pub fn unregister_stale(&self) {
+        let round = self.inner.round.load(Ordering::Relaxed);
+        let mut pollees = self.inner.pollees.lock();
+        if pollees.values().all(|entry| entry.round == round) {
+            return;
+        }
+
+        let self_observer = self.observer();
+        for (weak_pollee, _) in pollees.extract_if(|_, entry| entry.round != round) {
+            if let Some(pollee) = weak_pollee.upgrade() {
+                pollee.subject.unregister_observer(&self_observer);
+            }
+        }
+    }
+
     fn observer(&self) -> Weak<dyn Observer<IoEvents>> {
         Arc::downgrade(&self.inner) as _
     }
@@ -238,7 +293,13 @@ impl EventCounter {
     }
 
     pub fn write(&self) {
-        self.counter.fetch_add(1, Ordering::Relaxed);
+        self.counter.fetch_add(1, Ordering::Release);
         self.pauser.resume_one();
     }
+
+    pub fn reset(&self) {
+        // This synchronizes with `write`, so the events that are discarded here will
+        // be visible when the pollees are polled later.
+        self.counter.swap(0, Ordering::Acquire);
+    }
 }
@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: MPL-2.0
+
+use core::{
+    sync::atomic::{AtomicU32, AtomicU64, Ordering},
+    time::Duration,
+};
+
+use super::nice::NICE_0_WEIGHT;
+
+/// The scheduling state of a thread for the fair scheduling class,
+/// along with the runtime statistics of the thread.
+///
+/// The fields are atomics, since a thread may be enqueued or switched out
+/// on one CPU while its statistics are read from another one.
+/// All timestamps and durations are in nanoseconds.
+pub struct SchedEntity {
+    /// The virtual runtime, i.e., the actual runtime scaled by `NICE_0_WEIGHT / weight`.
+    vruntime: AtomicU64,
+    /// The load weight derived from the nice value of the thread.
+    weight: AtomicU32,
+    /// The time when the thread was last enqueued or last started running.
+    last_timestamp: AtomicU64,
+    /// The total time that the thread has been running on a CPU.
+    sum_exec_runtime: AtomicU64,
+    /// The total time that the thread has been waiting in a run queue.
+    sum_wait_time: AtomicU64,
+    /// The number of times that the thread has been picked to run.
+    nr_timeslices: AtomicU64,
+    /// The number of times that the thread gave up its CPU because it went to sleep.
+    nr_voluntary_switches: AtomicU64,
+    /// The number of times that the thread gave up its CPU while still being runnable.
+    nr_involuntary_switches: AtomicU64,
+}
+
+impl SchedEntity {
+    pub const fn new() -> Self {
+        Self {
+            vruntime: AtomicU64::new(0),
+            weight: AtomicU32::new(NICE_0_WEIGHT),
+            last_timestamp: AtomicU64::new(0),
+            sum_exec_runtime: AtomicU64::new(0),
+            sum_wait_time: AtomicU64::new(0),
+            nr_timeslices: AtomicU64::new(0),
+            nr_voluntary_switches: AtomicU64::new(0),
+            nr_involuntary_switches: AtomicU64::new(0),
+        }
+    }
+
+    /// Returns the virtual runtime.
+    pub fn vruntime(&self) -> u64 {
+        self.vruntime.load(Ordering::Relaxed)
+    }
+
+    pub(super) fn set_vruntime(&self, vruntime: u64) {
+        self.vruntime.store(vruntime, Ordering::Relaxed);
+    }
+
+    /// Returns the virtual runtime that the thread would have if it were switched out at `now`.
+    ///
+    /// The thread must be running.
+    pub(super) fn running_vruntime(&self, now: u64) -> u64 {
+        let delta = now.saturating_sub(self.last_timestamp.load(Ordering::Relaxed));
+        self.vruntime() + self.scale_delta(delta)
+    }
+
+    /// Returns the load weight.
+    pub fn weight(&self) -> u32 {
+        self.weight.load(Ordering::Relaxed)
+    }
+
+    pub(super) fn set_weight(&self, weight: u32) {
+        self.weight.store(weight, Ordering::Relaxed);
+    }
+
+    /// Records that the thread is put into a run queue at `now`.
+    pub(super) fn on_enqueue(&self, now: u64) {
+        self.last_timestamp.store(now, Ordering::Relaxed);
+    }
+
+    /// Records that the thread is picked to run at `now`.
+    pub(super) fn on_pick(&self, now: u64) {
+        let wait_time = now.saturating_sub(self.last_timestamp.swap(now, Ordering::Relaxed));
+        self.sum_wait_time.fetch_add(wait_time, Ordering::Relaxed);
+        self.nr_timeslices.fetch_add(1, Ordering::Relaxed);
+    }
+
+    /// Records that the thread is switched out at `now`.
+    ///
+    /// `is_preempted` tells whether the thread is still runnable.
+    pub(super) fn on_switch_out(&self, now: u64, is_preempted: bool) {
+        let delta = now.saturating_sub(self.last_timestamp.load(Ordering::Relaxed));
+        self.sum_exec_runtime.fetch_add(delta, Ordering::Relaxed);
+        self.vruntime
+            .fetch_add(self.scale_delta(delta), Ordering::Relaxed);
+
+        if is_preempted {
+            self.nr_involuntary_switches.fetch_add(1, Ordering::Relaxed);
+        } else {
+            self.nr_voluntary_switches.fetch_add(1, Ordering::Relaxed);
+        }
+    }
+
+    /// Converts a duration of actual runtime to a duration of virtual runtime.
+    fn scale_delta(&self, delta: u64) -> u64 {
+        let weight = self.weight() as u128;
+        (delta as u128 * NICE_0_WEIGHT as u128 / weight) as u64
+    }
+
+    /// Returns the total time that the thread has been running on a CPU.
+    pub fn sum_exec_runtime(&self) -> Duration {
+        Duration::from_nanos(self.sum_exec_runtime.load(Ordering::Relaxed))
+    }
+
+    /// Returns the total time that the thread has been waiting in a run queue.
+    pub fn sum_wait_time(&self) -> Duration {
+        Duration::from_nanos(self.sum_wait_time.load(Ordering::Relaxed))
+    }
+
+    /// Returns the number of times that the thread has been picked to run.
+    pub fn nr_timeslices(&self) -> u64 {
+        self.nr_timeslices.load(Ordering::Relaxed)
+    }
+
+    /// Returns the number of voluntary context switches.
+    pub fn nr_voluntary_switches(&self) -> u64 {
+        self.nr_voluntary_switches.load(Ordering::Relaxed)
+    }
+
+    /// Returns the number of involuntary context switches.
+    pub fn nr_involuntary_switches(&self) -> u64 {
+        self.nr_involuntary_switches.load(Ordering::Relaxed)
+    }
+}
+
+impl Default for SchedEntity {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// Returns the current time of the scheduler clock in nanoseconds.
+///
+/// The scheduler clock is read in the context switch path, so it directly reads
+/// the TSC instead of going through the clock sources of the time component.
+pub(crate) fn sched_clock() -> u64 {
+    let freq = ostd::arch::tsc_freq();
+    if freq == 0 {
+        return 0;
+    }
+    (ostd::arch::read_tsc() as u128 * 1_000_000_000 / freq as u128) as u64
+}
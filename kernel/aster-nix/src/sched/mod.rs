@@ -1,8 +1,10 @@
 // SPDX-License-Identifier: MPL-2.0
 
+mod entity;
 pub mod nice;
 mod priority_scheduler;
 
 // There may be multiple scheduling policies in the system,
 // and subsequent schedulers can be placed under this module.
-pub use self::priority_scheduler::init;
+pub(crate) use self::entity::sched_clock;
+pub use self::{entity::SchedEntity, priority_scheduler::init};
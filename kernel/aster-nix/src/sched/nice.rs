@@ -39,8 +39,34 @@ impl Nice {
     pub fn to_raw(self) -> i8 {
         self.value
     }
+
+    /// Returns the load weight of the nice value.
+    ///
+    /// Under fair scheduling, the share of CPU time that a task receives is
+    /// proportional to its weight. The weights are the same as those of Linux:
+    /// the weight of two adjacent nice levels differs by a factor of about 1.25,
+    /// so that a task gets about 10% more CPU time than a task one nice level above it.
+    pub fn weight(self) -> u32 {
+        NICE_TO_WEIGHT[(self.value - Self::MIN.value) as usize]
+    }
 }
 
+/// The load weight of the default nice value, 0.
+pub const NICE_0_WEIGHT: u32 = 1024;
+
+/// The load weights of the nice values from -20 to 19.
+#[rustfmt::skip]
+const NICE_TO_WEIGHT: [u32; 40] = [
+    /* -20 */ 88761, 71755, 56483, 46273, 36291,
+    /* -15 */ 29154, 23254, 18705, 14949, 11916,
+    /* -10 */ 9548, 7620, 6100, 4904, 3906,
+    /*  -5 */ 3121, 2501, 1991, 1586, 1277,
+    /*   0 */ 1024, 820, 655, 526, 423,
+    /*   5 */ 335, 272, 215, 172, 137,
+    /*  10 */ 110, 87, 70, 56, 45,
+    /*  15 */ 36, 29, 23, 18, 15,
+];
+
 #[allow(clippy::derivable_impls)]
 impl Default for Nice {
     fn default() -> Self {
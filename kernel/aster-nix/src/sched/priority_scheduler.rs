@@ -1,56 +1,354 @@
 // SPDX-License-Identifier: MPL-2.0
 
+use core::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
+
 use intrusive_collections::LinkedList;
-use ostd::task::{set_scheduler, Scheduler, Task, TaskAdapter};
+use ostd::{
+    cpu::{num_cpus, this_cpu},
+    task::{set_scheduler, Scheduler, Task, TaskAdapter, TaskStatus},
+};
 
-use crate::prelude::*;
+use super::entity::sched_clock;
+use crate::{
+    perf,
+    prelude::*,
+    process::posix_thread::PosixThreadExt,
+    sched::nice::{Nice, NICE_0_WEIGHT},
+    thread::Thread,
+};
 
 pub fn init() {
-    let preempt_scheduler = Box::new(PreemptScheduler::new());
+    let preempt_scheduler = Box::new(PreemptScheduler::new(num_cpus() as usize));
     let scheduler = Box::<PreemptScheduler>::leak(preempt_scheduler);
     set_scheduler(scheduler);
 }
 
+/// The maximum credit in virtual runtime (ns) that a waking task gets
+/// relative to the tasks that kept running.
+///
+/// The credit lets interactive tasks that sleep often run soon after they wake up,
+/// while still bounding how long they can delay the other tasks.
+const SLEEPER_CREDIT: u64 = 3_000_000;
+
+/// The minimum lead in virtual runtime (ns) that the running task must have
+/// over a queued task before it is preempted by that task.
+///
+/// This avoids over-scheduling tasks whose virtual runtimes are close to each other.
+const PREEMPT_GRANULARITY: u64 = 1_000_000;
+
 /// The preempt scheduler
 ///
-/// Real-time tasks are placed in the `real_time_tasks` queue and
+/// Each CPU owns a run queue. A task is enqueued to the run queue of the current CPU
+/// if its CPU affinity allows, or to the first CPU in its affinity mask otherwise.
+/// A CPU whose run queue is empty steals a task from the other run queues before
+/// going idle, so that the load is balanced without a global lock.
+///
+/// Within a run queue, real-time tasks are placed in the `real_time_tasks` queue and
 /// are always prioritized during scheduling.
 /// Normal tasks are placed in the `normal_tasks` queue and are only
 /// scheduled for execution when there are no real-time tasks.
+///
+/// Normal tasks are scheduled fairly according to their nice values. Each normal
+/// task accumulates virtual runtime at a rate inversely proportional to the weight
+/// of its nice value, and the task with the smallest virtual runtime runs next.
 struct PreemptScheduler {
-    /// Tasks with a priority of less than 100 are regarded as real-time tasks.
-    real_time_tasks: SpinLock<LinkedList<TaskAdapter>>,
-    /// Tasks with a priority greater than or equal to 100 are regarded as normal tasks.
-    normal_tasks: SpinLock<LinkedList<TaskAdapter>>,
+    /// The per-CPU run queues, indexed by CPU ID.
+    run_queues: Vec<PreemptRunQueue>,
 }
 
 impl PreemptScheduler {
-    pub fn new() -> Self {
-        Self {
-            real_time_tasks: SpinLock::new(LinkedList::new(TaskAdapter::new())),
-            normal_tasks: SpinLock::new(LinkedList::new(TaskAdapter::new())),
+    pub fn new(num_cpus: usize) -> Self {
+        let run_queues = (0..num_cpus).map(|_| PreemptRunQueue::new()).collect();
+        Self { run_queues }
+    }
+
+    /// Selects the CPU whose run queue the task should be put into.
+    fn select_cpu(&self, task: &Task) -> usize {
+        let cur_cpu = this_cpu();
+        let cpu_affinity = task.cpu_affinity();
+        if cpu_affinity.contains(cur_cpu) {
+            return cur_cpu as usize;
         }
+        cpu_affinity
+            .iter()
+            .find(|cpu| *cpu < self.run_queues.len())
+            .unwrap_or(cur_cpu as usize)
+    }
+
+    /// Steals a task that is allowed to run on `cpu` from the run queues of the other CPUs.
+    ///
+    /// Run queues that look empty are skipped without being locked.
+    /// Run queues that are locked by others are skipped, too,
+    /// since the contention suggests that their owners are busy scheduling.
+    fn steal(&self, cpu: usize) -> Option<Arc<Task>> {
+        let num_queues = self.run_queues.len();
+        let local = &self.run_queues[cpu];
+        (1..num_queues)
+            .map(|offset| &self.run_queues[(cpu + offset) % num_queues])
+            .filter(|victim| victim.len() > 0)
+            .find_map(|victim| {
+                let task = victim.try_steal(cpu as u32)?;
+                // Keep the lead or lag of the task relative to the other tasks
+                // when it moves to a run queue with a different virtual clock.
+                if let Some(thread) = thread_of(&task) {
+                    let entity = thread.sched_entity();
+                    let vruntime = entity.vruntime().saturating_sub(victim.min_vruntime())
+                        + local.min_vruntime();
+                    entity.set_vruntime(vruntime);
+                }
+                Some(task)
+            })
     }
 }
 
 impl Scheduler for PreemptScheduler {
     fn enqueue(&self, task: Arc<Task>) {
+        let cpu = self.select_cpu(&task);
+        self.run_queues[cpu].push(task);
+    }
+
+    fn dequeue(&self) -> Option<Arc<Task>> {
+        let cpu = this_cpu() as usize;
+        let task = self.run_queues[cpu].pop().or_else(|| self.steal(cpu))?;
+        if let Some(thread) = thread_of(&task) {
+            thread.sched_entity().on_pick(sched_clock());
+        }
+        Some(task)
+    }
+
+    fn should_preempt(&self, task: &Arc<Task>) -> bool {
         if task.is_real_time() {
-            self.real_time_tasks.lock_irq_disabled().push_back(task);
-        } else {
-            self.normal_tasks.lock_irq_disabled().push_back(task);
+            return false;
+        }
+
+        let run_queue = &self.run_queues[this_cpu() as usize];
+        if run_queue.num_real_time() > 0 {
+            return true;
+        }
+        if run_queue.num_normal() == 0 {
+            return false;
         }
+
+        let Some(thread) = thread_of(task) else {
+            return false;
+        };
+        let vruntime = thread.sched_entity().running_vruntime(sched_clock());
+        vruntime > run_queue.leftmost_vruntime() + PREEMPT_GRANULARITY
     }
 
-    fn dequeue(&self) -> Option<Arc<Task>> {
-        if !self.real_time_tasks.lock_irq_disabled().is_empty() {
-            self.real_time_tasks.lock_irq_disabled().pop_front()
+    fn on_switch_out(&self, task: &Arc<Task>) {
+        if let Some(thread) = thread_of(task) {
+            let is_preempted = task.status() == TaskStatus::Runnable;
+            thread
+                .sched_entity()
+                .on_switch_out(sched_clock(), is_preempted);
+            thread.perf_events().sched_out();
+        }
+    }
+
+    fn on_switch_in(&self, task: &Arc<Task>) {
+        perf::sync_deferred_events();
+        if let Some(thread) = thread_of(task) {
+            thread.perf_events().sched_in();
+        }
+    }
+}
+
+/// Returns the thread that the task belongs to.
+///
+/// Tasks that are created directly with `TaskOptions` do not belong to any thread.
+/// Such tasks are scheduled with the default nice value and without accounting.
+fn thread_of(task: &Task) -> Option<Arc<Thread>> {
+    task.data().downcast_ref::<Weak<Thread>>()?.upgrade()
+}
+
+/// Returns the load weight of the thread according to the nice value of its process.
+fn weight_of(thread: &Thread) -> u32 {
+    thread
+        .as_posix_thread()
+        .and_then(|posix_thread| posix_thread.weak_process().upgrade())
+        .map(|process| process.nice().load(Ordering::Relaxed))
+        .map_or(NICE_0_WEIGHT, Nice::weight)
+}
+
+/// The run queue of a single CPU.
+///
+/// The lengths of the queues, as well as the virtual clock of the fair queue,
+/// are mirrored in atomics so that `should_preempt` and work stealing can peek
+/// at a run queue without locking it.
+struct PreemptRunQueue {
+    lists: SpinLock<RunQueueLists>,
+    num_real_time: AtomicUsize,
+    num_normal: AtomicUsize,
+    /// The monotonically increasing virtual clock of the fair queue.
+    min_vruntime: AtomicU64,
+    /// The smallest virtual runtime among the queued normal tasks.
+    leftmost_vruntime: AtomicU64,
+}
+
+struct RunQueueLists {
+    /// Tasks with a priority of less than 100 are regarded as real-time tasks.
+    real_time_tasks: LinkedList<TaskAdapter>,
+    /// Tasks with a priority greater than or equal to 100 are regarded as normal tasks.
+    normal_tasks: FairQueue,
+}
+
+impl PreemptRunQueue {
+    fn new() -> Self {
+        Self {
+            lists: SpinLock::new(RunQueueLists {
+                real_time_tasks: LinkedList::new(TaskAdapter::new()),
+                normal_tasks: FairQueue::new(),
+            }),
+            num_real_time: AtomicUsize::new(0),
+            num_normal: AtomicUsize::new(0),
+            min_vruntime: AtomicU64::new(0),
+            leftmost_vruntime: AtomicU64::new(u64::MAX),
+        }
+    }
+
+    fn push(&self, task: Arc<Task>) {
+        if task.is_real_time() {
+            let mut lists = self.lists.lock_irq_disabled();
+            lists.real_time_tasks.push_back(task);
+            self.num_real_time.fetch_add(1, Ordering::Relaxed);
+            return;
+        }
+
+        let thread = thread_of(&task);
+        let vruntime = if let Some(thread) = &thread {
+            let entity = thread.sched_entity();
+            entity.set_weight(weight_of(thread));
+            entity.on_enqueue(sched_clock());
+            entity.vruntime()
         } else {
-            self.normal_tasks.lock_irq_disabled().pop_front()
+            0
+        };
+
+        let mut lists = self.lists.lock_irq_disabled();
+        // A task that has slept for a long time must not monopolize the CPU
+        // with the virtual runtime that it has saved up.
+        let vruntime = vruntime.max(self.min_vruntime().saturating_sub(SLEEPER_CREDIT));
+        if let Some(thread) = &thread {
+            thread.sched_entity().set_vruntime(vruntime);
         }
+        lists.normal_tasks.push(vruntime, task);
+        self.num_normal.fetch_add(1, Ordering::Relaxed);
+        self.update_leftmost(&lists.normal_tasks);
     }
 
-    fn should_preempt(&self, task: &Arc<Task>) -> bool {
-        !task.is_real_time() && !self.real_time_tasks.lock_irq_disabled().is_empty()
+    fn pop(&self) -> Option<Arc<Task>> {
+        if self.len() == 0 {
+            return None;
+        }
+
+        let mut lists = self.lists.lock_irq_disabled();
+        if let Some(task) = lists.real_time_tasks.pop_front() {
+            self.num_real_time.fetch_sub(1, Ordering::Relaxed);
+            return Some(task);
+        }
+        let (vruntime, task) = lists.normal_tasks.pop_leftmost()?;
+        self.num_normal.fetch_sub(1, Ordering::Relaxed);
+        self.min_vruntime.fetch_max(vruntime, Ordering::Relaxed);
+        self.update_leftmost(&lists.normal_tasks);
+        Some(task)
+    }
+
+    /// Tries to take a task that is allowed to run on `cpu` out of this run queue.
+    ///
+    /// Normal tasks are stolen from the right end of the fair queue, which holds the
+    /// tasks that the local CPU would run last.
+    fn try_steal(&self, cpu: u32) -> Option<Arc<Task>> {
+        let mut lists = self.lists.try_lock_irq_disabled()?;
+
+        if let Some(task) = Self::remove_first_runnable_on(&mut lists.real_time_tasks, cpu) {
+            self.num_real_time.fetch_sub(1, Ordering::Relaxed);
+            return Some(task);
+        }
+        let task = lists.normal_tasks.remove_rightmost_runnable_on(cpu)?;
+        self.num_normal.fetch_sub(1, Ordering::Relaxed);
+        self.update_leftmost(&lists.normal_tasks);
+        Some(task)
+    }
+
+    fn remove_first_runnable_on(list: &mut LinkedList<TaskAdapter>, cpu: u32) -> Option<Arc<Task>> {
+        let mut cursor = list.front_mut();
+        while let Some(task) = cursor.get() {
+            if task.cpu_affinity().contains(cpu) {
+                return cursor.remove();
+            }
+            cursor.move_next();
+        }
+        None
+    }
+
+    fn update_leftmost(&self, normal_tasks: &FairQueue) {
+        let leftmost = normal_tasks.leftmost_vruntime().unwrap_or(u64::MAX);
+        self.leftmost_vruntime.store(leftmost, Ordering::Relaxed);
+    }
+
+    fn num_real_time(&self) -> usize {
+        self.num_real_time.load(Ordering::Relaxed)
+    }
+
+    fn num_normal(&self) -> usize {
+        self.num_normal.load(Ordering::Relaxed)
+    }
+
+    fn min_vruntime(&self) -> u64 {
+        self.min_vruntime.load(Ordering::Relaxed)
+    }
+
+    fn leftmost_vruntime(&self) -> u64 {
+        self.leftmost_vruntime.load(Ordering::Relaxed)
+    }
+
+    fn len(&self) -> usize {
+        self.num_real_time() + self.num_normal()
+    }
+}
+
+/// A queue of normal tasks ordered by their virtual runtimes.
+struct FairQueue {
+    /// The tasks keyed by their virtual runtimes at the time of enqueueing.
+    ///
+    /// The second part of the key is a sequence number that breaks ties in FIFO order.
+    tasks: BTreeMap<(u64, u64), Arc<Task>>,
+    next_seq: u64,
+}
+
+impl FairQueue {
+    const fn new() -> Self {
+        Self {
+            tasks: BTreeMap::new(),
+            next_seq: 0,
+        }
+    }
+
+    fn push(&mut self, vruntime: u64, task: Arc<Task>) {
+        let seq = self.next_seq;
+        self.next_seq = self.next_seq.wrapping_add(1);
+        self.tasks.insert((vruntime, seq), task);
+    }
+
+    fn pop_leftmost(&mut self) -> Option<(u64, Arc<Task>)> {
+        let ((vruntime, _), task) = self.tasks.pop_first()?;
+        Some((vruntime, task))
+    }
+
+    fn remove_rightmost_runnable_on(&mut self, cpu: u32) -> Option<Arc<Task>> {
+        let key = self
+            .tasks
+            .iter()
+            .rev()
+            .find(|(_, task)| task.cpu_affinity().contains(cpu))
+            .map(|(key, _)| *key)?;
+        self.tasks.remove(&key)
+    }
+
+    fn leftmost_vruntime(&self) -> Option<u64> {
+        self.tasks
+            .first_key_value()
+            .map(|((vruntime, _), _)| *vruntime)
     }
 }
@@ -11,3 +11,18 @@ pub const TIMER_SOFTIRQ_ID: u8 = 1;
 
 /// The corresponding softirq line is used to schedule general taskless jobs.
 pub const TASKLESS_SOFTIRQ_ID: u8 = 2;
+
+/// The corresponding softirq line is used to invoke the RCU callbacks whose
+/// grace periods have completed.
+pub const RCU_SOFTIRQ_ID: u8 = 3;
+
+/// Returns the name of the softirq line with the ID, if it is used.
+pub fn softirq_name(id: u8) -> Option<&'static str> {
+    match id {
+        TASKLESS_URGENT_SOFTIRQ_ID => Some("taskless_urgent"),
+        TIMER_SOFTIRQ_ID => Some("timer"),
+        TASKLESS_SOFTIRQ_ID => Some("taskless"),
+        RCU_SOFTIRQ_ID => Some("rcu"),
+        _ => None,
+    }
+}
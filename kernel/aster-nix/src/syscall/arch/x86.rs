@@ -23,10 +23,12 @@ use crate::syscall::{
     execve::{sys_execve, sys_execveat},
     exit::sys_exit,
     exit_group::sys_exit_group,
+    fadvise64::sys_fadvise64,
     fcntl::sys_fcntl,
-    fork::sys_fork,
+    fork::{sys_fork, sys_vfork},
     fsync::{sys_fdatasync, sys_fsync},
     futex::sys_futex,
+    getcpu::sys_getcpu,
     getcwd::sys_getcwd,
     getdents64::{sys_getdents, sys_getdents64},
     getegid::sys_getegid,
@@ -48,6 +50,7 @@ use crate::syscall::{
     gettimeofday::sys_gettimeofday,
     getuid::sys_getuid,
     impl_syscall_nums_and_dispatch_fn,
+    io_uring::{sys_io_uring_enter, sys_io_uring_register, sys_io_uring_setup},
     ioctl::sys_ioctl,
     kill::sys_kill,
     link::{sys_link, sys_linkat},
@@ -62,6 +65,7 @@ use crate::syscall::{
     nanosleep::{sys_clock_nanosleep, sys_nanosleep},
     open::{sys_creat, sys_open, sys_openat},
     pause::sys_pause,
+    perf_event_open::sys_perf_event_open,
     pipe::{sys_pipe, sys_pipe2},
     poll::sys_poll,
     prctl::sys_prctl,
@@ -71,6 +75,7 @@ use crate::syscall::{
     pwrite64::sys_pwrite64,
     pwritev::{sys_pwritev, sys_pwritev2, sys_writev},
     read::sys_read,
+    readahead::sys_readahead,
     readlink::{sys_readlink, sys_readlinkat},
     recvfrom::sys_recvfrom,
     recvmsg::sys_recvmsg,
@@ -107,6 +112,7 @@ use crate::syscall::{
     sigaltstack::sys_sigaltstack,
     socket::sys_socket,
     socketpair::sys_socketpair,
+    splice::{sys_splice, sys_tee, sys_vmsplice},
     stat::{sys_fstat, sys_fstatat, sys_lstat, sys_stat},
     statfs::{sys_fstatfs, sys_statfs},
     symlink::{sys_symlink, sys_symlinkat},
@@ -179,6 +185,7 @@ impl_syscall_nums_and_dispatch_fn! {
     SYS_GETSOCKOPT = 55        => sys_getsockopt(args[..5]);
     SYS_CLONE = 56             => sys_clone(args[..5], &context);
     SYS_FORK = 57              => sys_fork(args[..0], &context);
+    SYS_VFORK = 58             => sys_vfork(args[..0], &context);
     SYS_EXECVE = 59            => sys_execve(args[..3], &mut context);
     SYS_EXIT = 60              => sys_exit(args[..1]);
     SYS_WAIT4 = 61             => sys_wait4(args[..4]);
@@ -247,12 +254,14 @@ impl_syscall_nums_and_dispatch_fn! {
     SYS_MOUNT = 165            => sys_mount(args[..5]);
     SYS_UMOUNT2 = 166           => sys_umount(args[..2]);
     SYS_GETTID = 186           => sys_gettid(args[..0]);
+    SYS_READAHEAD = 187        => sys_readahead(args[..3]);
     SYS_TIME = 201             => sys_time(args[..1]);
     SYS_FUTEX = 202            => sys_futex(args[..6]);
     SYS_SCHED_GETAFFINITY = 204 => sys_sched_getaffinity(args[..3]);
     SYS_EPOLL_CREATE = 213     => sys_epoll_create(args[..1]);
     SYS_GETDENTS64 = 217       => sys_getdents64(args[..3]);
     SYS_SET_TID_ADDRESS = 218  => sys_set_tid_address(args[..1]);
+    SYS_FADVISE64 = 221        => sys_fadvise64(args[..4]);
     SYS_TIMER_CREATE = 222     => sys_timer_create(args[..3]);
     SYS_TIMER_SETTIME = 223    => sys_timer_settime(args[..4]);
     SYS_TIMER_GETTIME = 224    => sys_timer_gettime(args[..2]);
@@ -278,6 +287,9 @@ impl_syscall_nums_and_dispatch_fn! {
     SYS_FCHMODAT = 268         => sys_fchmodat(args[..3]);
     SYS_FACCESSAT = 269        => sys_faccessat(args[..3]);
     SYS_SET_ROBUST_LIST = 273  => sys_set_robust_list(args[..2]);
+    SYS_SPLICE = 275           => sys_splice(args[..6]);
+    SYS_TEE = 276              => sys_tee(args[..4]);
+    SYS_VMSPLICE = 278         => sys_vmsplice(args[..4]);
     SYS_UTIMENSAT = 280        => sys_utimensat(args[..4]);
     SYS_EPOLL_PWAIT = 281      => sys_epoll_pwait(args[..6]);
     SYS_EVENTFD = 284          => sys_eventfd(args[..1]);
@@ -288,10 +300,15 @@ impl_syscall_nums_and_dispatch_fn! {
     SYS_PIPE2 = 293            => sys_pipe2(args[..2]);
     SYS_PREADV = 295           => sys_preadv(args[..4]);
     SYS_PWRITEV = 296          => sys_pwritev(args[..4]);
+    SYS_PERF_EVENT_OPEN = 298  => sys_perf_event_open(args[..5]);
     SYS_PRLIMIT64 = 302        => sys_prlimit64(args[..4]);
+    SYS_GETCPU = 309           => sys_getcpu(args[..3]);
     SYS_GETRANDOM = 318        => sys_getrandom(args[..3]);
     SYS_EXECVEAT = 322         => sys_execveat(args[..5], &mut context);
     SYS_PREADV2 = 327          => sys_preadv2(args[..5]);
     SYS_PWRITEV2 = 328         => sys_pwritev2(args[..5]);
+    SYS_IO_URING_SETUP = 425   => sys_io_uring_setup(args[..2]);
+    SYS_IO_URING_ENTER = 426   => sys_io_uring_enter(args[..6]);
+    SYS_IO_URING_REGISTER = 427 => sys_io_uring_register(args[..4]);
     SYS_CLONE3 = 435           => sys_clone3(args[..2], &context);
 }
@@ -11,8 +11,8 @@ pub fn sys_brk(heap_end: u64) -> Result<SyscallReturn> {
     };
     debug!("new heap end = {:x?}", heap_end);
     let current = current!();
-    let user_heap = current.heap();
-    let new_heap_end = user_heap.brk(new_heap_end)?;
+    let process_vm = current.vm();
+    let new_heap_end = process_vm.heap().brk(new_heap_end)?;
 
     Ok(SyscallReturn::Return(new_heap_end as _))
 }
@@ -34,8 +34,7 @@ pub fn sys_fchdir(fd: FileDesc) -> Result<SyscallReturn> {
 
     let current = current!();
     let dentry = {
-        let file_table = current.file_table().lock();
-        let file = file_table.get_file(fd)?;
+        let file = current.file_table().get_file(fd)?;
         let inode_handle = file
             .downcast_ref::<InodeHandle>()
             .ok_or(Error::with_message(Errno::EBADF, "not inode"))?;
@@ -15,8 +15,7 @@ pub fn sys_fchmod(fd: FileDesc, mode: u16) -> Result<SyscallReturn> {
     debug!("fd = {}, mode = 0o{:o}", fd, mode);
 
     let current = current!();
-    let file_table = current.file_table().lock();
-    let file = file_table.get_file(fd)?;
+    let file = current.file_table().get_file(fd)?;
     file.set_mode(InodeMode::from_bits_truncate(mode))?;
     Ok(SyscallReturn::Return(0))
 }
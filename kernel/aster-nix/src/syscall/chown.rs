@@ -22,8 +22,7 @@ pub fn sys_fchown(fd: FileDesc, uid: i32, gid: i32) -> Result<SyscallReturn> {
     }
 
     let current = current!();
-    let file_table = current.file_table().lock();
-    let file = file_table.get_file(fd)?;
+    let file = current.file_table().get_file(fd)?;
     if let Some(uid) = uid {
         file.set_owner(uid)?;
     }
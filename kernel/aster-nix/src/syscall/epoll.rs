@@ -78,10 +78,7 @@ pub fn sys_epoll_ctl(
     };
 
     let current = current!();
-    let file = {
-        let file_table = current.file_table().lock();
-        file_table.get_file(epfd)?.clone()
-    };
+    let file = current.file_table().get_file(epfd)?;
     let epoll_file = file
         .downcast_ref::<EpollFile>()
         .ok_or(Error::with_message(Errno::EINVAL, "not epoll file"))?;
@@ -90,7 +87,12 @@ pub fn sys_epoll_ctl(
     Ok(SyscallReturn::Return(0 as _))
 }
 
-fn do_epoll_wait(epfd: FileDesc, max_events: i32, timeout: i32) -> Result<Vec<EpollEvent>> {
+fn do_epoll_wait(
+    epfd: FileDesc,
+    events_addr: Vaddr,
+    max_events: i32,
+    timeout: i32,
+) -> Result<usize> {
     let max_events = {
         if max_events <= 0 {
             return_errno_with_message!(Errno::EINVAL, "max_events is not positive");
@@ -104,14 +106,19 @@ fn do_epoll_wait(epfd: FileDesc, max_events: i32, timeout: i32) -> Result<Vec<Ep
     };
 
     let current = current!();
-    let file_table = current.file_table().lock();
-    let epoll_file = file_table
-        .get_file(epfd)?
+    let file = current.file_table().get_file(epfd)?;
+    let epoll_file = file
         .downcast_ref::<EpollFile>()
         .ok_or(Error::with_message(Errno::EINVAL, "not epoll file"))?;
-    let epoll_events = epoll_file.wait(max_events, timeout.as_ref())?;
 
-    Ok(epoll_events)
+    // Write back the events as they are collected
+    let mut write_addr = events_addr;
+    epoll_file.wait(max_events, timeout.as_ref(), |epoll_event| {
+        let c_epoll_event = c_epoll_event::from(&epoll_event);
+        write_val_to_user(write_addr, &c_epoll_event)?;
+        write_addr += core::mem::size_of::<c_epoll_event>();
+        Ok(())
+    })
 }
 
 pub fn sys_epoll_wait(
@@ -125,20 +132,12 @@ pub fn sys_epoll_wait(
         epfd, events_addr, max_events, timeout
     );
 
-    let epoll_events = do_epoll_wait(epfd, max_events, timeout)?;
-
-    // Write back
-    let mut write_addr = events_addr;
-    for epoll_event in epoll_events.iter() {
-        let c_epoll_event = c_epoll_event::from(epoll_event);
-        write_val_to_user(write_addr, &c_epoll_event)?;
-        write_addr += core::mem::size_of::<c_epoll_event>();
-    }
+    let nr_events = do_epoll_wait(epfd, events_addr, max_events, timeout)?;
 
-    Ok(SyscallReturn::Return(epoll_events.len() as _))
+    Ok(SyscallReturn::Return(nr_events as _))
 }
 
-fn set_signal_mask(set_ptr: Vaddr) -> Result<u64> {
+pub(super) fn set_signal_mask(set_ptr: Vaddr) -> Result<u64> {
     let new_set: Option<u64> = if set_ptr != 0 {
         Some(read_val_from_user::<u64>(set_ptr)?)
     } else {
@@ -158,7 +157,7 @@ fn set_signal_mask(set_ptr: Vaddr) -> Result<u64> {
     Ok(old_sig_mask_value)
 }
 
-fn restore_signal_mask(sig_mask_val: u64) {
+pub(super) fn restore_signal_mask(sig_mask_val: u64) {
     let current_thread = current_thread!();
     let posix_thread = current_thread.as_posix_thread().unwrap();
     let mut sig_mask = posix_thread.sig_mask().lock();
@@ -185,27 +184,12 @@ pub fn sys_epoll_pwait(
 
     let old_sig_mask_value = set_signal_mask(sigmask)?;
 
-    let ready_events = match do_epoll_wait(epfd, max_events, timeout) {
-        Ok(events) => {
-            restore_signal_mask(old_sig_mask_value);
-            events
-        }
-        Err(e) => {
-            // Restore the signal mask even if an error occurs
-            restore_signal_mask(old_sig_mask_value);
-            return Err(e);
-        }
-    };
+    let nr_events = do_epoll_wait(epfd, events_addr, max_events, timeout);
 
-    // Write back
-    let mut write_addr = events_addr;
-    for event in ready_events.iter() {
-        let c_event = c_epoll_event::from(event);
-        write_val_to_user(write_addr, &c_event)?;
-        write_addr += core::mem::size_of::<c_epoll_event>();
-    }
+    // Restore the signal mask even if an error occurs
+    restore_signal_mask(old_sig_mask_value);
 
-    Ok(SyscallReturn::Return(ready_events.len() as _))
+    Ok(SyscallReturn::Return(nr_events? as _))
 }
 
 #[derive(Debug, Clone, Copy, Pod)]
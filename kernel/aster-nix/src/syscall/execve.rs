@@ -16,7 +16,8 @@ use crate::{
     process::{
         check_executable_file, credentials_mut, load_program_to_vm,
         posix_thread::{PosixThreadExt, ThreadName},
-        Credentials, Process, MAX_ARGV_NUMBER, MAX_ARG_LEN, MAX_ENVP_NUMBER, MAX_ENV_LEN,
+        Credentials, Process, ProcessVm, MAX_ARGV_NUMBER, MAX_ARG_LEN, MAX_ENVP_NUMBER,
+        MAX_ENV_LEN,
     },
     util::{read_cstring_from_user, read_val_from_user},
 };
@@ -109,18 +110,28 @@ fn do_execve(
         file.clean_for_close()?;
     }
 
+    // A process sharing the virtual memory with other processes, e.g., a vfork child,
+    // loads the program to a new virtual memory, leaving the shared one intact.
+    let new_process_vm = current.is_vm_shared().then(|| Arc::new(ProcessVm::alloc()));
+
     debug!("load program to root vmar");
     let (new_executable_path, elf_load_info) = {
         let fs_resolver = &*current.fs().read();
-        let process_vm = current.vm();
-        load_program_to_vm(process_vm, elf_file.clone(), argv, envp, fs_resolver, 1)?
+        let process_vm = new_process_vm.clone().unwrap_or_else(|| current.vm());
+        load_program_to_vm(&process_vm, elf_file.clone(), argv, envp, fs_resolver, 1)?
     };
+    if let Some(process_vm) = new_process_vm {
+        current.set_vm(process_vm);
+    }
 
     // After the program has been successfully loaded, the virtual memory of the current process
     // is initialized. Hence, it is necessary to clear the previously recorded robust list.
     *posix_thread.robust_list().lock() = None;
     debug!("load elf in execve succeeds");
 
+    // A parent suspended by vfork can run again once the child has its own program.
+    current.release_vfork_parent();
+
     let credentials = credentials_mut();
     set_uid_from_elf(&current, &credentials, &elf_file)?;
     set_gid_from_elf(&current, &credentials, &elf_file)?;
@@ -140,6 +151,8 @@ fn do_execve(
     // set new user stack top
     context.set_stack_pointer(elf_load_info.user_stack_top() as _);
     debug!("user stack top: 0x{:x}", elf_load_info.user_stack_top());
+    // Start the performance events that wait for the new program.
+    current_thread.perf_events().enable_on_exec();
     Ok(())
 }
 
@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: MPL-2.0
+
+use super::SyscallReturn;
+use crate::{
+    fs::{file_table::FileDesc, inode_handle::InodeHandle, utils::FileAdvice},
+    prelude::*,
+};
+
+pub fn sys_fadvise64(fd: FileDesc, offset: i64, len: i64, advice: i32) -> Result<SyscallReturn> {
+    let advice = FileAdvice::try_from(advice)?;
+    debug!(
+        "fd = {}, offset = {}, len = {}, advice = {:?}",
+        fd, offset, len, advice
+    );
+
+    if offset < 0 || len < 0 {
+        return_errno_with_message!(Errno::EINVAL, "the offset or the length is negative");
+    }
+    let file = {
+        let current = current!();
+        current.file_table().get_file(fd)?
+    };
+    let inode_handle = file
+        .downcast_ref::<InodeHandle>()
+        .ok_or(Error::with_message(Errno::ESPIPE, "not inode"))?;
+    // A zero length means all the data after the offset.
+    let len = if len == 0 { usize::MAX } else { len as usize };
+    inode_handle
+        .dentry()
+        .inode()
+        .advise(offset as usize, len, advice)?;
+    Ok(SyscallReturn::Return(0))
+}
@@ -4,6 +4,7 @@ use super::SyscallReturn;
 use crate::{
     fs::{
         file_table::{FdFlags, FileDesc},
+        pipe::{PipeReader, PipeWriter},
         utils::StatusFlags,
     },
     prelude::*,
@@ -48,10 +49,7 @@ pub fn sys_fcntl(fd: FileDesc, cmd: i32, arg: u64) -> Result<SyscallReturn> {
         }
         FcntlCmd::F_GETFL => {
             let current = current!();
-            let file = {
-                let file_table = current.file_table().lock();
-                file_table.get_file(fd)?.clone()
-            };
+            let file = current.file_table().get_file(fd)?;
             let status_flags = file.status_flags();
             let access_mode = file.access_mode();
             Ok(SyscallReturn::Return(
@@ -60,10 +58,7 @@ pub fn sys_fcntl(fd: FileDesc, cmd: i32, arg: u64) -> Result<SyscallReturn> {
         }
         FcntlCmd::F_SETFL => {
             let current = current!();
-            let file = {
-                let file_table = current.file_table().lock();
-                file_table.get_file(fd)?.clone()
-            };
+            let file = current.file_table().get_file(fd)?;
             let new_status_flags = {
                 // This cmd can change(set or unset) only the O_APPEND, O_ASYNC, O_DIRECT,
                 // O_NOATIME and O_NONBLOCK flags.
@@ -80,6 +75,30 @@ pub fn sys_fcntl(fd: FileDesc, cmd: i32, arg: u64) -> Result<SyscallReturn> {
             file.set_status_flags(new_status_flags)?;
             Ok(SyscallReturn::Return(0))
         }
+        FcntlCmd::F_SETPIPE_SZ => {
+            let current = current!();
+            let file = current.file_table().get_file(fd)?;
+            let size = if let Some(pipe) = file.downcast_ref::<PipeReader>() {
+                pipe.set_capacity(arg as usize)?
+            } else if let Some(pipe) = file.downcast_ref::<PipeWriter>() {
+                pipe.set_capacity(arg as usize)?
+            } else {
+                return_errno_with_message!(Errno::EBADF, "the file is not a pipe");
+            };
+            Ok(SyscallReturn::Return(size as _))
+        }
+        FcntlCmd::F_GETPIPE_SZ => {
+            let current = current!();
+            let file = current.file_table().get_file(fd)?;
+            let size = if let Some(pipe) = file.downcast_ref::<PipeReader>() {
+                pipe.capacity()
+            } else if let Some(pipe) = file.downcast_ref::<PipeWriter>() {
+                pipe.capacity()
+            } else {
+                return_errno_with_message!(Errno::EBADF, "the file is not a pipe");
+            };
+            Ok(SyscallReturn::Return(size as _))
+        }
     }
 }
 
@@ -93,4 +112,6 @@ enum FcntlCmd {
     F_GETFL = 3,
     F_SETFL = 4,
     F_DUPFD_CLOEXEC = 1030,
+    F_SETPIPE_SZ = 1031,
+    F_GETPIPE_SZ = 1032,
 }
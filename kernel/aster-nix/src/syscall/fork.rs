@@ -16,3 +16,9 @@ pub fn sys_fork(parent_context: &UserContext) -> Result<SyscallReturn> {
     let child_pid = clone_child(parent_context, clone_args).unwrap();
     Ok(SyscallReturn::Return(child_pid as _))
 }
+
+pub fn sys_vfork(parent_context: &UserContext) -> Result<SyscallReturn> {
+    let clone_args = CloneArgs::for_vfork();
+    let child_pid = clone_child(parent_context, clone_args)?;
+    Ok(SyscallReturn::Return(child_pid as _))
+}
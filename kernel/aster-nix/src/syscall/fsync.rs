@@ -11,8 +11,7 @@ pub fn sys_fsync(fd: FileDesc) -> Result<SyscallReturn> {
 
     let dentry = {
         let current = current!();
-        let file_table = current.file_table().lock();
-        let file = file_table.get_file(fd)?;
+        let file = current.file_table().get_file(fd)?;
         let inode_handle = file
             .downcast_ref::<InodeHandle>()
             .ok_or(Error::with_message(Errno::EINVAL, "not inode"))?;
@@ -27,8 +26,7 @@ pub fn sys_fdatasync(fd: FileDesc) -> Result<SyscallReturn> {
 
     let dentry = {
         let current = current!();
-        let file_table = current.file_table().lock();
-        let file = file_table.get_file(fd)?;
+        let file = current.file_table().get_file(fd)?;
         let inode_handle = file
             .downcast_ref::<InodeHandle>()
             .ok_or(Error::with_message(Errno::EINVAL, "not inode"))?;
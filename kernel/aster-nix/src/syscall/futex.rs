@@ -1,12 +1,17 @@
 // SPDX-License-Identifier: MPL-2.0
 
+use core::time::Duration;
+
+use super::clock_gettime::read_clock;
 use crate::{
     prelude::*,
     process::posix_thread::futex::{
         futex_op_and_flags_from_u32, futex_requeue, futex_wait, futex_wait_bitset, futex_wake,
-        futex_wake_bitset, FutexOp, FutexTimeout,
+        futex_wake_bitset, futex_wake_op, FutexFlags, FutexOp, FutexTimeout,
     },
-    syscall::SyscallReturn,
+    syscall::{ClockId, SyscallReturn},
+    time::{clockid_t, timespec_t},
+    util::read_val_from_user,
 };
 
 pub fn sys_futex(
@@ -17,12 +22,12 @@ pub fn sys_futex(
     futex_new_addr: u64,
     bitset: u64,
 ) -> Result<SyscallReturn> {
-    // FIXME: we current ignore futex flags
-    let (futex_op, futex_flags) = futex_op_and_flags_from_u32(futex_op as _).unwrap();
+    let (futex_op, futex_flags) = futex_op_and_flags_from_u32(futex_op as _)?;
     debug!(
         "futex_op = {:?}, futex_flags = {:?}, futex_addr = 0x{:x}",
         futex_op, futex_flags, futex_addr
     );
+    let is_private = futex_flags.contains(FutexFlags::FUTEX_PRIVATE);
 
     let get_futex_val = |val: i32| -> Result<usize> {
         if val < 0 {
@@ -31,45 +36,86 @@ pub fn sys_futex(
         Ok(val as usize)
     };
 
-    let get_futex_timeout = |timeout_addr| -> Result<Option<FutexTimeout>> {
-        if timeout_addr == 0 {
-            return Ok(None);
-        }
-        // TODO: parse a timeout
-        todo!()
-    };
+    // The timeout is relative for `FUTEX_WAIT`, and absolute for `FUTEX_WAIT_BITSET`, which
+    // is measured against `CLOCK_REALTIME` if `FUTEX_CLOCK_REALTIME` is set, or
+    // `CLOCK_MONOTONIC` otherwise.
+    let get_futex_timeout =
+        |timeout_addr: u64, is_abs_time: bool| -> Result<Option<FutexTimeout>> {
+            if timeout_addr == 0 {
+                return Ok(None);
+            }
+
+            let timespec = read_val_from_user::<timespec_t>(timeout_addr as _)?;
+            if timespec.sec < 0 || !(0..1_000_000_000).contains(&timespec.nsec) {
+                return_errno_with_message!(Errno::EINVAL, "the futex timeout is invalid");
+            }
+            let timeout = Duration::from(timespec);
+            if !is_abs_time {
+                return Ok(Some(FutexTimeout::new(timeout)));
+            }
+
+            let clock_id = if futex_flags.contains(FutexFlags::FUTEX_CLOCK_REALTIME) {
+                ClockId::CLOCK_REALTIME
+            } else {
+                ClockId::CLOCK_MONOTONIC
+            };
+            let now = read_clock(clock_id as clockid_t)?;
+            Ok(Some(FutexTimeout::new(timeout.saturating_sub(now))))
+        };
 
     let res = match futex_op {
         FutexOp::FUTEX_WAIT => {
-            let timeout = get_futex_timeout(utime_addr).expect("Invalid time addr");
-            futex_wait(futex_addr as _, futex_val as _, &timeout).map(|_| 0)
+            let timeout = get_futex_timeout(utime_addr, false)?;
+            futex_wait(futex_addr as _, futex_val as _, &timeout, is_private).map(|_| 0)
         }
         FutexOp::FUTEX_WAIT_BITSET => {
-            let timeout = get_futex_timeout(utime_addr).expect("Invalid time addr");
-            futex_wait_bitset(futex_addr as _, futex_val as _, &timeout, bitset as _).map(|_| 0)
+            let timeout = get_futex_timeout(utime_addr, true)?;
+            futex_wait_bitset(
+                futex_addr as _,
+                futex_val as _,
+                &timeout,
+                bitset as _,
+                is_private,
+            )
+            .map(|_| 0)
         }
         FutexOp::FUTEX_WAKE => {
-            let max_count = get_futex_val(futex_val as i32).expect("Invalid futex val");
-            futex_wake(futex_addr as _, max_count).map(|count| count as isize)
+            let max_count = get_futex_val(futex_val as i32)?;
+            futex_wake(futex_addr as _, max_count, is_private).map(|count| count as isize)
         }
         FutexOp::FUTEX_WAKE_BITSET => {
-            let max_count = get_futex_val(futex_val as i32).expect("Invalid futex val");
-            futex_wake_bitset(futex_addr as _, max_count, bitset as _).map(|count| count as isize)
+            let max_count = get_futex_val(futex_val as i32)?;
+            futex_wake_bitset(futex_addr as _, max_count, bitset as _, is_private)
+                .map(|count| count as isize)
+        }
+        FutexOp::FUTEX_WAKE_OP => {
+            let max_nwakes = get_futex_val(futex_val as i32)?;
+            // The second count is passed in place of the timeout
+            let max_nwakes_2 = get_futex_val(utime_addr as i32)?;
+            futex_wake_op(
+                futex_addr as _,
+                futex_new_addr as _,
+                max_nwakes,
+                max_nwakes_2,
+                bitset as _,
+                is_private,
+            )
+            .map(|nwakes| nwakes as _)
         }
         FutexOp::FUTEX_REQUEUE => {
-            let max_nwakes = get_futex_val(futex_val as i32).expect("Invalid futex val");
-            let max_nrequeues = get_futex_val(utime_addr as i32).expect("Invalid utime addr");
+            let max_nwakes = get_futex_val(futex_val as i32)?;
+            let max_nrequeues = get_futex_val(utime_addr as i32)?;
             futex_requeue(
                 futex_addr as _,
                 max_nwakes,
                 max_nrequeues,
                 futex_new_addr as _,
+                is_private,
             )
             .map(|nwakes| nwakes as _)
         }
-        _ => panic!("Unsupported futex operations"),
-    }
-    .unwrap();
+        _ => return_errno_with_message!(Errno::ENOSYS, "unsupported futex operation"),
+    }?;
 
     debug!("futex returns, tid= {} ", current_thread!().tid());
     Ok(SyscallReturn::Return(res as _))
@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: MPL-2.0
+
+use ostd::cpu::this_cpu;
+
+use super::SyscallReturn;
+use crate::{prelude::*, util::write_val_to_user};
+
+pub fn sys_getcpu(cpu_ptr: Vaddr, node_ptr: Vaddr, _tcache_ptr: Vaddr) -> Result<SyscallReturn> {
+    // The NUMA nodes are not supported, so all the CPUs belong to node 0.
+    let cpu = this_cpu();
+    let node = 0u32;
+    debug!("cpu = {}, node = {}", cpu, node);
+
+    if cpu_ptr != 0 {
+        write_val_to_user(cpu_ptr, &cpu)?;
+    }
+    if node_ptr != 0 {
+        write_val_to_user(node_ptr, &node)?;
+    }
+    Ok(SyscallReturn::Return(0))
+}
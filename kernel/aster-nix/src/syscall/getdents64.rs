@@ -23,8 +23,7 @@ pub fn sys_getdents(fd: FileDesc, buf_addr: Vaddr, buf_len: usize) -> Result<Sys
 
     let file = {
         let current = current!();
-        let file_table = current.file_table().lock();
-        file_table.get_file(fd)?.clone()
+        current.file_table().get_file(fd)?
     };
     let inode_handle = file
         .downcast_ref::<InodeHandle>()
@@ -48,8 +47,7 @@ pub fn sys_getdents64(fd: FileDesc, buf_addr: Vaddr, buf_len: usize) -> Result<S
 
     let file = {
         let current = current!();
-        let file_table = current.file_table().lock();
-        file_table.get_file(fd)?.clone()
+        current.file_table().get_file(fd)?
     };
     let inode_handle = file
         .downcast_ref::<InodeHandle>()
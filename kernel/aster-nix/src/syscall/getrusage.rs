@@ -30,18 +30,35 @@ pub fn sys_getrusage(target: i32, rusage_addr: Vaddr) -> Result<SyscallReturn> {
         let rusage = match rusage_target {
             RusageTarget::ForSelf => {
                 let process = current!();
+                let (nvcsw, nivcsw) =
+                    process
+                        .threads()
+                        .lock()
+                        .iter()
+                        .fold((0, 0), |(nvcsw, nivcsw), thread| {
+                            let sched_entity = thread.sched_entity();
+                            (
+                                nvcsw + sched_entity.nr_voluntary_switches(),
+                                nivcsw + sched_entity.nr_involuntary_switches(),
+                            )
+                        });
                 rusage_t {
                     ru_utime: process.prof_clock().user_clock().read_time().into(),
                     ru_stime: process.prof_clock().kernel_clock().read_time().into(),
+                    ru_nvcsw: nvcsw,
+                    ru_nivcsw: nivcsw,
                     ..Default::default()
                 }
             }
             RusageTarget::Thread => {
                 let thread = current_thread!();
                 let posix_thread = thread.as_posix_thread().unwrap();
+                let sched_entity = thread.sched_entity();
                 rusage_t {
                     ru_utime: posix_thread.prof_clock().user_clock().read_time().into(),
                     ru_stime: posix_thread.prof_clock().kernel_clock().read_time().into(),
+                    ru_nvcsw: sched_entity.nr_voluntary_switches(),
+                    ru_nivcsw: sched_entity.nr_involuntary_switches(),
                     ..Default::default()
                 }
             }
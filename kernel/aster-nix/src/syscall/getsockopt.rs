@@ -35,7 +35,7 @@ pub fn sys_getsockopt(
     let write_len = {
         let current = current!();
         let vmar = current.root_vmar();
-        raw_option.write_to_user(vmar, optval, optlen)?
+        raw_option.write_to_user(&vmar, optval, optlen)?
     };
 
     write_val_to_user(optlen_addr, &(write_len as u32))?;
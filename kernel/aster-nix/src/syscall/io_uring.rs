@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: MPL-2.0
+
+use core::time::Duration;
+
+use super::{
+    epoll::{restore_signal_mask, set_signal_mask},
+    SyscallReturn,
+};
+use crate::{
+    fs::{
+        file_table::{FdFlags, FileDesc},
+        io_uring::{
+            IoUringEnterFlags, IoUringFeatures, IoUringFile, IoUringGeteventsArg, IoUringParams,
+            IoUringRegisterOp, IoUringSetupFlags, IORING_MAX_CQ_ENTRIES, IORING_MAX_ENTRIES,
+        },
+    },
+    prelude::*,
+    time::timespec_t,
+    util::{read_val_from_user, write_val_to_user},
+};
+
+pub fn sys_io_uring_setup(entries: u32, params_addr: Vaddr) -> Result<SyscallReturn> {
+    let mut params: IoUringParams = read_val_from_user(params_addr)?;
+    debug!("entries = {}, params = {:?}", entries, params);
+
+    let flags = IoUringSetupFlags::from_bits(params.flags)
+        .ok_or_else(|| Error::with_message(Errno::EINVAL, "unknown setup flags"))?;
+    if !IoUringSetupFlags::SUPPORTED.contains(flags) {
+        return_errno_with_message!(Errno::EINVAL, "unsupported setup flags");
+    }
+    if params.resv.iter().any(|resv| *resv != 0) {
+        return_errno_with_message!(Errno::EINVAL, "the reserved fields are not zero");
+    }
+
+    let clamp = |entries: u32, max_entries: u32| -> Result<u32> {
+        if entries == 0 {
+            return_errno_with_message!(Errno::EINVAL, "the number of entries is zero");
+        }
+        if entries > max_entries {
+            if !flags.contains(IoUringSetupFlags::CLAMP) {
+                return_errno_with_message!(Errno::EINVAL, "too many entries");
+            }
+            return Ok(max_entries);
+        }
+        Ok(entries.next_power_of_two())
+    };
+    let sq_entries = clamp(entries, IORING_MAX_ENTRIES)?;
+    let cq_entries = if flags.contains(IoUringSetupFlags::CQSIZE) {
+        let cq_entries = clamp(params.cq_entries, IORING_MAX_CQ_ENTRIES)?;
+        if cq_entries < sq_entries {
+            return_errno_with_message!(Errno::EINVAL, "the CQ is smaller than the SQ");
+        }
+        cq_entries
+    } else {
+        2 * sq_entries
+    };
+
+    let io_uring_file = IoUringFile::new(sq_entries, cq_entries)?;
+    let (sq_off, cq_off) = io_uring_file.ring_offsets();
+    params.sq_entries = sq_entries;
+    params.cq_entries = cq_entries;
+    params.features = (IoUringFeatures::SINGLE_MMAP
+        | IoUringFeatures::NODROP
+        | IoUringFeatures::SUBMIT_STABLE
+        | IoUringFeatures::RW_CUR_POS
+        | IoUringFeatures::EXT_ARG)
+        .bits();
+    params.sq_off = sq_off;
+    params.cq_off = cq_off;
+    write_val_to_user(params_addr, &params)?;
+
+    let fd = {
+        let current = current!();
+        let mut file_table = current.file_table().lock();
+        file_table.insert(io_uring_file, FdFlags::CLOEXEC)
+    };
+    Ok(SyscallReturn::Return(fd as _))
+}
+
+pub fn sys_io_uring_enter(
+    fd: FileDesc,
+    to_submit: u32,
+    min_complete: u32,
+    flags: u32,
+    sigmask: Vaddr,
+    sigset_size: usize,
+) -> Result<SyscallReturn> {
+    let flags = IoUringEnterFlags::from_bits(flags)
+        .ok_or_else(|| Error::with_message(Errno::EINVAL, "unknown enter flags"))?;
+    debug!(
+        "fd = {}, to_submit = {}, min_complete = {}, flags = {:?}, sigmask = 0x{:x}, sigset_size = {}",
+        fd, to_submit, min_complete, flags, sigmask, sigset_size
+    );
+
+    // With extended arguments, the signal mask and the timeout are passed through
+    // an `IoUringGeteventsArg`, whose address and size are passed in place of the
+    // signal mask and its size.
+    let (sigmask, timeout) = if flags.contains(IoUringEnterFlags::EXT_ARG) {
+        if sigset_size != size_of::<IoUringGeteventsArg>() {
+            return_errno_with_message!(Errno::EINVAL, "invalid extended arguments size");
+        }
+        let arg: IoUringGeteventsArg = read_val_from_user(sigmask)?;
+        if arg.sigmask != 0 && arg.sigmask_sz != 8 {
+            return_errno_with_message!(Errno::EINVAL, "invalid sigset size");
+        }
+        let timeout = if arg.ts != 0 {
+            let timespec: timespec_t = read_val_from_user(arg.ts as Vaddr)?;
+            if timespec.sec < 0 || !(0..1_000_000_000).contains(&timespec.nsec) {
+                return_errno_with_message!(Errno::EINVAL, "invalid timeout");
+            }
+            Some(Duration::from(timespec))
+        } else {
+            None
+        };
+        (arg.sigmask as Vaddr, timeout)
+    } else {
+        if sigmask != 0 && sigset_size != 8 {
+            return_errno_with_message!(Errno::EINVAL, "invalid sigset size");
+        }
+        (sigmask, None)
+    };
+
+    let file = {
+        let current = current!();
+        current.file_table().get_file(fd)?
+    };
+    let io_uring_file = file
+        .downcast_ref::<IoUringFile>()
+        .ok_or_else(|| Error::with_message(Errno::EOPNOTSUPP, "the file is not an io_uring"))?;
+
+    // There is no SQ polling thread, so `IoUringEnterFlags::SQ_WAKEUP` and
+    // `IoUringEnterFlags::SQ_WAIT` have nothing to do.
+    let nr_submitted = if to_submit > 0 {
+        io_uring_file.submit(to_submit)?
+    } else {
+        0
+    };
+
+    if flags.contains(IoUringEnterFlags::GETEVENTS) {
+        let old_sig_mask_value = set_signal_mask(sigmask)?;
+        let res = io_uring_file.wait_cqes(min_complete, timeout.as_ref());
+        // Restore the signal mask even if an error occurs
+        restore_signal_mask(old_sig_mask_value);
+
+        // The submitted requests are reported even if the waiting fails.
+        if nr_submitted == 0 {
+            res?;
+        }
+    }
+
+    Ok(SyscallReturn::Return(nr_submitted as _))
+}
+
+pub fn sys_io_uring_register(
+    fd: FileDesc,
+    opcode: u32,
+    arg: Vaddr,
+    nr_args: u32,
+) -> Result<SyscallReturn> {
+    debug!(
+        "fd = {}, opcode = {}, arg = 0x{:x}, nr_args = {}",
+        fd, opcode, arg, nr_args
+    );
+
+    let op = IoUringRegisterOp::try_from(opcode)?;
+    let file = {
+        let current = current!();
+        current.file_table().get_file(fd)?
+    };
+    let io_uring_file = file
+        .downcast_ref::<IoUringFile>()
+        .ok_or_else(|| Error::with_message(Errno::EOPNOTSUPP, "the file is not an io_uring"))?;
+
+    io_uring_file.register(op, arg, nr_args)?;
+    Ok(SyscallReturn::Return(0))
+}
@@ -13,8 +13,7 @@ pub fn sys_ioctl(fd: FileDesc, cmd: u32, arg: Vaddr) -> Result<SyscallReturn> {
         fd, ioctl_cmd, arg
     );
     let current = current!();
-    let file_table = current.file_table().lock();
-    let file = file_table.get_file(fd)?;
+    let file = current.file_table().get_file(fd)?;
     let res = file.ioctl(ioctl_cmd, arg)?;
     Ok(SyscallReturn::Return(res as _))
 }
@@ -20,8 +20,7 @@ pub fn sys_lseek(fd: FileDesc, offset: isize, whence: u32) -> Result<SyscallRetu
         _ => return_errno!(Errno::EINVAL),
     };
     let current = current!();
-    let file_table = current.file_table().lock();
-    let file = file_table.get_file(fd)?;
+    let file = current.file_table().get_file(fd)?;
     let offset = file.seek(seek_from)?;
     Ok(SyscallReturn::Return(offset as _))
 }
@@ -1,5 +1,10 @@
 // SPDX-License-Identifier: MPL-2.0
 
+use core::ops::Range;
+
+use align_ext::AlignExt;
+use ostd::mm::MAX_USERSPACE_VADDR;
+
 use super::SyscallReturn;
 use crate::{prelude::*, util::read_bytes_from_user};
 
@@ -10,14 +15,18 @@ pub fn sys_madvise(start: Vaddr, len: usize, behavior: i32) -> Result<SyscallRet
         start, len, behavior
     );
     match behavior {
-        MadviseBehavior::MADV_NORMAL
-        | MadviseBehavior::MADV_SEQUENTIAL
-        | MadviseBehavior::MADV_WILLNEED => {
+        MadviseBehavior::MADV_NORMAL | MadviseBehavior::MADV_SEQUENTIAL => {
             // perform a read at first
             let mut buffer = vec![0u8; len];
             read_bytes_from_user(start, &mut VmWriter::from(buffer.as_mut_slice()))?;
         }
+        MadviseBehavior::MADV_WILLNEED | MadviseBehavior::MADV_POPULATE_READ => {
+            madv_populate(start, len, false)?
+        }
+        MadviseBehavior::MADV_POPULATE_WRITE => madv_populate(start, len, true)?,
         MadviseBehavior::MADV_DONTNEED => madv_dontneed(start, len)?,
+        MadviseBehavior::MADV_HUGEPAGE => madv_hugepage(start, len, true)?,
+        MadviseBehavior::MADV_NOHUGEPAGE => madv_hugepage(start, len, false)?,
         _ => todo!(),
     }
     Ok(SyscallReturn::Return(0))
@@ -34,6 +43,36 @@ fn madv_dontneed(start: Vaddr, len: usize) -> Result<()> {
     Ok(())
 }
 
+fn madv_hugepage(start: Vaddr, len: usize, enabled: bool) -> Result<()> {
+    let advised_range = advised_range(start, len)?;
+    let current = current!();
+    let root_vmar = current.root_vmar();
+    root_vmar.set_huge_pages(enabled, advised_range)
+}
+
+fn madv_populate(start: Vaddr, len: usize, write: bool) -> Result<()> {
+    let advised_range = advised_range(start, len)?;
+    let current = current!();
+    let root_vmar = current.root_vmar();
+    root_vmar.populate(advised_range, write)
+}
+
+/// Returns the page-aligned range of the advice.
+fn advised_range(start: Vaddr, len: usize) -> Result<Range<Vaddr>> {
+    if start % PAGE_SIZE != 0 {
+        return_errno_with_message!(Errno::EINVAL, "the start address is not page-aligned");
+    }
+    let end = start
+        .checked_add(len)
+        .filter(|end| *end <= MAX_USERSPACE_VADDR)
+        .ok_or(Error::with_message(
+            Errno::ENOMEM,
+            "the advised range is out of the user space",
+        ))?
+        .align_up(PAGE_SIZE);
+    Ok(start..end)
+}
+
 #[repr(i32)]
 #[derive(Debug, Clone, Copy, TryFromInt)]
 #[allow(non_camel_case_types)]
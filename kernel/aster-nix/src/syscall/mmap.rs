@@ -9,7 +9,8 @@ use aster_rights::Rights;
 
 use super::SyscallReturn;
 use crate::{
-    fs::file_table::FileDesc,
+    fs::{file_table::FileDesc, io_uring::IoUringFile},
+    perf::PerfEventFile,
     prelude::*,
     vm::{
         perms::VmPerms,
@@ -89,6 +90,15 @@ fn do_sys_mmap(
     let map_addr = vm_map_options.build()?;
     trace!("map range = 0x{:x} - 0x{:x}", map_addr, map_addr + len);
 
+    if option.flags.contains(MMapFlags::MAP_POPULATE) {
+        // Like Linux, the writable private mappings are populated for writing to break COW
+        // in advance. Failing to populate the mapping does not fail the mapping itself.
+        let write = vm_perms.contains(VmPerms::WRITE) && option.typ() == MMapType::Private;
+        if let Err(err) = root_vmar.populate(map_addr..map_addr + len, write) {
+            debug!("failed to populate the mapping: {:?}", err);
+        }
+    }
+
     Ok(map_addr)
 }
 
@@ -104,6 +114,14 @@ fn alloc_filebacked_vmo(
     option: &MMapOptions,
 ) -> Result<Vmo> {
     let current = current!();
+    let file = current.file_table().get_file(fd)?;
+    if let Some(io_uring_file) = file.downcast_ref::<IoUringFile>() {
+        return io_uring_file.mmap_vmo(offset, len);
+    }
+    if let Some(perf_event_file) = file.downcast_ref::<PerfEventFile>() {
+        return perf_event_file.mmap_vmo(offset, len);
+    }
+
     let page_cache_vmo = {
         let fs_resolver = current.fs().read();
         let dentry = fs_resolver.lookup_from_fd(fd)?;
@@ -5,7 +5,7 @@
 pub use clock_gettime::ClockId;
 use ostd::cpu::UserContext;
 
-use crate::{cpu::LinuxAbi, prelude::*};
+use crate::{cpu::LinuxAbi, prelude::*, process::posix_thread::PosixThreadExt, thread::Thread};
 
 mod accept;
 mod access;
@@ -31,10 +31,12 @@ mod eventfd;
 mod execve;
 mod exit;
 mod exit_group;
+mod fadvise64;
 mod fcntl;
 mod fork;
 mod fsync;
 mod futex;
+mod getcpu;
 mod getcwd;
 mod getdents64;
 mod getegid;
@@ -55,6 +57,7 @@ mod getsockopt;
 mod gettid;
 mod gettimeofday;
 mod getuid;
+mod io_uring;
 mod ioctl;
 mod kill;
 mod link;
@@ -69,6 +72,7 @@ mod munmap;
 mod nanosleep;
 mod open;
 mod pause;
+mod perf_event_open;
 mod pipe;
 mod poll;
 mod prctl;
@@ -78,6 +82,7 @@ mod prlimit64;
 mod pwrite64;
 mod pwritev;
 mod read;
+mod readahead;
 mod readlink;
 mod recvfrom;
 mod recvmsg;
@@ -114,8 +119,10 @@ mod shutdown;
 mod sigaltstack;
 mod socket;
 mod socketpair;
+mod splice;
 mod stat;
 mod statfs;
+pub mod stats;
 mod symlink;
 mod sync;
 mod tgkill;
@@ -176,6 +183,16 @@ macro_rules! impl_syscall_nums_and_dispatch_fn {
             pub const $name: u64 = $num;
         )*
 
+        /// Returns the name of the system call, e.g., `SYS_READ`.
+        pub fn syscall_name(syscall_number: u64) -> Option<&'static str> {
+            match syscall_number {
+                $(
+                    $num => Some(stringify!($name)),
+                )*
+                _ => None,
+            }
+        }
+
         // Then, define the dispatcher function
         pub fn syscall_dispatch(
             syscall_number: u64,
@@ -228,10 +245,20 @@ impl SyscallArgument {
     }
 }
 
-pub fn handle_syscall(context: &mut UserContext) {
+pub fn handle_syscall(context: &mut UserContext, current_thread: &Thread) {
+    let start_time = stats::start_time();
+    let syscall_number = context.syscall_num() as u64;
+
+    if let Some(return_value) = fast_syscall_dispatch(syscall_number, current_thread) {
+        context.set_syscall_ret(return_value as usize);
+        stats::record(syscall_number, start_time);
+        return;
+    }
+
     let syscall_frame = SyscallArgument::new_from_context(context);
     let syscall_return =
         arch::syscall_dispatch(syscall_frame.syscall_number, syscall_frame.args, context);
+    stats::record(syscall_number, start_time);
 
     match syscall_return {
         Ok(return_value) => {
@@ -247,6 +274,32 @@ pub fn handle_syscall(context: &mut UserContext) {
     }
 }
 
+/// Handles the trivial system calls that cannot fail, without going through the
+/// dispatcher.
+///
+/// The fast path uses the current thread from the user task loop directly, so it
+/// avoids looking up the current thread and process again, and skips the argument
+/// decoding and the logging of the dispatcher.
+///
+/// Returns `None` if the system call must be handled by the dispatcher.
+fn fast_syscall_dispatch(syscall_number: u64, current_thread: &Thread) -> Option<isize> {
+    if log::log_enabled!(log::Level::Info) {
+        return None;
+    }
+
+    let posix_thread = current_thread.as_posix_thread()?;
+    let return_value = match syscall_number {
+        arch::SYS_GETPID => posix_thread.process().pid() as _,
+        arch::SYS_GETTID => current_thread.tid() as _,
+        arch::SYS_GETUID => posix_thread.credentials().ruid().as_u32() as _,
+        arch::SYS_GETEUID => posix_thread.credentials().euid().as_u32() as _,
+        arch::SYS_GETGID => posix_thread.credentials().rgid().as_u32() as _,
+        arch::SYS_GETEGID => posix_thread.credentials().egid().as_u32() as _,
+        _ => return None,
+    };
+    Some(return_value)
+}
+
 #[macro_export]
 macro_rules! log_syscall_entry {
     ($syscall_name: tt) => {
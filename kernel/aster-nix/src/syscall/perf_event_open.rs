@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: MPL-2.0
+
+use super::SyscallReturn;
+use crate::{
+    fs::file_table::{FdFlags, FileDesc},
+    perf::{
+        PerfEvent, PerfEventAttr, PerfEventFile, PerfEventOpenFlags, PerfTarget,
+        PERF_ATTR_SIZE_VER0,
+    },
+    prelude::*,
+    thread::{thread_table, Tid},
+    util::{read_bytes_from_user, read_val_from_user, write_val_to_user},
+};
+
+pub fn sys_perf_event_open(
+    attr_addr: Vaddr,
+    pid: i32,
+    cpu: i32,
+    group_fd: FileDesc,
+    flags: u64,
+) -> Result<SyscallReturn> {
+    let flags = PerfEventOpenFlags::from_bits(flags)
+        .ok_or_else(|| Error::with_message(Errno::EINVAL, "unknown flags"))?;
+    debug!(
+        "attr_addr = 0x{:x}, pid = {}, cpu = {}, group_fd = {}, flags = {:?}",
+        attr_addr, pid, cpu, group_fd, flags
+    );
+
+    if flags.intersects(PerfEventOpenFlags::FD_OUTPUT | PerfEventOpenFlags::PID_CGROUP) {
+        return_errno_with_message!(Errno::EINVAL, "unsupported flags");
+    }
+    if group_fd != -1 {
+        return_errno_with_message!(Errno::EINVAL, "event groups are not supported");
+    }
+
+    let attr = read_attr_from_user(attr_addr)?;
+    debug!("attr = {:?}", attr);
+
+    let cpu = match cpu {
+        -1 => None,
+        cpu if cpu >= 0 && (cpu as u32) < ostd::cpu::num_cpus() => Some(cpu as u32),
+        _ => return_errno_with_message!(Errno::EINVAL, "invalid CPU"),
+    };
+    let target = match (pid, cpu) {
+        (-1, None) => {
+            return_errno_with_message!(Errno::EINVAL, "either the thread or the CPU is required")
+        }
+        (-1, Some(cpu)) => PerfTarget::Cpu(cpu),
+        (0, cpu) => PerfTarget::Thread {
+            thread: Arc::downgrade(&current_thread!()),
+            cpu,
+        },
+        (tid, cpu) if tid > 0 => {
+            let thread = thread_table::get_thread(tid as Tid)
+                .ok_or_else(|| Error::with_message(Errno::ESRCH, "the thread does not exist"))?;
+            PerfTarget::Thread {
+                thread: Arc::downgrade(&thread),
+                cpu,
+            }
+        }
+        _ => return_errno_with_message!(Errno::EINVAL, "invalid thread ID"),
+    };
+
+    let event = PerfEvent::new(&attr, target)?;
+    if let PerfTarget::Thread { thread, .. } = event.target() {
+        let thread = thread
+            .upgrade()
+            .ok_or_else(|| Error::with_message(Errno::ESRCH, "the thread has exited"))?;
+        thread.perf_events().attach(event.clone());
+    }
+    // Create the file before enabling the event, so that the event is detached from
+    // the thread when the file is dropped.
+    let file = Arc::new(PerfEventFile::new(event.clone()));
+    if event.is_initially_enabled() {
+        event.enable();
+    }
+
+    let fd = {
+        let current = current!();
+        let mut file_table = current.file_table().lock();
+        let fd_flags = if flags.contains(PerfEventOpenFlags::FD_CLOEXEC) {
+            FdFlags::CLOEXEC
+        } else {
+            FdFlags::empty()
+        };
+        file_table.insert(file, fd_flags)
+    };
+    Ok(SyscallReturn::Return(fd as _))
+}
+
+/// Reads the attributes of an event from the user space.
+///
+/// Only the `size` bytes of the attributes are read, where a size of zero stands
+/// for the first published version. The attributes may be of an older version than
+/// [`PerfEventAttr`], in which case the missing fields are zeros, or of a newer
+/// version, as long as the fields that are not understood are zeros.
+fn read_attr_from_user(attr_addr: Vaddr) -> Result<PerfEventAttr> {
+    let size_addr = attr_addr + size_of::<u32>();
+    let size = match read_val_from_user::<u32>(size_addr)? {
+        0 => PERF_ATTR_SIZE_VER0,
+        size => size,
+    } as usize;
+    let known_size = size_of::<PerfEventAttr>();
+
+    let mut attr = PerfEventAttr::default();
+    let is_valid = (PERF_ATTR_SIZE_VER0 as usize..=PAGE_SIZE).contains(&size) && {
+        let len = size.min(known_size);
+        read_bytes_from_user(
+            attr_addr,
+            &mut VmWriter::from(&mut attr.as_bytes_mut()[..len]),
+        )?;
+
+        let mut extra = vec![0u8; size - len];
+        read_bytes_from_user(attr_addr + len, &mut VmWriter::from(extra.as_mut_slice()))?;
+        extra.iter().all(|byte| *byte == 0)
+    };
+    if !is_valid {
+        // Tell the user space the size of the attributes that are understood.
+        write_val_to_user(size_addr, &(known_size as u32))?;
+        return_errno_with_message!(Errno::E2BIG, "the attributes are not supported");
+    }
+    attr.size = size as u32;
+
+    Ok(attr)
+}
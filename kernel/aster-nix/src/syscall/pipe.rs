@@ -4,8 +4,8 @@ use super::SyscallReturn;
 use crate::{
     fs::{
         file_table::{FdFlags, FileDesc},
-        pipe::{PipeReader, PipeWriter},
-        utils::{Channel, CreationFlags, StatusFlags},
+        pipe::new_pipe,
+        utils::{CreationFlags, StatusFlags},
     },
     prelude::*,
     util::{read_val_from_user, write_val_to_user},
@@ -15,16 +15,7 @@ pub fn sys_pipe2(fds: Vaddr, flags: u32) -> Result<SyscallReturn> {
     debug!("flags: {:?}", flags);
 
     let mut pipe_fds = read_val_from_user::<PipeFds>(fds)?;
-    let (reader, writer) = {
-        let (producer, consumer) = Channel::with_capacity_and_flags(
-            PIPE_BUF_SIZE,
-            StatusFlags::from_bits_truncate(flags),
-        )?
-        .split();
-        (PipeReader::new(consumer), PipeWriter::new(producer))
-    };
-    let pipe_reader = Arc::new(reader);
-    let pipe_writer = Arc::new(writer);
+    let (pipe_reader, pipe_writer) = new_pipe(StatusFlags::from_bits_truncate(flags))?;
     let fd_flags = if CreationFlags::from_bits_truncate(flags).contains(CreationFlags::O_CLOEXEC) {
         FdFlags::CLOEXEC
     } else {
@@ -51,5 +42,3 @@ struct PipeFds {
     reader_fd: FileDesc,
     writer_fd: FileDesc,
 }
-
-const PIPE_BUF_SIZE: usize = 1024 * 1024;
@@ -7,7 +7,7 @@ use crate::{
     events::IoEvents,
     fs::file_table::FileDesc,
     prelude::*,
-    process::signal::Poller,
+    process::{posix_thread::PosixThreadExt, signal::Poller},
     util::{read_val_from_user, write_val_to_user},
 };
 
@@ -51,44 +51,40 @@ pub fn sys_poll(fds: Vaddr, nfds: u64, timeout: i32) -> Result<SyscallReturn> {
 }
 
 pub fn do_poll(poll_fds: &[PollFd], timeout: Option<Duration>) -> Result<usize> {
+    // Return immediately if specifying a timeout of zero, in which case the files are
+    // polled without registering any poller
+    if timeout.is_some_and(|timeout| timeout.is_zero()) {
+        return poll_files(poll_fds, None);
+    }
+
+    // Reuse the poller cached in the current thread, which has been registered on
+    // the files polled last time
+    let current_thread = current_thread!();
+    let posix_thread = current_thread.as_posix_thread().unwrap();
+    let poller = posix_thread.poller().lock().take().unwrap_or_default();
+    let res = poll_until_ready(poll_fds, timeout, &poller);
+    *posix_thread.poller().lock() = Some(poller);
+
+    res
+}
+
+fn poll_until_ready(
+    poll_fds: &[PollFd],
+    timeout: Option<Duration>,
+    poller: &Poller,
+) -> Result<usize> {
     // The main loop of polling
-    let poller = Poller::new();
     loop {
-        let mut num_revents = 0;
-
-        for poll_fd in poll_fds {
-            // Skip poll_fd if it is not given a fd
-            let fd = match poll_fd.fd() {
-                Some(fd) => fd,
-                None => continue,
-            };
-
-            // Poll the file
-            let current = current!();
-            let file = {
-                let file_table = current.file_table().lock();
-                file_table.get_file(fd)?.clone()
-            };
-            let need_poller = if num_revents == 0 {
-                Some(&poller)
-            } else {
-                None
-            };
-            let revents = file.poll(poll_fd.events(), need_poller);
-            if !revents.is_empty() {
-                poll_fd.revents().set(revents);
-                num_revents += 1;
-            }
-        }
+        poller.start_round();
 
+        let num_revents = poll_files(poll_fds, Some(poller))?;
         if num_revents > 0 {
             return Ok(num_revents);
         }
 
-        // Return immediately if specifying a timeout of zero
-        if timeout.is_some() && timeout.as_ref().unwrap().is_zero() {
-            return Ok(0);
-        }
+        // All the files are polled with the poller, so the files that are polled
+        // last time but not this time will no longer wake up the poller.
+        poller.unregister_stale();
 
         if let Some(timeout) = timeout.as_ref() {
             poller.wait_timeout(timeout)?;
@@ -98,6 +94,34 @@ pub fn do_poll(poll_fds: &[PollFd], timeout: Option<Duration>) -> Result<usize>
     }
 }
 
+/// Polls the files and returns the number of files that have events.
+///
+/// The poller is registered on the files until one that has events is found, since
+/// there is no need to wait for the events on the rest.
+fn poll_files(poll_fds: &[PollFd], poller: Option<&Poller>) -> Result<usize> {
+    let current = current!();
+    let mut num_revents = 0;
+
+    for poll_fd in poll_fds {
+        // Skip poll_fd if it is not given a fd
+        let fd = match poll_fd.fd() {
+            Some(fd) => fd,
+            None => continue,
+        };
+
+        // Poll the file
+        let file = current.file_table().get_file(fd)?;
+        let need_poller = if num_revents == 0 { poller } else { None };
+        let revents = file.poll(poll_fd.events(), need_poller);
+        if !revents.is_empty() {
+            poll_fd.revents().set(revents);
+            num_revents += 1;
+        }
+    }
+
+    Ok(num_revents)
+}
+
 // https://github.com/torvalds/linux/blob/master/include/uapi/asm-generic/poll.h
 #[derive(Debug, Clone, Copy, Pod)]
 #[repr(C)]
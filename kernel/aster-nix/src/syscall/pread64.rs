@@ -19,8 +19,7 @@ pub fn sys_pread64(
     }
     let file = {
         let current = current!();
-        let filetable = current.file_table().lock();
-        filetable.get_file(fd)?.clone()
+        current.file_table().get_file(fd)?
     };
     // TODO: Check (f.file->f_mode & FMODE_PREAD); We don't have f_mode in our FileLike trait
     if user_buf_len == 0 {
@@ -59,8 +59,7 @@ fn do_sys_preadv(
 
     let file = {
         let current = current!();
-        let filetable = current.file_table().lock();
-        filetable.get_file(fd)?.clone()
+        current.file_table().get_file(fd)?
     };
 
     if io_vec_count == 0 {
@@ -126,39 +125,15 @@ fn do_sys_readv(fd: FileDesc, io_vec_ptr: Vaddr, io_vec_count: usize) -> Result<
 
     let file = {
         let current = current!();
-        let filetable = current.file_table().lock();
-        filetable.get_file(fd)?.clone()
+        current.file_table().get_file(fd)?
     };
 
     if io_vec_count == 0 {
         return Ok(0);
     }
 
-    let mut total_len = 0;
-
     let io_vecs = copy_iovs_from_user(io_vec_ptr, io_vec_count)?;
-    for io_vec in io_vecs.as_ref() {
-        if io_vec.is_empty() {
-            continue;
-        }
-
-        let mut buffer = vec![0u8; io_vec.len()];
-        // TODO: According to the man page
-        // at <https://man7.org/linux/man-pages/man2/readv.2.html>,
-        // readv must be atomic,
-        // but the current implementation does not ensure atomicity.
-        // A suitable fix would be to add a `readv` method for the `FileLike` trait,
-        // allowing each subsystem to implement atomicity.
-        let read_len = file.read(&mut buffer)?;
-        io_vec.write_exact_to_user(&buffer)?;
-        total_len += read_len;
-        if read_len == 0 || read_len < buffer.len() {
-            // End of file reached or no more data to read
-            break;
-        }
-    }
-
-    Ok(total_len)
+    file.read_vectored(&io_vecs)
 }
 
 bitflags! {
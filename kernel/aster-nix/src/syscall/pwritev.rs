@@ -54,8 +54,7 @@ fn do_sys_pwritev(
     }
     let file = {
         let current = current!();
-        let filetable = current.file_table().lock();
-        filetable.get_file(fd)?.clone()
+        current.file_table().get_file(fd)?
     };
     // TODO: Check (f.file->f_mode & FMODE_PREAD); We don't have f_mode in our FileLike trait
     if io_vec_count == 0 {
@@ -110,33 +109,11 @@ fn do_sys_writev(fd: FileDesc, io_vec_ptr: Vaddr, io_vec_count: usize) -> Result
     );
     let file = {
         let current = current!();
-        let filetable = current.file_table().lock();
-        filetable.get_file(fd)?.clone()
+        current.file_table().get_file(fd)?
     };
-    let mut total_len = 0;
 
     let io_vecs = copy_iovs_from_user(io_vec_ptr, io_vec_count)?;
-    for io_vec in io_vecs.as_ref() {
-        if io_vec.is_empty() {
-            continue;
-        }
-
-        let buffer = {
-            let mut buffer = vec![0u8; io_vec.len()];
-            io_vec.read_exact_from_user(&mut buffer)?;
-            buffer
-        };
-
-        // TODO: According to the man page
-        // at <https://man7.org/linux/man-pages/man2/readv.2.html>,
-        // writev must be atomic,
-        // but the current implementation does not ensure atomicity.
-        // A suitable fix would be to add a `writev` method for the `FileLike` trait,
-        // allowing each subsystem to implement atomicity.
-        let write_len = file.write(&buffer)?;
-        total_len += write_len;
-    }
-    Ok(total_len)
+    file.write_vectored(&io_vecs)
 }
 
 bitflags! {
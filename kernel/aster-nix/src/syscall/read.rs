@@ -11,8 +11,7 @@ pub fn sys_read(fd: FileDesc, user_buf_addr: Vaddr, buf_len: usize) -> Result<Sy
 
     let file = {
         let current = current!();
-        let file_table = current.file_table().lock();
-        file_table.get_file(fd)?.clone()
+        current.file_table().get_file(fd)?
     };
 
     let mut read_buf = vec![0u8; buf_len];
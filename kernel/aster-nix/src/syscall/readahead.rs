@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: MPL-2.0
+
+use super::SyscallReturn;
+use crate::{
+    fs::{
+        file_table::FileDesc,
+        inode_handle::InodeHandle,
+        utils::{FileAdvice, InodeType},
+    },
+    prelude::*,
+};
+
+pub fn sys_readahead(fd: FileDesc, offset: i64, count: usize) -> Result<SyscallReturn> {
+    debug!("fd = {}, offset = {}, count = {}", fd, offset, count);
+
+    if offset < 0 {
+        return_errno_with_message!(Errno::EINVAL, "the offset is negative");
+    }
+    let file = {
+        let current = current!();
+        current.file_table().get_file(fd)?
+    };
+    let inode_handle = file
+        .downcast_ref::<InodeHandle>()
+        .ok_or(Error::with_message(Errno::EINVAL, "not inode"))?;
+    if !inode_handle.access_mode().is_readable() {
+        return_errno_with_message!(Errno::EBADF, "the file is not opened for reading");
+    }
+    let inode = inode_handle.dentry().inode();
+    if inode.type_() != InodeType::File {
+        return_errno_with_message!(Errno::EINVAL, "not a regular file");
+    }
+    inode.advise(offset as usize, count, FileAdvice::WillNeed)?;
+    Ok(SyscallReturn::Return(0))
+}
@@ -30,9 +30,11 @@ pub fn sys_recvmsg(sockfd: FileDesc, user_msghdr_ptr: Vaddr, flags: i32) -> Resu
         c_user_msghdr.write_socket_addr_to_user(addr)?;
     }
 
-    if c_user_msghdr.msg_control != 0 {
-        warn!("receiving control message is not supported");
-    }
+    c_user_msghdr.write_control_message_to_user(
+        user_msghdr_ptr,
+        message_header.into_control_message(),
+        flags,
+    )?;
 
     Ok(SyscallReturn::Return(total_bytes as _))
 }
@@ -9,18 +9,13 @@ use crate::{
     util::write_val_to_user,
 };
 
-fn get_num_cpus() -> usize {
-    // TODO: Properly determine the number of available CPUs
-    // This could be through a system configuration query.
-    1
-}
-
 pub fn sys_sched_getaffinity(
     pid: Pid,
     cpuset_size: usize,
     cpu_set_ptr: Vaddr,
 ) -> Result<SyscallReturn> {
-    let num_cpus = get_num_cpus();
+    // Threads have no CPU affinity, so every thread may run on all the CPUs.
+    let num_cpus = ostd::cpu::num_cpus() as usize;
 
     if cpuset_size < core::mem::size_of::<cpu_set_t>() {
         return Err(Error::with_message(Errno::EINVAL, "invalid cpuset size"));
@@ -43,7 +38,9 @@ pub fn sys_sched_getaffinity(
 
     write_val_to_user(cpu_set_ptr, &dummy_cpu_set)?;
 
-    Ok(SyscallReturn::Return(0))
+    // Return the number of bytes written, which the C library relies on to clear the rest
+    // of the CPU set.
+    Ok(SyscallReturn::Return(mem::size_of::<cpu_set_t>() as _))
 }
 
 const CPU_SETSIZE: usize = 1024; // Max number of CPU bits.
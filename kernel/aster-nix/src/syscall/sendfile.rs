@@ -2,7 +2,11 @@
 
 use super::SyscallReturn;
 use crate::{
-    fs::file_table::FileDesc,
+    fs::{
+        file_handle::FileLike,
+        file_table::FileDesc,
+        utils::{SeekFrom, SpliceFlags},
+    },
     prelude::*,
     util::{read_val_from_user, write_val_to_user},
 };
@@ -38,10 +42,10 @@ pub fn sys_sendfile(
 
     let (out_file, in_file) = {
         let current = current!();
-        let file_table = current.file_table().lock();
-        let out_file = file_table.get_file(out_fd)?.clone();
+        let file_table = current.file_table();
+        let out_file = file_table.get_file(out_fd)?;
         // FIXME: the in_file must support mmap-like operations (i.e., it cannot be a socket).
-        let in_file = file_table.get_file(in_fd)?.clone();
+        let in_file = file_table.get_file(in_fd)?;
         (out_file, in_file)
     };
 
@@ -51,10 +55,104 @@ pub fn sys_sendfile(
         count = MAX_COUNT;
     }
 
+    let mut offset = offset.map(|offset| offset as usize);
+
+    // Hand the page frames of `in_file` to `out_file` if `in_file` is backed by
+    // page frames. Otherwise, fall back to copying the data through a buffer.
+    let res = match offset.as_mut() {
+        Some(offset) => send_frames(&out_file, &in_file, *offset, count).inspect(|len| {
+            *offset += len;
+        }),
+        None => in_file.seek(SeekFrom::Current(0)).and_then(|pos| {
+            let len = send_frames(&out_file, &in_file, pos, count)?;
+            in_file.seek(SeekFrom::Start(pos + len))?;
+            Ok(len)
+        }),
+    };
+    let total_len = match res {
+        Err(err) if matches!(err.error(), Errno::EOPNOTSUPP | Errno::ESPIPE) => {
+            copy_through_buffer(&out_file, &in_file, offset.as_mut(), count)?
+        }
+        res => res?,
+    };
+
+    if let Some(offset) = offset {
+        write_val_to_user(offset_ptr, &(offset as isize))?;
+    }
+
+    Ok(SyscallReturn::Return(total_len as _))
+}
+
+/// Sends at most `count` bytes at `offset` of `in_file` to `out_file`
+/// by handing the page frames that back the data to `out_file`.
+fn send_frames(
+    out_file: &Arc<dyn FileLike>,
+    in_file: &Arc<dyn FileLike>,
+    offset: usize,
+    count: usize,
+) -> Result<usize> {
+    // The maximum number of bytes that are read as frames at a time.
+    const MAX_FRAMES_LEN: usize = 16 * PAGE_SIZE;
+
+    let mut frames = Vec::with_capacity(MAX_FRAMES_LEN / PAGE_SIZE + 1);
+    let mut total_len = 0;
+
+    while total_len < count {
+        frames.clear();
+        let max_len = MAX_FRAMES_LEN.min(count - total_len);
+        let read_len = match in_file.read_frames_at(offset + total_len, max_len, &mut frames) {
+            Ok(len) => len,
+            Err(e) => {
+                if total_len > 0 {
+                    warn!("error occurs when trying to read file: {:?}", e);
+                    break;
+                }
+                return Err(e);
+            }
+        };
+
+        if read_len == 0 {
+            break;
+        }
+
+        // Like Linux, tell the output file that more data is coming, so that a socket
+        // can hold back small segments.
+        let flags = if total_len + read_len < count {
+            SpliceFlags::SPLICE_F_MORE
+        } else {
+            SpliceFlags::empty()
+        };
+        match out_file.write_frames(&frames, flags) {
+            Ok(len) => {
+                total_len += len;
+                if len < read_len {
+                    break;
+                }
+            }
+            Err(e) => {
+                if total_len > 0 {
+                    warn!("error occurs when trying to write file: {:?}", e);
+                    break;
+                }
+                return Err(e);
+            }
+        }
+    }
+
+    Ok(total_len)
+}
+
+/// Sends at most `count` bytes of `in_file` to `out_file` by copying the data
+/// through a buffer.
+fn copy_through_buffer(
+    out_file: &Arc<dyn FileLike>,
+    in_file: &Arc<dyn FileLike>,
+    mut offset: Option<&mut usize>,
+    count: usize,
+) -> Result<usize> {
     const BUFFER_SIZE: usize = PAGE_SIZE;
     let mut buffer = vec![0u8; BUFFER_SIZE].into_boxed_slice();
     let mut total_len = 0;
-    let mut offset = offset.map(|offset| offset as usize);
 
     while total_len < count {
         // The offset decides how to read from `in_file`.
@@ -67,9 +165,9 @@ pub fn sys_sendfile(
 
         // Read from `in_file`
         let read_res = if let Some(offset) = offset.as_mut() {
-            let res = in_file.read_at(*offset, &mut buffer[..max_readlen]);
+            let res = in_file.read_at(**offset, &mut buffer[..max_readlen]);
             if let Ok(len) = res.as_ref() {
-                *offset += *len;
+                **offset += *len;
             }
             res
         } else {
@@ -112,9 +210,5 @@ pub fn sys_sendfile(
         }
     }
 
-    if let Some(offset) = offset {
-        write_val_to_user(offset_ptr, &(offset as isize))?;
-    }
-
-    Ok(SyscallReturn::Return(total_len as _))
+    Ok(total_len)
 }
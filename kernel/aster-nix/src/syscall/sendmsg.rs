@@ -26,13 +26,7 @@ pub fn sys_sendmsg(sockfd: FileDesc, user_msghdr_ptr: Vaddr, flags: i32) -> Resu
         let addr = c_user_msghdr.read_socket_addr_from_user()?;
         let io_vecs = c_user_msghdr.copy_iovs_from_user()?;
 
-        let control_message = {
-            if c_user_msghdr.msg_control != 0 {
-                // TODO: support sending control message
-                warn!("control message is not supported now");
-            }
-            None
-        };
+        let control_message = c_user_msghdr.read_control_message_from_user()?;
 
         (io_vecs, MessageHeader::new(addr, control_message))
     };
@@ -31,7 +31,7 @@ pub fn sys_setsockopt(
 
         let current = current!();
         let vmar = current.root_vmar();
-        option.read_from_user(vmar, optval, optlen)?;
+        option.read_from_user(&vmar, optval, optlen)?;
 
         option
     };
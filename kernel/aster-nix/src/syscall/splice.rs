@@ -0,0 +1,345 @@
+// SPDX-License-Identifier: MPL-2.0
+
+use ostd::mm::FrameAllocOptions;
+
+use super::SyscallReturn;
+use crate::{
+    fs::{
+        file_handle::FileLike,
+        file_table::FileDesc,
+        pipe::{PipeReader, PipeWriter},
+        utils::{FrameSlice, SeekFrom, SpliceFlags},
+    },
+    prelude::*,
+    util::{
+        copy_iovs_from_user, read_bytes_from_user, read_val_from_user, write_bytes_to_user,
+        write_val_to_user, IoVec,
+    },
+};
+
+pub fn sys_splice(
+    fd_in: FileDesc,
+    off_in_ptr: Vaddr,
+    fd_out: FileDesc,
+    off_out_ptr: Vaddr,
+    len: usize,
+    flags: u32,
+) -> Result<SyscallReturn> {
+    let flags = SpliceFlags::from_bits(flags)
+        .ok_or_else(|| Error::with_message(Errno::EINVAL, "invalid splice flags"))?;
+    debug!(
+        "fd_in = {}, off_in_ptr = 0x{:x}, fd_out = {}, off_out_ptr = 0x{:x}, len = 0x{:x}, flags = {:?}",
+        fd_in, off_in_ptr, fd_out, off_out_ptr, len, flags
+    );
+
+    let (in_file, out_file) = get_files(fd_in, fd_out)?;
+    let is_nonblocking = flags.contains(SpliceFlags::SPLICE_F_NONBLOCK);
+    let len = len.min(MAX_SPLICE_LEN);
+
+    let in_pipe = in_file.downcast_ref::<PipeReader>();
+    let out_pipe = out_file.downcast_ref::<PipeWriter>();
+    if (in_pipe.is_some() && off_in_ptr != 0) || (out_pipe.is_some() && off_out_ptr != 0) {
+        return_errno_with_message!(Errno::ESPIPE, "the offset of a pipe must be NULL");
+    }
+
+    let spliced_len = match (in_pipe, out_pipe) {
+        (Some(in_pipe), Some(out_pipe)) => in_pipe.splice_to(out_pipe, len, is_nonblocking)?,
+        (Some(in_pipe), None) => splice_from_pipe(in_pipe, &out_file, off_out_ptr, len, flags)?,
+        (None, Some(out_pipe)) => {
+            splice_to_pipe(&in_file, out_pipe, off_in_ptr, len, is_nonblocking)?
+        }
+        (None, None) => {
+            return_errno_with_message!(Errno::EINVAL, "neither of the files is a pipe")
+        }
+    };
+
+    Ok(SyscallReturn::Return(spliced_len as _))
+}
+
+pub fn sys_tee(fd_in: FileDesc, fd_out: FileDesc, len: usize, flags: u32) -> Result<SyscallReturn> {
+    let flags = SpliceFlags::from_bits(flags)
+        .ok_or_else(|| Error::with_message(Errno::EINVAL, "invalid splice flags"))?;
+    debug!(
+        "fd_in = {}, fd_out = {}, len = 0x{:x}, flags = {:?}",
+        fd_in, fd_out, len, flags
+    );
+
+    let (in_file, out_file) = get_files(fd_in, fd_out)?;
+    let (Some(in_pipe), Some(out_pipe)) = (
+        in_file.downcast_ref::<PipeReader>(),
+        out_file.downcast_ref::<PipeWriter>(),
+    ) else {
+        return_errno_with_message!(Errno::EINVAL, "both of the files must be pipes");
+    };
+
+    let is_nonblocking = flags.contains(SpliceFlags::SPLICE_F_NONBLOCK);
+    let len = in_pipe.tee_to(out_pipe, len.min(MAX_SPLICE_LEN), is_nonblocking)?;
+    Ok(SyscallReturn::Return(len as _))
+}
+
+pub fn sys_vmsplice(
+    fd: FileDesc,
+    io_vec_ptr: Vaddr,
+    io_vec_count: usize,
+    flags: u32,
+) -> Result<SyscallReturn> {
+    let flags = SpliceFlags::from_bits(flags)
+        .ok_or_else(|| Error::with_message(Errno::EINVAL, "invalid splice flags"))?;
+    debug!(
+        "fd = {}, io_vec_ptr = 0x{:x}, io_vec_counter = 0x{:x}, flags = {:?}",
+        fd, io_vec_ptr, io_vec_count, flags
+    );
+
+    if io_vec_count > MAX_IO_VECS {
+        return_errno_with_message!(Errno::EINVAL, "too many IO vectors");
+    }
+
+    let file = {
+        let current = current!();
+        current.file_table().get_file(fd)?
+    };
+    let io_vecs = copy_iovs_from_user(io_vec_ptr, io_vec_count)?;
+    let is_nonblocking = flags.contains(SpliceFlags::SPLICE_F_NONBLOCK);
+
+    let len = if let Some(pipe) = file.downcast_ref::<PipeWriter>() {
+        vmsplice_to_pipe(pipe, &io_vecs, is_nonblocking)?
+    } else if let Some(pipe) = file.downcast_ref::<PipeReader>() {
+        let max_len = io_vecs.iter().map(|io_vec| io_vec.len()).sum();
+        pipe.splice_out(max_len, is_nonblocking, |frames| {
+            copy_frames_to_user(frames, &io_vecs)
+        })?
+    } else {
+        return_errno_with_message!(Errno::EBADF, "the file is not a pipe");
+    };
+
+    Ok(SyscallReturn::Return(len as _))
+}
+
+/// Splices from a pipe to a file that is not a pipe.
+///
+/// The flags are passed on to the file, e.g., so that a socket does not block with
+/// `SPLICE_F_NONBLOCK` and holds back small segments with `SPLICE_F_MORE`.
+fn splice_from_pipe(
+    in_pipe: &PipeReader,
+    out_file: &Arc<dyn FileLike>,
+    off_out_ptr: Vaddr,
+    len: usize,
+    flags: SpliceFlags,
+) -> Result<usize> {
+    if !out_file.access_mode().is_writable() {
+        return_errno_with_message!(Errno::EBADF, "the file is not writable");
+    }
+
+    let is_nonblocking = flags.contains(SpliceFlags::SPLICE_F_NONBLOCK);
+    if off_out_ptr == 0 {
+        return in_pipe.splice_out(len, is_nonblocking, |frames| {
+            out_file.write_frames(frames, flags)
+        });
+    }
+
+    let mut offset = read_offset_from_user(off_out_ptr)?;
+    let len = in_pipe.splice_out(len, is_nonblocking, |frames| {
+        write_frames_at(out_file, offset, frames)
+    })?;
+    offset += len;
+    write_val_to_user(off_out_ptr, &(offset as i64))?;
+    Ok(len)
+}
+
+/// Splices from a file that is not a pipe to a pipe.
+///
+/// If the file is backed by page frames, e.g., a file in the page cache, references to
+/// the frames are put into the pipe. Otherwise, the data is copied into new frames.
+fn splice_to_pipe(
+    in_file: &Arc<dyn FileLike>,
+    out_pipe: &PipeWriter,
+    off_in_ptr: Vaddr,
+    len: usize,
+    is_nonblocking: bool,
+) -> Result<usize> {
+    if !in_file.access_mode().is_readable() {
+        return_errno_with_message!(Errno::EBADF, "the file is not readable");
+    }
+
+    let pos = if off_in_ptr != 0 {
+        Some(read_offset_from_user(off_in_ptr)?)
+    } else {
+        match in_file.seek(SeekFrom::Current(0)) {
+            Ok(pos) => Some(pos),
+            Err(err) if err.error() == Errno::ESPIPE => None,
+            Err(err) => return Err(err),
+        }
+    };
+
+    let mut frames = Vec::new();
+    let res = match pos {
+        Some(pos) => in_file.read_frames_at(pos, len.min(MAX_FRAMES_LEN), &mut frames),
+        None => Err(Error::with_message(
+            Errno::EOPNOTSUPP,
+            "the file is not seekable",
+        )),
+    };
+    let spliced_len = match res {
+        Ok(0) => 0,
+        Ok(_) => out_pipe.splice_in(&frames, is_nonblocking)?,
+        Err(err) if err.error() == Errno::EOPNOTSUPP => {
+            copy_to_pipe(in_file, out_pipe, pos, len, is_nonblocking)?
+        }
+        Err(err) => return Err(err),
+    };
+
+    if let Some(pos) = pos {
+        let new_pos = pos + spliced_len;
+        if off_in_ptr != 0 {
+            write_val_to_user(off_in_ptr, &(new_pos as i64))?;
+        } else {
+            in_file.seek(SeekFrom::Start(new_pos))?;
+        }
+    }
+    Ok(spliced_len)
+}
+
+/// Copies at most one page of data from a file to a pipe.
+///
+/// The file offset is not updated, since the caller will do it.
+fn copy_to_pipe(
+    in_file: &Arc<dyn FileLike>,
+    out_pipe: &PipeWriter,
+    pos: Option<usize>,
+    len: usize,
+    is_nonblocking: bool,
+) -> Result<usize> {
+    // Make sure that the data can be put into the pipe before reading (and thus
+    // consuming) it from the file.
+    out_pipe.wait_writable(is_nonblocking)?;
+
+    let mut buffer = vec![0u8; len.min(PAGE_SIZE)].into_boxed_slice();
+    let read_len = match pos {
+        Some(pos) => in_file.read_at(pos, &mut buffer)?,
+        None => in_file.read(&mut buffer)?,
+    };
+    if read_len == 0 {
+        return Ok(0);
+    }
+
+    let frame = FrameAllocOptions::new(1).uninit(true).alloc_single()?;
+    frame
+        .writer()
+        .write(&mut VmReader::from(&buffer[..read_len]));
+    out_pipe.splice_in(&[FrameSlice::new(frame, 0..read_len)], is_nonblocking)
+}
+
+/// Copies the user buffers into new frames, which are then put into the pipe.
+fn vmsplice_to_pipe(pipe: &PipeWriter, io_vecs: &[IoVec], is_nonblocking: bool) -> Result<usize> {
+    let mut total_len = 0;
+
+    for io_vec in io_vecs.iter().filter(|io_vec| !io_vec.is_empty()) {
+        let mut pos = 0;
+        while pos < io_vec.len() {
+            let res = pipe.wait_writable(is_nonblocking).and_then(|_| {
+                let len = (io_vec.len() - pos).min(PAGE_SIZE);
+                let frame = FrameAllocOptions::new(1).uninit(true).alloc_single()?;
+                read_bytes_from_user(io_vec.base() + pos, &mut frame.writer().limit(len))?;
+                pipe.splice_in(&[FrameSlice::new(frame, 0..len)], is_nonblocking)
+            });
+            match res {
+                Ok(len) => {
+                    total_len += len;
+                    pos += len;
+                }
+                Err(_) if total_len > 0 => return Ok(total_len),
+                Err(err) => return Err(err),
+            }
+        }
+    }
+
+    Ok(total_len)
+}
+
+fn copy_frames_to_user(frames: &[FrameSlice], io_vecs: &[IoVec]) -> Result<usize> {
+    let mut total_len = 0;
+    let mut io_vecs = io_vecs.iter().filter(|io_vec| !io_vec.is_empty());
+    let Some(mut io_vec) = io_vecs.next() else {
+        return Ok(0);
+    };
+    let mut pos_in_io_vec = 0;
+
+    for frame in frames {
+        let mut pos_in_frame = 0;
+        while pos_in_frame < frame.len() {
+            if pos_in_io_vec == io_vec.len() {
+                let Some(next_io_vec) = io_vecs.next() else {
+                    return Ok(total_len);
+                };
+                io_vec = next_io_vec;
+                pos_in_io_vec = 0;
+            }
+
+            let len = (frame.len() - pos_in_frame).min(io_vec.len() - pos_in_io_vec);
+            let res = write_bytes_to_user(
+                io_vec.base() + pos_in_io_vec,
+                &mut frame.reader().skip(pos_in_frame).limit(len),
+            );
+            match res {
+                Ok(()) => {
+                    pos_in_frame += len;
+                    pos_in_io_vec += len;
+                    total_len += len;
+                }
+                Err(_) if total_len > 0 => return Ok(total_len),
+                Err(err) => return Err(err),
+            }
+        }
+    }
+
+    Ok(total_len)
+}
+
+/// Writes the data of the frame slices to the file at the given offset.
+fn write_frames_at(
+    file: &Arc<dyn FileLike>,
+    offset: usize,
+    frames: &[FrameSlice],
+) -> Result<usize> {
+    let mut buffer = vec![0u8; PAGE_SIZE].into_boxed_slice();
+    let mut written_len = 0;
+    for frame in frames {
+        let len = frame.reader().read(&mut VmWriter::from(&mut buffer[..]));
+        match file.write_at(offset + written_len, &buffer[..len]) {
+            Ok(n) => {
+                written_len += n;
+                if n < len {
+                    break;
+                }
+            }
+            Err(_) if written_len > 0 => break,
+            Err(err) => return Err(err),
+        }
+    }
+    Ok(written_len)
+}
+
+fn get_files(fd_in: FileDesc, fd_out: FileDesc) -> Result<(Arc<dyn FileLike>, Arc<dyn FileLike>)> {
+    let current = current!();
+    let file_table = current.file_table();
+    let in_file = file_table.get_file(fd_in)?;
+    let out_file = file_table.get_file(fd_out)?;
+    Ok((in_file, out_file))
+}
+
+fn read_offset_from_user(offset_ptr: Vaddr) -> Result<usize> {
+    let offset: i64 = read_val_from_user(offset_ptr)?;
+    if offset < 0 {
+        return_errno_with_message!(Errno::EINVAL, "offset cannot be negative");
+    }
+    Ok(offset as usize)
+}
+
+/// The maximum number of bytes that can be spliced at a time.
+const MAX_SPLICE_LEN: usize = 0x7fff_f000;
+
+/// The maximum number of bytes that are read as frames from a file at a time.
+const MAX_FRAMES_LEN: usize = 16 * PAGE_SIZE;
+
+/// The maximum number of IO vectors of `vmsplice`.
+const MAX_IO_VECS: usize = 1024;
@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: MPL-2.0
+
+//! The statistics of the system calls.
+//!
+//! Each CPU counts the system calls that it handles, and records their latencies in
+//! log2 histograms. The statistics are updated without locking, and are summed up
+//! over all the CPUs when they are read.
+
+use core::sync::atomic::{AtomicU64, Ordering};
+
+use ostd::{
+    arch::{read_tsc, tsc_freq},
+    cpu::{num_cpus, this_cpu},
+};
+use spin::Once;
+
+use crate::prelude::*;
+
+/// The number of system call numbers that are counted.
+const NR_SYSCALL_SLOTS: usize = 512;
+/// The number of the buckets of the latency histograms.
+///
+/// The `i`-th bucket counts the latencies within `[2^i, 2^(i + 1))` nanoseconds,
+/// except that the first bucket also counts the zero latencies and the last bucket
+/// also counts all the longer latencies.
+pub const NR_LATENCY_BUCKETS: usize = 32;
+
+/// The statistics of a system call.
+#[derive(Debug)]
+pub struct SyscallStats {
+    pub syscall_number: u64,
+    /// The name of the system call, e.g., `SYS_READ`, or `None` if it is not implemented.
+    pub syscall_name: Option<&'static str>,
+    pub count: u64,
+    pub total_ns: u64,
+    pub latency_buckets: [u64; NR_LATENCY_BUCKETS],
+}
+
+struct SyscallCounter {
+    count: AtomicU64,
+    total_ns: AtomicU64,
+    latency_buckets: [AtomicU64; NR_LATENCY_BUCKETS],
+}
+
+struct StatsTable {
+    per_cpu_counters: Box<[Box<[SyscallCounter]>]>,
+    /// The number of nanoseconds per TSC cycle, scaled by `2^32`.
+    ns_per_cycle: u64,
+}
+
+static STATS_TABLE: Once<StatsTable> = Once::new();
+
+fn stats_table() -> &'static StatsTable {
+    STATS_TABLE.call_once(|| {
+        let per_cpu_counters = (0..num_cpus())
+            .map(|_| {
+                (0..NR_SYSCALL_SLOTS)
+                    .map(|_| SyscallCounter::new())
+                    .collect()
+            })
+            .collect();
+        let ns_per_cycle = match tsc_freq() {
+            0 => 0,
+            freq => ((1_000_000_000u128 << 32) / freq as u128) as u64,
+        };
+        StatsTable {
+            per_cpu_counters,
+            ns_per_cycle,
+        }
+    })
+}
+
+/// Returns the start time of a system call, which is passed to [`record`].
+pub(super) fn start_time() -> u64 {
+    read_tsc()
+}
+
+/// Records a system call that has been handled, which started at `start_time`.
+pub(super) fn record(syscall_number: u64, start_time: u64) {
+    if syscall_number as usize >= NR_SYSCALL_SLOTS {
+        return;
+    }
+    let table = stats_table();
+    let cycles = read_tsc().saturating_sub(start_time);
+    let latency_ns = ((cycles as u128 * table.ns_per_cycle as u128) >> 32) as u64;
+
+    // The current task may be migrated to another CPU since the CPU is got. That's
+    // fine since the counters of any CPU are updated atomically.
+    let counter = &table.per_cpu_counters[this_cpu() as usize][syscall_number as usize];
+    counter.count.fetch_add(1, Ordering::Relaxed);
+    counter.total_ns.fetch_add(latency_ns, Ordering::Relaxed);
+    let bucket = (u64::BITS - 1 - latency_ns.max(1).leading_zeros()) as usize;
+    counter.latency_buckets[bucket.min(NR_LATENCY_BUCKETS - 1)].fetch_add(1, Ordering::Relaxed);
+}
+
+/// Returns the statistics of the system calls that have been handled, in the
+/// ascending order of the system call numbers.
+pub fn syscall_stats() -> Vec<SyscallStats> {
+    let table = stats_table();
+    (0..NR_SYSCALL_SLOTS)
+        .filter_map(|slot| {
+            let mut stats = SyscallStats {
+                syscall_number: slot as u64,
+                syscall_name: super::arch::syscall_name(slot as u64),
+                count: 0,
+                total_ns: 0,
+                latency_buckets: [0; NR_LATENCY_BUCKETS],
+            };
+            for counters in table.per_cpu_counters.iter() {
+                let counter = &counters[slot];
+                stats.count += counter.count.load(Ordering::Relaxed);
+                stats.total_ns += counter.total_ns.load(Ordering::Relaxed);
+                for (sum, bucket) in stats
+                    .latency_buckets
+                    .iter_mut()
+                    .zip(counter.latency_buckets.iter())
+                {
+                    *sum += bucket.load(Ordering::Relaxed);
+                }
+            }
+            (stats.count > 0).then_some(stats)
+        })
+        .collect()
+}
+
+impl SyscallCounter {
+    fn new() -> Self {
+        Self {
+            count: AtomicU64::new(0),
+            total_ns: AtomicU64::new(0),
+            latency_buckets: core::array::from_fn(|_| AtomicU64::new(0)),
+        }
+    }
+}
@@ -18,8 +18,7 @@ pub fn sys_ftruncate(fd: FileDesc, len: isize) -> Result<SyscallReturn> {
     check_length(len)?;
 
     let current = current!();
-    let file_table = current.file_table().lock();
-    let file = file_table.get_file(fd)?;
+    let file = current.file_table().get_file(fd)?;
     file.resize(len as usize)?;
     Ok(SyscallReturn::Return(0))
 }
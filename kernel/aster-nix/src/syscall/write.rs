@@ -16,8 +16,7 @@ pub fn sys_write(fd: FileDesc, user_buf_ptr: Vaddr, user_buf_len: usize) -> Resu
 
     let file = {
         let current = current!();
-        let file_table = current.file_table().lock();
-        file_table.get_file(fd)?.clone()
+        current.file_table().get_file(fd)?
     };
 
     if user_buf_len == 0 {
@@ -154,6 +154,10 @@ pub(super) fn init() {
 ///
 /// If the `Taskless` is ready to be executed, it will be set to not scheduled
 /// and can be scheduled again.
+///
+/// At most `TASKLESS_BUDGET` jobs are executed each time. The remaining jobs are
+/// put back to the input `taskless_list` and the softirq is raised again, so that
+/// other softirqs and tasks are not starved by a long list of jobs.
 fn taskless_softirq_handler(
     taskless_list: &'static CpuLocal<SpinLock<LinkedList<TasklessAdapter>>>,
     softirq_id: u8,
@@ -163,7 +167,12 @@ fn taskless_softirq_handler(
         LinkedList::take(&mut list_mut)
     });
 
-    while let Some(taskless) = processing_list.pop_back() {
+    const TASKLESS_BUDGET: usize = 64;
+
+    for _ in 0..TASKLESS_BUDGET {
+        let Some(taskless) = processing_list.pop_back() else {
+            return;
+        };
         if taskless
             .is_running
             .compare_exchange(false, true, Ordering::Acquire, Ordering::Relaxed)
@@ -183,6 +192,18 @@ fn taskless_softirq_handler(
         (taskless.callback.borrow_mut())();
         taskless.is_running.store(false, Ordering::Release);
     }
+
+    if processing_list.is_empty() {
+        return;
+    }
+    // Keep the order of the remaining jobs, which are older than the newly scheduled ones.
+    CpuLocal::borrow_with(taskless_list, |list| {
+        let mut list_mut = list.lock_irq_disabled();
+        while let Some(taskless) = processing_list.pop_front() {
+            list_mut.push_back(taskless);
+        }
+    });
+    SoftIrqLine::get(softirq_id).raise();
 }
 
 #[cfg(ktest)]
@@ -7,10 +7,11 @@ use core::sync::atomic::{AtomicU32, Ordering};
 use ostd::task::Task;
 
 use self::status::{AtomicThreadStatus, ThreadStatus};
-use crate::prelude::*;
+use crate::{perf::PerfEventContext, prelude::*, sched::SchedEntity};
 
 pub mod exception;
 pub mod kernel_thread;
+pub(crate) mod softirq_daemon;
 pub mod status;
 pub mod task;
 pub mod thread_table;
@@ -32,6 +33,10 @@ pub struct Thread {
 
     // mutable part
     status: AtomicThreadStatus,
+    /// Scheduling state and runtime statistics
+    sched_entity: SchedEntity,
+    /// Performance events attached to the thread
+    perf_events: PerfEventContext,
 }
 
 impl Thread {
@@ -47,6 +52,8 @@ impl Thread {
             task,
             data: Box::new(data),
             status: AtomicThreadStatus::new(status),
+            sched_entity: SchedEntity::new(),
+            perf_events: PerfEventContext::new(),
         }
     }
 
@@ -90,6 +97,16 @@ impl Thread {
         self.status.store(new_status, Ordering::Release);
     }
 
+    /// Returns the scheduling state and runtime statistics.
+    pub fn sched_entity(&self) -> &SchedEntity {
+        &self.sched_entity
+    }
+
+    /// Returns the performance events attached to the thread.
+    pub fn perf_events(&self) -> &PerfEventContext {
+        &self.perf_events
+    }
+
     pub fn yield_now() {
         Task::yield_now()
     }
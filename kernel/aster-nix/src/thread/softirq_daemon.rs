@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: MPL-2.0
+
+//! The softirq daemons.
+//!
+//! The softirqs are processed on the exit of interrupts within a budget. Once the
+//! budget is exhausted, e.g., under a flood of network packets, the remaining softirqs
+//! are deferred to the softirq daemon of the CPU, which is a kernel thread that is
+//! scheduled like the others, so that the user tasks are not starved by the softirqs.
+//! Like `ksoftirqd` on Linux, the daemon has the normal priority. A real-time daemon
+//! would be picked again right after it yields.
+
+use ostd::{
+    cpu::{num_cpus, CpuSet},
+    trap::handle_deferred,
+};
+
+use crate::{
+    thread::kernel_thread::{KernelThreadExt, ThreadOptions},
+    Thread,
+};
+
+/// Spawns a softirq daemon for each CPU.
+pub(crate) fn init() {
+    for cpu in 0..num_cpus() {
+        let mut cpu_affinity = CpuSet::new_empty();
+        cpu_affinity.add(cpu);
+        Thread::spawn_kernel_thread(
+            ThreadOptions::new(|| loop {
+                handle_deferred();
+                // Let the other tasks make progress between the rounds of softirqs.
+                Thread::yield_now();
+            })
+            .cpu_affinity(cpu_affinity),
+        );
+    }
+}
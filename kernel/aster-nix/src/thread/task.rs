@@ -44,7 +44,7 @@ pub fn create_new_user_task(user_space: Arc<UserSpace>, thread_ref: Weak<Thread>
             // handle user event:
             match return_reason {
                 ReturnReason::UserException => handle_exception(context),
-                ReturnReason::UserSyscall => handle_syscall(context),
+                ReturnReason::UserSyscall => handle_syscall(context, &current_thread),
                 ReturnReason::KernelEvent => {}
             };
 
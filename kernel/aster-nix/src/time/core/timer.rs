@@ -2,16 +2,16 @@
 
 use alloc::{
     boxed::Box,
-    collections::BinaryHeap,
     sync::{Arc, Weak},
     vec::Vec,
 };
 use core::{
-    sync::atomic::{AtomicBool, Ordering},
+    sync::atomic::{AtomicBool, AtomicU64, AtomicUsize, Ordering},
     time::Duration,
 };
 
-use ostd::sync::SpinLock;
+use aster_time::NANOS_PER_SECOND;
+use ostd::{arch::timer::TIMER_FREQ, sync::SpinLock};
 
 use super::Clock;
 
@@ -64,7 +64,7 @@ impl Timer {
     pub fn cancel(&self) {
         let timer_callback = self.timer_callback.lock_irq_disabled();
         if let Some(timer_callback) = timer_callback.upgrade() {
-            timer_callback.cancel();
+            self.timer_manager.cancel(&timer_callback);
         }
     }
 
@@ -90,7 +90,7 @@ impl Timer {
 
         let mut timer_callback = self.timer_callback.lock_irq_disabled();
         if let Some(timer_callback) = timer_callback.upgrade() {
-            timer_callback.cancel();
+            self.timer_manager.cancel(&timer_callback);
         }
         *timer_callback = Arc::downgrade(&new_timer_callback);
         self.timer_manager.insert(new_timer_callback);
@@ -128,6 +128,12 @@ impl Timer {
     }
 }
 
+impl Drop for Timer {
+    fn drop(&mut self) {
+        self.cancel();
+    }
+}
+
 fn interval_timer_callback(timer: &Weak<Timer>) {
     let Some(timer) = timer.upgrade() else {
         return;
@@ -145,52 +151,81 @@ fn interval_timer_callback(timer: &Weak<Timer>) {
 ///
 /// These created `Timer`s will hold an `Arc` pointer to this manager, hence this manager
 /// will be actually dropped after all the created timers have been dropped.
+///
+/// The timers are kept in a hierarchical timing wheel, so setting and cancelling a timer
+/// take constant time. The manager also tracks a lower bound of the next expiry so that
+/// [`TimerManager::process_expired_timers`] returns without locking until the bound is
+/// reached, rather than processing the timers on each tick.
 pub struct TimerManager {
     clock: Arc<dyn Clock>,
-    timer_callbacks: SpinLock<BinaryHeap<Arc<TimerCallback>>>,
+    timer_wheel: SpinLock<TimerWheel>,
+    /// The tick before which no timers will expire.
+    next_expiry: AtomicU64,
 }
 
 impl TimerManager {
     /// Create a `TimerManager` instance from a clock.
     pub fn new(clock: Arc<dyn Clock>) -> Arc<Self> {
+        let current_tick = duration_to_ticks(clock.read_time());
         Arc::new(Self {
             clock,
-            timer_callbacks: SpinLock::new(BinaryHeap::new()),
+            timer_wheel: SpinLock::new(TimerWheel::new(current_tick)),
+            next_expiry: AtomicU64::new(u64::MAX),
         })
     }
 
     fn insert(&self, timer_callback: Arc<TimerCallback>) {
-        self.timer_callbacks
-            .lock_irq_disabled()
-            .push(timer_callback);
+        let expired_tick = timer_callback.expired_tick();
+        let mut timer_wheel = self.timer_wheel.lock_irq_disabled();
+        timer_wheel.insert(timer_callback);
+        self.next_expiry.fetch_min(expired_tick, Ordering::Release);
+    }
+
+    fn cancel(&self, timer_callback: &TimerCallback) {
+        timer_callback.cancel();
+        self.timer_wheel.lock_irq_disabled().remove(timer_callback);
+    }
+
+    /// Returns a lower bound of the time when the next timer expires,
+    /// or `None` if there are no timers.
+    pub fn next_expiry(&self) -> Option<Duration> {
+        let next_expiry = self.next_expiry.load(Ordering::Acquire);
+        (next_expiry != u64::MAX).then(|| ticks_to_duration(next_expiry))
     }
 
     /// Check the managed timers, and if any have timed out,
     /// call the corresponding callback functions.
     pub fn process_expired_timers(&self) {
-        let callbacks = {
-            let mut timeout_list = self.timer_callbacks.lock_irq_disabled();
-            if timeout_list.len() == 0 {
-                return;
-            }
+        let current_time = self.clock.read_time();
+        let current_tick = duration_to_ticks(current_time);
+        if current_tick < self.next_expiry.load(Ordering::Acquire) {
+            return;
+        }
 
+        let mut callbacks = {
+            let mut timer_wheel = self.timer_wheel.lock_irq_disabled();
             let mut callbacks = Vec::new();
-            let current_time = self.clock.read_time();
-            while let Some(t) = timeout_list.peek() {
-                if t.is_cancelled() {
-                    // Just ignore the cancelled callback
-                    timeout_list.pop();
-                } else if t.expired_time <= current_time {
-                    callbacks.push(timeout_list.pop().unwrap());
-                } else {
-                    break;
-                }
+            timer_wheel.advance(current_tick, &mut callbacks);
+
+            // The callbacks expiring later in the current tick are processed next time.
+            let (expired, pending): (Vec<_>, Vec<_>) = callbacks
+                .into_iter()
+                .partition(|callback| callback.expired_time <= current_time);
+            for callback in pending {
+                timer_wheel.insert(callback);
             }
-            callbacks
+
+            self.next_expiry
+                .store(timer_wheel.next_expiry(), Ordering::Release);
+            expired
         };
 
+        callbacks.sort_unstable_by_key(|callback| callback.expired_time);
         for callback in callbacks {
-            (callback.callback)();
+            // The callback may be cancelled after it is taken from the timer wheel.
+            if !callback.is_cancelled() {
+                (callback.callback)();
+            }
         }
     }
 
@@ -203,11 +238,172 @@ impl TimerManager {
     }
 }
 
+/// The length of a tick of the timer wheel.
+const NANOS_PER_TICK: u64 = NANOS_PER_SECOND as u64 / TIMER_FREQ;
+
+/// Converts the time to the tick that it is in.
+fn duration_to_ticks(time: Duration) -> u64 {
+    (time.as_nanos() / NANOS_PER_TICK as u128) as u64
+}
+
+fn ticks_to_duration(ticks: u64) -> Duration {
+    Duration::from_nanos(ticks.saturating_mul(NANOS_PER_TICK))
+}
+
+const LEVEL_BITS: u32 = 6;
+const NR_SLOTS_PER_LEVEL: usize = 1 << LEVEL_BITS;
+const NR_LEVELS: usize = 6;
+
+/// A hierarchical timing wheel.
+///
+/// The wheel has `NR_LEVELS` levels of `NR_SLOTS_PER_LEVEL` slots. A slot of the level `n`
+/// covers `NR_SLOTS_PER_LEVEL^n` ticks, and a timer is put into the lowest level that can
+/// cover its expiry. When the current tick goes across the range of a slot of a lower
+/// level, the timers in the corresponding slot of the higher level are cascaded down.
+///
+/// The timers expiring beyond the range of the highest level are put into its farthest
+/// slot, and are placed again when they are cascaded.
+struct TimerWheel {
+    /// The current tick. The timers expiring before it have been processed.
+    current_tick: u64,
+    /// The slots of all the levels, which are allocated when the first timer is inserted.
+    slots: Vec<Vec<Arc<TimerCallback>>>,
+    nr_timers: usize,
+}
+
+impl TimerWheel {
+    const fn new(current_tick: u64) -> Self {
+        Self {
+            current_tick,
+            slots: Vec::new(),
+            nr_timers: 0,
+        }
+    }
+
+    fn insert(&mut self, timer_callback: Arc<TimerCallback>) {
+        if self.slots.is_empty() {
+            self.slots
+                .resize_with(NR_LEVELS * NR_SLOTS_PER_LEVEL, Vec::new);
+        }
+
+        let slot_idx = self.slot_index_of(timer_callback.expired_tick());
+        let slot = &mut self.slots[slot_idx];
+        timer_callback.set_position(slot_idx, slot.len());
+        slot.push(timer_callback);
+        self.nr_timers += 1;
+    }
+
+    fn remove(&mut self, timer_callback: &TimerCallback) {
+        let Some((slot_idx, idx)) = timer_callback.position() else {
+            return;
+        };
+        let slot = &mut self.slots[slot_idx];
+        let removed = slot.swap_remove(idx);
+        debug_assert!(core::ptr::eq(Arc::as_ptr(&removed), timer_callback));
+        removed.clear_position();
+        if let Some(moved) = slot.get(idx) {
+            moved.set_position(slot_idx, idx);
+        }
+        self.nr_timers -= 1;
+    }
+
+    /// Takes the timer callbacks of a slot.
+    fn take_slot(&mut self, slot_idx: usize) -> Vec<Arc<TimerCallback>> {
+        let slot = core::mem::take(&mut self.slots[slot_idx]);
+        self.nr_timers -= slot.len();
+        for timer_callback in slot.iter() {
+            timer_callback.clear_position();
+        }
+        slot
+    }
+
+    /// Processes the ticks until `current_tick` (inclusive), and collects the timer
+    /// callbacks expiring in these ticks.
+    ///
+    /// The timer callbacks that are inserted in the current tick later are collected
+    /// when the current tick is processed again.
+    fn advance(&mut self, current_tick: u64, expired: &mut Vec<Arc<TimerCallback>>) {
+        if current_tick < self.current_tick {
+            return;
+        }
+        if self.nr_timers == 0 {
+            self.current_tick = current_tick;
+            return;
+        }
+
+        // If the wheel is not processed for a long time, placing the timers again is
+        // cheaper than processing the ticks one by one.
+        if current_tick - self.current_tick >= (NR_SLOTS_PER_LEVEL * NR_SLOTS_PER_LEVEL) as u64 {
+            let timer_callbacks: Vec<_> = (0..self.slots.len())
+                .flat_map(|slot_idx| self.take_slot(slot_idx))
+                .collect();
+            self.current_tick = current_tick;
+            for timer_callback in timer_callbacks {
+                self.insert(timer_callback);
+            }
+        }
+
+        loop {
+            let tick = self.current_tick;
+            for level in 1..NR_LEVELS {
+                if tick & ((1 << (LEVEL_BITS * level as u32)) - 1) != 0 {
+                    break;
+                }
+                let slot_idx = level * NR_SLOTS_PER_LEVEL + Self::level_slot_of(tick, level);
+                for timer_callback in self.take_slot(slot_idx) {
+                    self.insert(timer_callback);
+                }
+            }
+
+            expired.extend(self.take_slot(Self::level_slot_of(tick, 0)));
+            if tick == current_tick {
+                break;
+            }
+            self.current_tick += 1;
+        }
+    }
+
+    /// Returns the tick before which no timers will expire.
+    fn next_expiry(&self) -> u64 {
+        if self.nr_timers == 0 {
+            return u64::MAX;
+        }
+
+        // The timers in the lowest level are exact. The other timers can only expire
+        // after they are cascaded, which happens at the next round of the lowest level.
+        let next_round = self.current_tick | (NR_SLOTS_PER_LEVEL as u64 - 1);
+        (self.current_tick..=next_round)
+            .find(|&tick| !self.slots[Self::level_slot_of(tick, 0)].is_empty())
+            .unwrap_or(next_round + 1)
+    }
+
+    fn slot_index_of(&self, expired_tick: u64) -> usize {
+        let expired_tick = expired_tick.max(self.current_tick);
+        let delta = expired_tick - self.current_tick;
+        for level in 0..NR_LEVELS {
+            if delta < 1 << (LEVEL_BITS * (level as u32 + 1)) {
+                return level * NR_SLOTS_PER_LEVEL + Self::level_slot_of(expired_tick, level);
+            }
+        }
+
+        let max_tick = self.current_tick + (1 << (LEVEL_BITS * NR_LEVELS as u32)) - 1;
+        (NR_LEVELS - 1) * NR_SLOTS_PER_LEVEL + Self::level_slot_of(max_tick, NR_LEVELS - 1)
+    }
+
+    fn level_slot_of(tick: u64, level: usize) -> usize {
+        (tick >> (LEVEL_BITS * level as u32)) as usize & (NR_SLOTS_PER_LEVEL - 1)
+    }
+}
+
 /// A `TimerCallback` can be used to execute a timer callback function.
 struct TimerCallback {
     expired_time: Duration,
     callback: Box<dyn Fn() + Send + Sync>,
     is_cancelled: AtomicBool,
+    /// The slot in the timer wheel, which is protected by the lock of the timer wheel.
+    slot_idx: AtomicUsize,
+    /// The index in the slot, which is protected by the lock of the timer wheel.
+    idx: AtomicUsize,
 }
 
 impl TimerCallback {
@@ -217,9 +413,15 @@ impl TimerCallback {
             expired_time: timeout,
             callback,
             is_cancelled: AtomicBool::new(false),
+            slot_idx: AtomicUsize::new(usize::MAX),
+            idx: AtomicUsize::new(0),
         }
     }
 
+    fn expired_tick(&self) -> u64 {
+        duration_to_ticks(self.expired_time)
+    }
+
     /// Cancel a `TimerCallback`. If the callback function has not been called,
     /// it will never be called again.
     fn cancel(&self) {
@@ -230,27 +432,82 @@ impl TimerCallback {
     fn is_cancelled(&self) -> bool {
         self.is_cancelled.load(Ordering::Acquire)
     }
-}
 
-impl PartialEq for TimerCallback {
-    fn eq(&self, other: &Self) -> bool {
-        self.expired_time == other.expired_time
+    fn position(&self) -> Option<(usize, usize)> {
+        let slot_idx = self.slot_idx.load(Ordering::Relaxed);
+        (slot_idx != usize::MAX).then(|| (slot_idx, self.idx.load(Ordering::Relaxed)))
     }
-}
 
-impl Eq for TimerCallback {}
+    fn set_position(&self, slot_idx: usize, idx: usize) {
+        self.slot_idx.store(slot_idx, Ordering::Relaxed);
+        self.idx.store(idx, Ordering::Relaxed);
+    }
 
-impl PartialOrd for TimerCallback {
-    fn partial_cmp(&self, other: &Self) -> Option<core::cmp::Ordering> {
-        Some(self.cmp(other))
+    fn clear_position(&self) {
+        self.slot_idx.store(usize::MAX, Ordering::Relaxed);
     }
 }
 
-impl Ord for TimerCallback {
-    fn cmp(&self, other: &Self) -> core::cmp::Ordering {
-        // We want `TimerCallback`s to be processed in ascending order of `expired_time`,
-        // and the in-order management of `TimerCallback`s currently relies on a maximum heap,
-        // so we need the reverse instruction here.
-        self.expired_time.cmp(&other.expired_time).reverse()
+#[cfg(ktest)]
+mod test {
+    use ostd::prelude::*;
+
+    use super::*;
+
+    struct ManualClock {
+        time: SpinLock<Duration>,
+    }
+
+    impl ManualClock {
+        fn set(&self, time: Duration) {
+            *self.time.lock_irq_disabled() = time;
+        }
+    }
+
+    impl Clock for ManualClock {
+        fn read_time(&self) -> Duration {
+            *self.time.lock_irq_disabled()
+        }
+    }
+
+    #[ktest]
+    fn timer_wheel_expiry_and_cancel() {
+        let clock = Arc::new(ManualClock {
+            time: SpinLock::new(Duration::ZERO),
+        });
+        let timer_manager = TimerManager::new(clock.clone());
+        let nr_fired = Arc::new(AtomicUsize::new(0));
+        let new_timer = |timeout: Duration| {
+            let nr_fired = nr_fired.clone();
+            let timer = timer_manager.create_timer(move || {
+                nr_fired.fetch_add(1, Ordering::Relaxed);
+            });
+            timer.set_timeout(Timeout::When(timeout));
+            timer
+        };
+
+        // The timers are in different levels of the timer wheel.
+        let timeouts = [
+            Duration::from_micros(1500),
+            Duration::from_millis(100),
+            Duration::from_secs(10),
+            Duration::from_secs(1000),
+        ];
+        let timers: Vec<_> = timeouts.iter().map(|timeout| new_timer(*timeout)).collect();
+        let cancelled_timer = new_timer(Duration::from_secs(5));
+        cancelled_timer.cancel();
+
+        for (nr_expected, timeout) in timeouts.iter().enumerate() {
+            assert!(timer_manager.next_expiry().is_some());
+            clock.set(*timeout - Duration::from_micros(1));
+            timer_manager.process_expired_timers();
+            assert_eq!(nr_fired.load(Ordering::Relaxed), nr_expected);
+
+            clock.set(*timeout);
+            timer_manager.process_expired_timers();
+            assert_eq!(nr_fired.load(Ordering::Relaxed), nr_expected + 1);
+        }
+        assert!(timer_manager.next_expiry().is_none());
+        drop(timers);
     }
 }
@@ -1,5 +1,7 @@
 // SPDX-License-Identifier: MPL-2.0
 
+use ostd::{mm::UserSpace, task::current_task};
+
 use super::read_val_from_user;
 use crate::{
     prelude::*,
@@ -129,3 +131,53 @@ pub fn copy_iovs_from_user(start_addr: Vaddr, count: usize) -> Result<Box<[IoVec
 
     Ok(io_vecs.into_boxed_slice())
 }
+
+/// Calls `f` with the readers of the user space buffers pointed by the IO vectors.
+///
+/// The empty IO vectors are skipped, so that each reader has some remaining data.
+pub fn with_user_readers<R>(
+    io_vecs: &[IoVec],
+    f: impl FnOnce(&mut [VmReader<'_, UserSpace>]) -> Result<R>,
+) -> Result<R> {
+    let current_task = current_task().ok_or(Error::with_message(
+        Errno::EFAULT,
+        "the current task is missing",
+    ))?;
+    let user_space = current_task.user_space().ok_or(Error::with_message(
+        Errno::EFAULT,
+        "the user space is missing",
+    ))?;
+
+    let vm_space = user_space.vm_space();
+    let mut readers = io_vecs
+        .iter()
+        .filter(|io_vec| !io_vec.is_empty())
+        .map(|io_vec| vm_space.reader(io_vec.base(), io_vec.len()))
+        .collect::<ostd::Result<Vec<_>>>()?;
+    f(&mut readers)
+}
+
+/// Calls `f` with the writers of the user space buffers pointed by the IO vectors.
+///
+/// The empty IO vectors are skipped, so that each writer has some available space.
+pub fn with_user_writers<R>(
+    io_vecs: &[IoVec],
+    f: impl FnOnce(&mut [VmWriter<'_, UserSpace>]) -> Result<R>,
+) -> Result<R> {
+    let current_task = current_task().ok_or(Error::with_message(
+        Errno::EFAULT,
+        "the current task is missing",
+    ))?;
+    let user_space = current_task.user_space().ok_or(Error::with_message(
+        Errno::EFAULT,
+        "the user space is missing",
+    ))?;
+
+    let vm_space = user_space.vm_space();
+    let mut writers = io_vecs
+        .iter()
+        .filter(|io_vec| !io_vec.is_empty())
+        .map(|io_vec| vm_space.writer(io_vec.base(), io_vec.len()))
+        .collect::<ostd::Result<Vec<_>>>()?;
+    f(&mut writers)
+}
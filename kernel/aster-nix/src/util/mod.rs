@@ -13,7 +13,7 @@ mod iovec;
 pub mod net;
 pub mod random;
 
-pub use iovec::{copy_iovs_from_user, IoVec};
+pub use iovec::{copy_iovs_from_user, with_user_readers, with_user_writers, IoVec};
 
 /// Reads bytes into the `dest` `VmWriter`
 /// from the user space of the current process.
@@ -34,7 +34,8 @@ pub fn read_bytes_from_user(src: Vaddr, dest: &mut VmWriter<'_>) -> Result<()> {
     ))?;
     let copy_len = dest.avail();
 
-    let mut user_reader = user_space.vm_space().reader(src, copy_len)?;
+    let vm_space = user_space.vm_space();
+    let mut user_reader = vm_space.reader(src, copy_len)?;
     user_reader.read_fallible(dest).map_err(|err| err.0)?;
     Ok(())
 }
@@ -51,9 +52,8 @@ pub fn read_val_from_user<T: Pod>(src: Vaddr) -> Result<T> {
         "the user space is missing",
     ))?;
 
-    let mut user_reader = user_space
-        .vm_space()
-        .reader(src, core::mem::size_of::<T>())?;
+    let vm_space = user_space.vm_space();
+    let mut user_reader = vm_space.reader(src, core::mem::size_of::<T>())?;
     Ok(user_reader.read_val()?)
 }
 
@@ -76,7 +76,8 @@ pub fn write_bytes_to_user(dest: Vaddr, src: &mut VmReader<'_, KernelSpace>) ->
     ))?;
     let copy_len = src.remain();
 
-    let mut user_writer = user_space.vm_space().writer(dest, copy_len)?;
+    let vm_space = user_space.vm_space();
+    let mut user_writer = vm_space.writer(dest, copy_len)?;
     user_writer.write_fallible(src).map_err(|err| err.0)?;
     Ok(())
 }
@@ -92,12 +93,40 @@ pub fn write_val_to_user<T: Pod>(dest: Vaddr, val: &T) -> Result<()> {
         "the user space is missing",
     ))?;
 
-    let mut user_writer = user_space
-        .vm_space()
-        .writer(dest, core::mem::size_of::<T>())?;
+    let vm_space = user_space.vm_space();
+    let mut user_writer = vm_space.writer(dest, core::mem::size_of::<T>())?;
     Ok(user_writer.write_val(val)?)
 }
 
+/// Atomically updates a `u32` value with `op`
+/// in the user space of the current process.
+///
+/// `op` computes the new value from the old one, and may be called multiple
+/// times if the value is changed concurrently, e.g., by other threads in the
+/// user space. If the update is successful, returns the old value.
+/// Otherwise, returns `Err`.
+pub fn atomic_update_val_in_user(dest: Vaddr, mut op: impl FnMut(u32) -> u32) -> Result<u32> {
+    let current_task = current_task().ok_or(Error::with_message(
+        Errno::EFAULT,
+        "the current task is missing",
+    ))?;
+    let user_space = current_task.user_space().ok_or(Error::with_message(
+        Errno::EFAULT,
+        "the user space is missing",
+    ))?;
+
+    let vm_space = user_space.vm_space();
+    let user_writer = vm_space.writer(dest, core::mem::size_of::<u32>())?;
+    let mut old_val = read_val_from_user::<u32>(dest)?;
+    loop {
+        let cur_val = user_writer.atomic_compare_exchange_u32(old_val, op(old_val))?;
+        if cur_val == old_val {
+            return Ok(old_val);
+        }
+        old_val = cur_val;
+    }
+}
+
 /// Read a C string from the user space of the current process.
 /// The length of the string should not exceed `max_len`,
 /// including the final `\0` byte.
@@ -109,7 +138,7 @@ pub fn write_val_to_user<T: Pod>(dest: Vaddr, val: &T) -> Result<()> {
 pub fn read_cstring_from_user(addr: Vaddr, max_len: usize) -> Result<CString> {
     let current = current!();
     let vmar = current.root_vmar();
-    read_cstring_from_vmar(vmar, addr, max_len)
+    read_cstring_from_vmar(&vmar, addr, max_len)
 }
 
 /// Read CString from `vmar`. If possible, use `read_cstring_from_user` instead.
@@ -15,6 +15,5 @@ use crate::{fs::file_table::FileDesc, net::socket::Socket, prelude::*};
 
 pub fn get_socket_from_fd(sockfd: FileDesc) -> Result<Arc<dyn Socket>> {
     let current = current!();
-    let file_table = current.file_table().lock();
-    file_table.get_socket(sockfd)
+    current.file_table().get_socket(sockfd)
 }
@@ -1,10 +1,16 @@
 // SPDX-License-Identifier: MPL-2.0
 
-use super::read_socket_addr_from_user;
+use core::mem::{align_of, offset_of, size_of};
+
+use super::{read_socket_addr_from_user, CSocketOptionLevel};
 use crate::{
-    net::socket::SocketAddr,
+    fs::file_table::{FdFlags, FileDesc},
+    net::socket::{ControlMessage, SendRecvFlags, SocketAddr},
     prelude::*,
-    util::{copy_iovs_from_user, net::write_socket_addr_with_max_len, IoVec},
+    util::{
+        copy_iovs_from_user, net::write_socket_addr_with_max_len, read_val_from_user,
+        write_val_to_user, IoVec,
+    },
 };
 
 /// Standard well-defined IP protocols.
@@ -84,15 +90,31 @@ pub struct CUserMsgHdr {
     /// Scatter/Gather iov array
     pub msg_iov: Vaddr,
     /// The # of elements in msg_iov
-    pub msg_iovlen: u32,
+    pub msg_iovlen: usize,
     /// Ancillary data
     pub msg_control: Vaddr,
     /// Ancillary data buffer length
-    pub msg_controllen: u32,
+    pub msg_controllen: usize,
     /// Flags on received message
     pub msg_flags: u32,
 }
 
+/// The header of a control message, i.e., `struct cmsghdr`.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Pod)]
+struct CControlMessageHeader {
+    /// The length of the control message, including the header
+    cmsg_len: usize,
+    cmsg_level: i32,
+    cmsg_type: i32,
+}
+
+/// The control message type that passes file descriptors.
+const SCM_RIGHTS: i32 = 1;
+
+/// The maximum number of file descriptors that can be passed at once.
+const SCM_MAX_FD: usize = 253;
+
 impl CUserMsgHdr {
     pub fn read_socket_addr_from_user(&self) -> Result<Option<SocketAddr>> {
         if self.msg_name == 0 {
@@ -113,6 +135,153 @@ impl CUserMsgHdr {
     }
 
     pub fn copy_iovs_from_user(&self) -> Result<Box<[IoVec]>> {
-        copy_iovs_from_user(self.msg_iov, self.msg_iovlen as usize)
+        copy_iovs_from_user(self.msg_iov, self.msg_iovlen)
+    }
+
+    /// Reads the control message from user space.
+    ///
+    /// Only `SCM_RIGHTS` is supported. The other control messages are ignored.
+    pub fn read_control_message_from_user(&self) -> Result<Option<ControlMessage>> {
+        if self.msg_control == 0 {
+            return Ok(None);
+        }
+
+        const HEADER_LEN: usize = size_of::<CControlMessageHeader>();
+        let mut fds = Vec::new();
+        let mut offset = 0;
+        while offset + HEADER_LEN <= self.msg_controllen {
+            let header: CControlMessageHeader = read_val_from_user(self.msg_control + offset)?;
+            if header.cmsg_len < HEADER_LEN || offset + header.cmsg_len > self.msg_controllen {
+                return_errno_with_message!(Errno::EINVAL, "the control message is malformed");
+            }
+
+            if header.cmsg_level == CSocketOptionLevel::SOL_SOCKET as i32
+                && header.cmsg_type == SCM_RIGHTS
+            {
+                let nr_fds = (header.cmsg_len - HEADER_LEN) / size_of::<FileDesc>();
+                if fds.len() + nr_fds > SCM_MAX_FD {
+                    return_errno_with_message!(Errno::EINVAL, "too many files are passed");
+                }
+                for i in 0..nr_fds {
+                    let fd_addr =
+                        self.msg_control + offset + HEADER_LEN + i * size_of::<FileDesc>();
+                    fds.push(read_val_from_user::<FileDesc>(fd_addr)?);
+                }
+            } else {
+                warn!("control message {:?} is not supported", header);
+            }
+
+            offset += header.cmsg_len.next_multiple_of(align_of::<usize>());
+        }
+
+        if fds.is_empty() {
+            return Ok(None);
+        }
+
+        let files = {
+            let current = current!();
+            let file_table = current.file_table().lock();
+            fds.iter()
+                .map(|fd| file_table.get_file(*fd).cloned())
+                .collect::<Result<Vec<_>>>()?
+        };
+        Ok(Some(ControlMessage::Rights(files)))
+    }
+
+    /// Writes the control message to user space, and then updates `msg_controllen`
+    /// of the message header at `msghdr_addr`.
+    ///
+    /// The passed files are installed into the file table of the current process.
+    /// The files that cannot fit in the buffer are closed, and `MSG_CTRUNC` is added
+    /// to `msg_flags`. If the control message cannot be written, the installed files
+    /// are closed again.
+    pub fn write_control_message_to_user(
+        &self,
+        msghdr_addr: Vaddr,
+        control_message: Option<ControlMessage>,
+        flags: SendRecvFlags,
+    ) -> Result<()> {
+        const HEADER_LEN: usize = size_of::<CControlMessageHeader>();
+        let mut fds = Vec::new();
+        let mut is_truncated = false;
+
+        if let Some(ControlMessage::Rights(files)) = control_message {
+            let max_nr_fds = if self.msg_control == 0 {
+                0
+            } else {
+                self.msg_controllen.saturating_sub(HEADER_LEN) / size_of::<FileDesc>()
+            };
+            let nr_fds = files.len().min(max_nr_fds);
+            is_truncated = nr_fds < files.len();
+
+            if nr_fds > 0 {
+                let fd_flags = if flags.contains(SendRecvFlags::MSG_CMSG_CLOEXEC) {
+                    FdFlags::CLOEXEC
+                } else {
+                    FdFlags::empty()
+                };
+                let current = current!();
+                let mut file_table = current.file_table().lock();
+                fds = files
+                    .into_iter()
+                    .take(nr_fds)
+                    .map(|file| file_table.insert(file, fd_flags))
+                    .collect();
+            }
+        }
+
+        let res = self.write_rights_to_user(msghdr_addr, &fds, is_truncated);
+        if res.is_err() && !fds.is_empty() {
+            let current = current!();
+            let mut file_table = current.file_table().lock();
+            let closed_files: Vec<_> = fds
+                .iter()
+                .filter_map(|fd| file_table.close_file(*fd))
+                .collect();
+            drop(file_table);
+            drop(closed_files);
+        }
+        res
+    }
+
+    /// Writes the installed file descriptors as a `SCM_RIGHTS` control message, and
+    /// then updates the message header at `msghdr_addr`.
+    fn write_rights_to_user(
+        &self,
+        msghdr_addr: Vaddr,
+        fds: &[FileDesc],
+        is_truncated: bool,
+    ) -> Result<()> {
+        const HEADER_LEN: usize = size_of::<CControlMessageHeader>();
+        let mut controllen = 0;
+
+        if !fds.is_empty() {
+            let header = CControlMessageHeader {
+                cmsg_len: HEADER_LEN + fds.len() * size_of::<FileDesc>(),
+                cmsg_level: CSocketOptionLevel::SOL_SOCKET as i32,
+                cmsg_type: SCM_RIGHTS,
+            };
+            write_val_to_user(self.msg_control, &header)?;
+            for (i, fd) in fds.iter().enumerate() {
+                let fd_addr = self.msg_control + HEADER_LEN + i * size_of::<FileDesc>();
+                write_val_to_user(fd_addr, fd)?;
+            }
+            controllen = header
+                .cmsg_len
+                .next_multiple_of(align_of::<usize>())
+                .min(self.msg_controllen);
+        }
+
+        write_val_to_user(
+            msghdr_addr + offset_of!(CUserMsgHdr, msg_controllen),
+            &controllen,
+        )?;
+        if is_truncated {
+            write_val_to_user(
+                msghdr_addr + offset_of!(CUserMsgHdr, msg_flags),
+                &(self.msg_flags | SendRecvFlags::MSG_CTRUNC.bits() as u32),
+            )?;
+        }
+        Ok(())
     }
 }
@@ -7,7 +7,7 @@
 //! without the need for context switching. This is particularly useful for frequently invoked operations such as
 //! obtaining the current time, which can be more efficiently handled within the user space.
 //!
-//! This module manages the VDSO mechanism through the `Vdso` struct, which contains a `VdsoData` instance with
+//! This module manages the VDSO mechanism through the `Vdso` struct, which publishes a `VdsoData` instance with
 //! necessary time-related information, and a Virtual Memory Object (VMO) that encapsulates both the data and the
 //! VDSO routines. The VMO is intended to be mapped into the address space of every user space process for efficient access.
 //!
@@ -15,14 +15,18 @@
 //! use. It also hooks up the VDSO data update routine to the time management subsystem for periodic updates.
 
 use alloc::{boxed::Box, sync::Arc};
-use core::{mem::ManuallyDrop, time::Duration};
+use core::{
+    mem::{size_of, ManuallyDrop},
+    sync::atomic::{fence, AtomicU32, Ordering},
+    time::Duration,
+};
 
 use aster_rights::Rights;
-use aster_time::{read_monotonic_time, Instant};
+use aster_time::{ClockSource, Instant, NANOS_PER_SECOND};
 use aster_util::coeff::Coeff;
 use ostd::{
     mm::{Frame, VmIo, PAGE_SIZE},
-    sync::SpinLock,
+    trap::disable_local,
 };
 use pod::Pod;
 use spin::Once;
@@ -154,36 +158,49 @@ impl VdsoData {
         self.shift = coeff.shift();
     }
 
-    fn update_clock_instant(&mut self, clockid: usize, secs: u64, nanos_info: u64) {
-        self.basetime[clockid].secs = secs;
-        self.basetime[clockid].nanos_info = nanos_info;
-    }
-
     fn update_high_res_instant(&mut self, instant: Instant, instant_cycles: u64) {
         self.last_cycles = instant_cycles;
         for clock_id in HIGH_RES_CLOCK_IDS {
-            let secs = if clock_id == ClockId::CLOCK_REALTIME {
-                instant.secs() + START_SECS_COUNT.get().unwrap()
-            } else {
-                instant.secs()
-            };
-
-            self.update_clock_instant(
-                clock_id as usize,
-                secs,
-                (instant.nanos() as u64) << self.shift as u64,
-            );
+            self.basetime[clock_id as usize] =
+                VdsoInstant::new_high_res(clock_id, instant, self.shift);
         }
     }
 
     fn update_coarse_res_instant(&mut self, instant: Instant) {
         for clock_id in COARSE_RES_CLOCK_IDS {
-            let secs = if clock_id == ClockId::CLOCK_REALTIME_COARSE {
-                instant.secs() + START_SECS_COUNT.get().unwrap()
-            } else {
-                instant.secs()
-            };
-            self.update_clock_instant(clock_id as usize, secs, instant.nanos() as u64);
+            self.basetime[clock_id as usize] = VdsoInstant::new_coarse_res(clock_id, instant);
+        }
+    }
+}
+
+impl VdsoInstant {
+    /// Creates the instant of a high-resolution clock, whose nanoseconds are shifted.
+    fn new_high_res(clock_id: ClockId, instant: Instant, shift: u32) -> Self {
+        Self::new_high_res_shifted(clock_id, instant.secs(), (instant.nanos() as u64) << shift)
+    }
+
+    fn new_high_res_shifted(clock_id: ClockId, secs: u64, shifted_nanos: u64) -> Self {
+        let secs = if clock_id == ClockId::CLOCK_REALTIME {
+            secs + START_SECS_COUNT.get().unwrap()
+        } else {
+            secs
+        };
+        Self {
+            secs,
+            nanos_info: shifted_nanos,
+        }
+    }
+
+    /// Creates the instant of a coarse-resolution clock.
+    fn new_coarse_res(clock_id: ClockId, instant: Instant) -> Self {
+        let secs = if clock_id == ClockId::CLOCK_REALTIME_COARSE {
+            instant.secs() + START_SECS_COUNT.get().unwrap()
+        } else {
+            instant.secs()
+        };
+        Self {
+            secs,
+            nanos_info: instant.nanos() as u64,
         }
     }
 }
@@ -191,12 +208,17 @@ impl VdsoData {
 /// Vdso (virtual dynamic shared object) is used to export some safe kernel space routines to user space applications
 /// so that applications can call these kernel space routines in-process, without context switching.
 ///
-/// Vdso maintains a `VdsoData` instance that contains data information required for VDSO mechanism,
+/// Vdso maintains the `VdsoData` that contains data information required for VDSO mechanism in a frame,
 /// and a `Vmo` that contains all VDSO-related information, including the VDSO data and the VDSO calling interfaces.
 /// This `Vmo` must be mapped to every userspace process.
 struct Vdso {
-    /// A VdsoData instance.
-    data: SpinLock<VdsoData>,
+    /// The sequence count of the VDSO data, which is odd while the data are being updated.
+    ///
+    /// This is the kernel's copy of the `seq` field in the `data_frame`, on which the
+    /// writers can perform atomic operations.
+    seq: AtomicU32,
+    /// The shift of the coefficient of the clocksource.
+    shift: u32,
     /// The vmo of the entire VDSO, including the library text and the VDSO data.
     vmo: Arc<Vmo>,
     /// The `Frame` that contains the VDSO data. This frame is contained in and
@@ -204,8 +226,14 @@ struct Vdso {
     data_frame: Frame,
 }
 
-/// A `SpinLock` for the `seq` field in `VdsoData`.
-static SEQ_LOCK: SpinLock<()> = SpinLock::new(());
+/// The offset of the VDSO data in the `data_frame`.
+const VDSO_DATA_OFFSET: usize = 0x80;
+/// The offset of the `seq` field in the `data_frame`.
+const SEQ_OFFSET: usize = VDSO_DATA_OFFSET;
+/// The offset of the `last_cycles` field in the `data_frame`.
+const LAST_CYCLES_OFFSET: usize = VDSO_DATA_OFFSET + 0x8;
+/// The offset of the `basetime` field in the `data_frame`.
+const BASETIME_OFFSET: usize = VDSO_DATA_OFFSET + 0x20;
 
 impl Vdso {
     /// Construct a new Vdso, including an initialized `VdsoData` and a vmo of the VDSO.
@@ -217,7 +245,9 @@ impl Vdso {
             let vmo_options = VmoOptions::<Rights>::new(5 * PAGE_SIZE);
             let vdso_vmo = vmo_options.alloc().unwrap();
             // Write VDSO data to VDSO vmo.
-            vdso_vmo.write_bytes(0x80, vdso_data.as_bytes()).unwrap();
+            vdso_vmo
+                .write_bytes(VDSO_DATA_OFFSET, vdso_data.as_bytes())
+                .unwrap();
 
             let vdso_lib_vmo = {
                 let vdso_path = FsPath::new(AT_FDCWD, "/lib/x86_64-linux-gnu/vdso64.so").unwrap();
@@ -234,55 +264,119 @@ impl Vdso {
             (vdso_vmo, data_frame)
         };
         Self {
-            data: SpinLock::new(vdso_data),
+            seq: AtomicU32::new(vdso_data.seq),
+            shift: vdso_data.shift,
             vmo: Arc::new(vdso_vmo),
             data_frame,
         }
     }
 
     fn update_high_res_instant(&self, instant: Instant, instant_cycles: u64) {
-        let seq_lock = SEQ_LOCK.lock();
-        self.data
-            .lock()
-            .update_high_res_instant(instant, instant_cycles);
-
-        // Update begins.
-        self.data_frame.write_val(0x80, &1).unwrap();
-        self.data_frame.write_val(0x88, &instant_cycles).unwrap();
-        for clock_id in HIGH_RES_CLOCK_IDS {
-            self.update_data_frame_instant(clock_id);
-        }
+        self.write_data(|| {
+            self.write_high_res_instants(instant_cycles, |clock_id| {
+                VdsoInstant::new_high_res(clock_id, instant, self.shift)
+            });
+        });
+    }
 
-        // Update finishes.
-        self.data_frame.write_val(0x80, &0).unwrap();
+    /// Updates the instants of all the clock IDs to the current time.
+    ///
+    /// Besides the coarse-resolution clock IDs, the instants of the high-resolution
+    /// clock IDs are also advanced, since `time` in the VDSO only reads the seconds of
+    /// the `CLOCK_REALTIME` instant. The time is calculated from the `last_record` of the
+    /// clocksource with the same coefficient as the VDSO, so the high-resolution clocks
+    /// read by the user space are not affected.
+    fn update_instants(&self, clocksource: &ClockSource) {
+        let (last_instant, last_cycles) = clocksource.last_record();
+        let instant_cycles = clocksource.read_cycles();
+
+        let (secs, shifted_nanos) = {
+            let coeff = clocksource.coeff();
+            let shifted_nanos = ((last_instant.nanos() as u128) << coeff.shift())
+                + instant_cycles.saturating_sub(last_cycles) as u128 * coeff.mult() as u128;
+            let shifted_nanos_per_sec = (NANOS_PER_SECOND as u128) << coeff.shift();
+            (
+                last_instant.secs() + (shifted_nanos / shifted_nanos_per_sec) as u64,
+                (shifted_nanos % shifted_nanos_per_sec) as u64,
+            )
+        };
+        let instant = Instant::new(secs, (shifted_nanos >> clocksource.coeff().shift()) as u32);
+
+        self.write_data(|| {
+            self.write_high_res_instants(instant_cycles, |clock_id| {
+                VdsoInstant::new_high_res_shifted(clock_id, secs, shifted_nanos)
+            });
+            for clock_id in COARSE_RES_CLOCK_IDS {
+                self.write_instant(clock_id, &VdsoInstant::new_coarse_res(clock_id, instant));
+            }
+        });
     }
 
-    fn update_coarse_res_instant(&self, instant: Instant) {
-        let seq_lock = SEQ_LOCK.lock();
-        self.data.lock().update_coarse_res_instant(instant);
+    /// Updates the VDSO data in the `data_frame` with `f`.
+    ///
+    /// The VDSO data are protected by a sequence count, i.e., the `seq` field. It is odd
+    /// during the update, and the user-space readers retry if it is odd or it changes
+    /// while they read the data.
+    ///
+    /// The writers are serialized by claiming an even sequence count with a CAS, instead
+    /// of taking an additional lock.
+    fn write_data(&self, f: impl FnOnce()) {
+        // The writers are called in interrupt contexts. Disable the local IRQs so that
+        // a writer cannot be interrupted by another writer that spins on the same CPU.
+        let _irq_guard = disable_local();
+
+        let mut seq = self.seq.load(Ordering::Relaxed);
+        loop {
+            if seq % 2 == 1 {
+                core::hint::spin_loop();
+                seq = self.seq.load(Ordering::Relaxed);
+                continue;
+            }
+            match self.seq.compare_exchange_weak(
+                seq,
+                seq.wrapping_add(1),
+                Ordering::Acquire,
+                Ordering::Relaxed,
+            ) {
+                Ok(_) => break,
+                Err(current) => seq = current,
+            }
+        }
 
         // Update begins.
-        self.data_frame.write_val(0x80, &1).unwrap();
-        for clock_id in COARSE_RES_CLOCK_IDS {
-            self.update_data_frame_instant(clock_id);
-        }
+        self.data_frame
+            .write_val(SEQ_OFFSET, &seq.wrapping_add(1))
+            .unwrap();
+        // The fences are compiler barriers on x86, which keep the writes of the sequence
+        // count and the data in order, as `smp_wmb` in Linux.
+        fence(Ordering::Release);
 
-        // Update finishes.
-        self.data_frame.write_val(0x80, &0).unwrap();
-    }
+        f();
 
-    /// Update the requisite fields of the VDSO data in the `data_frame`.
-    fn update_data_frame_instant(&self, clockid: ClockId) {
-        let clock_index = clockid as usize;
-        let secs_offset = 0xA0 + clock_index * 0x10;
-        let nanos_info_offset = 0xA8 + clock_index * 0x10;
-        let data = self.data.lock();
+        // Update finishes.
+        fence(Ordering::Release);
         self.data_frame
-            .write_val(secs_offset, &data.basetime[clock_index].secs)
+            .write_val(SEQ_OFFSET, &seq.wrapping_add(2))
             .unwrap();
+        self.seq.store(seq.wrapping_add(2), Ordering::Release);
+    }
+
+    fn write_high_res_instants(
+        &self,
+        instant_cycles: u64,
+        new_instant: impl Fn(ClockId) -> VdsoInstant,
+    ) {
         self.data_frame
-            .write_val(nanos_info_offset, &data.basetime[clock_index].nanos_info)
+            .write_val(LAST_CYCLES_OFFSET, &instant_cycles)
             .unwrap();
+        for clock_id in HIGH_RES_CLOCK_IDS {
+            self.write_instant(clock_id, &new_instant(clock_id));
+        }
+    }
+
+    fn write_instant(&self, clock_id: ClockId, instant: &VdsoInstant) {
+        let offset = BASETIME_OFFSET + clock_id as usize * size_of::<VdsoInstant>();
+        self.data_frame.write_val(offset, instant).unwrap();
     }
 }
 
@@ -293,10 +387,10 @@ fn update_vdso_high_res_instant(instant: Instant, instant_cycles: u64) {
         .update_high_res_instant(instant, instant_cycles);
 }
 
-/// Update the `VdsoInstant` for clock IDs with coarse resolution in Vdso.
-fn update_vdso_coarse_res_instant() {
-    let instant = Instant::from(read_monotonic_time());
-    VDSO.get().unwrap().update_coarse_res_instant(instant);
+/// Update the `VdsoInstant` for all clock IDs in Vdso to the current time.
+fn update_vdso_instants() {
+    let clocksource = aster_time::default_clocksource();
+    VDSO.get().unwrap().update_instants(&clocksource);
 }
 
 /// Init `START_SECS_COUNT`, which is used to record the seconds passed since 1970-01-01 00:00:00.
@@ -321,10 +415,10 @@ pub(super) fn init() {
     aster_time::VDSO_DATA_HIGH_RES_UPDATE_FN.call_once(|| Arc::new(update_vdso_high_res_instant));
 
     // Coarse resolution clock IDs directly read the instant stored in VDSO data without
-    // using coefficients for calculation, thus the related instant requires more frequent updating.
-    let coarse_instant_timer = ManuallyDrop::new(
-        MonotonicClock::timer_manager().create_timer(update_vdso_coarse_res_instant),
-    );
+    // using coefficients for calculation, and so does `time` with `CLOCK_REALTIME`, thus
+    // the related instants require more frequent updating.
+    let coarse_instant_timer =
+        ManuallyDrop::new(MonotonicClock::timer_manager().create_timer(update_vdso_instants));
     coarse_instant_timer.set_interval(Duration::from_millis(100));
     coarse_instant_timer.set_timeout(Timeout::After(Duration::from_millis(100)));
 }
@@ -107,6 +107,27 @@ impl Vmar<Rights> {
         self.0.protect(perms, range)
     }
 
+    /// Set whether the memory mappings in the specified range may be backed
+    /// by huge pages.
+    ///
+    /// The range's start and end addresses must be page-aligned.
+    /// Also, the range must be completely mapped.
+    pub fn set_huge_pages(&self, enabled: bool, range: Range<usize>) -> Result<()> {
+        self.0.set_huge_pages(enabled, range)
+    }
+
+    /// Commit the pages in the specified range and map them in batch,
+    /// as if the pages are accessed, so that later accesses to the pages
+    /// will not trigger page faults.
+    ///
+    /// If `write` is set, the pages are committed for writing.
+    ///
+    /// The range's start and end addresses must be page-aligned.
+    /// Also, the range must be completely mapped.
+    pub fn populate(&self, range: Range<usize>, write: bool) -> Result<()> {
+        self.0.populate(range, write)
+    }
+
     /// clear all mappings and children vmars.
     /// After being cleared, this vmar will become an empty vmar
     pub fn clear(&self) -> Result<()> {
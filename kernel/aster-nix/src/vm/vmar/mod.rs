@@ -211,6 +211,78 @@ impl Vmar_ {
         Ok(())
     }
 
+    /// Set whether the mappings in the range may be backed by huge pages.
+    /// The range is ensured to be mapped.
+    pub fn set_huge_pages(&self, enabled: bool, range: Range<usize>) -> Result<()> {
+        assert!(range.start % PAGE_SIZE == 0);
+        assert!(range.end % PAGE_SIZE == 0);
+        self.check_protected_range(&range)?;
+        self.do_set_huge_pages_inner(enabled, range)?;
+        Ok(())
+    }
+
+    fn do_set_huge_pages_inner(&self, enabled: bool, range: Range<usize>) -> Result<()> {
+        let advised_mappings: Vec<Arc<VmMapping>> = {
+            let inner = self.inner.lock();
+            inner
+                .vm_mappings
+                .find(&range)
+                .into_iter()
+                .cloned()
+                .collect()
+        };
+
+        for vm_mapping in advised_mappings {
+            let intersected_range = get_intersected_range(&range, &vm_mapping.range());
+            vm_mapping.set_huge_pages(enabled, intersected_range)?;
+        }
+
+        for child_vmar_ in self.inner.lock().child_vmar_s.find(&range) {
+            let child_vmar_range = child_vmar_.range();
+            debug_assert!(is_intersected(&child_vmar_range, &range));
+            let intersected_range = get_intersected_range(&range, &child_vmar_range);
+            child_vmar_.do_set_huge_pages_inner(enabled, intersected_range)?;
+        }
+
+        Ok(())
+    }
+
+    /// Commit the pages in the range and map them in batch.
+    /// The range should be mapped.
+    pub fn populate(&self, range: Range<usize>, write: bool) -> Result<()> {
+        assert!(range.start % PAGE_SIZE == 0);
+        assert!(range.end % PAGE_SIZE == 0);
+        self.check_protected_range(&range)?;
+        self.do_populate_inner(range, write)?;
+        Ok(())
+    }
+
+    fn do_populate_inner(&self, range: Range<usize>, write: bool) -> Result<()> {
+        let populated_mappings: Vec<Arc<VmMapping>> = {
+            let inner = self.inner.lock();
+            inner
+                .vm_mappings
+                .find(&range)
+                .into_iter()
+                .cloned()
+                .collect()
+        };
+
+        for vm_mapping in populated_mappings {
+            let intersected_range = get_intersected_range(&range, &vm_mapping.range());
+            vm_mapping.populate(intersected_range, write)?;
+        }
+
+        for child_vmar_ in self.inner.lock().child_vmar_s.find(&range) {
+            let child_vmar_range = child_vmar_.range();
+            debug_assert!(is_intersected(&child_vmar_range, &range));
+            let intersected_range = get_intersected_range(&range, &child_vmar_range);
+            child_vmar_.do_populate_inner(intersected_range, write)?;
+        }
+
+        Ok(())
+    }
+
     /// Ensure the whole protected range is mapped, that is to say, backed up by a VMO.
     /// Internally, we check whether the range intersects any free region recursively.
     /// If so, the range is not fully mapped.
@@ -5,9 +5,10 @@
 
 use core::ops::Range;
 
-use ostd::mm::{Frame, FrameVec, PageFlags, VmIo, VmMapOptions, VmSpace};
+use align_ext::AlignExt;
+use ostd::mm::{Frame, FrameVec, PageFlags, VmIo, VmMapOptions, VmSpace, HUGE_PAGE_SIZE};
 
-use super::{interval::Interval, is_intersected, Vmar, Vmar_};
+use super::{get_intersected_range, interval::Interval, is_intersected, Vmar, Vmar_};
 use crate::{
     prelude::*,
     vm::{
@@ -17,6 +18,10 @@ use crate::{
     },
 };
 
+/// The number of pages that are mapped around a faulted page if they are ready,
+/// i.e., the pages in the 64 KiB aligned window around the faulted page.
+const FAULT_AROUND_PAGES: usize = 16;
+
 /// A VmMapping represents mapping a vmo into a vmar.
 /// A vmar can has multiple VmMappings, which means multiple vmos are mapped to a vmar.
 /// A vmo can also contain multiple VmMappings, which means a vmo can be mapped to multiple vmars.
@@ -62,6 +67,9 @@ struct VmMappingInner {
     /// The permissions of pages in the mapping.
     /// All pages within the same VmMapping have the same permissions.
     perms: VmPerms,
+    /// Whether the mapping may be backed by huge pages, as advised by
+    /// `madvise(MADV_HUGEPAGE)`.
+    use_huge_pages: bool,
 }
 
 impl Interval<usize> for Arc<VmMapping> {
@@ -105,6 +113,7 @@ impl VmMapping {
             is_destroyed: false,
             mapped_pages: BTreeSet::new(),
             perms,
+            use_huge_pages: false,
         };
 
         Ok(Self {
@@ -120,20 +129,10 @@ impl VmMapping {
     ///
     /// Note: Since such new mappings will intersect with the current mapping,
     /// making sure that when adding the new mapping into a Vmar, the current mapping in the Vmar will be removed.
-    fn clone_partial(
-        &self,
-        range: Range<usize>,
-        new_perms: Option<VmPerms>,
-    ) -> Result<Arc<VmMapping>> {
+    fn clone_partial(&self, range: Range<usize>) -> Result<Arc<VmMapping>> {
         let partial_mapping = Arc::new(self.try_clone()?);
-        // Adjust the mapping range and the permission.
-        {
-            let mut inner = partial_mapping.inner.lock();
-            inner.shrink_to(range);
-            if let Some(perms) = new_perms {
-                inner.perms = perms;
-            }
-        }
+        // Adjust the mapping range.
+        partial_mapping.inner.lock().shrink_to(range);
         Ok(partial_mapping)
     }
 
@@ -151,6 +150,15 @@ impl VmMapping {
             .map_one_page(vm_space, page_idx, frame, is_readonly)
     }
 
+    /// Add the committed pages of a huge page and map them to vmspace as a huge page.
+    fn map_huge_page(&self, start_page_idx: usize, frames: FrameVec) -> Result<()> {
+        let parent = self.parent.upgrade().unwrap();
+        let vm_space = parent.vm_space();
+        self.inner
+            .lock()
+            .map_huge_page(vm_space, start_page_idx, frames)
+    }
+
     /// unmap a page
     fn unmap_one_page(&self, page_idx: usize) -> Result<()> {
         let parent = self.parent.upgrade().unwrap();
@@ -247,12 +255,91 @@ impl VmMapping {
         let required_perm = if write { VmPerms::WRITE } else { VmPerms::READ };
         self.check_perms(&required_perm)?;
 
+        if let Some(start_page_idx) = self.huge_page_idx_of(page_fault_addr)
+            && let Some(frames) = self.vmo.get_committed_huge_page(start_page_idx, false)?
+        {
+            return self.map_huge_page(start_page_idx, frames);
+        }
+
         let frame = self.vmo.get_committed_frame(page_idx, write)?;
 
         // If read access to cow vmo triggers page fault, the map should be readonly.
         // If user next tries to write to the frame, another page fault will be triggered.
         let is_readonly = self.vmo.is_cow_vmo() && !write;
-        self.map_one_page(page_idx, frame, is_readonly)
+        self.map_one_page(page_idx, frame, is_readonly)?;
+
+        if !write {
+            self.fault_around(page_idx)?;
+        }
+        Ok(())
+    }
+
+    /// Maps the pages around the faulted page that are ready without waiting for I/O,
+    /// e.g., the pages of a file that are already in the page cache.
+    ///
+    /// This saves the page faults of the subsequent accesses to the neighbor pages,
+    /// which are common for file-backed mappings (e.g., the code of executables).
+    fn fault_around(&self, page_idx: usize) -> Result<()> {
+        let page_idx_range = {
+            let inner = self.inner.lock();
+            let mapping_page_idx_range =
+                get_page_idx_range(&(inner.vmo_offset..inner.vmo_offset + inner.map_size));
+            let start = page_idx.align_down(FAULT_AROUND_PAGES);
+            start.max(mapping_page_idx_range.start)
+                ..(start + FAULT_AROUND_PAGES).min(mapping_page_idx_range.end)
+        };
+
+        let pages = self.vmo.get_cached_frames(page_idx_range.clone());
+        // The faulted page itself is always cached.
+        if pages.len() <= 1 {
+            return Ok(());
+        }
+
+        let parent = self.parent.upgrade().unwrap();
+        let vm_space = parent.vm_space();
+        let is_readonly = self.vmo.is_cow_vmo();
+        self.inner
+            .lock()
+            .map_pages(vm_space, page_idx_range, pages, is_readonly, false)
+    }
+
+    /// Commits the pages in the range and maps them in batch, as if they are accessed.
+    ///
+    /// If `write` is set, the pages are committed for writing, so that later writes to
+    /// them will not trigger page faults for COW.
+    pub(super) fn populate(&self, range: Range<usize>, write: bool) -> Result<()> {
+        if write {
+            self.vmo.check_rights(Rights::WRITE)?;
+        } else {
+            self.vmo.check_rights(Rights::READ)?;
+        }
+        let required_perm = if write { VmPerms::WRITE } else { VmPerms::READ };
+        self.check_perms(&required_perm)?;
+
+        let page_idx_range = {
+            let inner = self.inner.lock();
+            let range = get_intersected_range(&range, &inner.range());
+            let vmo_offset = (range.start - inner.map_to_addr + inner.vmo_offset)
+                ..(range.end - inner.map_to_addr + inner.vmo_offset).min(self.vmo.size());
+            get_page_idx_range(&vmo_offset)
+        };
+        if page_idx_range.is_empty() {
+            return Ok(());
+        }
+
+        let frames = self
+            .vmo
+            .get_committed_frames(page_idx_range.clone(), write)?;
+        let pages = page_idx_range.clone().zip(frames).collect();
+
+        let parent = self.parent.upgrade().unwrap();
+        let vm_space = parent.vm_space();
+        let is_readonly = self.vmo.is_cow_vmo() && !write;
+        // For writing, the read-only pages mapped for COW should be replaced. For reading,
+        // the pages that are already mapped should be kept, since they may be writable.
+        self.inner
+            .lock()
+            .map_pages(vm_space, page_idx_range, pages, is_readonly, write)
     }
 
     /// Protect a specified range of pages in the mapping to the target perms.
@@ -270,7 +357,7 @@ impl VmMapping {
         let rights = Rights::from(new_perms);
         self.vmo().check_rights(rights)?;
         // Protect permission for the perm in the VmMapping.
-        self.protect_with_subdivision(&range, new_perms)?;
+        self.update_with_subdivision(&range, |inner| inner.perms = new_perms)?;
         // Protect permission in the VmSpace.
         let vmar = self.parent.upgrade().unwrap();
         let vm_space = vmar.vm_space();
@@ -279,6 +366,95 @@ impl VmMapping {
         Ok(())
     }
 
+    /// Set whether a specified range of pages in the mapping may be backed by huge pages.
+    /// The VmMapping will split to maintain its property.
+    ///
+    /// If huge pages are enabled, the pages that have already been mapped are collapsed
+    /// into huge pages where possible. Otherwise, the existing huge pages are kept, but
+    /// new huge pages will not be mapped.
+    ///
+    /// Since this method will modify the `vm_mappings` in the vmar,
+    /// it should not be called during the direct iteration of the `vm_mappings`.
+    pub(super) fn set_huge_pages(&self, enabled: bool, range: Range<usize>) -> Result<()> {
+        if self.inner.lock().use_huge_pages == enabled {
+            return Ok(());
+        }
+
+        let new_mapping =
+            self.update_with_subdivision(&range, |inner| inner.use_huge_pages = enabled)?;
+        if enabled {
+            new_mapping
+                .as_deref()
+                .unwrap_or(self)
+                .collapse_huge_pages()?;
+        }
+
+        Ok(())
+    }
+
+    /// Returns the index of the first page of the huge page that contains the address,
+    /// if the mapping may be backed by huge pages at the address.
+    ///
+    /// The huge page must be fully within the mapping, and aligned to the huge page size
+    /// in both the address space and the VMO.
+    fn huge_page_idx_of(&self, addr: Vaddr) -> Option<usize> {
+        let inner = self.inner.lock();
+        if !inner.use_huge_pages {
+            return None;
+        }
+
+        let huge_page_addr = addr.align_down(HUGE_PAGE_SIZE);
+        let vmo_offset = (huge_page_addr + inner.vmo_offset).checked_sub(inner.map_to_addr)?;
+        if vmo_offset % HUGE_PAGE_SIZE != 0
+            || huge_page_addr < inner.map_to_addr
+            || huge_page_addr + HUGE_PAGE_SIZE > inner.map_to_addr + inner.map_size
+        {
+            return None;
+        }
+        Some(vmo_offset / PAGE_SIZE)
+    }
+
+    /// Collapse the mapped pages into huge pages where possible.
+    ///
+    /// This copies the mapped pages into newly allocated huge pages, unless they
+    /// already make up huge pages. Huge pages where no page has been mapped are left
+    /// to be mapped on page faults.
+    fn collapse_huge_pages(&self) -> Result<()> {
+        // The pages of shared mappings may be mapped by other processes,
+        // which would not see the pages that replace them.
+        if self.is_shared {
+            return Ok(());
+        }
+
+        let range = self.range();
+        let huge_page_addrs = (range.start.align_up(HUGE_PAGE_SIZE)
+            ..range.end.align_down(HUGE_PAGE_SIZE))
+            .step_by(HUGE_PAGE_SIZE);
+        for huge_page_addr in huge_page_addrs {
+            let Some(start_page_idx) = self.huge_page_idx_of(huge_page_addr) else {
+                continue;
+            };
+
+            let nr_pages = HUGE_PAGE_SIZE / PAGE_SIZE;
+            let is_populated = self
+                .inner
+                .lock()
+                .mapped_pages
+                .range(start_page_idx..start_page_idx + nr_pages)
+                .next()
+                .is_some();
+            if !is_populated {
+                continue;
+            }
+
+            if let Some(frames) = self.vmo.get_committed_huge_page(start_page_idx, true)? {
+                self.map_huge_page(start_page_idx, frames)?;
+            }
+        }
+
+        Ok(())
+    }
+
     pub(super) fn new_fork(&self, new_parent: &Arc<Vmar_>) -> Result<VmMapping> {
         let VmMapping { inner, vmo, .. } = self;
 
@@ -301,6 +477,7 @@ impl VmMapping {
                 is_destroyed: inner.is_destroyed,
                 mapped_pages: BTreeSet::new(),
                 perms: inner.perms,
+                use_huge_pages: inner.use_huge_pages,
             }
         };
 
@@ -316,10 +493,10 @@ impl VmMapping {
         self.map_to_addr()..self.map_to_addr() + self.map_size()
     }
 
-    /// Protect the current `VmMapping` to enforce new permissions within a specified range.
+    /// Update the properties (e.g., the permissions) of the current `VmMapping` within a specified range.
     ///
     /// Due to the property of `VmMapping`, this operation may require subdividing the current
-    /// `VmMapping`. In this condition, it will generate a new `VmMapping` with the specified `perm` to protect the
+    /// `VmMapping`. In this condition, it will generate a new `VmMapping` with the updated properties for the
     /// target range, as well as additional `VmMappings` to preserve the mappings in the remaining ranges.
     ///
     /// There are four conditions:
@@ -328,35 +505,35 @@ impl VmMapping {
     /// 3. |--------old perm--------| -> |-old-| + |-new-| + |-old-|
     /// 4. |--------old perm--------| -> |---------new perm--------|
     ///
-    /// Generally, this function is only used in `protect()` method.
+    /// Generally, this function is only used in `protect()` and `set_huge_pages()` methods.
     /// This method modifies the parent `Vmar` in the end if subdividing is required.
-    /// It removes current mapping and add splitted mapping to the Vmar.
-    fn protect_with_subdivision(
+    /// It removes current mapping and add splitted mapping to the Vmar, returning the
+    /// new `VmMapping` of the target range.
+    fn update_with_subdivision(
         &self,
         intersect_range: &Range<usize>,
-        perms: VmPerms,
-    ) -> Result<()> {
+        update: impl FnOnce(&mut VmMappingInner),
+    ) -> Result<Option<Arc<VmMapping>>> {
         let mut additional_mappings = Vec::new();
         let range = self.range();
         // Condition 4, the `additional_mappings` will be empty.
         if range.start == intersect_range.start && range.end == intersect_range.end {
-            self.inner.lock().perms = perms;
-            return Ok(());
+            update(&mut self.inner.lock());
+            return Ok(None);
         }
         // Condition 1 or 3, which needs an additional new VmMapping with range (range.start..intersect_range.start)
         if range.start < intersect_range.start {
-            let additional_left_mapping =
-                self.clone_partial(range.start..intersect_range.start, None)?;
+            let additional_left_mapping = self.clone_partial(range.start..intersect_range.start)?;
             additional_mappings.push(additional_left_mapping);
         }
         // Condition 2 or 3, which needs an additional new VmMapping with range (intersect_range.end..range.end).
         if range.end > intersect_range.end {
-            let additional_right_mapping =
-                self.clone_partial(intersect_range.end..range.end, None)?;
+            let additional_right_mapping = self.clone_partial(intersect_range.end..range.end)?;
             additional_mappings.push(additional_right_mapping);
         }
-        // The protected VmMapping must exist and its range is `intersect_range`.
-        let protected_mapping = self.clone_partial(intersect_range.clone(), Some(perms))?;
+        // The updated VmMapping must exist and its range is `intersect_range`.
+        let protected_mapping = self.clone_partial(intersect_range.clone())?;
+        update(&mut protected_mapping.inner.lock());
 
         // Begin to modify the `Vmar`.
         let vmar = self.parent.upgrade().unwrap();
@@ -366,7 +543,7 @@ impl VmMapping {
         // Add protected mappings to the vmar.
         vmar_inner
             .vm_mappings
-            .insert(protected_mapping.map_to_addr(), protected_mapping);
+            .insert(protected_mapping.map_to_addr(), protected_mapping.clone());
         // Add additional mappings to the vmar.
         for mapping in additional_mappings {
             vmar_inner
@@ -374,7 +551,7 @@ impl VmMapping {
                 .insert(mapping.map_to_addr(), mapping);
         }
 
-        Ok(())
+        Ok(Some(protected_mapping))
     }
 
     /// Trim a range from the mapping.
@@ -489,6 +666,67 @@ impl VmMappingInner {
         Ok(())
     }
 
+    /// Maps the given pages in the page index range with a single walk of the page table.
+    fn map_pages(
+        &mut self,
+        vm_space: &VmSpace,
+        page_idx_range: Range<usize>,
+        pages: Vec<(usize, Frame)>,
+        is_readonly: bool,
+        can_overwrite: bool,
+    ) -> Result<()> {
+        let map_range =
+            self.page_map_addr(page_idx_range.start)..self.page_map_addr(page_idx_range.end);
+
+        let vm_perms = {
+            let mut perms = self.perms;
+            if is_readonly {
+                // COW pages are forced to be read-only.
+                perms -= VmPerms::WRITE;
+            }
+            perms
+        };
+
+        let vm_map_options = {
+            let mut options = VmMapOptions::new();
+            options.flags(vm_perms.into());
+            options.can_overwrite(can_overwrite);
+            options
+        };
+
+        self.mapped_pages
+            .extend(pages.iter().map(|(page_idx, _)| *page_idx));
+        let pages = pages
+            .into_iter()
+            .map(|(page_idx, frame)| (self.page_map_addr(page_idx), frame));
+        vm_space.map_pages(&map_range, pages, &vm_map_options)?;
+        Ok(())
+    }
+
+    fn map_huge_page(
+        &mut self,
+        vm_space: &VmSpace,
+        start_page_idx: usize,
+        frames: FrameVec,
+    ) -> Result<()> {
+        let map_addr = self.page_map_addr(start_page_idx);
+        let nr_pages = frames.len();
+
+        let vm_map_options = {
+            let mut options = VmMapOptions::new();
+            options.addr(Some(map_addr));
+            options.flags(self.perms.into());
+            // The base pages that are already mapped are collapsed into the huge page.
+            options.can_overwrite(true);
+            options
+        };
+
+        vm_space.map_huge(frames, &vm_map_options)?;
+        self.mapped_pages
+            .extend(start_page_idx..start_page_idx + nr_pages);
+        Ok(())
+    }
+
     fn unmap_one_page(&mut self, vm_space: &VmSpace, page_idx: usize) -> Result<()> {
         let map_addr = self.page_map_addr(page_idx);
         let range = map_addr..(map_addr + PAGE_SIZE);
@@ -501,14 +739,16 @@ impl VmMappingInner {
 
     /// Unmap pages in the range.
     fn unmap(&mut self, vm_space: &VmSpace, range: &Range<usize>, may_destroy: bool) -> Result<()> {
-        let map_to_addr = self.map_to_addr;
-        let vmo_map_range = (range.start - map_to_addr + self.vmo_offset)
-            ..(range.end - map_to_addr + self.vmo_offset);
-        let page_idx_range = get_page_idx_range(&vmo_map_range);
-        let original_mapped_pages = self.mapped_pages.clone();
-        let mapped_pages_in_range = original_mapped_pages.range(page_idx_range);
-        for page_idx in mapped_pages_in_range {
-            self.unmap_one_page(vm_space, *page_idx)?;
+        if is_intersected(range, &self.range()) {
+            let map_to_addr = self.map_to_addr;
+            let unmap_range = get_intersected_range(range, &self.range());
+            let vmo_map_range = (unmap_range.start - map_to_addr + self.vmo_offset)
+                ..(unmap_range.end - map_to_addr + self.vmo_offset);
+            let page_idx_range = get_page_idx_range(&vmo_map_range);
+            // Unmap the whole range at once, so that the huge pages in the range are not split.
+            vm_space.unmap(&unmap_range)?;
+            self.mapped_pages
+                .retain(|page_idx| !page_idx_range.contains(page_idx));
         }
         if may_destroy && *range == self.range() {
             self.is_destroyed = true;
@@ -528,17 +768,10 @@ impl VmMappingInner {
     ) -> Result<()> {
         debug_assert!(range.start % PAGE_SIZE == 0);
         debug_assert!(range.end % PAGE_SIZE == 0);
-        let start_page = (range.start - self.map_to_addr + self.vmo_offset) / PAGE_SIZE;
-        let end_page = (range.end - self.map_to_addr + self.vmo_offset) / PAGE_SIZE;
         let flags: PageFlags = perms.into();
-        for page_idx in start_page..end_page {
-            let page_addr = self.page_map_addr(page_idx);
-            if vm_space.query(page_addr)?.is_some() {
-                // If the page is already mapped, we will modify page table
-                let page_range = page_addr..(page_addr + PAGE_SIZE);
-                vm_space.protect(&page_range, |p| p.flags = flags)?;
-            }
-        }
+        // The pages that are not mapped are skipped, and the huge pages that are
+        // partially protected are split.
+        vm_space.protect(&range, |p| p.flags = flags)?;
         Ok(())
     }
 
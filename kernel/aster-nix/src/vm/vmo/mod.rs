@@ -11,7 +11,7 @@ use align_ext::AlignExt;
 use aster_rights::Rights;
 use ostd::{
     collections::xarray::{CursorMut, XArray, XMark},
-    mm::{Frame, FrameAllocOptions, VmReader, VmWriter},
+    mm::{Frame, FrameAllocOptions, FrameVec, VmReader, VmWriter, HUGE_PAGE_SIZE},
 };
 
 use crate::prelude::*;
@@ -83,6 +83,19 @@ use self::options::ChildType;
 ///
 pub struct Vmo<R = Rights>(pub(super) Arc<Vmo_>, R);
 
+/// A weak reference to a VMO, which is created by `Vmo::downgrade`.
+///
+/// A `WeakVmo` does not keep the VMO alive. So the pager of a VMO can refer
+/// back to the VMO without making a reference cycle.
+pub struct WeakVmo<R = Rights>(Weak<Vmo_>, R);
+
+impl<R: Clone> WeakVmo<R> {
+    /// Upgrades to a VMO with the same access rights, if the VMO is still alive.
+    pub fn upgrade(&self) -> Option<Vmo<R>> {
+        self.0.upgrade().map(|vmo_| Vmo(vmo_, self.1.clone()))
+    }
+}
+
 /// Functions exist both for static capbility and dynamic capibility
 pub trait VmoRightsOp {
     /// Returns the access rights.
@@ -339,6 +352,77 @@ impl Vmo_ {
         })
     }
 
+    /// Commit the pages of the huge page starting at the target offset in the VMO and
+    /// return them if they make up a huge page, i.e., they are physically contiguous
+    /// and aligned to the huge page size.
+    ///
+    /// If none of the pages has been committed, a huge page is allocated for them.
+    /// If all of them have been committed, e.g., as a huge page that was split later,
+    /// the committed pages are returned if they still make up a huge page. Otherwise,
+    /// if `may_collapse` is set, the committed pages are collapsed into a new huge page
+    /// by copying their contents, and the new huge page replaces them in the VMO.
+    ///
+    /// Only anonymous VMOs that do not require COW can be backed by huge pages.
+    /// `None` is returned if the pages cannot be backed by a huge page, in which
+    /// case they should be committed one by one.
+    pub fn commit_huge_page(&self, offset: usize, may_collapse: bool) -> Result<Option<FrameVec>> {
+        debug_assert!(offset % HUGE_PAGE_SIZE == 0);
+        if self.pager.is_some() || self.flags.contains(VmoFlags::CONTIGUOUS) {
+            return Ok(None);
+        }
+
+        let nr_pages = HUGE_PAGE_SIZE / PAGE_SIZE;
+        let page_idx = offset / PAGE_SIZE + self.page_idx_offset;
+        self.pages.with(|pages, size| {
+            if pages.is_marked(VmoMark::CowVmo) || offset + HUGE_PAGE_SIZE > size {
+                return Ok(None);
+            }
+
+            let mut frames = FrameVec::new_with_capacity(nr_pages);
+            let mut cursor = pages.cursor_mut(page_idx as u64);
+            for _ in 0..nr_pages {
+                if let Some(frame) = cursor.load() {
+                    frames.push(frame.clone());
+                }
+                cursor.next();
+            }
+
+            if frames.len() == nr_pages {
+                let start_paddr = frames.get(0).unwrap().start_paddr();
+                let is_huge_page = start_paddr % HUGE_PAGE_SIZE == 0
+                    && frames
+                        .iter()
+                        .enumerate()
+                        .all(|(i, frame)| frame.start_paddr() == start_paddr + i * PAGE_SIZE);
+                if is_huge_page {
+                    return Ok(Some(frames));
+                }
+            }
+            if !frames.is_empty() && !may_collapse {
+                return Ok(None);
+            }
+
+            // Fall back to base pages if there are no free huge pages.
+            let Ok(segment) = FrameAllocOptions::new(nr_pages).alloc_contiguous() else {
+                return Ok(None);
+            };
+            if segment.start_paddr() % HUGE_PAGE_SIZE != 0 {
+                return Ok(None);
+            }
+            let huge_page = FrameVec::from(segment);
+
+            let mut cursor = pages.cursor_mut(page_idx as u64);
+            for frame in huge_page.iter() {
+                if let Some(committed_page) = cursor.load() {
+                    frame.copy_from(&committed_page);
+                }
+                cursor.store(frame.clone());
+                cursor.next();
+            }
+            Ok(Some(huge_page))
+        })
+    }
+
     /// Decommit the page corresponding to the target offset in the VMO.
     fn decommit_page(&mut self, offset: usize) -> Result<()> {
         let page_idx = offset / PAGE_SIZE + self.page_idx_offset;
@@ -387,6 +471,37 @@ impl Vmo_ {
         })
     }
 
+    /// Returns the pages in the range that have been committed or can be committed
+    /// without waiting for any I/O, along with their indices in the VMO.
+    ///
+    /// Only the pages of VMOs with pagers are returned, e.g., the pages that are
+    /// already in the page cache of a file. Note that the pages are not copied even if
+    /// the VMO requires COW, so they can only be mapped as read-only in this case.
+    pub fn cached_pages(&self, range: &Range<usize>) -> Vec<(usize, Frame)> {
+        let Some(pager) = &self.pager else {
+            return Vec::new();
+        };
+
+        self.pages.with(|pages, size| {
+            let raw_page_idx_range = get_page_idx_range(&(range.start..range.end.min(size)));
+            let mut cursor =
+                pages.cursor_mut((raw_page_idx_range.start + self.page_idx_offset) as u64);
+            let mut cached_pages = Vec::new();
+            for raw_page_idx in raw_page_idx_range {
+                if let Some(committed_page) = cursor.load() {
+                    cached_pages.push((raw_page_idx, committed_page.clone()));
+                } else if let Some(page) = pager.try_commit_page(cursor.index() as usize) {
+                    // The page is committed as if it is committed for reading,
+                    // see condition 2 in `prepare_page`.
+                    cursor.store(page.clone());
+                    cached_pages.push((raw_page_idx, page));
+                }
+                cursor.next();
+            }
+            cached_pages
+        })
+    }
+
     /// Decommit a range of pages in the VMO.
     pub fn decommit(&self, range: Range<usize>) -> Result<()> {
         self.pages.with(|pages, size| {
@@ -395,6 +510,40 @@ impl Vmo_ {
         })
     }
 
+    /// Decommit the pages at the target indices that are committed and for whose
+    /// committed frames `cond` returns true.
+    ///
+    /// The conditions are checked with the pages locked, so no one can commit
+    /// the pages in the meantime. The pager is notified of the pages at once.
+    /// Returns the indices of the decommitted pages.
+    pub fn decommit_pages_if<F>(&self, page_indices: &[usize], mut cond: F) -> Result<Vec<usize>>
+    where
+        F: FnMut(usize, &Frame) -> bool,
+    {
+        self.pages.with(|pages, size| {
+            let is_cow_vmo = pages.is_marked(VmoMark::CowVmo);
+            let mut decommitted = Vec::new();
+            for &page_idx in page_indices {
+                let mut cursor = pages.cursor_mut((page_idx + self.page_idx_offset) as u64);
+                if cursor.load().is_some_and(|frame| cond(page_idx, &frame)) {
+                    cursor.remove();
+                    decommitted.push(page_idx);
+                }
+            }
+            if let Some(pager) = &self.pager
+                && !is_cow_vmo
+                && !decommitted.is_empty()
+            {
+                let pager_indices: Vec<usize> = decommitted
+                    .iter()
+                    .map(|page_idx| page_idx + self.page_idx_offset)
+                    .collect();
+                pager.decommit_pages(&pager_indices)?;
+            }
+            Ok(decommitted)
+        })
+    }
+
     /// Read the specified amount of buffer content starting from the target offset in the VMO.
     pub fn read_bytes(&self, offset: usize, buf: &mut [u8]) -> Result<()> {
         let read_len = buf.len();
@@ -449,9 +598,7 @@ impl Vmo_ {
             let raw_page_idx_range = get_page_idx_range(&write_range);
             let page_idx_range = (raw_page_idx_range.start + self.page_idx_offset)
                 ..(raw_page_idx_range.end + self.page_idx_offset);
-            for page_idx in page_idx_range {
-                pager.update_page(page_idx)?;
-            }
+            pager.update_page_range(page_idx_range)?;
         }
         Ok(())
     }
@@ -651,6 +798,47 @@ impl<R> Vmo<R> {
         self.0.commit_page(page_idx * PAGE_SIZE, write_page)
     }
 
+    /// Returns the committed frames in the page index range, committing them if needed.
+    pub fn get_committed_frames(
+        &self,
+        page_idx_range: Range<usize>,
+        write_page: bool,
+    ) -> Result<Vec<Frame>> {
+        let commit_flags = if write_page {
+            CommitFlags::WILL_WRITE
+        } else {
+            CommitFlags::empty()
+        };
+        let mut frames = Vec::with_capacity(page_idx_range.len());
+        self.0.commit_and_operate(
+            &((page_idx_range.start * PAGE_SIZE)..(page_idx_range.end * PAGE_SIZE)),
+            |frame| frames.push(frame),
+            commit_flags,
+        )?;
+        Ok(frames)
+    }
+
+    /// Returns the frames in the page index range that are ready to be mapped without
+    /// waiting for any I/O, along with their page indices.
+    ///
+    /// See [`Vmo_::cached_pages`] for more details.
+    pub fn get_cached_frames(&self, page_idx_range: Range<usize>) -> Vec<(usize, Frame)> {
+        self.0
+            .cached_pages(&((page_idx_range.start * PAGE_SIZE)..(page_idx_range.end * PAGE_SIZE)))
+    }
+
+    /// Returns the committed frames of the huge page starting at the page index,
+    /// or `None` if the pages cannot be backed by a huge page.
+    ///
+    /// See [`Vmo_::commit_huge_page`] for more details.
+    pub fn get_committed_huge_page(
+        &self,
+        page_idx: usize,
+        may_collapse: bool,
+    ) -> Result<Option<FrameVec>> {
+        self.0.commit_huge_page(page_idx * PAGE_SIZE, may_collapse)
+    }
+
     pub fn is_cow_vmo(&self) -> bool {
         self.0.is_cow_vmo()
     }
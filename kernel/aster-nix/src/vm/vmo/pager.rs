@@ -1,5 +1,7 @@
 // SPDX-License-Identifier: MPL-2.0
 
+use core::ops::Range;
+
 use ostd::mm::Frame;
 
 use crate::prelude::*;
@@ -28,6 +30,17 @@ pub trait Pager: Send + Sync {
     /// It is up to the pager to decide the range of valid indices.
     fn commit_page(&self, idx: usize) -> Result<Frame>;
 
+    /// Ask the pager to provide a frame at a specified index only if the frame
+    /// is ready, i.e., it can be provided without waiting for any I/O.
+    ///
+    /// Returning `None` is not an error. The frame can still be provided by
+    /// [`commit_page`], which may wait for the I/O to complete.
+    ///
+    /// [`commit_page`]: Pager::commit_page
+    fn try_commit_page(&self, _idx: usize) -> Option<Frame> {
+        None
+    }
+
     /// Notify the pager that the frame at a specified index has been updated.
     ///
     /// Being aware of the updates allow the pager (e.g., an inode) to
@@ -40,6 +53,17 @@ pub trait Pager: Send + Sync {
     /// call or return an error.
     fn update_page(&self, idx: usize) -> Result<()>;
 
+    /// Notify the pager that the frames within the specified index range have been
+    /// updated by a single write.
+    ///
+    /// The pager may handle the write as a whole, e.g., to throttle the writer only once.
+    fn update_page_range(&self, idx_range: Range<usize>) -> Result<()> {
+        for idx in idx_range {
+            self.update_page(idx)?;
+        }
+        Ok(())
+    }
+
     /// Notify the pager that the frame at the specified index has been decommitted.
     ///
     /// Knowing that a frame is no longer needed, the pager (e.g., an inode)
@@ -51,6 +75,16 @@ pub trait Pager: Send + Sync {
     /// call or return an error.
     fn decommit_page(&self, idx: usize) -> Result<()>;
 
+    /// Notify the pager that the frames at the specified indices have been decommitted.
+    ///
+    /// The pager may handle the pages at once, e.g., to update its index only once.
+    fn decommit_pages(&self, indices: &[usize]) -> Result<()> {
+        for idx in indices {
+            self.decommit_page(*idx)?;
+        }
+        Ok(())
+    }
+
     /// Ask the pager to provide a frame at a specified index.
     /// Notify the pager that the frame will be fully overwritten soon, so pager can
     /// choose not to initialize it.
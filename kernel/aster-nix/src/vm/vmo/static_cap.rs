@@ -8,7 +8,7 @@ use ostd::mm::{Frame, VmIo};
 
 use super::{
     options::{VmoCowChild, VmoSliceChild},
-    CommitFlags, Vmo, VmoChildOptions, VmoRightsOp,
+    CommitFlags, Vmo, VmoChildOptions, VmoRightsOp, WeakVmo,
 };
 use crate::prelude::*;
 
@@ -103,6 +103,22 @@ impl<R: TRights> Vmo<TRightSet<R>> {
         self.0.decommit(range)
     }
 
+    /// Decommits the pages at `page_indices` that are committed and for whose
+    /// committed frames `cond` returns true.
+    ///
+    /// Returns the indices of the decommitted pages.
+    ///
+    /// # Access rights
+    ///
+    /// The method requires the Write right.
+    #[require(R > Write)]
+    pub fn decommit_pages_if<F>(&self, page_indices: &[usize], cond: F) -> Result<Vec<usize>>
+    where
+        F: FnMut(usize, &Frame) -> bool,
+    {
+        self.0.decommit_pages_if(page_indices, cond)
+    }
+
     /// Resize the VMO by giving a new size.
     ///
     /// The VMO must be resizable.
@@ -137,6 +153,16 @@ impl<R: TRights> Vmo<TRightSet<R>> {
         Vmo(self.0.clone(), self.1)
     }
 
+    /// Creates a weak reference to the VMO.
+    ///
+    /// # Access rights
+    ///
+    /// The method requires the Dup right.
+    #[require(R > Dup)]
+    pub fn downgrade(&self) -> WeakVmo<TRightSet<R>> {
+        WeakVmo(Arc::downgrade(&self.0), self.1)
+    }
+
     /// Strict the access rights.
     #[require(R > R1)]
     pub fn restrict<R1: TRights>(self) -> Vmo<TRightSet<R1>> {
@@ -7,7 +7,7 @@ use ostd::{
     sync::WaitQueue,
 };
 
-use super::{id::Sid, BlockDevice};
+use super::{id::Sid, request_queue::BioRequest, BlockDevice};
 use crate::prelude::*;
 
 /// The unit for block I/O.
@@ -129,6 +129,106 @@ impl Bio {
     }
 }
 
+/// A plug that holds back `Bio`s, so that a burst of `Bio`s can be merged before
+/// they are enqueued to the block device.
+///
+/// The `Bio`s submitted through a plug are merged into `BioRequest`s if their sector
+/// ranges are contiguous, and the requests are enqueued when the plug is flushed or
+/// dropped. The caller must flush the plug before waiting for the `Bio`s, otherwise
+/// the wait will never end.
+///
+/// # Examples
+///
+/// ```no_run
+/// let mut plug = BioPlug::new(block_device);
+/// let mut bio_waiter = BioWaiter::new();
+/// for bio in bios {
+///     bio_waiter.concat(plug.submit(&bio)?);
+/// }
+/// plug.flush();
+/// bio_waiter.wait();
+/// ```
+#[must_use]
+#[derive(Debug)]
+pub struct BioPlug<'a> {
+    block_device: &'a dyn BlockDevice,
+    requests: Vec<BioRequest>,
+    max_nr_segments_per_bio: usize,
+}
+
+impl<'a> BioPlug<'a> {
+    /// The maximum number of requests held by a plug.
+    ///
+    /// The plug is flushed automatically if the held requests reach this number.
+    const MAX_REQUESTS: usize = 16;
+
+    /// Creates a new plug for the `block_device`.
+    pub fn new(block_device: &'a dyn BlockDevice) -> Self {
+        Self {
+            block_device,
+            requests: Vec::new(),
+            max_nr_segments_per_bio: block_device.max_nr_segments_per_bio(),
+        }
+    }
+
+    /// Submits a `Bio` to the plug.
+    ///
+    /// Returns a `BioWaiter` to the caller to wait for its completion after
+    /// the plug is flushed.
+    ///
+    /// # Panics
+    ///
+    /// The caller must not submit a `Bio` more than once. Otherwise, a panic shall be triggered.
+    pub fn submit(&mut self, bio: &Bio) -> Result<BioWaiter, BioEnqueueError> {
+        if bio.segments().len() >= self.max_nr_segments_per_bio {
+            return Err(BioEnqueueError::TooBig);
+        }
+
+        // Change the status from "Init" to "Submit".
+        let result = bio.0.status.compare_exchange(
+            BioStatus::Init as u32,
+            BioStatus::Submit as u32,
+            Ordering::Release,
+            Ordering::Relaxed,
+        );
+        assert!(result.is_ok());
+
+        let submitted_bio = SubmittedBio(bio.0.clone());
+        match self.requests.last_mut() {
+            Some(request)
+                if request.can_merge(&submitted_bio)
+                    && request.num_segments() + submitted_bio.segments().len()
+                        <= self.max_nr_segments_per_bio =>
+            {
+                request.merge_bio(submitted_bio)
+            }
+            _ => {
+                if self.requests.len() >= Self::MAX_REQUESTS {
+                    self.flush();
+                }
+                self.requests.push(BioRequest::from(submitted_bio));
+            }
+        }
+
+        Ok(BioWaiter {
+            bios: vec![bio.0.clone()],
+        })
+    }
+
+    /// Enqueues all the held requests to the block device.
+    pub fn flush(&mut self) {
+        for request in self.requests.drain(..) {
+            self.block_device.enqueue_request(request);
+        }
+    }
+}
+
+impl Drop for BioPlug<'_> {
+    fn drop(&mut self) {
+        self.flush();
+    }
+}
+
 /// The error type returned when enqueueing the `Bio`.
 #[derive(Clone, Copy, PartialEq, Eq, Debug)]
 pub enum BioEnqueueError {
@@ -260,6 +360,11 @@ impl SubmittedBio {
         self.0.status()
     }
 
+    /// Creates another reference to the same submitted `Bio`.
+    pub(crate) fn dup(&self) -> Self {
+        Self(self.0.clone())
+    }
+
     /// Completes the `Bio` with the `status` and invokes the callback function.
     ///
     /// When the driver finishes the request for this `Bio`, it will call this method.
@@ -3,7 +3,7 @@
 use ostd::mm::{Frame, FrameAllocOptions, Segment, VmIo};
 
 use super::{
-    bio::{Bio, BioEnqueueError, BioSegment, BioStatus, BioType, BioWaiter, SubmittedBio},
+    bio::{Bio, BioEnqueueError, BioPlug, BioSegment, BioStatus, BioType, BioWaiter, SubmittedBio},
     id::{Bid, Sid},
     BlockDevice, BLOCK_SIZE, SECTOR_SIZE,
 };
@@ -165,34 +165,52 @@ impl dyn BlockDevice {
             return Ok(BioWaiter::new());
         }
 
-        let bio = {
-            let num_blocks = {
-                let first = Bid::from_offset(offset).to_raw();
-                let last = Bid::from_offset(offset + buf.len() - 1).to_raw();
-                last - first + 1
-            };
-            let segment = FrameAllocOptions::new(num_blocks as usize)
-                .uninit(true)
-                .alloc_contiguous()?;
-            segment.write_bytes(offset % BLOCK_SIZE, buf)?;
-            let len = segment
-                .writer()
-                .skip(offset % BLOCK_SIZE)
-                .write(&mut buf.into());
-            let bio_segment = BioSegment::from_segment(segment, offset % BLOCK_SIZE, len);
-            Bio::new(
-                BioType::Write,
-                Sid::from_offset(offset),
-                vec![bio_segment],
-                Some(general_complete_fn),
-            )
-        };
-
+        let bio = create_bio_from_bytes(offset, buf)?;
         let complete = bio.submit(self)?;
         Ok(complete)
     }
 }
 
+/// Implements several commonly used APIs for the plug to conveniently
+/// read and write block(s) in a batch.
+impl BioPlug<'_> {
+    /// Asynchronously reads one block indicated by the `bid`.
+    pub fn read_block(&mut self, bid: Bid, frame: &Frame) -> Result<BioWaiter, BioEnqueueError> {
+        let bio = create_bio_from_frame(BioType::Read, bid, frame);
+        self.submit(&bio)
+    }
+
+    /// Asynchronously writes contiguous blocks starting from the `bid`.
+    pub fn write_blocks(
+        &mut self,
+        bid: Bid,
+        segment: &Segment,
+    ) -> Result<BioWaiter, BioEnqueueError> {
+        let bio = create_bio_from_segment(BioType::Write, bid, segment);
+        self.submit(&bio)
+    }
+
+    /// Asynchronously writes one block indicated by the `bid`.
+    pub fn write_block(&mut self, bid: Bid, frame: &Frame) -> Result<BioWaiter, BioEnqueueError> {
+        let bio = create_bio_from_frame(BioType::Write, bid, frame);
+        self.submit(&bio)
+    }
+
+    /// Asynchronously writes consecutive bytes of several sectors in size.
+    pub fn write_bytes(&mut self, offset: usize, buf: &[u8]) -> ostd::Result<BioWaiter> {
+        if offset % SECTOR_SIZE != 0 || buf.len() % SECTOR_SIZE != 0 {
+            return Err(ostd::Error::InvalidArgs);
+        }
+        if buf.is_empty() {
+            return Ok(BioWaiter::new());
+        }
+
+        let bio = create_bio_from_bytes(offset, buf)?;
+        let complete = self.submit(&bio)?;
+        Ok(complete)
+    }
+}
+
 // TODO: Maybe we should have a builder for `Bio`.
 fn create_bio_from_segment(type_: BioType, bid: Bid, segment: &Segment) -> Bio {
     let bio_segment = BioSegment::from_segment(segment.clone(), 0, segment.nbytes());
@@ -215,6 +233,29 @@ fn create_bio_from_frame(type_: BioType, bid: Bid, frame: &Frame) -> Bio {
     )
 }
 
+fn create_bio_from_bytes(offset: usize, buf: &[u8]) -> ostd::Result<Bio> {
+    let num_blocks = {
+        let first = Bid::from_offset(offset).to_raw();
+        let last = Bid::from_offset(offset + buf.len() - 1).to_raw();
+        last - first + 1
+    };
+    let segment = FrameAllocOptions::new(num_blocks as usize)
+        .uninit(true)
+        .alloc_contiguous()?;
+    segment.write_bytes(offset % BLOCK_SIZE, buf)?;
+    let len = segment
+        .writer()
+        .skip(offset % BLOCK_SIZE)
+        .write(&mut buf.into());
+    let bio_segment = BioSegment::from_segment(segment, offset % BLOCK_SIZE, len);
+    Ok(Bio::new(
+        BioType::Write,
+        Sid::from_offset(offset),
+        vec![bio_segment],
+        Some(general_complete_fn),
+    ))
+}
+
 fn general_complete_fn(bio: &SubmittedBio) {
     match bio.status() {
         BioStatus::Complete => (),
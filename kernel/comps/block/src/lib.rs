@@ -46,8 +46,9 @@ use ostd::sync::SpinLock;
 use spin::Once;
 
 use self::{
-    bio::{BioEnqueueError, SubmittedBio},
+    bio::{BioEnqueueError, BioStatus, SubmittedBio},
     prelude::*,
+    request_queue::BioRequest,
 };
 
 pub const BLOCK_SIZE: usize = ostd::mm::PAGE_SIZE;
@@ -56,6 +57,18 @@ pub const SECTOR_SIZE: usize = 512;
 pub trait BlockDevice: Send + Sync + Any + Debug {
     /// Enqueues a new `SubmittedBio` to the block device.
     fn enqueue(&self, bio: SubmittedBio) -> Result<(), BioEnqueueError>;
+    /// Enqueues a `BioRequest`, which consists of contiguous `SubmittedBio`s, to the block device.
+    ///
+    /// If the request cannot be enqueued, its `SubmittedBio`s are completed with
+    /// `BioStatus::IoError`.
+    fn enqueue_request(&self, request: BioRequest) {
+        for bio in request.into_bios() {
+            let bio_ref = bio.dup();
+            if self.enqueue(bio).is_err() {
+                bio_ref.complete(BioStatus::IoError);
+            }
+        }
+    }
     /// Returns the upper limit for the number of segments per bio.
     fn max_nr_segments_per_bio(&self) -> usize;
 }
@@ -1,40 +1,87 @@
 // SPDX-License-Identifier: MPL-2.0
 
-use ostd::sync::{Mutex, WaitQueue};
+use ostd::{
+    cpu::{num_cpus, this_cpu},
+    sync::{SpinLock, WaitQueue},
+};
 
 use super::{
-    bio::{BioEnqueueError, BioType, SubmittedBio},
+    bio::{BioEnqueueError, BioStatus, BioType, SubmittedBio},
     id::Sid,
 };
 use crate::prelude::*;
 
-/// A simple block I/O request queue backed by one internal FIFO queue.
+/// A multi-queue block I/O request queue.
 ///
-/// It is a FIFO producer-consumer queue, where the producer (e.g., filesystem)
-/// submits requests to the queue, and the consumer (e.g., block device driver)
-/// continuously consumes and processes these requests from the queue.
+/// The queue consists of two levels of queues:
+/// - The software staging queues, one per CPU, to which the producers (e.g., filesystems)
+///   submit requests. A producer only contends with others on the same CPU.
+/// - The hardware dispatch queues, one per hardware queue of the device, from which the
+///   consumers (e.g., the block device driver) fetch requests. Each hardware dispatch
+///   queue serves a fixed subset of the software staging queues.
 ///
-/// It supports merging the new request with the front request if if the type
-/// is same and the sector range is contiguous.
-pub struct BioRequestSingleQueue {
-    queue: Mutex<VecDeque<BioRequest>>,
+/// It supports merging the new request with the last request of the software staging queue
+/// if the type is same and the sector range is contiguous.
+pub struct BioRequestMultiQueue {
+    sw_queues: Vec<SoftwareQueue>,
+    hw_queues: Vec<HardwareQueue>,
+    max_nr_segments_per_bio: usize,
+}
+
+/// A software staging queue.
+struct SoftwareQueue {
+    requests: SpinLock<VecDeque<BioRequest>>,
+}
+
+/// A hardware dispatch queue.
+struct HardwareQueue {
+    /// The number of requests in the software staging queues served by this queue
     num_requests: AtomicUsize,
+    /// The index of the software staging queue to be checked first
+    next_sw_queue: AtomicUsize,
     wait_queue: WaitQueue,
-    max_nr_segments_per_bio: usize,
 }
 
-impl BioRequestSingleQueue {
-    /// Creates an empty queue.
-    pub fn new() -> Self {
-        Self::with_max_nr_segments_per_bio(usize::MAX)
+impl BioRequestMultiQueue {
+    /// Creates an empty queue with the number of hardware queues.
+    ///
+    /// # Panics
+    ///
+    /// If `nr_hw_queues` is zero, this method will panic.
+    pub fn new(nr_hw_queues: usize) -> Self {
+        Self::with_max_nr_segments_per_bio(nr_hw_queues, usize::MAX)
     }
 
-    /// Creates an empty queue with the upper bound for the number of segments in a bio.
-    pub fn with_max_nr_segments_per_bio(max_nr_segments_per_bio: usize) -> Self {
+    /// Creates an empty queue with the number of hardware queues and
+    /// the upper bound for the number of segments in a bio.
+    ///
+    /// # Panics
+    ///
+    /// If `nr_hw_queues` is zero, this method will panic.
+    pub fn with_max_nr_segments_per_bio(
+        nr_hw_queues: usize,
+        max_nr_segments_per_bio: usize,
+    ) -> Self {
+        assert!(nr_hw_queues > 0);
+
+        // Each hardware queue is expected to serve at least one CPU.
+        let nr_sw_queues = (num_cpus() as usize).max(nr_hw_queues);
+        let sw_queues = (0..nr_sw_queues)
+            .map(|_| SoftwareQueue {
+                requests: SpinLock::new(VecDeque::new()),
+            })
+            .collect();
+        let hw_queues = (0..nr_hw_queues)
+            .map(|_| HardwareQueue {
+                num_requests: AtomicUsize::new(0),
+                next_sw_queue: AtomicUsize::new(0),
+                wait_queue: WaitQueue::new(),
+            })
+            .collect();
+
         Self {
-            queue: Mutex::new(VecDeque::new()),
-            num_requests: AtomicUsize::new(0),
-            wait_queue: WaitQueue::new(),
+            sw_queues,
+            hw_queues,
             max_nr_segments_per_bio,
         }
     }
@@ -44,15 +91,24 @@ impl BioRequestSingleQueue {
         self.max_nr_segments_per_bio
     }
 
+    /// Returns the number of hardware queues.
+    pub fn nr_hw_queues(&self) -> usize {
+        self.hw_queues.len()
+    }
+
     /// Returns the number of requests currently in this queue.
     pub fn num_requests(&self) -> usize {
-        self.num_requests.load(Ordering::Relaxed)
+        self.hw_queues
+            .iter()
+            .map(|hw_queue| hw_queue.num_requests.load(Ordering::Relaxed))
+            .sum()
     }
 
     /// Enqueues a `SubmittedBio` to this queue.
     ///
-    /// When enqueueing the `SubmittedBio`, try to insert it into the last request if the
-    /// type is same and the sector range is contiguous.
+    /// When enqueueing the `SubmittedBio`, try to insert it into the last request of
+    /// the software staging queue of the current CPU if the type is same and the sector
+    /// range is contiguous.
     /// Otherwise, creates and inserts a new request for the `SubmittedBio`.
     ///
     /// This method will wake up the waiter if a new `BioRequest` is enqueued.
@@ -61,71 +117,117 @@ impl BioRequestSingleQueue {
             return Err(BioEnqueueError::TooBig);
         }
 
-        let mut queue = self.queue.lock();
-        if let Some(request) = queue.front_mut() {
-            if request.can_merge(&bio)
-                && request.num_segments() + bio.segments().len() <= self.max_nr_segments_per_bio
+        self.enqueue_request_inner(BioRequest::from(bio));
+        Ok(())
+    }
+
+    /// Enqueues a `BioRequest` to this queue.
+    ///
+    /// The request is merged with the last request of the software staging queue of
+    /// the current CPU in the same way as [`enqueue`], if possible.
+    ///
+    /// If the request has too many segments, its `SubmittedBio`s are completed with
+    /// `BioStatus::IoError`.
+    ///
+    /// [`enqueue`]: Self::enqueue
+    pub fn enqueue_request(&self, request: BioRequest) {
+        if request.num_segments() > self.max_nr_segments_per_bio {
+            request.complete(BioStatus::IoError);
+            return;
+        }
+
+        self.enqueue_request_inner(request);
+    }
+
+    fn enqueue_request_inner(&self, request: BioRequest) {
+        let sw_index = this_cpu() as usize % self.sw_queues.len();
+        let hw_queue = self.hw_queue_of(sw_index);
+
+        let mut requests = self.sw_queues[sw_index].requests.lock();
+        if let Some(last_request) = requests.back_mut() {
+            if last_request.can_merge_request(&request)
+                && last_request.num_segments() + request.num_segments()
+                    <= self.max_nr_segments_per_bio
             {
-                request.merge_bio(bio);
-                return Ok(());
+                last_request.merge_request(request);
+                return;
             }
         }
 
-        let new_request = BioRequest::from(bio);
-        queue.push_front(new_request);
-        self.inc_num_requests();
-        drop(queue);
+        requests.push_back(request);
+        hw_queue.num_requests.fetch_add(1, Ordering::Relaxed);
+        drop(requests);
 
-        self.wait_queue.wake_all();
-        Ok(())
+        hw_queue.wait_queue.wake_one();
     }
 
-    /// Dequeues a `BioRequest` from this queue.
+    /// Dequeues a `BioRequest` for the `hw_index`-th hardware queue.
     ///
     /// This method will wait until one request can be retrieved.
-    pub fn dequeue(&self) -> BioRequest {
-        let mut num_requests = self.num_requests();
+    ///
+    /// # Panics
+    ///
+    /// If the `hw_index` is out of bounds, this method will panic.
+    pub fn dequeue(&self, hw_index: usize) -> BioRequest {
+        let hw_queue = &self.hw_queues[hw_index];
 
         loop {
-            if num_requests > 0 {
-                let mut queue = self.queue.lock();
-                if let Some(request) = queue.pop_back() {
-                    self.dec_num_requests();
-                    return request;
-                }
+            if let Some(request) = self.try_dequeue(hw_index) {
+                return request;
             }
 
-            num_requests = self.wait_queue.wait_until(|| {
-                let num_requests = self.num_requests();
-                if num_requests > 0 {
-                    Some(num_requests)
-                } else {
-                    None
-                }
-            });
+            hw_queue
+                .wait_queue
+                .wait_until(|| (hw_queue.num_requests.load(Ordering::Relaxed) > 0).then_some(()));
         }
     }
 
-    fn dec_num_requests(&self) {
-        self.num_requests.fetch_sub(1, Ordering::Relaxed);
-    }
+    /// Tries to dequeue a `BioRequest` for the `hw_index`-th hardware queue
+    /// without waiting.
+    ///
+    /// The software staging queues served by the hardware queue are visited
+    /// in a round-robin manner, so that no CPU can starve the others.
+    ///
+    /// # Panics
+    ///
+    /// If the `hw_index` is out of bounds, this method will panic.
+    pub fn try_dequeue(&self, hw_index: usize) -> Option<BioRequest> {
+        let hw_queue = &self.hw_queues[hw_index];
+        if hw_queue.num_requests.load(Ordering::Relaxed) == 0 {
+            return None;
+        }
 
-    fn inc_num_requests(&self) {
-        self.num_requests.fetch_add(1, Ordering::Relaxed);
+        let nr_hw_queues = self.hw_queues.len();
+        let nr_served = self.sw_queues.len().div_ceil(nr_hw_queues);
+        let start = hw_queue.next_sw_queue.load(Ordering::Relaxed);
+        for i in 0..nr_served {
+            let nth = (start + i) % nr_served;
+            let sw_index = hw_index + nth * nr_hw_queues;
+            let Some(sw_queue) = self.sw_queues.get(sw_index) else {
+                continue;
+            };
+            if let Some(request) = sw_queue.requests.lock().pop_front() {
+                hw_queue.num_requests.fetch_sub(1, Ordering::Relaxed);
+                hw_queue
+                    .next_sw_queue
+                    .store((nth + 1) % nr_served, Ordering::Relaxed);
+                return Some(request);
+            }
+        }
+        None
     }
-}
 
-impl Default for BioRequestSingleQueue {
-    fn default() -> Self {
-        Self::new()
+    fn hw_queue_of(&self, sw_index: usize) -> &HardwareQueue {
+        &self.hw_queues[sw_index % self.hw_queues.len()]
     }
 }
 
-impl Debug for BioRequestSingleQueue {
+impl Debug for BioRequestMultiQueue {
     fn fmt(&self, f: &mut core::fmt::Formatter) -> core::fmt::Result {
-        f.debug_struct("BioRequestSingleQueue")
+        f.debug_struct("BioRequestMultiQueue")
+            .field("nr_sw_queues", &self.sw_queues.len())
+            .field("nr_hw_queues", &self.hw_queues.len())
             .field("num_requests", &self.num_requests())
-            .field("queue", &self.queue.lock())
             .finish()
     }
 }
@@ -163,6 +265,11 @@ impl BioRequest {
         self.bios.iter()
     }
 
+    /// Consumes the request and returns the `SubmittedBio`s.
+    pub fn into_bios(self) -> impl Iterator<Item = SubmittedBio> {
+        self.bios.into_iter()
+    }
+
     /// Returns the number of segments.
     pub fn num_segments(&self) -> usize {
         self.num_segments
@@ -170,12 +277,22 @@ impl BioRequest {
 
     /// Returns `true` if can merge the `SubmittedBio`, `false` otherwise.
     pub fn can_merge(&self, rq_bio: &SubmittedBio) -> bool {
-        if rq_bio.type_() != self.type_ {
-            return false;
-        }
+        self.is_adjacent(rq_bio.type_(), rq_bio.sid_range())
+    }
+
+    /// Returns `true` if can merge all the `SubmittedBio`s of the other request,
+    /// `false` otherwise.
+    ///
+    /// This is the same check as [`Self::can_merge`], applied to the whole request.
+    pub fn can_merge_request(&self, other: &BioRequest) -> bool {
+        self.is_adjacent(other.type_, &other.sid_range)
+    }
 
-        rq_bio.sid_range().start == self.sid_range.end
-            || rq_bio.sid_range().end == self.sid_range.start
+    /// Returns whether the I/O of `type_` on `sid_range` can be placed at the front
+    /// or back of this request.
+    fn is_adjacent(&self, type_: BioType, sid_range: &Range<Sid>) -> bool {
+        type_ == self.type_
+            && (sid_range.start == self.sid_range.end || sid_range.end == self.sid_range.start)
     }
 
     /// Merges the `SubmittedBio` into this request.
@@ -200,6 +317,33 @@ impl BioRequest {
 
         self.num_segments += rq_bio_nr_segments;
     }
+
+    /// Merges all the `SubmittedBio`s of the other request into this request.
+    ///
+    /// The `SubmittedBio`s are merged one by one with [`Self::merge_bio`], in the
+    /// order that keeps each of them adjacent to this request.
+    ///
+    /// # Panics
+    ///
+    /// If the other request can not be merged, this method will panic.
+    pub fn merge_request(&mut self, other: BioRequest) {
+        assert!(self.can_merge_request(&other));
+
+        if other.sid_range.start == self.sid_range.end {
+            for bio in other.bios {
+                self.merge_bio(bio);
+            }
+        } else {
+            for bio in other.bios.into_iter().rev() {
+                self.merge_bio(bio);
+            }
+        }
+    }
+
+    /// Completes all the `SubmittedBio`s in this request with the `status`.
+    pub fn complete(&self, status: BioStatus) {
+        self.bios.iter().for_each(|bio| bio.complete(status));
+    }
 }
 
 impl From<SubmittedBio> for BioRequest {
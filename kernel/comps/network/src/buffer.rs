@@ -56,6 +56,15 @@ impl TxBuffer {
         self.dma_stream.writer().unwrap().limit(self.nbytes)
     }
 
+    /// Overwrites the bytes at `offset` of the buffer, which starts with the header.
+    pub fn write_bytes_at(&mut self, offset: usize, bytes: &[u8]) {
+        let end = offset + bytes.len();
+        assert!(end <= self.nbytes);
+        let mut writer = self.dma_stream.writer().unwrap().skip(offset);
+        writer.write(&mut VmReader::from(bytes));
+        self.dma_stream.sync(offset..end).unwrap();
+    }
+
     fn sync(&self) {
         self.dma_stream.sync(0..self.nbytes).unwrap();
     }
@@ -3,19 +3,28 @@
 #![allow(unused)]
 
 use alloc::{
+    boxed::Box,
     collections::VecDeque,
     sync::{Arc, Weak},
+    vec::Vec,
 };
 use core::ops::Range;
 
 use bitvec::{array::BitArray, prelude::Lsb0};
 use ostd::{
+    cpu::{num_cpus, this_cpu},
     mm::{
         Daddr, DmaDirection, DmaStream, FrameAllocOptions, HasDaddr, VmReader, VmWriter, PAGE_SIZE,
     },
     sync::{RwLock, SpinLock},
 };
 
+/// The number of segments moved between a per-CPU free list and the pool at a time.
+const CACHE_BATCH_SIZE: usize = 16;
+
+/// The maximum number of segments held by a per-CPU free list.
+const CACHE_CAPACITY: usize = 2 * CACHE_BATCH_SIZE;
+
 /// `DmaPool` is responsible for allocating small streaming DMA segments
 /// (equal to or smaller than PAGE_SIZE),
 /// referred to as `DmaSegment`.
@@ -27,14 +36,20 @@ use ostd::{
 ///
 /// Therefore, as a best practice,
 /// it is recommended for the `DmaPool` to have a static lifetime.
+///
+/// The freed segments are kept in per-CPU free lists, from which the segments
+/// are allocated again without locking the pool or the pages. The segments are
+/// moved between the free lists and the pool in batches.
 #[derive(Debug)]
 pub struct DmaPool {
     segment_size: usize,
     direction: DmaDirection,
     is_cache_coherent: bool,
+    init_size: usize,
     high_watermark: usize,
     avail_pages: SpinLock<VecDeque<Arc<DmaPage>>>,
     all_pages: SpinLock<VecDeque<Arc<DmaPage>>>,
+    cpu_caches: Box<[SpinLock<Vec<FreeSegment>>]>,
 }
 
 impl DmaPool {
@@ -82,44 +97,133 @@ impl DmaPool {
                 all_pages.push_back(page);
             }
 
+            let cpu_caches = (0..num_cpus())
+                .map(|_| SpinLock::new(Vec::with_capacity(CACHE_CAPACITY + 1)))
+                .collect();
+
             Self {
                 segment_size,
                 direction,
                 is_cache_coherent,
+                init_size,
                 high_watermark,
                 avail_pages: SpinLock::new(avail_pages),
                 all_pages: SpinLock::new(all_pages),
+                cpu_caches,
             }
         })
     }
 
     /// Allocates a `DmaSegment` from the pool
     pub fn alloc_segment(self: &Arc<Self>) -> Result<DmaSegment, ostd::Error> {
+        let cache = self.cpu_cache();
+        if let Some(free_segment) = cache.lock_irq_disabled().pop() {
+            return Ok(free_segment.into_segment());
+        }
+
+        let mut batch = self.alloc_batch()?;
+        let free_segment = batch.pop().unwrap();
+        cache.lock_irq_disabled().append(&mut batch);
+        Ok(free_segment.into_segment())
+    }
+
+    /// Allocates up to `CACHE_BATCH_SIZE` segments from the pages.
+    ///
+    /// A new page is allocated only if no segments are available.
+    fn alloc_batch(self: &Arc<Self>) -> Result<Vec<FreeSegment>, ostd::Error> {
+        let mut batch = Vec::with_capacity(CACHE_BATCH_SIZE);
+
         // Lock order: pool.avail_pages -> pool.all_pages
         //             pool.avail_pages -> page.allocated_segments
         let mut avail_pages = self.avail_pages.lock_irq_disabled();
-        if avail_pages.is_empty() {
-            /// Allocate a new page
-            let new_page = {
-                let pool = Arc::downgrade(self);
-                Arc::new(DmaPage::new(
-                    self.segment_size,
-                    self.direction,
-                    self.is_cache_coherent,
-                    pool,
-                )?)
-            };
-            let mut all_pages = self.all_pages.lock_irq_disabled();
-            avail_pages.push_back(new_page.clone());
-            all_pages.push_back(new_page);
+        while batch.len() < CACHE_BATCH_SIZE {
+            if avail_pages.is_empty() {
+                if !batch.is_empty() {
+                    break;
+                }
+
+                // Allocate a new page
+                let new_page = {
+                    let pool = Arc::downgrade(self);
+                    Arc::new(DmaPage::new(
+                        self.segment_size,
+                        self.direction,
+                        self.is_cache_coherent,
+                        pool,
+                    )?)
+                };
+                let mut all_pages = self.all_pages.lock_irq_disabled();
+                avail_pages.push_back(new_page.clone());
+                all_pages.push_back(new_page);
+            }
+
+            let first_avail_page = avail_pages.front().unwrap();
+            first_avail_page.alloc_segments(&mut batch, CACHE_BATCH_SIZE);
+            if first_avail_page.is_full() {
+                avail_pages.pop_front();
+            }
+        }
+
+        Ok(batch)
+    }
+
+    /// Returns the segments to their pages.
+    ///
+    /// The pages that become unused are freed if there are more than `high_watermark` pages.
+    fn free_batch(&self, batch: Vec<FreeSegment>) {
+        // Keep the same lock order as `pool.alloc_batch`
+        // Lock order: pool.avail_pages -> pool.all_pages -> page.allocated_segments
+        let mut avail_pages = self.avail_pages.lock_irq_disabled();
+        let mut all_pages = self.all_pages.lock_irq_disabled();
+
+        for FreeSegment { page, index } in batch {
+            let (became_avail, became_free) = page.free_index(index);
+
+            if became_free && all_pages.len() > self.high_watermark {
+                avail_pages.retain(|page_| !Arc::ptr_eq(page_, &page));
+                all_pages.retain(|page_| !Arc::ptr_eq(page_, &page));
+                continue;
+            }
+
+            if became_avail {
+                avail_pages.push_back(page);
+            }
+        }
+    }
+
+    /// Returns the segments in the per-CPU free lists to their pages.
+    fn flush_caches(&self) {
+        for cache in self.cpu_caches.iter() {
+            let batch = core::mem::take(&mut *cache.lock_irq_disabled());
+            self.free_batch(batch);
         }
+    }
+
+    /// Shrinks the pool to its initial capacity, as long as the pages are not in use.
+    ///
+    /// The segments in the per-CPU free lists keep their pages in use, so they are
+    /// flushed first. This is expected to be called when the pool is idle.
+    pub fn shrink(&self) {
+        self.flush_caches();
 
-        let first_avail_page = avail_pages.front().unwrap();
-        let free_segment = first_avail_page.alloc_segment().unwrap();
-        if first_avail_page.is_full() {
-            avail_pages.pop_front();
+        let mut avail_pages = self.avail_pages.lock_irq_disabled();
+        let mut all_pages = self.all_pages.lock_irq_disabled();
+
+        let nr_excess_pages = all_pages.len().saturating_sub(self.init_size);
+        let free_pages: Vec<_> = avail_pages
+            .iter()
+            .filter(|page| page.is_free())
+            .take(nr_excess_pages)
+            .cloned()
+            .collect();
+        for page in free_pages {
+            avail_pages.retain(|page_| !Arc::ptr_eq(page_, &page));
+            all_pages.retain(|page_| !Arc::ptr_eq(page_, &page));
         }
-        Ok(free_segment)
+    }
+
+    fn cpu_cache(&self) -> &SpinLock<Vec<FreeSegment>> {
+        &self.cpu_caches[this_cpu() as usize]
     }
 
     /// Returns the number of pages in pool
@@ -165,23 +269,42 @@ impl DmaPage {
         })
     }
 
-    fn alloc_segment(self: &Arc<Self>) -> Option<DmaSegment> {
+    /// Allocates the free segments in the page until `batch` has `batch_size` segments.
+    fn alloc_segments(self: &Arc<Self>, batch: &mut Vec<FreeSegment>, batch_size: usize) {
         let mut segments = self.allocated_segments.lock_irq_disabled();
-        let free_segment_index = get_next_free_index(&segments, self.nr_blocks_per_page())?;
-        segments.set(free_segment_index, true);
+        while batch.len() < batch_size {
+            let Some(index) = get_next_free_index(&segments, self.nr_blocks_per_page()) else {
+                break;
+            };
+            segments.set(index, true);
+            batch.push(FreeSegment {
+                page: self.clone(),
+                index,
+            });
+        }
+    }
+
+    /// Marks the segment as free.
+    ///
+    /// Returns whether the page becomes available, and whether the page becomes unused.
+    fn free_index(&self, index: usize) -> (bool, bool) {
+        let mut segments = self.allocated_segments.lock_irq_disabled();
+        let became_avail = get_next_free_index(&segments, self.nr_blocks_per_page()).is_none();
+        segments.set(index, false);
+        (became_avail, segments.not_any())
+    }
 
-        let segment = DmaSegment {
+    fn segment_at(self: &Arc<Self>, index: usize) -> DmaSegment {
+        DmaSegment {
             size: self.segment_size,
             dma_stream: self.storage.clone(),
-            start_addr: self.storage.daddr() + free_segment_index * self.segment_size,
+            start_addr: self.storage.daddr() + index * self.segment_size,
             page: Arc::downgrade(self),
-        };
-
-        Some(segment)
+        }
     }
 
     fn is_free(&self) -> bool {
-        *self.allocated_segments.lock() == BitArray::<[usize; 1], Lsb0>::ZERO
+        *self.allocated_segments.lock_irq_disabled() == BitArray::<[usize; 1], Lsb0>::ZERO
     }
 
     const fn nr_blocks_per_page(&self) -> usize {
@@ -204,6 +327,19 @@ fn get_next_free_index(segments: &BitArray, nr_blocks_per_page: usize) -> Option
     }
 }
 
+/// A segment that is not in use, but is still marked as allocated in its page.
+#[derive(Debug)]
+struct FreeSegment {
+    page: Arc<DmaPage>,
+    index: usize,
+}
+
+impl FreeSegment {
+    fn into_segment(self) -> DmaSegment {
+        self.page.segment_at(self.index)
+    }
+}
+
 impl HasDaddr for DmaPage {
     fn daddr(&self) -> Daddr {
         self.storage.daddr()
@@ -255,30 +391,16 @@ impl Drop for DmaSegment {
         let page = self.page.upgrade().unwrap();
         let pool = page.pool.upgrade().unwrap();
 
-        // Keep the same lock order as `pool.alloc_segment`
-        // Lock order: pool.avail_pages -> pool.all_pages -> page.allocated_segments
-        let mut avail_pages = pool.avail_pages.lock_irq_disabled();
-        let mut all_pages = pool.all_pages.lock_irq_disabled();
-
-        let mut allocated_segments = page.allocated_segments.lock_irq_disabled();
-
-        let nr_blocks_per_page = PAGE_SIZE / self.size;
-        let became_avail = get_next_free_index(&allocated_segments, nr_blocks_per_page).is_none();
-
         debug_assert!((page.daddr()..page.daddr() + PAGE_SIZE).contains(&self.daddr()));
-        let segment_idx = (self.daddr() - page.daddr()) / self.size;
-        allocated_segments.set(segment_idx, false);
-
-        let became_free = allocated_segments.not_any();
-
-        if became_free && all_pages.len() > pool.high_watermark {
-            avail_pages.retain(|page_| !Arc::ptr_eq(page_, &page));
-            all_pages.retain(|page_| !Arc::ptr_eq(page_, &page));
-            return;
-        }
+        let index = (self.daddr() - page.daddr()) / self.size;
 
-        if became_avail {
-            avail_pages.push_back(page.clone());
+        let overflow = {
+            let mut cache = pool.cpu_cache().lock_irq_disabled();
+            cache.push(FreeSegment { page, index });
+            (cache.len() > CACHE_CAPACITY).then(|| cache.split_off(CACHE_BATCH_SIZE))
+        };
+        if let Some(batch) = overflow {
+            pool.free_batch(batch);
         }
     }
 }
@@ -332,7 +454,10 @@ mod test {
             .collect();
         assert_eq!(pool.num_pages(), 100);
         drop(segments1);
+        pool.flush_caches();
         assert_eq!(pool.num_pages(), 50);
+        pool.shrink();
+        assert_eq!(pool.num_pages(), 10);
     }
 
     #[ktest]
@@ -352,9 +477,23 @@ mod test {
 
         assert_eq!(pool.num_pages(), 100 / 4);
         drop(segments1);
+        pool.flush_caches();
         assert_eq!(pool.num_pages(), 10);
     }
 
+    #[ktest]
+    fn reuse_cached_segment() {
+        let pool: Arc<DmaPool> = DmaPool::new(PAGE_SIZE, 0, 10, DmaDirection::ToDevice, false);
+        let segment = pool.alloc_segment().unwrap();
+        let daddr = segment.daddr();
+        drop(segment);
+
+        // The segment comes back from the per-CPU free list.
+        let segment = pool.alloc_segment().unwrap();
+        assert_eq!(segment.daddr(), daddr);
+        assert_eq!(pool.num_pages(), 1);
+    }
+
     #[ktest]
     fn read_dma_segments() {
         const SEGMENT_SIZE: usize = PAGE_SIZE / 4;
@@ -1,11 +1,11 @@
 // SPDX-License-Identifier: MPL-2.0
 
-use alloc::vec;
+use alloc::{vec, vec::Vec};
 
 use ostd::mm::VmWriter;
 use smoltcp::{phy, time::Instant};
 
-use crate::{buffer::RxBuffer, AnyNetworkDevice};
+use crate::AnyNetworkDevice;
 
 impl phy::Device for dyn AnyNetworkDevice {
     type RxToken<'a> = RxToken;
@@ -13,8 +13,18 @@ impl phy::Device for dyn AnyNetworkDevice {
 
     fn receive(&mut self, _timestamp: Instant) -> Option<(Self::RxToken<'_>, Self::TxToken<'_>)> {
         if self.can_receive() {
-            let rx_buffer = self.receive().unwrap();
-            Some((RxToken(rx_buffer), TxToken(self)))
+            // The device may drop the received packets (e.g., if the checksums are wrong).
+            let rx_buffer = self.receive().ok()?;
+            // Copy the packet out so that the buffer can be put back to the device
+            // without going through the buffer pool.
+            let buffer = {
+                let mut packet = rx_buffer.packet();
+                let mut buffer = vec![0u8; packet.remain()];
+                packet.read(&mut VmWriter::from(&mut buffer as &mut [u8]));
+                buffer
+            };
+            self.recycle_rx_buffer(rx_buffer);
+            Some((RxToken(buffer), TxToken(self)))
         } else {
             None
         }
@@ -32,17 +42,14 @@ impl phy::Device for dyn AnyNetworkDevice {
         self.capabilities()
     }
 }
-pub struct RxToken(RxBuffer);
+pub struct RxToken(Vec<u8>);
 
 impl phy::RxToken for RxToken {
-    fn consume<R, F>(self, f: F) -> R
+    fn consume<R, F>(mut self, f: F) -> R
     where
         F: FnOnce(&mut [u8]) -> R,
     {
-        let mut packet = self.0.packet();
-        let mut buffer = vec![0u8; packet.remain()];
-        packet.read(&mut VmWriter::from(&mut buffer as &mut [u8]));
-        f(&mut buffer)
+        f(&mut self.0)
     }
 }
 
@@ -47,8 +47,24 @@ pub trait AnyNetworkDevice: Send + Sync + Any + Debug {
     /// Receive a packet from network. If packet is ready, returns a RxBuffer containing the packet.
     /// Otherwise, return NotReady error.
     fn receive(&mut self) -> Result<RxBuffer, VirtioNetError>;
-    /// Send a packet to network. Return until the request completes.
+    /// Gives back a RxBuffer returned by `receive` once the packet has been consumed,
+    /// so that the device can receive packets with it again.
+    fn recycle_rx_buffer(&mut self, _rx_buffer: RxBuffer) {}
+    /// Send a packet to network. Return once the packet is queued to the device.
     fn send(&mut self, packet: &[u8]) -> Result<(), VirtioNetError>;
+
+    // ================Interrupt Control==================
+
+    /// Stops raising interrupts when receiving packets.
+    ///
+    /// The receive interrupts are only needed to start polling the device,
+    /// so they are disabled until the device has been polled empty.
+    fn disable_recv_irq(&mut self) {}
+    /// Starts raising interrupts when receiving packets.
+    ///
+    /// The packets that are received before enabling the interrupts may not
+    /// raise an interrupt, so the caller should check `can_receive` afterwards.
+    fn enable_recv_irq(&mut self) {}
 }
 
 pub trait NetDeviceIrqHandler = Fn() + Send + Sync + 'static;
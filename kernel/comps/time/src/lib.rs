@@ -9,8 +9,7 @@ extern crate alloc;
 use alloc::sync::Arc;
 use core::{sync::atomic::Ordering::Relaxed, time::Duration};
 
-use clocksource::ClockSource;
-pub use clocksource::Instant;
+pub use clocksource::{ClockSource, Instant};
 use component::{init_component, ComponentInitError};
 use ostd::sync::Mutex;
 use rtc::{get_cmos, is_updating, CENTURY_REGISTER};
@@ -5,12 +5,13 @@ use core::{fmt::Debug, hint::spin_loop, mem::size_of};
 
 use aster_block::{
     bio::{BioEnqueueError, BioStatus, BioType, SubmittedBio},
-    request_queue::{BioRequest, BioRequestSingleQueue},
+    request_queue::{BioRequest, BioRequestMultiQueue},
 };
-use aster_util::safe_ptr::SafePtr;
+use aster_util::{field_ptr, safe_ptr::SafePtr};
 use id_alloc::IdAlloc;
 use log::info;
 use ostd::{
+    cpu::num_cpus,
     io_mem::IoMem,
     mm::{DmaDirection, DmaStream, DmaStreamSlice, FrameAllocOptions, VmIo},
     sync::SpinLock,
@@ -31,8 +32,8 @@ use crate::{
 #[derive(Debug)]
 pub struct BlockDevice {
     device: Arc<DeviceInner>,
-    /// The software staging queue.
-    queue: BioRequestSingleQueue,
+    /// The software staging queues.
+    queue: BioRequestMultiQueue,
 }
 
 impl BlockDevice {
@@ -42,34 +43,44 @@ impl BlockDevice {
         let device_id = device.request_device_id();
 
         let block_device = Arc::new(Self {
-            device,
             // Each bio request includes an additional 1 request and 1 response descriptor,
             // therefore this upper bound is set to (QUEUE_SIZE - 2).
-            queue: BioRequestSingleQueue::with_max_nr_segments_per_bio(
+            queue: BioRequestMultiQueue::with_max_nr_segments_per_bio(
+                device.hw_queues.len(),
                 (DeviceInner::QUEUE_SIZE - 2) as usize,
             ),
+            device,
         });
 
         aster_block::register_device(device_id, block_device);
         Ok(())
     }
 
-    /// Dequeues a `BioRequest` from the software staging queue and
-    /// processes the request.
-    pub fn handle_requests(&self) {
-        let request = self.queue.dequeue();
+    /// Returns the number of hardware queues, each of which is a virtqueue of the device.
+    pub fn num_hw_queues(&self) -> usize {
+        self.device.hw_queues.len()
+    }
+
+    /// Dequeues a `BioRequest` from the software staging queues of
+    /// the `hw_index`-th hardware queue and processes the request.
+    ///
+    /// # Panics
+    ///
+    /// If the `hw_index` is out of bounds, this method will panic.
+    pub fn handle_requests(&self, hw_index: usize) {
+        let request = self.queue.dequeue(hw_index);
         info!("Handle Request: {:?}", request);
         match request.type_() {
-            BioType::Read => self.device.read(request),
-            BioType::Write => self.device.write(request),
+            BioType::Read => self.device.read(request, hw_index),
+            BioType::Write => self.device.write(request, hw_index),
             BioType::Flush | BioType::Discard => todo!(),
         }
     }
 
     /// Negotiate features for the device specified bits 0~23
     pub(crate) fn negotiate_features(features: u64) -> u64 {
-        let feature = BlockFeatures::from_bits(features).unwrap();
-        let support_features = BlockFeatures::from_bits(features).unwrap();
+        let feature = BlockFeatures::from_bits_truncate(features);
+        let support_features = BlockFeatures::all();
         (feature & support_features).bits
     }
 }
@@ -79,6 +90,10 @@ impl aster_block::BlockDevice for BlockDevice {
         self.queue.enqueue(bio)
     }
 
+    fn enqueue_request(&self, request: BioRequest) {
+        self.queue.enqueue_request(request)
+    }
+
     fn max_nr_segments_per_bio(&self) -> usize {
         self.queue.max_nr_segments_per_bio()
     }
@@ -87,51 +102,79 @@ impl aster_block::BlockDevice for BlockDevice {
 #[derive(Debug)]
 struct DeviceInner {
     config: SafePtr<VirtioBlockConfig, IoMem>,
-    queue: SpinLock<VirtQueue>,
+    hw_queues: Vec<HardwareQueue>,
     transport: SpinLock<Box<dyn VirtioTransport>>,
+}
+
+/// A virtqueue of the device, together with the resources for the requests on it.
+#[derive(Debug)]
+struct HardwareQueue {
+    queue: SpinLock<VirtQueue>,
     block_requests: DmaStream,
     block_responses: DmaStream,
     id_allocator: SpinLock<IdAlloc>,
     submitted_requests: SpinLock<BTreeMap<u16, SubmittedRequest>>,
 }
 
-impl DeviceInner {
-    const QUEUE_SIZE: u16 = 64;
-
-    /// Creates and inits the device.
-    pub fn init(mut transport: Box<dyn VirtioTransport>) -> Result<Arc<Self>, VirtioDeviceError> {
-        let config = VirtioBlockConfig::new(transport.as_mut());
-        let num_queues = transport.num_queues();
-        if num_queues != 1 {
-            return Err(VirtioDeviceError::QueuesAmountDoNotMatch(num_queues, 1));
-        }
-        let queue = VirtQueue::new(0, Self::QUEUE_SIZE, transport.as_mut())
+impl HardwareQueue {
+    fn new(index: u16, transport: &mut dyn VirtioTransport) -> Self {
+        let queue = VirtQueue::new(index, DeviceInner::QUEUE_SIZE, transport)
             .expect("create virtqueue failed");
         let block_requests = {
             let vm_segment = FrameAllocOptions::new(1).alloc_contiguous().unwrap();
             DmaStream::map(vm_segment, DmaDirection::Bidirectional, false).unwrap()
         };
-        assert!(Self::QUEUE_SIZE as usize * REQ_SIZE <= block_requests.nbytes());
+        assert!(DeviceInner::QUEUE_SIZE as usize * REQ_SIZE <= block_requests.nbytes());
         let block_responses = {
             let vm_segment = FrameAllocOptions::new(1).alloc_contiguous().unwrap();
             DmaStream::map(vm_segment, DmaDirection::Bidirectional, false).unwrap()
         };
-        assert!(Self::QUEUE_SIZE as usize * RESP_SIZE <= block_responses.nbytes());
+        assert!(DeviceInner::QUEUE_SIZE as usize * RESP_SIZE <= block_responses.nbytes());
 
-        let device = Arc::new(Self {
-            config,
+        Self {
             queue: SpinLock::new(queue),
-            transport: SpinLock::new(transport),
             block_requests,
             block_responses,
-            id_allocator: SpinLock::new(IdAlloc::with_capacity(Self::QUEUE_SIZE as usize)),
+            id_allocator: SpinLock::new(IdAlloc::with_capacity(DeviceInner::QUEUE_SIZE as usize)),
             submitted_requests: SpinLock::new(BTreeMap::new()),
-        });
+        }
+    }
+}
 
-        let cloned_device = device.clone();
-        let handle_irq = move |_: &TrapFrame| {
-            cloned_device.handle_irq();
+impl DeviceInner {
+    const QUEUE_SIZE: u16 = 64;
+
+    /// Creates and inits the device.
+    pub fn init(mut transport: Box<dyn VirtioTransport>) -> Result<Arc<Self>, VirtioDeviceError> {
+        let config = VirtioBlockConfig::new(transport.as_mut());
+        let features = BlockFeatures::from_bits_truncate(BlockDevice::negotiate_features(
+            transport.device_features(),
+        ));
+        // More virtqueues than CPUs bring no more parallelism.
+        let nr_hw_queues = if features.contains(BlockFeatures::MQ) {
+            field_ptr!(&config, VirtioBlockConfig, num_queues)
+                .read()
+                .unwrap()
+                .clamp(1, num_cpus() as u16)
+        } else {
+            1
         };
+        let num_queues = transport.num_queues();
+        if num_queues < nr_hw_queues {
+            return Err(VirtioDeviceError::QueuesAmountDoNotMatch(
+                num_queues,
+                nr_hw_queues,
+            ));
+        }
+        let hw_queues = (0..nr_hw_queues)
+            .map(|index| HardwareQueue::new(index, transport.as_mut()))
+            .collect();
+
+        let device = Arc::new(Self {
+            config,
+            hw_queues,
+            transport: SpinLock::new(transport),
+        });
 
         let cloned_device = device.clone();
         let handle_config_change = move |_: &TrapFrame| {
@@ -143,37 +186,45 @@ impl DeviceInner {
             transport
                 .register_cfg_callback(Box::new(handle_config_change))
                 .unwrap();
-            transport
-                .register_queue_callback(0, Box::new(handle_irq), false)
-                .unwrap();
+            for index in 0..nr_hw_queues {
+                let cloned_device = device.clone();
+                let handle_irq = move |_: &TrapFrame| {
+                    cloned_device.handle_irq(index as usize);
+                };
+                transport
+                    .register_queue_callback(index, Box::new(handle_irq), false)
+                    .unwrap();
+            }
             transport.finish_init();
         }
 
         Ok(device)
     }
 
-    /// Handles the irq issued from the device
-    fn handle_irq(&self) {
+    /// Handles the irq issued from the `hw_index`-th virtqueue of the device
+    fn handle_irq(&self, hw_index: usize) {
         info!("Virtio block device handle irq");
+        let hw_queue = &self.hw_queues[hw_index];
         // When we enter the IRQs handling function,
         // IRQs have already been disabled,
         // so there is no need to call `lock_irq_disabled`.
         loop {
             // Pops the complete request
             let complete_request = {
-                let mut queue = self.queue.lock();
+                let mut queue = hw_queue.queue.lock();
                 let Ok((token, _)) = queue.pop_used() else {
                     return;
                 };
-                self.submitted_requests.lock().remove(&token).unwrap()
+                hw_queue.submitted_requests.lock().remove(&token).unwrap()
             };
 
             // Handles the response
             let id = complete_request.id as usize;
-            let resp_slice = DmaStreamSlice::new(&self.block_responses, id * RESP_SIZE, RESP_SIZE);
+            let resp_slice =
+                DmaStreamSlice::new(&hw_queue.block_responses, id * RESP_SIZE, RESP_SIZE);
             resp_slice.sync().unwrap();
             let resp: BlockResp = resp_slice.read_val(0).unwrap();
-            self.id_allocator.lock().free(id);
+            hw_queue.id_allocator.lock().free(id);
             match RespStatus::try_from(resp.status).unwrap() {
                 RespStatus::Ok => {}
                 // FIXME: Return an error instead of triggering a kernel panic
@@ -204,9 +255,10 @@ impl DeviceInner {
     // TODO: Most logic is the same as read and write, there should be a refactor.
     // TODO: Should return an Err instead of panic if the device fails.
     fn request_device_id(&self) -> String {
-        let id = self.id_allocator.lock_irq_disabled().alloc().unwrap();
+        let hw_queue = &self.hw_queues[0];
+        let id = hw_queue.id_allocator.lock_irq_disabled().alloc().unwrap();
         let req_slice = {
-            let req_slice = DmaStreamSlice::new(&self.block_requests, id * REQ_SIZE, REQ_SIZE);
+            let req_slice = DmaStreamSlice::new(&hw_queue.block_requests, id * REQ_SIZE, REQ_SIZE);
             let req = BlockReq {
                 type_: ReqType::GetId as _,
                 reserved: 0,
@@ -218,7 +270,8 @@ impl DeviceInner {
         };
 
         let resp_slice = {
-            let resp_slice = DmaStreamSlice::new(&self.block_responses, id * RESP_SIZE, RESP_SIZE);
+            let resp_slice =
+                DmaStreamSlice::new(&hw_queue.block_responses, id * RESP_SIZE, RESP_SIZE);
             resp_slice.write_val(0, &BlockResp::default()).unwrap();
             resp_slice
         };
@@ -233,7 +286,7 @@ impl DeviceInner {
         let device_id_slice = DmaStreamSlice::new(&device_id_stream, 0, MAX_ID_LENGTH);
         let outputs = vec![&device_id_slice, &resp_slice];
 
-        let mut queue = self.queue.lock_irq_disabled();
+        let mut queue = hw_queue.queue.lock_irq_disabled();
         let token = queue
             .add_dma_buf(&[&req_slice], outputs.as_slice())
             .expect("add queue failed");
@@ -246,7 +299,7 @@ impl DeviceInner {
         queue.pop_used_with_token(token).expect("pop used failed");
 
         resp_slice.sync().unwrap();
-        self.id_allocator.lock_irq_disabled().free(id);
+        hw_queue.id_allocator.lock_irq_disabled().free(id);
         let resp: BlockResp = resp_slice.read_val(0).unwrap();
         match RespStatus::try_from(resp.status).unwrap() {
             RespStatus::Ok => {}
@@ -268,12 +321,13 @@ impl DeviceInner {
     }
 
     /// Reads data from the device, this function is non-blocking.
-    fn read(&self, bio_request: BioRequest) {
+    fn read(&self, bio_request: BioRequest, hw_index: usize) {
+        let hw_queue = &self.hw_queues[hw_index];
         let dma_streams = Self::dma_stream_map(&bio_request);
 
-        let id = self.id_allocator.lock_irq_disabled().alloc().unwrap();
+        let id = hw_queue.id_allocator.lock_irq_disabled().alloc().unwrap();
         let req_slice = {
-            let req_slice = DmaStreamSlice::new(&self.block_requests, id * REQ_SIZE, REQ_SIZE);
+            let req_slice = DmaStreamSlice::new(&hw_queue.block_requests, id * REQ_SIZE, REQ_SIZE);
             let req = BlockReq {
                 type_: ReqType::In as _,
                 reserved: 0,
@@ -285,7 +339,8 @@ impl DeviceInner {
         };
 
         let resp_slice = {
-            let resp_slice = DmaStreamSlice::new(&self.block_responses, id * RESP_SIZE, RESP_SIZE);
+            let resp_slice =
+                DmaStreamSlice::new(&hw_queue.block_responses, id * RESP_SIZE, RESP_SIZE);
             resp_slice.write_val(0, &BlockResp::default()).unwrap();
             resp_slice
         };
@@ -308,7 +363,7 @@ impl DeviceInner {
         }
 
         loop {
-            let mut queue = self.queue.lock_irq_disabled();
+            let mut queue = hw_queue.queue.lock_irq_disabled();
             if num_used_descs > queue.available_desc() {
                 continue;
             }
@@ -321,7 +376,8 @@ impl DeviceInner {
 
             // Records the submitted request
             let submitted_request = SubmittedRequest::new(id as u16, bio_request, dma_streams);
-            self.submitted_requests
+            hw_queue
+                .submitted_requests
                 .lock_irq_disabled()
                 .insert(token, submitted_request);
             return;
@@ -329,12 +385,13 @@ impl DeviceInner {
     }
 
     /// Writes data to the device, this function is non-blocking.
-    fn write(&self, bio_request: BioRequest) {
+    fn write(&self, bio_request: BioRequest, hw_index: usize) {
+        let hw_queue = &self.hw_queues[hw_index];
         let dma_streams = Self::dma_stream_map(&bio_request);
 
-        let id = self.id_allocator.lock_irq_disabled().alloc().unwrap();
+        let id = hw_queue.id_allocator.lock_irq_disabled().alloc().unwrap();
         let req_slice = {
-            let req_slice = DmaStreamSlice::new(&self.block_requests, id * REQ_SIZE, REQ_SIZE);
+            let req_slice = DmaStreamSlice::new(&hw_queue.block_requests, id * REQ_SIZE, REQ_SIZE);
             let req = BlockReq {
                 type_: ReqType::Out as _,
                 reserved: 0,
@@ -346,7 +403,8 @@ impl DeviceInner {
         };
 
         let resp_slice = {
-            let resp_slice = DmaStreamSlice::new(&self.block_responses, id * RESP_SIZE, RESP_SIZE);
+            let resp_slice =
+                DmaStreamSlice::new(&hw_queue.block_responses, id * RESP_SIZE, RESP_SIZE);
             resp_slice.write_val(0, &BlockResp::default()).unwrap();
             resp_slice
         };
@@ -368,7 +426,7 @@ impl DeviceInner {
             panic!("The request size surpasses the queue size");
         }
         loop {
-            let mut queue = self.queue.lock_irq_disabled();
+            let mut queue = hw_queue.queue.lock_irq_disabled();
             if num_used_descs > queue.available_desc() {
                 continue;
             }
@@ -381,7 +439,8 @@ impl DeviceInner {
 
             // Records the submitted request
             let submitted_request = SubmittedRequest::new(id as u16, bio_request, dma_streams);
-            self.submitted_requests
+            hw_queue
+                .submitted_requests
                 .lock_irq_disabled()
                 .insert(token, submitted_request);
             return;
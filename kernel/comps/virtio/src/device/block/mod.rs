@@ -25,6 +25,7 @@ bitflags! {
         const FLUSH         = 1 << 9;
         const TOPOLOGY      = 1 << 10;
         const CONFIG_WCE    = 1 << 11;
+        const MQ            = 1 << 12;
         const DISCARD       = 1 << 13;
         const WRITE_ZEROES  = 1 << 14;
     }
@@ -63,7 +64,8 @@ pub struct VirtioBlockConfig {
     blk_size: u32,
     topology: VirtioBlockTopology,
     writeback: u8,
-    unused0: [u8; 3],
+    unused0: u8,
+    num_queues: u16,
     max_discard_sectors: u32,
     max_discard_seg: u32,
     discard_sector_alignment: u32,
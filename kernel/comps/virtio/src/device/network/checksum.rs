@@ -0,0 +1,216 @@
+// SPDX-License-Identifier: MPL-2.0
+
+//! Utilities to offload the TCP and UDP checksums to the device.
+//!
+//! The Ethernet frames that carry unfragmented IPv4 packets or IPv6 packets without
+//! extension headers are handled. The TCP and UDP segments in the other frames
+//! cannot be located, so their checksums can be neither offloaded nor verified.
+
+const ETHERNET_HEADER_LEN: usize = 14;
+const ETHERTYPE_IPV4: u16 = 0x0800;
+const ETHERTYPE_IPV6: u16 = 0x86dd;
+const IPV4_MIN_HEADER_LEN: usize = 20;
+const IPV6_HEADER_LEN: usize = 40;
+const IP_PROTOCOL_TCP: u8 = 6;
+const IP_PROTOCOL_UDP: u8 = 17;
+const IP_PROTOCOL_ICMPV6: u8 = 58;
+const IP_PROTOCOL_IPV6_NO_NEXT: u8 = 59;
+const TCP_CHECKSUM_OFFSET: usize = 16;
+const UDP_CHECKSUM_OFFSET: usize = 6;
+
+/// The payload of an Ethernet frame, as far as the TCP and UDP checksums are concerned.
+pub(super) enum Payload {
+    /// A TCP or UDP segment.
+    Segment(L4Segment),
+    /// A packet that carries no TCP or UDP segment, e.g., an ARP packet.
+    NoSegment,
+    /// A packet that may carry a TCP or UDP segment that cannot be located, e.g.,
+    /// an IP fragment or an IPv6 packet with extension headers.
+    Unknown,
+}
+
+impl Payload {
+    /// Parses the payload of an Ethernet frame.
+    pub(super) fn parse(frame: &[u8]) -> Self {
+        if frame.len() < ETHERNET_HEADER_LEN {
+            return Self::Unknown;
+        }
+        match read_u16(frame, 12) {
+            ETHERTYPE_IPV4 => Self::parse_ipv4(&frame[ETHERNET_HEADER_LEN..]),
+            ETHERTYPE_IPV6 => Self::parse_ipv6(&frame[ETHERNET_HEADER_LEN..]),
+            _ => Self::NoSegment,
+        }
+    }
+
+    fn parse_ipv4(ip_packet: &[u8]) -> Self {
+        if ip_packet.len() < IPV4_MIN_HEADER_LEN {
+            return Self::Unknown;
+        }
+        let version = ip_packet[0] >> 4;
+        let header_len = (ip_packet[0] & 0xf) as usize * 4;
+        let total_len = read_u16(ip_packet, 2) as usize;
+        if version != 4
+            || header_len < IPV4_MIN_HEADER_LEN
+            || total_len < header_len
+            || total_len > ip_packet.len()
+        {
+            return Self::Unknown;
+        }
+
+        let protocol = ip_packet[9];
+        if protocol != IP_PROTOCOL_TCP && protocol != IP_PROTOCOL_UDP {
+            return Self::NoSegment;
+        }
+        // The "more fragments" flag and the fragment offset.
+        let is_fragment = read_u16(ip_packet, 6) & 0x3fff != 0;
+        if is_fragment {
+            return Self::Unknown;
+        }
+
+        let len = total_len - header_len;
+        let mut sum = 0u32;
+        sum = add_bytes(sum, &ip_packet[12..20]);
+        L4Segment::new(ETHERNET_HEADER_LEN + header_len, len, protocol, sum, true)
+    }
+
+    fn parse_ipv6(ip_packet: &[u8]) -> Self {
+        if ip_packet.len() < IPV6_HEADER_LEN || ip_packet[0] >> 4 != 6 {
+            return Self::Unknown;
+        }
+        let len = read_u16(ip_packet, 4) as usize;
+        if IPV6_HEADER_LEN + len > ip_packet.len() {
+            return Self::Unknown;
+        }
+
+        let next_header = ip_packet[6];
+        match next_header {
+            IP_PROTOCOL_TCP | IP_PROTOCOL_UDP => (),
+            IP_PROTOCOL_ICMPV6 | IP_PROTOCOL_IPV6_NO_NEXT => return Self::NoSegment,
+            // Extension headers, or protocols that the network stack does not know.
+            _ => return Self::Unknown,
+        }
+
+        let mut sum = 0u32;
+        sum = add_bytes(sum, &ip_packet[8..40]);
+        L4Segment::new(
+            ETHERNET_HEADER_LEN + IPV6_HEADER_LEN,
+            len,
+            next_header,
+            sum,
+            false,
+        )
+    }
+}
+
+/// The TCP or UDP segment in an Ethernet frame.
+pub(super) struct L4Segment {
+    /// The offset of the segment in the frame.
+    pub(super) start: usize,
+    /// The length of the segment.
+    len: usize,
+    /// The offset of the checksum field in the segment.
+    pub(super) checksum_offset: usize,
+    is_udp: bool,
+    /// Whether a zero checksum means that there is no checksum, which holds for UDP
+    /// over IPv4 only.
+    is_checksum_optional: bool,
+    /// The folded sum of the pseudo header, which is not complemented.
+    pseudo_header_sum: u16,
+}
+
+impl L4Segment {
+    /// Creates the payload that holds a segment with the given protocol, where `address_sum`
+    /// is the sum of the source and destination addresses in the IP header.
+    fn new(start: usize, len: usize, protocol: u8, address_sum: u32, is_ipv4: bool) -> Payload {
+        let checksum_offset = if protocol == IP_PROTOCOL_UDP {
+            UDP_CHECKSUM_OFFSET
+        } else {
+            TCP_CHECKSUM_OFFSET
+        };
+        if len < checksum_offset + 2 {
+            return Payload::Unknown;
+        }
+
+        // The pseudo headers of IPv4 and IPv6 have the same sum, although the IPv6 one
+        // stores the length and the protocol in wider fields.
+        let sum = address_sum + protocol as u32 + len as u32;
+        Payload::Segment(Self {
+            start,
+            len,
+            checksum_offset,
+            is_udp: protocol == IP_PROTOCOL_UDP,
+            is_checksum_optional: is_ipv4 && protocol == IP_PROTOCOL_UDP,
+            pseudo_header_sum: fold(sum),
+        })
+    }
+
+    /// Returns whether the segment reaches the end of the frame.
+    ///
+    /// The device checksums everything from the start of the segment to the end
+    /// of the frame, so the checksum can only be offloaded if there is no padding.
+    pub(super) fn ends_frame(&self, frame: &[u8]) -> bool {
+        self.start + self.len == frame.len()
+    }
+
+    /// Returns the value that should be stored in the checksum field
+    /// if the device completes the checksum.
+    pub(super) fn partial_checksum(&self) -> [u8; 2] {
+        self.pseudo_header_sum.to_be_bytes()
+    }
+
+    /// Computes the complete checksum of the segment.
+    ///
+    /// The checksum field in the frame is ignored.
+    pub(super) fn checksum(&self, frame: &[u8]) -> [u8; 2] {
+        let segment = &frame[self.start..self.start + self.len];
+        let field = self.checksum_offset;
+        let mut sum = self.pseudo_header_sum as u32;
+        sum = add_bytes(sum, &segment[..field]);
+        sum = add_bytes(sum, &segment[field + 2..]);
+        let checksum = !fold(sum);
+        // A zero UDP checksum means that there is no checksum.
+        if self.is_udp && checksum == 0 {
+            return [0xff, 0xff];
+        }
+        checksum.to_be_bytes()
+    }
+
+    /// Returns whether the checksum of the segment is correct.
+    pub(super) fn verify(&self, frame: &[u8]) -> bool {
+        let field = self.start + self.checksum_offset;
+        let stored = [frame[field], frame[field + 1]];
+        if self.is_checksum_optional && stored == [0, 0] {
+            return true;
+        }
+        stored == self.checksum(frame)
+    }
+}
+
+fn read_u16(bytes: &[u8], offset: usize) -> u16 {
+    u16::from_be_bytes([bytes[offset], bytes[offset + 1]])
+}
+
+/// Adds the bytes to the ones' complement sum as big-endian 16-bit words.
+///
+/// An odd byte at the end is padded with zero.
+fn add_bytes(mut sum: u32, bytes: &[u8]) -> u32 {
+    let mut chunks = bytes.chunks_exact(2);
+    for chunk in &mut chunks {
+        sum += u16::from_be_bytes([chunk[0], chunk[1]]) as u32;
+        // Fold early so that long segments cannot overflow the sum.
+        if sum >= 0x8000_0000 {
+            sum = fold(sum) as u32;
+        }
+    }
+    if let [last] = chunks.remainder() {
+        sum += (*last as u32) << 8;
+    }
+    sum
+}
+
+fn fold(mut sum: u32) -> u16 {
+    while sum > 0xffff {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    sum as u16
+}
@@ -45,7 +45,12 @@ bitflags! {
 
 impl NetworkFeatures {
     pub fn support_features() -> Self {
-        NetworkFeatures::VIRTIO_NET_F_MAC | NetworkFeatures::VIRTIO_NET_F_STATUS
+        NetworkFeatures::VIRTIO_NET_F_CSUM
+            | NetworkFeatures::VIRTIO_NET_F_GUEST_CSUM
+            | NetworkFeatures::VIRTIO_NET_F_MAC
+            | NetworkFeatures::VIRTIO_NET_F_STATUS
+            | NetworkFeatures::VIRTIO_NET_F_CTRL_VQ
+            | NetworkFeatures::VIRTIO_NET_F_MQ
     }
 }
 
@@ -63,7 +68,7 @@ bitflags! {
 pub struct VirtioNetConfig {
     pub mac: EthernetAddr,
     pub status: Status,
-    max_virtqueue_pairs: u16,
+    pub max_virtqueue_pairs: u16,
     mtu: u16,
     speed: u32,
     duplex: u8,
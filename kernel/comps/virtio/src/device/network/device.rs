@@ -1,6 +1,6 @@
 // SPDX-License-Identifier: MPL-2.0
 
-use alloc::{boxed::Box, string::ToString, sync::Arc};
+use alloc::{boxed::Box, string::ToString, sync::Arc, vec::Vec};
 use core::{fmt::Debug, hint::spin_loop, mem::size_of};
 
 use aster_network::{
@@ -9,10 +9,21 @@ use aster_network::{
 };
 use aster_util::{field_ptr, slot_vec::SlotVec};
 use log::debug;
-use ostd::{offset_of, sync::SpinLock, trap::TrapFrame};
-use smoltcp::phy::{DeviceCapabilities, Medium};
+use ostd::{
+    cpu::{num_cpus, this_cpu},
+    mm::{DmaDirection, DmaStream, DmaStreamSlice, FrameAllocOptions, VmIo, VmWriter},
+    offset_of,
+    sync::SpinLock,
+    trap::TrapFrame,
+};
+use pod::Pod;
+use smoltcp::phy::{Checksum, DeviceCapabilities, Medium};
 
-use super::{config::VirtioNetConfig, header::VirtioNetHdr};
+use super::{
+    checksum::Payload,
+    config::VirtioNetConfig,
+    header::{Flags, VirtioNetHdr},
+};
 use crate::{
     device::{network::config::NetworkFeatures, VirtioDeviceError},
     queue::{QueueError, VirtQueue},
@@ -22,16 +33,83 @@ use crate::{
 pub struct NetworkDevice {
     config: VirtioNetConfig,
     mac_addr: EthernetAddr,
-    send_queue: VirtQueue,
+    features: NetworkFeatures,
+    /// The pairs of receive and send queues.
+    ///
+    /// With `VIRTIO_NET_F_MQ`, there is a pair for each CPU (as long as the device
+    /// supports that many pairs). The packets are sent through the pair of the
+    /// current CPU, and received from all the pairs in turn.
+    queue_pairs: Vec<QueuePair>,
+    /// The index of the pair to receive packets from next.
+    next_recv_pair: usize,
+    /// The received buffers that are given back, which replace the buffers popped out
+    /// of the receive queues instead of newly allocated ones.
+    spare_rx_buffers: Vec<RxBuffer>,
+    /// The buffer that the received packets are copied to when their checksums are
+    /// verified, which is reused to avoid an allocation for each packet.
+    rx_checksum_buf: Vec<u8>,
+    /// The control queue, which exists if `VIRTIO_NET_F_CTRL_VQ` is negotiated.
+    ctrl_queue: Option<VirtQueue>,
+    transport: Box<dyn VirtioTransport>,
+}
+
+struct QueuePair {
     recv_queue: VirtQueue,
+    send_queue: VirtQueue,
     rx_buffers: SlotVec<RxBuffer>,
-    transport: Box<dyn VirtioTransport>,
+    /// The buffers that are being sent by the device.
+    tx_buffers: SlotVec<TxBuffer>,
+}
+
+impl QueuePair {
+    fn new(index: u16, transport: &mut dyn VirtioTransport) -> Result<Self, VirtioDeviceError> {
+        let recv_index = 2 * index;
+        let send_index = 2 * index + 1;
+        let mut recv_queue =
+            VirtQueue::new(recv_index, queue_size(recv_index, transport), transport)
+                .expect("creating recv queue fails");
+        let send_queue = VirtQueue::new(send_index, queue_size(send_index, transport), transport)
+            .expect("create send queue fails");
+
+        let mut rx_buffers = SlotVec::new();
+        for i in 0..recv_queue.size() {
+            let rx_pool = RX_BUFFER_POOL.get().unwrap();
+            let rx_buffer = RxBuffer::new(size_of::<VirtioNetHdr>(), rx_pool);
+            // FIEME: Replace rx_buffer with VM segment-based data structure to use dma mapping.
+            let token = recv_queue.add_dma_buf(&[], &[&rx_buffer])?;
+            assert_eq!(i, token);
+            assert_eq!(rx_buffers.put(rx_buffer) as u16, i);
+        }
+
+        if recv_queue.should_notify() {
+            debug!("notify receive queue {}", recv_index);
+            recv_queue.notify();
+        }
+
+        Ok(Self {
+            recv_queue,
+            send_queue,
+            rx_buffers,
+            tx_buffers: SlotVec::new(),
+        })
+    }
+
+    /// Pops out the buffers that have been sent, so their descriptors can be reused.
+    fn recycle_tx_buffers(&mut self) {
+        while let Ok((token, _)) = self.send_queue.pop_used() {
+            self.tx_buffers.remove(token as usize);
+        }
+    }
 }
 
 impl NetworkDevice {
     pub(crate) fn negotiate_features(device_features: u64) -> u64 {
         let device_features = NetworkFeatures::from_bits_truncate(device_features);
-        let supported_features = NetworkFeatures::support_features();
+        let mut supported_features = NetworkFeatures::support_features();
+        // The number of queue pairs is set through the control virtqueue.
+        if !device_features.contains(NetworkFeatures::VIRTIO_NET_F_CTRL_VQ) {
+            supported_features.remove(NetworkFeatures::VIRTIO_NET_F_MQ);
+        }
         let network_features = device_features & supported_features;
         debug!("{:?}", network_features);
         network_features.bits()
@@ -51,31 +129,48 @@ impl NetworkDevice {
             .read()
             .unwrap();
         debug!("mac addr = {:x?}, status = {:?}", mac_addr, status);
-        let mut recv_queue = VirtQueue::new(QUEUE_RECV, QUEUE_SIZE, transport.as_mut())
-            .expect("creating recv queue fails");
-        let send_queue = VirtQueue::new(QUEUE_SEND, QUEUE_SIZE, transport.as_mut())
-            .expect("create send queue fails");
 
-        let mut rx_buffers = SlotVec::new();
-        for i in 0..QUEUE_SIZE {
-            let rx_pool = RX_BUFFER_POOL.get().unwrap();
-            let rx_buffer = RxBuffer::new(size_of::<VirtioNetHdr>(), rx_pool);
-            // FIEME: Replace rx_buffer with VM segment-based data structure to use dma mapping.
-            let token = recv_queue.add_dma_buf(&[], &[&rx_buffer])?;
-            assert_eq!(i, token);
-            assert_eq!(rx_buffers.put(rx_buffer) as u16, i);
+        // More queue pairs than CPUs bring no more parallelism.
+        let max_queue_pairs = if features.contains(NetworkFeatures::VIRTIO_NET_F_MQ) {
+            field_ptr!(&virtio_net_config, VirtioNetConfig, max_virtqueue_pairs)
+                .read()
+                .unwrap()
+                .max(1)
+        } else {
+            1
+        };
+        let nr_queue_pairs = max_queue_pairs.min(num_cpus() as u16);
+        let num_queues = transport.num_queues();
+        if num_queues < 2 * nr_queue_pairs {
+            return Err(VirtioDeviceError::QueuesAmountDoNotMatch(
+                num_queues,
+                2 * nr_queue_pairs,
+            ));
         }
 
-        if recv_queue.should_notify() {
-            debug!("notify receive queue");
-            recv_queue.notify();
-        }
+        let queue_pairs = (0..nr_queue_pairs)
+            .map(|index| QueuePair::new(index, transport.as_mut()))
+            .collect::<Result<Vec<_>, _>>()?;
+        // The control virtqueue follows all the queue pairs that the device supports.
+        let ctrl_queue = if features.contains(NetworkFeatures::VIRTIO_NET_F_CTRL_VQ) {
+            let ctrl_index = 2 * max_queue_pairs;
+            Some(
+                VirtQueue::new(ctrl_index, CTRL_QUEUE_SIZE, transport.as_mut())
+                    .expect("creating control queue fails"),
+            )
+        } else {
+            None
+        };
+
         let mut device = Self {
             config: virtio_net_config.read().unwrap(),
             mac_addr,
-            send_queue,
-            recv_queue,
-            rx_buffers,
+            features,
+            queue_pairs,
+            next_recv_pair: 0,
+            spare_rx_buffers: Vec::new(),
+            rx_checksum_buf: Vec::new(),
+            ctrl_queue,
             transport,
         };
 
@@ -93,12 +188,23 @@ impl NetworkDevice {
             .transport
             .register_cfg_callback(Box::new(config_space_change))
             .unwrap();
-        device
-            .transport
-            .register_queue_callback(QUEUE_RECV, Box::new(handle_network_event), false)
-            .unwrap();
+        for index in 0..nr_queue_pairs {
+            device
+                .transport
+                .register_queue_callback(2 * index, Box::new(handle_network_event), false)
+                .unwrap();
+        }
         device.transport.finish_init();
 
+        // The device uses one queue pair until told otherwise.
+        if nr_queue_pairs > 1 {
+            let ctrl_queue = device.ctrl_queue.as_mut().unwrap();
+            if let Err(err) = set_queue_pairs(ctrl_queue, nr_queue_pairs) {
+                log::warn!("failed to enable {} queue pairs: {:?}", nr_queue_pairs, err);
+                device.queue_pairs.truncate(1);
+            }
+        }
+
         aster_network::register_device(
             super::DEVICE_NAME.to_string(),
             Arc::new(SpinLock::new(device)),
@@ -107,65 +213,174 @@ impl NetworkDevice {
     }
 
     /// Add a rx buffer to recv queue
-    /// FIEME: Replace rx_buffer with VM segment-based data structure to use dma mapping.
-    fn add_rx_buffer(&mut self, rx_buffer: RxBuffer) -> Result<(), VirtioNetError> {
-        let token = self
+    fn add_rx_buffer(
+        queue_pair: &mut QueuePair,
+        rx_buffer: RxBuffer,
+    ) -> Result<(), VirtioNetError> {
+        let token = queue_pair
             .recv_queue
             .add_dma_buf(&[], &[&rx_buffer])
             .map_err(queue_to_network_error)?;
-        assert!(self.rx_buffers.put_at(token as usize, rx_buffer).is_none());
-        if self.recv_queue.should_notify() {
-            self.recv_queue.notify();
+        assert!(queue_pair
+            .rx_buffers
+            .put_at(token as usize, rx_buffer)
+            .is_none());
+        if queue_pair.recv_queue.should_notify() {
+            queue_pair.recv_queue.notify();
         }
         Ok(())
     }
 
     /// Receive a packet from network. If packet is ready, returns a RxBuffer containing the packet.
     /// Otherwise, return NotReady error.
+    ///
+    /// The packets with wrong checksums are dropped if the checksums are not verified
+    /// by the network stack.
     fn receive(&mut self) -> Result<RxBuffer, VirtioNetError> {
-        let (token, len) = self.recv_queue.pop_used().map_err(queue_to_network_error)?;
+        loop {
+            let rx_buffer = self.receive_from_queues()?;
+            if !self
+                .features
+                .contains(NetworkFeatures::VIRTIO_NET_F_GUEST_CSUM)
+                || has_valid_checksum(&rx_buffer, &mut self.rx_checksum_buf)
+            {
+                return Ok(rx_buffer);
+            }
+            debug!("drop a packet with wrong checksum");
+            self.recycle_rx_buffer(rx_buffer);
+        }
+    }
+
+    /// Receives a packet from the receive queues.
+    ///
+    /// The receive queues are visited in turn, so a busy queue cannot starve the others.
+    fn receive_from_queues(&mut self) -> Result<RxBuffer, VirtioNetError> {
+        let nr_queue_pairs = self.queue_pairs.len();
+        let pair_index = (0..nr_queue_pairs)
+            .map(|i| (self.next_recv_pair + i) % nr_queue_pairs)
+            .find(|index| self.queue_pairs[*index].recv_queue.can_pop())
+            .ok_or(VirtioNetError::NotReady)?;
+        self.next_recv_pair = (pair_index + 1) % nr_queue_pairs;
+
+        let queue_pair = &mut self.queue_pairs[pair_index];
+        let (token, len) = queue_pair
+            .recv_queue
+            .pop_used()
+            .map_err(queue_to_network_error)?;
         debug!("receive packet: token = {}, len = {}", token, len);
-        let mut rx_buffer = self
+        let mut rx_buffer = queue_pair
             .rx_buffers
             .remove(token as usize)
             .ok_or(VirtioNetError::WrongToken)?;
         rx_buffer.set_packet_len(len as usize);
-        // FIXME: Ideally, we can reuse the returned buffer without creating new buffer.
-        // But this requires locking device to be compatible with smoltcp interface.
-        let rx_pool = RX_BUFFER_POOL.get().unwrap();
-        let new_rx_buffer = RxBuffer::new(size_of::<VirtioNetHdr>(), rx_pool);
-        self.add_rx_buffer(new_rx_buffer)?;
+        let new_rx_buffer = self.spare_rx_buffers.pop().unwrap_or_else(|| {
+            let rx_pool = RX_BUFFER_POOL.get().unwrap();
+            RxBuffer::new(size_of::<VirtioNetHdr>(), rx_pool)
+        });
+        Self::add_rx_buffer(queue_pair, new_rx_buffer)?;
         Ok(rx_buffer)
     }
 
-    /// Send a packet to network. Return until the request completes.
+    /// Keeps a received buffer to refill the receive queues later.
+    ///
+    /// Only one buffer per queue pair is kept, since a buffer is taken
+    /// for each received packet and is usually given back right away.
+    fn recycle_rx_buffer(&mut self, rx_buffer: RxBuffer) {
+        if self.spare_rx_buffers.len() < self.queue_pairs.len() {
+            self.spare_rx_buffers.push(rx_buffer);
+        }
+    }
+
+    /// Send a packet to network.
+    ///
+    /// The packet is sent through the queue pair of the current CPU. This method returns
+    /// once the packet is queued, and the buffer is recycled after the device sends it.
     /// FIEME: Replace tx_buffer with VM segment-based data structure to use dma mapping.
     fn send(&mut self, packet: &[u8]) -> Result<(), VirtioNetError> {
-        let header = VirtioNetHdr::default();
-        let tx_pool = TX_BUFFER_POOL.get().unwrap();
-        let tx_buffer = TxBuffer::new(&header, packet, tx_pool);
+        let tx_buffer = self.new_tx_buffer(packet);
 
-        let token = self
+        let queue_pair = self.tx_queue_pair();
+        queue_pair.recycle_tx_buffers();
+        // The queue is full only if the device falls far behind, so wait for it here.
+        while queue_pair.send_queue.available_desc() == 0 {
+            spin_loop();
+            queue_pair.recycle_tx_buffers();
+        }
+        let token = queue_pair
             .send_queue
             .add_dma_buf(&[&tx_buffer], &[])
             .map_err(queue_to_network_error)?;
+        assert!(queue_pair
+            .tx_buffers
+            .put_at(token as usize, tx_buffer)
+            .is_none());
 
-        if self.send_queue.should_notify() {
-            self.send_queue.notify();
-        }
-        // Wait until the buffer is used
-        while !self.send_queue.can_pop() {
-            spin_loop();
-        }
-        // Pop out the buffer, so we can reuse the send queue further
-        let (pop_token, _) = self.send_queue.pop_used().map_err(queue_to_network_error)?;
-        debug_assert!(pop_token == token);
-        if pop_token != token {
-            return Err(VirtioNetError::WrongToken);
+        if queue_pair.send_queue.should_notify() {
+            queue_pair.send_queue.notify();
         }
         debug!("send packet succeeds");
         Ok(())
     }
+
+    /// Copies the packet to a new `TxBuffer`.
+    ///
+    /// If the checksums are not computed by the network stack, the device is asked to
+    /// compute them, or they are computed here if the device cannot.
+    fn new_tx_buffer(&self, packet: &[u8]) -> TxBuffer {
+        let tx_pool = TX_BUFFER_POOL.get().unwrap();
+        let payload = self
+            .features
+            .contains(NetworkFeatures::VIRTIO_NET_F_CSUM)
+            .then(|| Payload::parse(packet));
+        let Some(Payload::Segment(segment)) = payload else {
+            return TxBuffer::new(&VirtioNetHdr::default(), packet, tx_pool);
+        };
+
+        let field = segment.start + segment.checksum_offset;
+        let (header, checksum) = if segment.ends_frame(packet) {
+            let header = VirtioNetHdr::with_partial_checksum(
+                segment.start as u16,
+                segment.checksum_offset as u16,
+            );
+            (header, segment.partial_checksum())
+        } else {
+            (VirtioNetHdr::default(), segment.checksum(packet))
+        };
+        let mut tx_buffer = TxBuffer::new(&header, packet, tx_pool);
+        tx_buffer.write_bytes_at(size_of::<VirtioNetHdr>() + field, &checksum);
+        tx_buffer
+    }
+
+    fn tx_queue_pair(&mut self) -> &mut QueuePair {
+        let nr_queue_pairs = self.queue_pairs.len();
+        &mut self.queue_pairs[this_cpu() as usize % nr_queue_pairs]
+    }
+}
+
+/// Checks the checksum of a received packet, unless the device has checked it
+/// or the packet comes from the same host with a partial checksum.
+///
+/// The network stack is told that the checksums are verified by the device, so the
+/// packets whose TCP or UDP segments cannot be located are considered invalid.
+fn has_valid_checksum(rx_buffer: &RxBuffer, packet: &mut Vec<u8>) -> bool {
+    let header: VirtioNetHdr = rx_buffer.buf().read_val().unwrap();
+    if header
+        .flags()
+        .intersects(Flags::VIRTIO_NET_HDR_F_DATA_VALID | Flags::VIRTIO_NET_HDR_F_NEEDS_CSUM)
+    {
+        return true;
+    }
+
+    // The buffer only grows to the size of the largest packet, so it is allocated rarely.
+    packet.resize(rx_buffer.packet_len(), 0);
+    rx_buffer
+        .packet()
+        .read(&mut VmWriter::from(packet.as_mut_slice()));
+    match Payload::parse(packet) {
+        Payload::Segment(segment) => segment.verify(packet),
+        Payload::NoSegment => true,
+        Payload::Unknown => false,
+    }
 }
 
 fn queue_to_network_error(err: QueueError) -> VirtioNetError {
@@ -176,6 +391,62 @@ fn queue_to_network_error(err: QueueError) -> VirtioNetError {
     }
 }
 
+/// Returns the size of the queue, which is as large as the device and the queue allow.
+fn queue_size(index: u16, transport: &dyn VirtioTransport) -> u16 {
+    let max_size = if transport.is_legacy_version() {
+        LEGACY_QUEUE_SIZE
+    } else {
+        QUEUE_SIZE
+    };
+    let device_max_size = transport.max_queue_size(index).unwrap_or(max_size);
+    // The queue size must be a power of two.
+    let size = max_size.min(device_max_size).max(1);
+    1 << (u16::BITS - 1 - size.leading_zeros())
+}
+
+/// Tells the device to use `nr_queue_pairs` queue pairs through the control virtqueue.
+fn set_queue_pairs(ctrl_queue: &mut VirtQueue, nr_queue_pairs: u16) -> Result<(), QueueError> {
+    const HEADER_OFFSET: usize = 0;
+    const DATA_OFFSET: usize = size_of::<CtrlHeader>();
+    const ACK_OFFSET: usize = DATA_OFFSET + size_of::<u16>();
+
+    let stream = {
+        let segment = FrameAllocOptions::new(1)
+            .uninit(true)
+            .alloc_contiguous()
+            .unwrap();
+        DmaStream::map(segment, DmaDirection::Bidirectional, false).unwrap()
+    };
+    let header_slice = DmaStreamSlice::new(&stream, HEADER_OFFSET, size_of::<CtrlHeader>());
+    let data_slice = DmaStreamSlice::new(&stream, DATA_OFFSET, size_of::<u16>());
+    let ack_slice = DmaStreamSlice::new(&stream, ACK_OFFSET, size_of::<u8>());
+
+    let header = CtrlHeader {
+        class: VIRTIO_NET_CTRL_MQ,
+        command: VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET,
+    };
+    header_slice.write_val(0, &header).unwrap();
+    data_slice.write_val(0, &nr_queue_pairs).unwrap();
+    ack_slice.write_val(0, &VIRTIO_NET_ERR).unwrap();
+    stream.sync(0..ACK_OFFSET + size_of::<u8>()).unwrap();
+
+    let token = ctrl_queue.add_dma_buf(&[&header_slice, &data_slice], &[&ack_slice])?;
+    if ctrl_queue.should_notify() {
+        ctrl_queue.notify();
+    }
+    while !ctrl_queue.can_pop() {
+        spin_loop();
+    }
+    ctrl_queue.pop_used_with_token(token)?;
+
+    ack_slice.sync().unwrap();
+    let ack: u8 = ack_slice.read_val(0).unwrap();
+    if ack != VIRTIO_NET_OK {
+        return Err(QueueError::NotReady);
+    }
+    Ok(())
+}
+
 impl AnyNetworkDevice for NetworkDevice {
     fn mac_addr(&self) -> EthernetAddr {
         self.mac_addr
@@ -186,24 +457,57 @@ impl AnyNetworkDevice for NetworkDevice {
         caps.max_transmission_unit = 1536;
         caps.max_burst_size = Some(1);
         caps.medium = Medium::Ethernet;
+
+        let is_tx_offloaded = self.features.contains(NetworkFeatures::VIRTIO_NET_F_CSUM);
+        let is_rx_offloaded = self
+            .features
+            .contains(NetworkFeatures::VIRTIO_NET_F_GUEST_CSUM);
+        let checksum = match (is_tx_offloaded, is_rx_offloaded) {
+            (false, false) => Checksum::Both,
+            (false, true) => Checksum::Tx,
+            (true, false) => Checksum::Rx,
+            (true, true) => Checksum::None,
+        };
+        caps.checksum.tcp = checksum;
+        caps.checksum.udp = checksum;
         caps
     }
 
     fn can_receive(&self) -> bool {
-        self.recv_queue.can_pop()
+        self.queue_pairs
+            .iter()
+            .any(|queue_pair| queue_pair.recv_queue.can_pop())
     }
 
     fn can_send(&self) -> bool {
-        self.send_queue.available_desc() >= 2
+        let queue_pair = &self.queue_pairs[this_cpu() as usize % self.queue_pairs.len()];
+        // The sent buffers will be recycled before sending.
+        queue_pair.send_queue.available_desc() >= 1 || queue_pair.send_queue.can_pop()
     }
 
     fn receive(&mut self) -> Result<RxBuffer, VirtioNetError> {
         self.receive()
     }
 
+    fn recycle_rx_buffer(&mut self, rx_buffer: RxBuffer) {
+        self.recycle_rx_buffer(rx_buffer)
+    }
+
     fn send(&mut self, packet: &[u8]) -> Result<(), VirtioNetError> {
         self.send(packet)
     }
+
+    fn disable_recv_irq(&mut self) {
+        for queue_pair in self.queue_pairs.iter_mut() {
+            queue_pair.recv_queue.disable_callback();
+        }
+    }
+
+    fn enable_recv_irq(&mut self) {
+        for queue_pair in self.queue_pairs.iter_mut() {
+            queue_pair.recv_queue.enable_callback();
+        }
+    }
 }
 
 impl Debug for NetworkDevice {
@@ -211,14 +515,28 @@ impl Debug for NetworkDevice {
         f.debug_struct("NetworkDevice")
             .field("config", &self.config)
             .field("mac_addr", &self.mac_addr)
-            .field("send_queue", &self.send_queue)
-            .field("recv_queue", &self.recv_queue)
+            .field("nr_queue_pairs", &self.queue_pairs.len())
             .field("transport", &self.transport)
             .finish()
     }
 }
 
-const QUEUE_RECV: u16 = 0;
-const QUEUE_SEND: u16 = 1;
+/// The header of a command sent through the control virtqueue.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Pod)]
+struct CtrlHeader {
+    class: u8,
+    command: u8,
+}
+
+const VIRTIO_NET_CTRL_MQ: u8 = 4;
+const VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET: u8 = 0;
+
+const VIRTIO_NET_OK: u8 = 0;
+const VIRTIO_NET_ERR: u8 = 1;
 
-const QUEUE_SIZE: u16 = 64;
+const QUEUE_SIZE: u16 = 256;
+/// The legacy transport places the descriptors and the available ring in one frame,
+/// which limits the size of the queue.
+const LEGACY_QUEUE_SIZE: u16 = 128;
+const CTRL_QUEUE_SIZE: u16 = 16;
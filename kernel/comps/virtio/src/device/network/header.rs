@@ -22,6 +22,23 @@ pub struct VirtioNetHdr {
                       // padding_reserved: u16,  // Only if VIRTIO_NET_F_HASH_REPORT negotiated
 }
 
+impl VirtioNetHdr {
+    /// Creates a header that asks the device to checksum the packet from `csum_start`
+    /// to the end, and to store the checksum at `csum_start + csum_offset`.
+    pub fn with_partial_checksum(csum_start: u16, csum_offset: u16) -> Self {
+        Self {
+            flags: Flags::VIRTIO_NET_HDR_F_NEEDS_CSUM,
+            csum_start,
+            csum_offset,
+            ..Default::default()
+        }
+    }
+
+    pub fn flags(&self) -> Flags {
+        self.flags
+    }
+}
+
 bitflags! {
     #[repr(C)]
     #[derive(Default, Pod)]
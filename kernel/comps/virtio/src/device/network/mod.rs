@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: MPL-2.0
 
+mod checksum;
 pub mod config;
 pub mod device;
 pub mod header;
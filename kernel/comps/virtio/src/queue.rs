@@ -323,6 +323,26 @@ impl VirtQueue {
         self.queue_size
     }
 
+    /// Disables the interrupts for the used buffers.
+    ///
+    /// It is only a hint, so the device may still send interrupts.
+    pub fn disable_callback(&mut self) {
+        field_ptr!(&self.avail, AvailRing, flags)
+            .write(&VIRTQ_AVAIL_F_NO_INTERRUPT)
+            .unwrap();
+    }
+
+    /// Enables the interrupts for the used buffers.
+    ///
+    /// The buffers that were used before may not raise an interrupt, so the caller
+    /// should check `can_pop` after enabling the interrupts.
+    pub fn enable_callback(&mut self) {
+        field_ptr!(&self.avail, AvailRing, flags)
+            .write(&0u16)
+            .unwrap();
+        fence(Ordering::SeqCst);
+    }
+
     /// whether the driver should notify the device
     pub fn should_notify(&self) -> bool {
         // read barrier
@@ -337,6 +357,9 @@ impl VirtQueue {
     }
 }
 
+/// The flag in the available ring that asks the device not to send interrupts.
+const VIRTQ_AVAIL_F_NO_INTERRUPT: u16 = 1;
+
 #[repr(C, align(16))]
 #[derive(Debug, Default, Copy, Clone, Pod)]
 pub struct Descriptor {
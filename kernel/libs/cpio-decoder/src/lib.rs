@@ -110,32 +110,7 @@ where
     R: Read,
 {
     fn new(reader: &'a mut R) -> Result<Self> {
-        let (metadata, name, data_padding_len) = {
-            let header = Header::new(reader)?;
-            let name = {
-                let name_size = read_hex_bytes_to_u32(&header.name_size)? as usize;
-                let mut name_bytes = vec![0u8; name_size];
-                reader.read_exact(&mut name_bytes)?;
-                let name = core::ffi::CStr::from_bytes_with_nul(&name_bytes)
-                    .map_err(|_| Error::FileNameError)?;
-                name.to_str().map_err(|_| Error::Utf8Error)?.to_string()
-            };
-            let metadata = if name == TRAILER_NAME {
-                Default::default()
-            } else {
-                FileMetadata::new(&header)?
-            };
-            let data_padding_len = {
-                let header_padding_len = align_up_pad(header.len() + name.len() + 1, 4);
-                if header_padding_len > 0 {
-                    let mut pad_buf = vec![0u8; header_padding_len];
-                    reader.read_exact(&mut pad_buf)?;
-                }
-                align_up_pad(metadata.size() as usize, 4)
-            };
-
-            (metadata, name, data_padding_len)
-        };
+        let (metadata, name, data_padding_len) = read_entry_header(reader)?;
         Ok(Self {
             metadata,
             name,
@@ -161,7 +136,7 @@ where
     {
         let data_len = self.metadata().size() as usize;
         let mut send_len = 0;
-        let mut buffer = vec![0u8; 0x1000];
+        let mut buffer = vec![0u8; min(data_len, READ_BUFFER_SIZE).max(self.data_padding_len)];
         while send_len < data_len {
             let len = min(buffer.len(), data_len - send_len);
             self.reader.read_exact(&mut buffer[..len])?;
@@ -180,6 +155,126 @@ where
     }
 }
 
+/// A CPIO (the newc format) decoder to iterator over the CPIO entries in a buffer.
+///
+/// Unlike [`CpioDecoder`], the data of the entries are borrowed from the buffer
+/// rather than copied out, so the users can refer to the data in place.
+pub struct CpioSliceDecoder<'a> {
+    buffer: &'a [u8],
+    is_error: bool,
+}
+
+impl<'a> CpioSliceDecoder<'a> {
+    /// Create a decoder.
+    pub fn new(buffer: &'a [u8]) -> Self {
+        Self {
+            buffer,
+            is_error: false,
+        }
+    }
+
+    fn next_entry(&mut self) -> Result<CpioSliceEntry<'a>> {
+        let mut reader = self.buffer;
+        let (metadata, name, data_padding_len) = read_entry_header(&mut reader)?;
+
+        let data_len = metadata.size() as usize;
+        if reader.len() < data_len + data_padding_len {
+            return Err(Error::BufferShortError);
+        }
+        let (data, remain) = reader.split_at(data_len);
+        self.buffer = &remain[data_padding_len..];
+
+        Ok(CpioSliceEntry {
+            metadata,
+            name,
+            data,
+        })
+    }
+}
+
+impl<'a> Iterator for CpioSliceDecoder<'a> {
+    type Item = Result<CpioSliceEntry<'a>>;
+
+    /// Stops if reaches to the trailer entry or encounters an error.
+    fn next(&mut self) -> Option<Self::Item> {
+        // Stop to iterate entries if encounters an error.
+        if self.is_error {
+            return None;
+        }
+
+        match self.next_entry() {
+            Ok(entry) if entry.is_trailer() => None,
+            Ok(entry) => Some(Ok(entry)),
+            Err(err) => {
+                self.is_error = true;
+                Some(Err(err))
+            }
+        }
+    }
+}
+
+/// A file entry in the CPIO, whose data are borrowed from the buffer.
+#[derive(Debug)]
+pub struct CpioSliceEntry<'a> {
+    metadata: FileMetadata,
+    name: String,
+    data: &'a [u8],
+}
+
+impl<'a> CpioSliceEntry<'a> {
+    /// The metadata of the file.
+    pub fn metadata(&self) -> &FileMetadata {
+        &self.metadata
+    }
+
+    /// The name of the file.
+    pub fn name(&self) -> &str {
+        &self.name
+    }
+
+    /// The data of the file.
+    pub fn data(&self) -> &'a [u8] {
+        self.data
+    }
+
+    pub fn is_trailer(&self) -> bool {
+        self.name == TRAILER_NAME
+    }
+}
+
+/// Reads the header and the name of an entry.
+///
+/// Returns the metadata, the name and the length of the padding after the data.
+fn read_entry_header<R>(reader: &mut R) -> Result<(FileMetadata, String, usize)>
+where
+    R: Read,
+{
+    let header = Header::new(reader)?;
+    let name = {
+        let name_size = read_hex_bytes_to_u32(&header.name_size)? as usize;
+        let mut name_bytes = vec![0u8; name_size];
+        reader.read_exact(&mut name_bytes)?;
+        let name =
+            core::ffi::CStr::from_bytes_with_nul(&name_bytes).map_err(|_| Error::FileNameError)?;
+        name.to_str().map_err(|_| Error::Utf8Error)?.to_string()
+    };
+    let metadata = if name == TRAILER_NAME {
+        Default::default()
+    } else {
+        FileMetadata::new(&header)?
+    };
+    let data_padding_len = {
+        let header_padding_len = align_up_pad(header.len() + name.len() + 1, 4);
+        if header_padding_len > 0 {
+            let mut pad_buf = vec![0u8; header_padding_len];
+            reader.read_exact(&mut pad_buf)?;
+        }
+        align_up_pad(metadata.size() as usize, 4)
+    };
+
+    Ok((metadata, name, data_padding_len))
+}
+
 /// The metadata of the file.
 #[derive(Clone, Debug, Default, Eq, PartialEq)]
 pub struct FileMetadata {
@@ -307,6 +402,8 @@ impl Default for FileType {
 }
 
 const MAGIC: &[u8] = b"070701";
+/// The size of the buffer to read the data of a file.
+const READ_BUFFER_SIZE: usize = 0x10000;
 const TRAILER_NAME: &str = "TRAILER!!!";
 
 struct Header {
@@ -2,33 +2,34 @@
 
 use lending_iterator::LendingIterator;
 
-use super::{error::*, CpioDecoder, FileType};
+use super::{error::*, CpioDecoder, CpioSliceDecoder, FileType};
 
-#[test]
-fn test_decoder() {
+/// Archives the files of this crate into a CPIO buffer.
+fn prepare_buffer(manifest_path: &std::path::Path) -> Vec<u8> {
     use std::process::{Command, Stdio};
 
+    let mut find_process = Command::new("find")
+        .arg(manifest_path.as_os_str())
+        .stdout(Stdio::piped())
+        .spawn()
+        .expect("find command is not started");
+    let ecode = find_process.wait().expect("failed to execute find");
+    assert!(ecode.success());
+    let find_stdout = find_process.stdout.take().unwrap();
+    let output = Command::new("cpio")
+        .stdin(find_stdout)
+        .args(["-o", "-H", "newc"])
+        .output()
+        .expect("failed to execute cpio");
+    assert!(output.status.success());
+    output.stdout
+}
+
+#[test]
+fn test_decoder() {
     let manifest_path = std::env::var("CARGO_MANIFEST_DIR").unwrap();
     let manifest_path = std::path::Path::new(manifest_path.as_str());
-
-    // Prepare the cpio buffer
-    let buffer = {
-        let mut find_process = Command::new("find")
-            .arg(manifest_path.as_os_str())
-            .stdout(Stdio::piped())
-            .spawn()
-            .expect("find command is not started");
-        let ecode = find_process.wait().expect("failed to execute find");
-        assert!(ecode.success());
-        let find_stdout = find_process.stdout.take().unwrap();
-        let output = Command::new("cpio")
-            .stdin(find_stdout)
-            .args(["-o", "-H", "newc"])
-            .output()
-            .expect("failed to execute cpio");
-        assert!(output.status.success());
-        output.stdout
-    };
+    let buffer = prepare_buffer(manifest_path);
 
     let mut decoder = CpioDecoder::new(buffer.as_slice());
     // 1st entry must be the root entry
@@ -62,6 +63,28 @@ fn test_decoder() {
     }
 }
 
+#[test]
+fn test_slice_decoder() {
+    let manifest_path = std::env::var("CARGO_MANIFEST_DIR").unwrap();
+    let manifest_path = std::path::Path::new(manifest_path.as_str());
+    let buffer = prepare_buffer(manifest_path);
+
+    // The slice decoder must produce the same entries as the stream decoder.
+    let mut decoder = CpioDecoder::new(buffer.as_slice());
+    let mut slice_decoder = CpioSliceDecoder::new(buffer.as_slice());
+    while let Some(decode_result) = decoder.next() {
+        let mut entry = decode_result.unwrap();
+        let slice_entry = slice_decoder.next().unwrap().unwrap();
+        assert_eq!(entry.name(), slice_entry.name());
+        assert_eq!(entry.metadata(), slice_entry.metadata());
+
+        let mut data: Vec<u8> = Vec::new();
+        entry.read_all(&mut data).unwrap();
+        assert_eq!(data.as_slice(), slice_entry.data());
+    }
+    assert!(slice_decoder.next().is_none());
+}
+
 #[test]
 fn test_short_buffer() {
     let short_buffer: Vec<u8> = Vec::new();
@@ -69,6 +92,11 @@ fn test_short_buffer() {
     let entry_result = decoder.next().unwrap();
     assert!(entry_result.is_err());
     assert!(entry_result.err() == Some(Error::BufferShortError));
+
+    let mut slice_decoder = CpioSliceDecoder::new(short_buffer.as_slice());
+    let entry_result = slice_decoder.next().unwrap();
+    assert!(entry_result.err() == Some(Error::BufferShortError));
+    assert!(slice_decoder.next().is_none());
 }
 
 #[test]
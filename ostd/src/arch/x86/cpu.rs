@@ -4,8 +4,9 @@
 
 use alloc::vec::Vec;
 use core::{
-    arch::x86_64::{_fxrstor, _fxsave},
+    arch::x86_64::{__cpuid, __cpuid_count, _fxrstor, _fxsave},
     fmt::Debug,
+    mem::size_of,
 };
 
 use bitflags::bitflags;
@@ -13,11 +14,16 @@ use bitvec::{
     prelude::{BitVec, Lsb0},
     slice::IterOnes,
 };
-use log::debug;
+use log::{debug, warn};
 #[cfg(feature = "intel_tdx")]
 use tdx_guest::tdcall;
 use trapframe::{GeneralRegs, UserContext as RawUserContext};
-use x86_64::registers::rflags::RFlags;
+use x86_64::{
+    instructions::tables::{lgdt, sgdt},
+    registers::{model_specific::Msr, rflags::RFlags},
+    structures::DescriptorTablePointer,
+    VirtAddr,
+};
 
 #[cfg(feature = "intel_tdx")]
 use crate::arch::tdx_guest::{handle_virtual_exception, TdxTrapFrame};
@@ -38,6 +44,76 @@ pub fn this_cpu() -> u32 {
     0
 }
 
+/// The index of the GDT entry that encodes the CPU and the NUMA node, which is the
+/// same as `GDT_ENTRY_CPUNODE` in Linux.
+const GDT_ENTRY_CPUNODE: usize = 15;
+const IA32_TSC_AUX: u32 = 0xc000_0103;
+
+/// Publishes the CPU and the NUMA node of this CPU to the user space.
+///
+/// As in Linux, the value `(node << 12) | cpu` is written to the `IA32_TSC_AUX` MSR,
+/// which is read by `RDTSCP` and `RDPID`, and stored in the limit of a user-visible
+/// data segment in the GDT, which is read by `LSL`. The vDSO implements `getcpu` with
+/// these instructions, so the user space can get the CPU without a system call.
+///
+/// This function must be called after the GDT and the TSS of this CPU are loaded.
+pub(crate) fn init_cpu_node() {
+    // The NUMA nodes are not supported, so all the CPUs belong to node 0.
+    let cpu_node = this_cpu() as u64 & 0xfff;
+
+    // SAFETY: Executing `CPUID` has no side effects.
+    let (has_rdtscp, has_rdpid) = unsafe {
+        let has_rdtscp = (__cpuid(0x8000_0001).edx >> 27) & 1 == 1;
+        let has_rdpid = __cpuid(0).eax >= 7 && (__cpuid_count(7, 0).ecx >> 22) & 1 == 1;
+        (has_rdtscp, has_rdpid)
+    };
+    if has_rdtscp || has_rdpid {
+        // SAFETY: The MSR exists as checked above, and it is not used by the kernel.
+        unsafe { Msr::new(IA32_TSC_AUX).write(cpu_node) };
+    }
+
+    // A read-only, accessed, present, 32-bit data segment with DPL 3, whose limit is
+    // the CPU and the NUMA node.
+    let descriptor = (cpu_node & 0xffff)
+        | (0x5 << 40)
+        | (1 << 44)
+        | (3 << 45)
+        | (1 << 47)
+        | (((cpu_node >> 16) & 0xf) << 48)
+        | (1 << 54);
+
+    let gdtp = sgdt();
+    // SAFETY: The current GDT is valid, and its size is given by its limit.
+    let old_gdt = unsafe {
+        core::slice::from_raw_parts(
+            gdtp.base.as_ptr::<u64>(),
+            (gdtp.limit as usize + 1) / size_of::<u64>(),
+        )
+    };
+    if old_gdt
+        .get(GDT_ENTRY_CPUNODE)
+        .is_some_and(|entry| *entry != 0)
+    {
+        warn!("The GDT entry for the CPU and the NUMA node is occupied");
+        return;
+    }
+
+    // The GDT may be too small to contain the entry, so it is copied to a larger one.
+    // The old GDT is leaked, which is small and only done once for each CPU.
+    let mut gdt = Vec::from(old_gdt);
+    gdt.resize(gdt.len().max(GDT_ENTRY_CPUNODE + 1), 0);
+    gdt[GDT_ENTRY_CPUNODE] = descriptor;
+    let gdt = Vec::leak(gdt);
+    // SAFETY: The new GDT contains the same entries as the old one at the same indices,
+    // so the loaded segment selectors remain valid. The new GDT lives forever.
+    unsafe {
+        lgdt(&DescriptorTablePointer {
+            limit: (gdt.len() * size_of::<u64>() - 1) as u16,
+            base: VirtAddr::new(gdt.as_ptr() as u64),
+        });
+    }
+}
+
 /// A set of CPUs.
 #[derive(Default)]
 pub struct CpuSet {
@@ -22,6 +22,12 @@ pub trait Apic: ApicTimer + Sync + Send {
 
     /// End of Interrupt, this function will inform APIC that this interrupt has been processed.
     fn eoi(&mut self);
+
+    /// Sets the LVT performance monitoring counter register in the APIC.
+    /// Bit 0-7:   The interrupt vector of performance monitoring interrupt.
+    /// Bit 8-10:  Delivery Mode, 0 for Fixed, 4 for NMI.
+    /// Bit 16:    Mask bit, which is set by the CPU when the interrupt is delivered.
+    fn set_lvt_pmi(&mut self, value: u64);
 }
 
 pub trait ApicTimer: Sync + Send {
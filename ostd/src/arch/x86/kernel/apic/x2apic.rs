@@ -2,8 +2,8 @@
 
 use x86::msr::{
     rdmsr, wrmsr, IA32_APIC_BASE, IA32_X2APIC_APICID, IA32_X2APIC_CUR_COUNT, IA32_X2APIC_DIV_CONF,
-    IA32_X2APIC_EOI, IA32_X2APIC_INIT_COUNT, IA32_X2APIC_LVT_TIMER, IA32_X2APIC_SIVR,
-    IA32_X2APIC_VERSION,
+    IA32_X2APIC_EOI, IA32_X2APIC_INIT_COUNT, IA32_X2APIC_LVT_PMI, IA32_X2APIC_LVT_TIMER,
+    IA32_X2APIC_SIVR, IA32_X2APIC_VERSION,
 };
 
 use super::ApicTimer;
@@ -66,6 +66,12 @@ impl super::Apic for X2Apic {
             wrmsr(IA32_X2APIC_EOI, 0);
         }
     }
+
+    fn set_lvt_pmi(&mut self, value: u64) {
+        unsafe {
+            wrmsr(IA32_X2APIC_LVT_PMI, value);
+        }
+    }
 }
 
 impl ApicTimer for X2Apic {
@@ -74,6 +74,10 @@ impl super::Apic for XApic {
     fn eoi(&mut self) {
         self.write(xapic::XAPIC_EOI, 0);
     }
+
+    fn set_lvt_pmi(&mut self, value: u64) {
+        self.write(xapic::XAPIC_LVT_PMI, value as u32);
+    }
 }
 
 impl ApicTimer for XApic {
@@ -3,10 +3,14 @@
 #![allow(dead_code)]
 
 use alloc::fmt;
-use core::ops::Range;
+use core::{
+    arch::asm,
+    ops::Range,
+    sync::atomic::{AtomicBool, Ordering},
+};
 
 use pod::Pod;
-pub(crate) use util::__memcpy_fallible;
+pub(crate) use util::{__atomic_cmpxchg_fallible, __memcpy_fallible};
 use x86_64::{instructions::tlb, structures::paging::PhysFrame, VirtAddr};
 
 use crate::mm::{
@@ -73,8 +77,23 @@ pub(crate) fn tlb_flush_addr_range(range: &Range<Vaddr>) {
     }
 }
 
+/// Flushes all the non-global TLB entries of the current address space.
+///
+/// If PCIDs are enabled, the entries tagged with the other PCIDs are kept.
 pub(crate) fn tlb_flush_all_excluding_global() {
-    tlb::flush_all();
+    if !pcid_enabled() {
+        tlb::flush_all();
+        return;
+    }
+
+    // Reloading CR3 without the no-flush bit flushes the entries tagged with the current PCID.
+    // The no-flush bit always reads as zero.
+    // SAFETY: Writing back the value of CR3 only invalidates the TLB entries.
+    unsafe {
+        let cr3: u64;
+        asm!("mov {}, cr3", out(reg) cr3, options(nomem, nostack, preserves_flags));
+        asm!("mov cr3, {}", in(reg) cr3, options(nostack, preserves_flags));
+    }
 }
 
 pub(crate) fn tlb_flush_all_including_global() {
@@ -92,6 +111,45 @@ pub(crate) fn tlb_flush_all_including_global() {
     }
 }
 
+/// A process-context identifier (PCID), which tags the TLB entries of an address space.
+///
+/// Switching between the address spaces with different PCIDs need not flush the TLB.
+/// PCID 0 is used by the kernel page table.
+pub(crate) type Pcid = u16;
+
+/// The number of PCIDs.
+pub(crate) const NR_PCIDS: usize = 1 << 12;
+
+/// The bit of CR3 that keeps the TLB entries tagged with the new PCID when writing CR3.
+const CR3_NO_FLUSH: u64 = 1 << 63;
+
+static PCID_ENABLED: AtomicBool = AtomicBool::new(false);
+
+/// Enables PCIDs if the CPU supports them.
+///
+/// This must be called when the PCID bits of CR3 are zero.
+pub(crate) fn enable_pcid() {
+    use x86_64::registers::control::{Cr4, Cr4Flags};
+
+    // SAFETY: Querying CPUID is always safe on x86-64.
+    let has_pcid = unsafe { (core::arch::x86_64::__cpuid(1).ecx >> 17) & 1 == 1 };
+    if !has_pcid {
+        return;
+    }
+
+    // SAFETY: Enabling PCIDs only changes how the TLB entries are tagged, since the
+    // current PCID is zero.
+    unsafe {
+        Cr4::update(|cr4| *cr4 |= Cr4Flags::PCID);
+    }
+    PCID_ENABLED.store(true, Ordering::Relaxed);
+}
+
+/// Returns whether PCIDs are enabled.
+pub(crate) fn pcid_enabled() -> bool {
+    PCID_ENABLED.load(Ordering::Relaxed)
+}
+
 #[derive(Clone, Copy, Pod, Default)]
 #[repr(C)]
 pub struct PageTableEntry(usize);
@@ -104,6 +162,8 @@ pub struct PageTableEntry(usize);
 /// Changing the level 4 page table is unsafe, because it's possible to violate memory safety by
 /// changing the page mapping.
 pub unsafe fn activate_page_table(root_paddr: Paddr, root_pt_cache: CachePolicy) {
+    // The cache bits of CR3 are a part of the PCID if PCIDs are enabled.
+    debug_assert!(!pcid_enabled() || root_pt_cache == CachePolicy::Writeback);
     x86_64::registers::control::Cr3::write(
         PhysFrame::from_start_address(x86_64::PhysAddr::new(root_paddr as u64)).unwrap(),
         match root_pt_cache {
@@ -119,6 +179,34 @@ pub unsafe fn activate_page_table(root_paddr: Paddr, root_pt_cache: CachePolicy)
     );
 }
 
+/// Activates the given level 4 page table with the PCID.
+///
+/// The TLB entries tagged with the PCID are flushed only if `need_flush` is true. If PCIDs
+/// are not enabled, the PCID is ignored and the non-global TLB entries are always flushed.
+/// The root page table node is always cached in the write-back policy.
+///
+/// # Safety
+///
+/// The same as [`activate_page_table`]. Besides, the TLB entries tagged with the PCID must
+/// not be stale if `need_flush` is false.
+pub(crate) unsafe fn activate_page_table_with_pcid(
+    root_paddr: Paddr,
+    pcid: Pcid,
+    need_flush: bool,
+) {
+    if !pcid_enabled() {
+        activate_page_table(root_paddr, CachePolicy::Writeback);
+        return;
+    }
+
+    debug_assert!((pcid as usize) < NR_PCIDS);
+    let mut cr3 = root_paddr as u64 | pcid as u64;
+    if !need_flush {
+        cr3 |= CR3_NO_FLUSH;
+    }
+    asm!("mov cr3, {}", in(reg) cr3, options(nostack, preserves_flags));
+}
+
 pub fn current_page_table_paddr() -> Paddr {
     x86_64::registers::control::Cr3::read()
         .0
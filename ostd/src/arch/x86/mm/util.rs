@@ -1,10 +1,17 @@
 // SPDX-License-Identifier: MPL-2.0
 
 core::arch::global_asm!(include_str!("memcpy_fallible.S"));
+core::arch::global_asm!(include_str!("atomic_fallible.S"));
 
 extern "C" {
     /// Copies `size` bytes from `src` to `dst`. This function works with exception handling
     /// and can recover from page fault.
     /// Returns number of bytes that failed to copy.
     pub(crate) fn __memcpy_fallible(dst: *mut u8, src: *const u8, size: usize) -> usize;
+
+    /// Atomically compares the `u32` value at `ptr` with `old_val` and, if they are equal,
+    /// replaces it with `new_val`. This function works with exception handling and can
+    /// recover from page fault.
+    /// Returns the value before the operation, or `u64::MAX` if the value failed to access.
+    pub(crate) fn __atomic_cmpxchg_fallible(ptr: *mut u32, old_val: u32, new_val: u32) -> u64;
 }
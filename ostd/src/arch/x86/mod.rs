@@ -12,6 +12,7 @@ pub(crate) mod irq;
 pub(crate) mod kernel;
 pub(crate) mod mm;
 pub(crate) mod pci;
+pub mod pmu;
 pub mod qemu;
 pub mod task;
 #[cfg(feature = "intel_tdx")]
@@ -32,6 +33,7 @@ pub(crate) fn before_all_init() {
 }
 
 pub(crate) fn after_all_init() {
+    cpu::init_cpu_node();
     irq::init();
     kernel::acpi::init();
     match kernel::apic::init() {
@@ -45,6 +47,7 @@ pub(crate) fn after_all_init() {
     }
     console::callback_init();
     timer::init();
+    pmu::init();
     #[cfg(feature = "intel_tdx")]
     if !tdx_is_enabled() {
         match iommu::init() {
@@ -0,0 +1,357 @@
+// SPDX-License-Identifier: MPL-2.0
+
+//! The performance monitoring unit (PMU).
+//!
+//! The PMU provides general-purpose performance counters, each of which counts
+//! a hardware event (e.g., CPU cycles or cache misses) on the CPU. A counter
+//! can also raise an interrupt when it overflows, which is the basis of the
+//! sampling profilers.
+//!
+//! Only the architectural performance monitoring (version 2 or later) of Intel
+//! CPUs is supported for now. On other CPUs, or if the hypervisor does not
+//! expose the PMU, there are no counters available.
+
+use core::sync::atomic::{AtomicU32, AtomicU8, Ordering};
+
+use spin::Once;
+use trapframe::TrapFrame;
+use x86::msr::{rdmsr, wrmsr};
+
+use crate::{
+    arch::x86::kernel::apic::APIC_INSTANCE,
+    cpu::this_cpu,
+    cpu_local,
+    mm::{VmSpace, MAX_USERSPACE_VADDR},
+    task::current_task,
+    trap::{disable_local, IrqLine},
+};
+
+const IA32_PMC0: u32 = 0xc1;
+const IA32_PERFEVTSEL0: u32 = 0x186;
+const IA32_PERF_GLOBAL_STATUS: u32 = 0x38e;
+const IA32_PERF_GLOBAL_CTRL: u32 = 0x38f;
+const IA32_PERF_GLOBAL_OVF_CTRL: u32 = 0x390;
+
+const PERFEVTSEL_USR: u64 = 1 << 16;
+const PERFEVTSEL_OS: u64 = 1 << 17;
+const PERFEVTSEL_INT: u64 = 1 << 20;
+const PERFEVTSEL_EN: u64 = 1 << 22;
+
+/// The maximum number of general-purpose counters that are used.
+const MAX_NR_COUNTERS: u8 = 8;
+
+/// A hardware event that can be counted by the performance counters.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum HwEvent {
+    /// The unhalted core cycles.
+    CpuCycles,
+    /// The retired instructions.
+    Instructions,
+    /// The references to the last level cache.
+    CacheReferences,
+    /// The misses of the last level cache.
+    CacheMisses,
+    /// The retired branch instructions.
+    BranchInstructions,
+    /// The mispredicted branch instructions.
+    BranchMisses,
+}
+
+impl HwEvent {
+    /// Returns the event select and the unit mask of the architectural event, and
+    /// its bit in `EBX` of CPUID leaf 0AH, which is set if the event is unavailable.
+    fn encoding(self) -> (u64, u32) {
+        match self {
+            Self::CpuCycles => (0x003c, 0),
+            Self::Instructions => (0x00c0, 1),
+            Self::CacheReferences => (0x4f2e, 3),
+            Self::CacheMisses => (0x412e, 4),
+            Self::BranchInstructions => (0x00c4, 5),
+            Self::BranchMisses => (0x00c5, 6),
+        }
+    }
+
+    /// Returns whether the event is supported by the PMU.
+    pub fn is_supported(self) -> bool {
+        let Some(info) = PMU_INFO.get() else {
+            return false;
+        };
+        let (_, bit) = self.encoding();
+        bit < info.nr_events && info.unavailable_events & (1 << bit) == 0
+    }
+}
+
+/// The configuration of a performance counter.
+#[derive(Clone, Copy, Debug)]
+pub struct CounterConfig {
+    /// The event to be counted.
+    pub event: HwEvent,
+    /// Whether to count the event in the user mode.
+    pub count_user: bool,
+    /// Whether to count the event in the kernel mode.
+    pub count_kernel: bool,
+    /// Whether to call the overflow handler when the counter overflows.
+    pub interrupt_on_overflow: bool,
+}
+
+/// A general-purpose performance counter of a CPU.
+///
+/// The counter is stopped and freed when it is dropped. A counter must only be
+/// used and dropped on the CPU where it is allocated, with which the local IRQs
+/// or the preemption should be disabled.
+#[derive(Debug)]
+pub struct Counter {
+    index: u8,
+    cpu: u32,
+}
+
+impl Counter {
+    /// Allocates a counter on the current CPU and starts counting with the configuration.
+    ///
+    /// The counter starts from `value`, see [`Counter::write`].
+    ///
+    /// Returns `None` if the event is not supported or all counters are in use.
+    pub fn start(config: &CounterConfig, value: i32) -> Option<Self> {
+        if !config.event.is_supported() {
+            return None;
+        }
+        let nr_counters = nr_counters();
+
+        let _irq_guard = disable_local();
+        let used_bits = USED_COUNTERS.load(Ordering::Relaxed);
+        let index = (!used_bits).trailing_zeros() as u8;
+        if index >= nr_counters {
+            return None;
+        }
+        USED_COUNTERS.store(used_bits | (1 << index), Ordering::Relaxed);
+
+        let (encoding, _) = config.event.encoding();
+        let mut evtsel = encoding | PERFEVTSEL_EN;
+        if config.count_user {
+            evtsel |= PERFEVTSEL_USR;
+        }
+        if config.count_kernel {
+            evtsel |= PERFEVTSEL_OS;
+        }
+        if config.interrupt_on_overflow {
+            evtsel |= PERFEVTSEL_INT;
+        }
+
+        let counter = Self {
+            index,
+            cpu: this_cpu(),
+        };
+        // SAFETY: Programming a free performance counter does not affect memory safety.
+        unsafe {
+            wrmsr(IA32_PERFEVTSEL0 + index as u32, 0);
+            counter.write(value);
+            wrmsr(IA32_PERFEVTSEL0 + index as u32, evtsel);
+            let global_ctrl = rdmsr(IA32_PERF_GLOBAL_CTRL);
+            wrmsr(IA32_PERF_GLOBAL_CTRL, global_ctrl | (1 << index));
+        }
+        Some(counter)
+    }
+
+    /// Returns the index of the counter, which is passed to the overflow handler.
+    pub fn index(&self) -> u8 {
+        self.index
+    }
+
+    /// Reads the value of the counter.
+    ///
+    /// The value is truncated to the width of the counter, see [`counter_width`].
+    pub fn read(&self) -> u64 {
+        debug_assert_eq!(self.cpu, this_cpu());
+        // SAFETY: Reading an allocated performance counter does not affect memory safety.
+        unsafe { rdmsr(IA32_PMC0 + self.index as u32) }
+    }
+
+    /// Writes the value of the counter.
+    ///
+    /// The value is sign-extended to the width of the counter, so writing `-n`
+    /// makes the counter overflow after `n` events.
+    pub fn write(&self, value: i32) {
+        debug_assert_eq!(self.cpu, this_cpu());
+        // SAFETY: Writing an allocated performance counter does not affect memory safety.
+        unsafe { wrmsr(IA32_PMC0 + self.index as u32, value as i64 as u64) };
+    }
+}
+
+impl Drop for Counter {
+    fn drop(&mut self) {
+        debug_assert_eq!(self.cpu, this_cpu());
+
+        let _irq_guard = disable_local();
+        // SAFETY: Stopping an allocated performance counter does not affect memory safety.
+        unsafe {
+            let global_ctrl = rdmsr(IA32_PERF_GLOBAL_CTRL);
+            wrmsr(IA32_PERF_GLOBAL_CTRL, global_ctrl & !(1 << self.index));
+            wrmsr(IA32_PERFEVTSEL0 + self.index as u32, 0);
+        }
+        USED_COUNTERS.fetch_and(!(1 << self.index), Ordering::Relaxed);
+    }
+}
+
+/// Returns the number of general-purpose counters of each CPU.
+///
+/// If the PMU is not supported, this function returns zero.
+pub fn nr_counters() -> u8 {
+    PMU_INFO.get().map_or(0, |info| info.nr_counters)
+}
+
+/// Returns the bit width of the general-purpose counters.
+pub fn counter_width() -> u8 {
+    PMU_INFO.get().map_or(0, |info| info.counter_width)
+}
+
+/// Sets the handler that is called when a counter overflows.
+///
+/// The handler is called in the interrupt context with the trap frame of the
+/// interrupted code and the index of the overflowed counter. The counter keeps
+/// counting from zero after it overflows, so the handler usually writes it again
+/// to set the next overflow.
+pub fn set_overflow_handler(handler: fn(&TrapFrame, u8)) {
+    OVERFLOW_HANDLER.call_once(|| handler);
+}
+
+struct PmuInfo {
+    nr_counters: u8,
+    counter_width: u8,
+    nr_events: u32,
+    unavailable_events: u32,
+}
+
+static PMU_INFO: Once<PmuInfo> = Once::new();
+static OVERFLOW_HANDLER: Once<fn(&TrapFrame, u8)> = Once::new();
+/// The IRQ line of the performance monitoring interrupts (PMIs).
+static PMI_IRQ: Once<IrqLine> = Once::new();
+/// The LVT entry of the PMIs, which should be written again after each PMI
+/// since the entry is masked by the CPU on delivering the PMI.
+static LVT_PMI: AtomicU32 = AtomicU32::new(0);
+
+cpu_local! {
+    /// The bitmap of the allocated counters.
+    static USED_COUNTERS: AtomicU8 = AtomicU8::new(0);
+}
+
+pub(super) fn init() {
+    // SAFETY: CPUID leaf 0 is always available.
+    let max_leaf = unsafe { core::arch::x86_64::__cpuid(0) }.eax;
+    if max_leaf < 0xa {
+        return;
+    }
+    // SAFETY: CPUID leaf 0AH is available, as checked above.
+    let leaf = unsafe { core::arch::x86_64::__cpuid(0xa) };
+    let version = leaf.eax & 0xff;
+    let nr_counters = ((leaf.eax >> 8) & 0xff) as u8;
+    // The global control and status MSRs are introduced in version 2.
+    if version < 2 || nr_counters == 0 {
+        return;
+    }
+    let Some(apic) = APIC_INSTANCE.get() else {
+        return;
+    };
+
+    PMU_INFO.call_once(|| PmuInfo {
+        nr_counters: nr_counters.min(MAX_NR_COUNTERS),
+        counter_width: ((leaf.eax >> 16) & 0xff) as u8,
+        nr_events: leaf.eax >> 24,
+        unavailable_events: leaf.ebx,
+    });
+
+    let mut irq = IrqLine::alloc().unwrap();
+    irq.on_active(handle_pmi);
+    // The fixed delivery mode.
+    let lvt_pmi = irq.num() as u32;
+    LVT_PMI.store(lvt_pmi, Ordering::Relaxed);
+    apic.lock_irq_disabled().set_lvt_pmi(lvt_pmi as u64);
+    PMI_IRQ.call_once(|| irq);
+}
+
+fn handle_pmi(trap_frame: &TrapFrame) {
+    // SAFETY: Reading the overflow status does not affect memory safety.
+    let status = unsafe { rdmsr(IA32_PERF_GLOBAL_STATUS) };
+    let overflowed = status & ((1 << nr_counters()) - 1);
+
+    if let Some(handler) = OVERFLOW_HANDLER.get() {
+        let mut bits = overflowed;
+        while bits != 0 {
+            let index = bits.trailing_zeros() as u8;
+            handler(trap_frame, index);
+            bits &= bits - 1;
+        }
+    }
+
+    // SAFETY: Clearing the overflow status does not affect memory safety.
+    unsafe { wrmsr(IA32_PERF_GLOBAL_OVF_CTRL, overflowed) };
+    APIC_INSTANCE
+        .get()
+        .unwrap()
+        .lock_irq_disabled()
+        .set_lvt_pmi(LVT_PMI.load(Ordering::Relaxed) as u64);
+}
+
+/// Returns whether the trap frame is of the code running in the user mode.
+pub fn is_user_frame(trap_frame: &TrapFrame) -> bool {
+    trap_frame.rip < MAX_USERSPACE_VADDR
+}
+
+/// Walks the frame pointers of the interrupted kernel code.
+///
+/// The interrupted instruction pointer and the return addresses are written into
+/// `buf`, and the number of them is returned. Only the frames on the kernel stack
+/// of the current task are walked, so the call chain is truncated, but the walk is
+/// still safe, if the kernel is built without frame pointers.
+pub fn kernel_callchain(trap_frame: &TrapFrame, buf: &mut [usize]) -> usize {
+    let Some(task) = current_task() else {
+        return walk_frames(trap_frame, buf, |_| None);
+    };
+    let stack = task.kernel_stack_range();
+    walk_frames(trap_frame, buf, |addr| {
+        if addr < stack.start || addr + size_of::<usize>() > stack.end {
+            return None;
+        }
+        // SAFETY: The address is on the kernel stack of the current task, which is mapped.
+        Some(unsafe { (addr as *const usize).read() })
+    })
+}
+
+/// Walks the frame pointers of the interrupted user code in the given VM space.
+///
+/// This is similar to [`kernel_callchain`], except that the frames are read without
+/// triggering page faults, so the walk stops at any frame that is not present.
+pub fn user_callchain(trap_frame: &TrapFrame, vm_space: &VmSpace, buf: &mut [usize]) -> usize {
+    walk_frames(trap_frame, buf, |addr| vm_space.read_val_nofault(addr))
+}
+
+fn walk_frames(
+    trap_frame: &TrapFrame,
+    buf: &mut [usize],
+    read: impl Fn(usize) -> Option<usize>,
+) -> usize {
+    if buf.is_empty() {
+        return 0;
+    }
+    buf[0] = trap_frame.rip;
+
+    let mut len = 1;
+    let mut frame = trap_frame.rbp;
+    while len < buf.len() && frame % size_of::<usize>() == 0 {
+        // A frame starts with the saved frame pointer, followed by the return address.
+        let (Some(next_frame), Some(ret_addr)) = (read(frame), read(frame + size_of::<usize>()))
+        else {
+            break;
+        };
+        if ret_addr == 0 {
+            break;
+        }
+        buf[len] = ret_addr;
+        len += 1;
+        // The stack grows downwards, so the outer frames are at higher addresses.
+        if next_frame <= frame {
+            break;
+        }
+        frame = next_frame;
+    }
+    len
+}
@@ -80,6 +80,7 @@ pub fn init() {
     mm::misc_init();
 
     trap::init();
+    sync::init_rcu();
     arch::after_all_init();
     bus::init();
 
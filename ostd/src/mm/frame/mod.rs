@@ -69,6 +69,11 @@ impl Frame {
         paddr_to_vaddr(self.start_paddr()) as *mut u8
     }
 
+    /// Returns the number of `Frame` handles and mappings that refer to the page frame.
+    pub fn reference_count(&self) -> u32 {
+        self.page.reference_count()
+    }
+
     /// Copies the content of `src` to the frame.
     pub fn copy_from(&self, src: &Frame) {
         if self.paddr() == src.paddr() {
@@ -3,13 +3,13 @@
 //! A contiguous range of page frames.
 
 use alloc::sync::Arc;
-use core::ops::Range;
+use core::{mem::ManuallyDrop, ops::Range};
 
 use super::Frame;
 use crate::{
     mm::{
         page::{cont_pages::ContPages, meta::FrameMeta, Page},
-        HasPaddr, Paddr, VmIo, VmReader, VmWriter, PAGE_SIZE,
+        FrameVec, HasPaddr, Paddr, VmIo, VmReader, VmWriter, PAGE_SIZE,
     },
     Error, Result,
 };
@@ -160,3 +160,20 @@ impl From<ContPages<FrameMeta>> for Segment {
         }
     }
 }
+
+impl From<Segment> for FrameVec {
+    /// Converts the `Segment` into its page frames, which are still contiguous
+    /// but can be handled (e.g., unmapped or freed) one by one.
+    fn from(segment: Segment) -> Self {
+        let frames = (0..segment.nframes())
+            .map(|i| {
+                let paddr = segment.start_paddr() + i * PAGE_SIZE;
+                // SAFETY: The page is kept alive by the `Segment`. We are incrementing
+                // the reference count so we restore, clone, and forget the handle.
+                let page = ManuallyDrop::new(unsafe { Page::<FrameMeta>::from_raw(paddr) });
+                Frame::from((*page).clone())
+            })
+            .collect();
+        FrameVec(frames)
+    }
+}
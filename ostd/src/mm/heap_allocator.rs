@@ -1,8 +1,19 @@
 // SPDX-License-Identifier: MPL-2.0
 
+//! The kernel heap allocator.
+//!
+//! Small allocations are served by slabs of fixed-size objects. Each size class has
+//! a per-CPU free list, so the fast paths of allocation and deallocation only
+//! disable local IRQs and never take a lock. Free lists are refilled from and
+//! drained to a global depot of the size class in batches. Slabs themselves, as well
+//! as allocations larger than the largest size class, come from a buddy heap, which
+//! is enlarged with pages from the page allocator when it runs out of memory.
+
 use core::{
     alloc::{GlobalAlloc, Layout},
+    cell::RefCell,
     ptr::NonNull,
+    sync::atomic::{AtomicIsize, Ordering},
 };
 
 use align_ext::AlignExt;
@@ -11,15 +22,16 @@ use log::debug;
 
 use super::paddr_to_vaddr;
 use crate::{
+    cpu_local,
     mm::{page::allocator::PAGE_ALLOCATOR, PAGE_SIZE},
     prelude::*,
     sync::SpinLock,
     trap::disable_local,
-    Error,
+    CpuLocal, Error,
 };
 
 #[global_allocator]
-static HEAP_ALLOCATOR: LockedHeapWithRescue<32> = LockedHeapWithRescue::new(rescue);
+static HEAP_ALLOCATOR: SlabHeap<32> = SlabHeap::new(rescue);
 
 #[alloc_error_handler]
 pub fn handle_alloc_error(layout: core::alloc::Layout) -> ! {
@@ -37,6 +49,269 @@ pub fn init() {
     }
 }
 
+/// The number of slab size classes.
+const NR_SIZE_CLASSES: usize = 8;
+
+/// The object size of the smallest size class. The size of each of the other
+/// size classes doubles that of the previous one.
+const MIN_OBJECT_SIZE: usize = 16;
+
+/// The object size of the largest size class.
+const MAX_OBJECT_SIZE: usize = MIN_OBJECT_SIZE << (NR_SIZE_CLASSES - 1);
+
+/// The size of a slab, which is carved into objects of the same size class.
+const SLAB_SIZE: usize = PAGE_SIZE * 4;
+
+/// The number of objects moved between a per-CPU free list and the depot at a time.
+const CACHE_BATCH_SIZE: usize = 32;
+
+/// The maximum number of objects held by a per-CPU free list.
+const CACHE_CAPACITY: usize = 2 * CACHE_BATCH_SIZE;
+
+cpu_local! {
+    static SLAB_CACHES: RefCell<[FreeList; NR_SIZE_CLASSES]> =
+        RefCell::new([FreeList::EMPTY; NR_SIZE_CLASSES]);
+
+    /// The usage counters of the size classes, which are updated by the local CPU only,
+    /// so that the allocations do not bounce a shared cache line between the CPUs.
+    static SLAB_COUNTERS: [SizeClassCounters; NR_SIZE_CLASSES] =
+        [SizeClassCounters::NEW; NR_SIZE_CLASSES];
+}
+
+/// Returns the index of the size class that serves allocations of the layout,
+/// or `None` if the allocation should go to the buddy heap.
+///
+/// Slabs are page-aligned and objects are power-of-two sized, so every object is
+/// aligned to its size.
+fn size_class_of(layout: &Layout) -> Option<usize> {
+    let size = layout.size().max(layout.align()).max(MIN_OBJECT_SIZE);
+    if size > MAX_OBJECT_SIZE {
+        return None;
+    }
+    Some((size.next_power_of_two() / MIN_OBJECT_SIZE).trailing_zeros() as usize)
+}
+
+const fn object_size_of(class: usize) -> usize {
+    MIN_OBJECT_SIZE << class
+}
+
+/// A free object, which stores the link to the next free object in place.
+struct FreeObject {
+    next: Option<NonNull<FreeObject>>,
+}
+
+/// A singly linked list of free objects of the same size class.
+struct FreeList {
+    head: Option<NonNull<FreeObject>>,
+    len: usize,
+}
+
+// SAFETY: The free objects are owned by the list, so they can be moved to other CPUs
+// along with it.
+unsafe impl Send for FreeList {}
+
+impl FreeList {
+    const EMPTY: Self = Self { head: None, len: 0 };
+
+    fn is_empty(&self) -> bool {
+        self.head.is_none()
+    }
+
+    fn pop(&mut self) -> Option<NonNull<u8>> {
+        let object = self.head?;
+        // SAFETY: Objects in the list are free and large enough to hold a `FreeObject`.
+        self.head = unsafe { object.as_ref().next };
+        self.len -= 1;
+        Some(object.cast())
+    }
+
+    /// Pushes a free object to the list.
+    ///
+    /// # Safety
+    ///
+    /// The object must be free, no longer used by anyone else and at least
+    /// `MIN_OBJECT_SIZE` bytes in size.
+    unsafe fn push(&mut self, ptr: NonNull<u8>) {
+        let object = ptr.cast::<FreeObject>();
+        object.as_ptr().write(FreeObject { next: self.head });
+        self.head = Some(object);
+        self.len += 1;
+    }
+
+    /// Moves at most `count` objects from the list to a new list.
+    fn split_off(&mut self, count: usize) -> FreeList {
+        let mut batch = FreeList::EMPTY;
+        for _ in 0..count {
+            let Some(object) = self.pop() else {
+                break;
+            };
+            // SAFETY: The object is free since it was in the list.
+            unsafe { batch.push(object) };
+        }
+        batch
+    }
+
+    /// Moves all objects of another list to this list.
+    fn append(&mut self, mut other: FreeList) {
+        while let Some(object) = other.pop() {
+            // SAFETY: The object is free since it was in the other list.
+            unsafe { self.push(object) };
+        }
+    }
+}
+
+/// The usage counters of a size class on a CPU.
+///
+/// The number of objects in use on a CPU may be negative, since an object may be
+/// freed on a CPU other than the one that allocated it. Only the sums of the
+/// counters of all CPUs are meaningful.
+struct SizeClassCounters {
+    nr_in_use: AtomicIsize,
+    nr_slabs: AtomicIsize,
+}
+
+impl SizeClassCounters {
+    const NEW: Self = Self {
+        nr_in_use: AtomicIsize::new(0),
+        nr_slabs: AtomicIsize::new(0),
+    };
+}
+
+/// The usage statistics of a slab size class of the kernel heap.
+#[derive(Debug, Clone, Copy)]
+pub struct HeapSizeClassStat {
+    /// The size of the objects in the size class.
+    pub object_size: usize,
+    /// The number of objects that are allocated and not yet freed.
+    pub nr_objects_in_use: usize,
+    /// The number of objects in all slabs of the size class, whether in use or not.
+    pub nr_objects_total: usize,
+}
+
+/// Returns the usage statistics of all slab size classes of the kernel heap.
+///
+/// The statistics sum up the counters of all CPUs. A CPU-local variable has a single
+/// instance for now (see [`CpuLocal`]), which holds the counters of all CPUs.
+pub fn heap_size_class_stats() -> [HeapSizeClassStat; NR_SIZE_CLASSES] {
+    let all_cpu_counters = [&*SLAB_COUNTERS];
+    core::array::from_fn(|class| {
+        let (mut nr_in_use, mut nr_slabs) = (0, 0);
+        for counters in all_cpu_counters {
+            nr_in_use += counters[class].nr_in_use.load(Ordering::Relaxed);
+            nr_slabs += counters[class].nr_slabs.load(Ordering::Relaxed);
+        }
+        let object_size = object_size_of(class);
+        HeapSizeClassStat {
+            object_size,
+            nr_objects_in_use: nr_in_use.max(0) as usize,
+            nr_objects_total: nr_slabs.max(0) as usize * (SLAB_SIZE / object_size),
+        }
+    })
+}
+
+struct SlabHeap<const ORDER: usize> {
+    backend: LockedHeapWithRescue<ORDER>,
+    depots: [SpinLock<FreeList>; NR_SIZE_CLASSES],
+}
+
+impl<const ORDER: usize> SlabHeap<ORDER> {
+    const EMPTY_DEPOT: SpinLock<FreeList> = SpinLock::new(FreeList::EMPTY);
+
+    /// Creates an new heap
+    pub const fn new(rescue: fn(&LockedHeapWithRescue<ORDER>, &Layout) -> Result<()>) -> Self {
+        Self {
+            backend: LockedHeapWithRescue::new(rescue),
+            depots: [Self::EMPTY_DEPOT; NR_SIZE_CLASSES],
+        }
+    }
+
+    /// SAFETY: The range [start, start + size) must be a valid memory region.
+    pub unsafe fn init(&self, start: *const u8, size: usize) {
+        self.backend.init(start, size);
+    }
+
+    /// Fetches a batch of free objects from the depot, or from a new slab
+    /// if the depot is empty.
+    fn fetch_batch(&self, class: usize) -> Option<FreeList> {
+        let batch = self.depots[class]
+            .lock_irq_disabled()
+            .split_off(CACHE_BATCH_SIZE);
+        if !batch.is_empty() {
+            return Some(batch);
+        }
+        self.alloc_slab(class)
+    }
+
+    /// Allocates a new slab from the buddy heap and carves it into free objects.
+    ///
+    /// Slabs are never returned to the buddy heap. Their free objects are kept in
+    /// the free lists and the depots for later allocations of the same size class.
+    fn alloc_slab(&self, class: usize) -> Option<FreeList> {
+        let layout = Layout::from_size_align(SLAB_SIZE, PAGE_SIZE).unwrap();
+        // SAFETY: The layout has a non-zero size.
+        let slab = NonNull::new(unsafe { self.backend.alloc(layout) })?;
+        SLAB_COUNTERS[class]
+            .nr_slabs
+            .fetch_add(1, Ordering::Relaxed);
+
+        let object_size = object_size_of(class);
+        let mut objects = FreeList::EMPTY;
+        for offset in (0..SLAB_SIZE).step_by(object_size).rev() {
+            // SAFETY: The object is within the newly allocated slab and is not used by anyone.
+            unsafe { objects.push(NonNull::new_unchecked(slab.as_ptr().add(offset))) };
+        }
+        Some(objects)
+    }
+}
+
+unsafe impl<const ORDER: usize> GlobalAlloc for SlabHeap<ORDER> {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        let Some(class) = size_class_of(&layout) else {
+            return self.backend.alloc(layout);
+        };
+
+        let object = CpuLocal::borrow_with(&SLAB_CACHES, |caches| caches.borrow_mut()[class].pop())
+            .or_else(|| {
+                // Do not borrow the free lists when refilling them, since enlarging the
+                // buddy heap may allocate heap memory in turn.
+                let mut batch = self.fetch_batch(class)?;
+                let object = batch.pop();
+                CpuLocal::borrow_with(&SLAB_CACHES, |caches| {
+                    caches.borrow_mut()[class].append(batch)
+                });
+                object
+            });
+
+        let Some(object) = object else {
+            return core::ptr::null_mut::<u8>();
+        };
+        SLAB_COUNTERS[class]
+            .nr_in_use
+            .fetch_add(1, Ordering::Relaxed);
+        object.as_ptr()
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        debug_assert!(ptr as usize != 0);
+        let Some(class) = size_class_of(&layout) else {
+            self.backend.dealloc(ptr, layout);
+            return;
+        };
+
+        let overflow = CpuLocal::borrow_with(&SLAB_CACHES, |caches| {
+            let free_list = &mut caches.borrow_mut()[class];
+            free_list.push(NonNull::new_unchecked(ptr));
+            (free_list.len > CACHE_CAPACITY).then(|| free_list.split_off(CACHE_BATCH_SIZE))
+        });
+        if let Some(batch) = overflow {
+            self.depots[class].lock_irq_disabled().append(batch);
+        }
+        SLAB_COUNTERS[class]
+            .nr_in_use
+            .fetch_sub(1, Ordering::Relaxed);
+    }
+}
+
 struct LockedHeapWithRescue<const ORDER: usize> {
     heap: SpinLock<Heap<ORDER>>,
     rescue: fn(&Self, &Layout) -> Result<()>,
@@ -62,9 +337,8 @@ impl<const ORDER: usize> LockedHeapWithRescue<ORDER> {
             .lock_irq_disabled()
             .add_to_heap(start, start + size)
     }
-}
 
-unsafe impl<const ORDER: usize> GlobalAlloc for LockedHeapWithRescue<ORDER> {
+    /// SAFETY: The same as [`GlobalAlloc::alloc`].
     unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
         let _guard = disable_local();
 
@@ -85,8 +359,8 @@ unsafe impl<const ORDER: usize> GlobalAlloc for LockedHeapWithRescue<ORDER> {
             })
     }
 
+    /// SAFETY: The same as [`GlobalAlloc::dealloc`].
     unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
-        debug_assert!(ptr as usize != 0);
         self.heap
             .lock_irq_disabled()
             .dealloc(NonNull::new_unchecked(ptr), layout)
@@ -135,3 +409,41 @@ fn rescue<const ORDER: usize>(heap: &LockedHeapWithRescue<ORDER>, layout: &Layou
 
     Ok(())
 }
+
+#[cfg(ktest)]
+mod test {
+    use super::*;
+
+    #[ktest]
+    fn size_class() {
+        assert_eq!(size_class_of(&Layout::new::<u8>()), Some(0));
+        assert_eq!(size_class_of(&Layout::new::<[u8; 17]>()), Some(1));
+        assert_eq!(
+            size_class_of(&Layout::from_size_align(8, 64).unwrap()),
+            Some(2)
+        );
+        assert_eq!(
+            size_class_of(&Layout::new::<[u8; MAX_OBJECT_SIZE]>()),
+            Some(7)
+        );
+        assert_eq!(
+            size_class_of(&Layout::new::<[u8; MAX_OBJECT_SIZE + 1]>()),
+            None
+        );
+    }
+
+    #[ktest]
+    fn alloc_dealloc_small_objects() {
+        let objects: Vec<Box<[u8; 100]>> = (0..CACHE_CAPACITY * 2)
+            .map(|i| Box::new([i as u8; 100]))
+            .collect();
+        for (i, object) in objects.iter().enumerate() {
+            assert_eq!(object.as_ptr() as usize % 128, 0);
+            assert!(object.iter().all(|byte| *byte == i as u8));
+        }
+        let stat = heap_size_class_stats()[size_class_of(&Layout::new::<[u8; 100]>()).unwrap()];
+        assert_eq!(stat.object_size, 128);
+        assert!(stat.nr_objects_in_use >= objects.len());
+        assert!(stat.nr_objects_total >= stat.nr_objects_in_use);
+    }
+}
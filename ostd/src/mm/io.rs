@@ -9,7 +9,7 @@ use inherit_methods_macro::inherit_methods;
 use pod::Pod;
 
 use crate::{
-    arch::mm::__memcpy_fallible,
+    arch::mm::{__atomic_cmpxchg_fallible, __memcpy_fallible},
     mm::{
         kspace::{KERNEL_BASE_VADDR, KERNEL_END_VADDR},
         MAX_USERSPACE_VADDR,
@@ -601,6 +601,29 @@ impl<'a> VmWriter<'a, UserSpace> {
         self.write_fallible(&mut reader).map_err(|err| err.0)?;
         Ok(())
     }
+
+    /// Atomically compares the `u32` value at the cursor with `old_val` and, if they are
+    /// equal, replaces it with `new_val`.
+    ///
+    /// The value before the operation is returned, which equals `old_val` if and only if
+    /// the value is replaced. The cursor is not advanced.
+    ///
+    /// If the cursor is not aligned to 4 bytes, the remaining space is less than 4 bytes,
+    /// or the value can not be accessed, this method will return `Err`.
+    pub fn atomic_compare_exchange_u32(&self, old_val: u32, new_val: u32) -> Result<u32> {
+        if self.avail() < core::mem::size_of::<u32>()
+            || (self.cursor as usize) % core::mem::align_of::<u32>() != 0
+        {
+            return Err(Error::InvalidArgs);
+        }
+
+        // SAFETY: The cursor is aligned and points to user space, whose page table is
+        // guaranteed to be activated due to the construction requirement. A page fault
+        // is either handled or recovered from.
+        let old_or_fault =
+            unsafe { __atomic_cmpxchg_fallible(self.cursor as *mut u32, old_val, new_val) };
+        u32::try_from(old_or_fault).map_err(|_| Error::PageFault)
+    }
 }
 
 impl<'a, Space> VmWriter<'a, Space> {
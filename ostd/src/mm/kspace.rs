@@ -231,6 +231,8 @@ pub fn activate_kernel_page_table() {
         kpt.first_activate_unchecked();
         crate::arch::mm::tlb_flush_all_including_global();
     }
+    // The kernel page table is activated with PCID 0, so PCIDs can be enabled now.
+    crate::arch::mm::enable_pcid();
 
     // SAFETY: the boot page table is OK to be dropped now since
     // the kernel page table is activated.
@@ -18,6 +18,7 @@ pub(crate) mod page;
 pub(crate) mod page_prop;
 pub(crate) mod page_table;
 mod space;
+mod tlb;
 
 use alloc::vec::Vec;
 use core::{fmt::Debug, ops::Range};
@@ -27,7 +28,9 @@ use spin::Once;
 pub use self::{
     dma::{Daddr, DmaCoherent, DmaDirection, DmaStream, DmaStreamSlice, HasDaddr},
     frame::{options::FrameAllocOptions, Frame, FrameVec, FrameVecIter, Segment},
+    heap_allocator::{heap_size_class_stats, HeapSizeClassStat},
     io::{KernelSpace, UserSpace, VmIo, VmReader, VmWriter},
+    page::allocator::total_pages,
     page_prop::{CachePolicy, PageFlags, PageProperty},
     space::{VmMapOptions, VmSpace},
 };
@@ -72,6 +75,12 @@ pub(crate) trait PagingConstsTrait: Clone + Debug + Default + Sync + 'static {
 /// The page size
 pub const PAGE_SIZE: usize = page_size::<PagingConsts>(1);
 
+/// The level of the huge pages that can be mapped in user space.
+pub(crate) const HUGE_PAGE_LEVEL: PagingLevel = 2;
+
+/// The size of the huge pages that can be mapped in user space by [`VmSpace::map_huge`].
+pub const HUGE_PAGE_SIZE: usize = page_size::<PagingConsts>(HUGE_PAGE_LEVEL);
+
 /// The page size at a given level.
 pub(crate) const fn page_size<C: PagingConstsTrait>(level: PagingLevel) -> usize {
     C::BASE_PAGE_SIZE << (nr_subpage_per_huge::<C>().ilog2() as usize * (level as usize - 1))
@@ -83,7 +92,6 @@ pub(crate) const fn nr_subpage_per_huge<C: PagingConstsTrait>() -> usize {
 }
 
 /// The number of base pages in a huge page at a given level.
-#[allow(dead_code)]
 pub(crate) const fn nr_base_per_page<C: PagingConstsTrait>(level: PagingLevel) -> usize {
     page_size::<C>(level) / C::BASE_PAGE_SIZE
 }
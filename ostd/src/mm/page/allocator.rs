@@ -2,10 +2,18 @@
 
 //! The physical page memory allocator.
 //!
+//! Single pages are served from per-CPU caches of free pages, which are refilled
+//! from and drained to the global buddy allocator in batches. So most allocations
+//! and deallocations of single pages do not touch the lock of the global allocator.
+//!
 //! TODO: Decouple it with the frame allocator in [`crate::mm::frame::options`] by
 //! allocating pages rather untyped memory from this module.
 
 use alloc::vec::Vec;
+use core::{
+    cell::RefCell,
+    sync::atomic::{AtomicUsize, Ordering},
+};
 
 use align_ext::AlignExt;
 use buddy_system_allocator::FrameAllocator;
@@ -13,16 +21,117 @@ use log::info;
 use spin::Once;
 
 use super::{cont_pages::ContPages, meta::PageMeta, Page};
-use crate::{boot::memory_region::MemoryRegionType, mm::PAGE_SIZE, sync::SpinLock};
+use crate::{
+    boot::memory_region::MemoryRegionType, cpu_local, mm::PAGE_SIZE, sync::SpinLock, CpuLocal,
+};
 
 pub(in crate::mm) static PAGE_ALLOCATOR: Once<SpinLock<FrameAllocator>> = Once::new();
 
+/// The total number of pages that are added to the allocator.
+static NR_TOTAL_PAGES: AtomicUsize = AtomicUsize::new(0);
+
+/// Returns the total number of physical pages that can be allocated,
+/// including the allocated ones.
+pub fn total_pages() -> usize {
+    NR_TOTAL_PAGES.load(Ordering::Relaxed)
+}
+
+/// The number of pages moved between a per-CPU cache and the global allocator at a time.
+const CACHE_BATCH_SIZE: usize = 32;
+
+/// The maximum number of pages held by a per-CPU cache.
+const CACHE_CAPACITY: usize = 4 * CACHE_BATCH_SIZE;
+
+/// The maximum order of the contiguous chunks that [`alloc`] takes from the global
+/// allocator at a time.
+const MAX_BATCH_ORDER: u32 = 9;
+
+cpu_local! {
+    static PAGE_CACHE: RefCell<PageCache> = RefCell::new(PageCache::new());
+}
+
+/// A per-CPU cache of free pages.
+///
+/// The cache is a fixed-size stack of frame numbers, so it never allocates heap
+/// memory, which may in turn need pages from this allocator.
+struct PageCache {
+    frames: [usize; CACHE_CAPACITY],
+    len: usize,
+}
+
+impl PageCache {
+    const fn new() -> Self {
+        Self {
+            frames: [0; CACHE_CAPACITY],
+            len: 0,
+        }
+    }
+
+    fn pop(&mut self) -> Option<usize> {
+        if self.len == 0 {
+            self.refill();
+        }
+        if self.len == 0 {
+            return None;
+        }
+        self.len -= 1;
+        Some(self.frames[self.len])
+    }
+
+    fn push(&mut self, frame: usize) {
+        if self.len == CACHE_CAPACITY {
+            self.drain();
+        }
+        self.frames[self.len] = frame;
+        self.len += 1;
+    }
+
+    /// Takes a batch of pages from the global allocator.
+    fn refill(&mut self) {
+        let mut allocator = PAGE_ALLOCATOR.get().unwrap().lock();
+        while self.len < CACHE_BATCH_SIZE {
+            let Some(frame) = allocator.alloc(1) else {
+                break;
+            };
+            self.frames[self.len] = frame;
+            self.len += 1;
+        }
+    }
+
+    /// Returns a batch of pages to the global allocator.
+    ///
+    /// The most recently freed pages, which are likely to be cache-hot,
+    /// are kept in the cache.
+    fn drain(&mut self) {
+        let num_drained = CACHE_BATCH_SIZE.min(self.len);
+        let mut allocator = PAGE_ALLOCATOR.get().unwrap().lock();
+        for frame in &self.frames[..num_drained] {
+            allocator.dealloc(*frame, 1);
+        }
+        drop(allocator);
+        self.frames.copy_within(num_drained..self.len, 0);
+        self.len -= num_drained;
+    }
+
+    /// Moves at most `max_count` frames from the cache to `frames`.
+    fn take(&mut self, max_count: usize, frames: &mut Vec<usize>) {
+        let count = max_count.min(self.len);
+        frames.extend_from_slice(&self.frames[self.len - count..self.len]);
+        self.len -= count;
+    }
+}
+
 /// Allocate a single page.
 pub(crate) fn alloc_single<M: PageMeta>() -> Option<Page<M>> {
-    PAGE_ALLOCATOR.get().unwrap().lock().alloc(1).map(|idx| {
-        let paddr = idx * PAGE_SIZE;
-        Page::<M>::from_unused(paddr)
-    })
+    let frame = CpuLocal::borrow_with(&PAGE_CACHE, |cache| cache.borrow_mut().pop())?;
+    Some(Page::<M>::from_unused(frame * PAGE_SIZE))
+}
+
+/// Deallocate a single page.
+///
+/// The page must have been allocated from this allocator and must be no longer in use.
+pub(in crate::mm) fn dealloc_single(frame: usize) {
+    CpuLocal::borrow_with(&PAGE_CACHE, |cache| cache.borrow_mut().push(frame));
 }
 
 /// Allocate a contiguous range of pages of a given length in bytes.
@@ -45,20 +154,49 @@ pub(crate) fn alloc_contiguous<M: PageMeta>(len: usize) -> Option<ContPages<M>>
 /// The allocated pages are not guarenteed to be contiguous.
 /// The total length of the allocated pages is `len`.
 ///
+/// The pages are taken from the per-CPU cache first. The rest are taken from the
+/// global allocator in contiguous chunks as large as possible, with the global
+/// lock acquired only once.
+///
 /// # Panics
 ///
 /// The function panics if the length is not base-page-aligned.
 pub(crate) fn alloc<M: PageMeta>(len: usize) -> Option<Vec<Page<M>>> {
     assert!(len % PAGE_SIZE == 0);
     let nframes = len / PAGE_SIZE;
-    let mut allocator = PAGE_ALLOCATOR.get().unwrap().lock();
-    let mut vector = Vec::new();
-    for _ in 0..nframes {
-        let paddr = allocator.alloc(1)? * PAGE_SIZE;
-        let page = Page::<M>::from_unused(paddr);
-        vector.push(page);
+
+    let mut frames = Vec::with_capacity(nframes);
+    CpuLocal::borrow_with(&PAGE_CACHE, |cache| {
+        cache.borrow_mut().take(nframes, &mut frames)
+    });
+
+    if frames.len() < nframes {
+        let mut allocator = PAGE_ALLOCATOR.get().unwrap().lock();
+        let mut order = MAX_BATCH_ORDER;
+        while frames.len() < nframes {
+            let remaining = nframes - frames.len();
+            let chunk_order = order.min(remaining.ilog2());
+            if let Some(start) = allocator.alloc(1 << chunk_order) {
+                frames.extend(start..start + (1 << chunk_order));
+                continue;
+            }
+            if chunk_order == 0 {
+                // Out of memory. Give back what we have taken.
+                for frame in frames {
+                    allocator.dealloc(frame, 1);
+                }
+                return None;
+            }
+            order = chunk_order - 1;
+        }
     }
-    Some(vector)
+
+    Some(
+        frames
+            .into_iter()
+            .map(|frame| Page::<M>::from_unused(frame * PAGE_SIZE))
+            .collect(),
+    )
 }
 
 pub(crate) fn init() {
@@ -75,6 +213,7 @@ pub(crate) fn init() {
             }
             // Add global free pages to the frame allocator.
             allocator.add_frame(start, end);
+            NR_TOTAL_PAGES.fetch_add(end - start, Ordering::Relaxed);
             info!(
                 "Found usable region, start:{:x}, end:{:x}",
                 region.base(),
@@ -151,6 +151,14 @@ impl<M: PageMeta> Page<M> {
         unsafe { &mut *(self.ptr as *mut M) }
     }
 
+    /// Get the number of references to this page.
+    ///
+    /// The number may be outdated as soon as it is returned, unless all the
+    /// references are known to be protected from being cloned or dropped.
+    pub fn reference_count(&self) -> u32 {
+        self.get_ref_count().load(Ordering::Relaxed)
+    }
+
     fn get_ref_count(&self) -> &AtomicU32 {
         unsafe { &(*self.ptr).ref_count }
     }
@@ -55,8 +55,8 @@ use core::{any::TypeId, marker::PhantomData, ops::Range};
 use align_ext::AlignExt;
 
 use super::{
-    page_size, pte_index, Child, KernelMode, PageTable, PageTableEntryTrait, PageTableError,
-    PageTableMode, PageTableNode, PagingConstsTrait, PagingLevel, UserMode,
+    nr_subpage_per_huge, page_size, pte_index, Child, KernelMode, PageTable, PageTableEntryTrait,
+    PageTableError, PageTableMode, PageTableNode, PagingConstsTrait, PagingLevel, UserMode,
 };
 use crate::mm::{page::DynPage, Paddr, PageProperty, Vaddr};
 
@@ -99,6 +99,11 @@ where
     guard_level: PagingLevel, // from guard_level to level, the locks are held
     va: Vaddr,                // current virtual address
     barrier_va: Range<Vaddr>, // virtual address range that is locked
+    /// Whether the shared page table nodes are copied before going down to them.
+    ///
+    /// User page tables share the page table nodes after forking. Mutable cursors of
+    /// them copy the shared nodes on the path so that modifications are private.
+    unshare_nodes: bool,
     phantom: PhantomData<&'a PageTable<M, E, C>>,
 }
 
@@ -113,6 +118,14 @@ where
     pub(crate) fn new(
         pt: &'a PageTable<M, E, C>,
         va: &Range<Vaddr>,
+    ) -> Result<Self, PageTableError> {
+        Self::new_inner(pt, va, false)
+    }
+
+    fn new_inner(
+        pt: &'a PageTable<M, E, C>,
+        va: &Range<Vaddr>,
+        unshare_nodes: bool,
     ) -> Result<Self, PageTableError> {
         if !M::covers(va) {
             return Err(PageTableError::InvalidVaddrRange(va.start, va.end));
@@ -135,6 +148,7 @@ where
             guard_level: C::NR_LEVELS,
             va: va.start,
             barrier_va: va.clone(),
+            unshare_nodes,
             phantom: PhantomData,
         };
 
@@ -157,6 +171,13 @@ where
                 break;
             }
 
+            // If the range covers the whole slot, the cursor may replace the child page
+            // table with a huge page. So the lock of the current node should be held.
+            let slot_size = page_size::<C>(cursor.level);
+            if va.start % slot_size == 0 && va.len() == slot_size {
+                break;
+            }
+
             cursor.level_down();
 
             // Release the guard of the previous level.
@@ -241,12 +262,28 @@ where
     fn level_down(&mut self) {
         debug_assert!(self.level > 1);
 
-        if let Child::PageTable(nxt_lvl_ptn) = self.cur_child() {
-            self.level -= 1;
-            self.guards[(C::NR_LEVELS - self.level) as usize] = Some(nxt_lvl_ptn.lock());
-        } else {
+        let Child::PageTable(nxt_lvl_ptn) = self.cur_child() else {
             panic!("Trying to level down when it is not mapped to a page table");
+        };
+        let mut nxt_lvl_ptn = nxt_lvl_ptn.lock();
+
+        if self.unshare_nodes && nxt_lvl_ptn.is_shared() {
+            // SAFETY: The node is in the user space, so it only contains tracked mappings.
+            // The copy shares the children of the node, which are write-protected.
+            let new_node = unsafe { nxt_lvl_ptn.make_copy(0..0, 0..nr_subpage_per_huge::<C>()) };
+            drop(nxt_lvl_ptn);
+
+            let idx = self.cur_idx();
+            let is_tracked = self.in_tracked_range();
+            self.guards[(C::NR_LEVELS - self.level) as usize]
+                .as_mut()
+                .unwrap()
+                .set_child_pt(idx, new_node.clone_raw(), is_tracked);
+            nxt_lvl_ptn = new_node;
         }
+
+        self.level -= 1;
+        self.guards[(C::NR_LEVELS - self.level) as usize] = Some(nxt_lvl_ptn);
     }
 
     fn cur_node(&self) -> &PageTableNode<E, C> {
@@ -321,7 +358,8 @@ where
         pt: &'a PageTable<M, E, C>,
         va: &Range<Vaddr>,
     ) -> Result<Self, PageTableError> {
-        Cursor::new(pt, va).map(|inner| Self(inner))
+        let unshare_nodes = TypeId::of::<M>() == TypeId::of::<UserMode>();
+        Cursor::new_inner(pt, va, unshare_nodes).map(|inner| Self(inner))
     }
 
     /// Gets the information of the current slot and go to the next slot.
@@ -332,6 +370,11 @@ where
         self.0.next()
     }
 
+    /// Gets the information of the current slot without moving to the next slot.
+    pub(crate) fn query(&mut self) -> Option<PageTableQueryResult> {
+        self.0.query()
+    }
+
     /// Jumps to the given virtual address.
     ///
     /// # Panics
@@ -365,12 +408,14 @@ where
 
     /// Maps the range starting from the current address to a [`DynPage`].
     ///
+    /// If the range is already mapped to a huge page, the huge page will be split
+    /// into smaller pages first.
+    ///
     /// # Panics
     ///
     /// This function will panic if
     ///  - the virtual address range to be mapped is out of the range;
-    ///  - the alignment of the page is not satisfied by the virtual address;
-    ///  - it is already mapped to a huge page while the caller wants to map a smaller one.
+    ///  - the alignment of the page is not satisfied by the virtual address.
     ///
     /// # Safety
     ///
@@ -392,7 +437,7 @@ where
             } else if !pte.is_present() {
                 self.level_down_create();
             } else {
-                panic!("Mapping a smaller page in an already mapped huge page");
+                self.level_down_split();
             }
             continue;
         }
@@ -404,6 +449,56 @@ where
         self.0.move_forward();
     }
 
+    /// Maps the range starting from the current address to a tracked huge page at the
+    /// given level.
+    ///
+    /// The huge page is made up of the base pages starting from `pa`. Existing mappings
+    /// in the range, including the page tables that map smaller pages, are replaced by
+    /// the huge page. So it can be used to collapse smaller pages into a huge page.
+    ///
+    /// # Panics
+    ///
+    /// This function will panic if
+    ///  - the level is not a valid level to map huge pages;
+    ///  - the virtual address range to be mapped is out of the range;
+    ///  - the alignment of the huge page is not satisfied by the virtual address.
+    ///
+    /// # Safety
+    ///
+    /// The caller should ensure that
+    ///  - the virtual range being mapped does not affect kernel's memory safety;
+    ///  - `pa` is aligned to the page size at the level;
+    ///  - the ownership of a reference to each of the base pages is transferred to
+    ///    this function.
+    pub(crate) unsafe fn map_huge(&mut self, pa: Paddr, level: PagingLevel, prop: PageProperty) {
+        assert!(level > 1 && level <= C::HIGHEST_TRANSLATION_LEVEL);
+        let end = self.0.va + page_size::<C>(level);
+        assert!(end <= self.0.barrier_va.end);
+        assert!(self.0.va % page_size::<C>(level) == 0);
+        debug_assert_eq!(pa % page_size::<C>(level), 0);
+        debug_assert!(self.0.in_tracked_range());
+
+        while self.0.level < level {
+            debug_assert!(self.0.level < self.0.guard_level);
+            self.0.level_up();
+        }
+        while self.0.level > level {
+            let pte = self.0.read_cur_pte();
+            if pte.is_present() && !pte.is_last(self.0.level) {
+                self.0.level_down();
+            } else if !pte.is_present() {
+                self.level_down_create();
+            } else {
+                self.level_down_split();
+            }
+        }
+
+        // Map the huge page. The child page table, if any, is dropped.
+        let idx = self.0.cur_idx();
+        self.cur_node_mut().set_child_huge(idx, pa, prop);
+        self.0.move_forward();
+    }
+
     /// Maps the range starting from the current address to a physical address range.
     ///
     /// The function will map as more huge pages as possible, and it will split
@@ -479,8 +574,9 @@ where
     /// # Panics
     ///
     /// This function will panic if:
-    ///  - the range to be unmapped is out of the range where the cursor is required to operate;
-    ///  - the range covers only a part of a page.
+    ///  - the range to be unmapped is out of the range where the cursor is required to operate.
+    ///
+    /// If the range covers only a part of a huge page, the huge page will be split.
     pub(crate) unsafe fn unmap(&mut self, len: usize) {
         let end = self.0.va + len;
         assert!(end <= self.0.barrier_va.end);
@@ -509,10 +605,8 @@ where
             {
                 if cur_pte.is_present() && !cur_pte.is_last(self.0.level) {
                     self.0.level_down();
-                } else if !is_tracked {
-                    self.level_down_split();
                 } else {
-                    unreachable!();
+                    self.level_down_split();
                 }
                 continue;
             }
@@ -528,7 +622,8 @@ where
     /// Applies the given operation to all the mappings within the range.
     ///
     /// The funtction will return an error if it is not allowed to protect an invalid range and
-    /// it does so, or if the range to be protected only covers a part of a page.
+    /// it does so. If the range to be protected only covers a part of a huge page, the huge
+    /// page will be split.
     ///
     /// # Safety
     ///
@@ -564,14 +659,12 @@ where
             }
 
             // Go down if the page size is too big and we are protecting part
-            // of untracked huge pages.
+            // of huge pages.
             let vaddr_not_fit = self.0.va % page_size::<C>(self.0.level) != 0
                 || self.0.va + page_size::<C>(self.0.level) > end;
-            if !self.0.in_tracked_range() && vaddr_not_fit {
+            if vaddr_not_fit {
                 self.level_down_split();
                 continue;
-            } else if vaddr_not_fit {
-                return Err(PageTableError::ProtectingPartial);
             }
 
             let mut pte_prop = cur_pte.prop();
@@ -617,15 +710,18 @@ where
         self.0.guards[(C::NR_LEVELS - self.0.level) as usize] = Some(new_node);
     }
 
-    /// Goes down a level assuming the current slot is an untracked huge page.
+    /// Goes down a level assuming the current slot is a huge page.
     ///
     /// This method will split the huge page and go down to the next level.
     fn level_down_split(&mut self) {
         debug_assert!(self.0.level > 1);
-        debug_assert!(!self.0.in_tracked_range());
 
         let idx = self.0.cur_idx();
-        self.cur_node_mut().split_untracked_huge(idx);
+        if self.0.in_tracked_range() {
+            self.cur_node_mut().split_tracked_huge(idx);
+        } else {
+            self.cur_node_mut().split_untracked_huge(idx);
+        }
 
         let Child::PageTable(new_node) = self.0.cur_child() else {
             unreachable!();
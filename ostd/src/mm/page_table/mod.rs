@@ -5,11 +5,10 @@ use core::{fmt::Debug, marker::PhantomData, ops::Range};
 use pod::Pod;
 
 use super::{
-    nr_subpage_per_huge, paddr_to_vaddr,
-    page_prop::{PageFlags, PageProperty},
-    page_size, Paddr, PagingConstsTrait, PagingLevel, Vaddr,
+    nr_base_per_page, nr_subpage_per_huge, paddr_to_vaddr, page_prop::PageProperty, page_size,
+    Paddr, PagingConstsTrait, PagingLevel, Vaddr,
 };
-use crate::arch::mm::{PageTableEntry, PagingConsts};
+use crate::arch::mm::{PageTableEntry, PagingConsts, Pcid};
 
 mod node;
 use node::*;
@@ -87,41 +86,34 @@ pub(crate) struct PageTable<
 }
 
 impl PageTable<UserMode> {
-    pub(crate) fn activate(&self) {
+    /// Activates the page table with the PCID.
+    ///
+    /// # Safety
+    ///
+    /// The TLB entries tagged with the PCID must not be stale if `need_flush` is false.
+    pub(crate) unsafe fn activate(&self, pcid: Pcid, need_flush: bool) {
         // SAFETY: The usermode page table is safe to activate since the kernel
-        // mappings are shared.
+        // mappings are shared. The TLB entries are ensured by the caller.
         unsafe {
-            self.root.activate();
+            self.root.activate(pcid, need_flush);
         }
     }
 
     /// Remove all write permissions from the user page table and create a cloned
     /// new page table.
     ///
-    /// TODO: We may consider making the page table itself copy-on-write.
+    /// The page table itself is copy-on-write. The new page table shares the child
+    /// page table nodes of the root with this page table, and the shared nodes are
+    /// copied when a mutable cursor goes down to them. Since nodes that are already
+    /// shared are write-protected, forking again only visits the nodes that have been
+    /// copied since the last fork.
     pub(crate) fn fork_copy_on_write(&self) -> Self {
-        let mut cursor = self.cursor_mut(&UserMode::VADDR_RANGE).unwrap();
-
-        // SAFETY: Protecting the user page table is safe.
-        unsafe {
-            cursor
-                .protect(
-                    UserMode::VADDR_RANGE.len(),
-                    |p: &mut PageProperty| p.flags -= PageFlags::W,
-                    true,
-                )
-                .unwrap();
-        };
-
-        let root_node = cursor.leak_root_guard().unwrap();
+        let cursor = self.cursor_mut(&UserMode::VADDR_RANGE).unwrap();
+        let mut root_node = cursor.leak_root_guard().unwrap();
 
         const NR_PTES_PER_NODE: usize = nr_subpage_per_huge::<PagingConsts>();
-        let new_root_node = unsafe {
-            root_node.make_copy(
-                0..NR_PTES_PER_NODE / 2,
-                NR_PTES_PER_NODE / 2..NR_PTES_PER_NODE,
-            )
-        };
+        root_node.protect_for_sharing(0..NR_PTES_PER_NODE / 2);
+        let new_root_node = unsafe { root_node.make_copy(0..0, 0..NR_PTES_PER_NODE) };
 
         PageTable::<UserMode> {
             root: new_root_node.into_raw(),
@@ -27,9 +27,9 @@
 
 use core::{marker::PhantomData, mem::ManuallyDrop, ops::Range, panic, sync::atomic::Ordering};
 
-use super::{nr_subpage_per_huge, page_size, PageTableEntryTrait};
+use super::{nr_base_per_page, nr_subpage_per_huge, page_size, PageTableEntryTrait};
 use crate::{
-    arch::mm::{PageTableEntry, PagingConsts},
+    arch::mm::{PageTableEntry, PagingConsts, Pcid},
     mm::{
         paddr_to_vaddr,
         page::{
@@ -37,7 +37,7 @@ use crate::{
             meta::{PageMeta, PageTablePageMeta, PageUsage},
             DynPage, Page,
         },
-        page_prop::PageProperty,
+        page_prop::{PageFlags, PageProperty},
         Paddr, PagingConstsTrait, PagingLevel, PAGE_SIZE,
     },
 };
@@ -115,22 +115,25 @@ where
     /// The caller must ensure that the page table to be activated has
     /// proper mappings for the kernel and has the correct const parameters
     /// matching the current CPU.
-    pub(crate) unsafe fn activate(&self) {
-        use crate::{
-            arch::mm::{activate_page_table, current_page_table_paddr},
-            mm::CachePolicy,
-        };
+    ///
+    /// The TLB entries tagged with the PCID are flushed if `need_flush` is true. The
+    /// page table is not reloaded if it is already activated and needs no flush.
+    pub(crate) unsafe fn activate(&self, pcid: Pcid, need_flush: bool) {
+        use crate::arch::mm::{activate_page_table_with_pcid, current_page_table_paddr};
 
         debug_assert_eq!(self.level, PagingConsts::NR_LEVELS);
 
         let last_activated_paddr = current_page_table_paddr();
 
-        activate_page_table(self.raw, CachePolicy::Writeback);
-
         if last_activated_paddr == self.raw {
+            if need_flush {
+                activate_page_table_with_pcid(self.raw, pcid, true);
+            }
             return;
         }
 
+        activate_page_table_with_pcid(self.raw, pcid, need_flush);
+
         // Increment the reference count of the current page table.
         self.inc_ref();
 
@@ -290,6 +293,7 @@ where
                 // SAFETY: The physical address is recorded in a valid PTE
                 // which would be casted from a handle. We are incrementing
                 // the reference count so we restore and forget a cloned one.
+                // For a huge page, this is the handle to its first base page.
                 let page = unsafe { DynPage::from_raw(paddr) };
                 core::mem::forget(page.clone());
                 Child::Page(page)
@@ -302,11 +306,11 @@ where
     /// Makes a copy of the page table node.
     ///
     /// This function allows you to control about the way to copy the children.
-    /// For indexes in `deep`, the children are deep copied and this function will be recursively called.
-    /// For indexes in `shallow`, the children are shallow copied as new references.
+    /// For indexes in `deep`, the child page tables are deep copied and this function will be
+    /// recursively called. For indexes in `shallow`, the child page tables are shallow copied as
+    /// new references, so that they are shared by both nodes.
     ///
-    /// You cannot shallow copy a child that is mapped to a page. Deep copying a page child will not
-    /// copy the mapped page but will copy the handle to the page.
+    /// Copying a page child will not copy the mapped page but will copy the handle to the page.
     ///
     /// You cannot either deep copy or shallow copy a child that is mapped to an untracked page.
     ///
@@ -319,37 +323,85 @@ where
         let mut new_pt = Self::alloc(self.level());
 
         for i in deep {
-            match self.child(i, true) {
-                Child::PageTable(pt) => {
-                    let guard = pt.clone_shallow().lock();
-                    let new_child = guard.make_copy(0..nr_subpage_per_huge::<C>(), 0..0);
-                    new_pt.set_child_pt(i, new_child.into_raw(), true);
-                }
-                Child::Page(page) => {
-                    let prop = self.read_pte_prop(i);
-                    new_pt.set_child_page(i, page.clone(), prop);
-                }
-                Child::None => {}
-                Child::Untracked(_) => {
-                    unreachable!();
-                }
-            }
+            self.copy_child(&mut new_pt, i, true);
         }
 
         for i in shallow {
-            debug_assert_eq!(self.level(), C::NR_LEVELS);
-            match self.child(i, /*meaningless*/ true) {
-                Child::PageTable(pt) => {
-                    new_pt.set_child_pt(i, pt.clone_shallow(), /*meaningless*/ true);
-                }
-                Child::None => {}
-                Child::Page(_) | Child::Untracked(_) => {
-                    unreachable!();
+            self.copy_child(&mut new_pt, i, false);
+        }
+
+        new_pt
+    }
+
+    fn copy_child(&self, new_pt: &mut Self, idx: usize, deep: bool) {
+        match self.child(idx, true) {
+            Child::PageTable(pt) if deep => {
+                let guard = pt.clone_shallow().lock();
+                // SAFETY: The child is copied in the same way as its parent.
+                let new_child = unsafe { guard.make_copy(0..nr_subpage_per_huge::<C>(), 0..0) };
+                new_pt.set_child_pt(idx, new_child.into_raw(), true);
+            }
+            Child::PageTable(pt) => {
+                new_pt.set_child_pt(idx, pt.clone_shallow(), true);
+            }
+            Child::Page(page) if self.level() > 1 => {
+                let prop = self.read_pte_prop(idx);
+                // SAFETY: The huge page is mapped by this node, so its base pages are
+                // alive. The extra references are transferred to the new PTE.
+                unsafe {
+                    inc_tracked_pages_ref::<C>(page.paddr(), self.level());
+                    new_pt.set_child_huge(idx, page.paddr(), prop);
                 }
             }
+            Child::Page(page) => {
+                let prop = self.read_pte_prop(idx);
+                new_pt.set_child_page(idx, page.clone(), prop);
+            }
+            Child::None => {}
+            Child::Untracked(_) => {
+                unreachable!();
+            }
         }
+    }
 
-        new_pt
+    /// Tells if the page table node is shared by multiple page tables.
+    ///
+    /// This should be called on a locked node that is reached from a locked parent, i.e., with
+    /// one reference held by the parent's PTE and one reference held by the handle. Other
+    /// references come from the PTEs of other page tables that share the node. Transient
+    /// references may make the node look shared, which is harmless but unnecessary.
+    pub(super) fn is_shared(&self) -> bool {
+        self.page.reference_count() > 2
+    }
+
+    /// Removes the write permission of the mappings of the children in the given range, so
+    /// that the child page tables can be shared with another page table.
+    ///
+    /// Shared child page tables are skipped, since they are always write-protected.
+    pub(super) fn protect_for_sharing(&mut self, idx_range: Range<usize>) {
+        for i in idx_range {
+            let pte = self.read_pte(i);
+            if !pte.is_present() {
+                continue;
+            }
+
+            if pte.is_last(self.level()) {
+                let mut prop = pte.prop();
+                if prop.flags.contains(PageFlags::W) {
+                    prop.flags -= PageFlags::W;
+                    self.protect(i, prop);
+                }
+                continue;
+            }
+
+            let Child::PageTable(pt) = self.child(i, true) else {
+                unreachable!();
+            };
+            let mut child = pt.lock();
+            if !child.is_shared() {
+                child.protect_for_sharing(0..nr_subpage_per_huge::<C>());
+            }
+        }
     }
 
     /// Removes a child if the child at the given index is present.
@@ -388,6 +440,26 @@ where
         self.overwrite_pte(idx, pte, true);
     }
 
+    /// Maps a tracked huge page at a given index.
+    ///
+    /// A tracked huge page is mapped by a single PTE, but the PTE holds a reference to
+    /// each of its base pages, so that the huge page can be split into smaller pages.
+    ///
+    /// # Safety
+    ///
+    /// The caller must ensure that `pa` is aligned to the page size of this level and
+    /// that the ownership of a reference to each of the base pages starting at `pa` is
+    /// transferred to this function.
+    pub(super) unsafe fn set_child_huge(&mut self, idx: usize, pa: Paddr, prop: PageProperty) {
+        // They should be ensured by the cursor.
+        debug_assert!(idx < nr_subpage_per_huge::<C>());
+        debug_assert!(self.level() > 1);
+        debug_assert_eq!(pa % page_size::<C>(self.level()), 0);
+
+        let pte = Some(E::new_page(pa, self.level(), prop));
+        self.overwrite_pte(idx, pte, true);
+    }
+
     /// Sets an untracked child page at a given index.
     ///
     /// # Safety
@@ -428,6 +500,39 @@ where
         self.set_child_pt(idx, new_page.into_raw(), false);
     }
 
+    /// Splits the tracked huge page mapped at `idx` to smaller pages.
+    pub(super) fn split_tracked_huge(&mut self, idx: usize) {
+        // These should be ensured by the cursor.
+        debug_assert!(idx < nr_subpage_per_huge::<C>());
+        debug_assert!(self.level() > 1);
+
+        let Child::Page(page) = self.child(idx, true) else {
+            panic!("`split_tracked_huge` not called on a tracked huge page");
+        };
+        let pa = page.paddr();
+        let prop = self.read_pte_prop(idx);
+
+        let small_level = self.level() - 1;
+        let mut new_page = PageTableNode::<E, C>::alloc(small_level);
+        for i in 0..nr_subpage_per_huge::<C>() {
+            let small_pa = pa + i * page_size::<C>(small_level);
+            // SAFETY: The smaller pages are parts of the huge page, whose base pages are
+            // kept alive by the PTE. The extra references are transferred to the new PTEs.
+            unsafe {
+                inc_tracked_pages_ref::<C>(small_pa, small_level);
+                if small_level > 1 {
+                    new_page.set_child_huge(i, small_pa, prop);
+                } else {
+                    new_page.set_child_page(i, DynPage::from_raw(small_pa), prop);
+                }
+            }
+        }
+
+        // The references held by the huge page are dropped when its PTE is overwritten.
+        self.set_child_pt(idx, new_page.into_raw(), true);
+        drop(page);
+    }
+
     /// Protects an already mapped child at a given index.
     pub(super) fn protect(&mut self, idx: usize, prop: PageProperty) {
         let mut pte = self.read_pte(idx);
@@ -484,8 +589,8 @@ where
                     // This is a page table.
                     drop(Page::<PageTablePageMeta<E, C>>::from_raw(paddr));
                 } else if in_tracked_range {
-                    // This is a frame.
-                    drop(DynPage::from_raw(paddr));
+                    // This is a frame, or a huge page made up of frames.
+                    drop_tracked_pages::<C>(paddr, self.level());
                 }
             }
 
@@ -545,11 +650,35 @@ where
                 } else {
                     // This is a page. You cannot drop a page table node that maps to
                     // untracked pages. This must be verified.
-                    // SAFETY: The physical address must be casted from a handle to a
-                    // page.
-                    drop(unsafe { DynPage::from_raw(pte.paddr()) });
+                    // SAFETY: The physical address must be casted from handles to the
+                    // base pages of the page.
+                    unsafe { drop_tracked_pages::<C>(pte.paddr(), level) };
                 }
             }
         }
     }
 }
+
+/// Gets an extra reference to each base page of the tracked page at the given level.
+///
+/// # Safety
+///
+/// The caller must ensure that the base pages are alive, e.g., they are mapped by a PTE.
+unsafe fn inc_tracked_pages_ref<C: PagingConstsTrait>(paddr: Paddr, level: PagingLevel) {
+    for i in 0..nr_base_per_page::<C>(level) {
+        let page = ManuallyDrop::new(DynPage::from_raw(paddr + i * C::BASE_PAGE_SIZE));
+        core::mem::forget((*page).clone());
+    }
+}
+
+/// Drops a reference to each base page of the tracked page at the given level.
+///
+/// # Safety
+///
+/// The caller must ensure that the references are owned by the caller, e.g., they are
+/// held by a PTE that has been overwritten.
+unsafe fn drop_tracked_pages<C: PagingConstsTrait>(paddr: Paddr, level: PagingLevel) {
+    for i in 0..nr_base_per_page::<C>(level) {
+        drop(DynPage::from_raw(paddr + i * C::BASE_PAGE_SIZE));
+    }
+}
@@ -6,7 +6,7 @@ use super::*;
 use crate::{
     mm::{
         kspace::LINEAR_MAPPING_BASE_VADDR,
-        page::{allocator, meta::FrameMeta},
+        page::{allocator, meta::FrameMeta, Page},
         page_prop::{CachePolicy, PageFlags},
     },
     prelude::*,
@@ -114,6 +114,70 @@ fn test_user_copy_on_write() {
     assert!(child_pt.query(from.start + 10).is_none());
 }
 
+#[ktest]
+fn test_user_copy_on_write_page_table() {
+    let pt = PageTable::<UserMode>::empty();
+    let from = PAGE_SIZE..PAGE_SIZE * 2;
+    let page = allocator::alloc_single::<FrameMeta>().unwrap();
+    let prop = PageProperty::new(PageFlags::RW, CachePolicy::Writeback);
+    unsafe { pt.cursor_mut(&from).unwrap().map(page.clone().into(), prop) };
+    assert_eq!(page.reference_count(), 2);
+
+    // The page table nodes are shared, so the page is not referenced again.
+    let child_pt = pt.fork_copy_on_write();
+    assert_eq!(page.reference_count(), 2);
+    assert_eq!(pt.query(from.start).unwrap().1.flags, PageFlags::R);
+    assert_eq!(child_pt.query(from.start).unwrap().1.flags, PageFlags::R);
+
+    // Modifying the parent page table copies the shared nodes.
+    unsafe { pt.protect(&from, |p| p.flags |= PageFlags::W).unwrap() };
+    assert_eq!(page.reference_count(), 3);
+    assert_eq!(pt.query(from.start).unwrap().1.flags, PageFlags::RW);
+    assert_eq!(child_pt.query(from.start).unwrap().1.flags, PageFlags::R);
+
+    // The child page table no longer shares the nodes, so they are not copied again.
+    unsafe { child_pt.unmap(&from).unwrap() };
+    assert_eq!(page.reference_count(), 2);
+    assert!(child_pt.query(from.start).is_none());
+    assert_eq!(pt.query(from.start).unwrap().1.flags, PageFlags::RW);
+}
+
+#[ktest]
+fn test_tracked_huge_map_split() {
+    let pt = PageTable::<UserMode>::empty();
+    const HUGE_PAGE_SIZE: usize = PAGE_SIZE * 512;
+
+    let from = HUGE_PAGE_SIZE..HUGE_PAGE_SIZE * 2;
+    let pages = allocator::alloc_contiguous::<FrameMeta>(HUGE_PAGE_SIZE).unwrap();
+    let start_paddr = pages.start_paddr();
+    assert_eq!(start_paddr % HUGE_PAGE_SIZE, 0);
+    let pages: Vec<Page<FrameMeta>> = pages.into();
+    for page in pages.iter() {
+        core::mem::forget(page.clone());
+    }
+    let prop = PageProperty::new(PageFlags::RW, CachePolicy::Writeback);
+    unsafe { pt.cursor_mut(&from).unwrap().map_huge(start_paddr, 2, prop) };
+    assert_eq!(
+        pt.query(from.start + PAGE_SIZE * 3 + 10).unwrap().0,
+        start_paddr + PAGE_SIZE * 3 + 10
+    );
+    assert!(pages.iter().all(|page| page.reference_count() == 2));
+
+    // Protecting or unmapping a part of the huge page splits it.
+    let prot = from.start + PAGE_SIZE..from.start + PAGE_SIZE * 2;
+    unsafe { pt.protect(&prot, |p| p.flags -= PageFlags::W).unwrap() };
+    assert_eq!(pt.query(prot.start).unwrap().1.flags, PageFlags::R);
+    assert_eq!(pt.query(from.start).unwrap().1.flags, PageFlags::RW);
+    let unmap = from.start..from.start + PAGE_SIZE;
+    unsafe { pt.unmap(&unmap).unwrap() };
+    assert!(pt.query(unmap.start).is_none());
+    assert_eq!(pages[0].reference_count(), 1);
+    assert_eq!(pages[1].reference_count(), 2);
+
+    unsafe { pt.unmap(&from).unwrap() };
+    assert!(pages.iter().all(|page| page.reference_count() == 1));
+}
+
 type Qr = PageTableQueryResult;
 
 #[derive(Clone, Debug, Default)]
@@ -2,6 +2,7 @@
 
 use core::ops::Range;
 
+use pod::Pod;
 use spin::Once;
 
 use super::{
@@ -9,16 +10,15 @@ use super::{
     is_page_aligned,
     kspace::KERNEL_PAGE_TABLE,
     page_table::{PageTable, PageTableMode, UserMode},
+    tlb::{TlbFlusher, TlbState},
     CachePolicy, FrameVec, PageFlags, PageProperty, PagingConstsTrait, PrivilegedPageFlags,
-    VmReader, VmWriter, PAGE_SIZE,
+    VmReader, VmWriter, HUGE_PAGE_LEVEL, HUGE_PAGE_SIZE, PAGE_SIZE,
 };
 use crate::{
-    arch::mm::{
-        current_page_table_paddr, tlb_flush_addr_range, tlb_flush_all_excluding_global,
-        PageTableEntry, PagingConsts,
-    },
+    arch::mm::{current_page_table_paddr, PageTableEntry, PagingConsts},
     cpu::CpuExceptionInfo,
     mm::{
+        paddr_to_vaddr,
         page_table::{Cursor, PageTableQueryResult as PtQr},
         Frame, MAX_USERSPACE_VADDR,
     },
@@ -46,30 +46,40 @@ use crate::{
 #[allow(clippy::type_complexity)]
 pub struct VmSpace {
     pt: PageTable<UserMode>,
+    tlb: TlbState,
     page_fault_handler: Once<fn(&VmSpace, &CpuExceptionInfo) -> core::result::Result<(), ()>>,
 }
 
 // Notes on TLB flushing:
 //
-// We currently assume that:
-// 1. `VmSpace` _might_ be activated on the current CPU and the user memory _might_ be used
-//    immediately after we make changes to the page table entries. So we must invalidate the
-//    corresponding TLB caches accordingly.
-// 2. `VmSpace` must _not_ be activated on another CPU. This assumption is trivial, since SMP
-//    support is not yet available. But we need to consider this situation in the future (TODO).
+// Each change to the page table entries is followed by a flush through a `TlbFlusher`. If the
+// `VmSpace` is activated on the current CPU, the TLB entries are invalidated immediately, since
+// the user memory _might_ be used right after the change. The other CPUs that have activated the
+// `VmSpace` flush its TLB entries the next time they activate it. This is enough as long as the
+// `VmSpace` cannot be running on another CPU; see the limitation in the `tlb` module.
 
 impl VmSpace {
     /// Creates a new VM address space.
     pub fn new() -> Self {
         Self {
             pt: KERNEL_PAGE_TABLE.get().unwrap().create_user_page_table(),
+            tlb: TlbState::new(),
             page_fault_handler: Once::new(),
         }
     }
 
     /// Activates the page table.
     pub(crate) fn activate(&self) {
-        self.pt.activate();
+        self.tlb.activate(|pcid, need_flush| {
+            // SAFETY: The TLB state tells whether the TLB entries tagged with the PCID are stale.
+            unsafe { self.pt.activate(pcid, need_flush) };
+        });
+    }
+
+    fn tlb_flusher(&self) -> TlbFlusher<'_> {
+        // SAFETY: The physical address of the root page table is only used for comparison.
+        let root_paddr = unsafe { self.pt.root_paddr() };
+        self.tlb.flusher(root_paddr)
     }
 
     pub(crate) fn handle_page_fault(
@@ -144,7 +154,133 @@ impl VmSpace {
         }
 
         drop(cursor);
-        tlb_flush_addr_range(&va_range);
+        let mut flusher = self.tlb_flusher();
+        flusher.flush_range(va_range);
+        flusher.dispatch();
+
+        Ok(addr)
+    }
+
+    /// Maps physical memory pages to the given page-aligned addresses in the VM space
+    /// with a single walk of the page table.
+    ///
+    /// Unlike [`map`], the pages do not need to be virtually contiguous. The addresses
+    /// must be in ascending order and within `range`, so the address and the alignment
+    /// in `options` are ignored. If overwriting is forbidden, the addresses that are
+    /// already mapped are skipped, and their frames are dropped.
+    ///
+    /// The ownership of the mapped frames will be transferred to the `VmSpace`.
+    ///
+    /// [`map`]: Self::map
+    pub fn map_pages(
+        &self,
+        range: &Range<Vaddr>,
+        pages: impl IntoIterator<Item = (Vaddr, Frame)>,
+        options: &VmMapOptions,
+    ) -> Result<()> {
+        if !is_page_aligned(range.start) || !is_page_aligned(range.end) {
+            return Err(Error::InvalidArgs);
+        }
+        if !UserMode::covers(range) {
+            return Err(Error::InvalidArgs);
+        }
+
+        let mut cursor = self.pt.cursor_mut(range)?;
+        let prop = PageProperty {
+            flags: options.flags,
+            cache: CachePolicy::Writeback,
+            priv_flags: PrivilegedPageFlags::USER,
+        };
+
+        let mut last_end = range.start;
+        for (addr, frame) in pages {
+            if !is_page_aligned(addr) || addr < last_end || addr >= range.end {
+                return Err(Error::InvalidArgs);
+            }
+            last_end = addr + PAGE_SIZE;
+
+            cursor.jump(addr);
+            if !options.can_overwrite && matches!(cursor.query(), Some(PtQr::Mapped { .. })) {
+                continue;
+            }
+            // SAFETY: mapping in the user space with `Frame` is safe.
+            unsafe {
+                cursor.map(frame.into(), prop);
+            }
+        }
+
+        drop(cursor);
+        let mut flusher = self.tlb_flusher();
+        flusher.flush_range(range.clone());
+        flusher.dispatch();
+
+        Ok(())
+    }
+
+    /// Maps physical memory pages into the VM space as a huge page according to
+    /// the given options, returning the address where the mapping is created.
+    ///
+    /// The frames must be physically contiguous and make up a huge page of
+    /// [`HUGE_PAGE_SIZE`] bytes. Both the physical address of the frames and the
+    /// address of the mapping must be aligned to [`HUGE_PAGE_SIZE`]. If overwriting
+    /// is allowed, existing mappings of smaller pages in the range are collapsed
+    /// into the huge page.
+    ///
+    /// The ownership of the frames will be transferred to the `VmSpace`.
+    pub fn map_huge(&self, frames: FrameVec, options: &VmMapOptions) -> Result<Vaddr> {
+        let Some(addr) = options.addr else {
+            return Err(Error::InvalidArgs);
+        };
+
+        let start_paddr = frames.get(0).ok_or(Error::InvalidArgs)?.start_paddr();
+        let is_huge_page = frames.nbytes() == HUGE_PAGE_SIZE
+            && start_paddr % HUGE_PAGE_SIZE == 0
+            && frames
+                .iter()
+                .enumerate()
+                .all(|(i, frame)| frame.start_paddr() == start_paddr + i * PAGE_SIZE);
+        if !is_huge_page || addr % HUGE_PAGE_SIZE != 0 {
+            return Err(Error::InvalidArgs);
+        }
+
+        let end = addr.checked_add(HUGE_PAGE_SIZE).ok_or(Error::InvalidArgs)?;
+        let va_range = addr..end;
+        if !UserMode::covers(&va_range) {
+            return Err(Error::InvalidArgs);
+        }
+
+        let mut cursor = self.pt.cursor_mut(&va_range)?;
+
+        // If overwrite is forbidden, we should check if there are existing mappings
+        if !options.can_overwrite {
+            while let Some(qr) = cursor.next() {
+                if matches!(qr, PtQr::Mapped { .. }) {
+                    return Err(Error::MapAlreadyMappedVaddr);
+                }
+            }
+            cursor.jump(va_range.start);
+        }
+
+        let prop = PageProperty {
+            flags: options.flags,
+            cache: CachePolicy::Writeback,
+            priv_flags: PrivilegedPageFlags::USER,
+        };
+
+        // The references to the frames are held by the huge page from now on.
+        for frame in frames.into_iter() {
+            core::mem::forget(frame);
+        }
+        // SAFETY: mapping in the user space with `Frame`s is safe, and the references
+        // to the frames are transferred to the page table.
+        unsafe {
+            cursor.map_huge(start_paddr, HUGE_PAGE_LEVEL, prop);
+        }
+
+        drop(cursor);
+        let mut flusher = self.tlb_flusher();
+        flusher.flush_range(va_range);
+        flusher.dispatch();
 
         Ok(addr)
     }
@@ -186,7 +322,9 @@ impl VmSpace {
         unsafe {
             self.pt.unmap(range)?;
         }
-        tlb_flush_addr_range(range);
+        let mut flusher = self.tlb_flusher();
+        flusher.flush_range(range.clone());
+        flusher.dispatch();
 
         Ok(())
     }
@@ -198,7 +336,9 @@ impl VmSpace {
         unsafe {
             self.pt.unmap(&(0..MAX_USERSPACE_VADDR)).unwrap();
         }
-        tlb_flush_all_excluding_global();
+        let mut flusher = self.tlb_flusher();
+        flusher.flush_all();
+        flusher.dispatch();
     }
 
     /// Updates the VM protection permissions within the VM address range.
@@ -225,7 +365,9 @@ impl VmSpace {
         unsafe {
             self.pt.protect(range, op)?;
         }
-        tlb_flush_addr_range(range);
+        let mut flusher = self.tlb_flusher();
+        flusher.flush_range(range.clone());
+        flusher.dispatch();
 
         Ok(())
     }
@@ -234,7 +376,8 @@ impl VmSpace {
     ///
     /// Both the parent and the newly forked VM space will be marked as
     /// read-only. And both the VM space will take handles to the same
-    /// physical memory pages.
+    /// physical memory pages. The page table pages are shared as well, until
+    /// either VM space modifies the mappings in them.
     pub fn fork_copy_on_write(&self) -> Self {
         let page_fault_handler = {
             let new_handler = Once::new();
@@ -245,9 +388,13 @@ impl VmSpace {
         };
         let new_space = Self {
             pt: self.pt.fork_copy_on_write(),
+            tlb: TlbState::new(),
             page_fault_handler,
         };
-        tlb_flush_all_excluding_global();
+        // The mappings of the current VM space have been made read-only.
+        let mut flusher = self.tlb_flusher();
+        flusher.flush_all();
+        flusher.dispatch();
         new_space
     }
 
@@ -292,6 +439,32 @@ impl VmSpace {
         // is activated during the usage period of the `VmWriter`.
         Ok(unsafe { VmWriter::<UserSpace>::from_user_space(vaddr as *mut u8, len) })
     }
+
+    /// Reads a value of `Pod` type from the user space without triggering page faults.
+    ///
+    /// The page table is walked by software and the value is read through the linear
+    /// mapping, so this method can be used where page faults cannot be handled, e.g.,
+    /// in the interrupt context. The value must not cross a page boundary.
+    ///
+    /// Returns `None` if the page is not mapped as readable by the user.
+    pub fn read_val_nofault<T: Pod>(&self, vaddr: Vaddr) -> Option<T> {
+        let size = core::mem::size_of::<T>();
+        if vaddr.checked_add(size)? > MAX_USERSPACE_VADDR
+            || vaddr / PAGE_SIZE != (vaddr + size - 1) / PAGE_SIZE
+        {
+            return None;
+        }
+
+        let (paddr, prop) = self.pt.query(vaddr)?;
+        if !prop.priv_flags.contains(PrivilegedPageFlags::USER)
+            || !prop.flags.contains(PageFlags::R)
+        {
+            return None;
+        }
+        // SAFETY: The physical memory is always mapped in the linear mapping, so reading it
+        // is memory-safe even if the page is concurrently unmapped and reused.
+        Some(unsafe { core::ptr::read_unaligned(paddr_to_vaddr(paddr) as *const T) })
+    }
 }
 
 impl Default for VmSpace {
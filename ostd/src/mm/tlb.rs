@@ -0,0 +1,220 @@
+// SPDX-License-Identifier: MPL-2.0
+
+//! TLB coherence of the VM spaces.
+//!
+//! Each VM space is tagged with its own PCID, so switching between the VM spaces
+//! keeps their TLB entries. As a result, the TLB entries of a VM space may be cached
+//! by a CPU even if the VM space is not activated on that CPU. Instead of flushing
+//! such entries immediately, the CPU is marked as stale and flushes them when the VM
+//! space is activated on the CPU next time.
+//!
+//! # Limitation
+//!
+//! There is no TLB shootdown by IPIs. Only the bootstrap processor is started, so no
+//! other CPU can be running a VM space when its TLB entries are flushed, and marking
+//! the other CPUs as stale is enough. Once the application processors are started,
+//! [`TlbFlusher::dispatch`] must also interrupt the CPUs that are running the VM space
+//! and wait for them to flush the TLB entries, before the frames can be reused.
+
+use core::ops::Range;
+
+use id_alloc::IdAlloc;
+use spin::Once;
+
+use super::{Paddr, Vaddr, PAGE_SIZE};
+use crate::{
+    arch::mm::{
+        current_page_table_paddr, tlb_flush_addr_range, tlb_flush_all_excluding_global, Pcid,
+        NR_PCIDS,
+    },
+    cpu::{num_cpus, this_cpu, CpuSet},
+    sync::SpinLock,
+};
+
+/// The maximum number of pages that are flushed one by one.
+///
+/// Flushing more pages one by one costs more than flushing and then refilling the
+/// whole TLB of the VM space.
+const MAX_NR_PAGES_TO_FLUSH: usize = 32;
+
+/// The maximum number of ranges collected by a [`TlbFlusher`] before it decides to
+/// flush all the TLB entries of the VM space.
+const MAX_NR_RANGES: usize = 8;
+
+/// The PCID shared by the VM spaces without their own PCIDs, whose TLB entries are
+/// always flushed on activation.
+const SHARED_PCID: Pcid = 0;
+
+static PCID_ALLOCATOR: Once<SpinLock<IdAlloc>> = Once::new();
+
+fn pcid_allocator() -> &'static SpinLock<IdAlloc> {
+    PCID_ALLOCATOR.call_once(|| {
+        let mut id_alloc = IdAlloc::with_capacity(NR_PCIDS);
+        id_alloc.alloc_specific(SHARED_PCID as usize).unwrap();
+        SpinLock::new(id_alloc)
+    })
+}
+
+/// The TLB state of a VM space.
+pub(super) struct TlbState {
+    pcid: Pcid,
+    cpus: SpinLock<TlbCpus>,
+}
+
+struct TlbCpus {
+    /// The CPUs that have activated the VM space, which may cache its TLB entries.
+    activated: CpuSet,
+    /// The CPUs that must flush the TLB entries of the VM space on activation.
+    stale: CpuSet,
+}
+
+/// A batch of TLB flushes of a VM space.
+///
+/// The flushes are not performed until [`TlbFlusher::dispatch`] is called, so
+/// that changing many pages costs at most one flush of the whole TLB.
+pub(super) struct TlbFlusher<'a> {
+    state: &'a TlbState,
+    root_paddr: Paddr,
+    ranges: [Range<Vaddr>; MAX_NR_RANGES],
+    nr_ranges: usize,
+    nr_pages: usize,
+    flush_all: bool,
+}
+
+impl TlbState {
+    pub(super) fn new() -> Self {
+        let pcid = pcid_allocator()
+            .lock_irq_disabled()
+            .alloc()
+            .map_or(SHARED_PCID, |pcid| pcid as Pcid);
+        Self {
+            pcid,
+            cpus: SpinLock::new(TlbCpus {
+                activated: CpuSet::new_empty(),
+                // The PCID may be used by a dropped VM space before, so its TLB entries
+                // may be stale on any CPU.
+                stale: CpuSet::new_full(),
+            }),
+        }
+    }
+
+    /// Activates the VM space on the current CPU with `activate`.
+    ///
+    /// The closure receives the PCID and whether the TLB entries tagged with the
+    /// PCID must be flushed.
+    pub(super) fn activate(&self, activate: impl FnOnce(Pcid, bool)) {
+        let cpu = this_cpu();
+        let mut cpus = self.cpus.lock_irq_disabled();
+        cpus.activated.add(cpu);
+        let need_flush = cpus.stale.contains(cpu) || self.pcid == SHARED_PCID;
+        cpus.stale.remove(cpu);
+        // The page table is activated with the lock held, so no flush can be missed.
+        activate(self.pcid, need_flush);
+    }
+
+    /// Creates a batch of TLB flushes of the VM space whose root page table is at `root_paddr`.
+    pub(super) fn flusher(&self, root_paddr: Paddr) -> TlbFlusher<'_> {
+        TlbFlusher {
+            state: self,
+            root_paddr,
+            ranges: core::array::from_fn(|_| 0..0),
+            nr_ranges: 0,
+            nr_pages: 0,
+            flush_all: false,
+        }
+    }
+}
+
+impl Drop for TlbState {
+    fn drop(&mut self) {
+        if self.pcid != SHARED_PCID {
+            pcid_allocator()
+                .lock_irq_disabled()
+                .free(self.pcid as usize);
+        }
+    }
+}
+
+impl<'a> TlbFlusher<'a> {
+    /// Adds the TLB entries of a page-aligned range to be flushed.
+    pub(super) fn flush_range(&mut self, range: Range<Vaddr>) {
+        if self.flush_all {
+            return;
+        }
+        self.nr_pages += range.len() / PAGE_SIZE;
+        if self.nr_ranges == MAX_NR_RANGES || self.nr_pages > MAX_NR_PAGES_TO_FLUSH {
+            self.flush_all = true;
+            return;
+        }
+        self.ranges[self.nr_ranges] = range;
+        self.nr_ranges += 1;
+    }
+
+    /// Adds all the TLB entries of the VM space to be flushed.
+    pub(super) fn flush_all(&mut self) {
+        self.flush_all = true;
+    }
+
+    /// Performs the flushes.
+    ///
+    /// The flushes are done immediately on the current CPU if the VM space is activated
+    /// on it. The other CPUs that may cache the TLB entries are marked as stale.
+    ///
+    /// No IPIs are sent, which is correct only because no other CPUs are started. See
+    /// the [module-level documentation](self) for details.
+    pub(super) fn dispatch(self) {
+        // Remember to add the TLB shootdown when the application processors are started.
+        debug_assert_eq!(num_cpus(), 1);
+
+        if !self.flush_all && self.nr_ranges == 0 {
+            return;
+        }
+
+        let cpu = this_cpu();
+        let mut cpus = self.state.cpus.lock_irq_disabled();
+        let TlbCpus { activated, stale } = &mut *cpus;
+        for other_cpu in activated.iter() {
+            // No other CPUs are started, so none of them is running the VM space. They
+            // flush the TLB entries when they activate the VM space next time.
+            stale.add(other_cpu as u32);
+        }
+
+        // The lock disables the preemption, so the VM space cannot be switched out meanwhile.
+        if current_page_table_paddr() != self.root_paddr {
+            return;
+        }
+        stale.remove(cpu);
+        if self.flush_all {
+            tlb_flush_all_excluding_global();
+        } else {
+            for range in &self.ranges[..self.nr_ranges] {
+                tlb_flush_addr_range(range);
+            }
+        }
+    }
+}
+
+#[cfg(ktest)]
+mod test {
+    use super::*;
+    use crate::prelude::*;
+
+    fn activate_and_check_flush(state: &TlbState) -> bool {
+        let mut need_flush = None;
+        state.activate(|_pcid, flush| need_flush = Some(flush));
+        need_flush.unwrap()
+    }
+
+    #[ktest]
+    fn stale_tlb_flushed_on_activation() {
+        let state = TlbState::new();
+        assert!(activate_and_check_flush(&state));
+        assert_eq!(activate_and_check_flush(&state), state.pcid == SHARED_PCID);
+
+        // The VM space is not activated, so the flush is deferred.
+        let mut flusher = state.flusher(0);
+        flusher.flush_range(0..PAGE_SIZE);
+        flusher.dispatch();
+        assert!(activate_and_check_flush(&state));
+    }
+}
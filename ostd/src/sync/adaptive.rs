@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: MPL-2.0
+
+//! Adaptive spinning for the sleeping locks.
+//!
+//! A sleeping lock is usually held for a short time. If the owner of the lock
+//! keeps running on another CPU, it is likely to release the lock soon, so a
+//! waiter spins for a while before going to sleep instead of paying for a
+//! round trip of sleeping and waking up.
+
+use core::sync::atomic::{AtomicU64, Ordering};
+
+use crate::{cpu::this_cpu, task::nr_context_switches};
+
+/// The owner of a sleeping lock.
+///
+/// The owner is identified by the CPU it runs on and the number of context
+/// switches that have occurred on the CPU when the lock is acquired. So the
+/// owner is still running if the number stays the same.
+pub(super) struct LockOwner {
+    /// The ID of the CPU in the bits above [`NR_SWITCHES_BITS`], and the
+    /// number of context switches in the low bits.
+    cpu_and_nr_switches: AtomicU64,
+}
+
+const NR_SWITCHES_BITS: u32 = 48;
+const NR_SWITCHES_MASK: u64 = (1 << NR_SWITCHES_BITS) - 1;
+const NO_OWNER: u64 = u64::MAX;
+
+/// The maximum number of times to check the lock before going to sleep.
+const MAX_SPINS: usize = 1 << 10;
+
+impl LockOwner {
+    pub(super) const fn new() -> Self {
+        Self {
+            cpu_and_nr_switches: AtomicU64::new(NO_OWNER),
+        }
+    }
+
+    /// Records the current task as the owner.
+    pub(super) fn set(&self) {
+        let cpu = this_cpu();
+        let owner = ((cpu as u64) << NR_SWITCHES_BITS)
+            | (nr_context_switches(cpu) as u64 & NR_SWITCHES_MASK);
+        self.cpu_and_nr_switches.store(owner, Ordering::Relaxed);
+    }
+
+    /// Clears the owner before the lock is released.
+    pub(super) fn clear(&self) {
+        self.cpu_and_nr_switches.store(NO_OWNER, Ordering::Relaxed);
+    }
+
+    /// Returns whether the owner is running on a CPU other than the current one.
+    ///
+    /// Spinning is worthless if the owner is not running, since the owner
+    /// cannot release the lock until it is scheduled again.
+    fn is_running_elsewhere(&self) -> bool {
+        let owner = self.cpu_and_nr_switches.load(Ordering::Relaxed);
+        if owner == NO_OWNER {
+            return false;
+        }
+        let cpu = (owner >> NR_SWITCHES_BITS) as u32;
+        cpu != this_cpu()
+            && nr_context_switches(cpu) as u64 & NR_SWITCHES_MASK == owner & NR_SWITCHES_MASK
+    }
+}
+
+/// Spins until the condition returns `Some(_)`, as long as the owner is running.
+///
+/// Returns `None` if the owner is not running or the spinning takes too long,
+/// in which case the caller should go to sleep.
+pub(super) fn spin_until<F, R>(owner: &LockOwner, mut cond: F) -> Option<R>
+where
+    F: FnMut() -> Option<R>,
+{
+    for _ in 0..MAX_SPINS {
+        if let Some(res) = cond() {
+            return Some(res);
+        }
+        if !owner.is_running_elsewhere() {
+            return None;
+        }
+        core::hint::spin_loop();
+    }
+    None
+}
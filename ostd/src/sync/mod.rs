@@ -2,20 +2,24 @@
 
 //! Useful synchronization primitives.
 
+mod adaptive;
 mod atomic_bits;
 mod mutex;
-// TODO: refactor this rcu implementation
-// Comment out this module since it raises lint error
-// mod rcu;
+mod rcu;
 mod rwlock;
 mod rwmutex;
 mod spin;
 mod wait;
 
-// pub use self::rcu::{pass_quiescent_state, OwnerPtr, Rcu, RcuReadGuard, RcuReclaimer};
+pub(crate) use self::rcu::init as init_rcu;
 pub use self::{
     atomic_bits::AtomicBits,
     mutex::{ArcMutexGuard, Mutex, MutexGuard},
+    rcu::{
+        enable_softirq as enable_rcu_softirq, pass_quiescent_state, stats as rcu_stats,
+        synchronize as synchronize_rcu, NonNullPtr, OwnerPtr, Rcu, RcuReadGuard, RcuReclaimer,
+        RcuStats,
+    },
     rwlock::{
         ArcRwLockReadGuard, ArcRwLockUpgradeableGuard, ArcRwLockWriteGuard, RwLock,
         RwLockReadGuard, RwLockUpgradeableGuard, RwLockWriteGuard,
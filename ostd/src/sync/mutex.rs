@@ -5,23 +5,45 @@ use core::{
     cell::UnsafeCell,
     fmt,
     ops::{Deref, DerefMut},
-    sync::atomic::{AtomicBool, Ordering},
+    sync::atomic::{AtomicU32, Ordering},
 };
 
-use super::WaitQueue;
+use super::{
+    adaptive::{spin_until, LockOwner},
+    WaitQueue,
+};
 
 /// A mutex with waitqueue.
+///
+/// A contended mutex first spins as long as its owner is running on another CPU,
+/// then sleeps on the wait queue. A waiter that has failed to acquire the mutex
+/// several times after being woken up requests a _handoff_, i.e., the owner hands
+/// the mutex over to a waiter on unlocking, so that the waiters are not starved
+/// by the new comers.
 pub struct Mutex<T: ?Sized> {
-    lock: AtomicBool,
+    /// The internal state of the mutex as follows:
+    /// - [`LOCKED`]: The mutex is held.
+    /// - [`HANDOFF_REQUESTED`]: A waiter requests a handoff on the next unlock.
+    /// - [`HANDED_OFF`]: The mutex is handed off and is to be taken by a waiter.
+    state: AtomicU32,
+    owner: LockOwner,
     queue: WaitQueue,
     val: UnsafeCell<T>,
 }
 
+const LOCKED: u32 = 1 << 0;
+const HANDOFF_REQUESTED: u32 = 1 << 1;
+const HANDED_OFF: u32 = 1 << 2;
+
+/// The number of failed attempts of a waiter before it requests a handoff.
+const HANDOFF_THRESHOLD: usize = 4;
+
 impl<T> Mutex<T> {
     /// Creates a new mutex.
     pub const fn new(val: T) -> Self {
         Self {
-            lock: AtomicBool::new(false),
+            state: AtomicU32::new(0),
+            owner: LockOwner::new(),
             queue: WaitQueue::new(),
             val: UnsafeCell::new(val),
         }
@@ -33,7 +55,8 @@ impl<T: ?Sized> Mutex<T> {
     ///
     /// This method runs in a block way until the mutex can be acquired.
     pub fn lock(&self) -> MutexGuard<T> {
-        self.queue.wait_until(|| self.try_lock())
+        self.lock_slow();
+        MutexGuard { mutex: self }
     }
 
     /// Acquires the mutex through an [`Arc`].
@@ -43,7 +66,10 @@ impl<T: ?Sized> Mutex<T> {
     ///
     /// [`lock`]: Self::lock
     pub fn lock_arc(self: &Arc<Self>) -> ArcMutexGuard<T> {
-        self.queue.wait_until(|| self.try_lock_arc())
+        self.lock_slow();
+        ArcMutexGuard {
+            mutex: self.clone(),
+        }
     }
 
     /// Tries Acquire the mutex immedidately.
@@ -66,19 +92,93 @@ impl<T: ?Sized> Mutex<T> {
     }
 
     /// Releases the mutex and wake up one thread which is blocked on this mutex.
+    ///
+    /// If a handoff is requested, the mutex is kept locked for the woken waiter.
     fn unlock(&self) {
-        self.release_lock();
+        self.owner.clear();
+
+        let mut state = self.state.load(Ordering::Relaxed);
+        loop {
+            let new_state = if state & HANDOFF_REQUESTED != 0 {
+                LOCKED | HANDED_OFF
+            } else {
+                0
+            };
+            match self.state.compare_exchange_weak(
+                state,
+                new_state,
+                Ordering::Release,
+                Ordering::Relaxed,
+            ) {
+                Ok(_) => break,
+                Err(current) => state = current,
+            }
+        }
+
         self.queue.wake_one();
     }
 
+    /// Acquires the mutex by spinning, and then by sleeping.
+    fn lock_slow(&self) {
+        if self.acquire_lock() {
+            return;
+        }
+        if spin_until(&self.owner, || self.acquire_lock().then_some(())).is_some() {
+            return;
+        }
+
+        let mut nr_failures = 0;
+        self.queue.wait_until(|| {
+            if self.acquire_lock() || self.take_handoff() {
+                return Some(());
+            }
+            nr_failures += 1;
+            if nr_failures >= HANDOFF_THRESHOLD {
+                self.request_handoff();
+            }
+            None
+        });
+    }
+
     fn acquire_lock(&self) -> bool {
-        self.lock
-            .compare_exchange(false, true, Ordering::Acquire, Ordering::Relaxed)
-            .is_ok()
+        let acquired = self
+            .state
+            .compare_exchange(0, LOCKED, Ordering::Acquire, Ordering::Relaxed)
+            .is_ok();
+        if acquired {
+            self.owner.set();
+        }
+        acquired
     }
 
-    fn release_lock(&self) {
-        self.lock.store(false, Ordering::Release);
+    /// Takes the mutex handed off by the previous owner.
+    fn take_handoff(&self) -> bool {
+        let taken = self
+            .state
+            .compare_exchange(
+                LOCKED | HANDED_OFF,
+                LOCKED,
+                Ordering::Acquire,
+                Ordering::Relaxed,
+            )
+            .is_ok();
+        if taken {
+            self.owner.set();
+        }
+        taken
+    }
+
+    /// Requests the owner to hand off the mutex on unlocking.
+    ///
+    /// The request is ignored if the mutex is not held, since the waiter has
+    /// been enqueued and will be woken up to try again.
+    fn request_handoff(&self) {
+        let _ = self
+            .state
+            .fetch_update(Ordering::Relaxed, Ordering::Relaxed, |state| {
+                (state & LOCKED != 0 && state & HANDED_OFF == 0)
+                    .then_some(state | HANDOFF_REQUESTED)
+            });
     }
 }
 
@@ -1,29 +1,55 @@
 // SPDX-License-Identifier: MPL-2.0
 
 //! Read-copy update (RCU).
+//!
+//! RCU allows readers to access a shared object without locking, while writers
+//! replace the object with a new one. The old object is reclaimed after a
+//! _grace period_, i.e., after all CPUs have passed a _quiescent state_ so that
+//! no reader can still hold a reference to it.
+//!
+//! A reader is in a read-side critical section as long as it holds a
+//! [`RcuReadGuard`], during which the preemption is disabled. So a CPU passes a
+//! quiescent state when it switches tasks or returns to the user space.
+//!
+//! The callbacks that are delayed after grace periods are invoked in batches
+//! from the RCU softirq, once the kernel enables it with [`enable_softirq`].
 
-use core::marker::PhantomData;
-use core::ops::Deref;
-use core::sync::atomic::{
-    AtomicPtr,
-    Ordering::{AcqRel, Acquire},
+use core::{
+    marker::PhantomData,
+    mem::ManuallyDrop,
+    ops::Deref,
+    sync::atomic::{
+        AtomicPtr,
+        Ordering::{AcqRel, Acquire},
+    },
 };
 
+use spin::Once;
+
 use self::monitor::RcuMonitor;
-use crate::prelude::*;
-use crate::sync::WaitQueue;
+use crate::{
+    task::{disable_preempt, DisablePreemptGuard},
+    trap::SoftIrqLine,
+};
 
 mod monitor;
 mod owner_ptr;
 
-pub use owner_ptr::OwnerPtr;
+pub use monitor::RcuStats;
+pub use owner_ptr::{NonNullPtr, OwnerPtr};
 
+/// A pointer protected by RCU.
+///
+/// The pointer can be read without locking through [`Rcu::read`], and be
+/// replaced through [`Rcu::replace`]. The writers should be synchronized by
+/// the users, e.g., with a lock.
 pub struct Rcu<P: OwnerPtr> {
     ptr: AtomicPtr<<P as OwnerPtr>::Target>,
-    marker: PhantomData<P::Target>,
+    marker: PhantomData<P>,
 }
 
 impl<P: OwnerPtr> Rcu<P> {
+    /// Creates a new RCU-protected pointer.
     pub fn new(ptr: P) -> Self {
         let ptr = AtomicPtr::new(OwnerPtr::into_raw(ptr) as *mut _);
         Self {
@@ -32,73 +58,245 @@ impl<P: OwnerPtr> Rcu<P> {
         }
     }
 
-    pub fn get(&self) -> RcuReadGuard<'_, P> {
-        let obj = unsafe { &*self.ptr.load(Acquire) };
-        RcuReadGuard { obj, rcu: self }
+    /// Enters a read-side critical section and gets the current object.
+    pub fn read(&self) -> RcuReadGuard<'_, P> {
+        let guard = disable_preempt();
+        let obj_ptr = self.ptr.load(Acquire);
+        RcuReadGuard {
+            obj_ptr,
+            _guard: guard,
+            _rcu: PhantomData,
+        }
     }
 }
 
 impl<P: OwnerPtr + Send> Rcu<P> {
+    /// Replaces the current object with a new one.
+    ///
+    /// The old object is returned as a [`RcuReclaimer`], which drops the old
+    /// object only after a grace period.
     pub fn replace(&self, new_ptr: P) -> RcuReclaimer<P> {
         let new_ptr = <P as OwnerPtr>::into_raw(new_ptr) as *mut _;
         let old_ptr = {
             let old_raw_ptr = self.ptr.swap(new_ptr, AcqRel);
+            // SAFETY: The pointer is converted from `P` by `into_raw` and its
+            // ownership is taken back from the RCU-protected pointer.
             unsafe { <P as OwnerPtr>::from_raw(old_raw_ptr) }
         };
-        RcuReclaimer { ptr: old_ptr }
+        RcuReclaimer {
+            ptr: ManuallyDrop::new(old_ptr),
+        }
     }
 }
 
+impl<P: OwnerPtr> Drop for Rcu<P> {
+    fn drop(&mut self) {
+        let ptr = *self.ptr.get_mut();
+        // SAFETY: The pointer is converted from `P` by `into_raw`. Since the
+        // RCU-protected pointer is exclusively owned, there are no readers.
+        drop(unsafe { <P as OwnerPtr>::from_raw(ptr) });
+    }
+}
+
+/// A guard of a read-side critical section of RCU.
+///
+/// The object read from a [`Rcu`] is valid as long as the guard is alive.
 pub struct RcuReadGuard<'a, P: OwnerPtr> {
-    obj: &'a <P as OwnerPtr>::Target,
-    rcu: &'a Rcu<P>,
+    obj_ptr: *const <P as OwnerPtr>::Target,
+    _guard: DisablePreemptGuard,
+    _rcu: PhantomData<&'a Rcu<P>>,
+}
+
+impl<'a, P: OwnerPtr> RcuReadGuard<'a, P> {
+    /// Gets the object, or `None` if the pointer is null.
+    ///
+    /// Only owner pointers like `Option<Arc<T>>` can be null.
+    pub fn get(&self) -> Option<&<P as OwnerPtr>::Target> {
+        // SAFETY: The object is not reclaimed until the end of the grace
+        // period, which cannot end while the guard disables preemption.
+        unsafe { self.obj_ptr.as_ref() }
+    }
 }
 
-impl<'a, P: OwnerPtr> Deref for RcuReadGuard<'a, P> {
+impl<'a, P: NonNullPtr> Deref for RcuReadGuard<'a, P> {
     type Target = <P as OwnerPtr>::Target;
 
     fn deref(&self) -> &Self::Target {
-        self.obj
+        self.get().unwrap()
     }
 }
 
+/// An object replaced from a [`Rcu`], which will be reclaimed after a grace period.
+///
+/// Dropping the reclaimer waits for the grace period and then drops the object
+/// in the current context. Use [`RcuReclaimer::delay`] to drop the object
+/// asynchronously instead.
 #[repr(transparent)]
 pub struct RcuReclaimer<P> {
-    ptr: P,
+    ptr: ManuallyDrop<P>,
 }
 
 impl<P: Send + 'static> RcuReclaimer<P> {
-    pub fn delay(mut self) {
-        let ptr: P = unsafe {
-            let ptr = core::mem::replace(&mut self.ptr, core::mem::uninitialized());
-
-            core::mem::forget(self);
+    /// Drops the object after a grace period without waiting for it.
+    ///
+    /// The object is then dropped in the RCU softirq, or when a CPU passes a
+    /// quiescent state if the softirq is not enabled, so dropping it must not sleep.
+    pub fn delay(self) {
+        self.delay_with(drop);
+    }
 
-            ptr
-        };
+    /// Passes the object to `f` after a grace period without waiting for it.
+    ///
+    /// Like [`RcuReclaimer::delay`], `f` must not sleep. If dropping the object
+    /// may sleep, `f` can hand it over to a context that is allowed to sleep.
+    pub fn delay_with<F>(self, f: F)
+    where
+        F: FnOnce(P) + Send + 'static,
+    {
+        let mut this = ManuallyDrop::new(self);
+        // SAFETY: The pointer is taken only once since `self` is not dropped.
+        let ptr: P = unsafe { ManuallyDrop::take(&mut this.ptr) };
         get_singleton().after_grace_period(move || {
-            drop(ptr);
+            f(ptr);
         });
     }
 }
 
+impl<P> RcuReclaimer<Option<P>> {
+    /// Reclaims the object at once if it is `None`, or returns the reclaimer otherwise.
+    ///
+    /// No reader can hold a reference to a null pointer, so there is no need to
+    /// wait for a grace period before reclaiming it.
+    pub fn skip_if_none(self) -> Option<Self> {
+        if self.ptr.is_some() {
+            return Some(self);
+        }
+        // The pointer is null and owns nothing, so it can be forgotten.
+        core::mem::forget(self);
+        None
+    }
+}
+
 impl<P> Drop for RcuReclaimer<P> {
     fn drop(&mut self) {
-        let wq = Arc::new(WaitQueue::new());
-        get_singleton().after_grace_period({
-            let wq = wq.clone();
-            move || {
-                wq.wake_one();
-            }
-        });
-        wq.wait_until(|| Some(0u8));
+        synchronize();
+        // SAFETY: The pointer is taken only once when `self` is dropped.
+        drop(unsafe { ManuallyDrop::take(&mut self.ptr) });
     }
 }
 
+/// Waits until a grace period has elapsed.
+///
+/// All the read-side critical sections that are entered before calling
+/// this function have exited when it returns.
+///
+/// # Panics
+///
+/// This function panics if it is called in a read-side critical section or
+/// with the preemption disabled.
+pub fn synchronize() {
+    assert!(
+        crate::task::is_preemptive(),
+        "waiting for a RCU grace period with the preemption disabled"
+    );
+
+    let monitor = get_singleton();
+    let gp = monitor.request_grace_period();
+    monitor.wait_for_grace_period(gp, || {
+        // The current CPU is not in a read-side critical section. Passing the quiescent state
+        // here ensures the progress even if no other tasks can run on the current CPU.
+        // SAFETY: The preemption is enabled, as checked above.
+        unsafe { pass_quiescent_state() };
+    });
+}
+
+/// Reports that the current CPU has passed a quiescent state.
+///
+/// # Safety
+///
+/// The current CPU must not be in a read-side critical section.
 pub unsafe fn pass_quiescent_state() {
-    get_singleton().pass_quiescent_state()
+    let Some(monitor) = RCU_MONITOR.get() else {
+        return;
+    };
+    monitor.pass_quiescent_state()
+}
+
+/// Enables the softirq line to invoke the callbacks that are delayed after grace periods.
+///
+/// # Panics
+///
+/// The softirq line can only be enabled once.
+pub fn enable_softirq(softirq_id: u8) {
+    let softirq = SoftIrqLine::get(softirq_id);
+    softirq.enable(|| get_singleton().handle_softirq());
+    get_singleton().set_softirq(softirq);
+}
+
+/// Returns the statistics of RCU, including the latency of grace periods and
+/// the backlog of callbacks.
+pub fn stats() -> RcuStats {
+    get_singleton().stats()
+}
+
+static RCU_MONITOR: Once<RcuMonitor> = Once::new();
+
+pub(crate) fn init() {
+    RCU_MONITOR.call_once(|| RcuMonitor::new(crate::cpu::num_cpus() as usize));
 }
 
 fn get_singleton() -> &'static RcuMonitor {
-    todo!()
+    RCU_MONITOR.get().unwrap()
+}
+
+#[cfg(ktest)]
+mod test {
+    use super::*;
+    use crate::prelude::*;
+
+    #[ktest]
+    fn rcu_replace_and_read() {
+        let rcu = Rcu::new(Box::new(1));
+        let old_guard = rcu.read();
+        assert_eq!(*old_guard, 1);
+        drop(old_guard);
+
+        let reclaimer = rcu.replace(Box::new(2));
+        assert_eq!(*rcu.read(), 2);
+        // Dropping the reclaimer waits for the grace period.
+        drop(reclaimer);
+        assert_eq!(*rcu.read(), 2);
+    }
+
+    #[ktest]
+    fn rcu_option() {
+        let rcu: Rcu<Option<Arc<u32>>> = Rcu::new(None);
+        assert!(rcu.read().get().is_none());
+
+        rcu.replace(Some(Arc::new(1))).delay();
+        assert_eq!(rcu.read().get(), Some(&1));
+
+        let value = Arc::new(2);
+        drop(rcu.replace(Some(value.clone())));
+        synchronize();
+        assert_eq!(Arc::strong_count(&value), 2);
+    }
+
+    #[ktest]
+    fn rcu_delay_and_stats() {
+        let value = Arc::new(1);
+        let rcu = Rcu::new(Some(value.clone()));
+        let nr_grace_periods = stats().nr_grace_periods;
+
+        rcu.replace(None).delay();
+        synchronize();
+        assert!(stats().nr_grace_periods > nr_grace_periods);
+
+        // The callback is invoked on the CPU that delays it.
+        while Arc::strong_count(&value) != 1 {
+            // SAFETY: The current CPU is not in a read-side critical section.
+            unsafe { pass_quiescent_state() };
+            crate::task::Task::yield_now();
+        }
+    }
 }
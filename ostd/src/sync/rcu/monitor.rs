@@ -2,140 +2,408 @@
 
 use alloc::collections::VecDeque;
 use core::sync::atomic::{
-    AtomicBool,
-    Ordering::{Acquire, Relaxed, Release},
+    fence, AtomicU64, AtomicUsize,
+    Ordering::{AcqRel, Acquire, Relaxed, SeqCst},
 };
 
-#[cfg(target_arch = "x86_64")]
-use crate::arch::x86::cpu;
-use crate::prelude::*;
-use crate::sync::AtomicBits;
-use crate::sync::SpinLock;
+use spin::Once;
+
+use crate::{
+    arch::{read_tsc, tsc_freq},
+    cpu,
+    prelude::*,
+    sync::{SpinLock, WaitQueue},
+    task::disable_preempt,
+    trap::{self, SoftIrqLine},
+};
+
+/// The maximum number of CPUs that share a leaf node of the grace-period tree.
+const FANOUT: usize = 16;
+
+/// The maximum number of callbacks that are invoked in a batch.
+///
+/// The remaining ready callbacks are invoked in the next batches, so that a
+/// large backlog of callbacks does not delay the other softirqs.
+const BATCH_LIMIT: usize = 64;
 
 /// A RCU monitor ensures the completion of _grace periods_ by keeping track
 /// of each CPU's passing _quiescent states_.
+///
+/// The grace periods are numbered in order. A grace period is started only
+/// when some callbacks or waiters request it, and at most one grace period is
+/// in progress at a time.
+///
+/// The quiescent states are detected hierarchically. Each CPU clears its bit
+/// in its leaf node when it first passes a quiescent state in a grace period,
+/// and the last CPU of a leaf node clears the bit of the leaf in the root node.
+/// The grace period completes when the root node is cleared. So each CPU only
+/// writes to the shared state once per grace period, and the contention is
+/// bounded by the fan-out of the nodes.
+///
+/// The callbacks are queued on the CPU that registers them, tagged with the
+/// grace period that they wait for. Each CPU invokes its own ready callbacks in
+/// batches from the RCU softirq, or directly when it passes a quiescent state
+/// if the softirq is not enabled.
 pub struct RcuMonitor {
-    is_monitoring: AtomicBool,
-    state: SpinLock<State>,
+    /// The number of the latest grace period that has started.
+    gp_seq: AtomicU64,
+    /// The number of the latest grace period that has completed.
+    gp_completed: AtomicU64,
+    /// The number of the latest grace period that has been requested.
+    gp_requested: AtomicU64,
+    /// The state of the grace periods, which serializes their starts and ends.
+    gp_state: SpinLock<GpState>,
+    /// The wait queue of the waiters of grace periods.
+    gp_wait_queue: WaitQueue,
+    leaves: Box<[Node]>,
+    root: Node,
+    per_cpu: Box<[PerCpu]>,
+    softirq: Once<&'static SoftIrqLine>,
 }
 
 impl RcuMonitor {
     pub fn new(num_cpus: usize) -> Self {
+        let num_leaves = num_cpus.div_ceil(FANOUT);
+        assert!(num_leaves <= u64::BITS as usize);
+
+        let leaves = (0..num_leaves)
+            .map(|leaf| Node::new((num_cpus - leaf * FANOUT).min(FANOUT)))
+            .collect();
+        let per_cpu = (0..num_cpus).map(|_| PerCpu::new()).collect();
+
         Self {
-            is_monitoring: AtomicBool::new(false),
-            state: SpinLock::new(State::new(num_cpus)),
+            gp_seq: AtomicU64::new(0),
+            gp_completed: AtomicU64::new(0),
+            gp_requested: AtomicU64::new(0),
+            gp_state: SpinLock::new(GpState::new()),
+            gp_wait_queue: WaitQueue::new(),
+            leaves,
+            root: Node::new(num_leaves),
+            per_cpu,
+            softirq: Once::new(),
         }
     }
 
+    /// Invokes the ready callbacks from the softirq line from now on.
+    pub fn set_softirq(&self, softirq: &'static SoftIrqLine) {
+        self.softirq.call_once(|| softirq);
+    }
+
     pub unsafe fn pass_quiescent_state(&self) {
-        // Fast path
-        if !self.is_monitoring.load(Relaxed) {
-            return;
-        }
+        let mut is_gp_completed = false;
+        let mut has_ready_callbacks = false;
 
-        // Check if the current GP is complete after passing the quiescent state
-        // on the current CPU. If GP is complete, take the callbacks of the current
-        // GP.
-        let callbacks = {
-            let mut state = self.state.lock_irq_disabled();
-            if state.current_gp.is_complete() {
-                return;
+        {
+            let _irq_guard = trap::disable_local();
+            let cpu = cpu::this_cpu() as usize;
+            let per_cpu = &self.per_cpu[cpu];
+            per_cpu.qs_count.fetch_add(1, Relaxed);
+
+            // Fast path: no grace period is in progress, or the CPU has reported
+            // a quiescent state in the current one.
+            let gp = self.gp_seq.load(Acquire);
+            if gp != self.gp_completed.load(Acquire) && per_cpu.qs_gp.load(Relaxed) != gp {
+                per_cpu.qs_gp.store(gp, Relaxed);
+                is_gp_completed = self.report_quiescent_state(cpu, gp);
             }
 
-            state.current_gp.pass_quiescent_state();
-            if !state.current_gp.is_complete() {
-                return;
+            if per_cpu.first_target.load(Relaxed) <= self.gp_completed.load(Acquire) {
+                match self.softirq.get() {
+                    Some(softirq) => softirq.raise(),
+                    None => has_ready_callbacks = true,
+                }
             }
+        }
 
-            // Now that the current GP is complete, take its callbacks
-            let current_callbacks = state.current_gp.take_callbacks();
+        if is_gp_completed {
+            self.gp_wait_queue.wake_all();
+        }
+        if has_ready_callbacks {
+            let _preempt_guard = disable_preempt();
+            while self.invoke_ready_callbacks() {}
+        }
+    }
 
-            // Check if we need to70G watch for a next GP
-            if !state.next_callbacks.is_empty() {
-                let callbacks = core::mem::take(&mut state.next_callbacks);
-                state.current_gp.restart(callbacks);
-            } else {
-                self.is_monitoring.store(false, Relaxed);
-            }
+    /// Clears the bit of the CPU in the grace-period tree.
+    ///
+    /// Returns whether the grace period is completed by the CPU.
+    fn report_quiescent_state(&self, cpu: usize, gp: u64) -> bool {
+        let leaf = cpu / FANOUT;
+        let cpu_bit = 1 << (cpu % FANOUT);
+        let prev_mask = self.leaves[leaf].qs_mask.fetch_and(!cpu_bit, AcqRel);
+        debug_assert_ne!(prev_mask & cpu_bit, 0);
+        if prev_mask != cpu_bit {
+            return false;
+        }
 
-            current_callbacks
-        };
+        let leaf_bit = 1 << leaf;
+        let prev_mask = self.root.qs_mask.fetch_and(!leaf_bit, AcqRel);
+        debug_assert_ne!(prev_mask & leaf_bit, 0);
+        if prev_mask != leaf_bit {
+            return false;
+        }
 
-        // Invoke the callbacks to notify the completion of GP
-        for f in callbacks {
-            (f)();
+        self.end_grace_period(gp);
+        true
+    }
+
+    fn end_grace_period(&self, gp: u64) {
+        let mut state = self.gp_state.lock_irq_disabled();
+
+        let cycles = read_tsc().wrapping_sub(state.start_time);
+        state.nr_grace_periods += 1;
+        state.total_cycles += cycles;
+        state.max_cycles = state.max_cycles.max(cycles);
+
+        self.gp_completed.store(gp, SeqCst);
+        // Pairs with `request_grace_period`: either the requester sees that the grace
+        // period has completed and starts the next one, or the next one is started here.
+        if self.gp_requested.load(SeqCst) > gp {
+            self.start_grace_period(&mut state);
+        }
+    }
+
+    fn start_grace_period(&self, state: &mut GpState) {
+        for leaf in self.leaves.iter() {
+            leaf.qs_mask.store(leaf.full_mask, Relaxed);
         }
+        self.root.qs_mask.store(self.root.full_mask, Relaxed);
+        state.start_time = read_tsc();
+
+        // Publish the masks before the CPUs see the new grace period.
+        self.gp_seq.fetch_add(1, SeqCst);
+    }
+
+    /// Requests a grace period that starts after all the preceding memory accesses,
+    /// and returns its number.
+    pub fn request_grace_period(&self) -> u64 {
+        // Order the removals of the objects before reading the number.
+        fence(SeqCst);
+        let target = self.gp_seq.load(SeqCst) + 1;
+        self.request_grace_period_for(target);
+        target
+    }
+
+    fn request_grace_period_for(&self, target: u64) {
+        self.gp_requested.fetch_max(target, SeqCst);
+
+        let gp = self.gp_seq.load(SeqCst);
+        if gp >= target || gp != self.gp_completed.load(SeqCst) {
+            // The grace period has started, or will be started when the current
+            // grace period ends.
+            return;
+        }
+
+        let mut state = self.gp_state.lock_irq_disabled();
+        let gp = self.gp_seq.load(Relaxed);
+        if gp < target && gp == self.gp_completed.load(Relaxed) {
+            self.start_grace_period(&mut state);
+        }
+    }
+
+    /// Returns whether the grace period has completed.
+    pub fn is_grace_period_completed(&self, gp: u64) -> bool {
+        self.gp_completed.load(Acquire) >= gp
+    }
+
+    /// Waits until the grace period has completed.
+    ///
+    /// `pass_quiescent_state` is called before each check, in order to ensure
+    /// the progress even if no other tasks can run on the current CPU.
+    pub fn wait_for_grace_period(&self, gp: u64, mut pass_quiescent_state: impl FnMut()) {
+        self.gp_wait_queue.wait_until(|| {
+            pass_quiescent_state();
+            self.is_grace_period_completed(gp).then_some(())
+        });
     }
 
     pub fn after_grace_period<F>(&self, f: F)
     where
-        F: FnOnce() -> () + Send + 'static,
+        F: FnOnce() + Send + 'static,
     {
-        let mut state = self.state.lock_irq_disabled();
+        fence(SeqCst);
+        let target = {
+            let _irq_guard = trap::disable_local();
+            let per_cpu = &self.per_cpu[cpu::this_cpu() as usize];
+            // Read the number with the local IRQs disabled, so that the callbacks of
+            // a CPU are always sorted by their grace periods.
+            let target = self.gp_seq.load(SeqCst) + 1;
 
-        state.next_callbacks.push_back(Box::new(f));
+            let mut callbacks = per_cpu.callbacks.lock();
+            if callbacks.is_empty() {
+                per_cpu.first_target.store(target, Relaxed);
+            }
+            callbacks.push_back((target, Box::new(f)));
+            per_cpu.nr_callbacks.fetch_add(1, Relaxed);
+            target
+        };
 
-        if !state.current_gp.is_complete() {
-            return;
+        self.request_grace_period_for(target);
+    }
+
+    /// Invokes a batch of the ready callbacks of the current CPU.
+    ///
+    /// Returns whether there are remaining ready callbacks.
+    ///
+    /// The preemption must be disabled.
+    pub fn invoke_ready_callbacks(&self) -> bool {
+        let completed = self.gp_completed.load(Acquire);
+        let per_cpu = &self.per_cpu[cpu::this_cpu() as usize];
+
+        let (batch, has_remaining) = {
+            let mut callbacks = per_cpu.callbacks.lock_irq_disabled();
+            let nr_ready = callbacks
+                .iter()
+                .take(BATCH_LIMIT)
+                .take_while(|(target, _)| *target <= completed)
+                .count();
+            if nr_ready == 0 {
+                return false;
+            }
+
+            let batch: Vec<_> = callbacks.drain(..nr_ready).collect();
+            let first_target = callbacks.front().map_or(u64::MAX, |(target, _)| *target);
+            per_cpu.first_target.store(first_target, Relaxed);
+            (batch, first_target <= completed)
+        };
+
+        per_cpu.nr_callbacks.fetch_sub(batch.len(), Relaxed);
+        per_cpu
+            .nr_invoked_callbacks
+            .fetch_add(batch.len() as u64, Relaxed);
+        for (_, f) in batch {
+            (f)();
         }
 
-        let callbacks = core::mem::take(&mut state.next_callbacks);
-        state.current_gp.restart(callbacks);
-        self.is_monitoring.store(true, Relaxed);
+        has_remaining
     }
-}
 
-struct State {
-    current_gp: GracePeriod,
-    next_callbacks: Callbacks,
-}
+    /// Handles the RCU softirq by invoking a batch of the ready callbacks of the current
+    /// CPU, and raises the softirq again if there are more.
+    pub fn handle_softirq(&self) {
+        if self.invoke_ready_callbacks() {
+            if let Some(softirq) = self.softirq.get() {
+                softirq.raise();
+            }
+        }
+    }
 
-impl State {
-    pub fn new(num_cpus: usize) -> Self {
-        Self {
-            current_gp: GracePeriod::new(num_cpus),
-            next_callbacks: VecDeque::new(),
+    /// Returns the statistics of the monitor.
+    pub fn stats(&self) -> RcuStats {
+        let (nr_grace_periods, total_cycles, max_cycles) = {
+            let state = self.gp_state.lock_irq_disabled();
+            (state.nr_grace_periods, state.total_cycles, state.max_cycles)
+        };
+        let cycles_to_ns = |cycles: u64| match tsc_freq() {
+            0 => 0,
+            freq => (cycles as u128 * 1_000_000_000 / freq as u128) as u64,
+        };
+
+        let mut stats = RcuStats {
+            nr_grace_periods,
+            avg_gp_latency_ns: cycles_to_ns(
+                total_cycles.checked_div(nr_grace_periods).unwrap_or(0),
+            ),
+            max_gp_latency_ns: cycles_to_ns(max_cycles),
+            nr_pending_callbacks: 0,
+            nr_invoked_callbacks: 0,
+            nr_quiescent_states: 0,
+        };
+        for per_cpu in self.per_cpu.iter() {
+            stats.nr_pending_callbacks += per_cpu.nr_callbacks.load(Relaxed);
+            stats.nr_invoked_callbacks += per_cpu.nr_invoked_callbacks.load(Relaxed);
+            stats.nr_quiescent_states += per_cpu.qs_count.load(Relaxed);
         }
+        stats
     }
 }
 
-type Callbacks = VecDeque<Box<dyn FnOnce() -> () + Send + 'static>>;
+/// The statistics of RCU.
+#[derive(Clone, Copy, Debug)]
+pub struct RcuStats {
+    /// The number of grace periods that have completed.
+    pub nr_grace_periods: u64,
+    /// The average time from the start to the end of a grace period in nanoseconds.
+    pub avg_gp_latency_ns: u64,
+    /// The maximum time from the start to the end of a grace period in nanoseconds.
+    pub max_gp_latency_ns: u64,
+    /// The number of callbacks that wait for their grace periods or to be invoked.
+    pub nr_pending_callbacks: usize,
+    /// The number of callbacks that have been invoked.
+    pub nr_invoked_callbacks: u64,
+    /// The number of quiescent states that the CPUs have passed.
+    pub nr_quiescent_states: u64,
+}
 
-struct GracePeriod {
-    callbacks: Callbacks,
-    cpu_mask: AtomicBits,
-    is_complete: bool,
+struct GpState {
+    /// The TSC value when the current or the last grace period started.
+    start_time: u64,
+    nr_grace_periods: u64,
+    total_cycles: u64,
+    max_cycles: u64,
 }
 
-impl GracePeriod {
-    pub fn new(num_cpus: usize) -> Self {
+impl GpState {
+    const fn new() -> Self {
         Self {
-            callbacks: Default::default(),
-            cpu_mask: AtomicBits::new_zeroes(num_cpus),
-            is_complete: false,
+            start_time: 0,
+            nr_grace_periods: 0,
+            total_cycles: 0,
+            max_cycles: 0,
         }
     }
+}
 
-    pub fn is_complete(&self) -> bool {
-        self.is_complete
-    }
-
-    pub unsafe fn pass_quiescent_state(&mut self) {
-        let this_cpu = cpu::this_cpu();
-        self.cpu_mask.set(this_cpu as usize, true);
+/// A node of the grace-period tree.
+#[repr(align(64))]
+struct Node {
+    /// The children that have not passed a quiescent state in the current grace period.
+    qs_mask: AtomicU64,
+    /// All the children.
+    full_mask: u64,
+}
 
-        if self.cpu_mask.is_full() {
-            self.is_complete = true;
+impl Node {
+    fn new(num_children: usize) -> Self {
+        let full_mask = match num_children {
+            64 => u64::MAX,
+            n => (1 << n) - 1,
+        };
+        Self {
+            qs_mask: AtomicU64::new(0),
+            full_mask,
         }
     }
+}
 
-    pub fn take_callbacks(&mut self) -> Callbacks {
-        core::mem::take(&mut self.callbacks)
-    }
+type Callbacks = VecDeque<(u64, Box<dyn FnOnce() + Send + 'static>)>;
 
-    pub fn restart(&mut self, callbacks: Callbacks) {
-        self.is_complete = false;
-        self.cpu_mask.clear();
-        self.callbacks = callbacks;
+/// The per-CPU state of the monitor, which is mostly accessed by its own CPU.
+#[repr(align(64))]
+struct PerCpu {
+    /// The number of the latest grace period in which the CPU has reported a
+    /// quiescent state.
+    qs_gp: AtomicU64,
+    /// The number of quiescent states that the CPU has passed.
+    qs_count: AtomicU64,
+    /// The callbacks, each with the number of the grace period that it waits for.
+    callbacks: SpinLock<Callbacks>,
+    /// The grace period that the first callback waits for, or `u64::MAX` if there
+    /// are no callbacks.
+    first_target: AtomicU64,
+    nr_callbacks: AtomicUsize,
+    nr_invoked_callbacks: AtomicU64,
+}
+
+impl PerCpu {
+    fn new() -> Self {
+        Self {
+            qs_gp: AtomicU64::new(0),
+            qs_count: AtomicU64::new(0),
+            callbacks: SpinLock::new(VecDeque::new()),
+            first_target: AtomicU64::new(u64::MAX),
+            nr_callbacks: AtomicUsize::new(0),
+            nr_invoked_callbacks: AtomicU64::new(0),
+        }
     }
 }
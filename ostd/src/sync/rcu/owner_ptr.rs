@@ -1,7 +1,5 @@
 // SPDX-License-Identifier: MPL-2.0
 
-use core::ptr::NonNull;
-
 use crate::prelude::*;
 
 /// A trait that abstracts pointers that have the ownership of the objects they
@@ -42,6 +40,9 @@ impl<T> OwnerPtr for Box<T> {
     }
 }
 
+// SAFETY: `Box::into_raw` never returns a null pointer.
+unsafe impl<T> NonNullPtr for Box<T> {}
+
 impl<T> OwnerPtr for Arc<T> {
     type Target = T;
 
@@ -54,6 +55,9 @@ impl<T> OwnerPtr for Arc<T> {
     }
 }
 
+// SAFETY: `Arc::into_raw` never returns a null pointer.
+unsafe impl<T> NonNullPtr for Arc<T> {}
+
 impl<P> OwnerPtr for Option<P>
 where
     P: OwnerPtr,
@@ -72,9 +76,16 @@ where
 
     unsafe fn from_raw(ptr: *const Self::Target) -> Self {
         if ptr.is_null() {
-            Some(<P as OwnerPtr>::from_raw(ptr))
-        } else {
             None
+        } else {
+            Some(<P as OwnerPtr>::from_raw(ptr))
         }
     }
 }
+
+/// A marker trait for owner pointers that are never null.
+///
+/// # Safety
+///
+/// [`OwnerPtr::into_raw`] must never return a null pointer.
+pub unsafe trait NonNullPtr: OwnerPtr {}
@@ -11,7 +11,10 @@ use core::{
     },
 };
 
-use super::WaitQueue;
+use super::{
+    adaptive::{spin_until, LockOwner},
+    WaitQueue,
+};
 
 /// A mutex that provides data access to either one writer or many readers.
 ///
@@ -25,7 +28,9 @@ use super::WaitQueue;
 /// The writing and reading portions cannot be active simultaneously, when
 /// one portion is in progress, the other portion will sleep. This is
 /// suitable for scenarios where the mutex is expected to be held for a
-/// period of time, which can avoid wasting CPU resources.
+/// period of time, which can avoid wasting CPU resources. Still, a contended
+/// thread spins for a while before sleeping if the writer is running on
+/// another CPU, since the writer is likely to release the mutex soon.
 ///
 /// This implementation provides the upgradeable read mutex (`upread mutex`).
 /// The `upread mutex` can be upgraded to write mutex atomically, useful in
@@ -92,6 +97,8 @@ pub struct RwMutex<T: ?Sized> {
     /// - **Bit 61:** Indicates if an upgradeable reader is being upgraded.
     /// - **Bits 60-0:** Reader mutex count.
     lock: AtomicUsize,
+    /// The writer that holds the mutex, if any.
+    writer: LockOwner,
     /// Threads that fail to acquire the mutex will sleep on this waitqueue.
     queue: WaitQueue,
     val: UnsafeCell<T>,
@@ -109,6 +116,7 @@ impl<T> RwMutex<T> {
         Self {
             val: UnsafeCell::new(val),
             lock: AtomicUsize::new(0),
+            writer: LockOwner::new(),
             queue: WaitQueue::new(),
         }
     }
@@ -122,6 +130,9 @@ impl<T: ?Sized> RwMutex<T> {
     /// order in which other concurrent readers or writers waiting simultaneously
     /// will acquire the mutex.
     pub fn read(&self) -> RwMutexReadGuard<T> {
+        if let Some(guard) = spin_until(&self.writer, || self.try_read()) {
+            return guard;
+        }
         self.queue.wait_until(|| self.try_read())
     }
 
@@ -132,6 +143,9 @@ impl<T: ?Sized> RwMutex<T> {
     /// order in which other concurrent readers or writers waiting simultaneously
     /// will acquire the mutex.
     pub fn write(&self) -> RwMutexWriteGuard<T> {
+        if let Some(guard) = spin_until(&self.writer, || self.try_write()) {
+            return guard;
+        }
         self.queue.wait_until(|| self.try_write())
     }
 
@@ -146,6 +160,9 @@ impl<T: ?Sized> RwMutex<T> {
     /// only one upreader can exist at any time to avoid deadlock in the
     /// upgread method.
     pub fn upread(&self) -> RwMutexUpgradeableGuard<T> {
+        if let Some(guard) = spin_until(&self.writer, || self.try_upread()) {
+            return guard;
+        }
         self.queue.wait_until(|| self.try_upread())
     }
 
@@ -171,6 +188,7 @@ impl<T: ?Sized> RwMutex<T> {
             .compare_exchange(0, WRITER, Acquire, Relaxed)
             .is_ok()
         {
+            self.writer.set();
             Some(RwMutexWriteGuard { inner: self })
         } else {
             None
@@ -303,6 +321,7 @@ impl<T: ?Sized, R: Deref<Target = RwMutex<T>>> DerefMut for RwMutexWriteGuard_<T
 
 impl<T: ?Sized, R: Deref<Target = RwMutex<T>>> Drop for RwMutexWriteGuard_<T, R> {
     fn drop(&mut self) {
+        self.inner.writer.clear();
         self.inner.lock.fetch_and(!WRITER, Release);
 
         // When the current writer releases, wake up all the sleeping threads.
@@ -355,6 +374,7 @@ impl<T: ?Sized, R: Deref<Target = RwMutex<T>> + Clone> RwMutexUpgradeableGuard_<
             Relaxed,
         );
         if res.is_ok() {
+            self.inner.writer.set();
             let inner = self.inner.clone();
             drop(self);
             Ok(RwMutexWriteGuard_ { inner })
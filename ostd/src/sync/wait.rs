@@ -101,6 +101,9 @@ impl WaitQueue {
             self.enqueue(waker.clone());
 
             if let Some(res) = cond() {
+                // The waker is no longer needed. Removing it keeps the wakers from waking up
+                // nobody, and allows the waker to be reused by the next waiter of the task.
+                self.dequeue(&waker);
                 return Some(res);
             };
 
@@ -175,6 +178,15 @@ impl WaitQueue {
         wakers.push_back(waker);
         self.num_wakers.fetch_add(1, Ordering::Acquire);
     }
+
+    fn dequeue(&self, waker: &Arc<Waker>) {
+        let mut wakers = self.wakers.lock_irq_disabled();
+        // The waker is most likely the last one, since it has just been enqueued.
+        if let Some(pos) = wakers.iter().rposition(|w| Arc::ptr_eq(w, waker)) {
+            wakers.remove(pos);
+            self.num_wakers.fetch_sub(1, Ordering::Release);
+        }
+    }
 }
 
 impl Default for WaitQueue {
@@ -206,11 +218,22 @@ pub struct Waker {
 
 impl Waiter {
     /// Creates a waiter and its associated [`Waker`].
+    ///
+    /// The waker of the last dropped waiter of the current task is reused if no one
+    /// else holds it, so waiting does not allocate in the common case.
     pub fn new_pair() -> (Self, Arc<Waker>) {
-        let waker = Arc::new(Waker {
-            has_woken: AtomicBool::new(false),
-            task: current_task().unwrap(),
-        });
+        let task = current_task().unwrap();
+        let cached_waker = task.inner_exclusive_access().cached_waker.take();
+        let waker = match cached_waker {
+            Some(waker) if Arc::strong_count(&waker) == 1 => {
+                waker.has_woken.store(false, Ordering::Relaxed);
+                waker
+            }
+            _ => Arc::new(Waker {
+                has_woken: AtomicBool::new(false),
+                task,
+            }),
+        };
         let waiter = Self {
             waker: waker.clone(),
         };
@@ -238,6 +261,12 @@ impl Drop for Waiter {
         // When dropping the waiter, we need to close the waker to ensure that if someone wants to
         // wake up the waiter afterwards, they will perform a no-op.
         self.waker.close();
+
+        // A waker held by others cannot be reused, otherwise their wake events would go to the
+        // next waiter by mistake.
+        if Arc::strong_count(&self.waker) == 1 {
+            self.waker.task.inner_exclusive_access().cached_waker = Some(self.waker.clone());
+        }
     }
 }
 
@@ -355,6 +384,25 @@ mod test {
         assert!(!waker.wake_up());
     }
 
+    #[ktest]
+    fn waiter_reuse_waker() {
+        let (waiter, waker) = Waiter::new_pair();
+        let waker_ptr = Arc::as_ptr(&waker);
+        drop(waker);
+        drop(waiter);
+
+        let (waiter, waker) = Waiter::new_pair();
+        assert_eq!(Arc::as_ptr(&waker), waker_ptr);
+        assert!(waker.wake_up());
+        waiter.wait();
+
+        // A waker that is still held cannot be reused.
+        drop(waiter);
+        let (_waiter, waker2) = Waiter::new_pair();
+        assert!(!Arc::ptr_eq(&waker, &waker2));
+        assert!(!waker.wake_up());
+    }
+
     #[ktest]
     fn waiter_wake_async() {
         let (waiter, waker) = Waiter::new_pair();
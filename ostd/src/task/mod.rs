@@ -8,6 +8,7 @@ mod scheduler;
 #[allow(clippy::module_inception)]
 mod task;
 
+pub(crate) use self::processor::{is_preemptive, nr_context_switches};
 pub use self::{
     priority::Priority,
     processor::{current_task, disable_preempt, preempt, schedule, DisablePreemptGuard},
@@ -2,18 +2,23 @@
 
 #![allow(dead_code)]
 
-use alloc::sync::Arc;
+use alloc::{boxed::Box, sync::Arc};
 use core::{
     cell::RefCell,
     sync::atomic::{AtomicUsize, Ordering::Relaxed},
 };
 
+use spin::Once;
+
 use super::{
-    scheduler::{fetch_task, GLOBAL_SCHEDULER},
+    scheduler::{fetch_task, global_scheduler},
     task::{context_switch, TaskContext},
     Task, TaskStatus,
 };
-use crate::{cpu_local, CpuLocal};
+use crate::{
+    cpu::{num_cpus, this_cpu},
+    cpu_local, CpuLocal,
+};
 
 pub struct Processor {
     current: Option<Arc<Task>>,
@@ -66,7 +71,20 @@ pub(crate) fn get_idle_task_ctx_ptr() -> *mut TaskContext {
     })
 }
 
-/// Calls this function to switch to other task by using GLOBAL_SCHEDULER
+/// The number of context switches of each CPU.
+///
+/// Unlike CPU-local variables, the counter of a CPU can be read by the other CPUs
+/// to tell whether the task running on that CPU has been switched out.
+static NR_CONTEXT_SWITCHES: Once<Box<[AtomicUsize]>> = Once::new();
+
+/// Returns the number of context switches that have occurred on the CPU.
+pub(crate) fn nr_context_switches(cpu: u32) -> usize {
+    NR_CONTEXT_SWITCHES
+        .get()
+        .map_or(0, |counters| counters[cpu as usize].load(Relaxed))
+}
+
+/// Calls this function to switch to other task by using the global scheduler
 pub fn schedule() {
     if let Some(task) = fetch_task() {
         switch_to_task(task);
@@ -82,14 +100,13 @@ pub fn schedule() {
 pub fn preempt(task: &Arc<Task>) {
     // TODO: Refactor `preempt` and `schedule`
     // after the Atomic mode and `might_break` is enabled.
-    let mut scheduler = GLOBAL_SCHEDULER.lock_irq_disabled();
+    let scheduler = global_scheduler();
     if !scheduler.should_preempt(task) {
         return;
     }
     let Some(next_task) = scheduler.dequeue() else {
         return;
     };
-    drop(scheduler);
     switch_to_task(next_task);
 }
 
@@ -108,17 +125,22 @@ fn switch_to_task(next_task: Arc<Task>) {
         );
     }
 
+    // SAFETY: Switching tasks is a quiescent state since the preemption is enabled.
+    unsafe { crate::sync::pass_quiescent_state() };
+
     let current_task_ctx_ptr = match current_task() {
         None => get_idle_task_ctx_ptr(),
         Some(current_task) => {
             let ctx_ptr = current_task.ctx().get();
 
+            global_scheduler().on_switch_out(&current_task);
+
             let mut task_inner = current_task.inner_exclusive_access();
 
             debug_assert_ne!(task_inner.task_status, TaskStatus::Sleeping);
             if task_inner.task_status == TaskStatus::Runnable {
                 drop(task_inner);
-                GLOBAL_SCHEDULER.lock_irq_disabled().enqueue(current_task);
+                global_scheduler().enqueue(current_task);
             } else if task_inner.task_status == TaskStatus::Sleepy {
                 task_inner.task_status = TaskStatus::Sleeping;
             }
@@ -127,8 +149,13 @@ fn switch_to_task(next_task: Arc<Task>) {
         }
     };
 
+    global_scheduler().on_switch_in(&next_task);
     let next_task_ctx_ptr = next_task.ctx().get().cast_const();
 
+    let nr_switches =
+        NR_CONTEXT_SWITCHES.call_once(|| (0..num_cpus()).map(|_| AtomicUsize::new(0)).collect());
+    nr_switches[this_cpu() as usize].fetch_add(1, Relaxed);
+
     if let Some(next_user_space) = next_task.user_space() {
         next_user_space.vm_space().activate();
     }
@@ -222,6 +249,12 @@ impl Drop for DisablePreemptGuard {
     }
 }
 
+/// Returns whether the current CPU can be preempted, i.e., no spin locks or
+/// other preemption-disabling guards are held.
+pub(crate) fn is_preemptive() -> bool {
+    PREEMPT_COUNT.is_preemptive()
+}
+
 /// Disables preemption.
 #[must_use]
 pub fn disable_preempt() -> DisablePreemptGuard {
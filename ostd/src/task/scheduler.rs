@@ -4,69 +4,86 @@
 
 use alloc::collections::VecDeque;
 
+use spin::Once;
+
 use crate::{prelude::*, sync::SpinLock, task::Task};
 
 static DEFAULT_SCHEDULER: FifoScheduler = FifoScheduler::new();
-pub(crate) static GLOBAL_SCHEDULER: SpinLock<GlobalScheduler> = SpinLock::new(GlobalScheduler {
-    scheduler: &DEFAULT_SCHEDULER,
-});
+
+/// The scheduler installed by [`set_scheduler`].
+///
+/// The scheduler is responsible for its own synchronization, so no global
+/// lock is taken on the hot `enqueue`/`dequeue`/`should_preempt` paths.
+static GLOBAL_SCHEDULER: Once<&'static dyn Scheduler> = Once::new();
 
 /// A scheduler for tasks.
 ///
 /// An implementation of scheduler can attach scheduler-related information
 /// with the `TypeMap` returned from `task.data()`.
+///
+/// All methods may be called concurrently from multiple CPUs, and from
+/// contexts where local IRQs are disabled. An implementation should keep
+/// its state in per-CPU structures wherever possible.
 pub trait Scheduler: Sync + Send {
     /// Enqueues a task to the scheduler.
     fn enqueue(&self, task: Arc<Task>);
 
-    /// Dequeues a task from the scheduler.
+    /// Dequeues a task to run on the current CPU from the scheduler.
     fn dequeue(&self) -> Option<Arc<Task>>;
 
     /// Tells whether the given task should be preempted by other tasks in the queue.
+    ///
+    /// This method is called on every return to user space, so it should be cheap
+    /// and should avoid taking locks.
     fn should_preempt(&self, task: &Arc<Task>) -> bool;
-}
 
-pub struct GlobalScheduler {
-    scheduler: &'static dyn Scheduler,
+    /// Notifies the scheduler that the given task is being switched out of the current CPU.
+    ///
+    /// This is called whether or not the task is going to be enqueued again,
+    /// so a scheduler can use it to account the running time of tasks.
+    /// The default implementation does nothing.
+    fn on_switch_out(&self, _task: &Arc<Task>) {}
+
+    /// Notifies the scheduler that the given task is being switched in to the current CPU.
+    ///
+    /// This is called after the previous task, if any, has been switched out.
+    /// The default implementation does nothing.
+    fn on_switch_in(&self, _task: &Arc<Task>) {}
 }
 
-impl GlobalScheduler {
-    pub const fn new(scheduler: &'static dyn Scheduler) -> Self {
-        Self { scheduler }
-    }
-
-    /// dequeue a task using scheduler
-    /// require the scheduler is not none
-    pub fn dequeue(&mut self) -> Option<Arc<Task>> {
-        self.scheduler.dequeue()
-    }
-    /// enqueue a task using scheduler
-    /// require the scheduler is not none
-    pub fn enqueue(&mut self, task: Arc<Task>) {
-        self.scheduler.enqueue(task)
-    }
-
-    pub fn should_preempt(&self, task: &Arc<Task>) -> bool {
-        self.scheduler.should_preempt(task)
+/// Returns the global scheduler.
+pub(crate) fn global_scheduler() -> &'static dyn Scheduler {
+    match GLOBAL_SCHEDULER.get() {
+        Some(scheduler) => *scheduler,
+        None => &DEFAULT_SCHEDULER,
     }
 }
+
 /// Sets the global task scheduler.
 ///
 /// This must be called before invoking `Task::spawn`.
+///
+/// # Panics
+///
+/// The global scheduler can only be set once. This function panics if
+/// it is called more than once.
 pub fn set_scheduler(scheduler: &'static dyn Scheduler) {
-    let mut global_scheduler = GLOBAL_SCHEDULER.lock_irq_disabled();
     // When setting a new scheduler, the old scheduler should be empty
-    assert!(global_scheduler.dequeue().is_none());
-    global_scheduler.scheduler = scheduler;
+    assert!(DEFAULT_SCHEDULER.dequeue().is_none());
+    assert!(
+        !GLOBAL_SCHEDULER.is_completed(),
+        "the global scheduler has already been set"
+    );
+    GLOBAL_SCHEDULER.call_once(|| scheduler);
 }
 
 pub fn fetch_task() -> Option<Arc<Task>> {
-    GLOBAL_SCHEDULER.lock_irq_disabled().dequeue()
+    global_scheduler().dequeue()
 }
 
 /// Adds a task to the global scheduler.
 pub fn add_task(task: Arc<Task>) {
-    GLOBAL_SCHEDULER.lock_irq_disabled().enqueue(task);
+    global_scheduler().enqueue(task);
 }
 
 /// A simple FIFO (First-In-First-Out) task scheduler.
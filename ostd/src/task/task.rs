@@ -5,7 +5,7 @@
 #![allow(missing_docs)]
 #![allow(dead_code)]
 
-use core::cell::UnsafeCell;
+use core::{cell::UnsafeCell, ops::Range};
 
 use intrusive_collections::{intrusive_adapter, LinkedListAtomicLink};
 
@@ -19,7 +19,7 @@ use crate::{
     cpu::CpuSet,
     mm::{kspace::KERNEL_PAGE_TABLE, FrameAllocOptions, PageFlags, Segment, PAGE_SIZE},
     prelude::*,
-    sync::{SpinLock, SpinLockGuard},
+    sync::{SpinLock, SpinLockGuard, Waker},
     user::UserSpace,
 };
 
@@ -81,6 +81,13 @@ impl KernelStack {
     pub fn end_paddr(&self) -> Paddr {
         self.segment.end_paddr()
     }
+
+    /// Returns the range of the usable stack in the kernel virtual address space,
+    /// which excludes the guard page.
+    pub fn vaddr_range(&self) -> Range<Vaddr> {
+        let end = crate::mm::paddr_to_vaddr(self.end_paddr());
+        end - KERNEL_STACK_SIZE..end
+    }
 }
 
 impl Drop for KernelStack {
@@ -119,7 +126,6 @@ pub struct Task {
     kstack: KernelStack,
     link: LinkedListAtomicLink,
     priority: Priority,
-    // TODO: add multiprocessor support
     cpu_affinity: CpuSet,
 }
 
@@ -132,6 +138,11 @@ unsafe impl Sync for Task {}
 
 pub(crate) struct TaskInner {
     pub task_status: TaskStatus,
+    /// A waker of the task that is no longer used, which can be reused by the next
+    /// [`Waiter`] of the task to avoid allocating a new waker.
+    ///
+    /// [`Waiter`]: crate::sync::Waiter
+    pub cached_waker: Option<Arc<Waker>>,
 }
 
 impl Task {
@@ -173,6 +184,11 @@ impl Task {
         &self.data
     }
 
+    /// Returns the range of the kernel stack of this task.
+    pub(crate) fn kernel_stack_range(&self) -> Range<Vaddr> {
+        self.kstack.vaddr_range()
+    }
+
     /// Returns the user space of this task, if it has.
     pub fn user_space(&self) -> Option<&Arc<UserSpace>> {
         if self.user_space.is_some() {
@@ -189,7 +205,13 @@ impl Task {
     /// **NOTE:** If there is anything left on the stack, it will be forgotten. This behavior may
     /// lead to resource leakage.
     fn exit(self: Arc<Self>) -> ! {
-        self.inner_exclusive_access().task_status = TaskStatus::Exited;
+        let cached_waker = {
+            let mut task_inner = self.inner_exclusive_access();
+            task_inner.task_status = TaskStatus::Exited;
+            // The cached waker refers to the task, so it must be dropped to break the cycle.
+            task_inner.cached_waker.take()
+        };
+        drop(cached_waker);
 
         // `current_task()` still holds a strong reference, so nothing is destroyed at this point,
         // neither is the kernel stack.
@@ -203,6 +225,16 @@ impl Task {
     pub fn is_real_time(&self) -> bool {
         self.priority.is_real_time()
     }
+
+    /// Returns the priority of the task.
+    pub fn priority(&self) -> Priority {
+        self.priority
+    }
+
+    /// Returns the set of CPUs that the task is allowed to run on.
+    pub fn cpu_affinity(&self) -> &CpuSet {
+        &self.cpu_affinity
+    }
 }
 
 #[derive(Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Debug)]
@@ -299,6 +331,7 @@ impl TaskOptions {
             user_space: self.user_space,
             task_inner: SpinLock::new(TaskInner {
                 task_status: TaskStatus::Runnable,
+                cached_waker: None,
             }),
             ctx: UnsafeCell::new(TaskContext::default()),
             kstack: KernelStack::new_with_guard_page()?,
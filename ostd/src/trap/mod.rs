@@ -7,7 +7,7 @@ mod irq;
 pub mod softirq;
 
 pub use handler::in_interrupt_context;
-pub use softirq::SoftIrqLine;
+pub use softirq::{handle_deferred, SoftIrqLine, SoftIrqStats};
 pub use trapframe::TrapFrame;
 
 pub(crate) use self::handler::call_irq_callback_functions;
@@ -5,11 +5,17 @@
 #![allow(unused_variables)]
 
 use alloc::boxed::Box;
-use core::sync::atomic::{AtomicBool, AtomicU8, Ordering};
+use core::sync::atomic::{AtomicBool, AtomicU64, AtomicU8, Ordering};
 
 use spin::Once;
 
-use crate::{cpu_local, task::disable_preempt, CpuLocal};
+use crate::{
+    arch::{read_tsc, tsc_freq},
+    cpu_local,
+    sync::WaitQueue,
+    task::disable_preempt,
+    CpuLocal,
+};
 
 /// A representation of a software interrupt (softirq) line.
 ///
@@ -25,6 +31,10 @@ use crate::{cpu_local, task::disable_preempt, CpuLocal};
 ///
 /// The `SoftIrqLine` with the smaller ID has the higher execution priority.
 ///
+/// The pending softirqs are processed on the exit of interrupts within a budget of time
+/// and rounds. The softirqs that are not processed within the budget are deferred to
+/// the softirq daemon of the CPU, see [`handle_deferred`].
+///
 /// # Example
 ///
 /// ```
@@ -41,11 +51,24 @@ use crate::{cpu_local, task::disable_preempt, CpuLocal};
 pub struct SoftIrqLine {
     id: u8,
     callback: Once<Box<dyn Fn() + 'static + Sync + Send>>,
+    /// The number of times that the callback has been executed.
+    count: AtomicU64,
+    /// The total TSC cycles spent in the callback.
+    cycles: AtomicU64,
+}
+
+/// The statistics of a [`SoftIrqLine`].
+#[derive(Clone, Copy, Debug)]
+pub struct SoftIrqStats {
+    /// The number of times that the softirq has been handled.
+    pub count: u64,
+    /// The total time spent in handling the softirq in nanoseconds.
+    pub total_ns: u64,
 }
 
 impl SoftIrqLine {
     /// The number of softirq lines.
-    const NR_LINES: u8 = 8;
+    pub const NR_LINES: u8 = 8;
 
     /// Gets a softirq line.
     ///
@@ -58,6 +81,8 @@ impl SoftIrqLine {
         Self {
             id,
             callback: Once::new(),
+            count: AtomicU64::new(0),
+            cycles: AtomicU64::new(0),
         }
     }
 
@@ -94,6 +119,28 @@ impl SoftIrqLine {
     pub fn is_enabled(&self) -> bool {
         ENABLED_MASK.load(Ordering::Acquire) & (1 << self.id) != 0
     }
+
+    /// Returns the statistics of this softirq line.
+    pub fn stats(&self) -> SoftIrqStats {
+        let cycles = self.cycles.load(Ordering::Relaxed);
+        let total_ns = match tsc_freq() {
+            0 => 0,
+            freq => (cycles as u128 * 1_000_000_000 / freq as u128) as u64,
+        };
+        SoftIrqStats {
+            count: self.count.load(Ordering::Relaxed),
+            total_ns,
+        }
+    }
+
+    fn handle(&self) {
+        let start = read_tsc();
+        self.callback.get().unwrap()();
+        let cycles = read_tsc().wrapping_sub(start);
+
+        self.count.fetch_add(1, Ordering::Relaxed);
+        self.cycles.fetch_add(cycles, Ordering::Relaxed);
+    }
 }
 
 /// A slice that stores the [`SoftIrqLine`]s, whose ID is equal to its offset in the slice.
@@ -110,8 +157,15 @@ static ENABLED_MASK: AtomicU8 = AtomicU8::new(0);
 cpu_local! {
     static PENDING_MASK: AtomicU8 = AtomicU8::new(0);
     static IS_ENABLED: AtomicBool = AtomicBool::new(true);
+    /// Whether the pending softirqs are deferred to the softirq daemon.
+    static IS_DEFERRED: AtomicBool = AtomicBool::new(false);
+    /// The wait queue of the softirq daemon.
+    static DAEMON_QUEUE: WaitQueue = WaitQueue::new();
 }
 
+/// Whether the softirq daemons are running, so that softirqs can be deferred to them.
+static HAS_DAEMON: AtomicBool = AtomicBool::new(false);
+
 /// Enables softirq in current processor.
 fn enable_softirq_local() {
     CpuLocal::borrow_with(&IS_ENABLED, |is_enabled| {
@@ -131,22 +185,89 @@ fn is_softirq_enabled() -> bool {
     CpuLocal::borrow_with(&IS_ENABLED, |is_enabled| is_enabled.load(Ordering::Acquire))
 }
 
-/// Processes pending softirqs.
+/// Processes pending softirqs on the exit of interrupts.
 ///
-/// The processing instructions will iterate for `SOFTIRQ_RUN_TIMES` times. If any softirq
-/// is raised during the iteration, it will be processed.
+/// If the pending softirqs are not all processed within the budget, the rest are deferred
+/// to the softirq daemon of the current CPU, so that they do not starve the tasks. The
+/// pending softirqs are not processed here until the daemon catches up.
 pub(crate) fn process_pending() {
+    if !HAS_DAEMON.load(Ordering::Acquire) {
+        process_within_budget();
+        return;
+    }
+
+    if CpuLocal::borrow_with(&IS_DEFERRED, |is_deferred| {
+        is_deferred.load(Ordering::Acquire)
+    }) {
+        return;
+    }
+    if process_within_budget() {
+        CpuLocal::borrow_with(&IS_DEFERRED, |is_deferred| {
+            is_deferred.store(true, Ordering::Release)
+        });
+        DAEMON_QUEUE.wake_one();
+    }
+}
+
+/// Handles the softirqs deferred to the softirq daemon of the current CPU.
+///
+/// This method waits until some softirqs are deferred, and then processes the pending
+/// softirqs within the budget. It is meant to be called in a loop by a kernel thread
+/// bound to the CPU, i.e., the softirq daemon, which should yield between the calls so
+/// that the other tasks can make progress.
+pub fn handle_deferred() {
+    HAS_DAEMON.store(true, Ordering::Release);
+
+    DAEMON_QUEUE.wait_until(|| {
+        CpuLocal::borrow_with(&IS_DEFERRED, |is_deferred| {
+            is_deferred.load(Ordering::Acquire)
+        })
+        .then_some(())
+    });
+
+    if process_within_budget() {
+        return;
+    }
+
+    // Check again with the local IRQs disabled, so that no softirq raised by the interrupts
+    // is left unprocessed after the daemon stops handling them.
+    let _irq_guard = crate::trap::disable_local();
+    if CpuLocal::borrow_with(&PENDING_MASK, |mask| mask.load(Ordering::Acquire)) == 0 {
+        CpuLocal::borrow_with(&IS_DEFERRED, |is_deferred| {
+            is_deferred.store(false, Ordering::Release)
+        });
+    }
+}
+
+/// Processes pending softirqs within the budget.
+///
+/// The processing instructions will iterate for at most `SOFTIRQ_RUN_TIMES` times and
+/// `SOFTIRQ_RUN_MILLIS` milliseconds. If any softirq is raised during the iteration, it
+/// will be processed.
+///
+/// Returns whether there are pending softirqs that are not processed due to the budget.
+fn process_within_budget() -> bool {
     const SOFTIRQ_RUN_TIMES: u8 = 5;
+    const SOFTIRQ_RUN_MILLIS: u64 = 2;
 
     if !is_softirq_enabled() {
-        return;
+        return false;
     }
 
     let preempt_guard = disable_preempt();
     disable_softirq_local();
 
-    CpuLocal::borrow_with(&PENDING_MASK, |mask| {
+    let deadline = match tsc_freq() {
+        0 => u64::MAX,
+        freq => read_tsc().saturating_add(freq / 1000 * SOFTIRQ_RUN_MILLIS),
+    };
+
+    let is_remaining = CpuLocal::borrow_with(&PENDING_MASK, |mask| {
         for i in 0..SOFTIRQ_RUN_TIMES {
+            if i > 0 && read_tsc() >= deadline {
+                break;
+            }
+
             // will not reactive in this handling.
             let mut action_mask = {
                 let pending_mask = mask.fetch_and(0, Ordering::Acquire);
@@ -154,14 +275,17 @@ pub(crate) fn process_pending() {
             };
 
             if action_mask == 0 {
-                return;
+                return false;
             }
             while action_mask > 0 {
                 let action_id = u8::trailing_zeros(action_mask) as u8;
-                SoftIrqLine::get(action_id).callback.get().unwrap()();
+                SoftIrqLine::get(action_id).handle();
                 action_mask &= action_mask - 1;
             }
         }
+        mask.load(Ordering::Acquire) & ENABLED_MASK.load(Ordering::Acquire) != 0
     });
     enable_softirq_local();
+
+    is_remaining
 }
@@ -4,17 +4,36 @@
 
 //! User space.
 
+use core::sync::atomic::{AtomicPtr, Ordering};
+
 use trapframe::TrapFrame;
 
-use crate::{cpu::UserContext, mm::VmSpace, prelude::*, task::Task};
+use crate::{
+    cpu::UserContext,
+    mm::VmSpace,
+    prelude::*,
+    sync::SpinLock,
+    task::{current_task, disable_preempt, Task},
+};
 
 /// A user space.
 ///
 /// Each user space has a VM address space and allows a task to execute in
 /// user mode.
 pub struct UserSpace {
-    /// vm space
-    vm_space: Arc<VmSpace>,
+    /// vm space, which is converted from an `Arc<VmSpace>` with `Arc::into_raw`
+    ///
+    /// It is read without locking, since the VM address space is accessed on every
+    /// copy from and to the user space.
+    vm_space: AtomicPtr<VmSpace>,
+    /// The VM address spaces that have been replaced, which are kept alive as long as
+    /// the user space, so that the references handed out by [`UserSpace::vm_space`]
+    /// remain valid.
+    ///
+    /// A VM address space is replaced only if it is shared with another process, e.g.,
+    /// at `exec` after `vfork`, in which case it is kept alive by the other process
+    /// anyway. So this rarely holds more than one VM address space.
+    retired_vm_spaces: SpinLock<Vec<Arc<VmSpace>>>,
     /// cpu context before entering user space
     init_ctx: UserContext,
 }
@@ -25,12 +44,44 @@ impl UserSpace {
     /// Each instance maintains a VM address space and the CPU state to enable
     /// execution in the user space.
     pub fn new(vm_space: Arc<VmSpace>, init_ctx: UserContext) -> Self {
-        Self { vm_space, init_ctx }
+        Self {
+            vm_space: AtomicPtr::new(Arc::into_raw(vm_space).cast_mut()),
+            retired_vm_spaces: SpinLock::new(Vec::new()),
+            init_ctx,
+        }
     }
 
     /// Returns the VM address space.
     pub fn vm_space(&self) -> &VmSpace {
-        &self.vm_space
+        let ptr = self.vm_space.load(Ordering::Acquire);
+        // SAFETY: The pointer is converted from an `Arc<VmSpace>` with `Arc::into_raw`.
+        // The `Arc` is dropped only when the user space is dropped, either as the current
+        // VM address space or as a retired one, so it outlives the borrow of `self`.
+        unsafe { &*ptr }
+    }
+
+    /// Replaces the VM address space, e.g., when a new program is loaded.
+    ///
+    /// If the user space belongs to the current task, the new VM address space
+    /// is activated at once. Otherwise, it is activated the next time the task
+    /// is scheduled.
+    pub fn set_vm_space(&self, vm_space: Arc<VmSpace>) {
+        let mut retired_vm_spaces = self.retired_vm_spaces.lock_irq_disabled();
+        let preempt_guard = disable_preempt();
+        let new_ptr = Arc::into_raw(vm_space).cast_mut();
+        let old_ptr = self.vm_space.swap(new_ptr, Ordering::AcqRel);
+        let is_current = current_task()
+            .and_then(|task| task.user_space().map(|user_space| Arc::as_ptr(user_space)))
+            .is_some_and(|user_space| core::ptr::eq(user_space, self));
+        if is_current {
+            // SAFETY: The new VM address space is kept alive by the user space.
+            unsafe { &*new_ptr }.activate();
+        }
+        drop(preempt_guard);
+
+        // SAFETY: The pointer is converted from an `Arc<VmSpace>` with `Arc::into_raw`,
+        // and its ownership is taken back only once since it has been swapped out.
+        retired_vm_spaces.push(unsafe { Arc::from_raw(old_ptr) });
     }
 
     /// Returns the user mode that is bound to the current task and user space.
@@ -48,6 +99,15 @@ impl UserSpace {
     }
 }
 
+impl Drop for UserSpace {
+    fn drop(&mut self) {
+        let ptr = *self.vm_space.get_mut();
+        // SAFETY: The pointer is converted from an `Arc<VmSpace>` with `Arc::into_raw`,
+        // and the user space is exclusively owned, so no references to it remain.
+        drop(unsafe { Arc::from_raw(ptr) });
+    }
+}
+
 /// Specific architectures need to implement this trait. This should only used in [`UserMode`]
 ///
 /// Only visible in `ostd`.
@@ -137,6 +197,11 @@ impl<'a> UserMode<'a> {
         F: FnMut() -> bool,
     {
         debug_assert!(Arc::ptr_eq(&self.current, &Task::current()));
+        if crate::task::is_preemptive() {
+            // SAFETY: Returning to the user space is a quiescent state since the
+            // preemption is enabled.
+            unsafe { crate::sync::pass_quiescent_state() };
+        }
         self.context.execute(has_kernel_event)
     }
 
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: MPL-2.0
+
+// Tests that the cached lookups, including the failed ones, are kept
+// consistent with the creations, removals and renames of files.
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../network/test.h"
+
+static char dir[64];
+static char path_a[128];
+static char path_b[128];
+static char path_c[128];
+static struct stat st;
+
+FN_SETUP(paths)
+{
+	snprintf(dir, sizeof(dir), "/tmp/dentry_cache_%d", getpid());
+	snprintf(path_a, sizeof(path_a), "%s/a", dir);
+	snprintf(path_b, sizeof(path_b), "%s/b", dir);
+	snprintf(path_c, sizeof(path_c), "%s/c", dir);
+	CHECK(mkdir(dir, 0755));
+}
+END_SETUP()
+
+FN_TEST(create_after_failed_lookup)
+{
+	int fd;
+
+	// Fail twice, so that the second lookup hits the negative dentry.
+	TEST_ERRNO(stat(path_a, &st), ENOENT);
+	TEST_ERRNO(stat(path_a, &st), ENOENT);
+
+	fd = TEST_SUCC(open(path_a, O_RDWR | O_CREAT | O_EXCL, 0644));
+	TEST_SUCC(close(fd));
+	TEST_RES(stat(path_a, &st), S_ISREG(st.st_mode));
+}
+END_TEST()
+
+FN_TEST(mkdir_after_failed_lookup)
+{
+	TEST_ERRNO(stat(path_c, &st), ENOENT);
+	TEST_SUCC(mkdir(path_c, 0755));
+	TEST_RES(stat(path_c, &st), S_ISDIR(st.st_mode));
+	TEST_SUCC(rmdir(path_c));
+	TEST_ERRNO(stat(path_c, &st), ENOENT);
+}
+END_TEST()
+
+FN_TEST(rename_to_failed_lookup)
+{
+	TEST_ERRNO(stat(path_b, &st), ENOENT);
+	TEST_SUCC(rename(path_a, path_b));
+	TEST_ERRNO(stat(path_a, &st), ENOENT);
+	TEST_RES(stat(path_b, &st), S_ISREG(st.st_mode));
+}
+END_TEST()
+
+FN_TEST(link_to_failed_lookup)
+{
+	TEST_ERRNO(stat(path_a, &st), ENOENT);
+	TEST_SUCC(link(path_b, path_a));
+	TEST_RES(stat(path_a, &st), st.st_nlink == 2);
+}
+END_TEST()
+
+FN_TEST(unlink)
+{
+	TEST_SUCC(unlink(path_a));
+	TEST_SUCC(unlink(path_b));
+	TEST_ERRNO(stat(path_a, &st), ENOENT);
+	TEST_ERRNO(stat(path_b, &st), ENOENT);
+	TEST_SUCC(rmdir(dir));
+}
+END_TEST()
@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: MPL-2.0
+
+#define _GNU_SOURCE
+
+#include <err.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#define NR_WAITERS 4
+#define MAX_EVENTS 8
+#define CHECK(cond, msg)                       \
+	do {                                   \
+		if (!(cond))                   \
+			err(EXIT_FAILURE, msg); \
+	} while (0)
+
+static int epfd;
+static int nr_reported;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void add_fd(int fd, unsigned int events)
+{
+	struct epoll_event ev = { .events = events, .data.fd = fd };
+	CHECK(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == 0, "epoll_ctl add");
+}
+
+static void test_exclusive_ctl(int fd)
+{
+	struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+
+	ev.events = EPOLLIN | EPOLLEXCLUSIVE | EPOLLONESHOT;
+	CHECK(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == -1 && errno == EINVAL,
+	      "EPOLLEXCLUSIVE with EPOLLONESHOT");
+
+	ev.events = EPOLLPRI | EPOLLEXCLUSIVE;
+	CHECK(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == -1 && errno == EINVAL,
+	      "EPOLLEXCLUSIVE with EPOLLPRI");
+
+	add_fd(fd, EPOLLIN | EPOLLEXCLUSIVE);
+
+	ev.events = EPOLLIN;
+	CHECK(epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) == -1 && errno == EINVAL,
+	      "modify an EPOLLEXCLUSIVE entry");
+
+	CHECK(epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL) == 0, "epoll_ctl del");
+}
+
+static void test_trigger_modes(void)
+{
+	struct epoll_event events[MAX_EVENTS];
+	int lt_pipe[2], et_pipe[2], oneshot_pipe[2];
+
+	CHECK(pipe(lt_pipe) == 0 && pipe(et_pipe) == 0 &&
+		      pipe(oneshot_pipe) == 0,
+	      "pipe");
+	add_fd(lt_pipe[0], EPOLLIN);
+	add_fd(et_pipe[0], EPOLLIN | EPOLLET);
+	add_fd(oneshot_pipe[0], EPOLLIN | EPOLLONESHOT);
+
+	CHECK(epoll_wait(epfd, events, MAX_EVENTS, 0) == 0,
+	      "nothing is ready");
+	CHECK(epoll_wait(epfd, events, MAX_EVENTS, 10) == 0,
+	      "timeout expires");
+
+	CHECK(write(lt_pipe[1], "a", 1) == 1 && write(et_pipe[1], "a", 1) == 1 &&
+		      write(oneshot_pipe[1], "a", 1) == 1,
+	      "write");
+
+	// Only one event is reported at a time, but none of them gets lost.
+	for (int i = 0; i < 3; i++)
+		CHECK(epoll_wait(epfd, events, 1, 0) == 1,
+		      "report events one by one");
+
+	// Only the level-triggered entry is still there.
+	CHECK(epoll_wait(epfd, events, MAX_EVENTS, 0) == 1 &&
+		      events[0].data.fd == lt_pipe[0],
+	      "report level-triggered events again");
+
+	for (int i = 0; i < 2; i++) {
+		close(lt_pipe[i]);
+		close(et_pipe[i]);
+		close(oneshot_pipe[i]);
+	}
+}
+
+static void *wait_for_events(void *arg)
+{
+	struct epoll_event events[MAX_EVENTS];
+	int nr_events = epoll_wait(epfd, events, MAX_EVENTS, 500);
+
+	CHECK(nr_events >= 0, "epoll_wait");
+	pthread_mutex_lock(&lock);
+	nr_reported += nr_events;
+	pthread_mutex_unlock(&lock);
+	return NULL;
+}
+
+static void test_shared_waiters(void)
+{
+	pthread_t threads[NR_WAITERS];
+	int fds[2];
+
+	CHECK(pipe(fds) == 0, "pipe");
+	add_fd(fds[0], EPOLLIN | EPOLLET | EPOLLEXCLUSIVE);
+
+	for (int i = 0; i < NR_WAITERS; i++)
+		CHECK(pthread_create(&threads[i], NULL, wait_for_events,
+				     NULL) == 0,
+		      "pthread_create");
+	usleep(100 * 1000);
+	CHECK(write(fds[1], "a", 1) == 1, "write");
+	for (int i = 0; i < NR_WAITERS; i++)
+		CHECK(pthread_join(threads[i], NULL) == 0, "pthread_join");
+
+	// An edge-triggered event is reported to exactly one of the waiters.
+	CHECK(nr_reported == 1, "report an event to a single waiter");
+
+	close(fds[0]);
+	close(fds[1]);
+}
+
+int main(void)
+{
+	int fds[2];
+
+	epfd = epoll_create1(0);
+	CHECK(epfd >= 0, "epoll_create1");
+
+	CHECK(pipe(fds) == 0, "pipe");
+	test_exclusive_ctl(fds[0]);
+	close(fds[0]);
+	close(fds[1]);
+
+	test_trigger_modes();
+	test_shared_waiters();
+
+	close(epfd);
+	printf("All epoll tests passed.\n");
+	return 0;
+}
@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: MPL-2.0
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_NR_FDS 10000
+#define NUM_OF_ROUNDS 1000000
+
+// Makes room for the watched file descriptors, in addition to the standard
+// streams and the epoll instance.
+static int raise_nofile_limit(int nr_fds)
+{
+	struct rlimit limit;
+
+	if (getrlimit(RLIMIT_NOFILE, &limit) < 0) {
+		perror("getrlimit");
+		return -1;
+	}
+	if (limit.rlim_cur >= (rlim_t)nr_fds + 16)
+		return 0;
+
+	limit.rlim_cur = nr_fds + 16;
+	if (limit.rlim_max < limit.rlim_cur)
+		limit.rlim_max = limit.rlim_cur;
+	if (setrlimit(RLIMIT_NOFILE, &limit) < 0) {
+		perror("setrlimit");
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct timespec start, end;
+	struct epoll_event event;
+	int nr_fds, epfd, *fds;
+	long total_nanoseconds, avg_latency;
+	uint64_t value = 1;
+	unsigned int seed = 1;
+
+	nr_fds = argc > 1 ? atoi(argv[1]) : DEFAULT_NR_FDS;
+	if (raise_nofile_limit(nr_fds) < 0)
+		return 1;
+
+	fds = malloc(sizeof(int) * nr_fds);
+	if (fds == NULL) {
+		perror("malloc");
+		return 1;
+	}
+
+	epfd = epoll_create1(0);
+	if (epfd < 0) {
+		perror("epoll_create1");
+		return 1;
+	}
+
+	for (int i = 0; i < nr_fds; i++) {
+		fds[i] = eventfd(0, EFD_NONBLOCK);
+		if (fds[i] < 0) {
+			perror("eventfd");
+			return 1;
+		}
+		event.events = EPOLLIN;
+		event.data.u32 = i;
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i], &event) < 0) {
+			perror("epoll_ctl");
+			return 1;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	// In each round, one of the watched file descriptors becomes ready, which
+	// should cost the same no matter how many file descriptors are watched.
+	for (int i = 0; i < NUM_OF_ROUNDS; i++) {
+		int fd = fds[rand_r(&seed) % nr_fds];
+
+		if (write(fd, &value, sizeof(value)) != sizeof(value)) {
+			perror("write");
+			return 1;
+		}
+		if (epoll_wait(epfd, &event, 1, -1) != 1) {
+			perror("epoll_wait");
+			return 1;
+		}
+		if (read(fds[event.data.u32], &value, sizeof(value)) !=
+		    sizeof(value)) {
+			perror("read");
+			return 1;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	total_nanoseconds = (end.tv_sec - start.tv_sec) * 1000000000L +
+			    (end.tv_nsec - start.tv_nsec);
+	avg_latency = total_nanoseconds / NUM_OF_ROUNDS;
+
+	printf("Woke up epoll_wait with one of %d eventfds %d times.\n", nr_fds,
+	       NUM_OF_ROUNDS);
+	printf("Epoll average latency with %d fds: %ld nanoseconds.\n", nr_fds,
+	       avg_latency);
+
+	for (int i = 0; i < nr_fds; i++)
+		close(fds[i]);
+	close(epfd);
+	free(fds);
+
+	return 0;
+}
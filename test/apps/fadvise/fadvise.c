@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: MPL-2.0
+
+// Tests that the advice on the page cache and the readahead do not change
+// what is read, even if the file is read by interleaved streams.
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "../network/test.h"
+
+#define PAGE_SIZE 4096
+#define NR_PAGES 256
+#define NR_STREAMS 4
+
+static const char *file_path = "/ext2/test_fadvise.txt";
+static int fd;
+static char buf[PAGE_SIZE];
+
+static int check_page(int page_idx)
+{
+	if (pread(fd, buf, PAGE_SIZE, (off_t)page_idx * PAGE_SIZE) != PAGE_SIZE)
+		return -1;
+	for (int i = 0; i < PAGE_SIZE; i++)
+		if (buf[i] != (char)page_idx)
+			return -1;
+	return 0;
+}
+
+FN_SETUP(file)
+{
+	fd = CHECK(open(file_path, O_RDWR | O_CREAT | O_TRUNC, 0644));
+	for (int i = 0; i < NR_PAGES; i++) {
+		memset(buf, i, PAGE_SIZE);
+		CHECK_WITH(write(fd, buf, PAGE_SIZE), _ret == PAGE_SIZE);
+	}
+	CHECK(fsync(fd));
+	// Drop the clean pages, so that they are read from the disk again.
+	CHECK_WITH(posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED), _ret == 0);
+}
+END_SETUP()
+
+FN_TEST(interleaved_streams)
+{
+	int stream, i;
+
+	// `posix_fadvise` returns the error number instead of setting `errno`.
+	TEST_RES(posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL), _ret == 0);
+	for (i = 0; i < NR_PAGES / NR_STREAMS; i++) {
+		for (stream = 0; stream < NR_STREAMS; stream++) {
+			TEST_RES(check_page(stream * (NR_PAGES / NR_STREAMS) +
+					    i),
+				 _ret == 0);
+		}
+	}
+}
+END_TEST()
+
+FN_TEST(random_reads)
+{
+	TEST_RES(posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED), _ret == 0);
+	TEST_RES(posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM), _ret == 0);
+	for (int i = 0; i < NR_PAGES; i += 17) {
+		int page = (i * 7) % NR_PAGES;
+		TEST_RES(check_page(page), _ret == 0);
+	}
+	TEST_RES(posix_fadvise(fd, 0, 0, POSIX_FADV_NORMAL), _ret == 0);
+}
+END_TEST()
+
+FN_TEST(willneed)
+{
+	TEST_RES(posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED), _ret == 0);
+	TEST_RES(posix_fadvise(fd, PAGE_SIZE * 8, PAGE_SIZE * 64,
+			       POSIX_FADV_WILLNEED),
+		 _ret == 0);
+	TEST_SUCC(readahead(fd, PAGE_SIZE * 128, PAGE_SIZE * 64));
+	for (int i = 0; i < NR_PAGES; i++)
+		TEST_RES(check_page(i), _ret == 0);
+}
+END_TEST()
+
+FN_TEST(huge_length)
+{
+	// The ranges that extend beyond the end of the file are clamped to it.
+	TEST_RES(posix_fadvise(fd, PAGE_SIZE, LLONG_MAX, POSIX_FADV_DONTNEED),
+		 _ret == 0);
+	TEST_RES(posix_fadvise(fd, PAGE_SIZE, LLONG_MAX, POSIX_FADV_WILLNEED),
+		 _ret == 0);
+	TEST_RES(posix_fadvise(fd, LLONG_MAX, 0, POSIX_FADV_WILLNEED),
+		 _ret == 0);
+	TEST_SUCC(readahead(fd, 0, SSIZE_MAX));
+	for (int i = 0; i < NR_PAGES; i++)
+		TEST_RES(check_page(i), _ret == 0);
+}
+END_TEST()
+
+FN_TEST(invalid_advice)
+{
+	int pipe_fds[2];
+
+	TEST_RES(posix_fadvise(fd, 0, 0, 100), _ret == EINVAL);
+	TEST_RES(posix_fadvise(fd, 0, -1, POSIX_FADV_NORMAL), _ret == EINVAL);
+
+	TEST_SUCC(pipe(pipe_fds));
+	TEST_RES(posix_fadvise(pipe_fds[0], 0, 0, POSIX_FADV_NORMAL),
+		 _ret == ESPIPE);
+	TEST_ERRNO(readahead(pipe_fds[0], 0, PAGE_SIZE), EINVAL);
+	TEST_SUCC(close(pipe_fds[0]));
+	TEST_SUCC(close(pipe_fds[1]));
+}
+END_TEST()
+
+FN_SETUP(cleanup)
+{
+	CHECK(close(fd));
+	CHECK(unlink(file_path));
+}
+END_SETUP()
@@ -72,8 +72,45 @@ int perform_sequential_io(int fd, ssize_t (*io_func)(int, void *, size_t),
 		     ((double)total_nanoseconds / 1e9);
 	printf("Executed the sequential %s (buffer size: %dKB, file size: %dMB) syscall %d times.\n",
 	       op_name, BUFFER_SIZE / KB, FILE_SIZE / MB, NUM_OF_CALLS);
-	printf("Syscall average latency: %ld nanoseconds, throughput: %.2f MB/s\n",
-	       avg_latency, throughput / MB);
+	printf("Sequential %s average latency: %ld nanoseconds, throughput: %.2f MB/s\n",
+	       op_name, avg_latency, throughput / MB);
+
+	return 0;
+}
+
+int perform_random_io(int fd, ssize_t (*io_func)(int, void *, size_t, off_t),
+		      const char *op_name)
+{
+	struct timespec start, end;
+	char buffer[BUFFER_SIZE];
+	ssize_t ret;
+	off_t offset;
+	long total_nanoseconds = 0, avg_latency;
+	double throughput;
+	unsigned int seed = 1;
+
+	memset(buffer, 0, BUFFER_SIZE);
+
+	for (int i = 0; i < NUM_OF_CALLS; i++) {
+		offset = (off_t)(rand_r(&seed) % (FILE_SIZE / BUFFER_SIZE)) *
+			 BUFFER_SIZE;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		ret = io_func(fd, buffer, BUFFER_SIZE, offset);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		if (ret == -1) {
+			fprintf(stderr, "Failed to %s the file.\n", op_name);
+			return -1;
+		}
+		total_nanoseconds += calc_duration(&start, &end);
+	}
+
+	avg_latency = total_nanoseconds / NUM_OF_CALLS;
+	throughput = ((double)BUFFER_SIZE * NUM_OF_CALLS) /
+		     ((double)total_nanoseconds / 1e9);
+	printf("Executed the random %s (buffer size: %dKB, file size: %dMB) syscall %d times.\n",
+	       op_name, BUFFER_SIZE / KB, FILE_SIZE / MB, NUM_OF_CALLS);
+	printf("Random %s average latency: %ld nanoseconds, throughput: %.2f MB/s\n",
+	       op_name, avg_latency, throughput / MB);
 
 	return 0;
 }
@@ -85,7 +122,19 @@ int sequential_read(int fd)
 
 int sequential_write(int fd)
 {
-	return perform_sequential_io(fd, write, "write");
+	return perform_sequential_io(
+		fd, (ssize_t(*)(int, void *, size_t))write, "write");
+}
+
+int random_read(int fd)
+{
+	return perform_random_io(fd, pread, "read");
+}
+
+int random_write(int fd)
+{
+	return perform_random_io(
+		fd, (ssize_t(*)(int, void *, size_t, off_t))pwrite, "write");
 }
 
 int main(int argc, char *argv[])
@@ -126,7 +175,16 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
-	// TODO: Add more test cases such as random read and random write.
+	if (random_read(fd) < 0) {
+		fprintf(stderr, "Failed to do random read on the file: %s.\n",
+			argv[1]);
+		return -1;
+	}
+	if (random_write(fd) < 0) {
+		fprintf(stderr, "Failed to do random write on the file: %s.\n",
+			argv[1]);
+		return -1;
+	}
 
 	close(fd);
 	if (unlink(argv[1]) < 0) {
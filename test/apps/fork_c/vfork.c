@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: MPL-2.0
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../network/test.h"
+
+static int pipe_fds[2];
+
+FN_SETUP(pipe)
+{
+	CHECK(pipe2(pipe_fds, O_NONBLOCK));
+}
+END_SETUP()
+
+FN_TEST(vfork_exit)
+{
+	char byte = 0;
+	int status;
+	pid_t pid;
+
+	// The child must not touch the test state, which is shared with the parent on Linux.
+	pid = CHECK(vfork());
+	if (pid == 0) {
+		// The parent must not run until the child exits.
+		usleep(100 * 1000);
+		_exit(write(pipe_fds[1], "a", 1) == 1 ? 0 : 1);
+	}
+
+	TEST_RES(read(pipe_fds[0], &byte, 1), _ret == 1 && byte == 'a');
+	TEST_RES(waitpid(pid, &status, 0),
+		 _ret == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+END_TEST()
+
+static volatile int shared_value;
+
+FN_TEST(vfork_shared_memory)
+{
+	int status;
+	pid_t pid;
+
+	shared_value = 0;
+	pid = CHECK(vfork());
+	if (pid == 0) {
+		// The child runs in the memory of the parent until it execs or exits.
+		shared_value = 1;
+		_exit(0);
+	}
+
+	TEST_RES(waitpid(pid, &status, 0),
+		 _ret == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	TEST_RES(shared_value, _ret == 1);
+}
+END_TEST()
+
+FN_TEST(vfork_execve)
+{
+	char *argv[] = { "hello", NULL };
+	char *envp[] = { NULL };
+	int status;
+	pid_t pid;
+
+	// The child must not touch the test state, which is shared with the parent on Linux.
+	pid = CHECK(vfork());
+	if (pid == 0) {
+		execve("/test/execve/hello", argv, envp);
+		_exit(127);
+	}
+
+	TEST_RES(waitpid(pid, &status, 0),
+		 _ret == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+END_TEST()
@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: MPL-2.0
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PAGE_SIZE 4096
+#define NUM_OF_ROUNDS 100
+
+static const int default_rss_mib[] = { 1, 16, 64, 256 };
+
+// The program that the children execute, which is set if `--exec` is given.
+static const char *exec_path;
+
+static long fork_with_rss(int rss_mib)
+{
+	struct timespec start, end;
+	size_t map_size = (size_t)rss_mib << 20;
+	long total_nanoseconds = 0;
+	char *addr;
+
+	addr = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+
+	for (int i = 0; i < NUM_OF_ROUNDS; i++) {
+		pid_t pid;
+
+		// Dirty the memory so that every fork has to write-protect it again.
+		for (size_t offset = 0; offset < map_size; offset += PAGE_SIZE)
+			addr[offset] = (char)i;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		pid = fork();
+		if (pid < 0) {
+			perror("fork");
+			return -1;
+		}
+		if (pid == 0) {
+			if (exec_path != NULL) {
+				execl(exec_path, exec_path, "--exit", NULL);
+				perror("execl");
+				_exit(1);
+			}
+			_exit(0);
+		}
+		if (waitpid(pid, NULL, 0) != pid) {
+			perror("waitpid");
+			return -1;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		total_nanoseconds += (end.tv_sec - start.tv_sec) * 1000000000L +
+				     (end.tv_nsec - start.tv_nsec);
+	}
+
+	munmap(addr, map_size);
+
+	return total_nanoseconds / NUM_OF_ROUNDS;
+}
+
+static int run(int rss_mib)
+{
+	long avg_latency = fork_with_rss(rss_mib);
+
+	if (avg_latency < 0)
+		return -1;
+
+	printf("%s average latency with %d MiB RSS: %ld nanoseconds.\n",
+	       exec_path != NULL ? "Fork and exec" : "Fork", rss_mib,
+	       avg_latency);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int first_arg = 1;
+
+	// The executed children exit right away.
+	if (argc > 1 && strcmp(argv[1], "--exit") == 0)
+		return 0;
+	if (argc > 1 && strcmp(argv[1], "--exec") == 0) {
+		exec_path = argv[0];
+		first_arg = 2;
+	}
+
+	// Measure the latency of fork, exit and wait for each of the given RSS sizes.
+	// With `--exec`, the children execute a new program before exiting.
+	if (argc > first_arg) {
+		for (int i = first_arg; i < argc; i++) {
+			if (run(atoi(argv[i])) < 0)
+				return 1;
+		}
+		return 0;
+	}
+
+	for (size_t i = 0;
+	     i < sizeof(default_rss_mib) / sizeof(default_rss_mib[0]); i++) {
+		if (run(default_rss_mib[i]) < 0)
+			return 1;
+	}
+	return 0;
+}
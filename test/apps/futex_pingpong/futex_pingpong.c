@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: MPL-2.0
+
+#define _GNU_SOURCE
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NUM_OF_ROUNDS 100000
+
+struct pingpong {
+	// The owner of the ball, which is 0 for the pinger and 1 for the ponger.
+	_Atomic int turn;
+	long total_nanoseconds;
+} __attribute__((aligned(64)));
+
+static int get_nr_cpus(void)
+{
+	cpu_set_t set;
+
+	if (sched_getaffinity(0, sizeof(set), &set) < 0) {
+		perror("sched_getaffinity");
+		return 1;
+	}
+	return CPU_COUNT(&set);
+}
+
+static void futex_wait(_Atomic int *addr, int val)
+{
+	syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void futex_wake(_Atomic int *addr)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+// Passes the ball to the other thread and waits for it to come back.
+static void play(struct pingpong *pingpong, int me)
+{
+	atomic_store(&pingpong->turn, !me);
+	futex_wake(&pingpong->turn);
+	while (atomic_load(&pingpong->turn) != me)
+		futex_wait(&pingpong->turn, !me);
+}
+
+static void *ponger(void *arg)
+{
+	struct pingpong *pingpong = arg;
+
+	while (atomic_load(&pingpong->turn) != 1)
+		futex_wait(&pingpong->turn, 0);
+	for (int i = 0; i < NUM_OF_ROUNDS - 1; i++)
+		play(pingpong, 1);
+	atomic_store(&pingpong->turn, 0);
+	futex_wake(&pingpong->turn);
+	return NULL;
+}
+
+static void *pinger(void *arg)
+{
+	struct pingpong *pingpong = arg;
+	struct timespec start, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (int i = 0; i < NUM_OF_ROUNDS; i++)
+		play(pingpong, 0);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	pingpong->total_nanoseconds =
+		(end.tv_sec - start.tv_sec) * 1000000000L +
+		(end.tv_nsec - start.tv_nsec);
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	struct pingpong *pingpongs;
+	pthread_t *threads;
+	long total_nanoseconds = 0, avg_latency;
+	int nr_pairs;
+
+	// Occupy all CPUs with the pairs by default.
+	nr_pairs = argc > 1 ? atoi(argv[1]) : get_nr_cpus() / 2;
+	if (nr_pairs < 1)
+		nr_pairs = 1;
+
+	pingpongs = aligned_alloc(64, sizeof(struct pingpong) * nr_pairs);
+	threads = malloc(sizeof(pthread_t) * 2 * nr_pairs);
+	if (pingpongs == NULL || threads == NULL) {
+		perror("malloc");
+		return 1;
+	}
+
+	for (int i = 0; i < nr_pairs; i++) {
+		atomic_init(&pingpongs[i].turn, 0);
+		pingpongs[i].total_nanoseconds = 0;
+		if (pthread_create(&threads[2 * i], NULL, ponger,
+				   &pingpongs[i]) != 0 ||
+		    pthread_create(&threads[2 * i + 1], NULL, pinger,
+				   &pingpongs[i]) != 0) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+
+	for (int i = 0; i < 2 * nr_pairs; i++)
+		pthread_join(threads[i], NULL);
+
+	for (int i = 0; i < nr_pairs; i++)
+		total_nanoseconds += pingpongs[i].total_nanoseconds;
+	avg_latency = total_nanoseconds / ((long)NUM_OF_ROUNDS * nr_pairs);
+
+	printf("Passed the futex between each of %d pairs of threads %d times.\n",
+	       nr_pairs, NUM_OF_ROUNDS);
+	printf("Futex average round-trip latency: %ld nanoseconds.\n",
+	       avg_latency);
+
+	free(threads);
+	free(pingpongs);
+
+	return 0;
+}
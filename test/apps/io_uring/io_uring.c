@@ -0,0 +1,417 @@
+// SPDX-License-Identifier: MPL-2.0
+
+// Tests the io_uring interface and compares the batched io_uring reads
+// with the synchronous `pread` calls.
+
+#define _GNU_SOURCE
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NR_ENTRIES 64
+#define IO_SIZE 4096
+#define NR_BLOCKS 256
+#define NR_ROUNDS 16
+#define CHECK(cond, msg)                       \
+	do {                                   \
+		if (!(cond))                   \
+			err(EXIT_FAILURE, msg); \
+	} while (0)
+
+struct ring {
+	int fd;
+	unsigned int sq_entries;
+	unsigned int cq_entries;
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_array;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	unsigned int nr_queued;
+};
+
+static int io_uring_setup(unsigned int entries, struct io_uring_params *params)
+{
+	return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int fd, unsigned int to_submit,
+			  unsigned int min_complete, unsigned int flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+		       NULL, 0);
+}
+
+static void ring_init(struct ring *ring)
+{
+	struct io_uring_params params;
+	size_t rings_size;
+	void *rings;
+
+	memset(&params, 0, sizeof(params));
+	ring->fd = io_uring_setup(NR_ENTRIES, &params);
+	CHECK(ring->fd >= 0, "io_uring_setup");
+	CHECK(params.features & IORING_FEAT_SINGLE_MMAP, "single mmap");
+
+	ring->sq_entries = params.sq_entries;
+	ring->cq_entries = params.cq_entries;
+	CHECK(ring->sq_entries == NR_ENTRIES &&
+		      ring->cq_entries == 2 * NR_ENTRIES,
+	      "ring sizes");
+
+	rings_size = params.sq_off.array +
+		     params.sq_entries * sizeof(unsigned int);
+	if (rings_size < params.cq_off.cqes +
+				 params.cq_entries * sizeof(struct io_uring_cqe))
+		rings_size = params.cq_off.cqes +
+			     params.cq_entries * sizeof(struct io_uring_cqe);
+	rings = mmap(NULL, rings_size, PROT_READ | PROT_WRITE,
+		     MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	CHECK(rings != MAP_FAILED, "mmap rings");
+	ring->sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe),
+			  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			  ring->fd, IORING_OFF_SQES);
+	CHECK(ring->sqes != MAP_FAILED, "mmap sqes");
+
+	ring->sq_head = rings + params.sq_off.head;
+	ring->sq_tail = rings + params.sq_off.tail;
+	ring->sq_array = rings + params.sq_off.array;
+	ring->cq_head = rings + params.cq_off.head;
+	ring->cq_tail = rings + params.cq_off.tail;
+	ring->cqes = rings + params.cq_off.cqes;
+	ring->nr_queued = 0;
+}
+
+static struct io_uring_sqe *ring_get_sqe(struct ring *ring)
+{
+	unsigned int tail = *ring->sq_tail + ring->nr_queued;
+	unsigned int head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	unsigned int index = tail & (ring->sq_entries - 1);
+	struct io_uring_sqe *sqe = &ring->sqes[index];
+
+	CHECK(tail - head < ring->sq_entries, "the SQ is full");
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sq_array[index] = index;
+	ring->nr_queued++;
+	return sqe;
+}
+
+static int ring_submit(struct ring *ring, unsigned int min_complete)
+{
+	unsigned int to_submit = ring->nr_queued;
+
+	__atomic_store_n(ring->sq_tail, *ring->sq_tail + to_submit,
+			 __ATOMIC_RELEASE);
+	ring->nr_queued = 0;
+	return io_uring_enter(ring->fd, to_submit, min_complete,
+			      min_complete ? IORING_ENTER_GETEVENTS : 0);
+}
+
+static int ring_peek_cqe(struct ring *ring, struct io_uring_cqe *cqe)
+{
+	unsigned int head = *ring->cq_head;
+	unsigned int tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+	if (head == tail)
+		return 0;
+	*cqe = ring->cqes[head & (ring->cq_entries - 1)];
+	__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+static void ring_wait_cqe(struct ring *ring, struct io_uring_cqe *cqe)
+{
+	while (!ring_peek_cqe(ring, cqe))
+		CHECK(io_uring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS) >=
+			      0,
+		      "io_uring_enter");
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void test_nop(struct ring *ring)
+{
+	struct io_uring_cqe cqe;
+	struct io_uring_sqe *sqe;
+	uint64_t seen = 0;
+
+	for (int i = 0; i < 8; i++) {
+		sqe = ring_get_sqe(ring);
+		sqe->opcode = IORING_OP_NOP;
+		sqe->user_data = i;
+	}
+	// An unsupported opcode fails in its CQE instead of the submission.
+	sqe = ring_get_sqe(ring);
+	sqe->opcode = 0xff;
+	sqe->user_data = 8;
+
+	CHECK(ring_submit(ring, 9) == 9, "submit NOPs");
+	for (int i = 0; i < 9; i++) {
+		CHECK(ring_peek_cqe(ring, &cqe), "reap a NOP");
+		if (cqe.user_data == 8)
+			CHECK(cqe.res == -EINVAL, "invalid opcode");
+		else
+			CHECK(cqe.res == 0, "NOP result");
+		seen |= 1ULL << cqe.user_data;
+	}
+	CHECK(seen == 0x1ff && !ring_peek_cqe(ring, &cqe), "all NOPs are reaped");
+}
+
+static void test_pipe(struct ring *ring)
+{
+	struct io_uring_cqe cqe;
+	struct io_uring_sqe *sqe;
+	char buf[8] = { 0 };
+	int fds[2];
+
+	CHECK(pipe(fds) == 0, "pipe");
+	CHECK(io_uring_enter(fds[0], 0, 0, 0) == -1 && errno == EOPNOTSUPP,
+	      "enter a non-io_uring file");
+
+	sqe = ring_get_sqe(ring);
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fds[0];
+	sqe->poll32_events = POLLIN;
+	sqe->user_data = 1;
+	sqe = ring_get_sqe(ring);
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = fds[0];
+	sqe->addr = (uintptr_t)buf;
+	sqe->len = sizeof(buf);
+	sqe->off = -1;
+	sqe->user_data = 2;
+
+	// Nothing completes before the pipe becomes readable.
+	CHECK(ring_submit(ring, 0) == 2, "submit pipe requests");
+	CHECK(io_uring_enter(ring->fd, 0, 0, IORING_ENTER_GETEVENTS) == 0,
+	      "run pending requests");
+	CHECK(!ring_peek_cqe(ring, &cqe), "the pipe is empty");
+
+	CHECK(write(fds[1], "hello", 5) == 5, "write");
+	for (int i = 0; i < 2; i++) {
+		ring_wait_cqe(ring, &cqe);
+		if (cqe.user_data == 1)
+			CHECK(cqe.res & POLLIN, "poll result");
+		else
+			CHECK(cqe.user_data == 2 && cqe.res == 5 &&
+				      strcmp(buf, "hello") == 0,
+			      "read result");
+	}
+
+	close(fds[0]);
+	close(fds[1]);
+}
+
+static int io_uring_register(int fd, unsigned int opcode, void *arg,
+			     unsigned int nr_args)
+{
+	return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void test_registered(struct ring *ring)
+{
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	struct io_uring_cqe cqe;
+	struct io_uring_sqe *sqe;
+	char bufs[2][8] = { "hello", { 0 } };
+	struct iovec iovs[2] = {
+		{ .iov_base = bufs[0], .iov_len = sizeof(bufs[0]) },
+		{ .iov_base = bufs[1], .iov_len = sizeof(bufs[1]) },
+	};
+	int fds[2], files[3];
+
+	CHECK(pipe(fds) == 0, "pipe");
+	files[0] = -1;
+	files[1] = fds[0];
+	files[2] = fds[1];
+	CHECK(io_uring_register(ring->fd, IORING_REGISTER_FILES, files, 3) == 0,
+	      "register files");
+	CHECK(io_uring_register(ring->fd, IORING_REGISTER_FILES, files, 3) ==
+			      -1 &&
+		      errno == EBUSY,
+	      "register files twice");
+	CHECK(io_uring_register(ring->fd, IORING_REGISTER_BUFFERS, iovs, 2) ==
+		      0,
+	      "register buffers");
+
+	// The read of the empty pipe is pending, so the wait times out.
+	sqe = ring_get_sqe(ring);
+	sqe->opcode = IORING_OP_READ_FIXED;
+	sqe->flags = IOSQE_FIXED_FILE;
+	sqe->fd = 1;
+	sqe->addr = (uintptr_t)bufs[1];
+	sqe->len = sizeof(bufs[1]);
+	sqe->off = -1;
+	sqe->buf_index = 1;
+	sqe->user_data = 1;
+	CHECK(ring_submit(ring, 0) == 1, "submit fixed read");
+	memset(&arg, 0, sizeof(arg));
+	ts.tv_sec = 0;
+	ts.tv_nsec = 10 * 1000 * 1000;
+	arg.ts = (uintptr_t)&ts;
+	CHECK(syscall(__NR_io_uring_enter, ring->fd, 0, 1,
+		      IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg,
+		      sizeof(arg)) == -1 &&
+		      errno == ETIME,
+	      "wait with a timeout");
+
+	// A fixed buffer must contain the whole range.
+	sqe = ring_get_sqe(ring);
+	sqe->opcode = IORING_OP_WRITE_FIXED;
+	sqe->flags = IOSQE_FIXED_FILE;
+	sqe->fd = 2;
+	sqe->addr = (uintptr_t)bufs[0];
+	sqe->len = sizeof(bufs[0]) + 1;
+	sqe->off = -1;
+	sqe->user_data = 2;
+	sqe = ring_get_sqe(ring);
+	sqe->opcode = IORING_OP_WRITE_FIXED;
+	sqe->flags = IOSQE_FIXED_FILE;
+	sqe->fd = 2;
+	sqe->addr = (uintptr_t)bufs[0];
+	sqe->len = 5;
+	sqe->off = -1;
+	sqe->user_data = 3;
+	CHECK(ring_submit(ring, 0) == 2, "submit fixed writes");
+
+	for (int i = 0; i < 3; i++) {
+		ring_wait_cqe(ring, &cqe);
+		if (cqe.user_data == 1)
+			CHECK(cqe.res == 5 && strcmp(bufs[1], "hello") == 0,
+			      "fixed read result");
+		else if (cqe.user_data == 2)
+			CHECK(cqe.res == -EFAULT, "out-of-range fixed buffer");
+		else
+			CHECK(cqe.user_data == 3 && cqe.res == 5,
+			      "fixed write result");
+	}
+
+	CHECK(io_uring_register(ring->fd, IORING_UNREGISTER_BUFFERS, NULL, 0) ==
+		      0,
+	      "unregister buffers");
+	CHECK(io_uring_register(ring->fd, IORING_UNREGISTER_FILES, NULL, 0) ==
+		      0,
+	      "unregister files");
+	CHECK(io_uring_register(ring->fd, IORING_UNREGISTER_FILES, NULL, 0) ==
+			      -1 &&
+		      errno == ENXIO,
+	      "unregister files twice");
+
+	close(fds[0]);
+	close(fds[1]);
+}
+
+static double bench_pread(int fd, char *bufs)
+{
+	double start = now();
+
+	for (int round = 0; round < NR_ROUNDS; round++)
+		for (int i = 0; i < NR_BLOCKS; i++)
+			CHECK(pread(fd, bufs + i * IO_SIZE, IO_SIZE,
+				    (off_t)i * IO_SIZE) == IO_SIZE,
+			      "pread");
+	return now() - start;
+}
+
+static double bench_io_uring(struct ring *ring, int fd, char *bufs)
+{
+	struct io_uring_cqe cqe;
+	struct io_uring_sqe *sqe;
+	double start = now();
+
+	for (int round = 0; round < NR_ROUNDS; round++) {
+		for (int i = 0; i < NR_BLOCKS; i += NR_ENTRIES) {
+			for (int j = i; j < i + NR_ENTRIES; j++) {
+				sqe = ring_get_sqe(ring);
+				sqe->opcode = IORING_OP_READ;
+				sqe->fd = fd;
+				sqe->addr = (uintptr_t)(bufs + j * IO_SIZE);
+				sqe->len = IO_SIZE;
+				sqe->off = (uint64_t)j * IO_SIZE;
+				sqe->user_data = j;
+			}
+			CHECK(ring_submit(ring, NR_ENTRIES) == NR_ENTRIES,
+			      "submit reads");
+			for (int j = 0; j < NR_ENTRIES; j++) {
+				ring_wait_cqe(ring, &cqe);
+				CHECK(cqe.res == IO_SIZE, "read result");
+			}
+		}
+	}
+	return now() - start;
+}
+
+static void test_file(struct ring *ring, const char *directory)
+{
+	char *bufs = malloc(NR_BLOCKS * IO_SIZE);
+	char path[256];
+	double pread_time, io_uring_time;
+	int fd;
+
+	CHECK(bufs != NULL, "malloc");
+	snprintf(path, sizeof(path), "%s/test_io_uring.txt", directory);
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	CHECK(fd >= 0, "open");
+	for (int i = 0; i < NR_BLOCKS; i++)
+		memset(bufs + i * IO_SIZE, 'a' + i % 26, IO_SIZE);
+	CHECK(write(fd, bufs, NR_BLOCKS * IO_SIZE) ==
+		      NR_BLOCKS * IO_SIZE,
+	      "write");
+	CHECK(fsync(fd) == 0, "fsync");
+
+	pread_time = bench_pread(fd, bufs);
+	memset(bufs, 0, NR_BLOCKS * IO_SIZE);
+	io_uring_time = bench_io_uring(ring, fd, bufs);
+	for (int i = 0; i < NR_BLOCKS; i++)
+		CHECK(bufs[i * IO_SIZE] == 'a' + i % 26 &&
+			      bufs[(i + 1) * IO_SIZE - 1] == 'a' + i % 26,
+		      "read data");
+
+	printf("%s: %d reads of %d bytes, pread: %.3f ms, io_uring (batch %d): %.3f ms\n",
+	       directory, NR_ROUNDS * NR_BLOCKS, IO_SIZE, pread_time * 1e3,
+	       NR_ENTRIES, io_uring_time * 1e3);
+
+	close(fd);
+	unlink(path);
+	free(bufs);
+}
+
+int main(int argc, char **argv)
+{
+	struct ring ring;
+
+	if (argc != 2) {
+		printf("Usage: %s <directory>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	ring_init(&ring);
+	test_nop(&ring);
+	test_pipe(&ring);
+	test_registered(&ring);
+	test_file(&ring, argv[1]);
+	close(ring.fd);
+
+	printf("All io_uring tests passed.\n");
+	return EXIT_SUCCESS;
+}
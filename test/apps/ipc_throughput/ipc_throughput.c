@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: MPL-2.0
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define KB 1024
+#define MB (1024 * KB)
+#define BUFFER_SIZE (64 * KB)
+#define BYTES_PER_PAIR (1024L * MB)
+
+static int get_nr_cpus(void)
+{
+	cpu_set_t set;
+
+	if (sched_getaffinity(0, sizeof(set), &set) < 0) {
+		perror("sched_getaffinity");
+		return 1;
+	}
+	return CPU_COUNT(&set);
+}
+
+static int create_channel(int use_unix_socket, int fds[2])
+{
+	if (use_unix_socket) {
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+			perror("socketpair");
+			return -1;
+		}
+	} else {
+		if (pipe(fds) < 0) {
+			perror("pipe");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void write_all(int fd)
+{
+	static char buffer[BUFFER_SIZE];
+	long offset = 0;
+	ssize_t ret;
+
+	memset(buffer, 'a', BUFFER_SIZE);
+	while (offset < BYTES_PER_PAIR) {
+		ret = write(fd, buffer, BUFFER_SIZE);
+		if (ret < 0) {
+			perror("write");
+			_exit(1);
+		}
+		offset += ret;
+	}
+	_exit(0);
+}
+
+static void read_all(int fd)
+{
+	static char buffer[BUFFER_SIZE];
+	long offset = 0;
+	ssize_t ret;
+
+	while (offset < BYTES_PER_PAIR) {
+		ret = read(fd, buffer, BUFFER_SIZE);
+		if (ret <= 0) {
+			perror("read");
+			_exit(1);
+		}
+		offset += ret;
+	}
+	_exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+	struct timespec start, end;
+	int use_unix_socket, nr_pairs, status, failed = 0;
+	long total_nanoseconds;
+	double throughput;
+
+	if (argc < 2 ||
+	    (strcmp(argv[1], "pipe") != 0 && strcmp(argv[1], "unix") != 0)) {
+		fprintf(stderr, "Usage: %s <pipe|unix> [nr_pairs]\n", argv[0]);
+		return 1;
+	}
+	use_unix_socket = strcmp(argv[1], "unix") == 0;
+	// Run a pair of a writer and a reader on each CPU by default.
+	nr_pairs = argc > 2 ? atoi(argv[2]) : get_nr_cpus();
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (int i = 0; i < nr_pairs; i++) {
+		int fds[2];
+
+		if (create_channel(use_unix_socket, fds) < 0)
+			return 1;
+
+		if (fork() == 0) {
+			close(fds[0]);
+			write_all(fds[1]);
+		}
+		if (fork() == 0) {
+			close(fds[1]);
+			read_all(fds[0]);
+		}
+		close(fds[0]);
+		close(fds[1]);
+	}
+
+	for (int i = 0; i < 2 * nr_pairs; i++) {
+		if (wait(&status) < 0) {
+			perror("wait");
+			return 1;
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			failed = 1;
+	}
+	if (failed) {
+		fprintf(stderr, "Failed to transfer the data.\n");
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	total_nanoseconds = (end.tv_sec - start.tv_sec) * 1000000000L +
+			    (end.tv_nsec - start.tv_nsec);
+	throughput = (double)BYTES_PER_PAIR * nr_pairs /
+		     ((double)total_nanoseconds / 1e9);
+
+	printf("Transferred %ld MiB through each of %d %s with a %d KiB buffer.\n",
+	       BYTES_PER_PAIR / MB, nr_pairs,
+	       use_unix_socket ? "UNIX socket pairs" : "pipes",
+	       BUFFER_SIZE / KB);
+	printf("%s throughput: %.2f MB/s\n",
+	       use_unix_socket ? "UNIX socket" : "Pipe", throughput / MB);
+
+	return 0;
+}
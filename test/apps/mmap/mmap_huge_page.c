@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: MPL-2.0
+
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../network/test.h"
+
+#define PAGE_SIZE 4096
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define NR_HUGE_PAGES 4
+#define MAP_SIZE (NR_HUGE_PAGES * HUGE_PAGE_SIZE)
+
+static char *map_addr;
+
+static void fill_pages(char *addr, size_t len, int seed)
+{
+	for (size_t i = 0; i < len; i += PAGE_SIZE)
+		memset(addr + i, (int)(i / PAGE_SIZE + seed), PAGE_SIZE);
+}
+
+static int check_pages(const char *addr, size_t len, int seed)
+{
+	for (size_t i = 0; i < len; i += PAGE_SIZE) {
+		char expected = (char)(i / PAGE_SIZE + seed);
+
+		if (addr[i] != expected || addr[i + PAGE_SIZE - 1] != expected)
+			return -1;
+	}
+	return 0;
+}
+
+FN_SETUP(mmap)
+{
+	char *addr;
+
+	// Map an extra huge page so that the mapping can be aligned.
+	addr = (char *)CHECK_WITH((long)mmap(NULL, MAP_SIZE + HUGE_PAGE_SIZE,
+					     PROT_READ | PROT_WRITE,
+					     MAP_PRIVATE | MAP_ANONYMOUS, -1,
+					     0),
+				  _ret != (long)MAP_FAILED);
+	map_addr = (char *)(((unsigned long)addr + HUGE_PAGE_SIZE - 1) &
+			    ~(unsigned long)(HUGE_PAGE_SIZE - 1));
+}
+END_SETUP()
+
+FN_TEST(fault_huge_pages)
+{
+	TEST_SUCC(madvise(map_addr, HUGE_PAGE_SIZE * 2, MADV_HUGEPAGE));
+
+	fill_pages(map_addr, HUGE_PAGE_SIZE * 2, 1);
+	TEST_RES(check_pages(map_addr, HUGE_PAGE_SIZE * 2, 1), _ret == 0);
+}
+END_TEST()
+
+FN_TEST(collapse_huge_pages)
+{
+	char *addr = map_addr + HUGE_PAGE_SIZE * 2;
+
+	// The pages are populated as base pages, and collapsed later.
+	TEST_SUCC(madvise(addr, HUGE_PAGE_SIZE * 2, MADV_NOHUGEPAGE));
+	fill_pages(addr, HUGE_PAGE_SIZE + PAGE_SIZE * 3, 2);
+	TEST_SUCC(madvise(addr, HUGE_PAGE_SIZE * 2, MADV_HUGEPAGE));
+
+	TEST_RES(check_pages(addr, HUGE_PAGE_SIZE + PAGE_SIZE * 3, 2),
+		 _ret == 0);
+	TEST_RES(addr[HUGE_PAGE_SIZE + PAGE_SIZE * 3], _ret == 0);
+}
+END_TEST()
+
+FN_TEST(split_huge_pages)
+{
+	char *addr = map_addr;
+
+	// Protecting and unmapping a part of a huge page splits it.
+	TEST_SUCC(mprotect(addr + PAGE_SIZE, PAGE_SIZE, PROT_READ));
+	TEST_RES(check_pages(addr, HUGE_PAGE_SIZE, 1), _ret == 0);
+	TEST_SUCC(munmap(addr + HUGE_PAGE_SIZE - PAGE_SIZE, PAGE_SIZE));
+	TEST_RES(check_pages(addr, HUGE_PAGE_SIZE - PAGE_SIZE, 1), _ret == 0);
+}
+END_TEST()
+
+FN_TEST(fork_huge_pages)
+{
+	char *addr = map_addr + HUGE_PAGE_SIZE;
+	int status;
+	pid_t pid;
+
+	pid = TEST_SUCC(fork());
+	if (pid == 0) {
+		// The writes of the child must not be seen by the parent.
+		fill_pages(addr, HUGE_PAGE_SIZE, 4);
+		_exit(check_pages(addr, HUGE_PAGE_SIZE, 4) == 0 ? 0 : 1);
+	}
+
+	TEST_RES(waitpid(pid, &status, 0),
+		 _ret == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	TEST_RES(check_pages(addr, HUGE_PAGE_SIZE, 1), _ret == 0);
+}
+END_TEST()
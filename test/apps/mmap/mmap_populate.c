@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: MPL-2.0
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../network/test.h"
+
+#define PAGE_SIZE 4096
+#define NR_PAGES 64
+#define FILE_SIZE (NR_PAGES * PAGE_SIZE)
+
+static const char *file_name = "/tmp/mmap_populate";
+static int fd;
+
+static int check_pages(const char *addr, int seed)
+{
+	for (size_t i = 0; i < FILE_SIZE; i += PAGE_SIZE) {
+		char expected = (char)(i / PAGE_SIZE + seed);
+
+		if (addr[i] != expected || addr[i + PAGE_SIZE - 1] != expected)
+			return -1;
+	}
+	return 0;
+}
+
+FN_SETUP(file)
+{
+	static char buffer[FILE_SIZE];
+
+	for (size_t i = 0; i < FILE_SIZE; i += PAGE_SIZE)
+		memset(buffer + i, (int)(i / PAGE_SIZE), PAGE_SIZE);
+
+	fd = CHECK(open(file_name, O_RDWR | O_CREAT | O_TRUNC, 0644));
+	CHECK_WITH(write(fd, buffer, FILE_SIZE), _ret == FILE_SIZE);
+}
+END_SETUP()
+
+FN_TEST(sequential_read)
+{
+	char *addr;
+
+	// The pages around the faulted pages can be mapped without faults.
+	addr = (char *)TEST_SUCC(
+		(long)mmap(NULL, FILE_SIZE, PROT_READ, MAP_PRIVATE, fd, 0));
+	TEST_RES(check_pages(addr, 0), _ret == 0);
+	TEST_SUCC(munmap(addr, FILE_SIZE));
+}
+END_TEST()
+
+FN_TEST(map_populate)
+{
+	char *addr;
+	char byte;
+
+	addr = (char *)TEST_SUCC((long)mmap(NULL, FILE_SIZE,
+					    PROT_READ | PROT_WRITE,
+					    MAP_PRIVATE | MAP_POPULATE, fd, 0));
+	TEST_RES(check_pages(addr, 0), _ret == 0);
+
+	// The private pages populated for writing are not shared with the file.
+	addr[PAGE_SIZE] = 'a';
+	TEST_RES(pread(fd, &byte, 1, PAGE_SIZE), _ret == 1 && byte == 1);
+	TEST_SUCC(munmap(addr, FILE_SIZE));
+}
+END_TEST()
+
+FN_TEST(madvise_populate)
+{
+	char *addr;
+
+	addr = (char *)TEST_SUCC((long)mmap(NULL, FILE_SIZE,
+					    PROT_READ | PROT_WRITE, MAP_SHARED,
+					    fd, 0));
+	TEST_SUCC(madvise(addr, FILE_SIZE, MADV_WILLNEED));
+	TEST_RES(check_pages(addr, 0), _ret == 0);
+
+	TEST_SUCC(madvise(addr, FILE_SIZE / 2, MADV_POPULATE_WRITE));
+	addr[PAGE_SIZE * 2] = 'b';
+	TEST_RES(addr[PAGE_SIZE * 2], _ret == 'b');
+	TEST_SUCC(munmap(addr, FILE_SIZE));
+}
+END_TEST()
+
+FN_SETUP(cleanup)
+{
+	CHECK(close(fd));
+	CHECK(unlink(file_name));
+}
+END_SETUP()
@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: MPL-2.0
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "test.h"
+
+#define NR_LISTENERS 2
+#define NR_CLIENTS 4
+
+static struct sockaddr_in sk_addr;
+static int sk_listen[NR_LISTENERS];
+static int sk_exclusive;
+
+static int new_socket(int reuse_port)
+{
+	int sk = CHECK(socket(PF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0));
+
+	CHECK(setsockopt(sk, SOL_SOCKET, SO_REUSEPORT, &reuse_port,
+			 sizeof(reuse_port)));
+	return sk;
+}
+
+FN_SETUP(general)
+{
+	sk_addr.sin_family = AF_INET;
+	CHECK(inet_aton("127.0.0.1", &sk_addr.sin_addr));
+}
+END_SETUP()
+
+FN_SETUP(exclusive)
+{
+	sk_exclusive = new_socket(0);
+
+	sk_addr.sin_port = htons(0x2345);
+	CHECK(bind(sk_exclusive, (struct sockaddr *)&sk_addr, sizeof(sk_addr)));
+}
+END_SETUP()
+
+FN_TEST(bind_exclusive)
+{
+	int sk = new_socket(1);
+
+	// A port bound without `SO_REUSEPORT` cannot be shared.
+	sk_addr.sin_port = htons(0x2345);
+	TEST_ERRNO(bind(sk, (struct sockaddr *)&sk_addr, sizeof(sk_addr)),
+		   EADDRINUSE);
+
+	TEST_SUCC(close(sk));
+}
+END_TEST()
+
+FN_TEST(bind_shared)
+{
+	int sk;
+
+	sk_addr.sin_port = htons(0x2346);
+	for (int i = 0; i < NR_LISTENERS; i++) {
+		sk_listen[i] = new_socket(1);
+		TEST_SUCC(bind(sk_listen[i], (struct sockaddr *)&sk_addr,
+			       sizeof(sk_addr)));
+		TEST_SUCC(listen(sk_listen[i], NR_CLIENTS));
+	}
+
+	// All the sockets bound to the port must enable `SO_REUSEPORT`.
+	sk = new_socket(0);
+	TEST_ERRNO(bind(sk, (struct sockaddr *)&sk_addr, sizeof(sk_addr)),
+		   EADDRINUSE);
+	TEST_SUCC(close(sk));
+}
+END_TEST()
+
+FN_TEST(accept_shared)
+{
+	int sk_clients[NR_CLIENTS];
+	int nr_accepted = 0;
+	int sk;
+
+	sk_addr.sin_port = htons(0x2346);
+	for (int i = 0; i < NR_CLIENTS; i++) {
+		sk_clients[i] = CHECK(socket(PF_INET, SOCK_STREAM, 0));
+		TEST_SUCC(connect(sk_clients[i], (struct sockaddr *)&sk_addr,
+				  sizeof(sk_addr)));
+	}
+
+	// Each connection is accepted by exactly one of the listeners.
+	for (int i = 0; i < NR_LISTENERS; i++) {
+		while ((sk = accept(sk_listen[i], NULL, NULL)) >= 0) {
+			nr_accepted++;
+			close(sk);
+		}
+	}
+	TEST_RES(nr_accepted, _ret == NR_CLIENTS);
+
+	for (int i = 0; i < NR_CLIENTS; i++)
+		TEST_SUCC(close(sk_clients[i]));
+	for (int i = 0; i < NR_LISTENERS; i++)
+		TEST_SUCC(close(sk_listen[i]));
+	TEST_SUCC(close(sk_exclusive));
+}
+END_TEST()
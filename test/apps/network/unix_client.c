@@ -10,6 +10,54 @@
 
 #define SOCKET_NAME "/tmp/test.sock"
 #define BUFFER_SIZE 128
+#define BULK_BUFFER_SIZE (64 * 1024)
+#define BULK_TOTAL_SIZE (64 * 1024 * 1024)
+
+// Passes a file descriptor with `SCM_RIGHTS`
+static void send_fd(int sock_fd, int fd)
+{
+	char data = 'F';
+	struct iovec iov = { .iov_base = &data, .iov_len = 1 };
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} control;
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control.buf,
+		.msg_controllen = sizeof(control.buf),
+	};
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+	if (sendmsg(sock_fd, &msg, 0) != 1) {
+		perror("sendmsg");
+		exit(EXIT_FAILURE);
+	}
+}
+
+// Sends the bulk data for the server to measure the throughput
+static void send_bulk(int sock_fd)
+{
+	static char buf[BULK_BUFFER_SIZE];
+	long total = 0;
+	ssize_t len;
+
+	memset(buf, 'B', BULK_BUFFER_SIZE);
+	while (total < BULK_TOTAL_SIZE) {
+		len = write(sock_fd, buf, BULK_BUFFER_SIZE);
+		if (len <= 0) {
+			perror("write");
+			exit(EXIT_FAILURE);
+		}
+		total += len;
+	}
+}
 
 int main()
 {
@@ -61,6 +109,23 @@ int main()
 		exit(EXIT_FAILURE);
 	}
 
+	// Pass the read end of a pipe to server
+	int pipe_fds[2];
+	if (pipe(pipe_fds) == -1) {
+		perror("pipe");
+		exit(EXIT_FAILURE);
+	}
+	char *pipe_mesg = "Hello from the pipe of unix socket client";
+	if (write(pipe_fds[1], pipe_mesg, strlen(pipe_mesg)) == -1) {
+		perror("write pipe");
+		exit(EXIT_FAILURE);
+	}
+	send_fd(client_fd, pipe_fds[0]);
+	close(pipe_fds[0]);
+	close(pipe_fds[1]);
+
+	send_bulk(client_fd);
+
 	// Close socket
 	close(client_fd);
 
@@ -7,9 +7,72 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <time.h>
 
 #define SOCKET_NAME "/tmp/test.sock"
 #define BUFFER_SIZE 128
+#define BULK_BUFFER_SIZE (64 * 1024)
+#define BULK_TOTAL_SIZE (64 * 1024 * 1024)
+
+// Receives a file descriptor passed with `SCM_RIGHTS`
+static int recv_fd(int sock_fd)
+{
+	char data;
+	struct iovec iov = { .iov_base = &data, .iov_len = 1 };
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} control;
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control.buf,
+		.msg_controllen = sizeof(control.buf),
+	};
+	struct cmsghdr *cmsg;
+	int fd;
+
+	if (recvmsg(sock_fd, &msg, 0) != 1) {
+		perror("recvmsg");
+		exit(EXIT_FAILURE);
+	}
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET ||
+	    cmsg->cmsg_type != SCM_RIGHTS ||
+	    cmsg->cmsg_len != CMSG_LEN(sizeof(int))) {
+		fprintf(stderr, "no file descriptor is received\n");
+		exit(EXIT_FAILURE);
+	}
+	memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+	return fd;
+}
+
+// Receives the bulk data, and reports the throughput
+static void recv_bulk(int sock_fd)
+{
+	static char buf[BULK_BUFFER_SIZE];
+	struct timespec start, end;
+	long total = 0;
+	ssize_t len;
+	double secs;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (total < BULK_TOTAL_SIZE) {
+		len = read(sock_fd, buf, BULK_BUFFER_SIZE);
+		if (len <= 0) {
+			perror("read");
+			exit(EXIT_FAILURE);
+		}
+		total += len;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	secs = (end.tv_sec - start.tv_sec) +
+	       (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("Server received %ld bytes in %.3f s (%.1f MiB/s)\n", total,
+	       secs, total / secs / (1024 * 1024));
+}
 
 int main()
 {
@@ -73,6 +136,18 @@ int main()
 	}
 	printf("Server Received: %s\n", buf);
 
+	// Read from the file descriptor passed by the client
+	int passed_fd = recv_fd(accepted_fd);
+	memset(buf, 0, BUFFER_SIZE);
+	if (read(passed_fd, buf, BUFFER_SIZE) == -1) {
+		perror("read passed fd");
+		exit(EXIT_FAILURE);
+	}
+	printf("Server Received from passed fd: %s\n", buf);
+	close(passed_fd);
+
+	recv_bulk(accepted_fd);
+
 	// Close the socket
 	close(accepted_fd);
 	close(server_fd);
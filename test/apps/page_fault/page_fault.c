@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: MPL-2.0
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PAGE_SIZE 4096
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define MAP_SIZE (256 * 1024 * 1024)
+#define NUM_OF_ROUNDS 4
+#define NUM_OF_FAULTS (NUM_OF_ROUNDS * (MAP_SIZE / PAGE_SIZE))
+
+struct worker {
+	pthread_t thread;
+	int use_huge_pages;
+	long total_nanoseconds;
+};
+
+static int get_nr_cpus(void)
+{
+	cpu_set_t set;
+
+	if (sched_getaffinity(0, sizeof(set), &set) < 0) {
+		perror("sched_getaffinity");
+		return 1;
+	}
+	return CPU_COUNT(&set);
+}
+
+static long touch_pages(int use_huge_pages)
+{
+	struct timespec start, end;
+	char *addr, *aligned_addr;
+
+	// Map an extra huge page so that the touched memory can be aligned.
+	addr = mmap(NULL, MAP_SIZE + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+	aligned_addr = (char *)(((unsigned long)addr + HUGE_PAGE_SIZE - 1) &
+				~(unsigned long)(HUGE_PAGE_SIZE - 1));
+
+	if (use_huge_pages &&
+	    madvise(aligned_addr, MAP_SIZE, MADV_HUGEPAGE) < 0) {
+		perror("madvise");
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (size_t offset = 0; offset < MAP_SIZE; offset += PAGE_SIZE)
+		aligned_addr[offset] = 1;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	munmap(addr, MAP_SIZE + HUGE_PAGE_SIZE);
+
+	return (end.tv_sec - start.tv_sec) * 1000000000L +
+	       (end.tv_nsec - start.tv_nsec);
+}
+
+static void *run_worker(void *arg)
+{
+	struct worker *worker = arg;
+	long nanoseconds;
+
+	worker->total_nanoseconds = 0;
+	for (int i = 0; i < NUM_OF_ROUNDS; i++) {
+		nanoseconds = touch_pages(worker->use_huge_pages);
+		if (nanoseconds < 0) {
+			worker->total_nanoseconds = -1;
+			break;
+		}
+		worker->total_nanoseconds += nanoseconds;
+	}
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	struct timespec start, end;
+	struct worker *workers;
+	int use_huge_pages = 0, nr_threads = 1;
+	long total_nanoseconds = 0, wall_nanoseconds, avg_latency;
+	double rate;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--huge-page") == 0) {
+			use_huge_pages = 1;
+		} else if (strcmp(argv[i], "--threads") == 0) {
+			// Each thread touches its own memory in the same address space.
+			nr_threads = get_nr_cpus();
+		} else {
+			fprintf(stderr, "Usage: %s [--huge-page] [--threads]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	workers = calloc(nr_threads, sizeof(struct worker));
+	if (workers == NULL) {
+		perror("calloc");
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (int i = 0; i < nr_threads; i++) {
+		workers[i].use_huge_pages = use_huge_pages;
+		if (pthread_create(&workers[i].thread, NULL, run_worker,
+				   &workers[i]) != 0) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+	for (int i = 0; i < nr_threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		if (workers[i].total_nanoseconds < 0)
+			return 1;
+		total_nanoseconds += workers[i].total_nanoseconds;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	wall_nanoseconds = (end.tv_sec - start.tv_sec) * 1000000000L +
+			   (end.tv_nsec - start.tv_nsec);
+	avg_latency = total_nanoseconds / ((long)NUM_OF_FAULTS * nr_threads);
+	rate = (double)NUM_OF_FAULTS * nr_threads /
+	       ((double)wall_nanoseconds / 1e9);
+
+	printf("Touched %d MiB of %s memory %d times in each of %d threads.\n",
+	       MAP_SIZE >> 20,
+	       use_huge_pages ? "huge-page-backed" : "base-page-backed",
+	       NUM_OF_ROUNDS, nr_threads);
+	printf("Page fault average latency: %ld nanoseconds.\n", avg_latency);
+	printf("Page fault rate: %.0f faults per second.\n", rate);
+
+	free(workers);
+
+	return 0;
+}
@@ -0,0 +1,194 @@
+// SPDX-License-Identifier: MPL-2.0
+
+#define _GNU_SOURCE
+
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../network/test.h"
+
+#define NR_DATA_PAGES 8
+
+static long page_size;
+
+static int perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu,
+			   int group_fd, unsigned long flags)
+{
+	return syscall(SYS_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+static void init_attr(struct perf_event_attr *attr)
+{
+	memset(attr, 0, sizeof(*attr));
+	attr->type = PERF_TYPE_HARDWARE;
+	attr->size = sizeof(*attr);
+	attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+	attr->disabled = 1;
+	attr->exclude_kernel = 1;
+}
+
+// Maps the ring buffer, returning -1 on failure like the other system calls.
+static int map_ring_buffer(int fd, size_t len, void **addr)
+{
+	*addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	return *addr == MAP_FAILED ? -1 : 0;
+}
+
+static void busy_loop(void)
+{
+	for (volatile int i = 0; i < 10000000; i++)
+		;
+}
+
+FN_SETUP(pmu)
+{
+	struct perf_event_attr attr;
+	int fd;
+
+	page_size = CHECK(sysconf(_SC_PAGESIZE));
+
+	init_attr(&attr);
+	fd = perf_event_open(&attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+	if (fd < 0 && (errno == ENOENT || errno == EOPNOTSUPP)) {
+		fprintf(stderr, "no PMU is available, skipping the tests\n");
+		exit(EXIT_SUCCESS);
+	}
+	CHECK(fd);
+	CHECK(close(fd));
+}
+END_SETUP()
+
+FN_TEST(counting)
+{
+	struct perf_event_attr attr;
+	uint64_t values[3];
+	int fd;
+
+	init_attr(&attr);
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+			   PERF_FORMAT_TOTAL_TIME_RUNNING;
+	fd = TEST_SUCC(perf_event_open(&attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+
+	// The event is disabled, so it counts nothing.
+	busy_loop();
+	TEST_RES(read(fd, values, sizeof(values)),
+		 _ret == sizeof(values) && values[0] == 0 && values[1] == 0);
+
+	TEST_SUCC(ioctl(fd, PERF_EVENT_IOC_ENABLE, 0));
+	busy_loop();
+	TEST_SUCC(ioctl(fd, PERF_EVENT_IOC_DISABLE, 0));
+	TEST_RES(read(fd, values, sizeof(values)),
+		 _ret == sizeof(values) && values[0] >= 10000000 &&
+			 values[1] > 0 && values[2] <= values[1]);
+
+	TEST_SUCC(ioctl(fd, PERF_EVENT_IOC_RESET, 0));
+	TEST_RES(read(fd, values, sizeof(values)),
+		 _ret == sizeof(values) && values[0] == 0);
+
+	TEST_SUCC(close(fd));
+}
+END_TEST()
+
+FN_TEST(attr_size)
+{
+	struct {
+		struct perf_event_attr attr;
+		uint64_t extra;
+	} big_attr;
+	struct perf_event_attr attr;
+	int fd;
+
+	// A size of zero stands for the first published version.
+	init_attr(&attr);
+	attr.size = 0;
+	fd = TEST_SUCC(perf_event_open(&attr, 0, -1, -1, 0));
+	TEST_SUCC(close(fd));
+
+	init_attr(&attr);
+	attr.size = PERF_ATTR_SIZE_VER0;
+	fd = TEST_SUCC(perf_event_open(&attr, 0, -1, -1, 0));
+	TEST_SUCC(close(fd));
+
+	init_attr(&attr);
+	attr.size = PERF_ATTR_SIZE_VER0 - 8;
+	TEST_ERRNO(perf_event_open(&attr, 0, -1, -1, 0), E2BIG);
+
+	// The fields that are not understood must be zeros.
+	init_attr(&big_attr.attr);
+	big_attr.attr.size = sizeof(big_attr);
+	big_attr.extra = 0;
+	fd = TEST_SUCC(perf_event_open(&big_attr.attr, 0, -1, -1, 0));
+	TEST_SUCC(close(fd));
+
+	big_attr.extra = 1;
+	TEST_ERRNO(perf_event_open(&big_attr.attr, 0, -1, -1, 0), E2BIG);
+	TEST_RES(big_attr.attr.size, _ret < sizeof(big_attr));
+}
+END_TEST()
+
+FN_TEST(mmap_metadata_only)
+{
+	struct perf_event_attr attr;
+	struct perf_event_mmap_page *meta;
+	int fd;
+
+	init_attr(&attr);
+	attr.sample_period = 100000;
+	fd = TEST_SUCC(perf_event_open(&attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+
+	// The number of data pages must be zero or a power of two.
+	TEST_ERRNO(map_ring_buffer(fd, 4 * page_size, (void **)&meta), EINVAL);
+
+	if (TEST_SUCC(map_ring_buffer(fd, page_size, (void **)&meta)) == 0) {
+		TEST_RES(meta->data_size, _ret == 0);
+		TEST_SUCC(munmap(meta, page_size));
+	}
+
+	TEST_SUCC(close(fd));
+}
+END_TEST()
+
+FN_TEST(sampling)
+{
+	size_t len = (1 + NR_DATA_PAGES) * page_size;
+	struct perf_event_attr attr;
+	struct perf_event_mmap_page *meta;
+	struct perf_event_header *header;
+	uint32_t *pid_tid;
+	uint64_t head;
+	int fd;
+
+	init_attr(&attr);
+	attr.sample_period = 100000;
+	attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_TID;
+	fd = TEST_SUCC(perf_event_open(&attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+
+	if (TEST_SUCC(map_ring_buffer(fd, len, (void **)&meta)) < 0) {
+		TEST_SUCC(close(fd));
+		return;
+	}
+	TEST_RES(meta->data_size, _ret == NR_DATA_PAGES * page_size);
+
+	TEST_SUCC(ioctl(fd, PERF_EVENT_IOC_ENABLE, 0));
+	busy_loop();
+	TEST_SUCC(ioctl(fd, PERF_EVENT_IOC_DISABLE, 0));
+
+	head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+	TEST_RES(head, _ret > 0);
+
+	// Each sample has the header, the IP, and the process and thread IDs.
+	header = (void *)((char *)meta + meta->data_offset);
+	pid_tid = (void *)((char *)(header + 1) + sizeof(uint64_t));
+	TEST_RES(header->type, _ret == PERF_RECORD_SAMPLE);
+	TEST_RES(header->size, _ret == sizeof(*header) + 2 * sizeof(uint64_t));
+	TEST_RES(pid_tid[0], _ret == getpid());
+	TEST_RES(pid_tid[1], _ret == gettid());
+
+	TEST_SUCC(munmap(meta, len));
+	TEST_SUCC(close(fd));
+}
+END_TEST()
@@ -59,4 +59,21 @@ echo "All ext2 fs test passed."
 
 echo "Start fdatasync test......"
 test_fdatasync
-echo "All fdatasync test passed."
\ No newline at end of file
+echo "All fdatasync test passed."
+
+echo "Start dentry cache test......"
+dentry/dentry_cache
+echo "All dentry cache test passed."
+
+echo "Start fadvise test......"
+fadvise/fadvise
+echo "All fadvise test passed."
+
+echo "Start splice test......"
+splice/splice
+echo "All splice test passed."
+
+echo "Start io_uring test......"
+io_uring/io_uring /
+io_uring/io_uring /ext2
+echo "All io_uring test passed."
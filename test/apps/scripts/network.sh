@@ -18,6 +18,7 @@ echo "Start network test......"
 ./socketpair
 ./sockoption
 ./listen_backlog
+./reuseport
 ./send_buf_full
 ./http_server &
 ./http_client
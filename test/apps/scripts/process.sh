@@ -11,20 +11,26 @@ echo "Start process test......"
 # These test programs are sorted by name.
 tests="
 clone3/clone_process
+epoll/epoll_exclusive
 execve/execve
 eventfd2/eventfd2
 fork/fork
 fork_c/fork
+fork_c/vfork
 getpid/getpid
 hello_pie/hello
 hello_world/hello_world
 itimer/setitimer
 itimer/timer_create
 mmap/mmap_and_fork
+mmap/mmap_huge_page
+mmap/mmap_populate
+perf/perf
 pthread/pthread_test
 pty/open_pty
 signal_c/parent_death_signal
 signal_c/signal_test
+vdso/vdso
 "
 
 for testcase in ${tests}
@@ -0,0 +1,217 @@
+// SPDX-License-Identifier: MPL-2.0
+
+#define _GNU_SOURCE
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define FILE_SIZE (64 * 1024 + 123)
+#define CHECK(cond, msg)                       \
+	do {                                   \
+		if (!(cond))                   \
+			err(EXIT_FAILURE, msg); \
+	} while (0)
+
+static char data[FILE_SIZE];
+static char buf[FILE_SIZE];
+
+static int create_file(const char *path)
+{
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	CHECK(fd >= 0, "open");
+
+	for (int i = 0; i < FILE_SIZE; i++)
+		data[i] = (char)(i * 7 + 3);
+	CHECK(write(fd, data, FILE_SIZE) == FILE_SIZE, "write");
+	CHECK(lseek(fd, 0, SEEK_SET) == 0, "lseek");
+	return fd;
+}
+
+static void read_all(int fd, char *dst, size_t len)
+{
+	size_t done = 0;
+	while (done < len) {
+		ssize_t n = read(fd, dst + done, len - done);
+		CHECK(n > 0, "read");
+		done += n;
+	}
+}
+
+static void test_splice_file_to_pipe(int file_fd)
+{
+	int pipe_fds[2];
+	loff_t off = 100;
+	ssize_t n;
+
+	CHECK(pipe(pipe_fds) == 0, "pipe");
+	n = splice(file_fd, &off, pipe_fds[1], NULL, 8192, 0);
+	CHECK(n == 8192, "splice file to pipe");
+	CHECK(off == 100 + 8192, "splice offset");
+
+	read_all(pipe_fds[0], buf, n);
+	CHECK(memcmp(buf, data + 100, n) == 0, "splice data");
+
+	close(pipe_fds[0]);
+	close(pipe_fds[1]);
+	printf("splice file to pipe passed\n");
+}
+
+static void test_tee_and_splice_pipe_to_file(void)
+{
+	int in_fds[2], out_fds[2];
+	const char *msg = "hello, splice and tee!";
+	size_t len = strlen(msg);
+	int out_fd;
+
+	CHECK(pipe(in_fds) == 0, "pipe");
+	CHECK(pipe(out_fds) == 0, "pipe");
+	CHECK(write(in_fds[1], msg, len) == (ssize_t)len, "write pipe");
+
+	CHECK(tee(in_fds[0], out_fds[1], len, 0) == (ssize_t)len, "tee");
+	read_all(out_fds[0], buf, len);
+	CHECK(memcmp(buf, msg, len) == 0, "tee data");
+
+	out_fd = open("/splice_out.txt", O_RDWR | O_CREAT | O_TRUNC, 0644);
+	CHECK(out_fd >= 0, "open");
+	CHECK(splice(in_fds[0], NULL, out_fd, NULL, len, 0) == (ssize_t)len,
+	      "splice pipe to file");
+	CHECK(pread(out_fd, buf, len, 0) == (ssize_t)len, "pread");
+	CHECK(memcmp(buf, msg, len) == 0, "splice pipe to file data");
+
+	close(out_fd);
+	unlink("/splice_out.txt");
+	close(in_fds[0]);
+	close(in_fds[1]);
+	close(out_fds[0]);
+	close(out_fds[1]);
+	printf("tee and splice pipe to file passed\n");
+}
+
+static void test_vmsplice(void)
+{
+	int pipe_fds[2];
+	char part1[] = "vmsplice ";
+	char part2[] = "works";
+	struct iovec iov[2] = {
+		{ .iov_base = part1, .iov_len = strlen(part1) },
+		{ .iov_base = part2, .iov_len = strlen(part2) },
+	};
+	size_t len = strlen(part1) + strlen(part2);
+
+	CHECK(pipe(pipe_fds) == 0, "pipe");
+	CHECK(vmsplice(pipe_fds[1], iov, 2, 0) == (ssize_t)len, "vmsplice");
+	read_all(pipe_fds[0], buf, len);
+	CHECK(memcmp(buf, "vmsplice works", len) == 0, "vmsplice data");
+
+	close(pipe_fds[0]);
+	close(pipe_fds[1]);
+	printf("vmsplice passed\n");
+}
+
+static void test_pipe_size(void)
+{
+	int pipe_fds[2];
+	ssize_t n;
+
+	CHECK(pipe(pipe_fds) == 0, "pipe");
+	CHECK(fcntl(pipe_fds[0], F_GETPIPE_SZ) > 0, "F_GETPIPE_SZ");
+
+	// The size is rounded up to a power-of-two number of pages.
+	CHECK(fcntl(pipe_fds[1], F_SETPIPE_SZ, 3 * 4096) == 4 * 4096,
+	      "F_SETPIPE_SZ");
+	CHECK(fcntl(pipe_fds[0], F_GETPIPE_SZ) == 4 * 4096, "F_GETPIPE_SZ");
+
+	CHECK(fcntl(pipe_fds[1], F_SETFL, O_NONBLOCK) == 0, "F_SETFL");
+	n = write(pipe_fds[1], data, FILE_SIZE);
+	CHECK(n == 4 * 4096, "write full pipe");
+
+	// The pipe cannot be shrunk below the data in it.
+	CHECK(fcntl(pipe_fds[1], F_SETPIPE_SZ, 4096) < 0 && errno == EBUSY,
+	      "F_SETPIPE_SZ busy");
+
+	read_all(pipe_fds[0], buf, n);
+	CHECK(memcmp(buf, data, n) == 0, "pipe data");
+
+	close(pipe_fds[0]);
+	close(pipe_fds[1]);
+	printf("pipe size passed\n");
+}
+
+static void test_pipe_vectored(void)
+{
+	int pipe_fds[2];
+	char part1[] = "readv ";
+	char part2[] = "and writev";
+	char out1[4], out2[32];
+	struct iovec iov[2] = {
+		{ .iov_base = part1, .iov_len = strlen(part1) },
+		{ .iov_base = part2, .iov_len = strlen(part2) },
+	};
+	size_t len = strlen(part1) + strlen(part2);
+
+	CHECK(pipe(pipe_fds) == 0, "pipe");
+	CHECK(writev(pipe_fds[1], iov, 2) == (ssize_t)len, "writev");
+
+	iov[0].iov_base = out1;
+	iov[0].iov_len = sizeof(out1);
+	iov[1].iov_base = out2;
+	iov[1].iov_len = sizeof(out2);
+	CHECK(readv(pipe_fds[0], iov, 2) == (ssize_t)len, "readv");
+	CHECK(memcmp(out1, "read", 4) == 0 &&
+		      memcmp(out2, "v and writev", len - 4) == 0,
+	      "readv data");
+
+	close(pipe_fds[0]);
+	close(pipe_fds[1]);
+	printf("pipe readv and writev passed\n");
+}
+
+static void test_sendfile_to_pipe(int file_fd)
+{
+	int pipe_fds[2];
+	char *dst = malloc(FILE_SIZE);
+	ssize_t total = 0;
+
+	CHECK(dst != NULL, "malloc");
+	CHECK(pipe(pipe_fds) == 0, "pipe");
+	CHECK(lseek(file_fd, 0, SEEK_SET) == 0, "lseek");
+
+	while (total < FILE_SIZE) {
+		ssize_t n = sendfile(pipe_fds[1], file_fd, NULL,
+				     FILE_SIZE - total);
+		CHECK(n > 0, "sendfile");
+		read_all(pipe_fds[0], dst + total, n);
+		total += n;
+	}
+	CHECK(lseek(file_fd, 0, SEEK_CUR) == FILE_SIZE, "sendfile offset");
+	CHECK(memcmp(dst, data, FILE_SIZE) == 0, "sendfile data");
+
+	free(dst);
+	close(pipe_fds[0]);
+	close(pipe_fds[1]);
+	printf("sendfile to pipe passed\n");
+}
+
+int main(void)
+{
+	int file_fd = create_file("/splice_in.txt");
+
+	test_splice_file_to_pipe(file_fd);
+	test_tee_and_splice_pipe_to_file();
+	test_vmsplice();
+	test_pipe_size();
+	test_pipe_vectored();
+	test_sendfile_to_pipe(file_fd);
+
+	close(file_fd);
+	unlink("/splice_in.txt");
+	printf("All splice tests passed\n");
+	return 0;
+}
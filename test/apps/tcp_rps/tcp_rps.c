@@ -0,0 +1,196 @@
+// SPDX-License-Identifier: MPL-2.0
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SERVER_PORT 8090
+#define MESSAGE_SIZE 64
+#define REQUESTS_PER_CLIENT 100000
+
+static int get_nr_cpus(void)
+{
+	cpu_set_t set;
+
+	if (sched_getaffinity(0, sizeof(set), &set) < 0) {
+		perror("sched_getaffinity");
+		return 1;
+	}
+	return CPU_COUNT(&set);
+}
+
+static int transfer_all(int fd, char *buffer, int is_send)
+{
+	ssize_t ret;
+	int offset = 0;
+
+	while (offset < MESSAGE_SIZE) {
+		if (is_send)
+			ret = send(fd, buffer + offset, MESSAGE_SIZE - offset,
+				   0);
+		else
+			ret = recv(fd, buffer + offset, MESSAGE_SIZE - offset,
+				   0);
+		if (ret <= 0)
+			return ret;
+		offset += ret;
+	}
+	return offset;
+}
+
+static void set_nodelay(int fd)
+{
+	int enable = 1;
+
+	if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable)) <
+	    0) {
+		perror("setsockopt");
+		_exit(1);
+	}
+}
+
+// Serves the requests of one connection until the client closes it.
+static void run_server(int listen_fd)
+{
+	char buffer[MESSAGE_SIZE];
+	int fd, ret;
+
+	fd = accept(listen_fd, NULL, NULL);
+	if (fd < 0) {
+		perror("accept");
+		_exit(1);
+	}
+	set_nodelay(fd);
+
+	while ((ret = transfer_all(fd, buffer, 0)) > 0) {
+		if (transfer_all(fd, buffer, 1) <= 0) {
+			perror("send");
+			_exit(1);
+		}
+	}
+	if (ret < 0) {
+		perror("recv");
+		_exit(1);
+	}
+	_exit(0);
+}
+
+// Sends the requests one by one, each of which waits for its response.
+static void run_client(struct sockaddr_in *addr)
+{
+	char buffer[MESSAGE_SIZE];
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		_exit(1);
+	}
+	if (connect(fd, (struct sockaddr *)addr, sizeof(*addr)) < 0) {
+		perror("connect");
+		_exit(1);
+	}
+	set_nodelay(fd);
+
+	memset(buffer, 'a', MESSAGE_SIZE);
+	for (int i = 0; i < REQUESTS_PER_CLIENT; i++) {
+		if (transfer_all(fd, buffer, 1) <= 0) {
+			perror("send");
+			_exit(1);
+		}
+		if (transfer_all(fd, buffer, 0) <= 0) {
+			perror("recv");
+			_exit(1);
+		}
+	}
+
+	close(fd);
+	_exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+	struct sockaddr_in addr;
+	struct timespec start, end;
+	int listen_fd, nr_clients, status, failed = 0, enable = 1;
+	long total_nanoseconds;
+	double rps;
+
+	// Run a client and a server on each CPU by default.
+	nr_clients = argc > 1 ? atoi(argv[1]) : get_nr_cpus();
+
+	listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (listen_fd < 0) {
+		perror("socket");
+		return 1;
+	}
+	if (setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &enable,
+		       sizeof(enable)) < 0) {
+		perror("setsockopt");
+		return 1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(SERVER_PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		perror("bind");
+		return 1;
+	}
+	if (listen(listen_fd, nr_clients) < 0) {
+		perror("listen");
+		return 1;
+	}
+
+	for (int i = 0; i < nr_clients; i++) {
+		if (fork() == 0)
+			run_server(listen_fd);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (int i = 0; i < nr_clients; i++) {
+		if (fork() == 0) {
+			close(listen_fd);
+			run_client(&addr);
+		}
+	}
+
+	for (int i = 0; i < 2 * nr_clients; i++) {
+		if (wait(&status) < 0) {
+			perror("wait");
+			return 1;
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			failed = 1;
+	}
+	if (failed) {
+		fprintf(stderr, "Failed to serve the requests.\n");
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	close(listen_fd);
+
+	total_nanoseconds = (end.tv_sec - start.tv_sec) * 1000000000L +
+			    (end.tv_nsec - start.tv_nsec);
+	rps = (double)REQUESTS_PER_CLIENT * nr_clients /
+	      ((double)total_nanoseconds / 1e9);
+
+	printf("Served %d requests of %d bytes for each of %d clients over TCP loopback.\n",
+	       REQUESTS_PER_CLIENT, MESSAGE_SIZE, nr_clients);
+	printf("TCP loopback throughput: %.0f requests per second\n", rps);
+
+	return 0;
+}
@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: MPL-2.0
+
+// Tests that the functions implemented in the vDSO agree with the system calls.
+
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../network/test.h"
+
+FN_TEST(getcpu)
+{
+	unsigned int cpu, node;
+
+	cpu = node = -1;
+	TEST_RES(syscall(SYS_getcpu, &cpu, &node, NULL), cpu == 0 && node == 0);
+
+	cpu = node = -1;
+	TEST_RES(getcpu(&cpu, &node), cpu == 0 && node == 0);
+	TEST_RES(sched_getcpu(), _ret == 0);
+}
+END_TEST()
+
+FN_TEST(time)
+{
+	struct timespec ts;
+	time_t t;
+
+	TEST_SUCC(clock_gettime(CLOCK_REALTIME, &ts));
+	TEST_RES(time(&t), _ret == t && t >= ts.tv_sec && t <= ts.tv_sec + 1);
+}
+END_TEST()
+
+FN_TEST(gettimeofday)
+{
+	struct timespec before, after;
+	struct timeval tv;
+
+	TEST_SUCC(clock_gettime(CLOCK_REALTIME, &before));
+	TEST_SUCC(gettimeofday(&tv, NULL));
+	TEST_RES(clock_gettime(CLOCK_REALTIME, &after),
+		 tv.tv_sec >= before.tv_sec && tv.tv_sec <= after.tv_sec);
+}
+END_TEST()
@@ -29,15 +29,18 @@ EOF
     echo "$init_script"
 }
 
+# Run a benchmark on Linux and Asterinas with the given number of vCPUs, and
+# write the filled result template into the given file.
 run_benchmark() {
     local benchmark="$1"
     local avg_pattern="$2"
     local avg_field="$3"
+    local smp="$4"
+    local result_file="$5"
 
     local linux_output="${BENCHMARK_DIR}/linux_output.txt"
     local aster_output="${BENCHMARK_DIR}/aster_output.txt"
     local result_template="${BENCHMARK_DIR}/${benchmark}/result_template.json"
-    local result_file="result_${benchmark}.json"
 
     # Entrypoint script for initramfs
     local initramfs_entrypoint_script="${BENCHMARK_DIR}/benchmark_entrypoint.sh"
@@ -47,7 +50,7 @@ run_benchmark() {
     # TODO: enable nopti for Linux to make the comparison more fair
     local qemu_cmd="/usr/local/qemu/bin/qemu-system-x86_64 \
         --no-reboot \
-        -smp 1 \
+        -smp ${smp} \
         -m 8G \
         -machine q35,kernel-irqchip=split \
         -cpu Icelake-Server,+x2apic \
@@ -66,8 +69,8 @@ run_benchmark() {
             "https://api.github.com/repos/asterinas/linux_kernel/contents/vmlinuz-5.15.0-105-generic?ref=9e66d28"
     fi
 
-    echo "Running benchmark ${benchmark} on Linux and Asterinas..."
-    make run BENCHMARK=${benchmark} ENABLE_KVM=1 RELEASE=1 2>&1 | tee "${aster_output}"
+    echo "Running benchmark ${benchmark} with ${smp} vCPUs on Linux and Asterinas..."
+    SMP=${smp} make run BENCHMARK=${benchmark} ENABLE_KVM=1 RELEASE=1 2>&1 | tee "${aster_output}"
     eval "$qemu_cmd"
 
     echo "Parsing results..."
@@ -81,9 +84,12 @@ run_benchmark() {
     fi
 
     echo "Updating the result template with average values..."
-    jq --arg linux_avg "${LINUX_AVG}" --arg aster_avg "${ASTER_AVG}" \
+    # Keep the names of the single-vCPU results, so that they continue the results
+    # recorded before the benchmarks were swept over vCPU counts.
+    jq --arg linux_avg "${LINUX_AVG}" --arg aster_avg "${ASTER_AVG}" --argjson smp "${smp}" \
         '(.[] | select(.extra == "linux_avg") | .value) |= $linux_avg |
-         (.[] | select(.extra == "aster_avg") | .value) |= $aster_avg' \
+         (.[] | select(.extra == "aster_avg") | .value) |= $aster_avg |
+         if $smp > 1 then (.[] | .name) |= "\(.) (\($smp) vCPUs)" else . end' \
         "${result_template}" > "${result_file}"
 
     echo "Cleaning up..."
@@ -96,6 +102,9 @@ run_benchmark() {
 # Main
 
 BENCHMARK="$1"
+# The numbers of vCPUs to run the benchmark with, which are given by the `smp`
+# list of the benchmark's config.json by default.
+SMP_LIST="${*:2}"
 echo "Running benchmark ${BENCHMARK}..."
 pwd
 if [ ! -d "$BENCHMARK_DIR/$BENCHMARK" ]; then
@@ -105,7 +114,20 @@ fi
 
 PATTERN=$(jq -r '.pattern' "$BENCHMARK_DIR/$BENCHMARK/config.json")
 FIELD=$(jq -r '.field' "$BENCHMARK_DIR/$BENCHMARK/config.json")
+if [ -z "${SMP_LIST}" ]; then
+    SMP_LIST=$(jq -r '(.smp // [1]) | .[]' "$BENCHMARK_DIR/$BENCHMARK/config.json")
+fi
 
-run_benchmark "$BENCHMARK" "$PATTERN" "$FIELD"
+RESULT_FILE="result_${BENCHMARK}.json"
+SMP_RESULT_FILES=()
+for SMP in ${SMP_LIST}; do
+    SMP_RESULT_FILE="result_${BENCHMARK}_smp${SMP}.json"
+    run_benchmark "$BENCHMARK" "$PATTERN" "$FIELD" "$SMP" "$SMP_RESULT_FILE"
+    SMP_RESULT_FILES+=("${SMP_RESULT_FILE}")
+done
+
+# Merge the results of all vCPU counts into one file.
+jq -s 'add' "${SMP_RESULT_FILES[@]}" > "${RESULT_FILE}"
+rm -f "${SMP_RESULT_FILES[@]}"
 
 echo "Benchmark completed successfully."
@@ -0,0 +1,9 @@
+#!/bin/sh
+
+# SPDX-License-Identifier: MPL-2.0
+
+set -e
+
+echo "*** Running epoll_latency with 10000 fds ***"
+
+/benchmark/bin/epoll_latency 10000
\ No newline at end of file
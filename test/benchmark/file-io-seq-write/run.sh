@@ -0,0 +1,9 @@
+#!/bin/sh
+
+# SPDX-License-Identifier: MPL-2.0
+
+set -e
+
+echo "*** Running file_io for the sequential write bandwidth ***"
+
+/benchmark/bin/file_io /tmp/file_io_benchmark
\ No newline at end of file
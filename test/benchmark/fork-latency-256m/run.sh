@@ -0,0 +1,9 @@
+#!/bin/sh
+
+# SPDX-License-Identifier: MPL-2.0
+
+set -e
+
+echo "*** Running fork_latency with 256 MiB RSS ***"
+
+/benchmark/bin/fork_latency 256
\ No newline at end of file
@@ -0,0 +1,9 @@
+#!/bin/sh
+
+# SPDX-License-Identifier: MPL-2.0
+
+set -e
+
+echo "*** Running futex_pingpong ***"
+
+/benchmark/bin/futex_pingpong
\ No newline at end of file
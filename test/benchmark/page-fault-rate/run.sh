@@ -0,0 +1,9 @@
+#!/bin/sh
+
+# SPDX-License-Identifier: MPL-2.0
+
+set -e
+
+echo "*** Running page_fault with a thread per CPU ***"
+
+/benchmark/bin/page_fault --threads
\ No newline at end of file
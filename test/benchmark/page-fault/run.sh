@@ -0,0 +1,9 @@
+#!/bin/sh
+
+# SPDX-License-Identifier: MPL-2.0
+
+set -e
+
+echo "*** Running page_fault ***"
+
+/benchmark/bin/page_fault
\ No newline at end of file
@@ -0,0 +1,9 @@
+#!/bin/sh
+
+# SPDX-License-Identifier: MPL-2.0
+
+set -e
+
+echo "*** Running ipc_throughput with pipes ***"
+
+/benchmark/bin/ipc_throughput pipe
\ No newline at end of file
@@ -0,0 +1,11 @@
+#!/bin/sh
+
+# SPDX-License-Identifier: MPL-2.0
+
+set -e
+
+echo "*** Running tcp_rps ***"
+
+# The loopback interface is down in a bare Linux initramfs.
+ip link set lo up 2>/dev/null || true
+/benchmark/bin/tcp_rps
\ No newline at end of file
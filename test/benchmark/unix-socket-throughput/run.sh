@@ -0,0 +1,9 @@
+#!/bin/sh
+
+# SPDX-License-Identifier: MPL-2.0
+
+set -e
+
+echo "*** Running ipc_throughput with UNIX sockets ***"
+
+/benchmark/bin/ipc_throughput unix
\ No newline at end of file